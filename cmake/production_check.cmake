@@ -0,0 +1,24 @@
+# Fails if the program BINARY, built against verona_rt_production, still
+# has a symbol from the debugging, systematic testing or logging code,
+# listed with the nm tool NM. Run with cmake -P.
+execute_process(
+  COMMAND ${NM} -C ${BINARY}
+  OUTPUT_VARIABLE SYMBOLS
+  RESULT_VARIABLE NM_RESULT)
+
+if(NOT NM_RESULT EQUAL 0)
+  message(FATAL_ERROR "${NM} failed on ${BINARY}")
+endif()
+
+set(FOUND "")
+string(REPLACE "\n" ";" SYMBOLS "${SYMBOLS}")
+foreach(SYMBOL ${SYMBOLS})
+  if(SYMBOL MATCHES "Logging::|Systematic::|EventTrace::|systematic_id")
+    list(APPEND FOUND "${SYMBOL}")
+  endif()
+endforeach()
+
+if(FOUND)
+  string(REPLACE ";" "\n" FOUND "${FOUND}")
+  message(FATAL_ERROR "Debugging hooks left in ${BINARY}:\n${FOUND}")
+endif()
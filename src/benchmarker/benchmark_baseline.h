@@ -0,0 +1,275 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <test/opt.h>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/**
+ * Native implementations a workload can run instead of a region, so that
+ * the region types can be compared with memory managed without a runtime.
+ *
+ *  - New allocates every object with `new` and deletes it once the
+ *    workload knows it is dead, as a program managing lifetimes by hand
+ *    would. Where only a traversal can tell, the workload does the
+ *    traversal, and its cost counts.
+ *  - Shared links objects with std::shared_ptr, so an object is deleted
+ *    when the last pointer to it goes. Dead cycles stay allocated until
+ *    the workload ends and breaks them.
+ *  - Monotonic bump-allocates every object from a MonotonicArena and frees
+ *    them all together when the workload ends, as an Arena region does.
+ *
+ * A baseline raises no GC events, so its results have run times and
+ * process memory but no pauses. The benchmarker names its CSVs after the
+ * baseline instead of a region type (see baseline_name()).
+ */
+enum class Baseline
+{
+  None,
+  New,
+  Shared,
+  Monotonic,
+};
+
+/// The flags that select each baseline, in the order of Baseline.
+inline constexpr const char* BASELINE_FLAGS[] = {
+  "--baseline-new", "--baseline-shared", "--baseline-monotonic"};
+
+/// The name of `b` in CSV file names, or nullptr for None.
+inline const char* baseline_name(Baseline b)
+{
+  switch (b)
+  {
+    case Baseline::New:
+      return "baseline_new";
+    case Baseline::Shared:
+      return "baseline_shared";
+    case Baseline::Monotonic:
+      return "baseline_monotonic";
+    default:
+      return nullptr;
+  }
+}
+
+/// The baseline the arguments of a benchmark select, if any.
+inline Baseline baseline_from_args(int argc, char** argv)
+{
+  for (int i = 1; i < argc; i++)
+  {
+    for (size_t b = 0; b < std::size(BASELINE_FLAGS); b++)
+    {
+      if (std::strcmp(argv[i], BASELINE_FLAGS[b]) == 0)
+        return static_cast<Baseline>(b + 1);
+    }
+  }
+  return Baseline::None;
+}
+
+inline Baseline parse_baseline(opt::Opt& opt)
+{
+  for (size_t b = 0; b < std::size(BASELINE_FLAGS); b++)
+  {
+    if (opt.has(BASELINE_FLAGS[b]))
+      return static_cast<Baseline>(b + 1);
+  }
+  return Baseline::None;
+}
+
+/**
+ * Bump allocator over chunks that are only freed when it is destroyed or
+ * released. As in an Arena region, the destructors of the objects that
+ * have one are run then, in the order the objects were made.
+ */
+class MonotonicArena
+{
+  static constexpr size_t CHUNK_SIZE = 1024 * 1024;
+
+  std::vector<std::byte*> chunks;
+  std::byte* ptr = nullptr;
+  std::byte* end = nullptr;
+  size_t bytes = 0;
+
+  /// Objects with a destructor, and how to run it.
+  std::vector<std::pair<void*, void (*)(void*)>> finalisers;
+
+  static uintptr_t align_up(std::byte* p, size_t align)
+  {
+    return (reinterpret_cast<uintptr_t>(p) + align - 1) & ~(align - 1);
+  }
+
+public:
+  MonotonicArena() = default;
+  MonotonicArena(const MonotonicArena&) = delete;
+  MonotonicArena& operator=(const MonotonicArena&) = delete;
+
+  ~MonotonicArena()
+  {
+    release();
+  }
+
+  void* alloc(size_t size, size_t align)
+  {
+    uintptr_t p = align_up(ptr, align);
+    if ((ptr == nullptr) || (p + size > reinterpret_cast<uintptr_t>(end)))
+    {
+      size_t chunk = size + align > CHUNK_SIZE ? size + align : CHUNK_SIZE;
+      ptr = static_cast<std::byte*>(::operator new(chunk));
+      end = ptr + chunk;
+      chunks.push_back(ptr);
+      p = align_up(ptr, align);
+    }
+    ptr = reinterpret_cast<std::byte*>(p + size);
+    bytes += size;
+    return reinterpret_cast<void*>(p);
+  }
+
+  template<typename T, typename... Args>
+  T* make(Args&&... args)
+  {
+    T* o = new (alloc(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    if constexpr (!std::is_trivially_destructible_v<T>)
+      finalisers.emplace_back(o, [](void* p) { static_cast<T*>(p)->~T(); });
+    return o;
+  }
+
+  /// Free every object made so far.
+  void release()
+  {
+    for (auto& [o, finalise] : finalisers)
+      finalise(o);
+    finalisers.clear();
+    for (auto* c : chunks)
+      ::operator delete(c);
+    chunks.clear();
+    ptr = nullptr;
+    end = nullptr;
+    bytes = 0;
+  }
+
+  /// Bytes of objects made since the last release.
+  size_t get_bytes() const
+  {
+    return bytes;
+  }
+};
+
+struct NoSharedFromThis
+{};
+
+/**
+ * Base of the objects of a workload that needs a Ptr to an object it only
+ * has the address of (see BaselineHeap::ptr_to()). Only Shared needs
+ * anything from it.
+ */
+template<Baseline B, typename T>
+using BaselineObject = std::conditional_t<
+  B == Baseline::Shared,
+  std::enable_shared_from_this<T>,
+  NoSharedFromThis>;
+
+/**
+ * Makes and frees the objects of a workload as baseline `B` does. The
+ * workload's pointers are Ptr<T>, so that the same code links objects with
+ * std::shared_ptr for Shared and with raw pointers otherwise.
+ */
+template<Baseline B>
+class BaselineHeap
+{
+  MonotonicArena arena;
+
+public:
+  template<typename T>
+  using Ptr =
+    std::conditional_t<B == Baseline::Shared, std::shared_ptr<T>, T*>;
+
+  /// Whether dispose() frees objects, so the workload must find the dead.
+  static constexpr bool frees_each = B == Baseline::New;
+
+  template<typename T, typename... Args>
+  Ptr<T> make(Args&&... args)
+  {
+    if constexpr (B == Baseline::Shared)
+      return std::make_shared<T>(std::forward<Args>(args)...);
+    else if constexpr (B == Baseline::Monotonic)
+      return arena.template make<T>(std::forward<Args>(args)...);
+    else
+      return new T(std::forward<Args>(args)...);
+  }
+
+  /// The Ptr to `p`, an object made by make() that is still alive.
+  template<typename T>
+  Ptr<T> ptr_to(T* p)
+  {
+    if constexpr (B == Baseline::Shared)
+      return p->shared_from_this();
+    else
+      return p;
+  }
+
+  /**
+   * Drop `p`, which the workload knows to be the last pointer to a dead
+   * object. New deletes the object. Shared deletes it as the pointer goes,
+   * and Monotonic when the heap is destroyed.
+   */
+  template<typename P>
+  void dispose(P& p)
+  {
+    if constexpr (B == Baseline::New)
+      delete p;
+    p = nullptr;
+  }
+};
+
+/// The object `p` points to, without copying a std::shared_ptr.
+template<typename T>
+T* raw_ptr(T* p)
+{
+  return p;
+}
+
+template<typename T>
+T* raw_ptr(const std::shared_ptr<T>& p)
+{
+  return p.get();
+}
+
+template<typename F, typename... Args>
+decltype(auto) run_with_baseline(Baseline b, F&& f, Args&&... args)
+{
+  switch (b)
+  {
+    case Baseline::New:
+      return f.template operator()<Baseline::New>(std::forward<Args>(args)...);
+
+    case Baseline::Shared:
+      return f.template operator()<Baseline::Shared>(
+        std::forward<Args>(args)...);
+
+    case Baseline::Monotonic:
+      return f.template operator()<Baseline::Monotonic>(
+        std::forward<Args>(args)...);
+
+    default:
+      throw std::invalid_argument("Unknown Baseline");
+  }
+}
+
+#define MAKE_BASELINE_WRAPPER(name, func) \
+  struct name \
+  { \
+    template<Baseline B, typename... Args> \
+    decltype(auto) operator()(Args&&... args) const \
+    { \
+      return func<B>(std::forward<Args>(args)...); \
+    } \
+  };
+
+#define DISPATCH_BASELINE(b, wrapper, ...) \
+  run_with_baseline(b, wrapper{}, __VA_ARGS__)
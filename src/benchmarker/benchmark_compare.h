@@ -0,0 +1,144 @@
+#pragma once
+
+#include "benchmark_json.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+namespace benchmarker
+{
+  inline double median(std::vector<double> values)
+  {
+    if (values.empty())
+      return 0;
+    std::sort(values.begin(), values.end());
+    size_t n = values.size();
+    return (n % 2 == 1) ? values[n / 2] :
+                          (values[n / 2 - 1] + values[n / 2]) / 2;
+  }
+
+  /**
+   * One-sided Mann-Whitney U test: the probability of samples at least as
+   * far above `baseline` as `current` is, if both came from the same
+   * distribution. Uses the normal approximation with a correction for
+   * ties and for continuity, which is close to the exact test even for
+   * five runs a side.
+   */
+  inline double mann_whitney_greater(
+    const std::vector<double>& current, const std::vector<double>& baseline)
+  {
+    size_t n = current.size();
+    size_t m = baseline.size();
+    if (n == 0 || m == 0)
+      return 1;
+
+    double u = 0;
+    for (double c : current)
+    {
+      for (double b : baseline)
+        u += (c > b) ? 1.0 : ((c == b) ? 0.5 : 0.0);
+    }
+
+    // Sizes of groups of tied values, for the variance correction.
+    std::vector<double> all(current);
+    all.insert(all.end(), baseline.begin(), baseline.end());
+    std::sort(all.begin(), all.end());
+    double ties = 0;
+    for (size_t i = 0; i < all.size();)
+    {
+      size_t j = i;
+      while (j < all.size() && all[j] == all[i])
+        j++;
+      double t = (double)(j - i);
+      ties += t * t * t - t;
+      i = j;
+    }
+
+    double total = (double)(n + m);
+    double mean = (double)(n * m) / 2;
+    double variance = ((double)(n * m) / 12) *
+      ((total + 1) - ties / (total * (total - 1)));
+    if (variance <= 0)
+      return 1;
+
+    double z = (u - mean - 0.5) / std::sqrt(variance);
+    return 0.5 * std::erfc(z / std::sqrt(2.0));
+  }
+
+  /**
+   * Compare the runs of `current` against those of `baseline`, both as
+   * written by write_json(), and report each of COMPARED_METRICS to `out`.
+   *
+   * A metric has regressed if its median is worse by more than
+   * `threshold` (a fraction, so 0.05 for 5%) and the Mann-Whitney test
+   * finds it worse with a p-value below `alpha`. Returns whether any
+   * metric regressed, or if the two cannot be compared.
+   */
+  inline bool compare_results(
+    const JsonValue& baseline,
+    const JsonValue& current,
+    double threshold,
+    double alpha,
+    std::ostream& out)
+  {
+    const JsonValue* bs = baseline.get("schema");
+    const JsonValue* cs = current.get("schema");
+    if (bs == nullptr || cs == nullptr || bs->number != cs->number)
+    {
+      out << "Baseline was written with a different JSON schema, "
+             "so cannot be compared\n";
+      return true;
+    }
+
+    for (const char* field : {"benchmark", "region_type"})
+    {
+      const JsonValue* b = baseline.get(field);
+      const JsonValue* c = current.get(field);
+      if (b != nullptr && c != nullptr && b->string != c->string)
+        out << "Warning: baseline " << field << " is " << b->string
+            << ", but this run's is " << c->string << "\n";
+    }
+
+    bool regressed = false;
+    out << "\nComparison against baseline (threshold " << std::fixed
+        << std::setprecision(1) << threshold * 100 << "%, alpha "
+        << std::setprecision(3) << alpha << "):\n";
+    for (const auto& metric : COMPARED_METRICS)
+    {
+      std::vector<double> b = run_values(baseline, metric.name);
+      std::vector<double> c = run_values(current, metric.name);
+      if (b.empty() || c.empty())
+      {
+        out << "  " << metric.name << ": missing, not compared\n";
+        continue;
+      }
+
+      // Flip metrics where smaller is worse, so worse is always larger.
+      if (!metric.larger_is_worse)
+      {
+        for (auto& v : b)
+          v = -v;
+        for (auto& v : c)
+          v = -v;
+      }
+
+      double mb = median(b);
+      double mc = median(c);
+      double change = (mb == 0) ? 0 : (mc - mb) / std::fabs(mb);
+      double p = mann_whitney_greater(c, b);
+      bool worse = change > threshold && p < alpha;
+      regressed |= worse;
+
+      double sign = metric.larger_is_worse ? 1 : -1;
+      out << "  " << std::left << std::setw(22) << metric.name << std::right
+          << std::setprecision(1) << " median " << sign * mb << " -> "
+          << sign * mc << " (" << std::showpos << change * 100
+          << std::noshowpos << "% worse), p=" << std::setprecision(4) << p
+          << (worse ? "  REGRESSION" : "") << "\n";
+    }
+    return regressed;
+  }
+} // namespace benchmarker
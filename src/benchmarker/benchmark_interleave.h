@@ -0,0 +1,189 @@
+#pragma once
+
+#include "util/gc_benchmark.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <pal/cpu.h>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace benchmarker
+{
+  /// Region types in the order of RegionType, as named by their flags.
+  inline constexpr const char* REGION_NAMES[] = {
+    "trace", "arena", "rc", "semispace", "generational", "compact"};
+
+  /**
+   * Parse the argument of --regions: "all", or a comma separated list of
+   * region names. Returns an empty list if any name is not a region.
+   */
+  inline std::vector<size_t> parse_regions(const std::string& arg)
+  {
+    std::vector<size_t> regions;
+    if (arg == "all")
+    {
+      for (size_t t = 0; t < std::size(REGION_NAMES); t++)
+        regions.push_back(t);
+      return regions;
+    }
+
+    size_t start = 0;
+    while (start <= arg.size())
+    {
+      size_t end = std::min(arg.find(',', start), arg.size());
+      std::string name = arg.substr(start, end - start);
+      auto it = std::find_if(
+        std::begin(REGION_NAMES), std::end(REGION_NAMES), [&](const char* n) {
+          return name == n;
+        });
+      if (it == std::end(REGION_NAMES))
+        return {};
+      regions.push_back((size_t)(it - std::begin(REGION_NAMES)));
+      start = end + 1;
+    }
+    return regions;
+  }
+
+  inline bool is_region_flag(const std::string& arg)
+  {
+    for (const char* name : REGION_NAMES)
+    {
+      if (arg == std::string("--") + name)
+        return true;
+    }
+    return false;
+  }
+
+  /**
+   * Allocate and free a fixed amount of memory in a fixed pattern, so that
+   * every benchmark in the process starts from the same allocator state
+   * rather than the first paying for the allocator's first chunks.
+   */
+  inline void warm_allocator()
+  {
+    constexpr size_t TOTAL = 64 * 1024 * 1024;
+    constexpr size_t SIZES[] = {16, 32, 64, 128, 256, 512, 1024, 4096};
+
+    std::vector<std::pair<void*, size_t>> blocks;
+    for (size_t size : SIZES)
+    {
+      for (size_t n = 0; n < TOTAL / std::size(SIZES) / size; n++)
+        blocks.emplace_back(verona::rt::heap::alloc(size), size);
+    }
+    for (auto& [p, size] : blocks)
+      verona::rt::heap::dealloc(p, size);
+  }
+
+  /**
+   * Run the benchmark once for each of `regions` in every trial, in an
+   * order shuffled afresh for each trial, so that drift in the machine's
+   * clock speed or temperature over the process falls on every region
+   * type alike.
+   *
+   * `run_entry` runs the benchmark with the arguments it is given; each
+   * region's arguments are `args` with the region's flag appended, and
+   * any other region flag removed. The calling thread is pinned to
+   * `pin_core` (unless it is -1) before anything runs, and the allocator
+   * is warmed with warm_allocator(). Each region gets its own summary and
+   * CSV, as run_benchmark() gives, and the CSVs of all of them are
+   * written to combined/interleaved.csv, each after a "## region=<name>"
+   * line.
+   */
+  inline void run_interleaved(
+    const std::function<void(int, char**)>& run_entry,
+    const std::vector<std::string>& args,
+    const std::vector<size_t>& regions,
+    size_t runs,
+    size_t warmup_runs,
+    uint64_t order_seed,
+    size_t pin_core,
+    const char* lib_path)
+  {
+    using verona::rt::api::GCBenchmark;
+
+    struct Trial
+    {
+      size_t region;
+      std::vector<std::string> args;
+      std::vector<char*> argv;
+      GCBenchmark benchmark;
+      std::function<void()> test_fn;
+    };
+
+    verona::rt::cpu::set_affinity(pin_core);
+    warm_allocator();
+
+    std::vector<std::unique_ptr<Trial>> trials;
+    for (size_t region : regions)
+    {
+      auto t = std::make_unique<Trial>();
+      t->region = region;
+      for (const auto& a : args)
+      {
+        if (!is_region_flag(a))
+          t->args.push_back(a);
+      }
+      t->args.push_back(std::string("--") + REGION_NAMES[region]);
+      for (auto& a : t->args)
+        t->argv.push_back(a.data());
+      t->argv.push_back(nullptr);
+
+      Trial* raw = t.get();
+      t->test_fn = [raw, &run_entry]() {
+        run_entry((int)raw->args.size(), raw->argv.data());
+      };
+      trials.push_back(std::move(t));
+    }
+
+    std::cout << "=== Interleaved Warmup (" << warmup_runs
+              << " runs of each region type) ===\n";
+    for (size_t w = 0; w < warmup_runs; w++)
+    {
+      for (auto& t : trials)
+        t->benchmark.warmup_run(t->test_fn);
+    }
+
+    std::mt19937_64 rng(order_seed);
+    std::vector<Trial*> order;
+    for (auto& t : trials)
+      order.push_back(t.get());
+
+    for (size_t run = 0; run < runs; run++)
+    {
+      std::shuffle(order.begin(), order.end(), rng);
+      std::cout << "\n--- Trial " << (run + 1) << " of " << runs << " ---\n";
+      for (Trial* t : order)
+      {
+        std::cout << "[" << REGION_NAMES[t->region] << "] ";
+        t->benchmark.measure_run(t->test_fn);
+      }
+    }
+
+    std::string name = GCBenchmark::summary_name(lib_path);
+    for (auto& t : trials)
+      t->benchmark.print_summary(name.c_str());
+
+    auto dir = GCBenchmark::csv_directory(name) / "combined";
+    std::filesystem::create_directories(dir);
+    auto path = dir / "interleaved.csv";
+    std::ofstream file(path);
+    if (!file.is_open())
+    {
+      std::cerr << "Error: Could not open file " << path.string()
+                << " for writing\n";
+      return;
+    }
+    for (auto& t : trials)
+    {
+      file << "## region=" << REGION_NAMES[t->region] << "\n";
+      t->benchmark.write_csv(file);
+    }
+    std::cout << "Combined results written to " << path.string() << "\n";
+  }
+} // namespace benchmarker
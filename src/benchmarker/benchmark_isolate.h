@@ -0,0 +1,247 @@
+#pragma once
+
+#include "util/gc_benchmark.h"
+
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <pal/cpu.h>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#  include <sys/wait.h>
+#  include <unistd.h>
+#  if defined(__linux__)
+#    include <sched.h>
+#    include <sys/prctl.h>
+#  endif
+#endif
+
+namespace benchmarker
+{
+  /// How each process of run_isolated() is set up before its run.
+  struct IsolateOptions
+  {
+    /// CPUs the process, and so the scheduler's threads, may run on, or
+    /// empty for those the benchmarker may.
+    std::vector<size_t> cpus;
+    /// Bytes to allocate, touch and free before the run, so that the
+    /// allocator's first page faults are not part of it.
+    size_t prefault_bytes = 0;
+    /// Transparent huge page mode to set for the runs, "always", "madvise"
+    /// or "never", or empty to leave it as it is.
+    std::string thp;
+  };
+
+#ifndef _WIN32
+  /// The system's transparent huge page setting.
+  inline constexpr const char* THP_ENABLED =
+    "/sys/kernel/mm/transparent_hugepage/enabled";
+
+  /**
+   * The transparent huge page mode, the bracketed word of THP_ENABLED, or
+   * empty if it cannot be read.
+   */
+  inline std::string read_thp_mode()
+  {
+    FILE* f = fopen(THP_ENABLED, "r");
+    if (f == nullptr)
+      return {};
+    char line[128] = {};
+    bool got = fgets(line, sizeof(line), f) != nullptr;
+    fclose(f);
+    const char* start = got ? strchr(line, '[') : nullptr;
+    const char* end = start != nullptr ? strchr(start, ']') : nullptr;
+    if (end == nullptr)
+      return {};
+    return std::string(start + 1, end);
+  }
+
+  inline bool write_thp_mode(const std::string& mode)
+  {
+    FILE* f = fopen(THP_ENABLED, "w");
+    if (f == nullptr)
+      return false;
+    bool written = fputs(mode.c_str(), f) >= 0;
+    return (fclose(f) == 0) && written;
+  }
+
+  /**
+   * Set up this process, a child of run_isolated(), as `options` asks.
+   */
+  inline void prepare_isolated(const IsolateOptions& options)
+  {
+#  if defined(__linux__)
+    if (!options.cpus.empty())
+    {
+      // The runtime reads the affinity when it starts, and places its
+      // threads within it.
+      cpu_set_t set;
+      CPU_ZERO(&set);
+      for (size_t c : options.cpus)
+        CPU_SET(c, &set);
+      if (sched_setaffinity(0, sizeof(set), &set) != 0)
+        std::cerr << "Warning: could not pin to --isolate-cpus\n";
+    }
+    // Unlike the system setting, this needs no privilege.
+    if (options.thp == "never")
+      prctl(PR_SET_THP_DISABLE, 1, 0, 0, 0);
+#  else
+    if (!options.cpus.empty())
+      verona::rt::cpu::set_affinity(options.cpus.front());
+#  endif
+
+    if (options.prefault_bytes != 0)
+    {
+      constexpr size_t BLOCK = 64 * 1024;
+      std::vector<void*> blocks;
+      for (size_t n = 0; n < options.prefault_bytes / BLOCK; n++)
+      {
+        void* p = verona::rt::heap::alloc(BLOCK);
+        memset(p, 0, BLOCK);
+        blocks.push_back(p);
+      }
+      for (void* p : blocks)
+        verona::rt::heap::dealloc(p, BLOCK);
+    }
+  }
+
+  /**
+   * Run `test_fn` in a process of its own, forked from this one, set up
+   * with `options`. If `measure` is set, the run is measured and its
+   * results are added to `benchmark`. Returns false if the process failed
+   * or its results could not be read.
+   */
+  inline bool isolated_run(
+    verona::rt::api::GCBenchmark& benchmark,
+    const std::function<void()>& test_fn,
+    const IsolateOptions& options,
+    bool measure)
+  {
+    int fds[2];
+    if (pipe(fds) != 0)
+      return false;
+
+    std::cout.flush();
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+      close(fds[0]);
+      close(fds[1]);
+      return false;
+    }
+
+    if (pid == 0)
+    {
+      close(fds[0]);
+      prepare_isolated(options);
+      verona::rt::api::GCBenchmark child;
+      std::ostringstream out;
+      if (measure)
+      {
+        child.measure_run(test_fn);
+        child.write_run(out, 0);
+      }
+      else
+      {
+        child.warmup_run(test_fn);
+      }
+      std::cout.flush();
+
+      std::string bytes = out.str();
+      const char* p = bytes.data();
+      size_t left = bytes.size();
+      while (left > 0)
+      {
+        ssize_t n = write(fds[1], p, left);
+        if (n <= 0)
+          _exit(1);
+        p += n;
+        left -= (size_t)n;
+      }
+      close(fds[1]);
+      // Skip the destructors of the state forked from the parent.
+      _exit(0);
+    }
+
+    close(fds[1]);
+    std::string bytes;
+    char buf[4096];
+    ssize_t n;
+    while ((n = read(fds[0], buf, sizeof(buf))) > 0)
+      bytes.append(buf, (size_t)n);
+    close(fds[0]);
+
+    int status = 0;
+    waitpid(pid, &status, 0);
+    if (!WIFEXITED(status) || (WEXITSTATUS(status) != 0))
+      return false;
+    if (!measure)
+      return true;
+
+    std::istringstream in(bytes);
+    return benchmark.read_run(in);
+  }
+
+  /**
+   * Make each warmup and measured run in a fresh process forked from this
+   * one, which must not have started the runtime, so that no run inherits
+   * the allocator's caches, the regions' chunk caches or the page state of
+   * the runs before it. Each process is set up with `options` before its
+   * run; the results of the measured ones are added to `benchmark`, and
+   * summarised as run_benchmark() would. Returns false if any run failed.
+   */
+  inline bool run_isolated(
+    verona::rt::api::GCBenchmark& benchmark,
+    const std::function<void()>& test_fn,
+    size_t runs,
+    size_t warmup_runs,
+    const IsolateOptions& options,
+    const char* lib_path)
+  {
+    using verona::rt::api::GCBenchmark;
+
+    // The system setting is shared, so it is put back once the runs end.
+    std::string thp_before;
+    if (!options.thp.empty())
+    {
+      thp_before = read_thp_mode();
+      if (!write_thp_mode(options.thp))
+      {
+        std::cerr << "Warning: could not set " << THP_ENABLED << " to "
+                  << options.thp << "\n";
+        thp_before.clear();
+      }
+    }
+
+    bool ok = true;
+    std::cout << "=== Isolated Warmup (" << warmup_runs << " processes) ===\n";
+    for (size_t w = 0; ok && (w < warmup_runs); w++)
+      ok = isolated_run(benchmark, test_fn, options, false);
+
+    std::cout << "\n=== Isolated Measurement (" << runs
+              << " processes) ===\n\n";
+    for (size_t run = 0; ok && (run < runs); run++)
+    {
+      std::cout << "\n--- Isolated Run " << (run + 1) << " of " << runs
+                << " ---\n";
+      ok = isolated_run(benchmark, test_fn, options, true);
+    }
+
+    if (!thp_before.empty())
+      write_thp_mode(thp_before);
+
+    if (!ok)
+    {
+      std::cerr << "Error: an isolated run failed\n";
+      return false;
+    }
+    benchmark.set_warmup_runs(warmup_runs);
+    benchmark.print_summary(GCBenchmark::summary_name(lib_path).c_str());
+    return true;
+  }
+#endif
+} // namespace benchmarker
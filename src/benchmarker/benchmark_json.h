@@ -0,0 +1,363 @@
+#pragma once
+
+#include "util/gc_benchmark.h"
+
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef BENCHMARK_GIT_SHA
+#  define BENCHMARK_GIT_SHA "unknown"
+#endif
+#ifndef BENCHMARK_BUILD_TYPE
+#  define BENCHMARK_BUILD_TYPE "unknown"
+#endif
+#ifndef BENCHMARK_CXX_FLAGS
+#  define BENCHMARK_CXX_FLAGS ""
+#endif
+#ifndef BENCHMARK_COMPILER
+#  define BENCHMARK_COMPILER "unknown"
+#endif
+
+namespace benchmarker
+{
+  /**
+   * Version of the JSON written by write_json(). Bump it when a field
+   * changes meaning, so that comparisons against old baselines fail
+   * rather than compare different things.
+   */
+  inline constexpr int JSON_SCHEMA = 1;
+
+  /**
+   * The metrics that --compare tests, as they are named in the "runs"
+   * array, and whether a larger value is worse.
+   */
+  struct ComparedMetric
+  {
+    const char* name;
+    bool larger_is_worse;
+  };
+
+  inline constexpr ComparedMetric COMPARED_METRICS[] = {
+    {"p99_gc_ns", true},
+    {"throughput_runs_per_s", false},
+    {"peak_mem_bytes", true},
+  };
+
+  inline void write_json_string(std::ostream& out, const std::string& s)
+  {
+    out << '"';
+    for (char c : s)
+    {
+      switch (c)
+      {
+        case '"':
+          out << "\\\"";
+          break;
+        case '\\':
+          out << "\\\\";
+          break;
+        case '\n':
+          out << "\\n";
+          break;
+        case '\t':
+          out << "\\t";
+          break;
+        default:
+          if ((unsigned char)c < 0x20)
+            out << "\\u00" << "0123456789abcdef"[(c >> 4) & 0xf]
+                << "0123456789abcdef"[c & 0xf];
+          else
+            out << c;
+      }
+    }
+    out << '"';
+  }
+
+  /**
+   * Write the results of `benchmark` as JSON, with what is needed to
+   * reproduce and compare them: the commit and build they came from, the
+   * machine's core count, and the arguments the benchmark was given.
+   */
+  inline void write_json(
+    std::ostream& out,
+    const verona::rt::api::GCBenchmark& benchmark,
+    const std::string& name,
+    const std::vector<std::string>& parameters,
+    size_t warmup_runs)
+  {
+    const char* type_names[] = {
+      "trace", "arena", "rc", "semispace", "generational", "compact", "bytes"};
+    int type = benchmark.get_region_type();
+
+    out << "{\n";
+    out << "  \"schema\": " << JSON_SCHEMA << ",\n";
+    out << "  \"benchmark\": ";
+    write_json_string(out, name);
+    out << ",\n  \"git_sha\": ";
+    write_json_string(out, BENCHMARK_GIT_SHA);
+    out << ",\n  \"build\": {\"type\": ";
+    write_json_string(out, BENCHMARK_BUILD_TYPE);
+    out << ", \"compiler\": ";
+    write_json_string(out, BENCHMARK_COMPILER);
+    out << ", \"cxx_flags\": ";
+    write_json_string(out, BENCHMARK_CXX_FLAGS);
+    out << "},\n";
+    out << "  \"cores\": " << std::thread::hardware_concurrency() << ",\n";
+    out << "  \"region_type\": ";
+    if (!benchmark.get_variant().empty())
+      write_json_string(out, benchmark.get_variant());
+    else
+      write_json_string(
+        out,
+        (type >= 0 && (size_t)type < std::size(type_names)) ?
+          type_names[type] :
+          "none");
+    out << ",\n  \"parameters\": [";
+    for (size_t i = 0; i < parameters.size(); i++)
+    {
+      if (i != 0)
+        out << ", ";
+      write_json_string(out, parameters[i]);
+    }
+    out << "],\n";
+    out << "  \"warmup_runs\": " << warmup_runs << ",\n";
+    out << "  \"runs\": [";
+
+    const auto& results = benchmark.get_results();
+    for (size_t i = 0; i < results.size(); i++)
+    {
+      const auto& r = results[i];
+      double throughput =
+        r.total_run_time_ns == 0 ? 0 : 1e9 / (double)r.total_run_time_ns;
+      out << (i == 0 ? "\n" : ",\n");
+      out << "    {\"run_time_ns\": " << r.total_run_time_ns
+          << ", \"throughput_runs_per_s\": " << std::setprecision(17)
+          << throughput          << ", \"gc_time_ns\": " << r.total_gc_time_ns
+          << ", \"gc_calls\": " << r.gc_call_count
+          << ", \"avg_gc_ns\": " << r.average_gc_time_ns
+          << ", \"max_gc_ns\": " << r.max_gc_time_ns
+          << ", \"p99_gc_ns\": " << r.p99_gc_time_ns
+          << ", \"avg_mem_bytes\": " << r.avg_memory_bytes
+          << ", \"peak_mem_bytes\": " << r.peak_memory_bytes
+          << ", \"peak_objects\": " << r.peak_object_count
+          << ", \"avg_mem_after_bytes\": " << r.avg_memory_after_bytes
+          << ", \"reclaimed_bytes\": " << r.gc_bytes_freed
+          << ", \"survival_ratio\": " << r.survival_ratio
+          << ", \"rss_avg_bytes\": " << r.process_memory.avg_rss
+          << ", \"rss_peak_bytes\": " << r.process_memory.peak_rss
+          << ", \"allocator_peak_bytes\": "
+          << r.process_memory.peak_allocator << "}";
+    }
+    out << "\n  ]\n}\n";
+  }
+
+  /**
+   * A JSON value, as read by parse_json(). Only what is needed to read
+   * back the output of write_json().
+   */
+  struct JsonValue
+  {
+    enum class Kind
+    {
+      Null,
+      Bool,
+      Number,
+      String,
+      Array,
+      Object
+    };
+
+    Kind kind = Kind::Null;
+    bool boolean = false;
+    double number = 0;
+    std::string string;
+    std::vector<JsonValue> array;
+    std::vector<std::pair<std::string, JsonValue>> object;
+
+    /// The member called `key` of an object, or nullptr.
+    const JsonValue* get(const std::string& key) const
+    {
+      for (const auto& [k, v] : object)
+      {
+        if (k == key)
+          return &v;
+      }
+      return nullptr;
+    }
+  };
+
+  class JsonParser
+  {
+    const std::string& text;
+    size_t pos = 0;
+
+    void skip_space()
+    {
+      while (pos < text.size() && std::isspace((unsigned char)text[pos]))
+        pos++;
+    }
+
+    bool consume(char c)
+    {
+      skip_space();
+      if (pos < text.size() && text[pos] == c)
+      {
+        pos++;
+        return true;
+      }
+      return false;
+    }
+
+    bool consume_word(const char* w)
+    {
+      size_t n = std::strlen(w);
+      if (text.compare(pos, n, w) != 0)
+        return false;
+      pos += n;
+      return true;
+    }
+
+    bool parse_string(std::string& s)
+    {
+      if (!consume('"'))
+        return false;
+      while (pos < text.size() && text[pos] != '"')
+      {
+        char c = text[pos++];
+        if (c != '\\')
+        {
+          s += c;
+          continue;
+        }
+        if (pos >= text.size())
+          return false;
+        char e = text[pos++];
+        switch (e)
+        {
+          case 'n':
+            s += '\n';
+            break;
+          case 't':
+            s += '\t';
+            break;
+          case 'u':
+            // Only the control characters write_json_string() escapes.
+            if (pos + 4 > text.size())
+              return false;
+            s += (char)std::strtol(text.substr(pos, 4).c_str(), nullptr, 16);
+            pos += 4;
+            break;
+          default:
+            s += e;
+        }
+      }
+      return consume('"');
+    }
+
+    bool parse_value(JsonValue& v)
+    {
+      skip_space();
+      if (pos >= text.size())
+        return false;
+
+      char c = text[pos];
+      if (c == '{')
+      {
+        pos++;
+        v.kind = JsonValue::Kind::Object;
+        if (consume('}'))
+          return true;
+        do
+        {
+          std::string key;
+          JsonValue member;
+          if (!parse_string(key) || !consume(':') || !parse_value(member))
+            return false;
+          v.object.emplace_back(std::move(key), std::move(member));
+        } while (consume(','));
+        return consume('}');
+      }
+      if (c == '[')
+      {
+        pos++;
+        v.kind = JsonValue::Kind::Array;
+        if (consume(']'))
+          return true;
+        do
+        {
+          v.array.emplace_back();
+          if (!parse_value(v.array.back()))
+            return false;
+        } while (consume(','));
+        return consume(']');
+      }
+      if (c == '"')
+      {
+        v.kind = JsonValue::Kind::String;
+        return parse_string(v.string);
+      }
+      if (consume_word("true") || consume_word("false"))
+      {
+        v.kind = JsonValue::Kind::Bool;
+        v.boolean = text[pos - 4] == 't';
+        return true;
+      }
+      if (consume_word("null"))
+        return true;
+
+      char* end;
+      v.number = std::strtod(text.c_str() + pos, &end);
+      if (end == text.c_str() + pos)
+        return false;
+      v.kind = JsonValue::Kind::Number;
+      pos = (size_t)(end - text.c_str());
+      return true;
+    }
+
+  public:
+    JsonParser(const std::string& text) : text(text) {}
+
+    std::optional<JsonValue> parse()
+    {
+      JsonValue v;
+      if (!parse_value(v))
+        return std::nullopt;
+      skip_space();
+      if (pos != text.size())
+        return std::nullopt;
+      return v;
+    }
+  };
+
+  inline std::optional<JsonValue> parse_json(const std::string& text)
+  {
+    return JsonParser(text).parse();
+  }
+
+  /**
+   * The values of `metric` in each run of a document written by
+   * write_json().
+   */
+  inline std::vector<double>
+  run_values(const JsonValue& doc, const char* metric)
+  {
+    std::vector<double> values;
+    const JsonValue* runs = doc.get("runs");
+    if (runs == nullptr)
+      return values;
+    for (const auto& run : runs->array)
+    {
+      const JsonValue* v = run.get(metric);
+      if (v != nullptr && v->kind == JsonValue::Kind::Number)
+        values.push_back(v->number);
+    }
+    return values;
+  }
+} // namespace benchmarker
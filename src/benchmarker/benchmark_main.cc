@@ -1,7 +1,15 @@
+#include "benchmark_baseline.h"
+#include "benchmark_compare.h"
+#include "benchmark_interleave.h"
+#include "benchmark_isolate.h"
+#include "benchmark_json.h"
+#include "benchmark_sweep.h"
 #include "util/gc_benchmark.h"
 
 #include <debug/harness.h>
+#include <fstream>
 #include <iostream>
+#include <sstream>
 #include <region/region_api.h>
 #include <test/opt.h>
 
@@ -44,6 +52,33 @@ int main(int argc, char** argv)
 {
   size_t runs = 0;
   size_t warmup_runs = 0;
+  // Where to write the results as JSON, and a previous run's results to
+  // compare them against. A metric regresses if it is worse by more than
+  // `threshold` and the difference is significant at `alpha`.
+  const char* json_path = nullptr;
+  const char* baseline_path = nullptr;
+  double threshold = 0.05;
+  double alpha = 0.05;
+  // Region types to run in one process, interleaved; the order of each
+  // trial is shuffled from `order_seed`, on a thread pinned to `pin_core`.
+  std::vector<size_t> regions;
+  uint64_t order_seed = 1;
+  size_t pin_core = 0;
+  // Cells of a scaling sweep: core counts, and benchmark flags with the
+  // values to give them. The region types are those of --regions.
+  benchmarker::SweepGrid sweep;
+  // Where to record the region operations of one run, for replay.
+  const char* trace_path = nullptr;
+  // Where to write the runtime events of one run (see EventTrace).
+  const char* events_path = nullptr;
+  // Whether to choose the numbers of runs as the results settle, rather
+  // than take them from --runs and --warmup_runs.
+  bool adaptive = false;
+  GCBenchmark::AdaptivePolicy policy;
+  // Whether to make each run in a process of its own, set up as `isolate`
+  // says.
+  bool isolated = false;
+  benchmarker::IsolateOptions isolate;
   int filepath_index = -1;
 
   for (int i = 1; i < argc; ++i)
@@ -56,6 +91,153 @@ int main(int argc, char** argv)
     {
       warmup_runs = std::stoul(argv[++i]);
     }
+    else if (std::strcmp(argv[i], "--adaptive") == 0)
+    {
+      adaptive = true;
+    }
+    else if (std::strcmp(argv[i], "--precision") == 0 && i + 1 < argc)
+    {
+      policy.precision = std::stod(argv[++i]) / 100;
+    }
+    else if (std::strcmp(argv[i], "--max-runs") == 0 && i + 1 < argc)
+    {
+      policy.max_runs = std::stoul(argv[++i]);
+    }
+    else if (std::strcmp(argv[i], "--metric") == 0 && i + 1 < argc)
+    {
+      i++;
+      if (std::strcmp(argv[i], "run_time") == 0)
+        policy.metric = GCBenchmark::AdaptiveMetric::RunTime;
+      else if (std::strcmp(argv[i], "p99_pause") == 0)
+        policy.metric = GCBenchmark::AdaptiveMetric::P99Pause;
+      else
+      {
+        std::cerr << "Unknown --metric " << argv[i] << "\n";
+        return 1;
+      }
+    }
+    else if (std::strcmp(argv[i], "--isolate") == 0)
+    {
+      isolated = true;
+    }
+    else if (std::strcmp(argv[i], "--isolate-cpus") == 0 && i + 1 < argc)
+    {
+      for (const auto& c : benchmarker::split_list(argv[++i]))
+        isolate.cpus.push_back(std::stoul(c));
+    }
+    else if (std::strcmp(argv[i], "--prefault-mb") == 0 && i + 1 < argc)
+    {
+      isolate.prefault_bytes = std::stoul(argv[++i]) * 1024 * 1024;
+    }
+    else if (std::strcmp(argv[i], "--thp") == 0 && i + 1 < argc)
+    {
+      isolate.thp = argv[++i];
+      if (
+        isolate.thp != "always" && isolate.thp != "madvise" &&
+        isolate.thp != "never")
+      {
+        std::cerr << "Unknown --thp " << isolate.thp << "\n";
+        return 1;
+      }
+    }
+    else if (std::strcmp(argv[i], "--json") == 0 && i + 1 < argc)
+    {
+      json_path = argv[++i];
+    }
+    else if (std::strcmp(argv[i], "--compare") == 0 && i + 1 < argc)
+    {
+      baseline_path = argv[++i];
+    }
+    else if (std::strcmp(argv[i], "--threshold") == 0 && i + 1 < argc)
+    {
+      threshold = std::stod(argv[++i]) / 100;
+    }
+    else if (std::strcmp(argv[i], "--alpha") == 0 && i + 1 < argc)
+    {
+      alpha = std::stod(argv[++i]);
+    }
+    else if (std::strcmp(argv[i], "--regions") == 0 && i + 1 < argc)
+    {
+      regions = benchmarker::parse_regions(argv[++i]);
+      if (regions.empty())
+      {
+        std::cerr << "Unknown region type in --regions " << argv[i] << "\n";
+        return 1;
+      }
+    }
+    else if (std::strcmp(argv[i], "--order-seed") == 0 && i + 1 < argc)
+    {
+      order_seed = std::stoull(argv[++i]);
+    }
+    else if (std::strcmp(argv[i], "--pin") == 0 && i + 1 < argc)
+    {
+      pin_core = (std::strcmp(argv[++i], "none") == 0) ?
+        (size_t)-1 :
+        std::stoul(argv[i]);
+    }
+    else if (std::strcmp(argv[i], "--sweep-cores") == 0 && i + 1 < argc)
+    {
+      for (const auto& c : benchmarker::split_list(argv[++i]))
+        sweep.cores.push_back(std::stoul(c));
+    }
+    else if (std::strcmp(argv[i], "--sweep-param") == 0 && i + 1 < argc)
+    {
+      benchmarker::SweepParam param;
+      if (!benchmarker::parse_sweep_param(argv[++i], param))
+      {
+        std::cerr << "Expected <flag>=<value>,... in --sweep-param "
+                  << argv[i] << "\n";
+        return 1;
+      }
+      sweep.params.push_back(std::move(param));
+    }
+    else if (std::strcmp(argv[i], "--record-trace") == 0 && i + 1 < argc)
+    {
+      trace_path = argv[++i];
+    }
+    else if (std::strcmp(argv[i], "--event-trace") == 0 && i + 1 < argc)
+    {
+      events_path = argv[++i];
+    }
+    else if (std::strcmp(argv[i], "--print-events") == 0 && i + 1 < argc)
+    {
+      if (!verona::rt::EventTrace::format(argv[++i], std::cout))
+      {
+        std::cerr << "Error: " << argv[i] << " is not an event trace\n";
+        return 1;
+      }
+      return 0;
+    }
+    else if (
+      std::strcmp(argv[i], "--print-events-chrome") == 0 && i + 1 < argc)
+    {
+      if (!verona::rt::EventTrace::format_chrome(argv[++i], std::cout))
+      {
+        std::cerr << "Error: " << argv[i] << " is not an event trace\n";
+        return 1;
+      }
+      return 0;
+    }
+    else if (std::strcmp(argv[i], "--perf-counters") == 0)
+    {
+      verona::rt::PerfCounters::set_enabled(true);
+    }
+    else if (std::strcmp(argv[i], "--profile-behaviours") == 0)
+    {
+      verona::rt::BehaviourProfile::set_enabled(true);
+    }
+    else if (std::strcmp(argv[i], "--profile-heap") == 0)
+    {
+      verona::rt::HeapProfile::set_enabled(true);
+    }
+    else if (std::strcmp(argv[i], "--pretenure-after") == 0 && i + 1 < argc)
+    {
+      verona::rt::AllocSites::set_pretenure_after(std::stoul(argv[++i]));
+    }
+    else if (std::strcmp(argv[i], "--memory-sample-us") == 0 && i + 1 < argc)
+    {
+      verona::rt::MemorySampler::set_interval(std::stoul(argv[++i]));
+    }
     else
     {
       filepath_index = i;
@@ -63,10 +245,61 @@ int main(int argc, char** argv)
     }
   }
 
-  if (filepath_index == -1 || runs == 0 || warmup_runs == 0)
+  if (
+    filepath_index == -1 ||
+    (trace_path == nullptr && events_path == nullptr && !adaptive &&
+     (runs == 0 || warmup_runs == 0)))
   {
     std::cerr << "Usage: " << argv[0]
-              << " --runs <n> --warmup_runs <n> <path_to_so> [args...]\n";
+              << " --runs <n> --warmup_runs <n>"
+                 " | --adaptive [--precision <percent>] [--max-runs <n>]"
+                 " [--metric run_time|p99_pause]"
+                 " [--isolate [--isolate-cpus <c>,...] [--prefault-mb <n>]"
+                 " [--thp always|madvise|never]]"
+                 " [--json <out.json>]"
+                 " [--compare <baseline.json>] [--threshold <percent>]"
+                 " [--alpha <p>] [--regions all|<type>,...]"
+                 " [--order-seed <n>] [--pin <core>|none]"
+                 " [--sweep-cores <n>,...] [--sweep-param <flag>=<v>,...]"
+                 " [--record-trace <out.trace>]"
+                 " [--event-trace <out.events>] [--print-events <file>]"
+                 " [--print-events-chrome <file>]"
+                 " [--perf-counters] [--profile-behaviours] [--profile-heap]"
+                 " [--pretenure-after <n>] [--memory-sample-us <n>]"
+                 " <path_to_so> [args...]\n";
+    return 1;
+  }
+
+  if (!regions.empty() && (json_path != nullptr || baseline_path != nullptr))
+  {
+    std::cerr << "--json and --compare cannot be combined with --regions\n";
+    return 1;
+  }
+
+  if (!sweep.params.empty() && sweep.cores.empty())
+    sweep.cores.push_back(0);
+  if (adaptive && (!regions.empty() || !sweep.cores.empty()))
+  {
+    std::cerr << "--adaptive cannot be combined with --regions or a sweep\n";
+    return 1;
+  }
+  if (isolated && (adaptive || !regions.empty() || !sweep.cores.empty()))
+  {
+    std::cerr << "--isolate cannot be combined with --adaptive, --regions"
+                 " or a sweep\n";
+    return 1;
+  }
+#ifdef PLATFORM_WINDOWS
+  if (isolated)
+  {
+    std::cerr << "--isolate needs fork, which Windows does not have\n";
+    return 1;
+  }
+#endif
+  if (
+    !sweep.cores.empty() && (json_path != nullptr || baseline_path != nullptr))
+  {
+    std::cerr << "--json and --compare cannot be combined with a sweep\n";
     return 1;
   }
 
@@ -74,6 +307,30 @@ int main(int argc, char** argv)
   int new_argc = argc - filepath_index;
   char** new_argv = argv + filepath_index;
 
+  // A native baseline (see Baseline) runs without regions, so there are no
+  // region types to interleave or sweep.
+  Baseline baseline = baseline_from_args(new_argc, new_argv);
+  if (
+    baseline != Baseline::None && (!regions.empty() || !sweep.cores.empty()))
+  {
+    std::cerr << "--regions and sweeps cannot be combined with a baseline\n";
+    return 1;
+  }
+
+  // Print the behaviour and heap profiles of every run, however the runs
+  // end. The profiles keep their own copies of the site and type names, so
+  // this may follow LIB_CLOSE.
+  struct ProfileDump
+  {
+    ~ProfileDump()
+    {
+      if (verona::rt::BehaviourProfile::is_enabled())
+        verona::rt::BehaviourProfile::dump(std::cout);
+      if (verona::rt::HeapProfile::is_enabled())
+        verona::rt::HeapProfile::dump(std::cout);
+    }
+  } profile_dump;
+
   const char* lib_path = new_argv[0];
   LibHandle handle = LIB_OPEN(lib_path);
   if (!handle)
@@ -105,41 +362,199 @@ int main(int argc, char** argv)
   std::cout << "\nRunning benchmark: " << lib_path << "\n";
   SystematicTestHarness harness(new_argc, new_argv);
   GCBenchmark benchmark;
+  if (baseline != Baseline::None)
+    benchmark.set_variant(baseline_name(baseline));
 #ifdef PLATFORM_WINDOWS
-  using CallbackSetter =
-    void (*)(void (*)(uint64_t, verona::rt::RegionType, size_t, size_t));
+  using CallbackSetter = void (*)(void (*)(const verona::rt::GCEvent&));
   auto set_callback =
     reinterpret_cast<CallbackSetter>(LIB_SYM(handle, "set_gc_callback"));
 
-  auto test_wrapper = [&]() {
+  auto run_entry = [&](int entry_argc, char** entry_argv) {
     if (set_callback)
     {
       auto* local_callback = verona::rt::get_gc_callback();
       if (local_callback)
       {
-        static std::function<void(
-          uint64_t, verona::rt::RegionType, size_t, size_t)>* current = nullptr;
+        static std::function<void(const verona::rt::GCEvent&)>* current =
+          nullptr;
         current = local_callback;
-        set_callback(
-          [](uint64_t d, verona::rt::RegionType r, size_t m, size_t o) {
-            if (current && *current)
-              (*current)(d, r, m, o);
-          });
+        set_callback([](const verona::rt::GCEvent& e) {
+          if (current && *current)
+            (*current)(e);
+        });
       }
     }
-    harness.run([&]() { entry(new_argc, new_argv); });
+    harness.run([&]() { entry(entry_argc, entry_argv); });
     if (set_callback)
       set_callback(nullptr);
   };
-
-  benchmark.run_benchmark(test_wrapper, runs, warmup_runs, lib_path);
 #else
-  benchmark.run_benchmark(
-    [&]() { harness.run([&]() { entry(new_argc, new_argv); }); },
-    runs,
-    warmup_runs,
-    lib_path);
+  auto run_entry = [&](int entry_argc, char** entry_argv) {
+    harness.run([&]() { entry(entry_argc, entry_argv); });
+  };
+#endif
+
+  if (trace_path != nullptr)
+  {
+    // Objects that move cannot be followed by their address.
+    for (int i = 1; i < new_argc; i++)
+    {
+      if (
+        std::strcmp(new_argv[i], "--semispace") == 0 ||
+        std::strcmp(new_argv[i], "--generational") == 0 ||
+        std::strcmp(new_argv[i], "--compact") == 0)
+      {
+        std::cerr << "--record-trace needs --trace, --arena or --rc\n";
+        LIB_CLOSE(handle);
+        return 1;
+      }
+    }
+    if (!verona::rt::AllocTrace::start(trace_path))
+    {
+      std::cerr << "Error: Could not open file " << trace_path
+                << " for writing\n";
+      LIB_CLOSE(handle);
+      return 1;
+    }
+    run_entry(new_argc, new_argv);
+    verona::rt::AllocTrace::stop();
+    std::cout << "Trace written to " << trace_path << "\n";
+    LIB_CLOSE(handle);
+    return 0;
+  }
+
+  if (events_path != nullptr)
+  {
+    if (!verona::rt::EventTrace::enabled)
+    {
+      std::cerr << "--event-trace needs a build with USE_EVENT_TRACE\n";
+      LIB_CLOSE(handle);
+      return 1;
+    }
+    if (!verona::rt::EventTrace::start(events_path))
+    {
+      std::cerr << "Error: Could not open file " << events_path
+                << " for writing\n";
+      LIB_CLOSE(handle);
+      return 1;
+    }
+    run_entry(new_argc, new_argv);
+    verona::rt::EventTrace::stop();
+    std::cout << "Events written to " << events_path << ", "
+              << verona::rt::EventTrace::get_dropped()
+              << " dropped as a ring was full\n";
+    LIB_CLOSE(handle);
+    return 0;
+  }
+
+  if (!sweep.cores.empty())
+  {
+    // A sweep of parameters alone keeps the core count of the arguments.
+    for (size_t& c : sweep.cores)
+    {
+      if (c == 0)
+        c = harness.cores;
+    }
+    sweep.regions = regions;
+    std::vector<std::string> args(new_argv, new_argv + new_argc);
+    benchmarker::run_sweep(
+      run_entry,
+      [&]() { harness.run([]() {}); },
+      harness.cores,
+      args,
+      sweep,
+      runs,
+      warmup_runs,
+      lib_path);
+    LIB_CLOSE(handle);
+    return 0;
+  }
+
+  if (!regions.empty())
+  {
+    std::vector<std::string> args(new_argv, new_argv + new_argc);
+    benchmarker::run_interleaved(
+      run_entry,
+      args,
+      regions,
+      runs,
+      warmup_runs,
+      order_seed,
+      pin_core,
+      lib_path);
+    LIB_CLOSE(handle);
+    return 0;
+  }
+
+  if (adaptive)
+    benchmark.run_adaptive(
+      [&]() { run_entry(new_argc, new_argv); }, policy, lib_path);
+#ifndef PLATFORM_WINDOWS
+  else if (isolated)
+  {
+    if (!benchmarker::run_isolated(
+          benchmark,
+          [&]() { run_entry(new_argc, new_argv); },
+          runs,
+          warmup_runs,
+          isolate,
+          lib_path))
+    {
+      LIB_CLOSE(handle);
+      return 1;
+    }
+  }
 #endif
+  else
+    benchmark.run_benchmark(
+      [&]() { run_entry(new_argc, new_argv); }, runs, warmup_runs, lib_path);
   LIB_CLOSE(handle);
+
+  if (json_path == nullptr && baseline_path == nullptr)
+    return 0;
+
+  std::string name = std::filesystem::path(lib_path).stem().string();
+  std::vector<std::string> parameters(new_argv + 1, new_argv + new_argc);
+  std::ostringstream json;
+  benchmarker::write_json(
+    json, benchmark, name, parameters, benchmark.get_warmup_runs());
+
+  if (json_path != nullptr)
+  {
+    std::ofstream file(json_path);
+    if (!file.is_open())
+    {
+      std::cerr << "Error: Could not open file " << json_path
+                << " for writing\n";
+      return 1;
+    }
+    file << json.str();
+  }
+
+  if (baseline_path != nullptr)
+  {
+    std::ifstream file(baseline_path);
+    if (!file.is_open())
+    {
+      std::cerr << "Error: Could not open baseline " << baseline_path << "\n";
+      return 1;
+    }
+    std::stringstream text;
+    text << file.rdbuf();
+
+    auto baseline = benchmarker::parse_json(text.str());
+    auto current = benchmarker::parse_json(json.str());
+    if (!baseline || !current)
+    {
+      std::cerr << "Error: Could not parse " << baseline_path << "\n";
+      return 1;
+    }
+
+    // Exit with 2 on a regression, so gating scripts can tell it apart
+    // from the benchmark failing to run.
+    if (benchmarker::compare_results(
+          *baseline, *current, threshold, alpha, std::cout))
+      return 2;
+  }
   return 0;
 }
\ No newline at end of file
@@ -24,6 +24,14 @@ RegionType string_to_region_type(const std::string& gc_type)
   {
     return RegionType::SemiSpace;
   }
+  else if (gc_type == "generational")
+  {
+    return RegionType::Generational;
+  }
+  else if (gc_type == "compact")
+  {
+    return RegionType::Compact;
+  }
   else
   {
     // Handle invalid input - default to Rc or throw exception
@@ -42,11 +50,125 @@ RegionType parse_region_type(opt::Opt& opt)
     return RegionType::Rc;
   else if (opt.has("--semispace"))
     return RegionType::SemiSpace;
+  else if (opt.has("--generational"))
+    return RegionType::Generational;
+  else if (opt.has("--compact"))
+    return RegionType::Compact;
   else
     std::cout << "Warning: no region specified, defaulting to Trace\n";
   return RegionType::Trace;
 }
 
+// Semispace collector tuning: copy threads (default 1), target occupancy
+// after a collection in percent, a budget for both spaces in bytes
+// (default 0, unlimited), whether spaces are committed on demand,
+// whether survivors are copied in hierarchical order, and whether they are
+// copied incrementally, in slices of how many bytes (--copy-slice, default
+// 64 KiB), for benchmarks that load references through api::load(). Trace
+// collector:
+// whether marks are kept in a side bitmap, whether marking prefetches,
+// whether dead trivial objects are swept lazily, whether marking is
+// incremental, in slices of how many objects (default 4096), whether it
+// happens on a background thread while the region is closed, both only for
+// benchmarks that pass `barrier_stores`, as every store of theirs goes
+// through verona::cpp::store(), and whether objects are kept in size-class
+// pages instead of rings. Arena regions:
+// the size of the first arena in bytes (default 4096), the size arenas stop
+// doubling at (default 1 MiB), and whether arenas of 2 MiB or more are
+// backed by transparent or explicit huge pages, and whether regions can be
+// collected by evacuating sparse arenas (--arena-gc). Arena chunks and
+// semispaces: how many bytes of freed ones each thread keeps for reuse
+// (--chunk-cache, default 0, off), and how many blocks of the collectors'
+// work stacks (--stack-cache, default 0, off). Remembered sets: how many
+// entries the set of a new region is sized for (--rs-capacity, default 0,
+// the smallest table). Rc regions: how many cycle candidates are buffered
+// before region_maybe_collect() collects cycles
+// (--rc-cycle-threshold, default 0, follow the policy), how many one
+// collection examines (--rc-cycle-budget, default 0, all), whether
+// decrefs are deferred until the region is closed (--rc-deferred), how
+// many unreachable objects a decref or close frees (--rc-free-budget,
+// default 0, all of them), and whether counts are kept in the spare bits of
+// the descriptor word (--rc-compact). All collectors: the policy
+// region_maybe_collect() follows, which is to collect every time unless the
+// region must first grow to a percentage of what survived (--gc-growth),
+// grow by a number of bytes (--gc-budget), or grow until a collection would
+// take about a number of microseconds (--gc-pause-target), and whether
+// the policy is also asked each time a region is closed (--gc-on-close).
+// The bytes a region may use before it is collected at its next close or
+// policy check (--region-soft-quota) and before an allocation stops the
+// run (--region-hard-quota), both default 0, unlimited.
+inline void parse_gc_options(opt::Opt& opt, bool barrier_stores = false)
+{
+  bool incremental = opt.has("--incremental-mark");
+  bool concurrent = opt.has("--concurrent-mark");
+  if ((incremental || concurrent) && !barrier_stores)
+  {
+    std::cerr << "--incremental-mark and --concurrent-mark need every field "
+                 "store to go through verona::cpp::store(), which this "
+                 "benchmark does not do\n";
+    abort();
+  }
+
+  GCPolicy policy;
+  if (opt.has("--gc-growth"))
+    policy = GCPolicy::heap_growth(
+      opt.is<size_t>("--gc-growth", GCPolicy::DEFAULT_GROWTH_PERCENT));
+  else if (opt.has("--gc-budget"))
+    policy = GCPolicy::allocation_budget(
+      opt.is<size_t>("--gc-budget", GCPolicy::DEFAULT_ALLOCATION_BUDGET));
+  else if (opt.has("--gc-pause-target"))
+    policy = GCPolicy::pause_target(
+      opt.is<size_t>(
+        "--gc-pause-target", GCPolicy::DEFAULT_PAUSE_TARGET_NS / 1000) *
+      1000);
+  else
+    policy = GCPolicy::always();
+  GCPolicy::set_default(policy.on_close(opt.has("--gc-on-close")));
+  RegionQuota::set_default(
+    {opt.is<size_t>("--region-soft-quota", 0),
+     opt.is<size_t>("--region-hard-quota", 0)});
+  RegionQuota::set_breach_hook([](Object* region, size_t bytes) {
+    std::cerr << "Region " << region << " went over --region-hard-quota "
+              << "allocating " << bytes << " bytes\n";
+    abort();
+  });
+  RegionTrace::set_paged(opt.has("--trace-pages"));
+  RegionTrace::set_mark_bitmap(opt.has("--mark-bitmap"));
+  RegionTrace::set_mark_prefetch(!opt.has("--no-mark-prefetch"));
+  RegionTrace::set_lazy_sweep(opt.has("--lazy-sweep"));
+  RegionTrace::set_incremental_mark(incremental);
+  RegionTrace::set_mark_slice(opt.is<size_t>("--mark-slice", 4096));
+  RegionTrace::set_concurrent_mark(concurrent);
+  RegionSemiSpace::set_virtual_spaces(opt.has("--semispace-vm"));
+  RegionSemiSpace::set_gc_threads(opt.is<size_t>("--gc-threads", 1));
+  RegionSemiSpace::set_target_occupancy(opt.is<size_t>(
+    "--semispace-occupancy", RegionSemiSpace::DEFAULT_TARGET_OCCUPANCY));
+  RegionSemiSpace::set_memory_budget(opt.is<size_t>("--semispace-budget", 0));
+  RegionSemiSpace::set_copy_order(
+    opt.has("--hierarchical-copy") ?
+      RegionSemiSpace::CopyOrder::Hierarchical :
+      RegionSemiSpace::CopyOrder::BreadthFirst);
+  RegionSemiSpace::set_coalesced_copy(!opt.has("--no-coalesced-copy"));
+  RegionSemiSpace::set_incremental_copy(opt.has("--incremental-copy"));
+  RegionSemiSpace::set_copy_slice(opt.is<size_t>(
+    "--copy-slice", RegionSemiSpace::DEFAULT_COPY_SLICE));
+  RegionArena::set_default_chunks(
+    {opt.is<size_t>("--arena-chunk", RegionArena::MIN_CHUNK_SIZE),
+     opt.is<size_t>("--arena-max-chunk", RegionArena::MAX_HEAP_CHUNK_SIZE),
+     opt.has("--explicit-huge-pages") ? pal::HugePages::Explicit :
+       opt.has("--huge-pages")        ? pal::HugePages::Transparent :
+                                        pal::HugePages::None});
+  RegionArena::set_collectable(opt.has("--arena-gc"));
+  ChunkCache::set_capacity(opt.is<size_t>("--chunk-cache", 0));
+  StackBlockCache::set_capacity(opt.is<size_t>("--stack-cache", 0));
+  RememberedSet::set_capacity_hint(opt.is<size_t>("--rs-capacity", 0));
+  RegionRc::set_cycle_threshold(opt.is<size_t>("--rc-cycle-threshold", 0));
+  RegionRc::set_cycle_budget(opt.is<size_t>("--rc-cycle-budget", 0));
+  RegionRc::set_deferred(opt.has("--rc-deferred"));
+  RegionRc::set_free_budget(opt.is<size_t>("--rc-free-budget", 0));
+  RegionRc::set_compact(opt.has("--rc-compact"));
+}
+
 template<typename F, typename... Args>
 decltype(auto) run_with_region(RegionType rt, F&& f, Args&&... args)
 {
@@ -67,6 +189,14 @@ decltype(auto) run_with_region(RegionType rt, F&& f, Args&&... args)
       return f.template operator()<RegionType::SemiSpace>(
         std::forward<Args>(args)...);
 
+    case RegionType::Generational:
+      return f.template operator()<RegionType::Generational>(
+        std::forward<Args>(args)...);
+
+    case RegionType::Compact:
+      return f.template operator()<RegionType::Compact>(
+        std::forward<Args>(args)...);
+
     default:
       throw std::invalid_argument("Unknown RegionType");
   }
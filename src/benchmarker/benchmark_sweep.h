@@ -0,0 +1,260 @@
+#pragma once
+
+#include "benchmark_interleave.h"
+#include "util/gc_benchmark.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace benchmarker
+{
+  /// A benchmark flag and the values a sweep gives it.
+  struct SweepParam
+  {
+    std::string flag;
+    std::vector<std::string> values;
+  };
+
+  /**
+   * The cells of a sweep are every combination of a region type, a value
+   * of each parameter and a core count. An empty list of regions runs the
+   * benchmark with the region flags it is given.
+   */
+  struct SweepGrid
+  {
+    std::vector<size_t> cores;
+    std::vector<size_t> regions;
+    std::vector<SweepParam> params;
+  };
+
+  /// Split a comma separated list.
+  inline std::vector<std::string> split_list(const std::string& arg)
+  {
+    std::vector<std::string> items;
+    size_t start = 0;
+    while (start <= arg.size())
+    {
+      size_t end = std::min(arg.find(',', start), arg.size());
+      if (end > start)
+        items.push_back(arg.substr(start, end - start));
+      start = end + 1;
+    }
+    return items;
+  }
+
+  /**
+   * Parse the argument of --sweep-param: "<flag>=<value>,...". Returns
+   * false if there is no flag or no value.
+   */
+  inline bool parse_sweep_param(const std::string& arg, SweepParam& param)
+  {
+    size_t eq = arg.find('=');
+    if (eq == 0 || eq == std::string::npos)
+      return false;
+    param.flag = arg.substr(0, eq);
+    param.values = split_list(arg.substr(eq + 1));
+    return !param.values.empty();
+  }
+
+  /// The median of `values`, which must not be empty.
+  inline double median(std::vector<double> values)
+  {
+    std::sort(values.begin(), values.end());
+    size_t n = values.size();
+    return n % 2 == 1 ? values[n / 2] :
+                        (values[n / 2 - 1] + values[n / 2]) / 2;
+  }
+
+  /**
+   * Run the benchmark in every cell of `grid`, `runs` times each after
+   * `warmup_runs` unmeasured runs, and write the results as a long-format
+   * CSV to sweep/sweep.csv: one row per cell, trial and metric, with a
+   * column for the region type, the core count and each parameter.
+   *
+   * `run_entry` runs the benchmark with the arguments it is given, on
+   * `cores` scheduler threads. A cell's arguments are `args` with the
+   * cell's region flag in place of any other, and each parameter's flag
+   * and value in place of any the flag already had. Before each measured
+   * run, `run_empty` starts and stops the scheduler with nothing to run,
+   * and its time is recorded as pool_startup_ns, so the fixed cost of the
+   * thread pool can be told apart from the benchmark's own scaling.
+   *
+   * The median run time of each cell is compared against the cell with
+   * the fewest cores and the same region and parameters: speedup is the
+   * ratio of the two, and efficiency is speedup over the ratio of their
+   * core counts. These are written with an empty trial column, and
+   * printed.
+   */
+  inline void run_sweep(
+    const std::function<void(int, char**)>& run_entry,
+    const std::function<void()>& run_empty,
+    size_t& cores,
+    const std::vector<std::string>& args,
+    const SweepGrid& grid,
+    size_t runs,
+    size_t warmup_runs,
+    const char* lib_path)
+  {
+    using verona::rt::api::GCBenchmark;
+    using Clock = std::chrono::steady_clock;
+
+    std::string name = GCBenchmark::summary_name(lib_path);
+    auto dir = GCBenchmark::csv_directory(name) / "sweep";
+    std::filesystem::create_directories(dir);
+    auto path = dir / "sweep.csv";
+    std::ofstream file(path);
+    if (!file.is_open())
+    {
+      std::cerr << "Error: Could not open file " << path.string()
+                << " for writing\n";
+      return;
+    }
+
+    file << "benchmark,region,cores";
+    for (const auto& p : grid.params)
+      file << "," << p.flag.substr(p.flag.find_first_not_of('-'));
+    file << ",trial,metric,value\n";
+
+    std::vector<size_t> core_counts = grid.cores;
+    std::sort(core_counts.begin(), core_counts.end());
+    std::vector<long> regions(grid.regions.begin(), grid.regions.end());
+    if (regions.empty())
+      regions.push_back(-1);
+
+    warm_allocator();
+
+    // The index of each parameter's value in the current cell.
+    std::vector<size_t> choice(grid.params.size(), 0);
+    for (long region : regions)
+    {
+      const char* region_name = region < 0 ? "default" : REGION_NAMES[region];
+      bool more = true;
+      while (more)
+      {
+        std::vector<std::string> cell_args;
+        for (size_t i = 0; i < args.size(); i++)
+        {
+          auto param = std::find_if(
+            grid.params.begin(), grid.params.end(), [&](const SweepParam& p) {
+              return p.flag == args[i];
+            });
+          if (param != grid.params.end())
+            i++;
+          else if (region < 0 || !is_region_flag(args[i]))
+            cell_args.push_back(args[i]);
+        }
+        if (region >= 0)
+          cell_args.push_back(std::string("--") + region_name);
+        std::string key = name + "," + region_name;
+        std::string label = std::string("[") + region_name;
+        for (size_t p = 0; p < grid.params.size(); p++)
+        {
+          const std::string& value = grid.params[p].values[choice[p]];
+          cell_args.push_back(grid.params[p].flag);
+          cell_args.push_back(value);
+          label += " " + grid.params[p].flag + "=" + value;
+        }
+        label += "]";
+        std::vector<char*> cell_argv;
+        for (auto& a : cell_args)
+          cell_argv.push_back(a.data());
+        cell_argv.push_back(nullptr);
+        auto test_fn = [&]() {
+          run_entry((int)cell_args.size(), cell_argv.data());
+        };
+
+        // Median run time of each core count, for speedup.
+        std::map<size_t, double> medians;
+        std::string columns;
+        for (size_t p = 0; p < grid.params.size(); p++)
+          columns += "," + grid.params[p].values[choice[p]];
+
+        for (size_t c : core_counts)
+        {
+          cores = c;
+          std::cout << "\n=== Sweep " << label << " cores=" << c << " ===\n";
+
+          GCBenchmark benchmark;
+          for (size_t w = 0; w < warmup_runs; w++)
+            benchmark.warmup_run(test_fn);
+
+          std::vector<double> run_times;
+          for (size_t run = 0; run < runs; run++)
+          {
+            auto start = Clock::now();
+            run_empty();
+            auto startup_ns =
+              std::chrono::duration_cast<std::chrono::nanoseconds>(
+                Clock::now() - start)
+                .count();
+
+            benchmark.measure_run(test_fn);
+            const auto& r = benchmark.get_results().back();
+            run_times.push_back((double)r.total_run_time_ns);
+
+            std::string prefix = key + "," + std::to_string(c) + columns +
+              "," + std::to_string(run) + ",";
+            file << prefix << "run_time_ns," << r.total_run_time_ns << "\n"
+                 << prefix << "gc_time_ns," << r.total_gc_time_ns << "\n"
+                 << prefix << "gc_calls," << r.gc_call_count << "\n"
+                 << prefix << "p99_gc_ns," << r.p99_gc_time_ns << "\n"
+                 << prefix << "max_gc_ns," << r.max_gc_time_ns << "\n"
+                 << prefix << "peak_mem_bytes," << r.peak_memory_bytes << "\n"
+                 << prefix << "rss_peak_bytes," << r.process_memory.peak_rss
+                 << "\n"
+                 << prefix << "pool_startup_ns," << startup_ns << "\n";
+          }
+          if (!run_times.empty())
+            medians[c] = median(run_times);
+        }
+
+        if (!medians.empty())
+        {
+          auto [base_cores, base_ns] = *medians.begin();
+          std::cout << "\n=== Scaling " << label << " ===\n"
+                    << std::setw(7) << "cores" << std::setw(16)
+                    << "median_ns" << std::setw(10) << "speedup"
+                    << std::setw(12) << "efficiency" << "\n";
+          for (auto [c, ns] : medians)
+          {
+            double speedup = ns == 0 ? 0 : base_ns / ns;
+            double efficiency = speedup * (double)base_cores / (double)c;
+            std::string prefix = key + "," + std::to_string(c) + columns + ",,";
+            file << prefix << "median_run_time_ns," << std::fixed
+                 << std::setprecision(0) << ns << "\n"
+                 << prefix << "speedup," << std::setprecision(4) << speedup
+                 << "\n"
+                 << prefix << "efficiency," << efficiency << "\n"
+                 << std::defaultfloat;
+            std::cout << std::setw(7) << c << std::setw(16) << std::fixed
+                      << std::setprecision(0) << ns << std::setprecision(2)
+                      << std::setw(10) << speedup << std::setw(12)
+                      << efficiency << std::defaultfloat << "\n";
+          }
+        }
+
+        // The next combination of parameter values, or done.
+        more = false;
+        for (size_t p = grid.params.size(); p-- > 0;)
+        {
+          if (++choice[p] < grid.params[p].values.size())
+          {
+            more = true;
+            break;
+          }
+          choice[p] = 0;
+        }
+      }
+    }
+
+    std::cout << "Sweep results written to " << path.string() << "\n";
+  }
+} // namespace benchmarker
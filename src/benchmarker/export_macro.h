@@ -13,11 +13,9 @@
 #  define BENCHMARK_WINDOWS_CALLBACK_BRIDGE() \
     using namespace verona::rt::api::internal; \
     extern "C" BENCHMARK_EXPORT void set_gc_callback( \
-      void (*callback)(uint64_t, verona::rt::RegionType, size_t, size_t)) \
+      void (*callback)(const verona::rt::GCEvent&)) \
     { \
-      static std::function<void( \
-        uint64_t, verona::rt::RegionType, size_t, size_t)> \
-        func; \
+      static std::function<void(const verona::rt::GCEvent&)> func; \
       if (callback) \
       { \
         func = callback; \
@@ -4,7 +4,9 @@
 
 #include "../ds/stackarray.h"
 #include "../object/object.h"
+#include "behaviourpool.h"
 #include "cown.h"
+#include "fusion.h"
 
 #include <snmalloc/snmalloc.h>
 
@@ -464,6 +466,9 @@ namespace verona::rt
     friend Slot;
     std::atomic<size_t> exec_count_down;
     size_t count;
+    Priority priority = Priority::High;
+    /// Size of the allocation holding the behaviour, see make().
+    uint32_t size = 0;
 
     /**
      * @brief Construct a new Behaviour object
@@ -486,27 +491,89 @@ namespace verona::rt
                 << b.exec_count_down.load(std::memory_order_acquire) << " ";
     }
 public:
+    /// Largest set of cowns schedule_many() has a specialised path for.
+    static constexpr size_t SMALL_COWNS = 3;
+
+    /// Smallest set of cowns schedule_many() radix sorts.
+    static constexpr size_t RADIX_SORT_COWNS = 256;
+
     Work* as_work()
     {
       return pointer_offset_signed<Work>(
         this, -static_cast<ptrdiff_t>(sizeof(Work)));
     }
+
+    /**
+     * Set the class of queue the behaviour goes to once it is runnable.
+     * Must be called before it is scheduled.
+     */
+    void set_priority(Priority p)
+    {
+      priority = p;
+    }
+
+    Priority get_priority() const
+    {
+      return priority;
+    }
 private:
     /**
-     * Remove `n` from the exec_count_down.
+     * The home core of the first cown, if the scheduler is sticky.
      */
-    void resolve(size_t n = 1, bool fifo = true)
+    Core* home()
+    {
+      if (!Scheduler::is_sticky() || (count == 0))
+        return nullptr;
+      return get_slots()[0].cown()->get_home();
+    }
+
+    /**
+     * Remove `n` from the exec_count_down, and return whether that leaves
+     * the behaviour runnable, for the caller to schedule.
+     */
+    bool count_down(size_t n = 1)
     {
       Logging::cout() << "Behaviour::resolve " << n << " for behaviour "
                       << *this << Logging::endl;
       // Note that we don't actually perform the last decrement as it is not
       // required.
-      if (
-        (exec_count_down.load(std::memory_order_acquire) == n) ||
-        (exec_count_down.fetch_sub(n) == n))
+      return (exec_count_down.load(std::memory_order_acquire) == n) ||
+        (exec_count_down.fetch_sub(n) == n);
+    }
+
+    /**
+     * Remove `n` from the exec_count_down, and schedule the behaviour if
+     * it is now runnable.
+     */
+    void resolve(size_t n = 1, bool fifo = true)
+    {
+      if (count_down(n))
       {
         Logging::cout() << "Scheduling Behaviour " << *this << Logging::endl;
-        Scheduler::schedule(as_work(), fifo);
+        if (priority == Priority::Low)
+          Scheduler::schedule_low(as_work());
+        else
+          Scheduler::schedule(as_work(), fifo, home());
+      }
+    }
+
+    /**
+     * Remove one from the exec_count_down, as the behaviour that has just
+     * run released a cown to this one, and if it is now runnable, hand it
+     * to this thread (see ThreadPool::schedule_handoff()).
+     */
+    void resolve_released()
+    {
+      if (priority == Priority::Low)
+      {
+        resolve();
+        return;
+      }
+
+      if (count_down())
+      {
+        Logging::cout() << "Handing off Behaviour " << *this << Logging::endl;
+        Scheduler::schedule_handoff(as_work(), home());
       }
     }
 
@@ -535,7 +602,7 @@ private:
                         << cown << Logging::endl;
         // Release transfer - required times, we needed one as we woke up
         // the cown, but the rest were not required.
-        for (int j = 0; j < transfer - required; j++)
+        for (size_t j = 0; j < transfer - required; j++)
           Cown::release(cown);
         return;
       }
@@ -544,7 +611,7 @@ private:
                       << transfer << " required: " << required << " on cown "
                       << cown << Logging::endl;
       // We didn't have enough RCs passed in, so we need to acquire the rest.
-      for (int j = 0; j < required - transfer; j++)
+      for (size_t j = 0; j < required - transfer; j++)
         Cown::acquire(cown);
     }
 
@@ -657,13 +724,125 @@ private:
     {
       auto behaviour = BehaviourCore::from_work(work);
       Logging::cout() << "Finished Behaviour " << *behaviour << Logging::endl;
+      // The first cown's data is now in this core's cache.
+      if (Scheduler::is_sticky() && (behaviour->count != 0))
+        behaviour->get_slots()[0].cown()->set_home(Scheduler::current_core());
       behaviour->release_all();
       if (!reuse)
-        heap::dealloc(work);
+        BehaviourPool::dealloc(work, behaviour->size);
       else
         behaviour->reset();
     }
 
+    /// The outcomes of acquire_inline().
+    enum class InlineAcquire
+    {
+      /// The cown is held through the slot. Run, then release_inline().
+      Acquired,
+      /// The cown is busy, and nothing has changed.
+      Busy,
+      /// The slot is queued on the cown, but readers that came before it
+      /// have not finished. Pass a behaviour to take over to queue_inline().
+      Queued
+    };
+
+    /**
+     * Try to take the cown of `slot`, a writer slot on the caller's stack,
+     * without a behaviour, so that the caller can use the cown at once. This
+     * only gets past a cheap check if the cown has an empty queue and no
+     * readers.
+     */
+    static InlineAcquire acquire_inline(Slot* slot)
+    {
+      Cown* cown = slot->cown();
+      if (
+        (cown->last_slot.load(std::memory_order_relaxed) != nullptr) ||
+        (cown->read_ref_count.get_count() != 0))
+        return InlineAcquire::Busy;
+
+      Slot* empty = nullptr;
+      if (!cown->last_slot.compare_exchange_strong(
+            empty, slot, std::memory_order_seq_cst))
+        return InlineAcquire::Busy;
+
+      yield();
+      // The reference count for the chain, as in schedule_many().
+      Cown::acquire(cown);
+
+      // A reader whose chain ended before the exchange may still be running.
+      // Any later one is queued behind the slot, so none can start now.
+      if (cown->read_ref_count.get_count() != 0)
+        return InlineAcquire::Queued;
+
+      Logging::cout() << "Acquired inline " << *slot << Logging::endl;
+      slot->set_ready();
+      return InlineAcquire::Acquired;
+    }
+
+    /**
+     * Release the cown of `slot` after acquire_inline() acquired it.
+     */
+    static void release_inline(Slot* slot)
+    {
+      if (Scheduler::is_sticky())
+        slot->cown()->set_home(Scheduler::current_core());
+      slot->release();
+    }
+
+    /**
+     * After acquire_inline() queued `slot`, put `b`, a writer of the same
+     * cown and of nothing else, in its place, to run once the readers before
+     * it have finished. `slot` is not used after this returns.
+     */
+    static void queue_inline(Slot* slot, BehaviourCore* b)
+    {
+      Cown* cown = slot->cown();
+      Slot* bslot = b->get_slots();
+      assert(b->count == 1);
+      assert((bslot->cown() == cown) && !bslot->is_read_only());
+
+      // The reference count of the chain is already held.
+      if (bslot->take_move() != 0)
+        Cown::release(cown);
+
+      Slot* expected = slot;
+      if (cown->last_slot.compare_exchange_strong(
+            expected, bslot, std::memory_order_seq_cst))
+      {
+        bslot->set_ready();
+      }
+      else
+      {
+        // Something has queued behind `slot`. Let it link to `slot`, and
+        // then pass the link on to `b`.
+        slot->set_ready();
+        while (slot->no_successor_response())
+        {
+          Systematic::yield_until(
+            [slot]() { return !slot->no_successor_response(); });
+          Aal::pause();
+        }
+        bslot->status.store(
+          slot->status.load(std::memory_order_acquire),
+          std::memory_order_release);
+      }
+
+      yield();
+      bool last_reader = false;
+      if (cown->read_ref_count.try_write(&last_reader))
+      {
+        if (last_reader)
+          shared::release(cown);
+        b->resolve(2);
+        return;
+      }
+
+      Logging::cout() << " Inline writer waiting for previous readers "
+                      << *bslot << Logging::endl;
+      cown->next_writer = b;
+      b->resolve();
+    }
+
     /**
      * @brief Deallocate the behaviour.
      *
@@ -675,7 +854,7 @@ private:
     void dealloc()
     {
       Logging::cout() << "Deallocating Behaviour " << *this << Logging::endl;
-      heap::dealloc(as_work());
+      BehaviourPool::dealloc(as_work(), size);
     }
 
     /**
@@ -736,11 +915,12 @@ private:
       //   | Work | Behaviour | Slot ... Slot | Body |
       size_t size =
         sizeof(Work) + sizeof(BehaviourCore) + (sizeof(Slot) * count) + payload;
-      void* base = heap::alloc(size);
+      void* base = BehaviourPool::alloc(size);
 
       Work* work = new (base) Work(f);
       void* base_behaviour = from_work(work);
       BehaviourCore* behaviour = new (base_behaviour) BehaviourCore(count);
+      behaviour->size = static_cast<uint32_t>(size);
 
       // These assertions are basically checking that we won't break any
       // alignment assumptions on Be.  If we add some actual alignment, then
@@ -758,6 +938,78 @@ private:
       return behaviour;
     }
 
+    /**
+     * Key a request is sorted on its cown by. Systematic testing uses the
+     * id, so that the order is the same on every run.
+     */
+    static uintptr_t sort_key(Slot* slot)
+    {
+#ifdef USE_SYSTEMATIC_TESTING
+      return slot->cown()->id();
+#else
+      return reinterpret_cast<uintptr_t>(slot->cown());
+#endif
+    }
+
+    /**
+     * Sort `count` requests into the order schedule_many acquires them in:
+     * by cown, then behaviour, with writers before readers within a
+     * behaviour. This is a stable LSD radix sort, one byte per pass, that
+     * sorts by the least significant of those keys first, and skips any
+     * pass whose byte is the same for every request, so large dynamic cown
+     * sets are sorted in a few linear passes instead of by comparison.
+     */
+    static void radix_sort_requests(
+      std::tuple<size_t, Slot*>* map, size_t count, size_t body_count)
+    {
+      StackArray<std::tuple<size_t, Slot*>> buffer(count);
+      auto* src = map;
+      auto* dst = buffer.get();
+
+      auto pass = [&](auto key, size_t shift) {
+        size_t offsets[256] = {};
+        for (size_t i = 0; i < count; i++)
+          offsets[(key(src[i]) >> shift) & 0xff]++;
+
+        size_t total = 0;
+        for (auto& o : offsets)
+        {
+          if (o == count)
+            return;
+          size_t c = o;
+          o = total;
+          total += c;
+        }
+
+        for (size_t i = 0; i < count; i++)
+          dst[offsets[(key(src[i]) >> shift) & 0xff]++] = src[i];
+        std::swap(src, dst);
+      };
+
+      pass(
+        [](const std::tuple<size_t, Slot*>& r) {
+          return uintptr_t(std::get<1>(r)->is_read_only() ? 1 : 0);
+        },
+        0);
+
+      for (size_t shift = 0; ((body_count - 1) >> shift) != 0; shift += 8)
+        pass(
+          [](const std::tuple<size_t, Slot*>& r) {
+            return uintptr_t(std::get<0>(r));
+          },
+          shift);
+
+      for (size_t shift = 0; shift < sizeof(uintptr_t) * 8; shift += 8)
+        pass(
+          [](const std::tuple<size_t, Slot*>& r) {
+            return sort_key(std::get<1>(r));
+          },
+          shift);
+
+      if (src != map)
+        std::copy(src, src + count, map);
+    }
+
     /**
      *  @brief Atomically schedule a collection of behaviours for
      * execution.
@@ -767,7 +1019,13 @@ private:
      *
      * @note This adds the behaviours to the dependency graph, and handles all
      * the process of waking up the work and adding to the underlying scheduler.
+     *
+     * @tparam Cowns The number of cowns the behaviours request together, if
+     * the caller knows it statically and it is at most SMALL_COWNS, or 0.
+     * This sizes the scratch arrays to fit, instead of reserving room for
+     * many cowns on every call.
      */
+    template<size_t Cowns = 0>
     static void schedule_many(BehaviourCore** bodies, size_t body_count)
     {
       /* IMPLEMENTATION NOTE
@@ -867,6 +1125,10 @@ private:
       Logging::cout() << "BehaviourCore::schedule_many" << body_count
                       << Logging::endl;
 
+      // Closures appended later to a fusion this thread has open must not
+      // overtake these behaviours (see Fusion).
+      Fusion::close_local();
+
       // non-unique cowns count
       size_t cown_count = 0;
       for (size_t i = 0; i < body_count; i++)
@@ -887,8 +1149,12 @@ private:
       // cowns We first construct an array that represents pairs of behaviour
       // number and slot pointer. Note: Really want a dynamically sized stack
       // allocation here.
-      StackArray<std::tuple<size_t, Slot*>> cown_to_behaviour_slot_map(
-        cown_count);
+      static_assert(Cowns <= SMALL_COWNS, "Use Cowns only for small sets");
+      constexpr size_t inline_cowns = Cowns == 0 ? 128 : Cowns;
+      assert((Cowns == 0) || (cown_count == Cowns));
+
+      StackArray<std::tuple<size_t, Slot*>, inline_cowns>
+        cown_to_behaviour_slot_map(cown_count);
       size_t idx = 0;
       for (size_t i = 0; i < body_count; i++)
       {
@@ -948,11 +1214,25 @@ private:
           return std::get<1>(i)->cown() < std::get<1>(j)->cown();
 #endif
       };
-      if (cown_count > 1)
-        std::sort(
-          cown_to_behaviour_slot_map.get(),
-          cown_to_behaviour_slot_map.get() + cown_count,
-          compare);
+      // Sets of up to three cowns, which are most of them, are sorted with a
+      // sorting network rather than std::sort.
+      auto* map = cown_to_behaviour_slot_map.get();
+      auto compare_swap = [map, &compare](size_t a, size_t b) {
+        if (compare(map[b], map[a]))
+          std::swap(map[a], map[b]);
+      };
+      if (cown_count >= RADIX_SORT_COWNS)
+        radix_sort_requests(map, cown_count, body_count);
+      else if (cown_count > SMALL_COWNS)
+        std::sort(map, map + cown_count, compare);
+      else if (cown_count == 2)
+        compare_swap(0, 1);
+      else if (cown_count == 3)
+      {
+        compare_swap(0, 1);
+        compare_swap(1, 2);
+        compare_swap(0, 1);
+      }
 
       // Helper struct to be used after building the chains in the next phases
       struct ChainInfo
@@ -970,7 +1250,7 @@ private:
       };
       size_t i = 0;
       size_t chain_count = 0;
-      StackArray<ChainInfo> chain_info(cown_count);
+      StackArray<ChainInfo, inline_cowns> chain_info(cown_count);
 
       while (i < cown_count)
       {
@@ -1190,10 +1470,15 @@ private:
         {
           if (!chain_first_slot->is_read_only())
           {
-            if (cown->read_ref_count.try_write())
+            bool last_reader = false;
+            if (cown->read_ref_count.try_write(&last_reader))
             {
               Logging::cout() << " Writer at head of queue and got the cown "
                               << *chain_first_slot << Logging::endl;
+              // Release the reference count of readers that finished
+              // without noticing they were the last.
+              if (last_reader)
+                shared::release(cown);
               // Process execution count
               ec[first_body_index] += 1;
               yield();
@@ -1222,7 +1507,7 @@ private:
         // This part is only for chains that start with a read-only behaviour
         if (read_only_can_run)
         {
-          for (int i = 0; i < first_consecutive_readers_count; i++)
+          for (size_t i = 0; i < first_consecutive_readers_count; i++)
             ec[first_body_index + i] += 1;
         }
       }
@@ -1263,7 +1548,7 @@ private:
   {
     assert(is_read_only());
 
-    auto status = cown()->read_ref_count.release_read();
+    auto status = cown()->read_ref_count.release_read(cown()->last_slot);
     if (status != ReadRefCount::NOT_LAST)
     {
       if (status == ReadRefCount::LAST_READER_WAITING_WRITER)
@@ -1303,8 +1588,11 @@ private:
     {
       Logging::cout() << "No successor, so releasing the cown" << Logging::endl;
       auto slot_addr = this;
+      // Sequentially consistent, so that a reader of a read-mostly cown
+      // that finishes now either sees the queue empty or is folded in by
+      // our drop_read() (see ReadRefCount::release_read()).
       if (cown()->last_slot.compare_exchange_strong(
-            slot_addr, nullptr, std::memory_order_acq_rel))
+            slot_addr, nullptr, std::memory_order_seq_cst))
       {
         yield();
 
@@ -1341,7 +1629,7 @@ private:
     {
       Logging::cout() << "Writer waking up next writer cown next slot "
                       << *next_behaviour() << Logging::endl;
-      next_behaviour()->resolve();
+      next_behaviour()->resolve_released();
       return;
     }
 
@@ -1404,14 +1692,43 @@ private:
       yield();
     }
 
+    // The readers that become runnable are gathered, and spread across the
+    // cores in one go, rather than scheduled one at a time.
+    static constexpr size_t READER_BATCH = 64;
+    Work* runnable[READER_BATCH];
+    size_t runnable_count = 0;
+    auto wake = [&runnable, &runnable_count](BehaviourCore* b) {
+      if (!b->count_down())
+        return;
+
+      Logging::cout() << "Scheduling Behaviour " << *b << Logging::endl;
+      if (b->get_priority() == Priority::Low)
+      {
+        Scheduler::schedule_low(b->as_work());
+        return;
+      }
+
+      runnable[runnable_count++] = b->as_work();
+      if (runnable_count == READER_BATCH)
+      {
+        Scheduler::schedule_spread(runnable, runnable_count);
+        runnable_count = 0;
+      }
+    };
+
     auto last_slot = curr_slot;
     curr_slot = next_slot();
     while (curr_slot != last_slot)
     {
       auto next = curr_slot->next_slot();
-      curr_slot->get_behaviour()->resolve(1, false);
+      wake(curr_slot->get_behaviour());
       curr_slot = next;
     }
-    last_slot->get_behaviour()->resolve(1, false);
+    wake(last_slot->get_behaviour());
+
+    if (runnable_count == 1)
+      Scheduler::schedule(runnable[0], false);
+    else if (runnable_count > 1)
+      Scheduler::schedule_spread(runnable, runnable_count);
   }
 } // namespace verona::rt
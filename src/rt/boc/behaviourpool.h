@@ -0,0 +1,21 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "../ds/sizedpool.h"
+
+namespace verona::rt
+{
+  /**
+   * A per-thread pool of freed behaviours, so that the thread that runs a
+   * behaviour keeps its memory for the next `when` it creates, instead of
+   * sending it back to the allocator of the thread that created it, which
+   * is usually another one.
+   *
+   * The size of a behaviour is set by the number of cowns and the size of
+   * the closure, so a behaviour is only reused for another of the same
+   * shape. Off unless set_capacity() is called (see SizedPool).
+   **/
+  class BehaviourPool : public SizedPool<BehaviourPool>
+  {};
+} // namespace verona::rt
@@ -0,0 +1,221 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <snmalloc/snmalloc.h>
+#include <string>
+#include <typeinfo>
+#include <vector>
+#ifndef _MSC_VER
+#  include <cxxabi.h>
+#endif
+
+namespace verona::rt
+{
+  /**
+   * Accounts the time behaviours take to their call sites, which a sampling
+   * profiler cannot tell apart as they all run through the same function
+   * pointer.
+   *
+   * A site is the type of a behaviour's closure, so each `when` in the
+   * source is its own site. For each site the profile counts the
+   * behaviours that ran, the ticks they ran for, and the ticks from the
+   * `when` that created each to it starting, which is the time it queued
+   * for its cowns and for a scheduler thread. Each thread adds to a table
+   * of its own without synchronisation, and dump() merges the tables.
+   *
+   * Off unless set_enabled(true) is called, in which case behaviours
+   * created from then on are profiled, at the cost of two reads of the
+   * tick counter and a word of memory each. Behaviours with no cowns run as
+   * closures and are not profiled.
+   */
+  class BehaviourProfile
+  {
+  public:
+    /// Sites a profile tells apart; later sites are counted as the last.
+    static constexpr size_t MAX_SITES = 512;
+
+  private:
+    struct Entry
+    {
+      // Written only by the table's thread, and read by dump().
+      std::atomic<uint64_t> count{0};
+      std::atomic<uint64_t> ticks{0};
+      std::atomic<uint64_t> queue_ticks{0};
+    };
+
+    struct Table
+    {
+      Entry entries[MAX_SITES];
+    };
+
+    struct State
+    {
+      std::mutex lock;
+      /// Name of each site, by id.
+      std::vector<std::string> sites;
+      /// Kept after their thread exits, so that dump() still counts them.
+      std::vector<std::unique_ptr<Table>> tables;
+    };
+
+    static inline std::atomic<bool> enabled_{false};
+
+    static State& state()
+    {
+      static State s;
+      return s;
+    }
+
+    static Table& local()
+    {
+      static thread_local Table* table = nullptr;
+      if (table == nullptr)
+      {
+        auto& s = state();
+        std::lock_guard<std::mutex> lock(s.lock);
+        s.tables.push_back(std::make_unique<Table>());
+        table = s.tables.back().get();
+      }
+      return *table;
+    }
+
+    static size_t register_site(const char* mangled)
+    {
+      std::string name = mangled;
+#ifndef _MSC_VER
+      int status = 0;
+      char* demangled = abi::__cxa_demangle(mangled, nullptr, nullptr, &status);
+      if (status == 0 && demangled != nullptr)
+        name = demangled;
+      free(demangled);
+#endif
+      auto& s = state();
+      std::lock_guard<std::mutex> lock(s.lock);
+      s.sites.push_back(std::move(name));
+      return std::min(s.sites.size() - 1, MAX_SITES - 1);
+    }
+
+    static void add(std::atomic<uint64_t>& a, uint64_t n)
+    {
+      a.store(a.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+  public:
+    static void set_enabled(bool on)
+    {
+      enabled_.store(on, std::memory_order_relaxed);
+    }
+
+    static bool is_enabled()
+    {
+      return enabled_.load(std::memory_order_relaxed);
+    }
+
+    /// The id of the site of behaviours whose closure is a `Be`.
+    template<typename Be>
+    static size_t site()
+    {
+      static const size_t id = register_site(typeid(Be).name());
+      return id;
+    }
+
+    static uint64_t tick()
+    {
+      return snmalloc::Aal::tick();
+    }
+
+    /// Account a behaviour of `site` created at tick `created`, that ran
+    /// from `start` to `end`.
+    static void
+    record(size_t site, uint64_t created, uint64_t start, uint64_t end)
+    {
+      Entry& e = local().entries[site];
+      add(e.count, 1);
+      add(e.ticks, end - start);
+      add(e.queue_ticks, start - created);
+    }
+
+    /// Forget everything profiled so far, but not the sites.
+    static void reset()
+    {
+      auto& s = state();
+      std::lock_guard<std::mutex> lock(s.lock);
+      for (auto& t : s.tables)
+      {
+        for (Entry& e : t->entries)
+        {
+          e.count.store(0, std::memory_order_relaxed);
+          e.ticks.store(0, std::memory_order_relaxed);
+          e.queue_ticks.store(0, std::memory_order_relaxed);
+        }
+      }
+    }
+
+    /**
+     * Print every site that ran, most ticks first: its behaviours, their
+     * share of all the ticks behaviours ran for, the total and mean ticks
+     * they ran for, and the mean ticks they queued for.
+     */
+    static void dump(std::ostream& out)
+    {
+      struct Row
+      {
+        size_t site;
+        uint64_t count = 0;
+        uint64_t ticks = 0;
+        uint64_t queue_ticks = 0;
+      };
+
+      auto& s = state();
+      std::lock_guard<std::mutex> lock(s.lock);
+      std::vector<Row> rows;
+      uint64_t total = 0;
+      for (size_t i = 0; i < std::min(s.sites.size(), MAX_SITES); i++)
+      {
+        Row r{i};
+        for (auto& t : s.tables)
+        {
+          Entry& e = t->entries[i];
+          r.count += e.count.load(std::memory_order_relaxed);
+          r.ticks += e.ticks.load(std::memory_order_relaxed);
+          r.queue_ticks += e.queue_ticks.load(std::memory_order_relaxed);
+        }
+        if (r.count == 0)
+          continue;
+        total += r.ticks;
+        rows.push_back(r);
+      }
+      std::sort(rows.begin(), rows.end(), [](const Row& a, const Row& b) {
+        return a.ticks > b.ticks;
+      });
+
+      out << "Behaviour profile (" << rows.size() << " sites)\n"
+          << std::setw(12) << "count" << std::setw(8) << "share"
+          << std::setw(16) << "ticks" << std::setw(12) << "mean"
+          << std::setw(12) << "queued"
+          << "  site\n";
+      for (const Row& r : rows)
+      {
+        out << std::setw(12) << r.count << std::setw(7) << std::fixed
+            << std::setprecision(1)
+            << (total == 0 ? 0.0 : 100.0 * (double)r.ticks / (double)total)
+            << "%" << std::defaultfloat << std::setw(16) << r.ticks
+            << std::setw(12) << r.ticks / r.count << std::setw(12)
+            << r.queue_ticks / r.count << "  "
+            << (r.site == MAX_SITES - 1 && s.sites.size() > MAX_SITES ?
+                  "(other sites)" :
+                  s.sites[r.site])
+            << "\n";
+      }
+    }
+  };
+} // namespace verona::rt
@@ -0,0 +1,57 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include <atomic>
+
+namespace verona::rt
+{
+  class Shared;
+
+  /**
+   * The per-thread state of biased reference counting (see Shared): whether
+   * objects made on this thread may be biased towards it, and the objects
+   * that are. It is kept apart from Shared so that the scheduler threads,
+   * which turn it on and give up their biases, do not depend on Shared.
+   */
+  class Bias
+  {
+    friend class Shared;
+
+    static inline thread_local bool here = false;
+
+    /// Objects biased towards this thread, linked through Shared::bias_next.
+    static inline thread_local Shared* biased = nullptr;
+
+    /// Gives up the bias of an object, set by Shared before it biases one.
+    static inline std::atomic<void (*)(Shared*)> unbias{nullptr};
+
+  public:
+    /**
+     * Whether Shared objects made on this thread from now on may be biased
+     * towards it. Only scheduler threads set this, as they give up the bias
+     * of everything they made whenever they run out of work and before they
+     * stop, and other threads may never do either.
+     */
+    static void set_here(bool enable)
+    {
+      here = enable;
+    }
+
+    /**
+     * Give up the bias of every object still biased towards this thread.
+     * Returns whether there were any.
+     */
+    static bool unbias_all()
+    {
+      if (biased == nullptr)
+        return false;
+
+      // Releasing one object may unbias others, so take the head each time.
+      auto f = unbias.load(std::memory_order_relaxed);
+      while (biased != nullptr)
+        f(biased);
+      return true;
+    }
+  };
+} // namespace verona::rt
@@ -5,6 +5,7 @@
 #include "../debug/logging.h"
 #include "../debug/systematic.h"
 #include "../ds/forward_list.h"
+#include "../pal/cache_line.h"
 #include "../region/region.h"
 #include "base_noticeboard.h"
 #include "shared.h"
@@ -43,6 +44,8 @@ namespace verona::rt
    * read more before a write).
    */
 
+  class Slot;
+
   struct ReadRefCount
   {
     enum STATUS
@@ -52,6 +55,9 @@ namespace verona::rt
       NOT_LAST
     };
 
+    /// Number of cache lines the departures of a read-mostly cown use.
+    static constexpr size_t STRIPES = 8;
+
   private:
     /**
      * Even numbers 2n, signify n readers are reading the cown.
@@ -60,7 +66,79 @@ namespace verona::rt
      */
     std::atomic<size_t> count{0};
 
+    struct alignas(CACHE_LINE) Stripe
+    {
+      std::atomic<size_t> departed{0};
+    };
+
+    /**
+     * For a read-mostly cown, readers that have finished but are still in
+     * `count`, spread over cache lines so that readers on different cores
+     * finish without sharing one. Folded into `count` once a writer is
+     * waiting or the cown's queue is empty. Otherwise nullptr.
+     */
+    Stripe* stripes = nullptr;
+
+    static size_t local_stripe()
+    {
+      static std::atomic<size_t> next{0};
+      static thread_local size_t stripe =
+        next.fetch_add(1, std::memory_order_relaxed) % STRIPES;
+      return stripe;
+    }
+
+    /**
+     * Take the finished readers recorded in the stripes out of `count`,
+     * and report whether that removed the last reader.
+     */
+    STATUS fold()
+    {
+      size_t departed = 0;
+      for (size_t i = 0; i < STRIPES; i++)
+        departed += stripes[i].departed.exchange(0, std::memory_order_seq_cst);
+
+      if (departed == 0)
+        return NOT_LAST;
+
+      auto old = count.fetch_sub(departed * 2, std::memory_order_seq_cst);
+      if (old > (departed * 2) + 1)
+        return NOT_LAST;
+      if (old == departed * 2)
+        return LAST_READER;
+
+      assert(old == (departed * 2) + 1);
+      Systematic::yield();
+      assert(count.load() == 1);
+      count.store(0, std::memory_order_relaxed);
+      return LAST_READER_WAITING_WRITER;
+    }
+
   public:
+    ReadRefCount() = default;
+    ReadRefCount(const ReadRefCount&) = delete;
+
+    ~ReadRefCount()
+    {
+      if (stripes != nullptr)
+        heap::dealloc(stripes, sizeof(Stripe) * STRIPES);
+    }
+
+    /**
+     * Count finished readers per core rather than in one shared word. Must
+     * be called before the cown is first read.
+     */
+    void set_read_mostly()
+    {
+      assert(count.load() == 0);
+      if (stripes != nullptr)
+        return;
+
+      auto* s = static_cast<Stripe*>(heap::alloc(sizeof(Stripe) * STRIPES));
+      for (size_t i = 0; i < STRIPES; i++)
+        new (&s[i]) Stripe;
+      stripes = s;
+    }
+
     // true means first reader is added, false otherwise
     bool add_read(int readers = 1)
     {
@@ -70,9 +148,25 @@ namespace verona::rt
     }
 
     // Returns whether this is the last reader, and if there is a writer
-    // waiting.
-    STATUS release_read()
+    // waiting. `last_slot` is the tail of the cown's queue.
+    STATUS release_read(const std::atomic<Slot*>& last_slot)
     {
+      if (stripes != nullptr)
+      {
+        stripes[local_stripe()].departed.fetch_add(
+          1, std::memory_order_seq_cst);
+
+        // Unless a writer is waiting or the queue is empty, a later reader
+        // or writer will fold this departure in. Both are checked after
+        // recording it, and set before folding, so one side sees the other.
+        if (
+          ((count.load(std::memory_order_seq_cst) & 1) == 0) &&
+          (last_slot.load(std::memory_order_seq_cst) != nullptr))
+          return NOT_LAST;
+
+        return fold();
+      }
+
       auto old = count.fetch_sub(2, std::memory_order_acquire);
       if (old > 3)
         return NOT_LAST;
@@ -94,7 +188,12 @@ namespace verona::rt
     // * True means that there are no readers currently accessing
     // * False means that there are readers, but the last reader is guaranteed
     // to see LAST_READER_WAITING_WRITER.
-    bool try_write()
+    //
+    // For a read-mostly cown, the readers may all have finished without
+    // noticing they were the last. Then this returns true and sets
+    // `last_reader`, and the caller releases the reference count the last
+    // reader would have.
+    bool try_write(bool* last_reader = nullptr)
     {
       if (count.load(std::memory_order_acquire) == 0)
         return true;
@@ -102,8 +201,15 @@ namespace verona::rt
       assert(count.load() % 2 == 0);
 
       // Mark a pending write
-      if (count.fetch_add(1) != 0)
-        return false;
+      if (count.fetch_add(1, std::memory_order_seq_cst) != 0)
+      {
+        if ((stripes == nullptr) || (fold() != LAST_READER_WAITING_WRITER))
+          return false;
+
+        assert(last_reader != nullptr);
+        *last_reader = true;
+        return true;
+      }
 
       // if in the time between reading and writing the ref count, it
       // became zero, we can now process the write, so clear the flag
@@ -120,16 +226,19 @@ namespace verona::rt
     }
   };
 
-  class Slot;
   class BehaviourCore;
 
   class Cown : public Shared
   {
   public:
-    Cown() {}
+    Cown()
+    {
+      may_cycle = true;
+    }
 
   private:
     friend Core;
+    friend class CownCollector;
     friend Slot;
     template<typename T>
     friend class Promise;
@@ -155,7 +264,35 @@ namespace verona::rt
      */
     ReadRefCount read_ref_count;
 
+    /**
+     * The core that behaviours whose first cown this is are sent to when
+     * the scheduler is sticky (see Scheduler::set_sticky()), or nullptr.
+     * Given as a hint with set_home(), and moved to wherever such a
+     * behaviour last ran, so that the cown's data stays in one cache.
+     */
+    std::atomic<Core*> home{nullptr};
+
   public:
+    /**
+     * Make readers of this cown that finish on different cores not share a
+     * cache line, at the cost of more work for a writer that follows them.
+     * Must be called before the cown is first read.
+     */
+    void set_read_mostly()
+    {
+      read_ref_count.set_read_mostly();
+    }
+
+    void set_home(Core* core)
+    {
+      home.store(core, std::memory_order_relaxed);
+    }
+
+    Core* get_home()
+    {
+      return home.load(std::memory_order_relaxed);
+    }
+
     inline friend Logging::SysLog& operator<<(Logging::SysLog& os, Cown& c)
     {
       return os << " Cown: " << &c
@@ -0,0 +1,22 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "../ds/sizedpool.h"
+
+namespace verona::rt
+{
+  /**
+   * A per-thread pool of freed cowns, so that a thread that drops the last
+   * reference to a cown keeps its memory for the next cown of the same size
+   * it makes, instead of sending it back to the allocator of the thread
+   * that made it, which is often another one.
+   *
+   * A cown goes into the pool only once its weak count, which keeps the
+   * memory alive after the value has been collected, has dropped to zero
+   * (see Shared::weak_release()). Cowns of types of the same size share a
+   * bin. Off unless set_capacity() is called (see SizedPool).
+   **/
+  class CownPool : public SizedPool<CownPool>
+  {};
+} // namespace verona::rt
@@ -27,8 +27,10 @@
 
 #include "../debug/logging.h"
 #include "../debug/systematic.h"
+#include "../debug/eventtrace.h"
 #include "../ds/asymlock.h"
 #include "../ds/queue.h"
+#include "../sched/idlework.h"
 
 #include <snmalloc/snmalloc.h>
 
@@ -73,6 +75,8 @@ namespace verona::rt
     {
       Logging::cout() << "Global epoch set to " << e << std::endl;
       global_epoch().store(e, std::memory_order_release);
+      if constexpr (EventTrace::enabled)
+        EventTrace::record(EventTrace::Event::EpochAdvance, e);
     }
 
   public:
@@ -105,6 +109,12 @@ namespace verona::rt
    * There are two types of delayed operations:
    *   1. Decrementing the reference count of an object
    *   2. Deallocating an object.
+   *
+   * Both are reclaimed an epoch at a time. The deallocations of an epoch are
+   * detached from the list in one step, and freed as a batch, on this thread
+   * or, if large enough and offloading is on, on an idle one. The objects to
+   * decrement are kept in blocks, so that delaying a decrement allocates
+   * once per block rather than once per object.
    */
   class LocalEpoch : public Pooled<LocalEpoch>
   {
@@ -120,13 +130,17 @@ namespace verona::rt
     };
 
     /**
-     * Represents the node in the queue for objects that need an incref
-     * applying.
+     * A block of objects that need a decref applying. The dec list is a
+     * chain of these, taken from at the front and added to at the back.
      */
-    struct DecNode
+    struct DecBlock
     {
-      DecNode* next;
-      Object* o;
+      static constexpr size_t CAPACITY = 62;
+
+      DecBlock* next = nullptr;
+      uint32_t head = 0;
+      uint32_t tail = 0;
+      Object* objects[CAPACITY];
     };
 
     friend class ThreadLocalEpoch;
@@ -142,8 +156,12 @@ namespace verona::rt
     /// Represents how many objects in each epoch of delete_list
     size_t unusable[4] = {0, 0, 0, 0};
 
-    /// The queue of objects to be decremeneted.
-    Queue<DecNode> dec_list;
+    /// The last object of each epoch in delete_list, where its batch ends.
+    InnerNode* delete_last[4] = {nullptr, nullptr, nullptr, nullptr};
+
+    /// The first and last blocks of objects to be decremented.
+    DecBlock* dec_front = nullptr;
+    DecBlock* dec_back = nullptr;
 
     /// Represents how many objects in each epoch of dec_list
     size_t to_dec[4] = {0, 0, 0, 0};
@@ -164,15 +182,45 @@ namespace verona::rt
     /// Used to stop advance_is_sensible always firing.
     size_t sensible_threshold = 0;
 
-    /// Used to check that all threads are in a particular state.
-    /// Forward reference due to requiring the LocalEpochPool to
-    /// find all LocalEpochs.
+    /// Delayed deletes flushed at once from which a batch is handed to an
+    /// idle thread to free, if offloading is on.
+    static constexpr size_t OFFLOAD_BATCH = 256;
+
+    static inline std::atomic<bool> offload_frees_{false};
+
+    /// Returns a thread that is not in a particular state, or nullptr if
+    /// they all are. Forward reference due to requiring the LocalEpochPool
+    /// to find all LocalEpochs.
     template<typename T, bool predicate(LocalEpoch* p, T t)>
-    static bool forall(T t);
+    static LocalEpoch* find_not(T t);
+
+    /**
+     * The thread that last stopped the global epoch advancing. It is
+     * checked before any scan, so while it is still behind an advance
+     * fails after one check rather than a scan of every thread. LocalEpochs
+     * are pooled and never freed, so this is always safe to follow.
+     */
+    static std::atomic<LocalEpoch*>& laggard()
+    {
+      static std::atomic<LocalEpoch*> l{nullptr};
+      return l;
+    }
+
+    /**
+     * Set while a thread scans every LocalEpoch to advance the global
+     * epoch. Threads that find it set do not scan as well, and leave the
+     * advance to the one that is.
+     */
+    static std::atomic<bool>& scanning()
+    {
+      static std::atomic<bool> s{false};
+      return s;
+    }
 
     void add_to_delete_list(void* p)
     {
       delete_list.enqueue((InnerNode*)p);
+      delete_last[(index + 2) & 3] = (InnerNode*)p;
       (*get_unusable(2))++;
       (*get_pressure(2))++;
       debug_check_count();
@@ -180,14 +228,58 @@ namespace verona::rt
 
     void add_to_dec_list(Object* p)
     {
-      auto node = (DecNode*)heap::alloc<sizeof(DecNode)>();
-      node->o = p;
-      dec_list.enqueue(node);
+      if ((dec_back == nullptr) || (dec_back->tail == DecBlock::CAPACITY))
+      {
+        auto block = new (heap::alloc<sizeof(DecBlock)>()) DecBlock;
+        if (dec_back == nullptr)
+          dec_front = block;
+        else
+          dec_back->next = block;
+        dec_back = block;
+      }
+      dec_back->objects[dec_back->tail++] = p;
       (*get_to_dec(2))++;
       (*get_pressure(2))++;
       debug_check_count();
     }
 
+    /**
+     * Remove the oldest object from the dec list, freeing its block if it
+     * was the last one in it.
+     */
+    Object* take_from_dec_list()
+    {
+      DecBlock* block = dec_front;
+      assert((block != nullptr) && (block->head < block->tail));
+      Object* o = block->objects[block->head++];
+      if (block->head == block->tail)
+      {
+        dec_front = block->next;
+        if (dec_front == nullptr)
+          dec_back = nullptr;
+        heap::dealloc<sizeof(DecBlock)>(block);
+      }
+      return o;
+    }
+
+    /**
+     * Free a batch of delayed deletes, linked through `next` and ended by
+     * nullptr. Each node is prefetched while the one before it is freed,
+     * so the misses of walking the batch overlap.
+     */
+    static void free_batch(InnerNode* batch)
+    {
+      while (batch != nullptr)
+      {
+        auto next = batch->next;
+        if (next != nullptr)
+          Aal::prefetch(next);
+        Logging::cout() << "Delayed delete on " << batch << Logging::endl;
+        heap::dealloc(batch);
+        batch = next;
+      }
+    }
+
     inline void use_epoch()
     {
       if (lock.internal_acquire())
@@ -223,24 +315,54 @@ namespace verona::rt
       return &to_dec[(index + i) & 3];
     }
 
+    InnerNode** get_delete_last(uint8_t i)
+    {
+      return &delete_last[(index + i) & 3];
+    }
+
+    size_t dec_length()
+    {
+      size_t len = 0;
+      for (DecBlock* b = dec_front; b != nullptr; b = b->next)
+        len += b->tail - b->head;
+      return len;
+    }
+
     /**
      * Deals with the old epoch's delayed operations for this thread.
      */
-    void flush_old_epoch()
+    void flush_old_epoch(bool offload = true)
     {
       debug_check_count();
 
       {
         auto cell = get_unusable(0);
         auto usable = *cell;
+        auto last = get_delete_last(0);
 
-        for (size_t n = 0; n < usable; n++)
+        if (usable > 0)
         {
-          auto d = delete_list.dequeue();
-          Logging::cout() << "Delayed delete on " << d << Logging::endl;
-          heap::dealloc(d);
+          InnerNode* batch = delete_list.dequeue_until(*last);
+
+          if (
+            offload && (usable >= OFFLOAD_BATCH) &&
+            offload_frees_.load(std::memory_order_relaxed))
+          {
+            // Leave the frees to a thread that has nothing else to do.
+            Logging::cout() << "Offloading " << usable << " delayed deletes"
+                            << Logging::endl;
+            IdleWork::push(Closure::make([batch](Work*) {
+              free_batch(batch);
+              return true;
+            }));
+          }
+          else
+          {
+            free_batch(batch);
+          }
         }
         *cell = 0;
+        *last = nullptr;
 
         *get_pressure(0) = 0;
       }
@@ -251,13 +373,11 @@ namespace verona::rt
 
         for (size_t n = 0; n < usable; n++)
         {
-          auto dn = (DecNode*)dec_list.dequeue();
           // Reestablish invariant.  The Immutable::release below
           // can re-enter the Epoch structure so we need to ensure the
           // invariant is re-established.
           (*cell)--;
-          auto o = dn->o;
-          heap::dealloc<sizeof(DecNode)>(dn);
+          auto o = take_from_dec_list();
           Logging::cout() << "Delayed decref on " << o << Logging::endl;
           immutable::release(o);
         }
@@ -437,17 +557,23 @@ namespace verona::rt
 
       uint64_t e = get_epoch();
 
-      // Check that all threads are in the same epoch as us
-      if (try_eject)
-      {
-        if (!forall<uint64_t, in_epoch_try_eject>(e))
-          return false;
-      }
-      else
-      {
-        if (!forall<uint64_t, in_epoch>(e))
-          return false;
-      }
+      // Check that all threads are in the same epoch as us, starting with
+      // the one that held up the last attempt.
+      auto check = try_eject ? in_epoch_try_eject : in_epoch;
+      LocalEpoch* hint = laggard().load(std::memory_order_relaxed);
+      if ((hint != nullptr) && !check(hint, e))
+        return false;
+
+      if (scanning().exchange(true, std::memory_order_acquire))
+        return false;
+
+      LocalEpoch* behind = try_eject ?
+        find_not<uint64_t, in_epoch_try_eject>(e) :
+        find_not<uint64_t, in_epoch>(e);
+      laggard().store(behind, std::memory_order_relaxed);
+      scanning().store(false, std::memory_order_release);
+      if (behind != nullptr)
+        return false;
 
       // Advance the global epoch
       // Note multiple threads could be attempting this write at the same time.
@@ -500,13 +626,13 @@ namespace verona::rt
         for (auto i : to_dec)
           sum += i;
 
-        auto len = dec_list.length();
+        auto len = dec_length();
 
         if (sum != len)
           Logging::cout() << "debug_check_cout: to_dec: " << sum
                           << " list.length " << len << Logging::endl;
 
-        assert(sum == dec_list.length());
+        assert(sum == len);
       }
 #endif
     }
@@ -515,19 +641,19 @@ namespace verona::rt
   using LocalEpochPool = snmalloc::Pool<LocalEpoch>;
 
   template<typename T, bool predicate(LocalEpoch* p, T t)>
-  bool LocalEpoch::forall(T t)
+  LocalEpoch* LocalEpoch::find_not(T t)
   {
     auto curr = LocalEpochPool::iterate();
 
     while (curr != nullptr)
     {
       if (!predicate(curr, t))
-        return false;
+        return curr;
 
       curr = LocalEpochPool::iterate(curr);
     }
 
-    return true;
+    return nullptr;
   }
 
   /**
@@ -581,6 +707,21 @@ namespace verona::rt
       yield();
     }
 
+    /**
+     * Whether large batches of delayed deletes are freed by idle scheduler
+     * threads (see IdleWork), rather than by the thread that finds them
+     * usable. Off by default.
+     */
+    static void set_offload_frees(bool on)
+    {
+      LocalEpoch::offload_frees_.store(on, std::memory_order_relaxed);
+    }
+
+    static bool is_offload_frees()
+    {
+      return LocalEpoch::offload_frees_.load(std::memory_order_relaxed);
+    }
+
     uint64_t get_local_epoch_epoch()
     {
       return local_epoch->epoch;
@@ -609,7 +750,7 @@ namespace verona::rt
       {
         // There are four epoch that can be cleared.
         for (int i = 0; i < 4; i++)
-          curr->flush_old_epoch();
+          curr->flush_old_epoch(false);
 
         curr->eject();
 
@@ -0,0 +1,161 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "../ds/heap.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace verona::rt
+{
+  /**
+   * The closures of a fused behaviour: one behaviour that runs, under a
+   * single acquisition of its cown, every closure the thread that
+   * scheduled it appended before it started (see cpp::when_batched()).
+   *
+   * The scheduling thread keeps the fusion open until it schedules any
+   * other work or finishes the work it is running, so a closure is only
+   * appended when nothing could have been ordered between it and the
+   * closures already there. Every way of scheduling work closes it:
+   * BehaviourCore::schedule_many(), for behaviours on cowns, and the
+   * Scheduler's schedule functions, for work on no cown. Once the behaviour starts, the fusion is
+   * closed and appending fails, so the caller schedules a new one.
+   *
+   * A fusion is shared by the behaviour and the thread that has it open,
+   * and freed by whichever lets go of it last.
+   **/
+  class Fusion
+  {
+  public:
+    struct Node
+    {
+      Node* next;
+      /// Runs the closure on the acquired cown `arg`, then frees the node.
+      void (*run)(Node* self, void* arg);
+    };
+
+  private:
+    /// Closures appended so far, most recent first, or closed().
+    std::atomic<Node*> head{nullptr};
+
+    /// One for the behaviour, and one while a thread has it open.
+    std::atomic<size_t> rc{2};
+
+    struct Open
+    {
+      const void* key = nullptr;
+      Fusion* fusion = nullptr;
+
+      ~Open()
+      {
+        if (fusion != nullptr)
+          fusion->release();
+      }
+    };
+
+    static Open& local()
+    {
+      static thread_local Open open;
+      return open;
+    }
+
+    static Node* closed()
+    {
+      return reinterpret_cast<Node*>(uintptr_t(1));
+    }
+
+    void release()
+    {
+      if (rc.fetch_sub(1, std::memory_order_acq_rel) == 1)
+      {
+        this->~Fusion();
+        heap::dealloc(this, sizeof(Fusion));
+      }
+    }
+
+  public:
+    /**
+     * Create a fusion holding `first`, for a behaviour that is about to be
+     * scheduled. Open it with open() once it is.
+     **/
+    static Fusion* create(Node* first)
+    {
+      first->next = nullptr;
+      auto* f = new (heap::alloc(sizeof(Fusion))) Fusion;
+      f->head.store(first, std::memory_order_relaxed);
+      return f;
+    }
+
+    /**
+     * Make `f` the fusion this thread appends to for `key`.
+     **/
+    static void open(const void* key, Fusion* f)
+    {
+      close_local();
+      local() = {key, f};
+    }
+
+    /**
+     * Append `n` to the fusion this thread has open for `key`. Returns
+     * false if there is none, or its behaviour has started.
+     **/
+    static bool append(const void* key, Node* n)
+    {
+      auto& o = local();
+      if ((o.fusion == nullptr) || (o.key != key))
+        return false;
+
+      Node* h = o.fusion->head.load(std::memory_order_relaxed);
+      do
+      {
+        if (h == closed())
+          return false;
+        n->next = h;
+      } while (!o.fusion->head.compare_exchange_weak(
+        h, n, std::memory_order_release, std::memory_order_relaxed));
+      return true;
+    }
+
+    /**
+     * Stop appending to this thread's open fusion, if it has one.
+     **/
+    static void close_local()
+    {
+      auto& o = local();
+      if (o.fusion == nullptr)
+        return;
+
+      o.fusion->release();
+      o = {};
+    }
+
+    /**
+     * Called by the behaviour: close the fusion and run its closures in the
+     * order they were appended.
+     **/
+    void run(void* arg)
+    {
+      Node* n = head.exchange(closed(), std::memory_order_acquire);
+
+      Node* ordered = nullptr;
+      while (n != nullptr)
+      {
+        Node* next = n->next;
+        n->next = ordered;
+        ordered = n;
+        n = next;
+      }
+
+      while (ordered != nullptr)
+      {
+        Node* next = ordered->next;
+        ordered->run(ordered, arg);
+        ordered = next;
+      }
+
+      release();
+    }
+  };
+} // namespace verona::rt
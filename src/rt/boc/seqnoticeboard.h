@@ -0,0 +1,133 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "../debug/logging.h"
+#include "../debug/systematic.h"
+#include "epoch.h"
+
+#include <atomic>
+#include <cstring>
+#include <type_traits>
+
+namespace verona::rt
+{
+  /**
+   * A noticeboard for trivially copyable values, published with a seqlock.
+   *
+   * Unlike Noticeboard, the value is stored inline, so an update does not
+   * allocate or leave anything for the epoch to free, and a peek does not
+   * enter an epoch. A peek only retries while an update overlaps it.
+   *
+   * As with Noticeboard, only the owning cown may update it. In coalescing
+   * mode, updates made within one global epoch after the first are held
+   * back, and only the last of them is published, by the next update in a
+   * later epoch or by flush(). The owner should flush() when it stops
+   * updating, so that the last value is not held back indefinitely.
+   */
+  template<typename T>
+  class SeqNoticeboard
+  {
+    static_assert(
+      std::is_trivially_copyable_v<T> && std::is_default_constructible_v<T>,
+      "SeqNoticeboard copies its value word by word");
+
+    static constexpr size_t WORDS =
+      (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+    /// Odd while an update is in progress.
+    std::atomic<uint64_t> seq{0};
+
+    std::atomic<uint64_t> words[WORDS];
+
+    /// Only accessed by the owner.
+    bool coalesce;
+    bool has_pending = false;
+    uint64_t published_epoch = 0;
+    T pending;
+
+    void publish(const T& v)
+    {
+      uint64_t buf[WORDS] = {};
+      std::memcpy(buf, &v, sizeof(T));
+
+      uint64_t s = seq.load(std::memory_order_relaxed);
+      seq.store(s + 1, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_release);
+      for (size_t i = 0; i < WORDS; i++)
+      {
+        words[i].store(buf[i], std::memory_order_relaxed);
+        yield();
+      }
+      seq.store(s + 2, std::memory_order_release);
+    }
+
+  public:
+    SeqNoticeboard(T content, bool coalesce = false)
+    : coalesce(coalesce), pending(content)
+    {
+      for (auto& w : words)
+        w.store(0, std::memory_order_relaxed);
+      publish(content);
+      published_epoch = GlobalEpoch::get();
+    }
+
+    void update(T v)
+    {
+      if (coalesce)
+      {
+        uint64_t e = GlobalEpoch::get();
+        if (e == published_epoch)
+        {
+          pending = v;
+          has_pending = true;
+          return;
+        }
+        published_epoch = e;
+        has_pending = false;
+      }
+
+      Logging::cout() << "Updating seqlock noticeboard " << this
+                      << Logging::endl;
+      publish(v);
+    }
+
+    /**
+     * Publish the last update held back by coalescing, if any.
+     */
+    void flush()
+    {
+      if (!has_pending)
+        return;
+
+      has_pending = false;
+      published_epoch = GlobalEpoch::get();
+      publish(pending);
+    }
+
+    T peek() const
+    {
+      uint64_t buf[WORDS];
+      while (true)
+      {
+        uint64_t s = seq.load(std::memory_order_acquire);
+        if ((s & 1) == 0)
+        {
+          for (size_t i = 0; i < WORDS; i++)
+            buf[i] = words[i].load(std::memory_order_relaxed);
+          std::atomic_thread_fence(std::memory_order_acquire);
+          if (seq.load(std::memory_order_relaxed) == s)
+            break;
+        }
+        Systematic::yield_until([this, s]() {
+          return seq.load(std::memory_order_acquire) != s;
+        });
+        Aal::pause();
+      }
+
+      T result;
+      std::memcpy(&result, buf, sizeof(T));
+      return result;
+    }
+  };
+} // namespace verona::rt
@@ -7,6 +7,8 @@
 #include "../ds/forward_list.h"
 #include "../region/region.h"
 #include "base_noticeboard.h"
+#include "bias.h"
+#include "cownpool.h"
 
 namespace verona::rt
 {
@@ -15,17 +17,124 @@ namespace verona::rt
    * for Shared objects in the verona runtime.
    * This is extended to give other forms of Shared objects, such as Cowns.
    * [TODO A Notify as another subclass of Shared]
+   *
+   * Strong references are counted with biased reference counting: the
+   * scheduler thread that made the object counts the references it takes
+   * out and drops in `local_rc`, without atomics, and every other thread
+   * uses the count in the header. While the thread holds this bias the
+   * header count carries BIAS_RC on top of the references it counts, which
+   * may go below BIAS_RC when references taken out by the owner are dropped
+   * elsewhere. Giving up the bias (see unbias()) moves the references the
+   * owner still counts into the header, which then holds every reference
+   * still held, and from then on the owner counts as the other threads do.
+   * The owner does so when `local_rc` reaches zero, and for everything it
+   * made whenever it runs out of work (see Bias), as references it
+   * counted may have been dropped elsewhere and `local_rc` may then never
+   * reach zero. Objects made while a release hook is set (see
+   * set_release_hook()) are never biased, as the hook's user needs the
+   * whole count in the header.
    */
 
   class Shared : public Object
   {
+    friend class CownCollector;
+
   public:
     Shared()
     {
-      make_shared();
+      if (Bias::here && is_biased_rc() && (get_release_hook() == nullptr))
+      {
+        make_shared(BIAS_RC);
+        owner.store(thread_id(), std::memory_order_relaxed);
+        local_rc = 1;
+        if (Bias::unbias.load(std::memory_order_relaxed) == nullptr)
+          Bias::unbias.store(unbias_object, std::memory_order_relaxed);
+        bias_next = Bias::biased;
+        if (bias_next != nullptr)
+          bias_next->bias_prev = this;
+        Bias::biased = this;
+      }
+      else
+      {
+        make_shared();
+      }
     }
 
+    /**
+     * Whether Shared objects made from now on are biased towards the thread
+     * that makes them. On by default; turning it off makes every thread
+     * count in the header, to compare against.
+     */
+    static void set_biased_rc(bool biased)
+    {
+      biased_rc_.store(biased, std::memory_order_relaxed);
+    }
+
+    static bool is_biased_rc()
+    {
+      return biased_rc_.load(std::memory_order_relaxed);
+    }
+
+    using ReleaseHook = void (*)(Shared*);
+
+    /**
+     * Set a function to call with each object that may take part in a
+     * cycle (see `may_cycle`) when a strong reference to it is released,
+     * before the count is decremented, so that the object is still alive
+     * while the hook runs. nullptr, the default, calls nothing.
+     */
+    static void set_release_hook(ReleaseHook hook)
+    {
+      release_hook_.store(hook, std::memory_order_release);
+    }
+
+    static ReleaseHook get_release_hook()
+    {
+      return release_hook_.load(std::memory_order_acquire);
+    }
+
+  protected:
+    /// Whether references to this object can form cycles that reference
+    /// counting does not free, which is so for cowns.
+    bool may_cycle = false;
+
   private:
+    static inline std::atomic<bool> biased_rc_{true};
+
+    static inline std::atomic<ReleaseHook> release_hook_{nullptr};
+
+    /// Set while the object is a candidate of the CownCollector, which
+    /// holds a weak reference to it, linked through `next_candidate`.
+    std::atomic<bool> candidate{false};
+    Shared* next_candidate = nullptr;
+
+    /**
+     * Thread the object is biased towards, or 0 once it has given up its
+     * bias. Only that thread writes it, so other threads cannot mistake
+     * themselves for it.
+     */
+    std::atomic<size_t> owner{0};
+
+    /// Strong references counted by `owner`. Only it reads or writes this.
+    size_t local_rc = 0;
+
+    /// Neighbours in the owner's Bias list. Only it reads or writes these.
+    Shared* bias_prev = nullptr;
+    Shared* bias_next = nullptr;
+
+    static size_t thread_id()
+    {
+      static std::atomic<size_t> next{1};
+      static thread_local size_t id =
+        next.fetch_add(1, std::memory_order_relaxed);
+      return id;
+    }
+
+    bool owned_here()
+    {
+      return owner.load(std::memory_order_relaxed) == thread_id();
+    }
+
     /**
      * Shared object's weak reference count.  This keeps the Shared object
      *itself alive, but not the data it can reach.  Weak reference can be
@@ -38,6 +147,12 @@ namespace verona::rt
     {
       Logging::cout() << "Shared " << o << " acquire" << Logging::endl;
       assert(o->debug_is_shared());
+      auto s = (Shared*)o;
+      if (s->owned_here())
+      {
+        s->local_rc++;
+        return;
+      }
       o->incref();
     }
 
@@ -46,15 +161,65 @@ namespace verona::rt
       Logging::cout() << "Shared " << o << " release" << Logging::endl;
       assert(o->debug_is_shared());
 
+      if (o->may_cycle)
+      {
+        auto hook = get_release_hook();
+        if (hook != nullptr)
+          hook(o);
+      }
+
+      if (o->owned_here())
+      {
+        if (--o->local_rc == 0)
+          o->unbias();
+        return;
+      }
+
       // Perform decref
       auto release_weak = false;
       bool last = o->decref_shared(release_weak);
+      o->finish_release(last, release_weak);
+    }
+
+  private:
+    /**
+     * Give up the bias towards this thread, the owner, moving the references
+     * it still counts into the header, and finish as a release would if none
+     * are left.
+     */
+    void unbias()
+    {
+      Logging::cout() << "Shared " << this << " unbias" << Logging::endl;
+      if (bias_prev != nullptr)
+        bias_prev->bias_next = bias_next;
+      else
+        Bias::biased = bias_next;
+      if (bias_next != nullptr)
+        bias_next->bias_prev = bias_prev;
+      bias_prev = nullptr;
+      bias_next = nullptr;
+
+      owner.store(0, std::memory_order_relaxed);
+      size_t by = BIAS_RC - (local_rc * ONE_RC);
+      local_rc = 0;
+
+      auto release_weak = false;
+      bool last = decref_shared(release_weak, by);
+      finish_release(last, release_weak);
+    }
+
+    static void unbias_object(Shared* o)
+    {
+      o->unbias();
+    }
 
+    void finish_release(bool last, bool release_weak)
+    {
       yield();
 
       if (release_weak)
       {
-        o->weak_release();
+        weak_release();
         yield();
       }
 
@@ -64,12 +229,14 @@ namespace verona::rt
       // All paths from this point must release the weak count owned by the
       // strong count.
 
-      Logging::cout() << "Cown " << o << " dealloc" << Logging::endl;
+      Logging::cout() << "Cown " << this << " dealloc" << Logging::endl;
 
       // If last, then collect the cown body.
-      o->queue_collect();
+      queue_collect();
     }
 
+  public:
+
     /**
      * Release a weak reference to this cown.
      **/
@@ -114,7 +281,10 @@ namespace verona::rt
   private:
     void dealloc()
     {
-      Object::dealloc();
+      if (is_co_allocated())
+        Object::dealloc();
+      else
+        CownPool::dealloc(&get_header(), size());
       yield();
     }
 
@@ -3,6 +3,7 @@
 #pragma once
 
 #include "../boc/behaviourcore.h"
+#include "../boc/behaviourprofile.h"
 
 namespace verona::rt
 {
@@ -55,20 +56,63 @@ namespace verona::rt
    */
   class Behaviour : public BehaviourCore
   {
+    /// Offset of the tick a profiled behaviour was created at, after its
+    /// body.
     template<typename Be>
+    static constexpr size_t created_offset()
+    {
+      return (sizeof(Be) + sizeof(uint64_t) - 1) & ~(sizeof(uint64_t) - 1);
+    }
+
+    template<typename Be, bool profiled = false>
     static void invoke(Work* work)
     {
       // Dispatch to the body of the behaviour.
       BehaviourCore* b = BehaviourCore::from_work(work);
       Be* body = b->get_body<Be>();
+      [[maybe_unused]] uint64_t start = 0;
+      if constexpr (profiled)
+        start = BehaviourProfile::tick();
 
+      if constexpr (EventTrace::enabled)
+      {
+        size_t count = b->get_count();
+        auto slots = b->get_slots();
+        EventTrace::record(
+          EventTrace::Event::BehaviourStart,
+          (uintptr_t)b,
+          count,
+          count > 0 ? (uintptr_t)slots[0].cown() : 0,
+          count > 1 ? (uintptr_t)slots[1].cown() : 0);
+      }
       (*body)();
+      if constexpr (EventTrace::enabled)
+        EventTrace::record(EventTrace::Event::BehaviourEnd, (uintptr_t)b);
+      if constexpr (profiled)
+      {
+        // A rerun queues and is accounted again, from now.
+        uint64_t end = BehaviourProfile::tick();
+        uint64_t& created =
+          *pointer_offset<uint64_t>(body, created_offset<Be>());
+        BehaviourProfile::record(
+          BehaviourProfile::site<Be>(), created, start, end);
+        created = end;
+      }
       if (behaviour_rerun())
       {
         behaviour_rerun() = false;
         Scheduler::schedule(work);
         return;
       }
+      if (behaviour_yield())
+      {
+        behaviour_yield() = false;
+        if (b->get_priority() == Priority::Low)
+          Scheduler::schedule_low(work);
+        else
+          Scheduler::schedule_yielded(work);
+        return;
+      }
       // Dealloc behaviour
       body->~Be();
 
@@ -76,36 +120,149 @@ namespace verona::rt
     }
 
   public:
+    /**
+     * Closures of at most this many bytes are stored in the behaviour's own
+     * allocation, after its slots, so that making the behaviour allocates
+     * once. A larger closure is moved once into an allocation of its own,
+     * and the behaviour holds a pointer to it, so that behaviours stay small
+     * enough for the BehaviourPool. The closure is not moved or copied again
+     * while the behaviour waits, runs or is rerun.
+     *
+     * This only covers the closure object itself: what its captures own,
+     * such as the buffer of a captured std::vector or the target of a
+     * std::function, is allocated when they are made, as usual.
+     */
+    static constexpr size_t INLINE_BODY = 512;
+
+    /// Whether a closure of type Be is stored in the behaviour itself.
+    template<typename Be>
+    static constexpr bool is_inline()
+    {
+      return sizeof(std::decay_t<Be>) <= INLINE_BODY;
+    }
+
+    /**
+     * A closure too large to be stored inline, in an allocation of its own.
+     */
+    template<typename Be>
+    class Boxed
+    {
+      Be* be;
+
+    public:
+      template<typename G>
+      Boxed(G&& g)
+      : be(new (heap::alloc<sizeof(Be)>()) Be(std::forward<G>(g)))
+      {
+        static_assert(
+          alignof(Be) <= sizeof(void*), "Alignment not supported, yet!");
+      }
+
+      Boxed(Boxed&& o) : be(o.be)
+      {
+        o.be = nullptr;
+      }
+
+      Boxed(const Boxed&) = delete;
+      Boxed& operator=(const Boxed&) = delete;
+      Boxed& operator=(Boxed&&) = delete;
+
+      ~Boxed()
+      {
+        if (be != nullptr)
+        {
+          be->~Be();
+          heap::dealloc(be, sizeof(Be));
+        }
+      }
+
+      decltype(auto) operator()()
+      {
+        return (*be)();
+      }
+    };
+
     static bool& behaviour_rerun()
     {
       static thread_local bool rerun = false;
       return rerun;
     }
 
+  private:
+    static bool& behaviour_yield()
+    {
+      static thread_local bool yield = false;
+      return yield;
+    }
+
+  public:
+    /**
+     * Run the behaviour running on this thread again once the work already
+     * queued on its core has had a turn, keeping its cowns acquired
+     * meanwhile, so that a long behaviour, such as one collecting a large
+     * region in slices, does not hold up everything behind it. Unlike
+     * behaviour_rerun(), which runs it again at once, this puts it at the
+     * back of its core's queue.
+     *
+     * The behaviour must return straight after. It runs again from the
+     * start of its closure, so it must keep its progress in its cowns or in
+     * the closure's own mutable captures.
+     */
+    static void yield_turn()
+    {
+      behaviour_yield() = true;
+    }
+
     template<typename Be>
     static Behaviour* make(size_t count, Be&& f)
     {
-      auto behaviour_core = BehaviourCore::make(count, invoke<Be>, sizeof(Be));
+      if constexpr (!is_inline<Be>())
+      {
+        return make<Boxed<Be>>(count, Boxed<Be>(std::forward<Be>(f)));
+      }
+      else
+      {
+        BehaviourCore* behaviour_core;
+        if (BehaviourProfile::is_enabled())
+        {
+          behaviour_core = BehaviourCore::make(
+            count,
+            invoke<Be, true>,
+            created_offset<Be>() + sizeof(uint64_t));
+          *pointer_offset<uint64_t>(
+            behaviour_core->get_body(), created_offset<Be>()) =
+            BehaviourProfile::tick();
+        }
+        else
+        {
+          behaviour_core = BehaviourCore::make(count, invoke<Be>, sizeof(Be));
+        }
 
-      new (behaviour_core->get_body()) Be(std::forward<Be>(f));
+        new (behaviour_core->get_body()) Be(std::forward<Be>(f));
 
-      // These assertions are basically checking that we won't break any
-      // alignment assumptions on Be.  If we add some actual alignment, then
-      // this can be improved.
-      static_assert(
-        alignof(Be) <= sizeof(void*), "Alignment not supported, yet!");
+        // These assertions are basically checking that we won't break any
+        // alignment assumptions on Be.  If we add some actual alignment, then
+        // this can be improved.
+        static_assert(
+          alignof(Be) <= sizeof(void*), "Alignment not supported, yet!");
 
-      return (Behaviour*)behaviour_core;
+        return (Behaviour*)behaviour_core;
+      }
     }
 
     template<TransferOwnership transfer = NoTransfer, class T>
-    static void schedule(Cown* cown, T&& f)
+    static void
+    schedule(Cown* cown, T&& f, Priority priority = Priority::High)
     {
-      schedule<transfer, T>(1, &cown, std::forward<T>(f));
+      schedule<transfer, T>(1, &cown, std::forward<T>(f), priority);
     }
 
     template<TransferOwnership transfer = NoTransfer, class Be>
-    static void schedule(size_t count, Cown** cowns, Be&& f)
+    static void schedule(
+      size_t count,
+      Cown** cowns,
+      Be&& f,
+      Priority priority = Priority::High)
     {
       // TODO Remove vector allocation here.  This is a temporary fix to
       // as we transition to using Request through the code base.
@@ -120,7 +277,7 @@ namespace verona::rt
         }
       }
 
-      schedule<Be>(count, requests, std::forward<Be>(f));
+      schedule<Be>(count, requests, std::forward<Be>(f), priority);
 
       heap::dealloc(requests);
     }
@@ -153,13 +310,18 @@ namespace verona::rt
     }
 
     template<class Be>
-    static void schedule(size_t count, Request* requests, Be&& f)
+    static void schedule(
+      size_t count,
+      Request* requests,
+      Be&& f,
+      Priority priority = Priority::High)
     {
       Logging::cout() << "Schedule behaviour of type: " << typeid(Be).name()
                       << Logging::endl;
 
       auto* body =
         prepare_to_schedule<Be>(count, requests, std::forward<Be>(f));
+      body->set_priority(priority);
 
       BehaviourCore* arr[] = {body};
 
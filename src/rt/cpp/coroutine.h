@@ -0,0 +1,316 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+/**
+ * Coroutine support for the C++ API: a `task` can `co_await acquire(...)`
+ * on cowns instead of nesting `when` closures, and other tasks can
+ * `co_await` it for its result.
+ *
+ *   task<int> total(cown_ptr<Account> a, cown_ptr<Account> b)
+ *   {
+ *     auto [x, y] = co_await acquire(read(a), read(b));
+ *     co_return x->balance + y->balance;
+ *   }
+ *
+ * Coroutines need C++20, so this is empty when the compiler does not
+ * support them.
+ */
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+
+#  include "../boc/behaviourpool.h"
+#  include "when.h"
+
+#  include <atomic>
+#  include <coroutine>
+#  include <optional>
+#  include <tuple>
+#  include <utility>
+
+namespace verona::cpp
+{
+  template<typename T = void>
+  class task;
+
+  /**
+   * The part of a task's promise that does not depend on its result: where
+   * its frame is allocated, and who is waiting for it to finish.
+   *
+   * The frame is freed by whichever of the coroutine finishing and the
+   * task object being destroyed happens last, so a task that is dropped
+   * without being awaited runs to completion on its own.
+   */
+  class task_promise_base
+  {
+    template<typename T>
+    friend class task;
+
+    /// nullptr while nobody waits, the awaiting coroutine, done(), or
+    /// detached() once the task object is gone.
+    std::atomic<void*> state{nullptr};
+
+    static void* done()
+    {
+      return reinterpret_cast<void*>(uintptr_t(1));
+    }
+
+    static void* detached()
+    {
+      return reinterpret_cast<void*>(uintptr_t(2));
+    }
+
+    struct final_awaiter
+    {
+      bool await_ready() noexcept
+      {
+        return false;
+      }
+
+      template<typename P>
+      std::coroutine_handle<>
+      await_suspend(std::coroutine_handle<P> h) noexcept
+      {
+        void* prev =
+          h.promise().state.exchange(done(), std::memory_order_acq_rel);
+
+        if (prev == detached())
+        {
+          h.destroy();
+          return std::noop_coroutine();
+        }
+
+        if (prev != nullptr)
+          return std::coroutine_handle<>::from_address(prev);
+
+        return std::noop_coroutine();
+      }
+
+      void await_resume() noexcept {}
+    };
+
+  public:
+    static void* operator new(size_t size)
+    {
+      return BehaviourPool::alloc(size);
+    }
+
+    static void operator delete(void* p, size_t size)
+    {
+      BehaviourPool::dealloc(p, size);
+    }
+
+    /// Tasks start running straight away, on the caller's thread.
+    std::suspend_never initial_suspend() noexcept
+    {
+      return {};
+    }
+
+    final_awaiter final_suspend() noexcept
+    {
+      return {};
+    }
+
+    void unhandled_exception()
+    {
+      abort();
+    }
+  };
+
+  template<typename T>
+  class task_result : public task_promise_base
+  {
+    std::optional<T> value;
+
+  public:
+    template<typename U>
+    void return_value(U&& v)
+    {
+      value.emplace(std::forward<U>(v));
+    }
+
+    T take()
+    {
+      return std::move(*value);
+    }
+  };
+
+  template<>
+  class task_result<void> : public task_promise_base
+  {
+  public:
+    void return_void() {}
+
+    void take() {}
+  };
+
+  /**
+   * A coroutine that runs on the Verona scheduler. It starts on the
+   * calling thread, and after each `co_await acquire(...)` continues in a
+   * behaviour that holds the requested cowns.
+   *
+   * `co_await` on a task waits for it to finish and returns its result.
+   * The awaiting coroutine continues on the thread that finished the
+   * task, inside whatever behaviour it finished in, so it should acquire
+   * the cowns it needs again rather than rely on that behaviour's.
+   */
+  template<typename T>
+  class task
+  {
+  public:
+    class promise_type : public task_result<T>
+    {
+    public:
+      task get_return_object()
+      {
+        return task(std::coroutine_handle<promise_type>::from_promise(*this));
+      }
+    };
+
+  private:
+    std::coroutine_handle<promise_type> h;
+
+    explicit task(std::coroutine_handle<promise_type> h) : h(h) {}
+
+  public:
+    task(task&& o) : h(std::exchange(o.h, nullptr)) {}
+
+    task(const task&) = delete;
+    task& operator=(const task&) = delete;
+    task& operator=(task&&) = delete;
+
+    ~task()
+    {
+      if (!h)
+        return;
+
+      void* prev = h.promise().state.exchange(
+        task_promise_base::detached(), std::memory_order_acq_rel);
+      if (prev == task_promise_base::done())
+        h.destroy();
+    }
+
+    auto operator co_await() &
+    {
+      struct awaiter
+      {
+        std::coroutine_handle<promise_type> h;
+
+        bool await_ready()
+        {
+          return h.promise().state.load(std::memory_order_acquire) ==
+            task_promise_base::done();
+        }
+
+        bool await_suspend(std::coroutine_handle<> waiting)
+        {
+          void* expected = nullptr;
+          return h.promise().state.compare_exchange_strong(
+            expected, waiting.address(), std::memory_order_acq_rel);
+        }
+
+        T await_resume()
+        {
+          return h.promise().take();
+        }
+      };
+
+      assert(h);
+      return awaiter{h};
+    }
+
+    auto operator co_await() &&
+    {
+      return operator co_await();
+    }
+  };
+
+  template<typename C>
+  struct acquired_type;
+
+  template<typename T>
+  struct acquired_type<cown_ptr<T>>
+  {
+    using type = acquired_cown<T>;
+  };
+
+  template<typename T>
+  struct acquired_type<cown_ptr<const T>>
+  {
+    using type = acquired_cown<const T>;
+  };
+
+  template<typename T>
+  struct acquired_type<cown_array<T>>
+  {
+    using type = acquired_cown_span<T>;
+  };
+
+  /**
+   * Awaitable returned by `acquire`. Do not use directly.
+   */
+  template<typename... Args>
+  class AcquireAwaiter
+  {
+    /// acquired_cown can be neither copied nor moved, so refer to those the
+    /// behaviour was passed.
+    using Acquired = std::tuple<typename acquired_type<Args>::type&...>;
+
+    std::tuple<Args...> cowns;
+
+    /// The acquired cowns, on the stack of the behaviour resuming us.
+    Acquired* acquired = nullptr;
+
+  public:
+    template<typename... Args2>
+    AcquireAwaiter(Args2&&... args) : cowns(std::forward<Args2>(args)...)
+    {}
+
+    bool await_ready()
+    {
+      return false;
+    }
+
+    /**
+     * Schedule a behaviour on the cowns that resumes `h`. It may run, and
+     * resume `h`, before this returns, so nothing here touches the frame
+     * once it is scheduled.
+     */
+    void await_suspend(std::coroutine_handle<> h)
+    {
+      std::apply(
+        [this, h](auto&&... cs) {
+          when(std::move(cs)...) << [this, h](auto&&... acq) {
+            Acquired a(acq...);
+            acquired = &a;
+            h.resume();
+          };
+        },
+        std::move(cowns));
+    }
+
+    decltype(auto) await_resume()
+    {
+      if constexpr (sizeof...(Args) == 1)
+        return std::get<0>(*acquired);
+      else
+        return *acquired;
+    }
+  };
+
+  /**
+   * Suspend the calling task until it has the cowns, and resume it in a
+   * behaviour that holds them. Takes the same arguments as `when`, and
+   * returns a reference to the acquired cown, or a tuple of references if
+   * there are several. They are valid until the task next suspends.
+   *
+   *   auto& a = co_await acquire(c);
+   *   auto [x, y] = co_await acquire(c1, read(c2));
+   */
+  template<typename... Args>
+  auto acquire(Args&&... args)
+  {
+    static_assert(sizeof...(Args) > 0, "acquire needs at least one cown");
+    return AcquireAwaiter<std::decay_t<Args>...>(std::forward<Args>(args)...);
+  }
+} // namespace verona::cpp
+#endif
@@ -2,8 +2,10 @@
 // SPDX-License-Identifier: MIT
 #pragma once
 
+#include <cstddef>
 #include <functional>
 #include <tuple>
+#include <type_traits>
 #include <utility>
 #include <verona.h>
 
@@ -34,6 +36,77 @@ namespace verona::cpp
   template<typename T>
   class cown_ptr;
 
+  /**
+   * How the value of a cown is placed next to the runtime's state for the
+   * cown, that is the reference counts in the object header and the queue
+   * of behaviours.
+   */
+  enum class CownLayout
+  {
+    /// The value directly follows the cown's state.
+    Packed,
+    /// The value starts on a cache line of its own, and the allocation
+    /// ends with the line the value ends in. Threads that schedule
+    /// behaviours on the cown, and so write its state, then do not
+    /// invalidate the lines the running behaviour is using in the value.
+    Padded,
+  };
+
+  /**
+   * The layout of cowns of type T: `T::cown_layout` if T declares it, and
+   * otherwise CownLayout::Packed. It can be specialised for types that
+   * cannot declare it.
+   */
+  template<typename T, typename = void>
+  struct cown_layout
+  : std::integral_constant<CownLayout, CownLayout::Packed>
+  {};
+  template<typename T>
+  struct cown_layout<T, std::void_t<decltype(T::cown_layout)>>
+  : std::integral_constant<CownLayout, T::cown_layout>
+  {};
+
+  /**
+   * The value of a cown, laid out as `layout` says.
+   */
+  template<typename T, CownLayout layout>
+  struct CownValue
+  {
+    T value;
+
+    template<typename... Args>
+    CownValue(Args&&... ts) : value(std::forward<Args>(ts)...)
+    {}
+  };
+
+  template<typename T>
+  struct CownValue<T, CownLayout::Padded>
+  {
+    static constexpr size_t CACHE_LINE = rt::CACHE_LINE;
+
+    /// Bytes of the object before this: its header and the cown's state.
+    static constexpr size_t PREFIX = sizeof(Object::Header) + sizeof(Cown);
+
+    /// Padding, of at least a byte, that starts the value and ends the
+    /// allocation on a line, given that the allocation starts on one.
+    static constexpr size_t BEFORE =
+      snmalloc::bits::align_up(PREFIX + 1, CACHE_LINE) - PREFIX;
+    static constexpr size_t AFTER =
+      snmalloc::bits::align_up(PREFIX + BEFORE + sizeof(T) + 1, CACHE_LINE) -
+      (PREFIX + BEFORE + sizeof(T));
+
+    static_assert(
+      alignof(T) <= alignof(Cown), "padded cown value is over-aligned");
+
+    std::byte before[BEFORE];
+    T value;
+    std::byte after[AFTER];
+
+    template<typename... Args>
+    CownValue(Args&&... ts) : value(std::forward<Args>(ts)...)
+    {}
+  };
+
   /**
    * Internal Verona runtime cown for the type T.
    *
@@ -44,11 +117,18 @@ namespace verona::cpp
   class ActualCown : public VCown<ActualCown<T>>
   {
   private:
-    T value;
+    CownValue<T, cown_layout<T>::value> storage;
 
     template<typename... Args>
-    ActualCown(Args&&... ts) : value(std::forward<Args>(ts)...)
-    {}
+    ActualCown(Args&&... ts) : storage(std::forward<Args>(ts)...)
+    {
+      // The allocator aligns an allocation whose size is a multiple of a
+      // cache line to the line, which a padded value relies on.
+      static_assert(
+        (cown_layout<T>::value != CownLayout::Padded) ||
+        (vsizeof<ActualCown> % CownValue<T, CownLayout::Padded>::CACHE_LINE ==
+         0));
+    }
 
     template<typename TT>
     friend class acquired_cown;
@@ -195,19 +275,29 @@ namespace verona::cpp
     template<typename TT>
     friend class AccessBatch;
 
+    template<typename TT>
+    friend class BatchedWhen;
+
+    template<typename TT>
+    friend class InlineWhen;
+
     /**
      * Internal Verona runtime cown for this type.
      */
     ActualCown<T>* allocated_cown{nullptr};
 
+  public:
     /**
-     * Accesses the internal Verona runtime cown for this handle.
+     * Accesses the internal Verona runtime cown for this handle, to
+     * schedule on it through the runtime, as with rt::schedule_lambda().
      */
     Cown* underlying_cown()
     {
       return allocated_cown;
     }
 
+  private:
+
     /**
      * Construct a new cown ptr object, actually allocates a runtime cown.
      *
@@ -279,17 +369,17 @@ namespace verona::cpp
       return allocated_cown != nullptr;
     }
 
-    bool operator==(const cown_ptr& other)
+    bool operator==(const cown_ptr& other) const
     {
       return allocated_cown == other.allocated_cown;
     }
 
-    bool operator!=(const cown_ptr& other)
+    bool operator!=(const cown_ptr& other) const
     {
       return !((*this) == other);
     }
 
-    bool operator==(std::nullptr_t)
+    bool operator==(std::nullptr_t) const
     {
       return allocated_cown == nullptr;
     }
@@ -308,7 +398,28 @@ namespace verona::cpp
       }
     }
 
-    weak get_weak()
+    /**
+     * Hint that behaviours on this cown should run on the `core`th core
+     * (see Scheduler::set_sticky()). The scheduler must be initialised.
+     */
+    void set_affinity(size_t core)
+    {
+      assert(allocated_cown != nullptr);
+      allocated_cown->set_home(verona::rt::Scheduler::core_at(core));
+    }
+
+    /**
+     * Make readers of this cown finishing on different cores not contend on
+     * one counter (see Cown::set_read_mostly()). Must be called before the
+     * cown is first read.
+     */
+    void set_read_mostly()
+    {
+      assert(allocated_cown != nullptr);
+      allocated_cown->set_read_mostly();
+    }
+
+    weak get_weak() const
     {
       if (allocated_cown != nullptr)
         allocated_cown->weak_acquire();
@@ -410,6 +521,12 @@ namespace verona::cpp
     template<typename T2>
     friend class AccessBatch;
 
+    template<typename T2>
+    friend class InlineWhen;
+
+    template<typename T2>
+    friend class BatchedWhen;
+
   private:
     /// Underlying cown that has been acquired.
     /// Runtime is actually holding this reference count.
@@ -431,9 +548,9 @@ namespace verona::cpp
     T& get_ref() const
     {
       if constexpr (std::is_const<T>())
-        return const_cast<T&>(origin_cown.value);
+        return const_cast<T&>(origin_cown.storage.value);
       else
-        return origin_cown.value;
+        return origin_cown.storage.value;
     }
 
     T& operator*()
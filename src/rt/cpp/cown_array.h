@@ -39,6 +39,11 @@ namespace verona::cpp
       {
         constr_helper(array_);
       }
+      else
+      {
+        // Takes the heap allocated array, and the references in it.
+        array = array_;
+      }
     }
 
     cown_array(const cown_array& o)
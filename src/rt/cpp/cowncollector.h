@@ -0,0 +1,388 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "../boc/cown.h"
+#include "../region/region.h"
+#include "../sched/idlework.h"
+#include "behaviour.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace verona::rt
+{
+  /**
+   * Collects cycles of cowns that nothing outside the cycle refers to, which
+   * reference counting alone frees only when the runtime is torn down, while
+   * the program runs. Off by default; see set_enabled().
+   *
+   * Every release of a strong reference to a cown that may leave it alive
+   * makes the cown a candidate, holding a weak reference to it. When a
+   * scheduler thread runs out of work (see IdleWork), the collector takes
+   * out a strong reference to the next candidate that is still alive and
+   * checks it with a Priority::Low behaviour on it. Checks run one at a
+   * time, each on a set of at most MAX_COWNS cowns, so that the work done
+   * at once is bounded:
+   *
+   *  - With every cown of the set acquired, so that their data cannot
+   *    change, it counts the references from the set to each cown, through
+   *    their fields and the remembered sets of the regions they hold
+   *    directly.
+   *  - If the set refers to cowns outside it, the check is run again on the
+   *    larger set, unless that is more than MAX_COWNS.
+   *  - Otherwise the set is garbage if each cown's count is the references
+   *    from the set, plus one for the queue of behaviours the check is in,
+   *    no behaviour is waiting behind the check, and nothing but the
+   *    collector holds a weak reference to it. Nothing else can then reach
+   *    the set, or make it reachable again, and it is torn down as the last
+   *    release of each cown would: finalisers first, then the references
+   *    the cowns hold, then their destructors.
+   *
+   * References the collector cannot see make it keep cowns, never free
+   * them: references from immutable objects or from regions nested in
+   * other regions are not counted, nor are cown_ptrs held in the value of
+   * a C++ cown, which does not trace it. Cowns biased to a thread (see
+   * Shared) are left alone too, and cowns made while the collector is on
+   * are not biased.
+   **/
+  class CownCollector
+  {
+  public:
+    /// Most cowns a check acquires at once. Larger graphs are kept.
+    static constexpr size_t MAX_COWNS = 64;
+
+    /// Most candidates that have already died one idle step goes through
+    /// before it gives the thread back.
+    static constexpr size_t STEP = 64;
+
+  private:
+    /// Candidates added since the last step, linked through
+    /// Shared::next_candidate.
+    static inline std::atomic<Shared*> pending_{nullptr};
+
+    /// Candidates taken from pending_ and not checked yet. Only touched by
+    /// whoever holds busy_.
+    static inline Shared* taken_ = nullptr;
+
+    /// Held from the start of a step until the check it starts is over.
+    static inline std::atomic<bool> busy_{false};
+
+    /// Whether a step is waiting in IdleWork.
+    static inline std::atomic<bool> queued_{false};
+
+    static inline std::atomic<size_t> collected_{0};
+
+    static void add_candidate(Shared* o)
+    {
+      if (
+        o->candidate.load(std::memory_order_relaxed) ||
+        o->candidate.exchange(true, std::memory_order_acq_rel))
+        return;
+
+      Logging::cout() << "CownCollector candidate " << o << Logging::endl;
+      o->weak_acquire();
+      Shared* h = pending_.load(std::memory_order_relaxed);
+      do
+      {
+        o->next_candidate = h;
+      } while (!pending_.compare_exchange_weak(
+        h, o, std::memory_order_release, std::memory_order_relaxed));
+      kick();
+    }
+
+    static void kick()
+    {
+      if (queued_.exchange(true, std::memory_order_acq_rel))
+        return;
+
+      IdleWork::push(Closure::make([](Work*) {
+        queued_.store(false, std::memory_order_release);
+        step();
+        return true;
+      }));
+    }
+
+    /**
+     * Start a check on the next candidate still alive, unless one is in
+     * progress.
+     **/
+    static void step()
+    {
+      if (busy_.exchange(true, std::memory_order_acquire))
+        return;
+
+      for (size_t i = 0; i < STEP; i++)
+      {
+        if (taken_ == nullptr)
+          taken_ = pending_.exchange(nullptr, std::memory_order_acquire);
+        if (taken_ == nullptr)
+          break;
+
+        Shared* c = taken_;
+        taken_ = c->next_candidate;
+        c->candidate.store(false, std::memory_order_release);
+
+        bool alive = c->acquire_strong_from_weak();
+        c->weak_release();
+        if (alive)
+        {
+          std::vector<Cown*> set{static_cast<Cown*>(c)};
+          schedule_check(set);
+          return;
+        }
+      }
+
+      finish();
+    }
+
+    static void finish()
+    {
+      busy_.store(false, std::memory_order_release);
+      // Candidates added while busy_ was held did not start a step.
+      if (pending_.load(std::memory_order_acquire) != nullptr)
+        kick();
+    }
+
+    /**
+     * Check `set`, whose strong references the caller gives to the check.
+     **/
+    static void schedule_check(std::vector<Cown*>& set)
+    {
+      BehaviourCore* b = BehaviourCore::make(set.size(), check, 0);
+      Slot* slots = b->get_slots();
+      for (size_t i = 0; i < set.size(); i++)
+      {
+        auto* s = new (&slots[i]) Slot(set[i]);
+        s->set_move();
+      }
+      b->set_priority(Priority::Low);
+      BehaviourCore::schedule_many(&b, 1);
+    }
+
+    /**
+     * Count a reference from the set to `o`, in `internal` if it is in
+     * `set`, or else by adding it to `found`.
+     **/
+    static void note(
+      Object* o,
+      const std::vector<Cown*>& set,
+      std::vector<size_t>& internal,
+      std::vector<Cown*>& found)
+    {
+      if (!static_cast<Shared*>(o)->may_cycle)
+        return;
+
+      auto it = std::find(set.begin(), set.end(), o);
+      if (it != set.end())
+        internal[it - set.begin()]++;
+      else if (std::find(found.begin(), found.end(), o) == found.end())
+        found.push_back(static_cast<Cown*>(o));
+    }
+
+    static void count_references(
+      Cown* x,
+      const std::vector<Cown*>& set,
+      std::vector<size_t>& internal,
+      std::vector<Cown*>& found)
+    {
+      ObjectStack st;
+      x->trace(st);
+      while (!st.empty())
+      {
+        Object* o = st.pop();
+        switch (o->get_class())
+        {
+          case Object::SHARED:
+            note(o, set, internal, found);
+            break;
+
+          case Object::ISO:
+          {
+            // The background collector may be sweeping the remembered set.
+            if (Region::get_type(o) == RegionType::Trace)
+              static_cast<RegionTrace*>(Region::get(o))->open();
+            Region::get(o)->for_each([&](Object* e) {
+              if (e->get_class() == Object::SHARED)
+                note(e, set, internal, found);
+            });
+            break;
+          }
+
+          default:
+            break;
+        }
+      }
+    }
+
+    static bool is_garbage(
+      Slot* slots,
+      const std::vector<Cown*>& set,
+      const std::vector<size_t>& internal)
+    {
+      // Read every count before the queues, as a behaviour can only be
+      // queued by something holding a reference, which it releases after.
+      for (size_t i = 0; i < set.size(); i++)
+      {
+        Cown* x = set[i];
+        if (x->owner.load(std::memory_order_relaxed) != 0)
+          return false;
+
+        size_t expected =
+          (size_t)Object::SHARED + ((internal[i] + 1) * Object::ONE_RC);
+        if (x->get_header().rc.load(std::memory_order_seq_cst) != expected)
+          return false;
+      }
+
+      for (size_t i = 0; i < set.size(); i++)
+      {
+        Cown* x = set[i];
+        if (x->last_slot.load(std::memory_order_seq_cst) != &slots[i])
+          return false;
+
+        size_t weak = x->candidate.load(std::memory_order_seq_cst) ? 2 : 1;
+        if (x->weak_count.load(std::memory_order_seq_cst) != weak)
+          return false;
+      }
+
+      return true;
+    }
+
+    static void check(Work* work)
+    {
+      BehaviourCore* b = BehaviourCore::from_work(work);
+      Slot* slots = b->get_slots();
+      size_t count = b->get_count();
+
+      std::vector<Cown*> set(count);
+      for (size_t i = 0; i < count; i++)
+        set[i] = slots[i].cown();
+
+      std::vector<size_t> internal(count, 0);
+      std::vector<Cown*> found;
+      for (Cown* x : set)
+        count_references(x, set, internal, found);
+
+      Logging::cout() << "CownCollector check of " << count << " cowns, "
+                      << found.size() << " more found" << Logging::endl;
+
+      if (!found.empty())
+      {
+        if (count + found.size() > MAX_COWNS)
+        {
+          BehaviourCore::finished(work);
+          finish();
+          return;
+        }
+
+        // The set holds `found` alive, and cannot change until the check
+        // is finished.
+        for (Cown* x : set)
+          Shared::acquire(x);
+        for (Cown* y : found)
+          Shared::acquire(y);
+        BehaviourCore::finished(work);
+
+        set.insert(set.end(), found.begin(), found.end());
+        schedule_check(set);
+        return;
+      }
+
+      if (!is_garbage(slots, set, internal))
+      {
+        BehaviourCore::finished(work);
+        finish();
+        return;
+      }
+
+      // Keep each cown alive while the check drops its queues' references.
+      // Nothing else can queue behaviours on the set, so finishing the
+      // check leaves it with exactly the references from the set and ours.
+      for (Cown* x : set)
+        Shared::acquire(x);
+      BehaviourCore::finished(work);
+
+      tear_down(set);
+      collected_.fetch_add(set.size(), std::memory_order_relaxed);
+      finish();
+    }
+
+    static void tear_down(std::vector<Cown*>& set)
+    {
+      Logging::cout() << "CownCollector collecting " << set.size()
+                      << " cowns" << Logging::endl;
+
+      ObjectStack dummy;
+      for (Cown* x : set)
+        x->finalise(nullptr, dummy);
+
+      // Releases the references between the cowns of the set too, down to
+      // the one each holds for the collector.
+      for (Cown* x : set)
+      {
+        ObjectStack f;
+        x->trace(f);
+        while (!f.empty())
+        {
+          Object* o = f.pop();
+          switch (o->get_class())
+          {
+            case Object::ISO:
+              Region::release(o);
+              break;
+
+            case Object::RC:
+            case Object::SCC_PTR:
+              Immutable::release(o);
+              break;
+
+            case Object::SHARED:
+              Shared::release(static_cast<Shared*>(o));
+              break;
+
+            default:
+              abort();
+          }
+        }
+      }
+
+      // Drop the collector's references without collecting again. A
+      // candidate left in the list fails to take a strong reference.
+      for (Cown* x : set)
+      {
+        assert(
+          x->get_header().rc.load(std::memory_order_relaxed) ==
+          (size_t)Object::SHARED + Object::ONE_RC);
+        x->get_header().rc.store(
+          Object::FINISHED_RC, std::memory_order_release);
+      }
+
+      for (Cown* x : set)
+        x->destructor();
+
+      for (Cown* x : set)
+        x->weak_release();
+    }
+
+  public:
+    /**
+     * Turn the collector on or off. While it is off, releases do not add
+     * candidates, but checks already started run to the end.
+     **/
+    static void set_enabled(bool enabled)
+    {
+      Shared::set_release_hook(enabled ? add_candidate : nullptr);
+    }
+
+    static bool is_enabled()
+    {
+      return Shared::get_release_hook() != nullptr;
+    }
+
+    /// Number of cowns the collector has freed.
+    static size_t get_collected()
+    {
+      return collected_.load(std::memory_order_relaxed);
+    }
+  };
+} // namespace verona::rt
@@ -26,14 +26,149 @@ namespace verona::rt
     Behaviour::schedule(count, requests, std::forward<Be>(f));
   }
 
+  /**
+   * Schedule `f` to run on its own, not on any cown. As with behaviours,
+   * a closure larger than Behaviour::INLINE_BODY bytes is moved into an
+   * allocation of its own rather than into the work item.
+   */
   template<typename Be>
-  static void schedule_lambda(Be&& f)
+  static void schedule_lambda(Be&& f, Priority priority = Priority::High)
   {
-    auto w = Closure::make([f = std::forward<Be>(f)](Work* w) mutable {
-      f();
+    using B = std::decay_t<Be>;
+    if constexpr (!Behaviour::is_inline<B>())
+    {
+      schedule_lambda(Behaviour::Boxed<B>(std::forward<Be>(f)), priority);
+    }
+    else
+    {
+      auto w = Closure::make([f = std::forward<Be>(f)](Work* w) mutable {
+        f();
+        return true;
+      });
+      if (priority == Priority::Low)
+        Scheduler::schedule_low(w);
+      else
+        Scheduler::schedule(w);
+    }
+  }
+
+  /**
+   * Schedule the collection deferred when the region `r`, which `c` owns,
+   * was closed with api::CloseGC::Defer, as a behaviour of its own on `c`.
+   * It runs after the behaviours already waiting on `c` rather than
+   * lengthening the one that closed the region, and with Priority::Low,
+   * so that it does not hold up latency critical work. `r` must still be
+   * the entry point of its region when it runs.
+   */
+  inline void schedule_region_collect(Cown* c, Object* r)
+  {
+    Behaviour::schedule(
+      c, [r]() { api::region_collect_deferred(r); }, Priority::Low);
+  }
+
+  /**
+   * Like schedule_region_collect(), but the collection is only scheduled
+   * once a scheduler thread runs out of work, so that it reclaims the
+   * garbage of a cown that has gone quiet without adding to the latency of
+   * anything waiting to run. Does nothing unless closing `r` deferred a
+   * collection, or if one is already waiting. Must be called from a
+   * behaviour on `c`.
+   */
+  inline void schedule_idle_collect(Cown* c, Object* r)
+  {
+    RegionBase* md = Region::get(r);
+    if (!md->collect_deferred || md->collect_idle_queued)
+      return;
+
+    md->collect_idle_queued = true;
+    Cown::acquire(c);
+    IdleWork::push(Closure::make([c, r](Work*) {
+      schedule_region_collect(c, r);
+      Cown::release(c);
       return true;
-    });
-    Scheduler::schedule(w);
+    }));
+  }
+
+  /**
+   * Like schedule_region_collect(), but the collection is queued with this
+   * scheduler thread's GCPacer, which lets it through within the thread's
+   * GC budget, ahead of collections expected to reclaim less per cycle of
+   * pause, and not while runnable work is waiting. With pacing off (see
+   * GCPacer::set_budget()), or off a scheduler thread, it is scheduled
+   * straight away. Does nothing unless closing `r` deferred a collection,
+   * or if one is already waiting. Must be called from a behaviour on `c`.
+   */
+  inline void schedule_paced_collect(Cown* c, Object* r)
+  {
+    RegionBase* md = Region::get(r);
+    if (!md->collect_deferred || md->collect_idle_queued)
+      return;
+
+    if (GCPacer::get_budget() == 0 || Scheduler::local() == nullptr)
+    {
+      schedule_region_collect(c, r);
+      return;
+    }
+
+    md->collect_idle_queued = true;
+    size_t used = Region::get_memory_used(md);
+    size_t live = md->gc_policy.get_live();
+    size_t reclaimable = used > live ? used - live : 0;
+
+    Cown::acquire(c);
+    GCPacer::local().request(
+      Closure::make([c, r, used](Work*) {
+        Behaviour::schedule(
+          c,
+          [r, used]() {
+            uint64_t start = Aal::tick();
+            if (api::region_collect_deferred(r))
+              GCPacer::record(used, Aal::tick() - start);
+          },
+          Priority::Low);
+        Cown::release(c);
+        return true;
+      }),
+      reclaimable,
+      used);
+  }
+
+  /**
+   * Schedule the release of the region whose entry point is `r`, and then
+   * of the regions it holds, each in a closure of its own with
+   * Priority::Low (see region_release_async()).
+   */
+  inline void schedule_region_release(Object* r)
+  {
+    schedule_lambda(
+      [r]() {
+        ObjectStack collect;
+        with_region_stats(
+          r->get_region(),
+          "Region release",
+          [&]() { Region::release_shallow(r, collect); },
+          true);
+        while (!collect.empty())
+          schedule_region_release(collect.pop());
+      },
+      Priority::Low);
+  }
+
+  /**
+   * Release the region whose entry point is `r` in the background, rather
+   * than in the calling behaviour, which a large region or a deep tree of
+   * regions would stall. The caller gives up `r`, and must not use it, or
+   * any object of the regions it holds, again.
+   *
+   * The teardown is sliced by region: each region of the tree is released
+   * by a closure of its own, with Priority::Low, so that latency critical
+   * work runs between them. Must be called while the scheduler runs.
+   */
+  inline void region_release_async(Object* r)
+  {
+    assert(r->debug_is_iso());
+    AllocTrace::on_release(r);
+    schedule_region_release(r);
   }
 
   // TODO super minimal version initially, just to get the tests working.
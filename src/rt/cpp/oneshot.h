@@ -0,0 +1,187 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include <atomic>
+#include <optional>
+
+namespace verona::rt
+{
+  /*
+   * A one-shot future: a value written once and consumed by a single
+   * continuation.
+   *
+   * Unlike Promise, it is not a cown. The value is held in place, and
+   * fulfilling it schedules the continuation as a single Work item, or
+   * then() does if the value is already there. Whichever of the two comes
+   * second schedules it, so there is exactly one scheduled Work per value,
+   * where a Promise needs the promise cown and then a behaviour on it.
+   *
+   * There is one read end-point (OneShotR) and one write end-point
+   * (OneShotW), neither of which can be copied. The continuation is passed
+   * an empty optional if the write end-point is dropped without
+   * fulfilling it.
+   */
+  template<typename T>
+  class OneShot
+  {
+    /// nullptr, the continuation waiting for the value, or fulfilled().
+    std::atomic<Work*> continuation{nullptr};
+
+    std::optional<T> val;
+
+    /// One for each end-point, the reader's is dropped by the continuation.
+    std::atomic<size_t> rc{2};
+
+    OneShot() = default;
+
+    static Work* fulfilled()
+    {
+      return reinterpret_cast<Work*>(uintptr_t(1));
+    }
+
+    void release()
+    {
+      if (rc.fetch_sub(1, std::memory_order_acq_rel) == 1)
+      {
+        this->~OneShot();
+        heap::dealloc(this, sizeof(OneShot));
+      }
+    }
+
+    /**
+     * Publish the value, if any, and schedule the continuation if it is
+     * already waiting.
+     */
+    void complete()
+    {
+      Work* w = continuation.exchange(fulfilled(), std::memory_order_acq_rel);
+      if (w != nullptr)
+        Scheduler::schedule(w);
+      release();
+    }
+
+  public:
+    /**
+     * The read end-point. Consumed by then().
+     */
+    class OneShotR
+    {
+      friend class OneShot;
+
+      OneShot* oneshot;
+
+      OneShotR(OneShot* o) : oneshot(o) {}
+
+    public:
+      OneShotR() : oneshot(nullptr) {}
+
+      OneShotR(OneShotR&& old) : oneshot(old.oneshot)
+      {
+        old.oneshot = nullptr;
+      }
+
+      OneShotR(const OneShotR&) = delete;
+      OneShotR& operator=(const OneShotR&) = delete;
+
+      OneShotR& operator=(OneShotR&& old)
+      {
+        if (oneshot)
+          oneshot->release();
+        oneshot = old.oneshot;
+        old.oneshot = nullptr;
+        return *this;
+      }
+
+      ~OneShotR()
+      {
+        if (oneshot)
+          oneshot->release();
+      }
+
+      /**
+       * Run `fn` with the value once it has been fulfilled, as a Work item
+       * of its own.
+       */
+      template<
+        typename F,
+        typename = std::enable_if_t<std::is_invocable_v<F, std::optional<T>>>>
+      void then(F&& fn) &&
+      {
+        OneShot* o = oneshot;
+        oneshot = nullptr;
+
+        Work* w = Closure::make([fn = std::forward<F>(fn), o](Work*) mutable {
+          fn(std::move(o->val));
+          o->release();
+          return true;
+        });
+
+        Work* expected = nullptr;
+        if (!o->continuation.compare_exchange_strong(
+              expected, w, std::memory_order_acq_rel))
+          Scheduler::schedule(w);
+      }
+    };
+
+    /**
+     * The write end-point. Consumed by fulfill().
+     */
+    class OneShotW
+    {
+      friend class OneShot;
+
+      OneShot* oneshot;
+
+      OneShotW(OneShot* o) : oneshot(o) {}
+
+    public:
+      OneShotW() : oneshot(nullptr) {}
+
+      OneShotW(OneShotW&& old) : oneshot(old.oneshot)
+      {
+        old.oneshot = nullptr;
+      }
+
+      OneShotW(const OneShotW&) = delete;
+      OneShotW& operator=(const OneShotW&) = delete;
+
+      OneShotW& operator=(OneShotW&& old)
+      {
+        if (oneshot)
+          oneshot->complete();
+        oneshot = old.oneshot;
+        old.oneshot = nullptr;
+        return *this;
+      }
+
+      ~OneShotW()
+      {
+        if (oneshot)
+          oneshot->complete();
+      }
+    };
+
+    /**
+     * Create a one-shot future and get its read and write end-points.
+     */
+    static std::pair<OneShotR, OneShotW> create_oneshot()
+    {
+      auto* o = new (heap::alloc(sizeof(OneShot))) OneShot;
+      return std::make_pair(OneShotR(o), OneShotW(o));
+    }
+
+    /**
+     * Fulfill the future with a value, scheduling its continuation if it
+     * has one.
+     */
+    static void fulfill(OneShotW&& wp, T&& v)
+    {
+      OneShotW tmp = std::move(wp);
+      tmp.oneshot->val.emplace(std::move(v));
+      OneShot* o = tmp.oneshot;
+      tmp.oneshot = nullptr;
+      o->complete();
+    }
+  };
+} // namespace verona::rt
@@ -0,0 +1,390 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "vobject.h"
+
+#include <array>
+#include <cstring>
+#include <string_view>
+#include <type_traits>
+
+namespace verona::rt
+{
+  /**
+   * Untraced byte buffers allocated as objects of the current region, so
+   * that the memory behind a container is counted, laid out and freed like
+   * the rest of the region: bump allocated in Arena and SemiSpace regions,
+   * and tracked in Trace regions.
+   *
+   * A buffer is an object with no fields, whose size is the requested
+   * size rounded up to a power of two, so that a descriptor per size class
+   * covers every buffer. Its body starts at its object pointer, so the
+   * pointer to the data is the pointer to the object. It lives as long as
+   * something traces it, as objects do. In Rc regions, the reference it is
+   * created with belongs to whoever holds the buffer, and free() drops it;
+   * elsewhere free() does nothing, and the collector reclaims the buffer.
+   * Nor does it outside an open region, as when a container is destroyed
+   * while its region is released, which frees the buffer anyway.
+   */
+  class RegionBuffer
+  {
+    static constexpr size_t MIN_BITS = 4;
+    static constexpr size_t CLASSES = 40;
+
+    static void trace(const Object*, ObjectStack&) {}
+
+    // A buffer has no references, but a relocate keeps collectors from
+    // scanning its body for them.
+    static void relocate(Object*, Object* (*)(Object*)) {}
+
+    static const Descriptor* desc(size_t size_class)
+    {
+      static const auto descs = []() {
+        std::array<Descriptor, CLASSES> d{};
+        for (size_t i = 0; i < CLASSES; i++)
+        {
+          d[i].size = sizeof(Object::Header) + (size_t(1) << (MIN_BITS + i));
+          d[i].trace = trace;
+          d[i].relocate = relocate;
+        }
+        return d;
+      }();
+      return &descs[size_class];
+    }
+
+  public:
+    /// Bytes a buffer of at least `bytes` bytes holds.
+    static size_t capacity_for(size_t bytes)
+    {
+      return size_t(1) << (MIN_BITS + size_class(bytes));
+    }
+
+    static size_t size_class(size_t bytes)
+    {
+      size_t c = 0;
+      while ((size_t(1) << (MIN_BITS + c)) < bytes)
+      {
+        if (++c == CLASSES)
+          abort();
+      }
+      return c;
+    }
+
+    /// A buffer of at least `bytes` bytes in the current region.
+    static Object* alloc(size_t bytes)
+    {
+      assert(api::RegionContext::is_open());
+      return api::create_object(desc(size_class(bytes)));
+    }
+
+    /// Give up the buffer `b`, of the current region.
+    static void free(Object* b)
+    {
+      if (
+        api::RegionContext::is_open() &&
+        (api::RegionContext::get_region_type() == RegionType::Rc))
+        api::decref(b);
+    }
+
+    /// The buffer whose data starts at `p`.
+    static Object* of(const void* p)
+    {
+      return (Object*)p;
+    }
+  };
+
+  /**
+   * A standard allocator whose memory is RegionBuffers of the current
+   * region, for standard containers in region objects. The region must be
+   * open whenever the container allocates or frees.
+   *
+   * The object holding the container must trace its buffer, as
+   * `st.push(RegionBuffer::of(v.data()))`, or a collection frees it. A
+   * standard container cannot be told that its buffer moved, so this only
+   * suits regions that do not move objects, Trace and Rc regions; rvector
+   * suits all of them.
+   */
+  template<typename T>
+  class region_allocator
+  {
+  public:
+    using value_type = T;
+
+    region_allocator() = default;
+
+    template<typename U>
+    region_allocator(const region_allocator<U>&)
+    {}
+
+    T* allocate(size_t n)
+    {
+      static_assert(alignof(T) <= Object::ALIGNMENT);
+      return (T*)RegionBuffer::alloc(n * sizeof(T));
+    }
+
+    void deallocate(T* p, size_t)
+    {
+      RegionBuffer::free(RegionBuffer::of(p));
+    }
+
+    template<typename U>
+    bool operator==(const region_allocator<U>&) const
+    {
+      return true;
+    }
+
+    template<typename U>
+    bool operator!=(const region_allocator<U>&) const
+    {
+      return false;
+    }
+  };
+
+  /**
+   * A vector whose elements are kept in a RegionBuffer of the region of
+   * the object that holds it. The object's trace and relocate must call
+   * the vector's, as for RegionPool; they visit the buffer, and the
+   * elements too if they are references to objects, so that moving
+   * collectors update both. The region must be open whenever the vector
+   * grows, and in Rc regions whenever it shrinks or is cleared.
+   *
+   * Elements are copied bytewise and never destroyed, so they must be
+   * trivially copyable. Reference elements are written with set(), which
+   * goes through store(), and in Rc regions are counted as fields are: the
+   * caller increfs and decrefs for them.
+   *
+   * In SemiSpace, Generational and Compact regions, an allocation may move
+   * every object but the entry point, the one holding the vector included.
+   * Unless the vector is in the entry point, make room for its new buffer
+   * with region_ensure_available() before it grows, and find it again.
+   */
+  template<typename T>
+  class rvector
+  {
+    static_assert(std::is_trivially_copyable_v<T>);
+    static_assert(alignof(T) <= Object::ALIGNMENT);
+
+    static constexpr bool is_ref = std::is_pointer_v<T> &&
+      std::is_base_of_v<Object, std::remove_pointer_t<T>>;
+
+    Object* buf = nullptr;
+    size_t size_ = 0;
+    size_t capacity_ = 0;
+
+    T* elems() const
+    {
+      return (T*)buf;
+    }
+
+  public:
+    rvector() = default;
+    rvector(const rvector&) = delete;
+    rvector& operator=(const rvector&) = delete;
+
+    size_t size() const
+    {
+      return size_;
+    }
+
+    size_t capacity() const
+    {
+      return capacity_;
+    }
+
+    bool empty() const
+    {
+      return size_ == 0;
+    }
+
+    T* data() const
+    {
+      return elems();
+    }
+
+    T* begin() const
+    {
+      return elems();
+    }
+
+    T* end() const
+    {
+      return elems() + size_;
+    }
+
+    T& operator[](size_t i) const
+    {
+      assert(i < size_);
+      return elems()[i];
+    }
+
+    T& back() const
+    {
+      assert(size_ > 0);
+      return elems()[size_ - 1];
+    }
+
+    /// Write the reference `value` to element `i`.
+    void set(size_t i, T value)
+    {
+      static_assert(is_ref);
+      assert(i < size_);
+      api::store(elems()[i], value);
+    }
+
+    void reserve(size_t n)
+    {
+      if (n <= capacity_)
+        return;
+
+      size_t cap = RegionBuffer::capacity_for(n * sizeof(T)) / sizeof(T);
+      Object* next = RegionBuffer::alloc(cap * sizeof(T));
+      if (buf != nullptr)
+      {
+        std::memcpy((void*)next, elems(), size_ * sizeof(T));
+        RegionBuffer::free(buf);
+      }
+      api::store(buf, next);
+      capacity_ = cap;
+    }
+
+    void push_back(T value)
+    {
+      if (size_ == capacity_)
+        reserve(size_ == 0 ? 4 : size_ * 2);
+      elems()[size_++] = value;
+    }
+
+    void pop_back()
+    {
+      assert(size_ > 0);
+      size_--;
+    }
+
+    /// Resize to `n` elements, setting new ones to `value`.
+    void resize(size_t n, T value = T())
+    {
+      reserve(n);
+      for (size_t i = size_; i < n; i++)
+        elems()[i] = value;
+      size_ = n;
+    }
+
+    /// Remove every element, and give up the buffer.
+    void clear()
+    {
+      if (buf != nullptr)
+        RegionBuffer::free(buf);
+      buf = nullptr;
+      size_ = 0;
+      capacity_ = 0;
+    }
+
+    void trace(ObjectStack& st) const
+    {
+      if (buf == nullptr)
+        return;
+      st.push(buf);
+      if constexpr (is_ref)
+      {
+        for (T o : *this)
+        {
+          if (o != nullptr)
+            st.push(o);
+        }
+      }
+    }
+
+    void relocate(Object* (*fwd)(Object*))
+    {
+      if (buf == nullptr)
+        return;
+      // The elements are forwarded in the buffer's copy.
+      buf = fwd(buf);
+      if constexpr (is_ref)
+      {
+        for (T& o : *this)
+        {
+          if (o != nullptr)
+            o = (T)fwd(o);
+        }
+      }
+    }
+  };
+
+  /**
+   * A string kept in a RegionBuffer, as rvector keeps its elements, and
+   * with the same rules for the object holding it. It is kept terminated,
+   * so that c_str() needs no copy.
+   */
+  class rstring
+  {
+    rvector<char> chars;
+
+  public:
+    size_t size() const
+    {
+      return chars.empty() ? 0 : chars.size() - 1;
+    }
+
+    bool empty() const
+    {
+      return size() == 0;
+    }
+
+    const char* c_str() const
+    {
+      return chars.empty() ? "" : chars.data();
+    }
+
+    std::string_view view() const
+    {
+      return {c_str(), size()};
+    }
+
+    operator std::string_view() const
+    {
+      return view();
+    }
+
+    void append(std::string_view s)
+    {
+      size_t n = size();
+      chars.resize(n + s.size() + 1);
+      std::memcpy(chars.data() + n, s.data(), s.size());
+      chars[n + s.size()] = '\0';
+    }
+
+    void push_back(char c)
+    {
+      append(std::string_view(&c, 1));
+    }
+
+    rstring& operator=(std::string_view s)
+    {
+      chars.resize(0);
+      append(s);
+      return *this;
+    }
+
+    bool operator==(std::string_view s) const
+    {
+      return view() == s;
+    }
+
+    void clear()
+    {
+      chars.clear();
+    }
+
+    void trace(ObjectStack& st) const
+    {
+      chars.trace(st);
+    }
+
+    void relocate(Object* (*fwd)(Object*))
+    {
+      chars.relocate(fwd);
+    }
+  };
+} // namespace verona::rt
@@ -2,10 +2,15 @@
 // SPDX-License-Identifier: MIT
 #pragma once
 
+#include "../boc/cownpool.h"
 #include "../region/region_api.h"
 
+#include <initializer_list>
 #include <new>
 #include <type_traits>
+#include <typeinfo>
+#include <utility>
+#include <vector>
 
 namespace verona::rt
 {
@@ -42,6 +47,101 @@ namespace verona::rt
   struct has_relocate<T, std::void_t<decltype(&T::relocate)>> : std::true_type
   {};
 
+  template<class T, class = void>
+  struct has_pointer_fields : std::false_type
+  {};
+  template<class T>
+  struct has_pointer_fields<T, std::void_t<decltype(&T::pointer_fields)>>
+  : std::true_type
+  {};
+
+  /**
+   * Build a Descriptor::pointer_map from the byte offsets of a type's
+   * reference fields, for its `static constexpr uint64_t pointer_fields()`:
+   *
+   *   return field_map({offsetof(Node, left), offsetof(Node, right)});
+   *
+   * Every offset must be pointer-aligned and within the first 64 words.
+   */
+  constexpr uint64_t field_map(std::initializer_list<size_t> offsets)
+  {
+    uint64_t map = 0;
+    for (size_t offset : offsets)
+    {
+      assert(offset % sizeof(Object*) == 0);
+      assert(offset / sizeof(Object*) < 64);
+      map |= uint64_t(1) << (offset / sizeof(Object*));
+    }
+    return map;
+  }
+
+  /**
+   * Build a Descriptor::pointer_map for an array of `count` reference
+   * fields starting at byte offset `offset`.
+   */
+  constexpr uint64_t field_map(size_t offset, size_t count)
+  {
+    uint64_t map = 0;
+    for (size_t i = 0; i < count; i++)
+      map |= field_map({offset + i * sizeof(Object*)});
+    return map;
+  }
+
+  /**
+   * A type can instead name its reference fields once, in a method that
+   * calls a visitor on each of them, null or not:
+   *
+   *   template<typename F>
+   *   void fields(F&& f)
+   *   {
+   *     f(left);
+   *     f(right);
+   *   }
+   *
+   * V derives both the trace and the relocate function of the type from
+   * it, so a copying collector updates exactly those fields, and the type
+   * needs neither method.
+   */
+  struct AnyField
+  {
+    template<typename F>
+    void operator()(F*&) const
+    {}
+  };
+
+  template<class T, class = void>
+  struct has_fields : std::false_type
+  {};
+  template<class T>
+  struct has_fields<
+    T,
+    std::void_t<decltype(std::declval<T&>().fields(AnyField{}))>>
+  : std::true_type
+  {};
+
+  template<class T, class = void>
+  struct has_intern_hash : std::false_type
+  {};
+  template<class T>
+  struct has_intern_hash<T, std::void_t<decltype(&T::intern_hash)>>
+  : std::true_type
+  {};
+
+  template<class T, class = void>
+  struct has_intern_equals : std::false_type
+  {};
+  template<class T>
+  struct has_intern_equals<T, std::void_t<decltype(&T::intern_equals)>>
+  : std::true_type
+  {};
+
+  template<class T, class = void>
+  struct has_tail : std::false_type
+  {};
+  template<class T>
+  struct has_tail<T, std::void_t<typename T::TailElement>> : std::true_type
+  {};
+
   template<class T>
   struct has_destructor
   {
@@ -58,7 +158,24 @@ namespace verona::rt
   private:
     static void gc_trace(const Object* o, ObjectStack& st)
     {
-      ((T*)o)->trace(st);
+      if constexpr (has_fields<T>::value)
+      {
+        ((T*)o)->fields([&st](auto*& field) {
+          if (field != nullptr)
+            st.push(field);
+        });
+      }
+      else
+        ((T*)o)->trace(st);
+      if constexpr (tail_is_ref())
+      {
+        T* t = (T*)o;
+        for (size_t i = 0; i < t->tail_size(); i++)
+        {
+          if (t->tail()[i] != nullptr)
+            st.push(t->tail()[i]);
+        }
+      }
     }
 
     static void gc_notified(Object* o)
@@ -92,13 +209,84 @@ namespace verona::rt
     {
       if constexpr (has_relocate<T>::value)
         ((T*)o)->relocate(forward);
-      else
+      if constexpr (has_fields<T>::value)
+      {
+        ((T*)o)->fields([forward](auto*& field) {
+          using F = std::remove_reference_t<decltype(field)>;
+          if (field != nullptr)
+            field = (F)forward(field);
+        });
+      }
+      if constexpr (tail_is_ref())
+      {
+        T* t = (T*)o;
+        for (size_t i = 0; i < t->tail_size(); i++)
+        {
+          auto& e = t->tail()[i];
+          if (e != nullptr)
+            e = (typename T::TailElement)forward(e);
+        }
+      }
+      if constexpr (
+        !has_relocate<T>::value && !has_fields<T>::value && !tail_is_ref())
       {
         UNUSED(o);
         UNUSED(forward);
       }
     }
 
+    static size_t gc_hash(const Object* o)
+    {
+      if constexpr (has_intern_hash<T>::value)
+        return ((const T*)o)->intern_hash();
+      else
+      {
+        UNUSED(o);
+        return 0;
+      }
+    }
+
+    static bool gc_equals(const Object* o, const Object* that)
+    {
+      if constexpr (has_intern_equals<T>::value)
+        return ((const T*)o)->intern_equals(*(const T*)that);
+      else
+      {
+        UNUSED(o);
+        UNUSED(that);
+        return false;
+      }
+    }
+
+    /// Whether the trailing array, if there is one, holds references.
+    static constexpr bool tail_is_ref()
+    {
+      if constexpr (has_tail<T>::value)
+      {
+        using E = typename T::TailElement;
+        return std::is_pointer_v<E> &&
+          std::is_base_of_v<Object, std::remove_pointer_t<E>>;
+      }
+      else
+        return false;
+    }
+
+    static constexpr size_t tail_element_size()
+    {
+      if constexpr (has_tail<T>::value)
+        return sizeof(typename T::TailElement);
+      else
+        return 0;
+    }
+
+    static constexpr uint64_t pointer_map()
+    {
+      if constexpr (has_pointer_fields<T>::value)
+        return T::pointer_fields();
+      else
+        return 0;
+    }
+
     void trace(ObjectStack&) {}
 
   public:
@@ -112,7 +300,23 @@ namespace verona::rt
         has_finaliser<T>::value ? gc_final : nullptr,
         has_notified<T>::value ? gc_notified : nullptr,
         has_destructor<T>::value ? gc_destructor : nullptr,
-        has_relocate<T>::value ? gc_relocate : nullptr};
+        (has_relocate<T>::value || has_fields<T>::value || tail_is_ref()) ?
+          gc_relocate :
+          nullptr,
+        pointer_map(),
+        has_intern_hash<T>::value ? gc_hash : nullptr,
+        has_intern_equals<T>::value ? gc_equals : nullptr,
+        tail_element_size(),
+        typeid(T).name()};
+      static_assert(
+        has_intern_hash<T>::value == has_intern_equals<T>::value,
+        "intern_hash and intern_equals must be defined together");
+      static_assert(
+        !has_fields<T>::value || !has_relocate<T>::value,
+        "fields() replaces relocate");
+      static_assert(
+        !has_pointer_fields<T>::value || !tail_is_ref(),
+        "a pointer map cannot name the references in a trailing array");
 
       return &desc;
     }
@@ -145,6 +349,13 @@ namespace verona::rt
       // region.
     }
 
+    void operator delete(void*, RegionType, size_t)
+    {
+      // Should not be called directly, present to allow calling if the
+      // constructor throws an exception. The object lifetime is managed by the
+      // region.
+    }
+
     void* operator new[](size_t size) = delete;
     void operator delete[](void* p) = delete;
     void operator delete[](void* p, size_t sz) = delete;
@@ -163,13 +374,197 @@ namespace verona::rt
 
     void* operator new(size_t)
     {
-      return api::create_object(VBase<T, Object>::desc());
+      return api::create_object<vsizeof<T>>(VBase<T, Object>::desc());
     }
 
     void* operator new(size_t, RegionType rt)
     {
       return api::create_fresh_region<V>(rt, V::desc());
     }
+
+    void* operator new(size_t, RegionType rt, size_t large_object_threshold)
+    {
+      return api::create_fresh_region<V>(rt, V::desc(), large_object_threshold);
+    }
+
+    void* operator new(size_t, RegionType rt, const RegionHints& hints)
+    {
+      return api::create_fresh_region<V>(rt, V::desc(), hints);
+    }
+
+    void* operator new(size_t, RegionArena::ChunkConfig config)
+    {
+      return api::create_fresh_arena_region<V>(V::desc(), config);
+    }
+  };
+
+  /**
+   * Converts a C++ class into a variable sized Verona object, whose fields
+   * are followed, in the same allocation, by an array of `Elem` whose length
+   * is chosen when the object is created by create_object_with_tail().
+   *
+   * The elements are never destroyed, and moving collectors copy them
+   * bytewise. If they are references to objects, they are traced and
+   * relocated after the fields, and in Rc regions are counted as fields
+   * are. A trailing array of references cannot be combined with
+   * `pointer_fields`.
+   */
+  template<class T, class Elem>
+  class VTail : public VBase<T, Object>
+  {
+    static_assert(std::is_trivially_copyable_v<Elem>);
+    static_assert(std::is_trivially_destructible_v<Elem>);
+    static_assert(alignof(Elem) <= Object::ALIGNMENT);
+
+    template<class U, typename... Args>
+    friend U* create_object_with_tail(size_t n, Args&&... args);
+
+    // The region writes the length when it allocates the object, so that
+    // its size is known before the constructor runs, and this is not
+    // initialised here.
+    size_t tail_length;
+
+  public:
+    using TailElement = Elem;
+
+    VTail() : VBase<T, Object>() {}
+
+    size_t tail_size() const
+    {
+      return tail_length;
+    }
+
+    Elem* tail() const
+    {
+      // The array starts at the end of the fixed size part of the object.
+      return (Elem*)((std::byte*)this + vsizeof<T> - sizeof(Object::Header));
+    }
+  };
+
+  /**
+   * Create an object of the variable sized type `T` in the current region,
+   * with `n` value-initialised elements in its trailing array, constructed
+   * from `args`.
+   */
+  template<class T, typename... Args>
+  T* create_object_with_tail(size_t n, Args&&... args)
+  {
+    using Elem = typename T::TailElement;
+    static_assert(std::is_base_of_v<VTail<T, Elem>, T>);
+    Object* o = api::create_object_with_tail(T::desc(), n);
+    T* t = ::new (static_cast<void*>(o)) T(std::forward<Args>(args)...);
+    // Value-initialising `T` may have cleared the length.
+    static_cast<VTail<T, Elem>*>(t)->tail_length = n;
+    Elem* e = t->tail();
+    for (size_t i = 0; i < n; i++)
+      ::new (static_cast<void*>(&e[i])) Elem();
+    return t;
+  }
+
+  /**
+   * Create `n` objects of type `T` in the current region, storing them in
+   * `out[0..n)`. Each is default-constructed, as by `new T`, but the region
+   * allocates them as one batch (see api::create_objects).
+   */
+  template<class T>
+  void alloc_many(size_t n, T** out)
+  {
+    static_assert(std::is_base_of_v<V<T>, T>);
+    static_assert(std::is_default_constructible_v<T>);
+    api::create_objects(T::desc(), n, reinterpret_cast<Object**>(out));
+    for (size_t i = 0; i < n; i++)
+      ::new (static_cast<void*>(out[i])) T();
+  }
+
+  /**
+   * Create an object of type `T` in the current region, constructed from
+   * `args`, as `new T` does, unless that would take the region over its
+   * hard quota, when it returns nullptr having created nothing (see
+   * RegionQuota).
+   */
+  template<class T, typename... Args>
+  T* try_new(Args&&... args)
+  {
+    static_assert(std::is_base_of_v<V<T>, T>);
+    Object* o = api::try_create_object<vsizeof<T>>(T::desc());
+    if (o == nullptr)
+      return nullptr;
+    return ::new (static_cast<void*>(o)) T(std::forward<Args>(args)...);
+  }
+
+  /**
+   * A free list of dead objects of type `T` in one region, handed out again
+   * by make() in place of new allocations, so that short-lived objects of a
+   * hot type cost neither an allocation nor a free by the collector.
+   *
+   * The pool belongs to an object of the region, usually its entry point,
+   * whose trace and relocate must call the pool's, so that pooled objects
+   * stay alive and follow moving collectors. Recycle an object only once
+   * nothing else refers to it; in rc regions, with the reference it was
+   * created with as its only one, which the pool then holds. Its fields are
+   * left as they are until make() destroys it and constructs a new `T` in
+   * its place, so clear its pointers first if what they refer to should be
+   * collected. A reused object may be older than the objects it is made to
+   * refer to, so write its pointer fields with store() in generational
+   * regions.
+   */
+  template<class T>
+  class RegionPool
+  {
+    std::vector<T*> free_;
+    size_t reused = 0;
+    size_t allocated = 0;
+
+  public:
+    /// A `T` made from `args`, reusing a pooled object if there is one.
+    template<typename... Args>
+    T* make(Args&&... args)
+    {
+      if (free_.empty())
+      {
+        allocated++;
+        return new T(std::forward<Args>(args)...);
+      }
+
+      T* o = free_.back();
+      free_.pop_back();
+      reused++;
+      o->~T();
+      return ::new (static_cast<void*>(o)) T(std::forward<Args>(args)...);
+    }
+
+    /// Return `o`, which must be dead, to the pool.
+    void recycle(T* o)
+    {
+      free_.push_back(o);
+    }
+
+    size_t size() const
+    {
+      return free_.size();
+    }
+
+    size_t get_reused() const
+    {
+      return reused;
+    }
+
+    size_t get_allocated() const
+    {
+      return allocated;
+    }
+
+    void trace(ObjectStack& st) const
+    {
+      for (T* o : free_)
+        st.push(o);
+    }
+
+    void relocate(Object* (*fwd)(Object*))
+    {
+      for (T*& o : free_)
+        o = (T*)fwd(o);
+    }
   };
 
   /**
@@ -186,7 +581,20 @@ namespace verona::rt
     void* operator new(size_t)
     {
       return Object::register_object(
-        heap::alloc<vsizeof<T>>(), VBase<T, Cown>::desc());
+        CownPool::alloc(vsizeof<T>), VBase<T, Cown>::desc());
     }
   };
 } // namespace verona::rt
+
+namespace verona::cpp
+{
+  /**
+   * Stores into and loads from the reference fields of V<> objects in the
+   * current region that go through the collectors' barriers: the write
+   * barrier of incremental, concurrent and sticky marking, and the read
+   * barrier of incremental copying (see rt::api::store() and
+   * rt::api::load()).
+   */
+  using rt::api::load;
+  using rt::api::store;
+} // namespace verona::cpp
@@ -2,10 +2,12 @@
 // SPDX-License-Identifier: MIT
 #pragma once
 
+#include "../boc/fusion.h"
 #include "behaviour.h"
 #include "cown.h"
 #include "cown_array.h"
 
+#include <chrono>
 #include <functional>
 #include <tuple>
 #include <utility>
@@ -99,8 +101,11 @@ namespace verona::cpp
     {
       constr_helper(ptr_span);
 
+      // The references the cown_ptrs held now belong to the behaviour, so
+      // free their array without destroying them.
+      heap::dealloc(ptr_span.array);
       ptr_span.length = 0;
-      ptr_span.arary = nullptr;
+      ptr_span.array = nullptr;
     }
 
     AccessBatch(AccessBatch&& old)
@@ -149,6 +154,29 @@ namespace verona::cpp
     return AccessBatch<T>(c);
   }
 
+  template<typename T>
+  auto convert_access(cown_array<T>&& c)
+  {
+    return AccessBatch<T>(std::move(c));
+  }
+
+  /**
+   * Whether `when(cowns...) << f`, for `f` of type F and cowns of types
+   * Cowns, stores its closure inline in the behaviour (see
+   * Behaviour::INLINE_BODY), so that making the behaviour allocates once.
+   * The closure holds `f` and the cowns, so this is checked on both.
+   * Performance sensitive call sites can assert it:
+   *
+   *   static_assert(inline_when<decltype(f), cown_ptr<A>, cown_ptr<B>>());
+   */
+  template<typename F, typename... Cowns>
+  constexpr bool inline_when()
+  {
+    return Behaviour::is_inline<std::tuple<
+      std::decay_t<F>,
+      decltype(convert_access(std::declval<Cowns>()))...>>();
+  }
+
   template<typename... Args>
   class Batch
   {
@@ -167,6 +195,20 @@ namespace verona::cpp
     template<typename... Args2>
     friend class Batch;
 
+    /// Total number of cowns requested by the whens in the batch.
+    static constexpr size_t cown_count()
+    {
+      return (0 + ... + Args::cown_count);
+    }
+
+    /// Whether the number of cowns is statically known, and small enough
+    /// for the specialised paths in schedule_many.
+    static constexpr bool small_cowns()
+    {
+      return (true && ... && Args::static_cown_count) &&
+        (cown_count() > 0) && (cown_count() <= BehaviourCore::SMALL_COWNS);
+    }
+
     template<size_t index = 0>
     void create_behaviour(BehaviourCore** barray)
     {
@@ -184,6 +226,7 @@ namespace verona::cpp
           std::move(std::get<0>(t)),
           std::move(std::get<1>(t)),
           std::move(std::get<2>(t)));
+        barray[index]->set_priority(w.priority);
         create_behaviour<index + 1>(barray);
       }
     }
@@ -203,7 +246,10 @@ namespace verona::cpp
         BehaviourCore* barray[sizeof...(Args)];
         create_behaviour(barray);
 
-        BehaviourCore::schedule_many(barray, sizeof...(Args));
+        if constexpr (small_cowns())
+          BehaviourCore::schedule_many<cown_count()>(barray, sizeof...(Args));
+        else
+          BehaviourCore::schedule_many(barray, sizeof...(Args));
       }
     }
 
@@ -245,6 +291,13 @@ namespace verona::cpp
     template<typename... Args2>
     friend class Batch;
 
+    /// Whether cown_count is the number of cowns, that is, no argument is a
+    /// cown_array.
+    static constexpr bool static_cown_count = !(is_batch<Args>::value || ...);
+
+    /// Number of cown arguments, each cown_array counting as one.
+    static constexpr size_t cown_count = sizeof...(Args);
+
     /// Set of cowns used by this behaviour.
     std::tuple<Args...> cown_tuple;
 
@@ -263,6 +316,9 @@ namespace verona::cpp
     Request* req_extended;
     bool is_req_extended;
 
+    /// The class of queue the behaviour is scheduled on.
+    Priority priority = Priority::High;
+
     /**
      * This uses template programming to turn the std::tuple into a C style
      * stack allocated array.
@@ -393,12 +449,14 @@ namespace verona::cpp
           r,
           [f = std::move(f), cown_tuple = std::move(cown_tuple)]() mutable {
             /// Effectively converts ActualCown<T>... to
-            /// acquired_cown... .
-            auto lift_f = [f = std::move(f)](Args... args) mutable {
-              std::move(f)(access_to_acquired<typename Args::Type>(args)...);
+            /// acquired_cown... . Neither the closure nor the cowns are
+            /// moved out, so that a behaviour that yields its turn (see
+            /// Behaviour::yield_turn()) runs again with both intact.
+            auto lift_f = [&f](Args&... args) {
+              f(access_to_acquired<typename Args::Type>(args)...);
             };
 
-            std::apply(std::move(lift_f), std::move(cown_tuple));
+            std::apply(lift_f, cown_tuple);
           });
       }
     }
@@ -406,10 +464,11 @@ namespace verona::cpp
   public:
     When(F&& f_) : f(std::forward<F>(f_)) {}
 
-    When(F&& f_, std::tuple<Args...> cown_tuple_)
-    : f(std::forward<F>(f_)),
-      cown_tuple(std::move(cown_tuple_)),
-      is_req_extended(false)
+    When(F&& f_, std::tuple<Args...> cown_tuple_, Priority priority_)
+    : cown_tuple(std::move(cown_tuple_)),
+      f(std::forward<F>(f_)),
+      is_req_extended(false),
+      priority(priority_)
     {
       const size_t req_count = get_cown_count();
       if (req_count > sizeof...(Args))
@@ -423,8 +482,9 @@ namespace verona::cpp
     When(When&& o)
     : cown_tuple(std::move(o.cown_tuple)),
       f(std::forward<F>(o.f)),
+      req_extended(o.req_extended),
       is_req_extended(o.is_req_extended),
-      req_extended(o.req_extended)
+      priority(o.priority)
     {
       o.req_extended = nullptr;
       o.is_req_extended = false;
@@ -458,7 +518,7 @@ namespace verona::cpp
   {
     // Note only requires friend when Args2 == Args
     // but C++ doesn't like this.
-    template<typename... Args2>
+    template<Priority, typename... Args2>
     friend auto when(Args2&&... args);
 
     /**
@@ -467,7 +527,11 @@ namespace verona::cpp
      */
     std::tuple<Args...> cown_tuple;
 
-    PreWhen(Args... args) : cown_tuple(std::move(args)...) {}
+    Priority priority;
+
+    PreWhen(Priority priority, Args... args)
+    : cown_tuple(std::move(args)...), priority(priority)
+    {}
 
   public:
     template<typename F>
@@ -478,13 +542,13 @@ namespace verona::cpp
       if constexpr (sizeof...(Args) == 0)
       {
         // Execute now atomic batch makes no sense.
-        verona::rt::schedule_lambda(std::forward<F>(f));
+        verona::rt::schedule_lambda(std::forward<F>(f), priority);
         return Batch(std::make_tuple());
       }
       else
       {
-        return Batch(
-          std::make_tuple(When(std::forward<F>(f), std::move(cown_tuple))));
+        return Batch(std::make_tuple(
+          When(std::forward<F>(f), std::move(cown_tuple), priority)));
       }
     }
   };
@@ -511,11 +575,317 @@ namespace verona::cpp
    * cown_array<A1>&& )... To get the universal reference type to work, we
    * can't place this constraint on it directly, as it needs to be on a type
    * argument.
+   *
+   * A cown_ptr or cown_array passed with std::move gives its references to
+   * the behaviour, which releases them when it has run, so scheduling it
+   * takes out no new ones:
+   *
+   *   when(std::move(cown1)) << closure;
+   *
+   * The behaviour is high priority unless `priority` says otherwise:
+   *
+   *   when<Priority::Low>(cown1, ..., cownn) << closure;
    */
-  template<typename... Args>
+  template<Priority priority = Priority::High, typename... Args>
   auto when(Args&&... args)
   {
-    return PreWhen(convert_access(std::forward<Args>(args))...);
+    return PreWhen(priority, convert_access(std::forward<Args>(args))...);
+  }
+
+  /**
+   * Class for staging a delayed when. Do not call directly use
+   * `when_after`.
+   */
+  template<typename... Args>
+  class DelayedWhen
+  {
+    template<typename Rep, typename Period, typename... Args2>
+    friend auto
+    when_after(std::chrono::duration<Rep, Period> delay, Args2&&... args);
+
+    uint64_t delay_ns;
+
+    std::tuple<Args...> cown_tuple;
+
+    DelayedWhen(uint64_t delay_ns, Args... args)
+    : delay_ns(delay_ns), cown_tuple(std::move(args)...)
+    {}
+
+  public:
+    template<typename F>
+    void operator<<(F&& f)
+    {
+      Work* w = Closure::make(
+        [cown_tuple = std::move(cown_tuple),
+         f = std::forward<F>(f)](Work*) mutable {
+          std::apply(
+            [&f](auto&... cowns) { when(std::move(cowns)...) << std::move(f); },
+            cown_tuple);
+          return true;
+        });
+      Scheduler::schedule_after(delay_ns, w);
+    }
+  };
+
+  /**
+   * Like `when(cowns...) << closure`, but the behaviour is only scheduled
+   * once `delay` has passed, and so acquires its cowns after that:
+   *
+   *   when_after(std::chrono::milliseconds(10), cown1) << closure;
+   *
+   * The delay is kept by a timer on the wheel of the scheduler thread that
+   * asked for it (see TimerWheel), so arming it is O(1), and no thread is
+   * kept awake for it. The behaviour may run up to about a millisecond
+   * late, or later if the thread is busy.
+   */
+  template<typename Rep, typename Period, typename... Args>
+  auto when_after(std::chrono::duration<Rep, Period> delay, Args&&... args)
+  {
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(delay);
+    return DelayedWhen<std::decay_t<Args>...>(
+      ns.count() > 0 ? (uint64_t)ns.count() : 0, std::forward<Args>(args)...);
+  }
+
+  /**
+   * Class for staging a when on a file descriptor. Do not call directly use
+   * `when_ready`.
+   */
+  template<typename T>
+  class ReadyWhen
+  {
+    template<typename TT>
+    friend auto when_ready(int fd, uint32_t interest, cown_ptr<TT>& c);
+
+    int fd;
+    uint32_t interest;
+    cown_ptr<T>& c;
+
+    template<typename F>
+    struct Watch : public FdPoller::Source
+    {
+      cown_ptr<T> c;
+      F f;
+
+      template<typename G>
+      Watch(int fd, uint32_t interest, cown_ptr<T> c, G&& g)
+      : FdPoller::Source{fd, interest, ready},
+        c(std::move(c)),
+        f(std::forward<G>(g))
+      {}
+
+      static void ready(FdPoller::Source* self, uint32_t events)
+      {
+        auto* w = static_cast<Watch*>(self);
+        when(w->c) << [w, events](acquired_cown<T> acq) {
+          if (w->f(acq, events))
+          {
+            FdPoller::rearm(w);
+            return;
+          }
+
+          FdPoller::remove(w);
+          w->~Watch();
+          heap::dealloc(w, sizeof(Watch));
+        };
+      }
+    };
+
+    ReadyWhen(int fd, uint32_t interest, cown_ptr<T>& c)
+    : fd(fd), interest(interest), c(c)
+    {}
+
+  public:
+    template<typename F>
+    void operator<<(F&& f)
+    {
+      using W = Watch<std::remove_reference_t<F>>;
+      auto* w = new (heap::alloc(sizeof(W)))
+        W(fd, interest, c, std::forward<F>(f));
+      Scheduler::add_poll_source(w);
+    }
+  };
+
+  /**
+   * Run a behaviour on `c` each time `fd` is ready for `interest`, one of
+   * or both FdPoller::READABLE and FdPoller::WRITABLE:
+   *
+   *   when_ready(fd, FdPoller::READABLE, c) <<
+   *     [](acquired_cown<T>& c, uint32_t events) { ...; return true; };
+   *
+   * `events` is what `fd` was seen to be ready for, and may include
+   * FdPoller::CLOSED. The closure returns whether to carry on: `fd` is only
+   * polled again once it has returned true, and after it returns false the
+   * closure is destroyed, and `fd` may be closed.
+   *
+   * The scheduler threads poll when they are idle and between batches of
+   * work, and a paused thread waits on `fd` (see FdPoller), so no thread of
+   * its own is needed for it. The behaviour is scheduled on the core of
+   * the thread that saw `fd` ready. The runtime does not finish while any
+   * closure has yet to return false. Only supported on Linux.
+   */
+  template<typename T>
+  auto when_ready(int fd, uint32_t interest, cown_ptr<T>& c)
+  {
+    return ReadyWhen<T>(fd, interest, c);
+  }
+
+  /**
+   * Class for staging a fused when. Do not call directly use `when_batched`.
+   */
+  template<typename T>
+  class BatchedWhen
+  {
+    template<typename TT>
+    friend auto when_batched(cown_ptr<TT>& c);
+
+    cown_ptr<T>& c;
+
+    template<typename F>
+    struct Node : public Fusion::Node
+    {
+      F f;
+
+      template<typename G>
+      Node(G&& g) : Fusion::Node{nullptr, invoke}, f(std::forward<G>(g))
+      {}
+
+      static void invoke(Fusion::Node* self, void* arg)
+      {
+        auto* n = static_cast<Node*>(self);
+        auto* acq = static_cast<acquired_cown<T>*>(arg);
+        n->f(acquired_cown<T>(acq->origin_cown));
+        n->~Node();
+        heap::dealloc(n, sizeof(Node));
+      }
+    };
+
+    BatchedWhen(cown_ptr<T>& c) : c(c) {}
+
+  public:
+    template<typename F>
+    void operator<<(F&& f)
+    {
+      using N = Node<std::remove_reference_t<F>>;
+      auto* n = new (heap::alloc(sizeof(N))) N(std::forward<F>(f));
+
+      const void* key = c.underlying_cown();
+      if (Fusion::append(key, n))
+        return;
+
+      auto* fusion = Fusion::create(n);
+      when(c) << [fusion](acquired_cown<T> acq) { fusion->run(&acq); };
+      Fusion::open(key, fusion);
+    }
+  };
+
+  /**
+   * Like `when(c) << closure`, but if the previous behaviour this thread
+   * scheduled was also a `when_batched` on `c`, and has not started, the
+   * closure is appended to it instead, to run under the same acquisition
+   * of `c`. Closures run in the order they were written:
+   *
+   *   when_batched(c) << closure1;
+   *   when_batched(c) << closure2;
+   *
+   * Scheduling anything else, by any means, and the end of the behaviour or
+   * work item the thread is running, stops further appends, so fusing never
+   * reorders a closure past other work.
+   */
+  template<typename T>
+  auto when_batched(cown_ptr<T>& c)
+  {
+    return BatchedWhen<T>(c);
+  }
+
+  /**
+   * Class for staging an inline when. Do not call directly use
+   * `when_inline`.
+   */
+  template<typename T>
+  class InlineWhen
+  {
+    template<typename TT>
+    friend auto when_inline(cown_ptr<TT>& c);
+
+    cown_ptr<T>& c;
+
+    /// Number of closures running inline on this thread.
+    static size_t& depth()
+    {
+      static thread_local size_t depth = 0;
+      return depth;
+    }
+
+    InlineWhen(cown_ptr<T>& c) : c(c) {}
+
+  public:
+    /// Closures nested deeper than this are scheduled as usual.
+    static constexpr size_t MAX_DEPTH = 8;
+
+    template<typename F>
+    void operator<<(F&& f)
+    {
+      if ((Scheduler::current_core() == nullptr) || (depth() >= MAX_DEPTH))
+      {
+        when(c) << std::forward<F>(f);
+        return;
+      }
+
+      // Closures appended later must not overtake this one.
+      Fusion::close_local();
+
+      Slot slot(c.underlying_cown());
+      switch (BehaviourCore::acquire_inline(&slot))
+      {
+        case BehaviourCore::InlineAcquire::Acquired:
+        {
+          depth()++;
+          f(acquired_cown<T>(*c.allocated_cown));
+          depth()--;
+          BehaviourCore::release_inline(&slot);
+          return;
+        }
+
+        case BehaviourCore::InlineAcquire::Busy:
+        {
+          when(c) << std::forward<F>(f);
+          return;
+        }
+
+        case BehaviourCore::InlineAcquire::Queued:
+        {
+          Scheduler::stats().behaviour(1);
+          Request request = Request::write(c.underlying_cown());
+          auto* b = Behaviour::prepare_to_schedule(
+            1,
+            &request,
+            [f = std::forward<F>(f), c = c]() mutable {
+              f(acquired_cown<T>(*c.allocated_cown));
+            });
+          BehaviourCore::queue_inline(&slot, b);
+          return;
+        }
+      }
+    }
+  };
+
+  /**
+   * Like `when(c) << closure`, but if this is a scheduler thread and `c` is
+   * idle, with nothing queued on it and no readers, the closure runs at once,
+   * on this thread's stack, rather than being allocated as a behaviour and
+   * queued. Otherwise it is scheduled as by `when`:
+   *
+   *   when_inline(session) << [](acquired_cown<Session> s) { ... };
+   *
+   * This makes a call on a private cown a function call. A closure on a
+   * cown the caller holds is scheduled, to run after the caller. A closure
+   * that runs inline must not call Behaviour::yield_turn(), and closures
+   * nested more than InlineWhen::MAX_DEPTH deep are always scheduled.
+   */
+  template<typename T>
+  auto when_inline(cown_ptr<T>& c)
+  {
+    return InlineWhen<T>(c);
   }
 
 } // namespace verona::cpp
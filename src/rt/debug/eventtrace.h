@@ -0,0 +1,482 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <iomanip>
+#include <mutex>
+#include <ostream>
+#include <snmalloc/snmalloc.h>
+#include <thread>
+#include <vector>
+
+namespace verona::rt
+{
+  /**
+   * A binary trace of runtime events, cheap enough to leave on in the hot
+   * paths of the collectors and the scheduler, where Logging::cout() is
+   * compiled out.
+   *
+   * Each thread appends fixed-size records, an event, the processor's tick
+   * counter and up to four arguments, to a ring of its own. Only the owner
+   * writes a ring and only the drain reads it, so a record costs a few
+   * stores and a release, and no lock. A record that finds its ring full is
+   * dropped and counted rather than waiting for the drain. Rings are kept
+   * for the life of the process; a thread that exits leaves its ring for the
+   * next thread to start.
+   *
+   * start() opens a file and a background thread that drains the rings into
+   * it as they fill. The file holds the raw records, which format() sorts by
+   * tick and prints; see `benchmarker --event-trace`. Events are only
+   * recorded when the runtime is built with USE_EVENT_TRACE. Otherwise
+   * `enabled` is false, and the call sites, which test it with
+   * `if constexpr`, compile to nothing.
+   */
+  class EventTrace
+  {
+  public:
+#ifdef USE_EVENT_TRACE
+    static constexpr bool enabled = true;
+#else
+    static constexpr bool enabled = false;
+#endif
+
+    enum class Event : uint32_t
+    {
+      /// Trace region collection: the entry point.
+      RegionGC = 1,
+      /// Trace region collection done: the entry point.
+      RegionGCDone,
+      /// Semispace collection: the entry point, the bytes in use and the
+      /// semispace size.
+      SemiSpaceGC,
+      /// Semispace collection done: the entry point, the bytes that
+      /// survived and the new semispace size.
+      SemiSpaceGCDone,
+      /// Semispace growth: the bytes in use, needed and the semispace size.
+      SemiSpaceGrow,
+      /// A behaviour took a region: the region and its owners before.
+      TaskInc,
+      /// A behaviour let go of a region: the region and its owners before.
+      TaskDec,
+      /// Work about to run on this thread: the work.
+      Schedule,
+      /// Work stolen: the work and the core it came from.
+      Steal,
+      /// A behaviour starts: the behaviour, its number of cowns, and its
+      /// first two cowns.
+      BehaviourStart,
+      /// A behaviour ends: the behaviour.
+      BehaviourEnd,
+      /// A scheduler thread found no work and parks.
+      Park,
+      /// A parked scheduler thread wakes up.
+      Unpark,
+      /// The global epoch advances: the new epoch.
+      EpochAdvance,
+      /// Written by start() and stop() to relate ticks to time: the
+      /// nanoseconds of the steady clock at this tick.
+      Clock,
+    };
+
+    struct Record
+    {
+      uint64_t tick;
+      uint32_t event;
+      uint32_t thread;
+      uint64_t args[4];
+    };
+
+    /// Records each thread's ring holds.
+    static constexpr size_t RING_SIZE = 1 << 14;
+
+    static constexpr char MAGIC[8] = {'V', 'E', 'V', 'T', 'R', 'C', '0', '1'};
+
+  private:
+    struct Ring
+    {
+      /// Written by the owner only.
+      std::atomic<uint64_t> head{0};
+      /// Written by the drain only.
+      std::atomic<uint64_t> tail{0};
+      std::atomic<uint64_t> dropped{0};
+      std::atomic<bool> in_use{true};
+      uint32_t thread;
+      Ring* next = nullptr;
+      Record records[RING_SIZE];
+    };
+
+    struct State
+    {
+      std::atomic<Ring*> rings{nullptr};
+      std::atomic<uint32_t> threads{0};
+      /// Held by whoever drains the rings.
+      std::mutex drain_lock;
+      FILE* file = nullptr;
+      std::thread drainer;
+      std::atomic<bool> running{false};
+    };
+
+    static State& state()
+    {
+      static State s;
+      return s;
+    }
+
+    static Ring* claim()
+    {
+      auto& s = state();
+      for (Ring* r = s.rings.load(std::memory_order_acquire); r != nullptr;
+           r = r->next)
+      {
+        bool free = false;
+        if (r->in_use.compare_exchange_strong(
+              free, true, std::memory_order_acquire))
+          return r;
+      }
+
+      Ring* r = new Ring;
+      r->thread = s.threads.fetch_add(1, std::memory_order_relaxed);
+      r->next = s.rings.load(std::memory_order_relaxed);
+      while (!s.rings.compare_exchange_weak(
+        r->next, r, std::memory_order_release, std::memory_order_relaxed))
+      {}
+      return r;
+    }
+
+    /// Claims a ring on a thread's first record, and frees it on exit.
+    struct Owner
+    {
+      Ring* ring = claim();
+
+      ~Owner()
+      {
+        ring->in_use.store(false, std::memory_order_release);
+      }
+    };
+
+    static Ring* local()
+    {
+      static thread_local Owner owner;
+      return owner.ring;
+    }
+
+    /// Hand every record written so far to `f`, ring by ring.
+    template<typename F>
+    static void drain(F f)
+    {
+      auto& s = state();
+      std::lock_guard<std::mutex> lock(s.drain_lock);
+      for (Ring* r = s.rings.load(std::memory_order_acquire); r != nullptr;
+           r = r->next)
+      {
+        uint64_t head = r->head.load(std::memory_order_acquire);
+        uint64_t tail = r->tail.load(std::memory_order_relaxed);
+        for (uint64_t i = tail; i < head; i++)
+          f(r->records[i % RING_SIZE]);
+        r->tail.store(head, std::memory_order_release);
+      }
+    }
+
+    static void write_all()
+    {
+      FILE* file = state().file;
+      drain([file](const Record& r) { fwrite(&r, sizeof(r), 1, file); });
+    }
+
+    static void write_clock()
+    {
+      Record r{};
+      r.tick = snmalloc::Aal::tick();
+      r.event = (uint32_t)Event::Clock;
+      auto now = std::chrono::steady_clock::now().time_since_epoch();
+      r.args[0] =
+        (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(now)
+          .count();
+      fwrite(&r, sizeof(r), 1, state().file);
+    }
+
+    /// The records of the trace at `path`, in tick order.
+    static bool load(const char* path, std::vector<Record>& records)
+    {
+      FILE* file = fopen(path, "rb");
+      if (file == nullptr)
+        return false;
+      char magic[sizeof(MAGIC)];
+      if (
+        fread(magic, sizeof(magic), 1, file) != 1 ||
+        !std::equal(magic, magic + sizeof(magic), MAGIC))
+      {
+        fclose(file);
+        return false;
+      }
+
+      Record r;
+      while (fread(&r, sizeof(r), 1, file) == 1)
+        records.push_back(r);
+      fclose(file);
+
+      std::stable_sort(
+        records.begin(), records.end(), [](const Record& a, const Record& b) {
+          return a.tick < b.tick;
+        });
+      return true;
+    }
+
+  public:
+    static void record(
+      Event e,
+      uint64_t a0 = 0,
+      uint64_t a1 = 0,
+      uint64_t a2 = 0,
+      uint64_t a3 = 0)
+    {
+      Ring* r = local();
+      uint64_t head = r->head.load(std::memory_order_relaxed);
+      if (head - r->tail.load(std::memory_order_acquire) == RING_SIZE)
+      {
+        r->dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+      }
+
+      Record& rec = r->records[head % RING_SIZE];
+      rec.tick = snmalloc::Aal::tick();
+      rec.event = (uint32_t)e;
+      rec.thread = r->thread;
+      rec.args[0] = a0;
+      rec.args[1] = a1;
+      rec.args[2] = a2;
+      rec.args[3] = a3;
+      r->head.store(head + 1, std::memory_order_release);
+    }
+
+    /// Records dropped since start() because a ring was full.
+    static uint64_t get_dropped()
+    {
+      uint64_t dropped = 0;
+      for (Ring* r = state().rings.load(std::memory_order_acquire);
+           r != nullptr;
+           r = r->next)
+        dropped += r->dropped.load(std::memory_order_relaxed);
+      return dropped;
+    }
+
+    /**
+     * Drain the rings into `path` every millisecond until stop(). False if
+     * tracing is not built in, is already running, or the file cannot be
+     * opened.
+     */
+    static bool start(const char* path)
+    {
+      auto& s = state();
+      if (!enabled || s.running)
+        return false;
+      s.file = fopen(path, "wb");
+      if (s.file == nullptr)
+        return false;
+      fwrite(MAGIC, sizeof(MAGIC), 1, s.file);
+      write_clock();
+      // Events from before the start are not part of the trace.
+      drain([](const Record&) {});
+      for (Ring* r = s.rings.load(std::memory_order_acquire); r != nullptr;
+           r = r->next)
+        r->dropped.store(0, std::memory_order_relaxed);
+      s.running = true;
+      s.drainer = std::thread([]() {
+        while (state().running.load(std::memory_order_acquire))
+        {
+          write_all();
+          std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+      });
+      return true;
+    }
+
+    /// Write what is left in the rings and close the file.
+    static void stop()
+    {
+      auto& s = state();
+      if (!s.running)
+        return;
+      s.running.store(false, std::memory_order_release);
+      s.drainer.join();
+      write_all();
+      write_clock();
+      fclose(s.file);
+      s.file = nullptr;
+    }
+
+    static const char* name(uint32_t e)
+    {
+      switch ((Event)e)
+      {
+        case Event::RegionGC:
+          return "region_gc";
+        case Event::RegionGCDone:
+          return "region_gc_done";
+        case Event::SemiSpaceGC:
+          return "semispace_gc";
+        case Event::SemiSpaceGCDone:
+          return "semispace_gc_done";
+        case Event::SemiSpaceGrow:
+          return "semispace_grow";
+        case Event::TaskInc:
+          return "task_inc";
+        case Event::TaskDec:
+          return "task_dec";
+        case Event::Schedule:
+          return "schedule";
+        case Event::Steal:
+          return "steal";
+        case Event::BehaviourStart:
+          return "behaviour_start";
+        case Event::BehaviourEnd:
+          return "behaviour_end";
+        case Event::Park:
+          return "park";
+        case Event::Unpark:
+          return "unpark";
+        case Event::EpochAdvance:
+          return "epoch_advance";
+        case Event::Clock:
+          return "clock";
+      }
+      return "unknown";
+    }
+
+    /**
+     * Print the records of the trace at `path` in tick order, one per line:
+     * the ticks since the first record, the thread, the event and its
+     * arguments. False if it is not a trace.
+     */
+    static bool format(const char* path, std::ostream& out)
+    {
+      std::vector<Record> records;
+      if (!load(path, records))
+        return false;
+
+      uint64_t first = records.empty() ? 0 : records.front().tick;
+      for (const Record& rec : records)
+      {
+        out << rec.tick - first << " t" << rec.thread << " "
+            << name(rec.event) << std::hex;
+        for (uint64_t a : rec.args)
+          out << " 0x" << a;
+        out << std::dec << "\n";
+      }
+      return true;
+    }
+
+    /**
+     * Write the trace at `path` as Chrome Trace Event JSON, which
+     * chrome://tracing and the Perfetto UI open, with a track per thread.
+     * Collections, behaviours and parked time are spans; the other events
+     * are instants, with their arguments. Times are in microseconds from
+     * the start of the trace, converted from ticks with the clock records
+     * written by start() and stop(). False if it is not a trace.
+     */
+    static bool format_chrome(const char* path, std::ostream& out)
+    {
+      std::vector<Record> records;
+      if (!load(path, records))
+        return false;
+
+      // Ticks per nanosecond, from the first and last clock records.
+      const Record* clocks[2] = {nullptr, nullptr};
+      for (const Record& r : records)
+      {
+        if (r.event == (uint32_t)Event::Clock)
+        {
+          if (clocks[0] == nullptr)
+            clocks[0] = &r;
+          clocks[1] = &r;
+        }
+      }
+      double ticks_per_ns = 1;
+      if (
+        clocks[0] != clocks[1] && clocks[1]->args[0] > clocks[0]->args[0] &&
+        clocks[1]->tick > clocks[0]->tick)
+        ticks_per_ns = (double)(clocks[1]->tick - clocks[0]->tick) /
+          (double)(clocks[1]->args[0] - clocks[0]->args[0]);
+      uint64_t first = records.empty() ? 0 : records.front().tick;
+
+      out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+      const char* sep = "\n";
+      uint32_t threads = 0;
+      for (const Record& r : records)
+      {
+        if (r.event == (uint32_t)Event::Clock)
+          continue;
+        threads = std::max(threads, r.thread + 1);
+
+        const char* span = nullptr;
+        const char* phase = "i";
+        switch ((Event)r.event)
+        {
+          case Event::RegionGC:
+          case Event::SemiSpaceGC:
+          case Event::BehaviourStart:
+          case Event::Park:
+            phase = "B";
+            break;
+          case Event::RegionGCDone:
+          case Event::SemiSpaceGCDone:
+          case Event::BehaviourEnd:
+          case Event::Unpark:
+            phase = "E";
+            break;
+          default:
+            break;
+        }
+        switch ((Event)r.event)
+        {
+          case Event::RegionGC:
+          case Event::RegionGCDone:
+            span = "region_gc";
+            break;
+          case Event::SemiSpaceGC:
+          case Event::SemiSpaceGCDone:
+            span = "semispace_gc";
+            break;
+          case Event::BehaviourStart:
+          case Event::BehaviourEnd:
+            span = "behaviour";
+            break;
+          case Event::Park:
+          case Event::Unpark:
+            span = "parked";
+            break;
+          default:
+            span = name(r.event);
+            break;
+        }
+
+        out << sep << "{\"name\":\"" << span << "\",\"ph\":\"" << phase
+            << "\",\"pid\":0,\"tid\":" << r.thread << ",\"ts\":" << std::fixed
+            << std::setprecision(3)
+            << (double)(r.tick - first) / ticks_per_ns / 1000
+            << std::defaultfloat;
+        if (phase[0] == 'i')
+          out << ",\"s\":\"t\"";
+        if (phase[0] != 'E')
+          out << ",\"args\":{\"a0\":" << r.args[0] << ",\"a1\":" << r.args[1]
+              << ",\"a2\":" << r.args[2] << ",\"a3\":" << r.args[3] << "}";
+        out << "}";
+        sep = ",\n";
+      }
+      for (uint32_t t = 0; t < threads; t++)
+      {
+        out << sep << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,"
+            << "\"tid\":" << t << ",\"args\":{\"name\":\"thread " << t
+            << "\"}}";
+        sep = ",\n";
+      }
+      out << "\n]}\n";
+      return true;
+    }
+  };
+} // namespace verona::rt
@@ -2,13 +2,24 @@
 // SPDX-License-Identifier: MIT
 #pragma once
 
+#include <algorithm>
 #include <cassert>
+#include <cerrno>
 #include <chrono>
+#include <deque>
 #include <functional>
 #include <list>
+#include <string>
 #include <test/opt.h>
+#include <vector>
 #include <verona.h>
 
+#ifndef _WIN32
+#  include <sys/mman.h>
+#  include <sys/wait.h>
+#  include <unistd.h>
+#endif
+
 using namespace verona::rt;
 using namespace verona::rt::api;
 using namespace std::chrono;
@@ -76,6 +87,12 @@ class SystematicTestHarness
    */
   std::list<PlatformThread> external_threads;
 
+  /**
+   * The command line, without the options that select seeds, to print how
+   * to replay a seed that failed.
+   */
+  std::string replay;
+
 public:
   opt::Opt opt;
 
@@ -83,6 +100,7 @@ public:
   size_t cores;
   size_t seed_lower;
   size_t seed_upper;
+  size_t jobs;
   high_resolution_clock::time_point start;
 
   void (*run_at_termination)(void) = nullptr;
@@ -96,6 +114,17 @@ public:
       std::cout << " " << argv[i];
     }
 
+    for (int i = 0; i < argc; i++)
+    {
+      std::string arg = argv[i];
+      if (arg == "--seed" || arg == "--seed_count" || arg == "--jobs")
+      {
+        i++;
+        continue;
+      }
+      replay += (i == 0 ? "" : " ") + arg;
+    }
+
 #ifdef USE_SYSTEMATIC_TESTING
     size_t count = opt.is<size_t>("--seed_count", 100);
 #else
@@ -126,10 +155,19 @@ public:
     if (opt.has("--log-all") || (seed_lower + 1 == seed_upper))
       Logging::enable_logging();
 
+    // --cores 0 runs as many threads as the process can keep running.
     cores = opt.is<size_t>("--cores", 4);
+    if (cores == 0)
+      cores = Scheduler::available_cores();
 
     detect_leaks = !opt.has("--allow_leaks");
 
+    // --jobs N runs the seeds in N processes at once, and --jobs 0 in one
+    // per core.
+    jobs = opt.is<size_t>("--jobs", 1);
+    if (jobs == 0)
+      jobs = Scheduler::available_cores();
+
 #if defined(_WIN32) && defined(CI_BUILD)
     _set_error_mode(_OUT_TO_STDERR);
     _set_abort_behavior(0, _WRITE_ABORT_MSG);
@@ -151,8 +189,29 @@ public:
     {
       sched.set_fair(false);
     }
+    sched.set_steal_half((seed / 2) % 2 == 1);
+    sched.set_sticky((seed / 4) % 2 == 1);
+    // Retire every thread that pauses, down to one.
+    sched.set_elastic((seed / 8) % 2, 0, 0);
 #else
     UNUSED(seed);
+    sched.set_steal_half(opt.has("--steal-half"));
+    sched.set_sticky(opt.has("--sticky"));
+    sched.set_time_slice(opt.is<size_t>("--time-slice", 0));
+    sched.set_targeted_wakeup(opt.has("--targeted-wakeup"));
+    sched.set_spin_before_park(
+      opt.is<size_t>("--spin-before-park", sched.get_spin_before_park()));
+    if (opt.has("--socket"))
+      sched.set_placement(
+        Topology::Placement::Socket, opt.is<size_t>("--socket", 0));
+    else if (opt.has("--compact"))
+      sched.set_placement(Topology::Placement::Compact);
+    else
+      sched.set_placement(Topology::Placement::Scatter);
+    sched.set_elastic(
+      opt.is<size_t>("--elastic", 0),
+      opt.is<size_t>("--retire-after", 100'000'000),
+      opt.is<size_t>("--wake-after", 1'000'000));
 #endif
 
     sched.init(cores, run_at_termination);
@@ -192,24 +251,22 @@ public:
   template<typename F, typename... Args>
   void run(F&& f, Args... args)
   {
-    for (seed = seed_lower; seed < seed_upper; seed++)
-    {
+    run_seeds([&]() {
       Systematic::set_seed(seed);
       run_with_seed(f, std::forward<Args>(args)...);
-    }
+    });
   }
 
   void
   run_many(std::vector<std::pair<std::function<void()>, std::string>> tests)
   {
 #ifdef USE_SYSTEMATIC_TESTING
-    for (seed = seed_lower; seed < seed_upper; seed++)
-    {
+    run_seeds([&]() {
       Systematic::set_seed(seed);
       auto test = tests[Systematic::get_prng_next() % tests.size()];
       std::cout << "Running test: " << test.second << std::endl;
       run_with_seed(test.first);
-    }
+    });
 #else
     for (auto& test : tests)
     {
@@ -219,6 +276,147 @@ public:
 #endif
   }
 
+  /**
+   * Call `run_seed` with each seed from seed_lower to seed_upper, in this
+   * process, or with --jobs N, spread over N worker processes, as the
+   * systematic scheduler's state is global to a process.
+   */
+  template<typename R>
+  void run_seeds(R&& run_seed)
+  {
+    if (jobs > 1 && seed_upper - seed_lower > 1)
+    {
+#ifndef _WIN32
+      run_seeds_forked(run_seed);
+      return;
+#else
+      std::cout << "--jobs is not supported on Windows, running the seeds "
+                   "in this process."
+                << std::endl;
+#endif
+    }
+
+    for (seed = seed_lower; seed < seed_upper; seed++)
+      run_seed();
+  }
+
+#ifndef _WIN32
+  /**
+   * Split the seeds into one range per job, and run each range in a child
+   * process. A child that fails stops at the seed it was running, which it
+   * records in memory shared with this process; the rest of its range is
+   * given to a new child. Once every seed has run, print the seeds that
+   * failed, with the command that replays each one, and exit with an error
+   * if there were any.
+   */
+  template<typename R>
+  void run_seeds_forked(R& run_seed)
+  {
+    struct Range
+    {
+      size_t lower;
+      size_t upper;
+    };
+
+    size_t count = seed_upper - seed_lower;
+    size_t workers = std::min(jobs, count);
+
+    auto* running = (size_t*)mmap(
+      nullptr,
+      workers * sizeof(size_t),
+      PROT_READ | PROT_WRITE,
+      MAP_SHARED | MAP_ANONYMOUS,
+      -1,
+      0);
+    if (running == MAP_FAILED)
+      abort();
+
+    std::deque<Range> ranges;
+    for (size_t i = 0; i < workers; i++)
+      ranges.push_back({seed_lower + ((count * i) / workers),
+                        seed_lower + ((count * (i + 1)) / workers)});
+
+    std::vector<pid_t> pids(workers, 0);
+    std::vector<Range> given(workers);
+    std::vector<size_t> failed;
+
+    auto start_worker = [&](size_t w) {
+      Range r = ranges.front();
+      ranges.pop_front();
+      given[w] = r;
+      running[w] = r.lower;
+
+      std::cout.flush();
+      fflush(stdout);
+      pid_t pid = fork();
+      if (pid < 0)
+        abort();
+
+      if (pid == 0)
+      {
+        for (seed = r.lower; seed < r.upper; seed++)
+        {
+          running[w] = seed;
+          run_seed();
+        }
+        std::cout.flush();
+        fflush(stdout);
+        _exit(0);
+      }
+
+      pids[w] = pid;
+    };
+
+    size_t live = 0;
+    for (size_t w = 0; w < workers; w++, live++)
+      start_worker(w);
+
+    while (live > 0)
+    {
+      int status;
+      pid_t pid = waitpid(-1, &status, 0);
+      if (pid < 0)
+      {
+        if (errno == EINTR)
+          continue;
+        abort();
+      }
+
+      auto it = std::find(pids.begin(), pids.end(), pid);
+      if (it == pids.end())
+        continue;
+      auto w = (size_t)(it - pids.begin());
+      live--;
+
+      if (!WIFEXITED(status) || (WEXITSTATUS(status) != 0))
+      {
+        size_t s = running[w];
+        failed.push_back(s);
+        if (s + 1 < given[w].upper)
+          ranges.push_front({s + 1, given[w].upper});
+      }
+
+      if (!ranges.empty())
+      {
+        start_worker(w);
+        live++;
+      }
+    }
+
+    munmap(running, workers * sizeof(size_t));
+
+    std::sort(failed.begin(), failed.end());
+    std::cout << "Seeds passed: " << (count - failed.size()) << " of "
+              << count << " in " << workers << " jobs" << std::endl;
+    for (auto s : failed)
+      std::cout << "Seed " << s << " failed, replay with: " << replay
+                << " --seed " << s << " --seed_count 1" << std::endl;
+
+    if (!failed.empty())
+      exit(1);
+  }
+#endif
+
   /**
    * Add an external thread to the system, which will be joined after
    * sched.run() finishes. Do not create any verona::PlatformThread or
@@ -46,6 +46,20 @@ namespace Logging
   static constexpr bool flight_recorder = false;
 #endif
 
+  /// Whether cout() writes anywhere. Hot paths test it with `if constexpr`,
+  /// so that they do not even evaluate what they would log otherwise.
+  static constexpr bool enabled = systematic || flight_recorder;
+
+#ifdef VERONA_PRODUCTION
+#  if defined(USE_SYSTEMATIC_TESTING) || defined(USE_FLIGHT_RECORDER) || \
+    defined(USE_EVENT_TRACE) || defined(USE_SCHED_STATS) || \
+    defined(ENABLE_BENCHMARKING)
+#    error "VERONA_PRODUCTION builds cannot enable debugging hooks"
+#  endif
+// Nor do they install the crash handlers of CI builds.
+#  undef CI_BUILD
+#endif
+
   struct Header
   {
     size_t time;
@@ -620,7 +634,7 @@ namespace Logging
 
   inline std::ostream& endl(std::ostream& os)
   {
-    if constexpr (systematic || flight_recorder)
+    if constexpr (enabled)
     {
       os << std::endl;
     }
@@ -314,7 +314,9 @@ namespace verona::rt
      */
     static bool yield()
     {
-      yield_until(true_thunk);
+      // Naming true_thunk would emit its dynamic initialisation.
+      if constexpr (enabled)
+        yield_until(true_thunk);
       return true;
     }
 
@@ -53,6 +53,18 @@ namespace verona::rt
     // Used to thread a freelist pointer through the bag.
     MaybeElem* next_free;
 
+    /// Slots that have been bump allocated, live or not.
+    size_t slots = 0;
+
+    /// Slots that are holes, on the freelist.
+    size_t holes = 0;
+
+    /// Elements next_non_empty() tests for holes at once.
+    static constexpr size_t SCAN_GROUP = 8;
+
+    /// Percentage of holes above which compact_if_sparse() compacts.
+    static constexpr size_t COMPACT_PERCENT = 50;
+
     /// Takes an index and returns the pointer to the Block
     static Block* get_block(MaybeElem* ptr)
     {
@@ -71,12 +83,43 @@ namespace verona::rt
       return ((uintptr_t)index & INDEX_MASK) == INDEX_MASK;
     }
 
+    /// The position of an index in its block, with 0 the `prev` pointer.
+    static size_t block_slot(MaybeElem* ptr)
+    {
+      return ((uintptr_t)ptr & INDEX_MASK) / sizeof(MaybeElem);
+    }
+
+    /**
+     * Whether the SCAN_GROUP elements ending at `elem` are all holes. The
+     * hole bits are and-ed together rather than tested one at a time, which
+     * compilers turn into a few vector instructions.
+     */
+    static bool all_holes(MaybeElem* elem)
+    {
+      uintptr_t all = EMPTY_MASK;
+      for (size_t i = 0; i < SCAN_GROUP; i++)
+        all &= (uintptr_t)(elem - i)->hole_ptr;
+      return all != 0;
+    }
+
   public:
     BagBase() : index(null_index), next_free(nullptr)
     {
       static_assert(
-        sizeof(*this) == sizeof(void*) * 2,
-        "Stack should contain only the index and freelist pointer");
+        sizeof(*this) == sizeof(void*) * 4,
+        "Bag should contain only the index, freelist pointer and counts");
+    }
+
+    /// The number of elements in the bag.
+    size_t size() const
+    {
+      return slots - holes;
+    }
+
+    /// The number of holes left by remove() that insert() has not reused.
+    size_t hole_count() const
+    {
+      return holes;
     }
 
     /// Deallocate the linked blocks for this bag.
@@ -90,6 +133,9 @@ namespace verona::rt
         local_block = prev;
       }
       index = null_index;
+      next_free = nullptr;
+      slots = 0;
+      holes = 0;
     }
 
     ALWAYSINLINE void remove(E* item)
@@ -97,6 +143,38 @@ namespace verona::rt
       MaybeElem* hole = (MaybeElem*)item;
       hole->hole_ptr = (MaybeElem*)((uintptr_t)next_free | EMPTY_MASK);
       next_free = hole;
+      holes++;
+    }
+
+    /**
+     * Move every element into new blocks with no holes between them, and
+     * free the old blocks, so that iteration takes time in proportion to
+     * the elements rather than to the most the bag has held. Calls
+     * `moved(from, to)` for each element, as pointers returned by insert()
+     * no longer refer to it.
+     */
+    template<typename F>
+    void compact(F moved)
+    {
+      BagBase fresh;
+      for (E* e : *this)
+        moved(e, fresh.insert(*e));
+      dealloc();
+      index = fresh.index;
+      slots = fresh.slots;
+    }
+
+    /**
+     * compact() if more than `percent` percent of the slots are holes.
+     * Returns whether it did.
+     */
+    template<typename F>
+    bool compact_if_sparse(F moved, size_t percent = COMPACT_PERCENT)
+    {
+      if (holes * 100 <= slots * percent)
+        return false;
+      compact(moved);
+      return true;
     }
 
     /// Insert an element into the bag.
@@ -109,8 +187,10 @@ namespace verona::rt
         assert((uintptr_t)prev & EMPTY_MASK);
         MaybeElem* cur = next_free;
         next_free = (MaybeElem*)((uintptr_t)prev & ~EMPTY_MASK);
+        holes--;
         return &(cur->item);
       }
+      slots++;
       if (!is_last_block_elem(index))
       {
         index++;
@@ -148,6 +228,11 @@ namespace verona::rt
       while ((elem != BagBase::null_index) &&
              ((uintptr_t)elem->hole_ptr & EMPTY_MASK))
       {
+        // Skip runs of holes within the block a group at a time.
+        while ((block_slot(elem) > SCAN_GROUP) && all_holes(elem))
+          elem -= SCAN_GROUP;
+        if (((uintptr_t)elem->hole_ptr & EMPTY_MASK) == 0)
+          break;
         step(elem);
       }
       return elem;
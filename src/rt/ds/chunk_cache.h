@@ -0,0 +1,194 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "heap.h"
+
+#include <atomic>
+#include <cstddef>
+
+namespace verona::rt
+{
+  /**
+   * A per-thread cache of large heap blocks, such as arena chunks and
+   * semispaces, so that a thread releasing one region and creating the next
+   * gets back memory that is already mapped instead of going through the
+   * allocator and faulting in fresh pages.
+   *
+   * Blocks are kept in bins of one exact size each, and a block is only
+   * handed back out for the same size. Each thread keeps at most
+   * get_capacity() bytes, which is 0 by default, so the cache is off unless
+   * set_capacity() is called. Blocks that do not fit go straight back to the
+   * heap. A scheduler thread trims its cache when it pauses, and every
+   * thread's cache is emptied when the thread exits.
+   *
+   * Hits and misses are counted across all threads while the cache is on.
+   **/
+  class ChunkCache
+  {
+  public:
+    /// Blocks smaller than this are never cached.
+    static constexpr size_t MIN_SIZE = 4 * 1024;
+
+    /// Number of distinct block sizes a thread caches at once.
+    static constexpr size_t BINS = 16;
+
+    struct Stats
+    {
+      size_t hits;
+      size_t misses;
+    };
+
+  private:
+    struct Block
+    {
+      Block* next;
+    };
+
+    struct Bin
+    {
+      size_t size = 0;
+      Block* head = nullptr;
+    };
+
+    Bin bins[BINS];
+
+    /// Bytes held in all bins.
+    size_t cached = 0;
+
+    static inline std::atomic<size_t> capacity_{0};
+    static inline std::atomic<size_t> hits_{0};
+    static inline std::atomic<size_t> misses_{0};
+
+    static ChunkCache& local()
+    {
+      static thread_local ChunkCache cache;
+      return cache;
+    }
+
+    ChunkCache() = default;
+
+    ~ChunkCache()
+    {
+      release();
+    }
+
+    void release()
+    {
+      for (auto& bin : bins)
+      {
+        while (bin.head != nullptr)
+        {
+          Block* next = bin.head->next;
+          heap::dealloc(bin.head, bin.size);
+          bin.head = next;
+        }
+      }
+      cached = 0;
+    }
+
+  public:
+    /**
+     * Set how many bytes each thread may keep. 0 turns the cache off, but
+     * does not empty the threads' caches; see trim().
+     **/
+    static void set_capacity(size_t bytes)
+    {
+      capacity_.store(bytes, std::memory_order_relaxed);
+    }
+
+    static size_t get_capacity()
+    {
+      return capacity_.load(std::memory_order_relaxed);
+    }
+
+    static Stats get_stats()
+    {
+      return {
+        hits_.load(std::memory_order_relaxed),
+        misses_.load(std::memory_order_relaxed)};
+    }
+
+    static void reset_stats()
+    {
+      hits_.store(0, std::memory_order_relaxed);
+      misses_.store(0, std::memory_order_relaxed);
+    }
+
+    /**
+     * Allocate a block of `size` bytes, from this thread's cache if it has
+     * one. Freed with dealloc() or heap::dealloc().
+     **/
+    static void* alloc(size_t size)
+    {
+      if ((size < MIN_SIZE) || (get_capacity() == 0))
+        return heap::alloc(size);
+
+      auto& c = local();
+      for (auto& bin : c.bins)
+      {
+        if ((bin.size == size) && (bin.head != nullptr))
+        {
+          Block* b = bin.head;
+          bin.head = b->next;
+          c.cached -= size;
+          hits_.fetch_add(1, std::memory_order_relaxed);
+          return b;
+        }
+      }
+
+      misses_.fetch_add(1, std::memory_order_relaxed);
+      return heap::alloc(size);
+    }
+
+    /**
+     * Free the block `p` of `size` bytes, allocated with alloc() or
+     * heap::alloc(), into this thread's cache if there is room.
+     **/
+    static void dealloc(void* p, size_t size)
+    {
+      size_t capacity = get_capacity();
+      if ((size < MIN_SIZE) || (size > capacity))
+      {
+        heap::dealloc(p, size);
+        return;
+      }
+
+      auto& c = local();
+      if (c.cached + size <= capacity)
+      {
+        Bin* free_bin = nullptr;
+        for (auto& bin : c.bins)
+        {
+          if (bin.size == size)
+          {
+            free_bin = &bin;
+            break;
+          }
+          if ((free_bin == nullptr) && (bin.head == nullptr))
+            free_bin = &bin;
+        }
+
+        if (free_bin != nullptr)
+        {
+          auto* b = static_cast<Block*>(p);
+          b->next = free_bin->head;
+          free_bin->head = b;
+          free_bin->size = size;
+          c.cached += size;
+          return;
+        }
+      }
+
+      heap::dealloc(p, size);
+    }
+
+    /**
+     * Return every block this thread has cached to the heap.
+     **/
+    static void trim()
+    {
+      local().release();
+    }
+  };
+} // namespace verona::rt
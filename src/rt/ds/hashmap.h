@@ -4,11 +4,18 @@
 
 #include "../object/object.h"
 
+#include <algorithm>
+
 namespace verona::rt
 {
   /**
    * Robin Hood hash map where the key type is `K*`, where `K` is derrived from
    * `Object`. The `Entry` type must be either `K*` or `std::pair<K*, Value>`.
+   *
+   * The slots past the capacity hold entries displaced from the last ones, so
+   * probing never wraps around. Erasing shifts the entries after the erased
+   * one back towards their ideal slots, which keeps probes short and lets a
+   * lookup stop at the first slot its key could not be past.
    */
   template<typename Entry>
   class ObjectMap
@@ -17,6 +24,8 @@ namespace verona::rt
     size_t filled_slots = 0;
     uint8_t capacity_shift;
     uint8_t longest_probe = 0;
+    /// Capacity the map starts with, and goes back to when cleared.
+    uint8_t initial_shift;
 
     /**
      * The key type must be derrived from `Object` because the low bits are used
@@ -26,6 +35,13 @@ namespace verona::rt
     static constexpr uintptr_t MARK_MASK = Object::ALIGNMENT >> 1;
     static constexpr uintptr_t PROBE_MASK = MARK_MASK - 1;
 
+    /// Slots past the capacity, enough for the longest probe.
+    static constexpr size_t OVERFLOW_SLOTS = PROBE_MASK;
+
+    /// A sweep that leaves fewer than one entry in SHRINK_RATIO slots
+    /// shrinks the map, to twice its entries or the initial capacity.
+    static constexpr size_t SHRINK_RATIO = 8;
+
     static_assert((MARK_MASK & PROBE_MASK) == 0);
     static_assert(((MARK_MASK | PROBE_MASK) & ~Object::MASK) == 0);
 
@@ -89,13 +105,20 @@ namespace verona::rt
     }
 
     /**
-     * Allocate enough slots for 8 entries.
+     * Allocate the initial slots.
      */
     void init_alloc()
     {
-      static constexpr size_t init_capacity = 8;
-      capacity_shift = (uint8_t)bits::ctz(init_capacity);
-      slots = (Entry*)heap::calloc<init_capacity * sizeof(Entry)>();
+      capacity_shift = initial_shift;
+      slots = (Entry*)heap::calloc(slot_count() * sizeof(Entry));
+    }
+
+    /**
+     * Number of slots allocated, including the overflow slots.
+     */
+    size_t slot_count() const
+    {
+      return capacity() + OVERFLOW_SLOTS;
     }
 
     /**
@@ -103,11 +126,20 @@ namespace verona::rt
      * be reinserted.
      */
     void resize()
+    {
+      rehash((uint8_t)(capacity_shift + 1));
+    }
+
+    /**
+     * Move the entries into a new allocation with a capacity of
+     * `1 << shift`.
+     */
+    void rehash(uint8_t shift)
     {
       auto prev = *this;
 
-      capacity_shift++;
-      slots = (Entry*)heap::calloc(capacity() * sizeof(Entry));
+      capacity_shift = shift;
+      slots = (Entry*)heap::calloc(slot_count() * sizeof(Entry));
       filled_slots = 0;
       longest_probe = 0;
 
@@ -122,6 +154,30 @@ namespace verona::rt
       }
     }
 
+    /**
+     * Remove the entry at `index`, and shift the entries after it back by
+     * one slot, up to the first that is empty or in its ideal slot.
+     */
+    void remove_at(size_t index)
+    {
+      slots[index].~Entry();
+      key_of(slots[index]) = 0;
+      filled_slots--;
+
+      for (size_t next = index + 1; next < slot_count(); next++)
+      {
+        const auto k = key_of(slots[next]);
+        if ((k == 0) || (probe_index(k) == 0))
+          break;
+
+        slots[index] = std::move(slots[next]);
+        key_of(slots[index]) = k - 1;
+        slots[next].~Entry();
+        key_of(slots[next]) = 0;
+        index = next;
+      }
+    }
+
     /**
      * Place an entry into the map at the given index, overwriting any existing
      * entry. The probe bits of the key are set to `probe_len` and the
@@ -149,6 +205,8 @@ namespace verona::rt
 
       const ObjectMap* map;
       size_t index;
+      /// Set by erasing the entry at `index`, which another may have taken.
+      bool revisit = false;
 
       Entry& entry()
       {
@@ -194,7 +252,14 @@ namespace verona::rt
 
       Iterator& operator++()
       {
-        while (++index < map->capacity())
+        if (revisit)
+        {
+          revisit = false;
+          if (key_of(map->slots[index]) != 0)
+            return *this;
+        }
+
+        while (++index < map->slot_count())
         {
           const auto key = key_of(map->slots[index]);
           if (key != 0)
@@ -215,10 +280,14 @@ namespace verona::rt
     };
 
     /**
-     * Create an `ObjectMap` with an initial capacity for at least 8 entries.
+     * Create an `ObjectMap` with an initial capacity for at least 8 entries,
+     * or twice `hint` entries if that is more, so that a map expected to
+     * hold `hint` entries is filled without resizing.
      */
-    ObjectMap()
+    explicit ObjectMap(size_t hint = 4)
     {
+      size_t capacity = bits::next_pow2(hint < 4 ? 8 : hint * 2);
+      initial_shift = (uint8_t)bits::ctz(capacity);
       init_alloc();
     }
 
@@ -227,15 +296,15 @@ namespace verona::rt
       dealloc();
     }
 
-    static ObjectMap<Entry>* create()
+    static ObjectMap<Entry>* create(size_t hint = 4)
     {
-      return new (heap::alloc<sizeof(ObjectMap<Entry>)>()) ObjectMap();
+      return new (heap::alloc<sizeof(ObjectMap<Entry>)>()) ObjectMap(hint);
     }
 
     void dealloc()
     {
       clear(true);
-      heap::dealloc(slots, capacity() * sizeof(Entry));
+      heap::dealloc(slots, slot_count() * sizeof(Entry));
     }
 
     /**
@@ -266,7 +335,7 @@ namespace verona::rt
 
     Iterator end() const
     {
-      return Iterator(this, capacity());
+      return Iterator(this, slot_count());
     }
 
     /**
@@ -283,12 +352,15 @@ namespace verona::rt
       auto index = hash & (capacity() - 1);
       for (size_t probe_len = 0; probe_len <= longest_probe; probe_len++)
       {
-        const auto k = unmark_key(key_of(slots[index]));
-        if (k == (uintptr_t)key)
+        const auto k = key_of(slots[index]);
+        if (unmark_key(k) == (uintptr_t)key)
           return Iterator(this, index);
 
-        if (++index == capacity())
-          index = 0;
+        // The key would have displaced an entry closer to its ideal slot.
+        if ((k == 0) || (probe_index(k) < probe_len))
+          break;
+
+        index++;
       }
 
       return end();
@@ -349,8 +421,7 @@ namespace verona::rt
           probe_len = probe_index(key_of(entry));
         }
 
-        if (++index == capacity())
-          index = 0;
+        index++;
       }
 
       // Maximum probe length reached, resize and retry.
@@ -379,19 +450,69 @@ namespace verona::rt
 
     /**
      * Remove an entry from the map at the given iterator position. The iterator
-     * must be valid. This operation will not invalidate the iterator.
+     * must be valid. This operation will not invalidate the iterator: an entry
+     * shifted into its slot is the next one it visits, so erasing while
+     * iterating still visits every entry once.
      */
     void erase(Iterator& it)
     {
       assert(key_of(it.entry()) != 0);
 
-      // No tombstones are necessary because our insertion algorithm relies on
-      // the the minimum probe length determined by the maximum value we can
-      // stash in the lower bits of the key.
+      // Entries only shift back from later slots, which the iterator has not
+      // reached yet.
+      remove_at(it.index);
+      it.revisit = true;
+    }
 
-      it.entry().~Entry();
-      key_of(it.entry()) = 0;
-      filled_slots--;
+    /**
+     * Remove every unmarked entry, passing its key to `dead` first, and
+     * unmark the rest.
+     *
+     * Unlike iterating and erasing, this works on the slots directly: one
+     * pass counts the marked entries, so that when none are dead, the common
+     * case for a remembered set that is not shrinking, no entry is visited
+     * one at a time. The mark bits are then cleared in a second branch-free
+     * pass, which compilers vectorise for sets.
+     *
+     * If few entries are left (see SHRINK_RATIO), the map then shrinks, so
+     * that iterating and sweeping it costs in proportion to what it holds.
+     */
+    template<typename F>
+    void sweep(F&& dead)
+    {
+      const size_t count = slot_count();
+      size_t marked = 0;
+      for (size_t i = 0; i < count; i++)
+        marked += (key_of(slots[i]) & MARK_MASK) != 0;
+
+      if (marked != filled_slots)
+      {
+        // An entry shifted back into slot `i` is inspected next.
+        for (size_t i = 0; i < count;)
+        {
+          const auto k = key_of(slots[i]);
+          if ((k != 0) && ((k & MARK_MASK) == 0))
+          {
+            dead((KeyType*)unmark_key(k));
+            remove_at(i);
+          }
+          else
+          {
+            i++;
+          }
+        }
+      }
+
+      for (size_t i = 0; i < count; i++)
+        key_of(slots[i]) &= ~MARK_MASK;
+
+      if (
+        (capacity_shift > initial_shift) &&
+        (filled_slots * SHRINK_RATIO < capacity()))
+      {
+        size_t target = bits::next_pow2(std::max<size_t>(filled_slots * 2, 1));
+        rehash(std::max(initial_shift, (uint8_t)bits::ctz(target)));
+      }
     }
 
     /**
@@ -406,9 +527,9 @@ namespace verona::rt
 
       longest_probe = 0;
 
-      if (!skip_deallocate && (capacity() > 8))
+      if (!skip_deallocate && (capacity_shift > initial_shift))
       {
-        heap::dealloc(slots, capacity() * sizeof(Entry));
+        heap::dealloc(slots, slot_count() * sizeof(Entry));
         init_alloc();
       }
     }
@@ -421,7 +542,7 @@ namespace verona::rt
     OutStream& debug_layout(OutStream& out) const
     {
       out << "{";
-      for (size_t i = 0; i < capacity(); i++)
+      for (size_t i = 0; i < slot_count(); i++)
       {
         const auto key = key_of(slots[i]);
         if (key == 0)
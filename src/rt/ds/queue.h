@@ -54,6 +54,32 @@ namespace verona
       return result;
     }
 
+    /**
+     * Remove the elements up to and including `end`, which must be in the
+     * queue, and return the first of them. They stay linked through `next`,
+     * ending in nullptr.
+     */
+    T* dequeue_until(T* end)
+    {
+      assert(first != nullptr);
+      assert(end != nullptr);
+
+      auto result = first;
+      if (end == last)
+      {
+        first = nullptr;
+        last = nullptr;
+      }
+      else
+      {
+        first = end->next;
+      }
+      end->next = nullptr;
+
+      assert((first != nullptr && last != nullptr) || last == first);
+      return result;
+    }
+
     size_t length()
     {
       T* p = first;
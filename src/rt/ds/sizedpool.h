@@ -0,0 +1,173 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "heap.h"
+
+#include <atomic>
+#include <cstddef>
+
+namespace verona::rt
+{
+  /**
+   * A per-thread pool of freed blocks, so that the thread that frees a
+   * block keeps its memory for the next one of the same size it allocates,
+   * instead of sending it back to the allocator of the thread that
+   * allocated it, which is often another one.
+   *
+   * Blocks are kept in bins of one exact size each, so a block is only
+   * reused for another of the same size. Each thread keeps at most
+   * get_capacity() bytes, which is 0 by default, so the pool is off unless
+   * set_capacity() is called. Blocks larger than MAX_SIZE, or that do not
+   * fit, go straight back to the heap. A scheduler thread trims its pool
+   * when it pauses, and every thread's pool is emptied when the thread
+   * exits.
+   *
+   * `Tag` keeps apart the pools, and capacities, of different uses.
+   **/
+  template<typename Tag>
+  class SizedPool
+  {
+  public:
+    /// Blocks larger than this are never pooled.
+    static constexpr size_t MAX_SIZE = 1024;
+
+    /// Number of distinct block sizes a thread pools at once.
+    static constexpr size_t BINS = 16;
+
+  private:
+    struct Block
+    {
+      Block* next;
+    };
+
+    struct Bin
+    {
+      size_t size = 0;
+      Block* head = nullptr;
+    };
+
+    Bin bins[BINS];
+
+    /// Bytes held in all bins.
+    size_t pooled = 0;
+
+    static inline std::atomic<size_t> capacity_{0};
+
+    static SizedPool& local()
+    {
+      static thread_local SizedPool pool;
+      return pool;
+    }
+
+    SizedPool() = default;
+
+    ~SizedPool()
+    {
+      release();
+    }
+
+    void release()
+    {
+      for (auto& bin : bins)
+      {
+        while (bin.head != nullptr)
+        {
+          Block* next = bin.head->next;
+          heap::dealloc(bin.head, bin.size);
+          bin.head = next;
+        }
+      }
+      pooled = 0;
+    }
+
+  public:
+    /**
+     * Set how many bytes each thread may keep. 0 turns the pool off, but
+     * does not empty the threads' pools; see trim().
+     **/
+    static void set_capacity(size_t bytes)
+    {
+      capacity_.store(bytes, std::memory_order_relaxed);
+    }
+
+    static size_t get_capacity()
+    {
+      return capacity_.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Allocate a block of `size` bytes, from this thread's pool if it has
+     * one. Freed with dealloc().
+     **/
+    static void* alloc(size_t size)
+    {
+      if ((size > MAX_SIZE) || (get_capacity() == 0))
+        return heap::alloc(size);
+
+      auto& p = local();
+      for (auto& bin : p.bins)
+      {
+        if ((bin.size == size) && (bin.head != nullptr))
+        {
+          Block* b = bin.head;
+          bin.head = b->next;
+          p.pooled -= size;
+          return b;
+        }
+      }
+
+      return heap::alloc(size);
+    }
+
+    /**
+     * Free the block `b` of `size` bytes into this thread's pool if there
+     * is room. It may have come from alloc() or straight from the heap.
+     **/
+    static void dealloc(void* b, size_t size)
+    {
+      size_t capacity = get_capacity();
+      if ((size > MAX_SIZE) || (size > capacity))
+      {
+        heap::dealloc(b, size);
+        return;
+      }
+
+      auto& p = local();
+      Bin* free_bin = nullptr;
+      if (p.pooled + size <= capacity)
+      {
+        for (auto& bin : p.bins)
+        {
+          if (bin.size == size)
+          {
+            free_bin = &bin;
+            break;
+          }
+          if ((free_bin == nullptr) && (bin.head == nullptr))
+            free_bin = &bin;
+        }
+      }
+
+      if (free_bin == nullptr)
+      {
+        heap::dealloc(b, size);
+        return;
+      }
+
+      auto* block = static_cast<Block*>(b);
+      block->next = free_bin->head;
+      free_bin->head = block;
+      free_bin->size = size;
+      p.pooled += size;
+    }
+
+    /**
+     * Return every block this thread has pooled to the heap.
+     **/
+    static void trim()
+    {
+      local().release();
+    }
+  };
+} // namespace verona::rt
@@ -4,37 +4,186 @@
 
 #include "heap.h"
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <cstring>
 
 namespace verona::rt
 {
+  /**
+   * A per-thread cache of stack blocks, so that the stacks a collection
+   * builds for its own bookkeeping, such as its mark stack and the stack of
+   * fields of each object it scans, take their blocks from the blocks
+   * earlier stacks on the thread freed rather than from the allocator.
+   *
+   * Every stack block is the same size, whatever the stack holds. Each
+   * thread keeps at most get_capacity() blocks, which is 0 by default, so
+   * the cache is off unless set_capacity() is called. A scheduler thread
+   * trims its cache when it pauses, and every thread's cache is emptied
+   * when the thread exits. Hits and misses are counted per thread.
+   **/
+  class StackBlockCache
+  {
+  public:
+    /// Size of a stack block: 64 pointers.
+    static constexpr size_t BLOCK_SIZE = 64 * sizeof(void*);
+
+    struct Stats
+    {
+      size_t hits;
+      size_t misses;
+    };
+
+  private:
+    struct Block
+    {
+      Block* next;
+    };
+
+    Block* head = nullptr;
+    size_t count = 0;
+    Stats stats{0, 0};
+
+    static inline std::atomic<size_t> capacity_{0};
+
+    static StackBlockCache& local()
+    {
+      static thread_local StackBlockCache cache;
+      return cache;
+    }
+
+    StackBlockCache() = default;
+
+    ~StackBlockCache()
+    {
+      release();
+    }
+
+    void release()
+    {
+      while (head != nullptr)
+      {
+        Block* next = head->next;
+        heap::dealloc<BLOCK_SIZE>(head);
+        head = next;
+      }
+      count = 0;
+    }
+
+  public:
+    /**
+     * Set how many blocks each thread may keep. 0 turns the cache off, but
+     * does not empty the threads' caches; see trim().
+     **/
+    static void set_capacity(size_t blocks)
+    {
+      capacity_.store(blocks, std::memory_order_relaxed);
+    }
+
+    static size_t get_capacity()
+    {
+      return capacity_.load(std::memory_order_relaxed);
+    }
+
+    /// Hits and misses of this thread's cache.
+    static Stats get_stats()
+    {
+      return local().stats;
+    }
+
+    static void reset_stats()
+    {
+      local().stats = {0, 0};
+    }
+
+    /// Allocate a stack block, from this thread's cache if it has one.
+    static void* alloc()
+    {
+      if (get_capacity() == 0)
+        return heap::alloc<BLOCK_SIZE>();
+
+      auto& c = local();
+      if (c.head != nullptr)
+      {
+        Block* b = c.head;
+        c.head = b->next;
+        c.count--;
+        c.stats.hits++;
+        return b;
+      }
+
+      c.stats.misses++;
+      return heap::alloc<BLOCK_SIZE>();
+    }
+
+    /// Free the stack block `p` into this thread's cache if there is room.
+    static void dealloc(void* p)
+    {
+      size_t capacity = get_capacity();
+      if (capacity != 0)
+      {
+        auto& c = local();
+        if (c.count < capacity)
+        {
+          auto* b = static_cast<Block*>(p);
+          b->next = c.head;
+          c.head = b;
+          c.count++;
+          return;
+        }
+      }
+
+      heap::dealloc<BLOCK_SIZE>(p);
+    }
+
+    /**
+     * Return every block this thread has cached to the heap.
+     **/
+    static void trim()
+    {
+      local().release();
+    }
+  };
+
   class HeapAlloc
   {
   public:
     template<size_t Size>
     ALWAYSINLINE void* alloc()
     {
-      return heap::template alloc<Size>();
+      if constexpr (Size == StackBlockCache::BLOCK_SIZE)
+        return StackBlockCache::alloc();
+      else
+        return heap::template alloc<Size>();
     }
 
     template<size_t Size>
     ALWAYSINLINE void dealloc(void* p)
     {
-      heap::template dealloc<Size>(p);
+      if constexpr (Size == StackBlockCache::BLOCK_SIZE)
+        StackBlockCache::dealloc(p);
+      else
+        heap::template dealloc<Size>(p);
     }
   };
 
   /**
    * This class contains the core functionality for a stack using aligned blocks
    * of memory. The stack is the size of a single pointer when empty.
+   *
+   * Each block holds `PointerCount` pointers, a power of two. Stacks that
+   * grow large, such as those a collector keeps for a whole region, can use
+   * larger blocks to cross block boundaries less often. Only blocks of the
+   * default size go through the StackBlockCache.
    */
-  template<class T, class Alloc = HeapAlloc>
+  template<class T, class Alloc = HeapAlloc, size_t PointerCount = 64>
   class StackThin
   {
     static inline HeapAlloc default_alloc{};
 
   private:
-    static constexpr size_t POINTER_COUNT = 64;
+    static constexpr size_t POINTER_COUNT = PointerCount;
     static_assert(
       snmalloc::bits::next_pow2_const(POINTER_COUNT) == POINTER_COUNT,
       "Should be power of 2 for alignment.");
@@ -43,12 +192,13 @@ namespace verona::rt
 
     /**
      * The assumes that the allocations are aligned to the same threshold as
-     * their size. The blocks contain one previous pointer, and 63 pointers to
-     * Ts.  This is a power of two, so we can use the bottom part of the
-     * pointer to track the index.
+     * their size. The blocks contain one previous pointer, and
+     * POINTER_COUNT - 1 pointers to Ts.  This is a power of two, so we can
+     * use the bottom part of the pointer to track the index.
      *
-     * As the block contains a previous pointer, there are only 64 possible
-     * states for a block, that is 0 - 63 live entries.
+     * As the block contains a previous pointer, there are only POINTER_COUNT
+     * possible states for a block, that is 0 - POINTER_COUNT - 1 live
+     * entries.
      *
      * The stack is represented by a single interior pointer, index, of type
      * T**.
@@ -104,6 +254,12 @@ namespace verona::rt
       return ((uintptr_t)index & INDEX_MASK) == INDEX_MASK;
     }
 
+    /// The number of entries in the block an index points into.
+    static size_t entries(T** index)
+    {
+      return ((uintptr_t)index & INDEX_MASK) / sizeof(T*);
+    }
+
   public:
     StackThin() : index(null_index)
     {
@@ -164,6 +320,49 @@ namespace verona::rt
       push_slow(item, alloc);
     }
 
+    /**
+     * Push the `n` elements of `items`, in order, as that many calls to
+     * push() would, but copying as many as fit into each block at once.
+     */
+    void push_range(T* const* items, size_t n, Alloc& alloc = default_alloc)
+    {
+      while (n > 0)
+      {
+        if (is_full(index))
+        {
+          push_slow(*items++, alloc);
+          n--;
+          continue;
+        }
+
+        size_t k = std::min(n, STACK_COUNT - entries(index));
+        std::memcpy(index + 1, items, k * sizeof(T*));
+        index += k;
+        items += k;
+        n -= k;
+      }
+    }
+
+    /**
+     * Pop up to `n` elements into `out`, in the order that many calls to
+     * pop() would return them, and return how many were popped.
+     */
+    size_t pop_n(T** out, size_t n, Alloc& alloc = default_alloc)
+    {
+      size_t popped = 0;
+      while (popped < n && !empty())
+      {
+        // Take all but the last entry of the block directly, and the last
+        // through pop(), which frees the block.
+        size_t k = std::min(n - popped, entries(index) - 1);
+        for (size_t i = 0; i < k; i++)
+          out[popped++] = *index--;
+        if (popped < n)
+          out[popped++] = pop(alloc);
+      }
+      return popped;
+    }
+
     /// For all elements of the stack
     template<typename F>
     void forall(F&& apply)
@@ -258,7 +457,7 @@ namespace verona::rt
    * elements and pops them on each iteration may trigger allocation the first
    * time but will then not trigger allocation on any subsequent iteration.
    */
-  template<class T>
+  template<class T, size_t PointerCount = 64>
   class Stack
   {
     /**
@@ -267,7 +466,9 @@ namespace verona::rt
      */
     class BackupAlloc
     {
-      using Block = typename StackThin<T, BackupAlloc>::Block;
+      using Block = typename StackThin<T, BackupAlloc, PointerCount>::Block;
+      static constexpr bool cached =
+        sizeof(Block) == StackBlockCache::BLOCK_SIZE;
 
       /// A one place pool of Block.
       Block* backup = nullptr;
@@ -285,6 +486,8 @@ namespace verona::rt
 
         if (backup)
           return std::exchange(backup, nullptr);
+        else if constexpr (cached)
+          return StackBlockCache::alloc();
         else
           return heap::template alloc<Size>();
       }
@@ -299,19 +502,25 @@ namespace verona::rt
 
         if (backup == nullptr)
           backup = b;
+        else if constexpr (cached)
+          StackBlockCache::dealloc(b);
         else
           heap::template dealloc<Size>(b);
       }
 
       ~BackupAlloc()
       {
-        if (backup != nullptr)
+        if (backup == nullptr)
+          return;
+        if constexpr (cached)
+          StackBlockCache::dealloc(backup);
+        else
           heap::template dealloc<sizeof(Block)>(backup);
       }
     };
 
     /// Underlying stack
-    StackThin<T, BackupAlloc> stack;
+    StackThin<T, BackupAlloc, PointerCount> stack;
 
     /// Allocator for new blocks of stack
     BackupAlloc backup_alloc;
@@ -337,6 +546,18 @@ namespace verona::rt
       return stack.pop(backup_alloc);
     }
 
+    /// Put the `n` elements of `items` on the stack, in order.
+    void push_range(T* const* items, size_t n)
+    {
+      stack.push_range(items, n, backup_alloc);
+    }
+
+    /// Remove up to `n` elements into `out`, returning how many.
+    size_t pop_n(T** out, size_t n)
+    {
+      return stack.pop_n(out, n, backup_alloc);
+    }
+
     /// Check if stack is empty
     ALWAYSINLINE bool empty()
     {
@@ -11,12 +11,13 @@
  * Due to portability allocates a largeish array on the stack, if this array is
  * not big enough then dynamically allocates something of the correct size. This
  * is done to avoid the need for a dynamic allocation in the common case.
+ * Callers that know a smaller bound can shrink the stack allocated part with
+ * `Size`.
  */
-template<typename T>
+template<typename T, size_t Size = 128>
 class StackArray
 {
-  // Size of the stack allocated array.
-  static constexpr size_t Size = 128;
+  static_assert(Size > 0, "StackArray needs some stack allocated space");
 
   // Stack allocated array. Untyped to avoid initialisation and destruction.
   char main[Size * sizeof(T)];
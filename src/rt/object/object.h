@@ -61,6 +61,13 @@ namespace verona::rt
    * about this object. However, we again borrow the bottom bits.
    *
    * TODO These are currently used in RC regions.  Properly document.
+   *
+   * On 64-bit platforms the top byte of a descriptor pointer is always zero,
+   * so an RC region in compact mode keeps a small saturating reference count
+   * there, leaving the region meta-data free for a next pointer.
+   *
+   * Where descriptors are 8-byte aligned, the third bit marks an Iso object
+   * allocated together with its region's metadata (see CoAllocation).
    */
   using Alloc = snmalloc::Alloc;
   using namespace snmalloc;
@@ -110,12 +117,37 @@ namespace verona::rt
     using RelocateFunction =
       void (*)(Object* o, Object* (*forward)(Object*));
 
+    // Called to intern frozen objects (see InternTable). The hash must
+    // depend only on what equals compares, and both may compare reference
+    // fields by address, as the objects they refer to are interned first.
+    using HashFunction = size_t (*)(const Object* o);
+    using EqualsFunction = bool (*)(const Object* o, const Object* that);
+
     size_t size;
     TraceFunction trace;
     FinalFunction finaliser;
     NotifiedFunction notified = nullptr;
     DestructorFunction destructor = nullptr;
     RelocateFunction relocate = nullptr;
+    // Optional map of the reference fields, for types whose fields are at
+    // fixed places. Bit i is set if the pointer-sized word at byte offset
+    // i * sizeof(Object*) in the object is an Object* field. Collectors
+    // then visit those fields directly instead of calling trace and
+    // relocate, so the map must name exactly the fields trace pushes.
+    // 0 means no map.
+    uint64_t pointer_map = 0;
+    // Optional structural hash and equality, for types whose frozen objects
+    // may be shared by freeze_interned(). Both or neither must be set.
+    HashFunction hash = nullptr;
+    EqualsFunction equals = nullptr;
+    // Size of an element of the array that trails objects of a variable
+    // sized type, or 0 for fixed size types. Such an object keeps the length
+    // of its array in the first word of its body, and `size` is that of the
+    // object without the array, which starts at the end of it.
+    size_t tail = 0;
+    // Optional name of the type, as from typeid, for profiles of the heap
+    // (see HeapProfile).
+    const char* name = nullptr;
     // TODO: virtual dispatch, pattern matching on type, reflection
   };
 
@@ -132,6 +164,46 @@ namespace verona::rt
     YesTransfer
   };
 
+  /**
+   * One allocation holding the metadata of a region and the Iso object the
+   * region was created with, so that making a small region is one call to
+   * the allocator and the two share cache lines. This header sits between
+   * the two objects. They can outlive each other, as when the Iso is
+   * frozen or merged into another region, so whichever of them is freed
+   * last frees the allocation (see Object::dealloc()).
+   */
+  struct alignas(MIN_ALLOC_SIZE) CoAllocation
+  {
+    std::byte* start;
+    size_t size;
+    std::atomic<size_t> live{2};
+
+    CoAllocation(std::byte* start, size_t size) : start(start), size(size) {}
+
+    /// Allocate `first` bytes, which must be aligned, followed by the
+    /// header, followed by `second` bytes. Returns the header, which is
+    /// at the end of the first part.
+    static CoAllocation* alloc(size_t first, size_t second)
+    {
+      size_t size = first + sizeof(CoAllocation) + second;
+      auto* p = (std::byte*)heap::alloc(size);
+      return new (p + first) CoAllocation(p, size);
+    }
+
+    /// Where the second part starts.
+    void* second()
+    {
+      return this + 1;
+    }
+
+    /// Called once for each of the two objects when it is freed.
+    void release()
+    {
+      if (live.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        heap::dealloc(start, size);
+    }
+  };
+
   /// The C++ representation of objects has no fields. All meta-data for the
   /// object is in the `Header` struct. Object should not be allocated directly,
   /// but instead should be allocated as part of the runtime.
@@ -225,6 +297,22 @@ namespace verona::rt
     static constexpr uint8_t SHIFT = (uint8_t)bits::next_pow2_bits_const(MASK);
     static constexpr size_t ONE_RC = 1 << SHIFT;
 
+    // A compact reference count lives in the top byte of the descriptor word,
+    // on platforms where that byte is free. A count of COMPACT_RC_MAX is
+    // sticky: the real count is then kept by the region.
+    static constexpr uint8_t COMPACT_RC_SHIFT = (sizeof(uintptr_t) * 8) - 8;
+    static constexpr size_t COMPACT_RC_MAX = 0xff;
+    static constexpr uintptr_t COMPACT_RC_MASK = (sizeof(uintptr_t) == 8) ?
+      ((uintptr_t)COMPACT_RC_MAX << COMPACT_RC_SHIFT) :
+      0;
+
+    // Set in the descriptor word of an object that shares a CoAllocation
+    // with the metadata of its region, on platforms where descriptors leave
+    // a third low bit free. The other low bits are for the colour.
+    static constexpr uintptr_t CO_ALLOCATED =
+      (descriptor_alignment >= 8) ? 4 : 0;
+    static constexpr uintptr_t COLOUR_MASK = MARK_MASK & ~CO_ALLOCATED;
+
 #ifdef USE_SYSTEMATIC_TESTING
     // Used to give objects unique identifiers for systematic testing.
     inline static std::atomic<size_t> id_source = 1;
@@ -257,6 +345,15 @@ namespace verona::rt
     Object(const Object&) = delete;
     Object& operator=(const Object&) = delete;
 
+    /// Size of an object of type `desc` whose trailing array has `tail`
+    /// elements. `tail` must be 0 if the type has no trailing array.
+    static size_t size_of(const Descriptor* desc, size_t tail)
+    {
+      assert((desc->tail != 0) || (tail == 0));
+      return desc->size +
+        snmalloc::bits::align_up(tail * desc->tail, ALIGNMENT);
+    }
+
     /// Should be called by the region allocator prior to initialising an
     /// object as part of the runtime.  This is used to ensure that all
     /// subclasses of rt::Object are actually part of the runtime.
@@ -297,8 +394,9 @@ namespace verona::rt
 
     inline const Descriptor* get_descriptor() const
     {
-      return (
-        const Descriptor*)((uintptr_t)get_header().descriptor.load(std::memory_order_relaxed) & ~MARK_MASK);
+      return (const Descriptor*)((uintptr_t)get_header().descriptor.load(
+                                   std::memory_order_relaxed) &
+                                 ~(MARK_MASK | COMPACT_RC_MASK));
     }
 
 #ifdef USE_SYSTEMATIC_TESTING
@@ -362,6 +460,11 @@ namespace verona::rt
       return get_class() == RegionMD::RC;
     }
 
+    bool debug_is_interned()
+    {
+      return is_interned();
+    }
+
     bool debug_test_rc(size_t test_rc)
     {
       assert(debug_is_immutable());
@@ -392,6 +495,16 @@ namespace verona::rt
       return (Object*)(get_header().bits & ~MASK);
     }
 
+    bool debug_is_co_allocated() const
+    {
+      return is_co_allocated();
+    }
+
+    static constexpr bool debug_can_co_allocate()
+    {
+      return CAN_CO_ALLOCATE;
+    }
+
     static bool debug_is_aligned(const void* o)
     {
       return ((uintptr_t)o & MASK) == 0;
@@ -409,14 +522,22 @@ namespace verona::rt
     friend class RegionArena;
     friend class RegionRc;
     friend class RegionSemiSpace;
+    friend class RegionGenerational;
+    friend class RegionCompact;
+    friend class RegionBytes;
+    friend class LargeObjectSpace;
+    friend class ObjectPages;
+    friend class AllocTrace;
+    friend class Snapshot;
+    friend class CownCollector;
     friend class RememberedSet;
     friend class ExternalReferenceTable;
+    friend class HeapProfile;
+    friend class InternTable;
     template<typename Entry>
     friend class ObjectMap;
     friend class Message;
     friend class LocalEpoch;
-    friend size_t debug_get_ref_count(Object* o);
-
     friend class LinkedObjectStack;
 
     template<typename T>
@@ -428,9 +549,12 @@ namespace verona::rt
       return (RegionMD)(get_header().bits & MASK);
     }
 
-    inline size_t size()
+    inline size_t size() const
     {
-      return get_descriptor()->size;
+      const Descriptor* desc = get_descriptor();
+      if (SNMALLOC_LIKELY(desc->tail == 0))
+        return desc->size;
+      return size_of(desc, *reinterpret_cast<const size_t*>(this));
     }
 
     inline bool is_type(const Descriptor* desc)
@@ -438,6 +562,14 @@ namespace verona::rt
       return get_descriptor() == desc;
     }
 
+    /// Record `tail` as the length of the trailing array of this object,
+    /// just allocated, if its type has one.
+    inline void init_tail(size_t tail)
+    {
+      if (get_descriptor()->tail != 0)
+        *reinterpret_cast<size_t*>(this) = tail;
+    }
+
     inline void init_iso()
     {
       get_header().bits = (size_t)this | (uint8_t)RegionMD::ISO;
@@ -496,6 +628,27 @@ namespace verona::rt
       get_header().bits = RegionMD::UNMARKED + ONE_RC;
     }
 
+    inline size_t get_compact_rc()
+    {
+      return (get_header().descriptor_bits & COMPACT_RC_MASK) >>
+        COMPACT_RC_SHIFT;
+    }
+
+    inline void set_compact_rc(size_t rc)
+    {
+      assert(COMPACT_RC_MASK != 0);
+      assert(rc <= COMPACT_RC_MAX);
+      get_header().descriptor_bits =
+        (get_header().descriptor_bits & ~COMPACT_RC_MASK) |
+        (rc << COMPACT_RC_SHIFT);
+    }
+
+    inline void init_compact_ref_count()
+    {
+      get_header().bits = RegionMD::UNMARKED;
+      set_compact_rc(1);
+    }
+
     inline void init_iso_ref_count(size_t count)
     {
       assert(get_class() == RegionMD::ISO);
@@ -549,9 +702,9 @@ namespace verona::rt
       get_header().bits = (get_header().bits & ~MASK) | (uint8_t)RegionMD::RC;
     }
 
-    inline void make_shared()
+    inline void make_shared(size_t rc = ONE_RC)
     {
-      get_header().bits = (size_t)RegionMD::SHARED + ONE_RC;
+      get_header().bits = (size_t)RegionMD::SHARED + rc;
     }
 
     inline bool is_pending()
@@ -673,12 +826,12 @@ namespace verona::rt
     inline void set_rc_colour(RcColour colour)
     {
       get_header().descriptor_bits =
-        (get_header().descriptor_bits & ~MARK_MASK) | (uintptr_t)colour;
+        (get_header().descriptor_bits & ~COLOUR_MASK) | (uintptr_t)colour;
     }
 
     inline RcColour get_rc_colour()
     {
-      return (RcColour)((uintptr_t)get_header().descriptor_bits & MARK_MASK);
+      return (RcColour)((uintptr_t)get_header().descriptor_bits & COLOUR_MASK);
     }
 
     inline bool has_ext_ref()
@@ -692,7 +845,7 @@ namespace verona::rt
     inline void set_has_ext_ref()
     {
       assert(!debug_is_immutable());
-      assert(((uintptr_t)get_header().descriptor.load() & MARK_MASK) == 0);
+      assert(((uintptr_t)get_header().descriptor.load() & COLOUR_MASK) == 0);
 
       get_header().descriptor.store(
         (const Descriptor*)((uintptr_t)get_header().descriptor.load() | (uintptr_t)1),
@@ -707,6 +860,61 @@ namespace verona::rt
         std::memory_order_relaxed);
     }
 
+    /**
+     * Whether this immutable object lives in a block made by
+     * Freeze::apply_compact(), and so is not freed on its own. Immutable
+     * objects have no external references, so this reuses that bit.
+     */
+    inline bool in_frozen_block()
+    {
+      return ((uintptr_t)get_header().descriptor.load() & (uintptr_t)1) ==
+        (uintptr_t)1;
+    }
+
+    inline void set_in_frozen_block()
+    {
+      auto desc = (uintptr_t)get_header().descriptor.load();
+      get_header().descriptor.store(
+        (const Descriptor*)(desc | (uintptr_t)1), std::memory_order_relaxed);
+    }
+
+    /// Whether objects can share a CoAllocation on this platform.
+    static constexpr bool CAN_CO_ALLOCATE = CO_ALLOCATED != 0;
+
+    /**
+     * Whether this object was created as the Iso of a region in one
+     * CoAllocation with the region's metadata, which it then frees along
+     * with.
+     */
+    inline bool is_co_allocated() const
+    {
+      return (get_header().descriptor_bits & CO_ALLOCATED) != 0;
+    }
+
+    inline void set_co_allocated()
+    {
+      assert(CAN_CO_ALLOCATE);
+      get_header().descriptor_bits |= CO_ALLOCATED;
+    }
+
+    /**
+     * Whether this immutable object is in the InternTable. Set only while
+     * it is, so that the release of its last reference takes it out.
+     */
+    inline bool is_interned()
+    {
+      return ((uintptr_t)get_header().descriptor.load() & (uintptr_t)2) ==
+        (uintptr_t)2;
+    }
+
+    inline void set_interned(bool interned)
+    {
+      auto desc = (uintptr_t)get_header().descriptor.load();
+      desc = interned ? (desc | (uintptr_t)2) : (desc & ~(uintptr_t)2);
+      get_header().descriptor.store(
+        (const Descriptor*)desc, std::memory_order_relaxed);
+    }
+
     inline void incref_nonatomic()
     {
       assert(get_class() == RegionMD::NONATOMIC_RC);
@@ -753,12 +961,22 @@ namespace verona::rt
     static constexpr size_t FINISHED_RC =
       (((size_t)1) << (((sizeof(size_t)) * 8) - 1)) + (size_t)RegionMD::SHARED;
 
+    /**
+     * Added to a shared object's reference count while the thread that made
+     * it counts its own references elsewhere (see Shared), so that the count
+     * cannot reach zero while it does, however many of the references that
+     * thread took out are dropped by others.
+     **/
+    static constexpr size_t BIAS_RC = ((size_t)1)
+      << (((sizeof(size_t)) * 8) - 2);
+
     /**
      * Returns true, if this was the last decref on the shared object.  If this
      *returns true all future, and parallel, calls to acquire_strong_from_weak
-     *will return false.
+     *will return false.  `by` is ONE_RC, or BIAS_RC less the references
+     *the owning thread still counts when it gives up its bias.
      **/
-    inline bool decref_shared(bool& release_weak)
+    inline bool decref_shared(bool& release_weak, size_t by = ONE_RC)
     {
       Logging::cout() << "decref_shared " << (void*)this << std::endl;
       // This always performs the atomic subtraction, since the shared object
@@ -770,11 +988,11 @@ namespace verona::rt
       assert(debug_rc() != 0);
       assert(get_header().rc < FINISHED_RC);
       assert(get_class() == RegionMD::SHARED);
-      static constexpr size_t DONE_RC = (size_t)RegionMD::SHARED + ONE_RC;
+      size_t done_rc = (size_t)RegionMD::SHARED + by;
 
-      size_t prev_rc = get_header().rc.fetch_sub(ONE_RC);
+      size_t prev_rc = get_header().rc.fetch_sub(by);
 
-      if (prev_rc != DONE_RC)
+      if (prev_rc != done_rc)
         return false;
 
       yield();
@@ -849,10 +1067,72 @@ namespace verona::rt
       return get_header().rc.load(std::memory_order_relaxed) == FINISHED_RC;
     }
 
+    /**
+     * Point each non-null reference field named by the descriptor's pointer
+     * map at what `forward` returns for it. Returns false, and does
+     * nothing, if the descriptor has no pointer map.
+     **/
+    template<typename Forward>
+    inline bool relocate_mapped(Forward forward)
+    {
+      uint64_t map = get_descriptor()->pointer_map;
+      if (map == 0)
+        return false;
+
+      auto** fields = (Object**)this;
+      for (size_t i = 0; map != 0; i++, map >>= 1)
+      {
+        if (((map & 1) != 0) && (fields[i] != nullptr))
+          fields[i] = forward(fields[i]);
+      }
+      return true;
+    }
+
+    /**
+     * Point the fields of this object at the addresses `forward` gives for
+     * the objects they reference: through the pointer map, else through
+     * Descriptor::relocate, else by scanning the body for words `forward`
+     * changes. The scan can theoretically rewrite a non-pointer field that
+     * happens to hold the address of such an object.
+     **/
+    inline void relocate_fields(Object* (*forward)(Object*))
+    {
+      if (relocate_mapped(forward))
+        return;
+
+      const Descriptor* desc = get_descriptor();
+      if (desc->relocate != nullptr)
+      {
+        desc->relocate(this, forward);
+        return;
+      }
+
+      auto** body = (Object**)this;
+      size_t words = (size() - sizeof(Header)) / sizeof(Object*);
+      for (size_t i = 0; i < words; i++)
+      {
+        if (body[i] != nullptr)
+          body[i] = forward(body[i]);
+      }
+    }
+
   private:
     inline void trace(ObjectStack& f) const
     {
-      get_descriptor()->trace(this, f);
+      const Descriptor* desc = get_descriptor();
+      uint64_t map = desc->pointer_map;
+      if (map == 0)
+      {
+        desc->trace(this, f);
+        return;
+      }
+
+      auto* const* fields = (Object* const*)this;
+      for (size_t i = 0; map != 0; i++, map >>= 1)
+      {
+        if (((map & 1) != 0) && (fields[i] != nullptr))
+          f.push(fields[i]);
+      }
     }
 
     inline void finalise(Object* region, ObjectStack& isos)
@@ -875,6 +1155,11 @@ namespace verona::rt
 
     inline void dealloc()
     {
+      if (SNMALLOC_UNLIKELY(is_co_allocated()))
+      {
+        ((CoAllocation*)real_start() - 1)->release();
+        return;
+      }
       heap::dealloc(&this->get_header(), size());
     }
 
@@ -0,0 +1,12 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include <cstddef>
+
+namespace verona::rt
+{
+  /// Bytes in a cache line. Data written by different cores is aligned to
+  /// this to keep it on separate lines.
+  static constexpr size_t CACHE_LINE = 64;
+} // namespace verona::rt
@@ -5,9 +5,11 @@
 #include <snmalloc/snmalloc.h>
 
 #if defined(__linux__)
+#  include <dirent.h>
 #  include <sched.h>
 #  include <stdio.h>
 #  include <stdlib.h>
+#  include <string.h>
 #  include <unistd.h>
 #elif defined(_WIN32)
 #  include <processtopologyapi.h>
@@ -30,13 +32,32 @@
 
 #include <algorithm>
 #include <functional>
+#include <tuple>
 #include <vector>
 
 namespace verona::rt
 {
   using namespace snmalloc;
+
   class Topology
   {
+  public:
+    /**
+     * The order in which the cores of a scheduler are given CPUs.
+     */
+    enum class Placement
+    {
+      /// One thread on each physical core before any two share one, filling
+      /// a NUMA node, package and shared cache before the next.
+      Scatter,
+      /// The hyperthreads of each physical core next to each other, so that
+      /// threads share as few caches and packages as they can.
+      Compact,
+      /// Only the CPUs of one socket, in scatter order, so that pools
+      /// pinned to different sockets do not share CPUs.
+      Socket,
+    };
+
   private:
     struct CPU
     {
@@ -45,6 +66,12 @@ namespace verona::rt
       size_t group;
       size_t id;
       bool hyperthread;
+      /// CPUs with the same `l3` in the same package share a last-level
+      /// cache.
+      size_t l3 = 0;
+      /// CPUs with the same `core` in the same package are hyperthreads of
+      /// one physical core.
+      size_t core = 0;
 
       size_t get()
       {
@@ -75,6 +102,13 @@ namespace verona::rt
         if (package > that.package)
           return false;
 
+        // Sort by shared cache within a package.
+        if (l3 < that.l3)
+          return true;
+
+        if (l3 > that.l3)
+          return false;
+
         // Sort by group.
         if (group < that.group)
           return true;
@@ -85,9 +119,24 @@ namespace verona::rt
         // Sort by id.
         return id < that.id;
       }
+
+      /// The order of Placement::Compact.
+      static bool compact_less(const CPU& a, const CPU& b)
+      {
+        return std::tie(a.numa_node, a.package, a.l3, a.core, a.group, a.id) <
+          std::tie(b.numa_node, b.package, b.l3, b.core, b.group, b.id);
+      }
+
+      size_t socket() const
+      {
+        return (package << 16) | numa_node;
+      }
     };
 
+    /// Every CPU the process may run on, in scatter order.
     std::vector<CPU> cpus;
+    /// The CPUs the cores are given, in order, as set by place().
+    std::vector<CPU> placed;
 
 #if defined(CPU_COUNT) && defined(CPU_ISSET)
     template<typename CPUSet>
@@ -100,12 +149,15 @@ namespace verona::rt
       uint32_t index = 0;
       uint32_t found = 0;
 
-      // TODO: CPU topology detection for Linux
       while (found < count)
       {
         if (CPU_ISSET(index, &all_cpus))
         {
+#  if defined(__linux__)
+          cpus.push_back(linux_cpu(index));
+#  else
           cpus.push_back(CPU{0, 0, 0, index, false});
+#  endif
           found++;
         }
 
@@ -114,6 +166,125 @@ namespace verona::rt
     }
 #endif
 
+#if defined(__linux__)
+    /**
+     * Read the number in the sysfs file `name` of CPU `id`, or return
+     * `fallback` if there is none.
+     */
+    static size_t read_cpu_value(size_t id, const char* name, size_t fallback)
+    {
+      char path[128];
+      snprintf(
+        path, sizeof(path), "/sys/devices/system/cpu/cpu%zu/%s", id, name);
+      FILE* f = fopen(path, "r");
+      if (f == nullptr)
+        return fallback;
+
+      size_t value;
+      if (fscanf(f, "%zu", &value) != 1)
+        value = fallback;
+      fclose(f);
+      return value;
+    }
+
+    /**
+     * Describe CPU `id` from sysfs. Anything missing, as in a container
+     * without sysfs, reads as 0, which puts every CPU in the same place.
+     */
+    static CPU linux_cpu(uint32_t id)
+    {
+      CPU cpu{0, 0, 0, id, false};
+      cpu.package = read_cpu_value(id, "topology/physical_package_id", 0);
+      cpu.l3 = read_cpu_value(id, "cache/index3/id", 0);
+
+      // The first CPU listed as a sibling is the physical core.
+      cpu.core = read_cpu_value(id, "topology/thread_siblings_list", id);
+      cpu.hyperthread = cpu.core != id;
+
+      // The NUMA node is the `node<n>` entry in the CPU's directory.
+      char path[64];
+      snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%u", id);
+      DIR* dir = opendir(path);
+      if (dir != nullptr)
+      {
+        while (dirent* e = readdir(dir))
+        {
+          size_t node;
+          if (sscanf(e->d_name, "node%zu", &node) == 1)
+          {
+            cpu.numa_node = node;
+            break;
+          }
+        }
+        closedir(dir);
+      }
+      return cpu;
+    }
+
+    /**
+     * The CPUs' worth of time the CPU quota of the process's cgroup allows,
+     * rounded up, or `fallback` if it has none.
+     */
+    static size_t cgroup_cpu_limit(size_t fallback)
+    {
+      // Under cgroup v2, the line "0::<path>" names the process's cgroup.
+      char dir[600] = "/sys/fs/cgroup";
+      FILE* f = fopen("/proc/self/cgroup", "r");
+      if (f != nullptr)
+      {
+        char line[512];
+        while (fgets(line, sizeof(line), f) != nullptr)
+        {
+          if (strncmp(line, "0::", 3) == 0)
+          {
+            line[strcspn(line, "\n")] = '\0';
+            snprintf(dir, sizeof(dir), "/sys/fs/cgroup%s", line + 3);
+            break;
+          }
+        }
+        fclose(f);
+      }
+
+      char path[640];
+      long long quota = -1;
+      long long period = 0;
+
+      // cgroup v2 has "<quota> <period>" in cpu.max, or "max <period>".
+      snprintf(path, sizeof(path), "%s/cpu.max", dir);
+      f = fopen(path, "r");
+      if (f != nullptr)
+      {
+        char q[32];
+        if (fscanf(f, "%31s %lld", q, &period) == 2 && strcmp(q, "max") != 0)
+          quota = atoll(q);
+        fclose(f);
+      }
+      else
+      {
+        // cgroup v1 has them in two files, with a quota of -1 for none.
+        f = fopen("/sys/fs/cgroup/cpu/cpu.cfs_quota_us", "r");
+        if (f != nullptr)
+        {
+          if (fscanf(f, "%lld", &quota) != 1)
+            quota = -1;
+          fclose(f);
+        }
+        f = fopen("/sys/fs/cgroup/cpu/cpu.cfs_period_us", "r");
+        if (f != nullptr)
+        {
+          if (fscanf(f, "%lld", &period) != 1)
+            period = 0;
+          fclose(f);
+        }
+      }
+
+      if (quota <= 0 || period <= 0)
+        return fallback;
+
+      return std::max<size_t>(1, (size_t)((quota + period - 1) / period));
+    }
+#endif
+
   public:
     static void init(Topology* top) noexcept
     {
@@ -155,6 +326,7 @@ namespace verona::rt
                 group,
                 id,
                 hyperthread});
+              top->cpus.back().core = i;
 
               hyperthread = true;
             }
@@ -201,23 +373,105 @@ namespace verona::rt
 #endif
 
       std::sort(top->cpus.begin(), top->cpus.end());
+      top->placed = top->cpus;
+    }
+
+    /**
+     * Order the CPUs that get(), socket() and cache() return by `placement`.
+     * For Placement::Socket, `socket` picks the socket, counting from 0 in
+     * scatter order; there must be that many sockets.
+     */
+    void place(Placement placement, size_t socket = 0)
+    {
+      placed = cpus;
+      switch (placement)
+      {
+        case Placement::Scatter:
+          break;
+
+        case Placement::Compact:
+          std::stable_sort(placed.begin(), placed.end(), CPU::compact_less);
+          break;
+
+        case Placement::Socket:
+        {
+          std::vector<size_t> sockets;
+          for (const CPU& cpu : cpus)
+          {
+            if (
+              std::find(sockets.begin(), sockets.end(), cpu.socket()) ==
+              sockets.end())
+              sockets.push_back(cpu.socket());
+          }
+          if (socket >= sockets.size())
+            abort();
+
+          placed.clear();
+          for (const CPU& cpu : cpus)
+          {
+            if (cpu.socket() == sockets[socket])
+              placed.push_back(cpu);
+          }
+          break;
+        }
+      }
     }
 
     size_t get(size_t index)
     {
-      if (cpus.size() == 0)
+      if (placed.size() == 0)
         abort();
 
-      index = index % cpus.size();
-      return cpus.at(index).get();
+      index = index % placed.size();
+      return placed.at(index).get();
     }
 
     size_t size()
     {
-      if (cpus.size() == 0)
+      if (placed.size() == 0)
         abort();
 
-      return cpus.size();
+      return placed.size();
+    }
+
+    /**
+     * How many threads the process can keep running at once: the CPUs
+     * size() counts, capped by the CPU quota of its cgroup on Linux, as a
+     * container limited to some CPUs' worth of time has. More scheduler
+     * threads than this only take turns on the CPUs.
+     */
+    size_t available()
+    {
+      size_t count = size();
+#if defined(__linux__)
+      count = std::min(count, cgroup_cpu_limit(count));
+#endif
+      return count;
+    }
+
+    /**
+     * An identifier shared by the CPUs in the same package and NUMA node as
+     * the one get(index) returns.
+     */
+    size_t socket(size_t index)
+    {
+      if (placed.size() == 0)
+        return 0;
+
+      return placed.at(index % placed.size()).socket();
+    }
+
+    /**
+     * An identifier shared by the CPUs that share a last-level cache with
+     * the one get(index) returns.
+     */
+    size_t cache(size_t index)
+    {
+      if (placed.size() == 0)
+        return 0;
+
+      const CPU& cpu = placed.at(index % placed.size());
+      return (socket(index) << 16) | cpu.l3;
     }
 
   private:
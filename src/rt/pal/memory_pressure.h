@@ -0,0 +1,266 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "memory_sampler.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <snmalloc/snmalloc.h>
+
+#if defined(__linux__)
+#  include <stdio.h>
+#  include <string.h>
+#  include <string>
+#  if defined(SNMALLOC_PASS_THROUGH) && defined(__GLIBC__)
+#    include <malloc.h>
+#  endif
+#elif defined(_WIN32)
+#  include <windows.h>
+#endif
+
+namespace verona::rt
+{
+  /**
+   * Watches the memory pressure on the process, so that the runtime can
+   * give memory back before the OS or a cgroup limit takes it by force.
+   * Off by default; see set_watermark().
+   *
+   * Scheduler threads poll it as they refill their batch of work, and at
+   * most one sample is taken every get_interval() cycles. A sample finds
+   * pressure if the memory in use, that of the process's cgroup where
+   * there is one and its resident set otherwise, is at least the
+   * watermark, or if the OS says so:
+   *
+   *  - On Linux, if the cgroup has hit memory.high or memory.max since the
+   *    last sample (memory.events), or if tasks have been stalled on
+   *    memory for PSI_THRESHOLD percent of the last 10 seconds (PSI, from
+   *    the cgroup's memory.pressure or /proc/pressure/memory).
+   *  - On Windows, if the system's low memory resource notification is
+   *    signalled.
+   *
+   * Each sample that finds pressure is an alarm, as is each call to
+   * signal(). On an alarm every running scheduler thread empties its
+   * caches, hands its allocator's free memory back and lets through every
+   * collection its GCPacer holds, most garbage first, and until a sample
+   * finds none, semispace regions free the space each collection empties.
+   */
+  class MemoryPressure
+  {
+  public:
+    /// Default cycles between samples.
+    static constexpr uint64_t DEFAULT_INTERVAL = 100'000'000;
+
+    /// Share of time stalled on memory, in percent, that counts as pressure.
+    static constexpr size_t PSI_THRESHOLD = 10;
+
+  private:
+    static inline std::atomic<size_t> watermark_{0};
+    static inline std::atomic<uint64_t> interval_{DEFAULT_INTERVAL};
+
+    /// Tick before which no sample is taken.
+    static inline std::atomic<uint64_t> next_sample_{0};
+    static inline std::atomic<bool> pressure_{false};
+    static inline std::atomic<size_t> alarms_{0};
+
+#if defined(__linux__)
+    /// memory.events limit hits at the last sample. Only touched by the
+    /// thread taking a sample.
+    static inline uint64_t limit_events_ = 0;
+
+    /// The directory of the process's cgroup (v2), or empty if there is
+    /// none.
+    static const std::string& cgroup()
+    {
+      static const std::string dir = []() {
+        std::string d;
+        FILE* f = fopen("/proc/self/cgroup", "r");
+        if (f == nullptr)
+          return d;
+        char line[512];
+        while (fgets(line, sizeof(line), f) != nullptr)
+        {
+          if (strncmp(line, "0::", 3) != 0)
+            continue;
+          d = std::string("/sys/fs/cgroup") + (line + 3);
+          while (!d.empty() && (d.back() == '\n' || d.back() == '/'))
+            d.pop_back();
+          break;
+        }
+        fclose(f);
+        return d;
+      }();
+      return dir;
+    }
+
+    /// The number at the start of the file `path`, or 0 if it has none.
+    static uint64_t read_number(const std::string& path)
+    {
+      FILE* f = fopen(path.c_str(), "r");
+      if (f == nullptr)
+        return 0;
+      unsigned long long n = 0;
+      if (fscanf(f, "%llu", &n) != 1)
+        n = 0;
+      fclose(f);
+      return n;
+    }
+
+    /// Times the cgroup has hit memory.high or memory.max.
+    static uint64_t read_limit_events()
+    {
+      FILE* f = fopen((cgroup() + "/memory.events").c_str(), "r");
+      if (f == nullptr)
+        return 0;
+      uint64_t events = 0;
+      char key[32];
+      unsigned long long n;
+      while (fscanf(f, "%31s %llu", key, &n) == 2)
+      {
+        if ((strcmp(key, "high") == 0) || (strcmp(key, "max") == 0))
+          events += n;
+      }
+      fclose(f);
+      return events;
+    }
+
+    /// Whether the "some avg10" stall of a PSI file is over the threshold.
+    static bool read_psi(const std::string& path)
+    {
+      FILE* f = fopen(path.c_str(), "r");
+      if (f == nullptr)
+        return false;
+      double avg10 = 0;
+      int read = fscanf(f, "some avg10=%lf", &avg10);
+      fclose(f);
+      return (read == 1) && (avg10 >= (double)PSI_THRESHOLD);
+    }
+#endif
+
+    /// Memory in use, as compared with the watermark.
+    static size_t usage()
+    {
+#if defined(__linux__)
+      if (!cgroup().empty())
+      {
+        uint64_t current = read_number(cgroup() + "/memory.current");
+        if (current != 0)
+          return (size_t)current;
+      }
+#endif
+      return MemorySampler::process_rss();
+    }
+
+    static bool os_pressure()
+    {
+#if defined(__linux__)
+      bool pressure = false;
+      if (!cgroup().empty())
+      {
+        uint64_t events = read_limit_events();
+        pressure = events > limit_events_;
+        limit_events_ = events;
+      }
+      return pressure || read_psi(cgroup() + "/memory.pressure") ||
+        read_psi("/proc/pressure/memory");
+#elif defined(_WIN32)
+      static HANDLE low =
+        CreateMemoryResourceNotification(LowMemoryResourceNotification);
+      BOOL state = FALSE;
+      return (low != nullptr) && QueryMemoryResourceNotification(low, &state) &&
+        state;
+#else
+      return false;
+#endif
+    }
+
+  public:
+    /**
+     * Set the memory in use, in bytes, at which there is pressure. 0, the
+     * default, stops sampling, but signal() still raises alarms.
+     */
+    static void set_watermark(size_t bytes)
+    {
+      watermark_.store(bytes, std::memory_order_relaxed);
+    }
+
+    static size_t get_watermark()
+    {
+      return watermark_.load(std::memory_order_relaxed);
+    }
+
+    static void set_interval(uint64_t cycles)
+    {
+      interval_.store(cycles, std::memory_order_relaxed);
+    }
+
+    static uint64_t get_interval()
+    {
+      return interval_.load(std::memory_order_relaxed);
+    }
+
+    /// Whether the last sample, or a signal() since, found pressure.
+    static bool is_under_pressure()
+    {
+      return pressure_.load(std::memory_order_relaxed);
+    }
+
+    /// Number of alarms so far.
+    static size_t get_alarms()
+    {
+      return alarms_.load(std::memory_order_acquire);
+    }
+
+    /**
+     * Raise an alarm, for pressure that the program learns of itself. It
+     * counts as pressure until the next sample, get_interval() cycles on.
+     */
+    static void signal()
+    {
+      next_sample_.store(
+        snmalloc::Aal::tick() + get_interval(), std::memory_order_relaxed);
+      pressure_.store(true, std::memory_order_relaxed);
+      alarms_.fetch_add(1, std::memory_order_release);
+    }
+
+    /**
+     * Take a sample if one is due. Called by scheduler threads.
+     */
+    static void poll()
+    {
+      if ((get_watermark() == 0) && !is_under_pressure())
+        return;
+
+      uint64_t now = snmalloc::Aal::tick();
+      uint64_t next = next_sample_.load(std::memory_order_relaxed);
+      if (
+        (now < next) ||
+        !next_sample_.compare_exchange_strong(
+          next, now + get_interval(), std::memory_order_relaxed))
+        return;
+
+      size_t watermark = get_watermark();
+      bool pressure =
+        (watermark != 0) && ((usage() >= watermark) || os_pressure());
+      pressure_.store(pressure, std::memory_order_relaxed);
+      if (pressure)
+        alarms_.fetch_add(1, std::memory_order_release);
+    }
+
+    /**
+     * Hand the free memory this thread's allocator holds back, so that it
+     * can be returned to the OS.
+     */
+    static void release_heap()
+    {
+#ifdef SNMALLOC_PASS_THROUGH
+#  if defined(__linux__) && defined(__GLIBC__)
+      malloc_trim(0);
+#  endif
+#else
+      snmalloc::ThreadAlloc::get().flush();
+#endif
+    }
+  };
+} // namespace verona::rt
@@ -0,0 +1,183 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "threading.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <snmalloc/snmalloc.h>
+
+#if defined(__linux__)
+#  include <stdio.h>
+#  include <unistd.h>
+#elif defined(_WIN32)
+#  include <windows.h>
+// windows.h must come first.
+#  include <psapi.h>
+#elif defined(__APPLE__)
+#  include <mach/mach.h>
+#endif
+
+namespace verona::rt
+{
+  /**
+   * Samples the memory of the whole process on a background thread, for
+   * the benchmark harness: its resident set, and the memory snmalloc has
+   * taken from the OS. Unlike the regions' own counts, these include
+   * allocator fragmentation, idle semispaces, arena slack and metadata.
+   *
+   * Samples are taken every get_interval() microseconds between start()
+   * and stop(), and once at each of them. An interval of 0 turns sampling
+   * off.
+   */
+  class MemorySampler
+  {
+  public:
+    struct Summary
+    {
+      size_t samples = 0;
+      size_t peak_rss = 0;
+      size_t avg_rss = 0;
+      size_t peak_allocator = 0;
+      size_t avg_allocator = 0;
+    };
+
+  private:
+    static inline std::atomic<size_t> interval_us_{10000};
+
+    std::mutex m;
+    std::condition_variable cv;
+    bool stopping = false;
+    std::optional<PlatformThread> thread;
+
+    Summary summary;
+    size_t rss_total = 0;
+    size_t allocator_total = 0;
+
+    void sample()
+    {
+      size_t rss = process_rss();
+      size_t allocator = allocator_usage();
+      summary.samples++;
+      summary.peak_rss = std::max(summary.peak_rss, rss);
+      summary.peak_allocator = std::max(summary.peak_allocator, allocator);
+      rss_total += rss;
+      allocator_total += allocator;
+    }
+
+  public:
+    static void set_interval(size_t us)
+    {
+      interval_us_.store(us, std::memory_order_relaxed);
+    }
+
+    static size_t get_interval()
+    {
+      return interval_us_.load(std::memory_order_relaxed);
+    }
+
+    /// Resident set size of the process in bytes, or 0 if unknown.
+    static size_t process_rss()
+    {
+#if defined(__linux__)
+      FILE* f = fopen("/proc/self/statm", "r");
+      if (f == nullptr)
+        return 0;
+      unsigned long size = 0;
+      unsigned long resident = 0;
+      int read = fscanf(f, "%lu %lu", &size, &resident);
+      fclose(f);
+      if (read != 2)
+        return 0;
+      return (size_t)resident * (size_t)sysconf(_SC_PAGESIZE);
+#elif defined(_WIN32)
+      PROCESS_MEMORY_COUNTERS pmc;
+      if (!GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)))
+        return 0;
+      return pmc.WorkingSetSize;
+#elif defined(__APPLE__)
+      mach_task_basic_info_data_t info;
+      mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+      if (
+        task_info(
+          mach_task_self(),
+          MACH_TASK_BASIC_INFO,
+          (task_info_t)&info,
+          &count) != KERN_SUCCESS)
+        return 0;
+      return info.resident_size;
+#else
+      return 0;
+#endif
+    }
+
+    /// Bytes snmalloc currently has from the OS, or 0 if it is bypassed.
+    static size_t allocator_usage()
+    {
+#ifdef SNMALLOC_PASS_THROUGH
+      return 0;
+#else
+      return snmalloc::Alloc::Config::Backend::get_current_usage();
+#endif
+    }
+
+    MemorySampler() = default;
+
+    MemorySampler(const MemorySampler&) = delete;
+    MemorySampler& operator=(const MemorySampler&) = delete;
+
+    ~MemorySampler()
+    {
+      stop();
+    }
+
+    /// Start sampling, unless the interval is 0.
+    void start()
+    {
+      size_t interval = get_interval();
+      if (interval == 0)
+        return;
+
+      sample();
+      thread.emplace([this, interval]() {
+        std::unique_lock<std::mutex> lock(m);
+        while (!cv.wait_for(
+          lock, std::chrono::microseconds(interval), [this]() {
+            return stopping;
+          }))
+          sample();
+      });
+    }
+
+    /// Stop sampling, and return what was seen since start().
+    Summary stop()
+    {
+      if (thread.has_value())
+      {
+        {
+          std::lock_guard<std::mutex> lock(m);
+          stopping = true;
+        }
+        cv.notify_one();
+        thread->join();
+        thread.reset();
+        sample();
+      }
+
+      Summary s = summary;
+      if (s.samples != 0)
+      {
+        s.avg_rss = rss_total / s.samples;
+        s.avg_allocator = allocator_total / s.samples;
+      }
+      return s;
+    }
+  };
+} // namespace verona::rt
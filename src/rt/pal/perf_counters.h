@@ -0,0 +1,280 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__linux__)
+#  include <cstring>
+#  include <linux/perf_event.h>
+#  include <sys/ioctl.h>
+#  include <sys/syscall.h>
+#  include <unistd.h>
+#endif
+
+namespace verona::rt
+{
+  /**
+   * Hardware performance counters, read through perf_event_open on Linux,
+   * for the benchmark harness.
+   *
+   * Off unless set_enabled(true) is called. Elsewhere, or where the kernel
+   * refuses a counter (perf_event_paranoid, or a virtual machine without
+   * the event), the counter reads as unavailable and every other counter
+   * still works.
+   */
+  class PerfCounters
+  {
+  public:
+    enum Counter : size_t
+    {
+      Cycles,
+      Instructions,
+      LLCMisses,
+      DTLBMisses,
+      BranchMisses,
+      COUNT
+    };
+
+    static constexpr const char* NAMES[COUNT] = {
+      "cycles", "instructions", "llc_misses", "dtlb_misses", "branch_misses"};
+
+    /// A reading, or the difference between two.
+    struct Values
+    {
+      uint64_t value[COUNT] = {};
+      /// Bit `c` is set if counter `c` was read.
+      uint32_t available = 0;
+
+      bool has(Counter c) const
+      {
+        return (available & (1u << c)) != 0;
+      }
+
+      Values operator-(const Values& earlier) const
+      {
+        Values d;
+        d.available = available & earlier.available;
+        for (size_t c = 0; c < COUNT; c++)
+          d.value[c] = d.has((Counter)c) ? value[c] - earlier.value[c] : 0;
+        return d;
+      }
+
+      Values& operator+=(const Values& other)
+      {
+        available |= other.available;
+        for (size_t c = 0; c < COUNT; c++)
+          value[c] += other.value[c];
+        return *this;
+      }
+    };
+
+  private:
+    static inline std::atomic<bool> enabled_{false};
+
+#if defined(__linux__)
+    static int open_counter(Counter c, int group, bool inherit)
+    {
+      perf_event_attr attr;
+      std::memset(&attr, 0, sizeof(attr));
+      attr.size = sizeof(attr);
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+      attr.inherit = inherit ? 1 : 0;
+      attr.disabled = (group == -1) ? 1 : 0;
+      if (group == -1 && !inherit)
+        attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_ID;
+
+      switch (c)
+      {
+        case Cycles:
+          attr.type = PERF_TYPE_HARDWARE;
+          attr.config = PERF_COUNT_HW_CPU_CYCLES;
+          break;
+        case Instructions:
+          attr.type = PERF_TYPE_HARDWARE;
+          attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+          break;
+        case LLCMisses:
+          attr.type = PERF_TYPE_HARDWARE;
+          attr.config = PERF_COUNT_HW_CACHE_MISSES;
+          break;
+        case DTLBMisses:
+          attr.type = PERF_TYPE_HW_CACHE;
+          attr.config = PERF_COUNT_HW_CACHE_DTLB |
+            (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+            (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+          break;
+        case BranchMisses:
+          attr.type = PERF_TYPE_HARDWARE;
+          attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+          break;
+        default:
+          return -1;
+      }
+
+      return (int)syscall(SYS_perf_event_open, &attr, 0, -1, group, 0);
+    }
+#endif
+
+    /**
+     * The counters of one thread, as one group so that they are all
+     * scheduled onto the PMU together and read in one system call.
+     */
+    class ThreadGroup
+    {
+#if defined(__linux__)
+      int fd[COUNT];
+      uint64_t id[COUNT] = {};
+      int leader = -1;
+
+    public:
+      ThreadGroup()
+      {
+        for (size_t c = 0; c < COUNT; c++)
+        {
+          fd[c] = open_counter((Counter)c, leader, false);
+          if (fd[c] == -1)
+            continue;
+          if (leader == -1)
+            leader = fd[c];
+          ioctl(fd[c], PERF_EVENT_IOC_ID, &id[c]);
+        }
+        if (leader != -1)
+        {
+          ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+          ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+        }
+      }
+
+      ~ThreadGroup()
+      {
+        for (int f : fd)
+        {
+          if (f != -1)
+            close(f);
+        }
+      }
+
+      Values read_values()
+      {
+        Values v;
+        if (leader == -1)
+          return v;
+
+        struct
+        {
+          uint64_t nr;
+          struct
+          {
+            uint64_t value;
+            uint64_t id;
+          } values[COUNT];
+        } data;
+        if (::read(leader, &data, sizeof(data)) <= 0)
+          return v;
+
+        for (size_t i = 0; i < data.nr && i < COUNT; i++)
+        {
+          for (size_t c = 0; c < COUNT; c++)
+          {
+            if (fd[c] != -1 && id[c] == data.values[i].id)
+            {
+              v.value[c] = data.values[i].value;
+              v.available |= 1u << c;
+            }
+          }
+        }
+        return v;
+      }
+#else
+    public:
+      Values read_values()
+      {
+        return {};
+      }
+#endif
+    };
+
+  public:
+    static void set_enabled(bool on)
+    {
+      enabled_.store(on, std::memory_order_relaxed);
+    }
+
+    static bool is_enabled()
+    {
+      return enabled_.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * The counters of the calling thread, opened on its first call. Only
+     * the difference between two readings means anything.
+     */
+    static Values read_thread()
+    {
+      static thread_local ThreadGroup group;
+      return group.read_values();
+    }
+
+    /**
+     * Counters for the calling thread and every thread it starts while
+     * they are open, such as the scheduler threads of a whole benchmark
+     * run. A thread's counts are added when it exits, so read() once the
+     * threads have been joined.
+     *
+     * The kernel cannot read inherited counters as a group, so each is
+     * opened on its own and they may be multiplexed.
+     */
+    class Inherited
+    {
+#if defined(__linux__)
+      int fd[COUNT];
+
+    public:
+      Inherited()
+      {
+        for (size_t c = 0; c < COUNT; c++)
+        {
+          fd[c] = is_enabled() ? open_counter((Counter)c, -1, true) : -1;
+          if (fd[c] != -1)
+            ioctl(fd[c], PERF_EVENT_IOC_ENABLE, 0);
+        }
+      }
+
+      ~Inherited()
+      {
+        for (int f : fd)
+        {
+          if (f != -1)
+            close(f);
+        }
+      }
+
+      Values read()
+      {
+        Values v;
+        for (size_t c = 0; c < COUNT; c++)
+        {
+          if (fd[c] != -1 && ::read(fd[c], &v.value[c], sizeof(uint64_t)) > 0)
+            v.available |= 1u << c;
+        }
+        return v;
+      }
+#else
+    public:
+      Inherited() = default;
+
+      Values read()
+      {
+        return {};
+      }
+#endif
+
+      Inherited(const Inherited&) = delete;
+      Inherited& operator=(const Inherited&) = delete;
+    };
+  };
+} // namespace verona::rt
@@ -18,7 +18,108 @@
 #  if __has_include(<version>)
 #    include <version>
 #  endif
-#  if defined(__cpp_lib_semaphore)
+#  include <algorithm>
+#  include <chrono>
+#  include <cstdint>
+#  if defined(__linux__)
+#    include <cerrno>
+#    include <cstdlib>
+#    include <ctime>
+#    include <linux/futex.h>
+#    include <sys/syscall.h>
+#    include <unistd.h>
+namespace verona::rt::pal
+{
+  /**
+   * A binary semaphore on a futex word, so that a release with no thread
+   * waiting costs one atomic exchange and no system call.
+   */
+  class SemaphoreImpl
+  {
+    /// 1 if released and not yet acquired, 2 if a thread may be waiting.
+    std::atomic<uint32_t> word{0};
+
+    long futex(int op, uint32_t value, const timespec* timeout = nullptr)
+    {
+      return syscall(
+        SYS_futex,
+        reinterpret_cast<uint32_t*>(&word),
+        op | FUTEX_PRIVATE_FLAG,
+        value,
+        timeout,
+        nullptr,
+        0);
+    }
+
+  public:
+    void release()
+    {
+      if (word.exchange(1, std::memory_order_release) == 2)
+        futex(FUTEX_WAKE, 1);
+    }
+
+    void acquire()
+    {
+      while (true)
+      {
+        uint32_t w = word.exchange(0, std::memory_order_acquire);
+        if (w == 1)
+          return;
+
+        // Announce the wait, unless a release got in first.
+        w = 0;
+        if (!word.compare_exchange_strong(
+              w, 2, std::memory_order_relaxed, std::memory_order_relaxed))
+          continue;
+
+        if ((futex(FUTEX_WAIT, 2) != 0) && (errno != EAGAIN) &&
+            (errno != EINTR))
+        {
+          // Failed to wait on the futex.
+          abort();
+        }
+      }
+    }
+
+    /**
+     * As acquire(), but gives up after `timeout_ns` nanoseconds. Returns
+     * whether it acquired.
+     */
+    bool acquire_for(uint64_t timeout_ns)
+    {
+      auto deadline =
+        std::chrono::steady_clock::now() + std::chrono::nanoseconds(timeout_ns);
+      while (true)
+      {
+        uint32_t w = word.exchange(0, std::memory_order_acquire);
+        if (w == 1)
+          return true;
+
+        auto left = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                      deadline - std::chrono::steady_clock::now())
+                      .count();
+        if (left <= 0)
+          return false;
+
+        w = 0;
+        if (!word.compare_exchange_strong(
+              w, 2, std::memory_order_relaxed, std::memory_order_relaxed))
+          continue;
+
+        timespec ts;
+        ts.tv_sec = static_cast<time_t>(left / 1'000'000'000);
+        ts.tv_nsec = static_cast<long>(left % 1'000'000'000);
+        if ((futex(FUTEX_WAIT, 2, &ts) != 0) && (errno != EAGAIN) &&
+            (errno != EINTR) && (errno != ETIMEDOUT))
+        {
+          // Failed to wait on the futex.
+          abort();
+        }
+      }
+    }
+  };
+} // namespace verona::rt::pal
+#  elif defined(__cpp_lib_semaphore)
 #    include <semaphore>
 namespace verona::rt::pal
 {
@@ -36,6 +137,11 @@ namespace verona::rt::pal
     {
       semaphore_.acquire();
     }
+
+    bool acquire_for(uint64_t timeout_ns)
+    {
+      return semaphore_.try_acquire_for(std::chrono::nanoseconds(timeout_ns));
+    }
   };
 } // namespace verona::rt::pal
 #  elif defined(__APPLE__)
@@ -66,6 +172,13 @@ namespace verona::rt::pal
     {
       dispatch_semaphore_wait(semaphore_, DISPATCH_TIME_FOREVER);
     }
+
+    bool acquire_for(uint64_t timeout_ns)
+    {
+      return dispatch_semaphore_wait(
+               semaphore_,
+               dispatch_time(DISPATCH_TIME_NOW, (int64_t)timeout_ns)) == 0;
+    }
   };
 } // namespace verona::rt::pal
 #  elif defined(WIN32)
@@ -100,10 +213,20 @@ namespace verona::rt::pal
     {
       WaitForSingleObject(semaphore_, INFINITE);
     }
+
+    bool acquire_for(uint64_t timeout_ns)
+    {
+      // Rounded up to whole milliseconds, short of INFINITE.
+      DWORD ms = (DWORD)std::min<uint64_t>(
+        (timeout_ns + 999'999) / 1'000'000, INFINITE - 1);
+      return WaitForSingleObject(semaphore_, ms) == WAIT_OBJECT_0;
+    }
   };
 } // namespace verona::rt::pal
 #  elif __has_include(<semaphore.h>)
 // Use Posix semaphores
+#    include <cerrno>
+#    include <ctime>
 #    include <semaphore.h>
 namespace verona::rt::pal
 {
@@ -161,6 +284,28 @@ namespace verona::rt::pal
         }
       }
     }
+
+    bool acquire_for(uint64_t timeout_ns)
+    {
+      timespec ts;
+      clock_gettime(CLOCK_REALTIME, &ts);
+      uint64_t ns = (uint64_t)ts.tv_nsec + (timeout_ns % 1'000'000'000);
+      ts.tv_sec +=
+        (time_t)((timeout_ns / 1'000'000'000) + (ns / 1'000'000'000));
+      ts.tv_nsec = (long)(ns % 1'000'000'000);
+      while (true)
+      {
+        if (sem_timedwait(&semaphore_, &ts) == 0)
+          return true;
+        if (errno == EINTR)
+          continue;
+        if (errno == ETIMEDOUT)
+          return false;
+
+        // Failed to acquire semaphore.
+        abort();
+      }
+    }
   };
 } // namespace verona::rt::pal
 #  else
@@ -199,6 +344,25 @@ namespace verona::rt::pal
 #  endif
     }
 
+    /**
+     * As sleep(), but gives up after `timeout_ns` nanoseconds. Returns
+     * whether it was woken.
+     */
+    bool sleep_for(uint64_t timeout_ns)
+    {
+#  ifndef NDEBUG
+      assert(!sleeper);
+      sleeper = true;
+#  endif
+      bool woken = sem.acquire_for(timeout_ns);
+#  ifndef NDEBUG
+      if (woken)
+        waker = false;
+      sleeper = false;
+#  endif
+      return woken;
+    }
+
     /**
      * Used to wake a thread from sleep.
      *
@@ -4,7 +4,11 @@
 
 #include "threading.h"
 
+#include <condition_variable>
+#include <functional>
 #include <list>
+#include <mutex>
+#include <vector>
 
 /**
  * This constructs a platforms affinitised set of threads.
@@ -82,4 +86,97 @@ namespace verona::rt
       }
     }
   };
+
+  /**
+   * Affinitised threads that park between runs rather than exit, so that
+   * the next run starts without creating threads. Like ThreadPoolBuilder,
+   * the calling thread takes part in each run.
+   */
+  class ParkedThreads
+  {
+    std::list<PlatformThread> threads;
+    std::mutex m;
+    std::condition_variable cv;
+    std::function<void(size_t)> body;
+    /// Bumped to start each run.
+    size_t session = 0;
+    /// Parked threads still in the current run.
+    size_t busy = 0;
+    bool exiting = false;
+
+    static void park(ParkedThreads* p, size_t index, size_t affinity)
+    {
+      cpu::set_affinity(affinity);
+      size_t seen = 0;
+      std::unique_lock<std::mutex> lock(p->m);
+      while (true)
+      {
+        p->cv.wait(lock, [p, seen]() {
+          return p->exiting || (p->session != seen);
+        });
+        if (p->exiting)
+          return;
+
+        seen = p->session;
+        lock.unlock();
+        p->body(index);
+        lock.lock();
+        if (--p->busy == 0)
+          p->cv.notify_all();
+      }
+    }
+
+  public:
+    /// How many threads run, the calling thread included.
+    size_t size() const
+    {
+      return threads.size() + 1;
+    }
+
+    /**
+     * Run `f(i)` for each `i` below the size of `affinities`, the last on
+     * the calling thread, each on the CPU `affinities[i]`. The threads are
+     * started by the first run, and later runs must be the same size.
+     * Returns once every `f(i)` has.
+     */
+    void
+    run(const std::vector<size_t>& affinities, std::function<void(size_t)> f)
+    {
+      size_t count = affinities.size() - 1;
+      {
+        std::unique_lock<std::mutex> lock(m);
+        body = std::move(f);
+        busy = count;
+        session++;
+      }
+      cv.notify_all();
+
+      for (size_t i = threads.size(); i < count; i++)
+        threads.emplace_back(&park, this, i, affinities[i]);
+
+      cpu::set_affinity(affinities[count]);
+      body(count);
+
+      std::unique_lock<std::mutex> lock(m);
+      cv.wait(lock, [this]() { return busy == 0; });
+    }
+
+    /**
+     * Wakes the parked threads to exit, and waits for them.
+     */
+    ~ParkedThreads()
+    {
+      {
+        std::unique_lock<std::mutex> lock(m);
+        exiting = true;
+      }
+      cv.notify_all();
+
+      while (!threads.empty())
+      {
+        threads.front().join();
+        threads.pop_front();
+      }
+    }
+  };
 }
@@ -0,0 +1,99 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <snmalloc/snmalloc.h>
+
+namespace verona::rt
+{
+  /**
+   * Converts Aal::tick() readings, the TSC on x86, to nanoseconds, for
+   * timing short events at the cost of two tick reads rather than two
+   * clock calls.
+   *
+   * The tick rate is calibrated against the steady clock once, by the
+   * first call, which spins for CALIBRATION_NS. Timestamps from now_ns()
+   * are on the steady clock's scale as of that calibration. This assumes
+   * a tick rate that is constant and the same on every core, as the
+   * invariant TSC of current x86 CPUs is.
+   */
+  class TickClock
+  {
+  public:
+    /// Time the calibration spins for.
+    static constexpr uint64_t CALIBRATION_NS = 2'000'000;
+
+  private:
+    struct Calibration
+    {
+      uint64_t tick;
+      uint64_t ns;
+      double ns_per_tick;
+    };
+
+    static uint64_t steady_ns()
+    {
+      return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+    }
+
+    static Calibration calibrate()
+    {
+      uint64_t ns = steady_ns();
+      uint64_t tick = snmalloc::Aal::tick();
+      uint64_t ns2;
+      uint64_t tick2;
+      do
+      {
+        ns2 = steady_ns();
+        tick2 = snmalloc::Aal::tick();
+      } while (ns2 - ns < CALIBRATION_NS);
+
+      // A tick counter that does not move is no use; fall back to 1ns.
+      double ratio =
+        tick2 == tick ? 1.0 : (double)(ns2 - ns) / (double)(tick2 - tick);
+      return {tick, ns, ratio};
+    }
+
+    static const Calibration& calibration()
+    {
+      static const Calibration c = calibrate();
+      return c;
+    }
+
+  public:
+    static uint64_t ticks()
+    {
+      return snmalloc::Aal::tick();
+    }
+
+    /// Nanoseconds in `ticks` ticks.
+    static uint64_t to_ns(uint64_t ticks)
+    {
+      return (uint64_t)((double)ticks * calibration().ns_per_tick);
+    }
+
+    /// The steady clock time, in nanoseconds, at the tick reading `tick`.
+    static uint64_t timestamp_ns(uint64_t tick)
+    {
+      const Calibration& c = calibration();
+      if (tick >= c.tick)
+        return c.ns + to_ns(tick - c.tick);
+      uint64_t before = to_ns(c.tick - tick);
+      return c.ns > before ? c.ns - before : 0;
+    }
+
+    static uint64_t now_ns()
+    {
+      return timestamp_ns(ticks());
+    }
+
+    static double get_ns_per_tick()
+    {
+      return calibration().ns_per_tick;
+    }
+  };
+} // namespace verona::rt
@@ -0,0 +1,175 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+
+/**
+ * This file provides reserve / commit / decommit / release of virtual
+ * address ranges, for allocators that want to hold a large range but only
+ * pay for the pages they touch.
+ *
+ * A reserved range is inaccessible until committed. Decommitting returns
+ * the physical pages to the OS; the range stays reserved and can be
+ * committed again, with undefined contents. Ranges passed to commit and
+ * decommit must start and end on page boundaries, which offsets from a
+ * reserved base that are multiples of VM_GRANULE always do.
+ *
+ * It also provides mappings backed by huge pages, for allocators that hand
+ * out large blocks and want fewer TLB misses when walking them.
+ */
+#if defined(_WIN32)
+#  define WIN32_LEAN_AND_MEAN
+#  ifndef NOMINMAX
+#    define NOMINMAX
+#  endif
+#  include <windows.h>
+#else
+#  include <sys/mman.h>
+#endif
+
+namespace verona::rt::pal
+{
+  /// Granule of commit and decommit. A multiple of the page size on every
+  /// supported platform, including 64KB-page configurations.
+  static constexpr size_t VM_GRANULE = 64 * 1024;
+
+  /// Size and alignment of a huge page.
+  static constexpr size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+  /**
+   * How vm_alloc_huge backs a mapping.
+   *
+   *  - Transparent maps ordinary pages and asks the OS to use huge pages
+   *    for them where it can (Linux transparent huge pages).
+   *  - Explicit asks for pages from the reserved huge page pool (Linux
+   *    hugetlbfs, Windows large pages), and falls back to Transparent when
+   *    the pool is empty or the process may not use it.
+   **/
+  enum class HugePages
+  {
+    None,
+    Transparent,
+    Explicit,
+  };
+
+#if defined(_WIN32)
+  inline void* vm_reserve(size_t size)
+  {
+    return VirtualAlloc(nullptr, size, MEM_RESERVE, PAGE_NOACCESS);
+  }
+
+  inline void vm_commit(void* p, size_t size)
+  {
+    if (VirtualAlloc(p, size, MEM_COMMIT, PAGE_READWRITE) == nullptr)
+      abort();
+  }
+
+  inline void vm_decommit(void* p, size_t size)
+  {
+    VirtualFree(p, size, MEM_DECOMMIT);
+  }
+
+  inline void vm_release(void* p, size_t)
+  {
+    VirtualFree(p, 0, MEM_RELEASE);
+  }
+
+  /**
+   * Map `size` bytes of committed memory, a multiple of HUGE_PAGE_SIZE,
+   * backed as `mode` asks. Released with vm_release.
+   **/
+  inline void* vm_alloc_huge(size_t size, HugePages mode)
+  {
+    void* p = nullptr;
+    if (mode == HugePages::Explicit)
+      p = VirtualAlloc(
+        nullptr,
+        size,
+        MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES,
+        PAGE_READWRITE);
+    if (p == nullptr)
+      p = VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    if (p == nullptr)
+      abort();
+    return p;
+  }
+#else
+  inline void* vm_reserve(size_t size)
+  {
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#  ifdef MAP_NORESERVE
+    flags |= MAP_NORESERVE;
+#  endif
+    void* p = mmap(nullptr, size, PROT_NONE, flags, -1, 0);
+    return p == MAP_FAILED ? nullptr : p;
+  }
+
+  inline void vm_commit(void* p, size_t size)
+  {
+    if (mprotect(p, size, PROT_READ | PROT_WRITE) != 0)
+      abort();
+  }
+
+  inline void vm_decommit(void* p, size_t size)
+  {
+    // MADV_DONTNEED drops the pages at once on Linux, so resident memory
+    // falls straight away; elsewhere MADV_FREE lets the OS reclaim them.
+#  if defined(__linux__) || !defined(MADV_FREE)
+    madvise(p, size, MADV_DONTNEED);
+#  else
+    madvise(p, size, MADV_FREE);
+#  endif
+    mprotect(p, size, PROT_NONE);
+  }
+
+  inline void vm_release(void* p, size_t size)
+  {
+    munmap(p, size);
+  }
+
+  /**
+   * Map `size` bytes of committed memory, a multiple of HUGE_PAGE_SIZE,
+   * backed as `mode` asks. Released with vm_release.
+   *
+   * The mapping is aligned to HUGE_PAGE_SIZE, as the OS only backs aligned
+   * ranges with huge pages.
+   **/
+  inline void* vm_alloc_huge(size_t size, HugePages mode)
+  {
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#  ifdef MAP_HUGETLB
+    if (mode == HugePages::Explicit)
+    {
+      void* p =
+        mmap(nullptr, size, PROT_READ | PROT_WRITE, flags | MAP_HUGETLB, -1, 0);
+      if (p != MAP_FAILED)
+        return p;
+    }
+#  endif
+
+    // Over-map by a huge page, and trim both ends to an aligned range.
+    size_t reserve = size + HUGE_PAGE_SIZE;
+    void* r = mmap(nullptr, reserve, PROT_READ | PROT_WRITE, flags, -1, 0);
+    if (r == MAP_FAILED)
+      abort();
+
+    auto base = reinterpret_cast<uintptr_t>(r);
+    auto start = (base + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+    if (start != base)
+      munmap(r, start - base);
+    if (start + size != base + reserve)
+      munmap(
+        reinterpret_cast<void*>(start + size), base + reserve - start - size);
+
+    void* p = reinterpret_cast<void*>(start);
+#  ifdef MADV_HUGEPAGE
+    if (mode != HugePages::None)
+      madvise(p, size, MADV_HUGEPAGE);
+#  endif
+    return p;
+  }
+#endif
+} // namespace verona::rt::pal
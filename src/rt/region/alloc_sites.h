@@ -0,0 +1,203 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "../object/object.h"
+#include "heap_profile.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <iomanip>
+#include <ostream>
+#include <vector>
+
+namespace verona::rt
+{
+  /**
+   * Survival of the objects of each allocation site of a copying region,
+   * and the sites whose objects it pretenures: allocates where collections
+   * do not copy them (see set_pretenure_after()).
+   *
+   * A site is the descriptor of the objects allocated there. A collection
+   * that finds alive at least SURVIVAL percent of the objects a site had
+   * alive after the previous one, plus those it has allocated since, is
+   * one the site survived. A site that survives `pretenure_after`
+   * collections in a row is pretenured, until it fails to survive one.
+   *
+   * A region keeps a table of its own, made on its first allocation while
+   * pretenuring is on, and counts in it without synchronisation, as only
+   * the thread that has the region open allocates in it or collects it.
+   * Sites past MAX_SITES are neither counted nor pretenured.
+   *
+   * SemiSpace regions pretenure into their large object space, which a
+   * region_ptr cannot refer to, so they abort when one is stored that
+   * refers to a pretenured object. Generational regions pretenure into
+   * their old generation.
+   */
+  class AllocSites
+  {
+  public:
+    /// Sites a region tells apart.
+    static constexpr size_t MAX_SITES = 64;
+
+    /// Share of its objects, in percent, a site keeps alive over a
+    /// collection to count as surviving it.
+    static constexpr size_t SURVIVAL = 90;
+
+    struct Row
+    {
+      const Descriptor* desc = nullptr;
+      /// Objects allocated, and found alive summed over the collections.
+      uint64_t allocated = 0;
+      uint64_t survived = 0;
+      /// Objects the last collection found alive, and the share of the
+      /// site's objects that was, in percent.
+      size_t live = 0;
+      size_t survival = 0;
+      /// Collections survived in a row.
+      size_t streak = 0;
+      bool pretenured = false;
+    };
+
+  private:
+    struct Site
+    {
+      Row row;
+      /// Allocated since the last collection.
+      size_t since = 0;
+      /// Found alive by the collection in progress.
+      size_t found = 0;
+    };
+
+    /// Open addressing from a descriptor to its site.
+    static constexpr size_t SLOTS = 2 * MAX_SITES;
+    Site slots[SLOTS];
+    size_t count = 0;
+
+    static inline std::atomic<size_t> pretenure_after_{0};
+
+    Site* find(const Descriptor* desc, bool add)
+    {
+      size_t i = (((uintptr_t)desc >> 3) * 0x9E3779B97F4A7C15ull) % SLOTS;
+      for (size_t probes = 0; probes < SLOTS; probes++)
+      {
+        Site& s = slots[i];
+        if (s.row.desc == desc)
+          return &s;
+        if (s.row.desc == nullptr)
+        {
+          if (!add || count == MAX_SITES)
+            return nullptr;
+          count++;
+          s.row.desc = desc;
+          return &s;
+        }
+        i = (i + 1) % SLOTS;
+      }
+      return nullptr;
+    }
+
+  public:
+    /**
+     * Pretenure the objects of a site once it has survived `n` collections
+     * in a row. 0, the default, turns pretenuring and the tables it keeps
+     * off.
+     **/
+    static void set_pretenure_after(size_t n)
+    {
+      pretenure_after_.store(n, std::memory_order_relaxed);
+    }
+
+    static size_t get_pretenure_after()
+    {
+      return pretenure_after_.load(std::memory_order_relaxed);
+    }
+
+    static bool is_enabled()
+    {
+      return get_pretenure_after() != 0;
+    }
+
+    /// Count an allocation of `desc`. Returns whether it is pretenured.
+    bool allocated(const Descriptor* desc)
+    {
+      Site* s = find(desc, true);
+      if (s == nullptr)
+        return false;
+      s->row.allocated++;
+      s->since++;
+      return s->row.pretenured;
+    }
+
+    /// Count `o` as found alive by the collection in progress.
+    void found(const Object* o)
+    {
+      Site* s = find(o->get_descriptor(), false);
+      if (s != nullptr)
+        s->found++;
+    }
+
+    /// End the collection in progress, and decide which sites to pretenure.
+    void collected()
+    {
+      size_t after = get_pretenure_after();
+      for (Site& s : slots)
+      {
+        if (s.row.desc == nullptr)
+          continue;
+
+        // A site with nothing to lose tells nothing.
+        size_t candidates = s.row.live + s.since;
+        if (candidates != 0)
+        {
+          // Objects from before the table was made may be found too.
+          s.row.survival = std::min<size_t>(s.found * 100 / candidates, 100);
+          s.row.streak = (s.row.survival >= SURVIVAL) ? s.row.streak + 1 : 0;
+        }
+        s.row.survived += s.found;
+        s.row.live = s.found;
+        s.row.pretenured = (after != 0) && (s.row.streak >= after);
+        s.since = 0;
+        s.found = 0;
+      }
+    }
+
+    /// Every site, most objects allocated first.
+    std::vector<Row> rows() const
+    {
+      std::vector<Row> rows;
+      for (const Site& s : slots)
+      {
+        if (s.row.desc != nullptr)
+          rows.push_back(s.row);
+      }
+      std::sort(rows.begin(), rows.end(), [](const Row& a, const Row& b) {
+        return a.allocated > b.allocated;
+      });
+      return rows;
+    }
+
+    /**
+     * Print every site: the objects it allocated, how many the last
+     * collection found alive and their share of the site's objects, the
+     * collections it survived in a row, and whether it is pretenured.
+     */
+    void dump(std::ostream& out) const
+    {
+      out << "Allocation sites (" << count << ")\n"
+          << std::setw(14) << "allocated" << std::setw(12) << "live"
+          << std::setw(10) << "survival" << std::setw(8) << "streak"
+          << std::setw(12) << "pretenured"
+          << "  type\n";
+      for (const Row& r : rows())
+      {
+        out << std::setw(14) << r.allocated << std::setw(12) << r.live
+            << std::setw(9) << r.survival << "%" << std::setw(8) << r.streak
+            << std::setw(12) << (r.pretenured ? "yes" : "no") << "  "
+            << HeapProfile::type_name(r.desc) << "\n";
+      }
+    }
+  };
+} // namespace verona::rt
@@ -0,0 +1,193 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "../util/live_metrics.h"
+#include "region_base.h"
+
+#include <atomic>
+#include <snmalloc/snmalloc.h>
+
+namespace verona::rt
+{
+  /**
+   * Allocation counters for each region type, for the benchmark harness.
+   *
+   * Only counted when ENABLE_BENCHMARKING is defined; otherwise every
+   * method is empty and get() returns zeros. Each thread counts into a
+   * block of its own, written only by that thread, and get() sums the
+   * blocks of every thread. One allocation in SAMPLE_PERIOD is timed, in
+   * Aal::tick() cycles, into a histogram with a bucket per power of two.
+   */
+  class AllocStats
+  {
+  public:
+    static constexpr size_t TYPES = 7;
+    static constexpr size_t SAMPLE_PERIOD = 64;
+    static constexpr size_t LATENCY_BUCKETS = 64;
+
+    struct Counters
+    {
+      /// Bytes and objects allocated.
+      uint64_t bytes = 0;
+      uint64_t objects = 0;
+      /// Allocations that needed a new arena or a semispace grow().
+      uint64_t slow_paths = 0;
+      /// Sampled latencies: bucket `b` counts those in [2^(b-1), 2^b).
+      uint64_t latency[LATENCY_BUCKETS] = {};
+
+      /// Upper bound, in cycles, of the sampled latency at `percentile`.
+      uint64_t latency_percentile(double percentile) const
+      {
+        uint64_t total = 0;
+        for (auto c : latency)
+          total += c;
+        if (total == 0)
+          return 0;
+
+        uint64_t rank = (uint64_t)((percentile / 100.0) * (double)total);
+        uint64_t seen = 0;
+        for (size_t b = 0; b < LATENCY_BUCKETS; b++)
+        {
+          seen += latency[b];
+          if (seen > rank)
+            return b == 0 ? 0 : (uint64_t(1) << b) - 1;
+        }
+        return ~uint64_t(0);
+      }
+    };
+
+  private:
+    struct Local : public snmalloc::Pooled<Local>
+    {
+      struct Atomics
+      {
+        std::atomic<uint64_t> bytes{0};
+        std::atomic<uint64_t> objects{0};
+        std::atomic<uint64_t> slow_paths{0};
+        std::atomic<uint64_t> latency[LATENCY_BUCKETS] = {};
+      };
+
+      Atomics counters[TYPES];
+      size_t countdown = SAMPLE_PERIOD;
+    };
+
+    using LocalPool = snmalloc::Pool<Local>;
+
+    /// Only the owning thread writes, so a load and a store suffice.
+    static void bump(std::atomic<uint64_t>& c, uint64_t n = 1)
+    {
+      c.store(c.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    static Local& local()
+    {
+      struct Handle
+      {
+        Local* l = LocalPool::acquire();
+
+        ~Handle()
+        {
+          LocalPool::release(l);
+        }
+      };
+      static thread_local Handle h;
+      return *h.l;
+    }
+
+  public:
+    /**
+     * Counts one allocation of `bytes` in a region of type `type`, and
+     * times it from construction to destruction if it is sampled. The
+     * bytes are counted in LiveMetrics too, whether benchmarking or not.
+     */
+    class Sample
+    {
+#ifdef ENABLE_BENCHMARKING
+      Local::Atomics* counters;
+      uint64_t start = 0;
+#endif
+
+    public:
+      Sample(RegionType type, size_t bytes)
+      {
+        LiveMetrics::allocated((size_t)type, bytes);
+#ifdef ENABLE_BENCHMARKING
+        Local& l = local();
+        counters = &l.counters[(size_t)type];
+        bump(counters->bytes, bytes);
+        bump(counters->objects);
+        if (--l.countdown == 0)
+        {
+          l.countdown = SAMPLE_PERIOD;
+          start = snmalloc::Aal::tick();
+        }
+#else
+        UNUSED(type);
+        UNUSED(bytes);
+#endif
+      }
+
+      ~Sample()
+      {
+#ifdef ENABLE_BENCHMARKING
+        if (start == 0)
+          return;
+        uint64_t cycles = snmalloc::Aal::tick() - start;
+        size_t b = cycles == 0 ? 0 : 64 - snmalloc::bits::clz(cycles);
+        bump(counters->latency[std::min(b, LATENCY_BUCKETS - 1)]);
+#endif
+      }
+
+      Sample(const Sample&) = delete;
+      Sample& operator=(const Sample&) = delete;
+    };
+
+    /// Count an allocation in a region of type `type` that took a slow path.
+    static void slow_path(RegionType type)
+    {
+#ifdef ENABLE_BENCHMARKING
+      bump(local().counters[(size_t)type].slow_paths);
+#else
+      UNUSED(type);
+#endif
+    }
+
+    /// The counters of every thread for `type`, since the last reset().
+    static Counters get(RegionType type)
+    {
+      Counters c;
+      for (auto* l = LocalPool::iterate(); l != nullptr;
+           l = LocalPool::iterate(l))
+      {
+        auto& a = l->counters[(size_t)type];
+        c.bytes += a.bytes.load(std::memory_order_relaxed);
+        c.objects += a.objects.load(std::memory_order_relaxed);
+        c.slow_paths += a.slow_paths.load(std::memory_order_relaxed);
+        for (size_t b = 0; b < LATENCY_BUCKETS; b++)
+          c.latency[b] += a.latency[b].load(std::memory_order_relaxed);
+      }
+      return c;
+    }
+
+    /**
+     * Zero the counters of every thread. Counts made by other threads while
+     * this runs may be lost, so only call it while they are not allocating.
+     */
+    static void reset()
+    {
+      for (auto* l = LocalPool::iterate(); l != nullptr;
+           l = LocalPool::iterate(l))
+      {
+        for (auto& a : l->counters)
+        {
+          a.bytes.store(0, std::memory_order_relaxed);
+          a.objects.store(0, std::memory_order_relaxed);
+          a.slow_paths.store(0, std::memory_order_relaxed);
+          for (auto& b : a.latency)
+            b.store(0, std::memory_order_relaxed);
+        }
+      }
+    }
+  };
+} // namespace verona::rt
@@ -0,0 +1,405 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "../object/object.h"
+#include "region_base.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <initializer_list>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace verona::rt
+{
+  /**
+   * Records the region operations of a program to a file, so that the same
+   * sequence can be replayed against any region type, whatever the random
+   * streams and the collector of the recorded run did (see
+   * test/benchmarks/replay).
+   *
+   * A trace holds the creation of regions and of objects with their sizes,
+   * and collections, releases, merges and freezes, in the order they
+   * happened across all threads. Programs write fields directly rather
+   * than through the runtime, so writes are recovered instead: just before
+   * each collection, merge or freeze, the region is walked from its entry
+   * point with each object's trace function, and every reference that
+   * changed since the last walk is recorded as a write of the word it is
+   * stored in. A replay of the writes gives each collection the same live
+   * graph as the recorded one. References that trace functions do not
+   * push, and references out of the region, are not recorded.
+   *
+   * Each region and object is given the next id, from 1, in the order of
+   * its Region or Alloc. An id of 0 stands for nullptr. Objects are known
+   * by their address between walks, so only regions that do not move
+   * objects can be recorded: trace, arena and rc. Regions created before
+   * start() are ignored.
+   */
+  class AllocTrace
+  {
+  public:
+    /**
+     * The operations of a trace, each a byte followed by its operands as
+     * LEB128 varints.
+     */
+    enum class Op : uint8_t
+    {
+      /// A new region: its RegionType and the size of its entry point.
+      Region = 1,
+      /// A new object: its region and its size.
+      Alloc,
+      /// An object, the word offset of a field in it, and the object the
+      /// field now refers to, or 0.
+      Write,
+      /// A collection of a region.
+      Collect,
+      /// A release of a region.
+      Release,
+      /// The second region was merged into the first.
+      Merge,
+      /// A freeze of a region.
+      Freeze,
+      /// The end of the trace.
+      End,
+    };
+
+    /// The first bytes of a trace file, with the version of the format.
+    static constexpr char MAGIC[8] = {'V', 'R', 'T', 'R', 'A', 'C', 'E', '1'};
+
+    static void put_varint(std::vector<uint8_t>& out, uint64_t v)
+    {
+      while (v >= 0x80)
+      {
+        out.push_back((uint8_t)(v | 0x80));
+        v >>= 7;
+      }
+      out.push_back((uint8_t)v);
+    }
+
+    /**
+     * Read the varint at `pos` of `data`, advancing `pos` past it. Returns
+     * false if it runs past `size`.
+     */
+    static bool
+    get_varint(const uint8_t* data, size_t size, size_t& pos, uint64_t& v)
+    {
+      v = 0;
+      for (unsigned shift = 0; pos < size && shift < 64; shift += 7)
+      {
+        uint8_t b = data[pos++];
+        v |= (uint64_t)(b & 0x7f) << shift;
+        if ((b & 0x80) == 0)
+          return true;
+      }
+      return false;
+    }
+
+  private:
+    /// Bytes of the trace buffered before they are written out.
+    static constexpr size_t BUFFER = 1 << 16;
+
+    struct Entry
+    {
+      uint64_t id;
+      uint64_t region;
+    };
+
+    using Refs = std::vector<std::pair<uint32_t, uint64_t>>;
+
+    static inline std::atomic<bool> enabled_{false};
+
+    std::mutex m;
+    std::FILE* file = nullptr;
+    std::vector<uint8_t> buffer;
+    uint64_t next_id = 1;
+    std::unordered_map<const Object*, Entry> objects;
+    /// The objects of each region as of its last walk, and those created
+    /// since, by the id of the region.
+    std::unordered_map<uint64_t, std::vector<const Object*>> members;
+    /// The references of each object at the last walk, by word offset.
+    std::unordered_map<uint64_t, Refs> refs;
+
+    static AllocTrace& get()
+    {
+      static AllocTrace trace;
+      return trace;
+    }
+
+    void op(Op o, std::initializer_list<uint64_t> operands)
+    {
+      buffer.push_back((uint8_t)o);
+      for (uint64_t v : operands)
+        put_varint(buffer, v);
+      if (buffer.size() >= BUFFER)
+        flush();
+    }
+
+    void flush()
+    {
+      std::fwrite(buffer.data(), 1, buffer.size(), file);
+      buffer.clear();
+    }
+
+    /// The id of the region whose entry point is `entry`, or 0 if it is not
+    /// recorded.
+    uint64_t region_of(const Object* entry)
+    {
+      auto it = objects.find(entry);
+      if (it == objects.end() || it->second.id != it->second.region)
+        return 0;
+      return it->second.region;
+    }
+
+    /**
+     * Record the writes that make the references of the region `region`,
+     * whose entry point is `entry`, what they are now, and forget the
+     * objects that are no longer reachable.
+     */
+    void walk(uint64_t region, const Object* entry)
+    {
+      std::vector<const Object*> live;
+      std::unordered_set<const Object*> seen{entry};
+      std::vector<const Object*> work{entry};
+      std::vector<Object*> pushed;
+      ObjectStack children;
+
+      while (!work.empty())
+      {
+        const Object* o = work.back();
+        work.pop_back();
+        live.push_back(o);
+
+        const Descriptor* d = o->get_descriptor();
+        d->trace(o, children);
+        pushed.clear();
+        while (!children.empty())
+        {
+          Object* c = children.pop();
+          auto it = objects.find(c);
+          if (it != objects.end() && it->second.region == region)
+            pushed.push_back(c);
+        }
+
+        // Find the word each pushed reference is stored in.
+        Refs now;
+        auto words = (Object* const*)o;
+        size_t n = (const_cast<Object*>(o)->size() - sizeof(Object::Header)) /
+          sizeof(Object*);
+        for (size_t w = 0; w < n && !pushed.empty(); w++)
+        {
+          auto p = std::find(pushed.begin(), pushed.end(), words[w]);
+          if (p == pushed.end())
+            continue;
+          *p = pushed.back();
+          pushed.pop_back();
+          now.emplace_back((uint32_t)w, objects[words[w]].id);
+          if (seen.insert(words[w]).second)
+            work.push_back(words[w]);
+        }
+
+        uint64_t id = objects[o].id;
+        Refs& before = refs[id];
+        size_t i = 0;
+        size_t j = 0;
+        while (i < before.size() || j < now.size())
+        {
+          if (
+            j == now.size() ||
+            (i < before.size() && before[i].first < now[j].first))
+          {
+            op(Op::Write, {id, before[i++].first, 0});
+          }
+          else if (i == before.size() || now[j].first < before[i].first)
+          {
+            op(Op::Write, {id, now[j].first, now[j].second});
+            j++;
+          }
+          else
+          {
+            if (before[i].second != now[j].second)
+              op(Op::Write, {id, now[j].first, now[j].second});
+            i++;
+            j++;
+          }
+        }
+        before = std::move(now);
+      }
+
+      for (const Object* o : members[region])
+      {
+        if (seen.count(o) != 0)
+          continue;
+        auto it = objects.find(o);
+        if (it != objects.end() && it->second.region == region)
+        {
+          refs.erase(it->second.id);
+          objects.erase(it);
+        }
+      }
+      members[region] = std::move(live);
+    }
+
+    /// Forget every object of the region `region`.
+    void drop(uint64_t region)
+    {
+      for (const Object* o : members[region])
+      {
+        auto it = objects.find(o);
+        if (it != objects.end() && it->second.region == region)
+        {
+          refs.erase(it->second.id);
+          objects.erase(it);
+        }
+      }
+      members.erase(region);
+    }
+
+  public:
+    static bool is_enabled()
+    {
+      return enabled_.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Start recording to the file at `path`, replacing it. Returns false
+     * if it cannot be opened.
+     */
+    static bool start(const char* path)
+    {
+      AllocTrace& t = get();
+      std::lock_guard<std::mutex> lock(t.m);
+      t.file = std::fopen(path, "wb");
+      if (t.file == nullptr)
+        return false;
+      std::fwrite(MAGIC, 1, sizeof(MAGIC), t.file);
+      t.next_id = 1;
+      enabled_.store(true, std::memory_order_relaxed);
+      return true;
+    }
+
+    /// Stop recording, and finish the file.
+    static void stop()
+    {
+      AllocTrace& t = get();
+      std::lock_guard<std::mutex> lock(t.m);
+      if (t.file == nullptr)
+        return;
+      enabled_.store(false, std::memory_order_relaxed);
+      t.op(Op::End, {});
+      t.flush();
+      std::fclose(t.file);
+      t.file = nullptr;
+      t.objects.clear();
+      t.members.clear();
+      t.refs.clear();
+    }
+
+    static void on_region(const Object* entry, RegionType type)
+    {
+      if (!is_enabled())
+        return;
+
+      // Objects that move cannot be told apart by their address.
+      if (
+        type == RegionType::SemiSpace || type == RegionType::Generational ||
+        type == RegionType::Compact)
+        abort();
+
+      AllocTrace& t = get();
+      std::lock_guard<std::mutex> lock(t.m);
+      t.op(Op::Region, {(uint64_t)type, entry->get_descriptor()->size});
+      uint64_t id = t.next_id++;
+      t.objects[entry] = {id, id};
+      t.members[id].push_back(entry);
+    }
+
+    static void on_alloc(const Object* entry, const Object* o)
+    {
+      if (!is_enabled())
+        return;
+
+      AllocTrace& t = get();
+      std::lock_guard<std::mutex> lock(t.m);
+      uint64_t region = t.region_of(entry);
+      if (region == 0)
+        return;
+      t.op(Op::Alloc, {region, const_cast<Object*>(o)->size()});
+      t.objects[o] = {t.next_id++, region};
+      t.members[region].push_back(o);
+    }
+
+    static void on_collect(const Object* entry)
+    {
+      if (!is_enabled())
+        return;
+
+      AllocTrace& t = get();
+      std::lock_guard<std::mutex> lock(t.m);
+      uint64_t region = t.region_of(entry);
+      if (region == 0)
+        return;
+      t.walk(region, entry);
+      t.op(Op::Collect, {region});
+    }
+
+    static void on_release(const Object* entry)
+    {
+      if (!is_enabled())
+        return;
+
+      AllocTrace& t = get();
+      std::lock_guard<std::mutex> lock(t.m);
+      uint64_t region = t.region_of(entry);
+      if (region == 0)
+        return;
+      t.op(Op::Release, {region});
+      t.drop(region);
+    }
+
+    static void on_merge(const Object* into, const Object* from)
+    {
+      if (!is_enabled())
+        return;
+
+      AllocTrace& t = get();
+      std::lock_guard<std::mutex> lock(t.m);
+      uint64_t to = t.region_of(into);
+      uint64_t merged = t.region_of(from);
+      if (to == 0 || merged == 0)
+        return;
+      t.walk(to, into);
+      t.walk(merged, from);
+      t.op(Op::Merge, {to, merged});
+
+      auto& dest = t.members[to];
+      for (const Object* o : t.members[merged])
+      {
+        t.objects[o].region = to;
+        dest.push_back(o);
+      }
+      t.members.erase(merged);
+    }
+
+    static void on_freeze(const Object* entry)
+    {
+      if (!is_enabled())
+        return;
+
+      AllocTrace& t = get();
+      std::lock_guard<std::mutex> lock(t.m);
+      uint64_t region = t.region_of(entry);
+      if (region == 0)
+        return;
+      t.walk(region, entry);
+      t.op(Op::Freeze, {region});
+      t.drop(region);
+    }
+  };
+} // namespace verona::rt
@@ -0,0 +1,153 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "../pal/threading.h"
+#include "region_base.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <optional>
+
+namespace verona::rt
+{
+  /**
+   * A thread that finishes the collections of closed regions of type `R`.
+   *
+   * A region is handed over with submit() when it is closed with a
+   * collection in progress, and the thread works on it until the
+   * collection is over, or until the region is wanted back. Whoever wants
+   * to use the region again calls withdraw() first: a region still waiting
+   * is simply taken off the queue, and one being worked on is asked to
+   * stop, which `R` must check for at least every slice of work. Either
+   * way, withdraw() returns once the thread is done with the region, and
+   * the mutex orders everything the thread did before what the caller
+   * does next.
+   *
+   * `R` provides:
+   *  - `std::atomic<bool> in_background`, set from submit() until the
+   *    thread or withdraw() is done with the region;
+   *  - `std::atomic<bool> background_stop`, set to ask the thread to stop;
+   *  - `void collect_in_background()`, which does the work.
+   *
+   * While the thread works on a region, its RegionBase::state is
+   * Collecting.
+   *
+   * The thread is started by the first submit(), and joined when the
+   * program exits. Regions still queued then are left as they are.
+   **/
+  template<class R>
+  class BackgroundCollector
+  {
+    std::mutex m;
+    std::condition_variable work_cv;
+    std::condition_variable done_cv;
+    std::deque<R*> queue;
+    R* current = nullptr;
+    bool stopping = false;
+    std::optional<PlatformThread> worker;
+
+    static BackgroundCollector& get()
+    {
+      static BackgroundCollector collector;
+      return collector;
+    }
+
+    ~BackgroundCollector()
+    {
+      {
+        std::lock_guard<std::mutex> l(m);
+        stopping = true;
+      }
+      work_cv.notify_all();
+      if (worker.has_value())
+        worker->join();
+    }
+
+    void run()
+    {
+      std::unique_lock<std::mutex> l(m);
+      while (true)
+      {
+        work_cv.wait(l, [this]() { return stopping || !queue.empty(); });
+        if (stopping)
+          return;
+
+        R* r = queue.front();
+        queue.pop_front();
+        current = r;
+        r->state.store(RegionBase::Collecting, std::memory_order_relaxed);
+        l.unlock();
+
+        r->collect_in_background();
+
+        l.lock();
+        r->state.store(RegionBase::Closed, std::memory_order_relaxed);
+        r->in_background.store(false, std::memory_order_release);
+        current = nullptr;
+        done_cv.notify_all();
+      }
+    }
+
+  public:
+    /**
+     * Queue the closed region `r` for the thread to work on.
+     **/
+    static void submit(R* r)
+    {
+      auto& c = get();
+      {
+        std::lock_guard<std::mutex> l(c.m);
+        assert(!r->in_background.load(std::memory_order_relaxed));
+        if (!c.worker.has_value())
+          c.worker.emplace([&c]() { c.run(); });
+        r->in_background.store(true, std::memory_order_relaxed);
+        c.queue.push_back(r);
+      }
+      c.work_cv.notify_one();
+    }
+
+    /**
+     * Take the region `r` back from the thread, waiting for it to stop if
+     * it is working on `r`. A single load if `r` was never handed over.
+     **/
+    static void withdraw(R* r)
+    {
+      if (!r->in_background.load(std::memory_order_acquire))
+        return;
+
+      auto& c = get();
+      std::unique_lock<std::mutex> l(c.m);
+      auto it = std::find(c.queue.begin(), c.queue.end(), r);
+      if (it != c.queue.end())
+      {
+        c.queue.erase(it);
+        r->in_background.store(false, std::memory_order_relaxed);
+        c.done_cv.notify_all();
+        return;
+      }
+
+      r->background_stop.store(true, std::memory_order_relaxed);
+      c.done_cv.wait(l, [r]() {
+        return !r->in_background.load(std::memory_order_relaxed);
+      });
+      r->background_stop.store(false, std::memory_order_relaxed);
+    }
+
+    /**
+     * Wait until the thread has nothing left to do.
+     *
+     * For testing and benchmarking purposes.
+     **/
+    static void drain()
+    {
+      auto& c = get();
+      std::unique_lock<std::mutex> l(c.m);
+      c.done_cv.wait(
+        l, [&c]() { return c.queue.empty() && (c.current == nullptr); });
+    }
+  };
+} // namespace verona::rt
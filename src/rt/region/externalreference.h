@@ -6,7 +6,9 @@
 #include "ds/hashmap.h"
 #include "immutable.h"
 
+#include <atomic>
 #include <snmalloc/snmalloc.h>
+#include <utility>
 
 namespace verona::rt
 {
@@ -16,6 +18,23 @@ namespace verona::rt
 
   class ExternalReferenceTable
   {
+    /**
+     * The identity of a table as its external references see it. A
+     * reference points at an owner cell rather than at its table, so that
+     * merging a region hands the references of the absorbed table to the
+     * surviving one by re-pointing the absorbed table's few owner cells,
+     * not every reference.
+     *
+     * A table allocates its first cell when it creates its first
+     * reference, and frees its cells when it is deallocated, by which time
+     * every reference has been invalidated and no longer points at them.
+     **/
+    struct Owner
+    {
+      std::atomic<ExternalReferenceTable*> table;
+      Owner* next;
+    };
+
   public:
     /**
      * An external reference is a pointer to a ExternalRef object. There is at
@@ -28,8 +47,9 @@ namespace verona::rt
       friend class ExternalReferenceTable;
 
     private:
-      // The `ExternalReferenceTable` of the region where `o` lives
-      std::atomic<ExternalReferenceTable*> ert;
+      // The owner cell of the table of the region where `o` lives, or
+      // nullptr once `o` has been collected.
+      std::atomic<Owner*> owner;
       // The object externally referred to
       Object* o;
 
@@ -47,19 +67,20 @@ namespace verona::rt
       static ExternalRef*
       find_ext_ref(ExternalReferenceTable* ert, const Object* o)
       {
+        assert(ert->external_map != nullptr);
         auto i = ert->external_map->find(o);
         assert(i != ert->external_map->end());
         assert(i.value());
         return i.value();
       }
 
-      ExternalRef(ExternalReferenceTable* ert_, Object* o_)
-      : Object(), ert{ert_}, o{o_}
+      ExternalRef(ExternalReferenceTable* ert, Object* o_)
+      : Object(), owner{ert->get_owner()}, o{o_}
       {
         make_scc();
 
         incref();
-        ert.load(std::memory_order_relaxed)->insert(o, this);
+        ert->insert(o, this);
 
         o->set_has_ext_ref();
       }
@@ -97,9 +118,11 @@ namespace verona::rt
       /**
        * Check if this external reference still points to an object in `region`.
        */
-      bool is_in(ExternalReferenceTable* ert_)
+      bool is_in(ExternalReferenceTable* ert)
       {
-        return ert.load(std::memory_order_relaxed) == ert_;
+        Owner* w = owner.load(std::memory_order_relaxed);
+        return (w != nullptr) &&
+          (w->table.load(std::memory_order_relaxed) == ert);
       }
     };
 
@@ -108,60 +131,213 @@ namespace verona::rt
     // entry in the map (if any) is removed as well.
     using ExternalMap = ObjectMap<std::pair<Object*, ExternalRef*>>;
 
-    ExternalMap* external_map;
+    /// Allocated on the first insert, as most regions never hand out an
+    /// external reference.
+    ExternalMap* external_map = nullptr;
+
+    ExternalMap* get_external_map()
+    {
+      if (SNMALLOC_UNLIKELY(external_map == nullptr))
+        external_map = ExternalMap::create();
+      return external_map;
+    }
+
+    /// Owner cells of this table and of every table merged into it.
+    Owner* owners = nullptr;
+
+    Owner* get_owner()
+    {
+      if (owners == nullptr)
+      {
+        owners = new (heap::alloc<sizeof(Owner)>()) Owner;
+        owners->table.store(this, std::memory_order_relaxed);
+        owners->next = nullptr;
+      }
+      return owners;
+    }
 
   public:
-    ExternalReferenceTable() : external_map(ExternalMap::create()) {}
+    ExternalReferenceTable() = default;
 
     void dealloc()
     {
-      for (auto it = external_map->begin(); it != external_map->end(); ++it)
-        remove_ref(it);
+      if (external_map != nullptr)
+      {
+        for (auto it = external_map->begin(); it != external_map->end(); ++it)
+          remove_ref(it);
 
-      external_map->dealloc();
-      heap::dealloc<sizeof(ExternalMap)>(external_map);
+        external_map->dealloc();
+        heap::dealloc<sizeof(ExternalMap)>(external_map);
+        external_map = nullptr;
+      }
+
+      while (owners != nullptr)
+      {
+        Owner* next = owners->next;
+        heap::dealloc<sizeof(Owner)>(owners);
+        owners = next;
+      }
     }
 
+    /**
+     * Take over the external references of `that`, whose region is being
+     * merged into this one. The references keep their owner cells, which
+     * are re-pointed at this table and spliced onto its list, and the
+     * smaller of the two maps is inserted into the larger.
+     **/
     void merge(ExternalReferenceTable* that)
     {
+      if (that->owners == nullptr)
+        return;
+
+      Owner* last = nullptr;
+      for (Owner* w = that->owners; w != nullptr; w = w->next)
+      {
+        w->table.store(this, std::memory_order_relaxed);
+        last = w;
+      }
+      last->next = owners;
+      owners = that->owners;
+      that->owners = nullptr;
+
+      if (that->is_empty())
+        return;
+
+      if (size() < that->external_map->size())
+        std::swap(external_map, that->external_map);
+      if (that->external_map == nullptr)
+        return;
+
       for (auto e : *that->external_map)
       {
         auto* ext_ref = *e.second;
         assert(ext_ref->o);
-        ext_ref->ert.store(this, std::memory_order_relaxed);
         *e.second = nullptr;
         insert(e.first, ext_ref);
       }
     }
 
+    /**
+     * Whether no object of the region has an external reference.
+     **/
+    bool is_empty() const
+    {
+      return size() == 0;
+    }
+
+    /// Number of objects of the region with an external reference.
+    size_t size() const
+    {
+      return external_map == nullptr ? 0 : external_map->size();
+    }
+
     void insert(Object* object, ExternalRef* ext_ref)
     {
-      auto unique = external_map->insert(std::make_pair(object, ext_ref)).first;
+      auto unique =
+        get_external_map()->insert(std::make_pair(object, ext_ref)).first;
       assert(unique);
       UNUSED(unique);
     }
 
     void erase(Object* p)
     {
+      assert(external_map != nullptr);
       auto it = external_map->find(p);
       assert(it != external_map->end());
       remove_ref(it);
     }
 
+    /**
+     * Point the external reference to `from` at `to`, where a collection
+     * has moved the object.
+     **/
+    void move(Object* from, Object* to)
+    {
+      assert(external_map != nullptr);
+      auto it = external_map->find(from);
+      assert(it != external_map->end());
+      ExternalRef* ext_ref = it.value();
+      external_map->erase(it);
+      ext_ref->o = to;
+      insert(to, ext_ref);
+    }
+
+    /**
+     * Point the external references at the objects' new addresses after a
+     * collection that moved objects, where `forward(o)` is where `o` is
+     * now, or nullptr if it was collected. The references of collected
+     * objects are invalidated.
+     *
+     * The map is rebuilt rather than updated in place, as a moved object
+     * may take the key of one not visited yet, so this costs time in the
+     * number of external references only.
+     **/
+    template<typename Forward>
+    void relocate(Forward forward)
+    {
+      if (is_empty())
+        return;
+
+      ExternalMap* moved = ExternalMap::create(external_map->size());
+      for (auto e : *external_map)
+      {
+        ExternalRef* ext_ref = *e.second;
+        Object* to = forward(e.first);
+        if (to == nullptr)
+        {
+          invalidate(ext_ref);
+          continue;
+        }
+        ext_ref->o = to;
+        auto unique = moved->insert(std::make_pair(to, ext_ref)).first;
+        assert(unique);
+        UNUSED(unique);
+      }
+
+      external_map->dealloc();
+      heap::dealloc<sizeof(ExternalMap)>(external_map);
+      external_map = moved;
+    }
+
+    /**
+     * Invalidate the external references of the objects for which `dead`
+     * holds, which are not freed yet, and clear their flags, so that the
+     * sweep freeing them later need not look them up.
+     **/
+    template<typename Dead>
+    void erase_dead(Dead dead)
+    {
+      if (is_empty())
+        return;
+
+      for (auto it = external_map->begin(); it != external_map->end(); ++it)
+      {
+        Object* p = it.key();
+        if (dead(p))
+        {
+          p->clear_has_ext_ref();
+          remove_ref(it);
+        }
+      }
+    }
+
     void remove_ref(ExternalMap::Iterator& it)
     {
       auto*& ext_ref = it.value();
       if (ext_ref != nullptr)
-      {
-        // The object this external ref points to has been collected, so we
-        // need to invalidate this ext_ref so that `is_in` returns
-        // false.second.
-        ext_ref->o = nullptr;
-        ext_ref->ert.store(nullptr, std::memory_order_relaxed);
-        Immutable::release(ext_ref);
-      }
+        invalidate(ext_ref);
       external_map->erase(it);
     }
+
+  private:
+    static void invalidate(ExternalRef* ext_ref)
+    {
+      // The object this external ref points to has been collected, so we
+      // need to invalidate this ext_ref so that `is_in` returns false.
+      ext_ref->o = nullptr;
+      ext_ref->owner.store(nullptr, std::memory_order_relaxed);
+      Immutable::release(ext_ref);
+    }
   };
 
   using ExternalRef = ExternalReferenceTable::ExternalRef;
@@ -4,6 +4,9 @@
 
 #include "region.h"
 
+#include <cstring>
+#include <vector>
+
 namespace verona::rt
 {
   /**!freeze.md
@@ -117,10 +120,140 @@ namespace verona::rt
    * region. Rather than copy the set up front, we lazily construct it using the
    * ring in the isolated regions. Every time we break the ring, we keep track
    * of that point in the objects stack.
+   *
+   * Acyclic graphs
+   * --------------
+   *
+   * A caller that knows the graph has no cycles, for instance because it is
+   * a tree, can say so with `FreezeShape::Acyclic`. Every object is then an
+   * SCC of its own, so the walk makes each object a complete SCC as soon as
+   * it reaches it, and only counts the references it finds to it later. No
+   * path is kept, no union is done and there is no post-order visit.
+   *
+   * The declaration covers the regions nested in the one being frozen. If
+   * the graph does have a cycle, the objects on it count references to each
+   * other and are never freed.
+   *
+   * Other regions
+   * -------------
+   *
+   * Semispace and Rc regions can be frozen too, but have no ring of their
+   * objects, so the walk collects the objects it visits instead, and the
+   * region is rid of its garbage first.
+   *
+   * A semispace region is collected into the heap: every object reachable
+   * from the pinned entry point is copied into an allocation of its own,
+   * as a frozen object is freed on its own, and the spaces are freed with
+   * the dead objects in them. The entry point does not move.
+   *
+   * An Rc region frees its pending decrefs and every garbage cycle,
+   * whatever its cycle budget. Its fields already own a reference to the
+   * immutable objects they refer to, so the walk takes none, and the bits
+   * that held the colours and compact counts are cleared.
+   *
+   * Other regions cannot be frozen, and abort.
+   *
+   * Compact freezing
+   * ----------------
+   *
+   * `Freeze::apply_compact` copies the objects reachable from the entry
+   * point into one block (see FrozenBlock), in depth-first order, so that
+   * threads reading the frozen graph walk contiguous memory. The copies
+   * become one SCC rooted at the copy of the entry point, and the block is
+   * freed when that SCC is. Fields are updated through the pointer map or
+   * `Descriptor::relocate` of each object, or else by a scan of its body
+   * for the addresses of copied objects. The old objects are freed without
+   * running their destructors, since the copies now own what they held.
+   *
+   * Nested regions are frozen in place, and only referenced from the block.
+   * The block stays writable: acquiring and releasing the frozen graph
+   * updates the reference count in the header of its root.
+   */
+
+  /**
+   * What the caller of Freeze::apply() knows about the shape of the graph.
    */
+  enum class FreezeShape
+  {
+    /// Any graph; SCCs are computed.
+    Any,
+    /// The graph has no cycles, so every object is its own SCC.
+    Acyclic,
+  };
+
   class Freeze
   {
   private:
+    using ForwardMap = ObjectMap<std::pair<Object*, Object*>>;
+
+    /// Where apply_compact() has copied each object, for forward().
+    static inline thread_local ForwardMap* forwarding_ = nullptr;
+
+    /**
+     * Forwarding callback passed to Descriptor::relocate: the copy of an
+     * object apply_compact() has copied, or the reference unchanged.
+     */
+    static Object* forward(Object* field)
+    {
+      auto it = forwarding_->find(field);
+      if (it == forwarding_->end())
+        return field;
+      return it.value();
+    }
+
+    /// References intern() has moved off objects it replaced, each to be
+    /// released once it is done.
+    static inline thread_local std::vector<Object*>* replaced_ = nullptr;
+
+    /**
+     * Forwarding callback for intern(): the interned object that replaces
+     * a frozen one, with a reference taken for the field, or the reference
+     * unchanged.
+     */
+    static Object* forward_interned(Object* field)
+    {
+      auto it = forwarding_->find(field);
+      if (it == forwarding_->end())
+        return field;
+      it.value()->incref();
+      replaced_->push_back(field);
+      return it.value();
+    }
+
+    /**
+     * Update the fields of `obj` through its pointer map or relocate.
+     * Returns false if it has neither.
+     */
+    static bool fix_known_fields(Object* obj, Object* (*fwd)(Object*))
+    {
+      if (obj->relocate_mapped(fwd))
+        return true;
+
+      auto* descriptor = obj->get_descriptor();
+      if (descriptor->relocate != nullptr)
+      {
+        descriptor->relocate(obj, fwd);
+        return true;
+      }
+      return false;
+    }
+
+    static void fix_fields(Object* obj)
+    {
+      if (fix_known_fields(obj, forward))
+        return;
+
+      size_t body_size = obj->size() - sizeof(Object::Header);
+      auto* body = (Object**)obj;
+      size_t num_words = body_size / sizeof(Object*);
+      for (size_t i = 0; i < num_words; i++)
+      {
+        Object* word = body[i];
+        if (word != nullptr)
+          body[i] = forward(word);
+      }
+    }
+
     static Object* post_order_mark(Object* o)
     {
       return (Object*)(((size_t)o) | 1);
@@ -131,8 +264,34 @@ namespace verona::rt
       return (Object*)(((uintptr_t)o) & ~(uintptr_t)1);
     }
 
+    /**
+     * Whether `o`, the root of an immutable SCC, is the only object in it.
+     * Any other object of the SCC would be reachable from `o` through
+     * objects of the SCC, so a field of `o` would refer to one.
+     */
+    static bool is_own_scc(Object* o)
+    {
+      ObjectStack fields;
+      o->trace(fields);
+      bool alone = true;
+      while (!fields.empty())
+      {
+        Object::RegionMD c;
+        if (fields.pop()->root_and_class(c) == o)
+          alone = false;
+      }
+      return alone;
+    }
+
   public:
-    static void apply(Object* o)
+    /**
+     * Freeze the region whose entry point is `o`. If `frozen` is not
+     * null, the objects frozen are added to it.
+     */
+    static void apply(
+      Object* o,
+      FreezeShape shape = FreezeShape::Any,
+      std::vector<Object*>* frozen = nullptr)
     {
       assert(o->debug_is_iso());
 
@@ -141,6 +300,7 @@ namespace verona::rt
       ObjectStack iso;
       ObjectStack pending;
       ObjectStack dealloc_regions;
+      ObjectStack found;
 
       iso.push(o);
 
@@ -148,28 +308,69 @@ namespace verona::rt
       {
         assert(objects.empty());
         assert(dfs.empty());
+        assert(found.empty());
 
         Object* p = iso.pop();
         assert(p->debug_is_iso());
 
-        // TODO(region): Right now we can only freeze trace regions. We'll
-        // probably need different strategies if we want to freeze other kinds
-        // of regions, e.g. copying objects out of an arena region.
-        assert(RegionTrace::is_trace_region(p->get_region()));
-        RegionTrace* reg = RegionTrace::get(p);
+        RegionBase* reg = p->get_region();
+        RegionType type = Region::get_type(reg);
 
-        // Drop the ISO mark on the entry point.
-        p->init_next(reg);
+        switch (type)
+        {
+          case RegionType::Trace:
+          {
+            RegionTrace* trace = RegionTrace::get(p);
 
-        // Start with the graph entry point.
-        dfs.push(p);
+            // A frozen object is freed on its own, which objects in pages
+            // cannot be.
+            if (trace->is_paged())
+              abort();
+
+            trace->finish_mark(p);
+            trace->finish_sweep();
+            trace->end_sticky();
+
+            // Drop the ISO mark on the entry point.
+            p->init_next(trace);
 
-        // Add the finaliser, and non-finaliser rings to objects.
-        objects.push(reg->next_not_root);
-        objects.push(reg->get_next());
+            // Add the finaliser, and non-finaliser rings to objects.
+            objects.push(trace->next_not_root);
+            objects.push(trace->get_next());
 
-        // Mark region metadata object, so sweeping does not travel through it.
-        reg->Object::mark();
+            // Mark region metadata object, so sweeping does not travel
+            // through it.
+            trace->Object::mark();
+            break;
+          }
+
+          case RegionType::SemiSpace:
+          {
+            // Move the live objects out of the spaces, each into a heap
+            // allocation of its own, and free the rest.
+            ((RegionSemiSpace*)reg)->evacuate(p, dealloc_regions);
+            while (!dealloc_regions.empty())
+              Region::release(dealloc_regions.pop());
+            p->init_next(nullptr);
+            break;
+          }
+
+          case RegionType::Rc:
+          {
+            // Free the garbage, so that the walk finds every object left.
+            ((RegionRc*)reg)->prepare_freeze(p);
+            p->init_next(nullptr);
+            break;
+          }
+
+          default:
+            // The other regions allocate objects in blocks, which a frozen
+            // object cannot be freed from on its own.
+            abort();
+        }
+
+        // Start with the graph entry point.
+        dfs.push(p);
 
         while (!dfs.empty())
         {
@@ -239,8 +440,10 @@ namespace verona::rt
             {
               Logging::cout()
                 << "External reference during freeze: " << r << Logging::endl;
-              // External reference
-              r->incref();
+              // External reference. The fields of an Rc region each own a
+              // reference already.
+              if (type != RegionType::Rc)
+                r->incref();
               break;
             }
 
@@ -253,10 +456,28 @@ namespace verona::rt
 
             case Object::UNMARKED:
             {
-              // Lazily construct stack of sublists for gcing
-              objects.push(q->get_next());
+              // Lazily construct stack of sublists for gcing. Regions other
+              // than trace regions have no ring, but have no garbage left.
+              if (type == RegionType::Trace)
+                objects.push(q->get_next());
+              else
+                found.push(q);
               // Clear the `has_ext_ref` bit.
               q->clear_has_ext_ref();
+              if (type == RegionType::Rc)
+              {
+                // Clear the colour and count, which share the bits.
+                q->set_rc_colour(RcColour::GREEN);
+                if (((RegionRc*)reg)->is_compact())
+                  q->set_compact_rc(0);
+              }
+              if (shape == FreezeShape::Acyclic)
+              {
+                // Nothing below q reaches back to it, so it is complete.
+                q->make_nonatomic_scc();
+                q->trace(dfs);
+                break;
+              }
               // Add this to the current path we are exploring
               q->set_pending();
               pending.push(q);
@@ -272,6 +493,24 @@ namespace verona::rt
           }
         }
 
+        if (type != RegionType::Trace)
+        {
+          while (!found.empty())
+          {
+            p = found.pop();
+            if (p->get_class() == Object::NONATOMIC_RC)
+              p->make_atomic();
+            else
+              assert(p->get_class() == Object::SCC_PTR);
+            if (frozen != nullptr)
+              frozen->push_back(p);
+          }
+
+          reg->discard();
+          reg->dealloc();
+          continue;
+        }
+
         // Finalise all the objects
         // Move non-atomics to atomics
         // Calculate list of things to be deallocated
@@ -307,14 +546,19 @@ namespace verona::rt
             {
               // Convert to atomic rc to allow sharing.
               p->make_atomic();
+              if (frozen != nullptr)
+                frozen->push_back(p);
               break;
             }
 
             case Object::MARKED:
               assert(p == reg);
+              break;
 
             case Object::RC:
             case Object::SCC_PTR:
+              if (frozen != nullptr)
+                frozen->push_back(p);
               break;
 
             default:
@@ -345,5 +589,221 @@ namespace verona::rt
       assert(pending.empty());
       assert(dealloc_regions.empty());
     }
+
+    /**
+     * Replace each of the `frozen` objects reachable from `o`, which
+     * apply() has just frozen, by an equal interned object if there is one,
+     * or else intern it (see InternTable). Returns the object that now
+     * stands for `o`, passing the caller's reference to `o` on to it.
+     *
+     * Objects are visited children first, so that each one's fields refer
+     * to interned objects by the time it is compared. Only objects that are
+     * SCCs of their own are interned. Fields are updated through the
+     * pointer map or `Descriptor::relocate`, so the fields of objects with
+     * neither keep referring to the objects they did.
+     */
+    static Object* intern(Object* o, std::vector<Object*>& frozen)
+    {
+      // Objects still to visit. Only objects frozen with `o` are private to
+      // this thread, and so can have their fields changed.
+      ObjectMap<Object*> unvisited(frozen.size());
+      for (Object* f : frozen)
+        unvisited.insert(f);
+
+      ForwardMap forwarding;
+      std::vector<Object*> replaced;
+      forwarding_ = &forwarding;
+      replaced_ = &replaced;
+
+      ObjectStack dfs;
+      dfs.push(o);
+      while (!dfs.empty())
+      {
+        Object* q_mark = dfs.pop();
+        Object* q = remove_post_order_mark(q_mark);
+
+        if (q == q_mark)
+        {
+          if (unvisited.erase(q))
+          {
+            dfs.push(post_order_mark(q));
+            q->trace(dfs);
+          }
+          continue;
+        }
+
+        // Every field of `q` outside its SCC has been visited.
+        fix_known_fields(q, forward_interned);
+        if (
+          !InternTable::is_internable(q) ||
+          (q->get_class() != Object::RC) || !is_own_scc(q))
+          continue;
+
+        Object* c = InternTable::intern(q);
+        if (c != q)
+          forwarding.insert(std::make_pair(q, c));
+      }
+
+      forwarding_ = nullptr;
+      replaced_ = nullptr;
+
+      // The caller's reference to `o` moves to what replaces it, and the
+      // references intern() took for the others are not needed.
+      auto root = forwarding.find(o);
+      Object* result = root == forwarding.end() ? o : root.value();
+      if (result != o)
+        replaced.push_back(o);
+      for (auto it = forwarding.begin(); it != forwarding.end(); ++it)
+      {
+        if (it.key() != o)
+          Immutable::release(it.value());
+      }
+      for (Object* r : replaced)
+        Immutable::release(r);
+
+      return result;
+    }
+
+    /**
+     * Freeze the region whose entry point is `o` into a single block, and
+     * return the new address of `o`. Only the returned pointer may be used
+     * afterwards; external references into the region are invalidated.
+     */
+    static Object* apply_compact(Object* o)
+    {
+      assert(o->debug_is_iso());
+
+      if (!RegionTrace::is_trace_region(o->get_region()))
+        abort();
+      RegionTrace* reg = RegionTrace::get(o);
+
+      // Objects in pages cannot be freed on their own, and other roots
+      // would be left pointing at the old objects.
+      if (reg->is_paged() || !reg->additional_entry_points.empty())
+        abort();
+
+      reg->finish_mark(o);
+      reg->finish_sweep();
+      reg->end_sticky();
+
+      // Note every object before any header changes.
+      ObjectStack all;
+      for (auto p : *reg)
+        all.push(p);
+
+      // Drop the ISO mark on the entry point.
+      o->init_next(reg);
+
+      // Mark what is reachable, in the order it is to be laid out.
+      std::vector<Object*> reachable;
+      ObjectStack dfs;
+      ObjectStack subregions;
+      size_t bytes = 0;
+      dfs.push(o);
+      while (!dfs.empty())
+      {
+        Object::RegionMD c;
+        Object* q = dfs.pop();
+        Object* r = q->root_and_class(c);
+
+        switch (c)
+        {
+          case Object::UNMARKED:
+          {
+            q->mark();
+            reachable.push_back(q);
+            bytes += snmalloc::bits::align_up(q->size(), Object::ALIGNMENT);
+            q->trace(dfs);
+            break;
+          }
+
+          case Object::MARKED:
+            break;
+
+          case Object::ISO:
+          {
+            subregions.push(q);
+            break;
+          }
+
+          case Object::RC:
+          case Object::SHARED:
+          {
+            r->incref();
+            break;
+          }
+
+          default:
+            assert(0);
+        }
+      }
+
+      // Finalise the unreachable objects while every object is in place.
+      ObjectStack dealloc_regions;
+      ObjectStack dead;
+      while (!all.empty())
+      {
+        Object* p = all.pop();
+        if (p->get_class() != Object::UNMARKED)
+          continue;
+
+        p->finalise(nullptr, dealloc_regions);
+        dead.push(p);
+        while (!dealloc_regions.empty())
+          Region::release(dealloc_regions.pop());
+      }
+
+      // Copy the reachable objects into the block.
+      std::byte* block = FrozenBlock::alloc(bytes);
+      ForwardMap forwarding(reachable.size());
+      std::byte* free_ptr = block;
+      for (Object* q : reachable)
+      {
+        size_t size = snmalloc::bits::align_up(q->size(), Object::ALIGNMENT);
+        std::memcpy(free_ptr, q->real_start(), size);
+        forwarding.insert(std::make_pair(q, Object::object_start(free_ptr)));
+        free_ptr += size;
+      }
+
+      // Make the copies one SCC, rooted at the copy of `o`.
+      forwarding_ = &forwarding;
+      Object* root = forward(o);
+      assert(root->real_start() == block);
+      for (Object* q : reachable)
+      {
+        Object* n = forward(q);
+        fix_fields(n);
+        if (n == root)
+        {
+          n->make_nonatomic_scc();
+          n->make_atomic();
+        }
+        else
+        {
+          n->set_scc(root);
+        }
+        n->set_in_frozen_block();
+      }
+      forwarding_ = nullptr;
+
+      // The copies now own what the old objects held.
+      for (Object* q : reachable)
+        q->dealloc();
+
+      while (!dead.empty())
+      {
+        Object* q = dead.pop();
+        q->destructor();
+        q->dealloc();
+      }
+
+      reg->discard();
+      reg->dealloc();
+
+      while (!subregions.empty())
+        apply(subregions.pop());
+
+      return root;
+    }
   };
 } // namespace verona::rt
@@ -0,0 +1,167 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "../pal/perf_counters.h"
+#include "../pal/tick_clock.h"
+#include "gc_phases.h"
+#include "region_base.h"
+
+#include <algorithm>
+#include <atomic>
+#include <snmalloc/snmalloc.h>
+
+namespace verona::rt
+{
+  /**
+   * A GC or release of a region, as reported by with_region_stats().
+   */
+  struct GCEvent
+  {
+    uint64_t duration_ns;
+    RegionType type;
+    size_t memory_before;
+    size_t objects_before;
+    /// When the pause started, as given by now().
+    uint64_t start_ns;
+    /// Hardware counters over the pause, if PerfCounters is enabled.
+    PerfCounters::Values counters;
+    /// Time the pause spent in each GCPhases::Phase.
+    uint64_t phase_ns[GCPhases::COUNT];
+    /// Bytes the collector copied or moved.
+    uint64_t bytes_copied;
+    /// Memory the region used before the pause and no longer does; all of
+    /// it for a release.
+    size_t bytes_freed;
+    /// Memory the region used, objects left in it, and entries in its
+    /// remembered set, afterwards. All 0 for a release.
+    size_t memory_after;
+    size_t objects_survived;
+    /// Whether the event released the region, rather than collected it.
+    bool released;
+    size_t remembered_set_size;
+    /// Time with_region_stats() spent measuring and reporting the event,
+    /// outside the pause itself.
+    uint64_t harness_ns;
+
+    /// A monotonic clock in nanoseconds, for placing events in time.
+    static uint64_t now()
+    {
+      return TickClock::now_ns();
+    }
+
+    /**
+     * What timing an empty pause reads, in nanoseconds, and so the bias in
+     * every duration_ns. Measured once, as the least of many tries.
+     */
+    static uint64_t timer_overhead_ns()
+    {
+      static const uint64_t overhead = []() {
+        uint64_t least = ~uint64_t(0);
+        for (size_t i = 0; i < 1000; i++)
+        {
+          uint64_t start = TickClock::ticks();
+          uint64_t end = TickClock::ticks();
+          least = std::min(least, end - start);
+        }
+        return TickClock::to_ns(least);
+      }();
+      return overhead;
+    }
+  };
+
+  /**
+   * Process-wide collection of GC events, for the benchmark harness.
+   *
+   * Unlike the thread local gc_callback, this sees the events of every
+   * thread. Each thread records into a ring of its own, which only it
+   * writes to, so recording takes no lock. A single consumer drains all
+   * the rings with drain(). A thread whose ring is full drops the event
+   * and counts it, rather than wait for the consumer.
+   */
+  class GCEventSink
+  {
+  public:
+    /// Events each thread can hold before it drops them.
+    static constexpr size_t CAPACITY = 8192;
+
+  private:
+    struct Ring : public snmalloc::Pooled<Ring>
+    {
+      GCEvent events[CAPACITY];
+      /// Next event to drain, only written by the consumer.
+      std::atomic<size_t> head{0};
+      /// Next event to record, only written by the owning thread.
+      std::atomic<size_t> tail{0};
+      std::atomic<size_t> dropped{0};
+    };
+
+    using RingPool = snmalloc::Pool<Ring>;
+
+    /// Hands the thread's ring back to the pool when it exits, undrained
+    /// events and all, for the next thread to carry on from.
+    class LocalRing
+    {
+      friend class GCEventSink;
+      Ring* ring;
+
+      LocalRing() : ring(RingPool::acquire()) {}
+
+      ~LocalRing()
+      {
+        RingPool::release(ring);
+      }
+    };
+
+    static inline std::atomic<bool> enabled_{false};
+
+  public:
+    static void set_enabled(bool on)
+    {
+      enabled_.store(on, std::memory_order_relaxed);
+    }
+
+    static bool is_enabled()
+    {
+      return enabled_.load(std::memory_order_relaxed);
+    }
+
+    static void record(const GCEvent& e)
+    {
+      static thread_local LocalRing local;
+      Ring* r = local.ring;
+
+      size_t t = r->tail.load(std::memory_order_relaxed);
+      if (t - r->head.load(std::memory_order_acquire) == CAPACITY)
+      {
+        r->dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+      }
+
+      r->events[t % CAPACITY] = e;
+      r->tail.store(t + 1, std::memory_order_release);
+    }
+
+    /**
+     * Pass every event recorded since the last drain to `f`, one thread's
+     * ring at a time, and return how many were dropped. Only one thread
+     * may drain at a time.
+     */
+    template<typename F>
+    static size_t drain(F&& f)
+    {
+      size_t dropped = 0;
+      for (auto* r = RingPool::iterate(); r != nullptr;
+           r = RingPool::iterate(r))
+      {
+        size_t h = r->head.load(std::memory_order_relaxed);
+        size_t t = r->tail.load(std::memory_order_acquire);
+        for (; h != t; h++)
+          f(r->events[h % CAPACITY]);
+        r->head.store(h, std::memory_order_release);
+        dropped += r->dropped.exchange(0, std::memory_order_relaxed);
+      }
+      return dropped;
+    }
+  };
+} // namespace verona::rt
@@ -0,0 +1,161 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <snmalloc/snmalloc.h>
+
+namespace verona::rt
+{
+  /**
+   * Time spent in each phase of the collectors, and the bytes they copied,
+   * per thread, for the benchmark harness. with_region_stats() reports
+   * both with the event of each GC.
+   *
+   * Phases nest: a GCPhases::Scope inside another, such as the finaliser
+   * of one object during a sweep, takes the time from the outer phase
+   * until it ends. Only counted when ENABLE_BENCHMARKING is defined.
+   */
+  class GCPhases
+  {
+  public:
+    enum Phase : size_t
+    {
+      Mark,
+      Sweep,
+      Copy,
+      UpdatePointers,
+      Finalise,
+      /// Scanning the root of the region, before the objects it reaches.
+      Roots,
+      /// Marking or freeing the objects of a large object space.
+      LargeObjects,
+      /// Releasing the subregions that became unreachable.
+      ReleaseSubregions,
+      /// Recomputing the region's size and memory use, and resizing it.
+      Stats,
+      COUNT
+    };
+
+    static constexpr const char* NAMES[COUNT] = {
+      "mark",
+      "sweep",
+      "copy",
+      "update_pointers",
+      "finalise",
+      "roots",
+      "large_objects",
+      "release_subregions",
+      "stats"};
+
+    struct Totals
+    {
+      uint64_t ns[COUNT] = {};
+      uint64_t bytes_copied = 0;
+    };
+
+  private:
+    struct State
+    {
+      Totals totals;
+      /// The innermost phase, or COUNT outside of any.
+      Phase current = COUNT;
+      uint64_t since = 0;
+    };
+
+    static State& state()
+    {
+      static thread_local State s;
+      return s;
+    }
+
+    static uint64_t now()
+    {
+      return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+    }
+
+    /// Charge the time since the last switch to the current phase, and
+    /// make `next` current.
+    static void switch_to(Phase next)
+    {
+      State& s = state();
+      uint64_t t = now();
+      if (s.current != COUNT)
+        s.totals.ns[s.current] += t - s.since;
+      s.current = next;
+      s.since = t;
+    }
+
+  public:
+    /**
+     * Counts the time until it is destroyed, or until next(), against
+     * `phase`, and then goes back to the phase it was created in.
+     */
+    class Scope
+    {
+#ifdef ENABLE_BENCHMARKING
+      Phase outer;
+#endif
+
+    public:
+      Scope(Phase phase)
+      {
+#ifdef ENABLE_BENCHMARKING
+        outer = state().current;
+        switch_to(phase);
+#else
+        UNUSED(phase);
+#endif
+      }
+
+      /// Count the time from here against `phase` instead.
+      void next(Phase phase)
+      {
+#ifdef ENABLE_BENCHMARKING
+        switch_to(phase);
+#else
+        UNUSED(phase);
+#endif
+      }
+
+      ~Scope()
+      {
+#ifdef ENABLE_BENCHMARKING
+        switch_to(outer);
+#endif
+      }
+
+      Scope(const Scope&) = delete;
+      Scope& operator=(const Scope&) = delete;
+    };
+
+    /**
+     * Count `bytes` as copied or moved by the calling thread. A collector
+     * that copies on several threads counts the total on the thread that
+     * started the collection.
+     */
+    static void copied(size_t bytes)
+    {
+#ifdef ENABLE_BENCHMARKING
+      state().totals.bytes_copied += bytes;
+#else
+      UNUSED(bytes);
+#endif
+    }
+
+    /// Time the calling thread has spent in each phase so far, and the
+    /// bytes it has copied.
+    static Totals read()
+    {
+      State& s = state();
+      Totals t = s.totals;
+      if (s.current != COUNT)
+        t.ns[s.current] += now() - s.since;
+      return t;
+    }
+  };
+} // namespace verona::rt
@@ -0,0 +1,242 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace verona::rt
+{
+  /**
+   * Decides when a region is worth collecting, for callers that ask through
+   * api::region_maybe_collect() rather than collecting unconditionally.
+   *
+   * Every region has one, copied from the default policy when the region is
+   * created (see set_default()). Each collection of the region reports the
+   * memory in use before and after it, and how long it took. From that the
+   * policy works out how much memory the region may use before the next
+   * collection, so asking is a single comparison.
+   *
+   *  - Always collects whenever asked. This is the default, and matches
+   *    calling api::region_collect() directly.
+   *  - HeapGrowth collects once the region uses `param` percent of what
+   *    survived the last collection.
+   *  - AllocationBudget collects once the region has grown by `param` bytes
+   *    since the last collection.
+   *  - PauseTarget aims for collections of `param` nanoseconds. It keeps a
+   *    moving average of how many bytes of region a collection gets through
+   *    per microsecond, and lets the region grow to what can be collected
+   *    in the target time. It never lets the region collect again before
+   *    it has grown by half of what survived, so a region whose live data
+   *    alone exceeds the target does not collect on every request.
+   *
+   * The growth-based policies never collect a region smaller than
+   * MIN_TRIGGER_BYTES.
+   *
+   * A policy can also ask to be consulted whenever its region is closed
+   * (see on_close()), which is a safepoint: the mutator holds no pointers
+   * into the region there, so even a moving collection needs nothing
+   * from it.
+   **/
+  class GCPolicy
+  {
+  public:
+    enum class Kind
+    {
+      Always,
+      HeapGrowth,
+      AllocationBudget,
+      PauseTarget,
+    };
+
+    static constexpr size_t DEFAULT_GROWTH_PERCENT = 200;
+    static constexpr size_t DEFAULT_ALLOCATION_BUDGET = 1024 * 1024;
+    static constexpr uint64_t DEFAULT_PAUSE_TARGET_NS = 1000 * 1000;
+    static constexpr size_t MIN_TRIGGER_BYTES = 64 * 1024;
+
+  private:
+    Kind kind = Kind::Always;
+    uint64_t param = 0;
+
+    /// Memory use at which the region is next worth collecting.
+    size_t trigger = 0;
+
+    /// Memory in use after the last collection.
+    size_t live = 0;
+
+    /// For PauseTarget, the moving average of bytes collected per
+    /// microsecond, or 0 before the first collection.
+    uint64_t bytes_per_us = 0;
+
+    /// Whether api::close_region() asks this policy.
+    bool close = false;
+
+    static inline std::atomic<Kind> default_kind_{Kind::Always};
+    static inline std::atomic<uint64_t> default_param_{0};
+    static inline std::atomic<bool> default_close_{false};
+
+    GCPolicy(Kind k, uint64_t p) : kind(k), param(p)
+    {
+      update_trigger();
+    }
+
+  public:
+    GCPolicy() = default;
+
+    static GCPolicy always()
+    {
+      return {Kind::Always, 0};
+    }
+
+    static GCPolicy heap_growth(size_t percent = DEFAULT_GROWTH_PERCENT)
+    {
+      return {Kind::HeapGrowth, percent < 100 ? 100 : percent};
+    }
+
+    static GCPolicy allocation_budget(size_t bytes = DEFAULT_ALLOCATION_BUDGET)
+    {
+      return {Kind::AllocationBudget, bytes};
+    }
+
+    static GCPolicy pause_target(uint64_t ns = DEFAULT_PAUSE_TARGET_NS)
+    {
+      return {Kind::PauseTarget, ns == 0 ? 1 : ns};
+    }
+
+    /**
+     * Set the policy regions created from now on start with.
+     **/
+    static void set_default(GCPolicy policy)
+    {
+      default_param_.store(policy.param, std::memory_order_relaxed);
+      default_kind_.store(policy.kind, std::memory_order_relaxed);
+      default_close_.store(policy.close, std::memory_order_relaxed);
+    }
+
+    static GCPolicy get_default()
+    {
+      GCPolicy policy{
+        default_kind_.load(std::memory_order_relaxed),
+        default_param_.load(std::memory_order_relaxed)};
+      policy.close = default_close_.load(std::memory_order_relaxed);
+      return policy;
+    }
+
+    /**
+     * This policy, but asked whether to collect each time its region is
+     * closed if `on` is true.
+     **/
+    GCPolicy on_close(bool on = true) const
+    {
+      GCPolicy policy = *this;
+      policy.close = on;
+      return policy;
+    }
+
+    bool is_on_close() const
+    {
+      return close;
+    }
+
+    /**
+     * This policy, but not collecting its region before it uses `bytes`,
+     * for a region expected to be filled to that size. The floor lasts
+     * until the first collection. GCPolicy::always() is left as it is.
+     **/
+    GCPolicy warm_up(size_t bytes) const
+    {
+      GCPolicy policy = *this;
+      if ((kind != Kind::Always) && (bytes > policy.trigger))
+        policy.trigger = bytes;
+      return policy;
+    }
+
+    Kind get_kind() const
+    {
+      return kind;
+    }
+
+    /// Memory use at which the region is next worth collecting.
+    size_t get_trigger() const
+    {
+      return trigger;
+    }
+
+    /// Memory in use after the last collection.
+    size_t get_live() const
+    {
+      return live;
+    }
+
+    /**
+     * Whether a region using `memory_used` bytes is worth collecting.
+     **/
+    bool should_collect(size_t memory_used) const
+    {
+      return memory_used >= trigger;
+    }
+
+    /**
+     * Record a collection that took the region from `before` to `after`
+     * bytes in `pause_ns` nanoseconds, and work out the next trigger.
+     **/
+    void collected(size_t before, size_t after, uint64_t pause_ns)
+    {
+      if ((kind == Kind::PauseTarget) && (pause_ns != 0))
+      {
+        uint64_t sample = before * 1000 / pause_ns;
+        bytes_per_us =
+          bytes_per_us == 0 ? sample : (bytes_per_us * 3 + sample) / 4;
+      }
+      live = after;
+      update_trigger();
+    }
+
+    /**
+     * Account for the region `other` governs being merged into this one.
+     * What survived the last collection of either survives in the merged
+     * region, so the trigger is worked out again from the sum. This policy
+     * keeps its own kind and pause measurements.
+     **/
+    void merge(const GCPolicy& other)
+    {
+      live += other.live;
+      update_trigger();
+    }
+
+  private:
+    void update_trigger()
+    {
+      size_t t = 0;
+      switch (kind)
+      {
+        case Kind::Always:
+          trigger = 0;
+          return;
+
+        case Kind::HeapGrowth:
+          t = live / 100 * param + live % 100 * param / 100;
+          break;
+
+        case Kind::AllocationBudget:
+          t = live + param;
+          break;
+
+        case Kind::PauseTarget:
+        {
+          t = live + live / 2;
+          if (bytes_per_us != 0)
+          {
+            size_t budget = bytes_per_us * (param / 1000);
+            if (budget > t)
+              t = budget;
+          }
+          break;
+        }
+      }
+      trigger = t < MIN_TRIGGER_BYTES ? MIN_TRIGGER_BYTES : t;
+    }
+  };
+} // namespace verona::rt
@@ -0,0 +1,298 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "../object/object.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#ifndef _MSC_VER
+#  include <cxxabi.h>
+#endif
+
+namespace verona::rt
+{
+  /**
+   * Accounts the objects that collections find alive to their types, so
+   * that when a region grows it can be seen which types hold its memory.
+   *
+   * The collectors already visit every live object, as they mark or copy
+   * it, and count it here too. A type is a Descriptor, named after the
+   * class of a V<T> (see Descriptor::name). Each thread adds to a table of
+   * its own without synchronisation, and the tables are merged to read
+   * them, so a collection that copies on several threads is counted whole.
+   * The profile sums what every collection found, so that dividing by the
+   * collections profiled gives the live heap of the average one.
+   *
+   * Off unless set_enabled(true) is called, in which case it costs a
+   * lookup in the thread's table for each live object. Off, it costs each
+   * live object a relaxed load.
+   */
+  class HeapProfile
+  {
+  public:
+    /// Types a profile tells apart; later types are counted as the last.
+    static constexpr size_t MAX_TYPES = 512;
+
+    struct Row
+    {
+      std::string name;
+      /// Size of the type's objects, without any trailing array.
+      size_t size = 0;
+      /// Live objects and bytes, summed over the collections profiled.
+      uint64_t objects = 0;
+      uint64_t bytes = 0;
+    };
+
+  private:
+    struct Entry
+    {
+      // Written only by the table's thread, and read by rows().
+      std::atomic<uint64_t> objects{0};
+      std::atomic<uint64_t> bytes{0};
+    };
+
+    struct Table
+    {
+      /// Open addressing from a descriptor to its id. Only the table's
+      /// thread uses it.
+      static constexpr size_t SLOTS = 2 * MAX_TYPES;
+      const Descriptor* keys[SLOTS] = {};
+      size_t ids[SLOTS];
+
+      Entry entries[MAX_TYPES];
+    };
+
+    struct State
+    {
+      std::mutex lock;
+      /// Name and size of each type, by id.
+      std::vector<Row> types;
+      std::unordered_map<const Descriptor*, size_t> ids;
+      /// Kept after their thread exits, so that rows() still counts them.
+      std::vector<std::unique_ptr<Table>> tables;
+      /// Tables of threads that have exited, for the next thread to take,
+      /// as the threads a parallel copy starts are short lived.
+      std::vector<Table*> free;
+    };
+
+    static inline std::atomic<bool> enabled_{false};
+    static inline std::atomic<uint64_t> collections_{0};
+
+    static State& state()
+    {
+      static State s;
+      return s;
+    }
+
+    static Table& local()
+    {
+      struct Handle
+      {
+        Table* table = nullptr;
+
+        ~Handle()
+        {
+          if (table == nullptr)
+            return;
+          auto& s = state();
+          std::lock_guard<std::mutex> lock(s.lock);
+          s.free.push_back(table);
+        }
+      };
+      static thread_local Handle h;
+      if (h.table == nullptr)
+      {
+        auto& s = state();
+        std::lock_guard<std::mutex> lock(s.lock);
+        if (!s.free.empty())
+        {
+          h.table = s.free.back();
+          s.free.pop_back();
+        }
+        else
+        {
+          s.tables.push_back(std::make_unique<Table>());
+          h.table = s.tables.back().get();
+        }
+      }
+      return *h.table;
+    }
+
+    /**
+     * The id of `desc`, registered on first sight. The name is copied, as
+     * the descriptor may be in a library unloaded before the profile is
+     * read.
+     */
+    static size_t register_type(const Descriptor* desc)
+    {
+      auto& s = state();
+      std::lock_guard<std::mutex> lock(s.lock);
+      auto it = s.ids.find(desc);
+      if (it != s.ids.end())
+        return it->second;
+
+      s.types.push_back({type_name(desc), desc->size});
+      size_t id = std::min(s.types.size() - 1, MAX_TYPES - 1);
+      s.ids.emplace(desc, id);
+      return id;
+    }
+
+    static size_t id_of(Table& t, const Descriptor* desc)
+    {
+      size_t i = (((uintptr_t)desc >> 3) * 0x9E3779B97F4A7C15ull) %
+        Table::SLOTS;
+      for (size_t probes = 0; probes < Table::SLOTS; probes++)
+      {
+        if (t.keys[i] == desc)
+          return t.ids[i];
+        if (t.keys[i] == nullptr)
+        {
+          t.keys[i] = desc;
+          t.ids[i] = register_type(desc);
+          return t.ids[i];
+        }
+        i = (i + 1) % Table::SLOTS;
+      }
+      return MAX_TYPES - 1;
+    }
+
+    static void add(std::atomic<uint64_t>& a, uint64_t n)
+    {
+      a.store(a.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+  public:
+    /// The name of the type of the objects of `desc`, demangled.
+    static std::string type_name(const Descriptor* desc)
+    {
+      if (desc->name == nullptr)
+        return "(unnamed)";
+
+      std::string name = desc->name;
+#ifndef _MSC_VER
+      int status = 0;
+      char* demangled =
+        abi::__cxa_demangle(desc->name, nullptr, nullptr, &status);
+      if (status == 0 && demangled != nullptr)
+        name = demangled;
+      std::free(demangled);
+#endif
+      return name;
+    }
+
+    static void set_enabled(bool on)
+    {
+      enabled_.store(on, std::memory_order_relaxed);
+    }
+
+    static bool is_enabled()
+    {
+      return enabled_.load(std::memory_order_relaxed);
+    }
+
+    /// Count `o` as found alive by the collection in progress.
+    static void count(const Object* o)
+    {
+      if (SNMALLOC_LIKELY(!is_enabled()))
+        return;
+
+      Table& t = local();
+      Entry& e = t.entries[id_of(t, o->get_descriptor())];
+      add(e.objects, 1);
+      add(e.bytes, o->size());
+    }
+
+    /// Count a collection, whose live objects are being counted.
+    static void collected()
+    {
+      collections_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /// Collections profiled so far.
+    static uint64_t get_collections()
+    {
+      return collections_.load(std::memory_order_relaxed);
+    }
+
+    /// Forget everything profiled so far, but not the types.
+    static void reset()
+    {
+      auto& s = state();
+      std::lock_guard<std::mutex> lock(s.lock);
+      for (auto& t : s.tables)
+      {
+        for (Entry& e : t->entries)
+        {
+          e.objects.store(0, std::memory_order_relaxed);
+          e.bytes.store(0, std::memory_order_relaxed);
+        }
+      }
+      collections_.store(0, std::memory_order_relaxed);
+    }
+
+    /// Every type found alive so far, most bytes first.
+    static std::vector<Row> rows()
+    {
+      auto& s = state();
+      std::lock_guard<std::mutex> lock(s.lock);
+      std::vector<Row> rows;
+      for (size_t i = 0; i < std::min(s.types.size(), MAX_TYPES); i++)
+      {
+        Row r = s.types[i];
+        if (i == MAX_TYPES - 1 && s.types.size() > MAX_TYPES)
+          r = {"(other types)", 0};
+        for (auto& t : s.tables)
+        {
+          r.objects += t->entries[i].objects.load(std::memory_order_relaxed);
+          r.bytes += t->entries[i].bytes.load(std::memory_order_relaxed);
+        }
+        if (r.objects != 0)
+          rows.push_back(std::move(r));
+      }
+      std::sort(rows.begin(), rows.end(), [](const Row& a, const Row& b) {
+        return a.bytes > b.bytes;
+      });
+      return rows;
+    }
+
+    /**
+     * Print every type found alive, most bytes first: its share of the
+     * live bytes, and its live objects and bytes in the average collection
+     * profiled.
+     */
+    static void dump(std::ostream& out)
+    {
+      std::vector<Row> rows = HeapProfile::rows();
+      uint64_t collections = std::max<uint64_t>(get_collections(), 1);
+      uint64_t total = 0;
+      for (const Row& r : rows)
+        total += r.bytes;
+
+      out << "Heap profile (" << rows.size() << " types, " << get_collections()
+          << " collections)\n"
+          << std::setw(8) << "share" << std::setw(14) << "objects"
+          << std::setw(14) << "bytes" << std::setw(8) << "size"
+          << "  type\n";
+      for (const Row& r : rows)
+      {
+        out << std::setw(7) << std::fixed << std::setprecision(1)
+            << (total == 0 ? 0.0 : 100.0 * (double)r.bytes / (double)total)
+            << "%" << std::defaultfloat << std::setw(14)
+            << r.objects / collections << std::setw(14)
+            << r.bytes / collections << std::setw(8) << r.size << "  "
+            << r.name << "\n";
+      }
+    }
+  };
+} // namespace verona::rt
@@ -3,8 +3,14 @@
 #pragma once
 
 #include "../object/object.h"
+#include "../pal/cache_line.h"
+#include "intern.h"
 #include "linked_object_stack.h"
 
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+
 namespace verona::rt
 {
   class Shared;
@@ -14,79 +20,252 @@ namespace verona::rt
     inline void release(Object* o);
   } // namespace shared
 
-  class Immutable
+  /**
+   * A block of memory holding a whole immutable SCC, made by
+   * Freeze::apply_compact(). The objects in it are freed together with the
+   * block, when the SCC is. The first object is the root of the SCC, and
+   * starts a cache line into the block, after the size of the block.
+   */
+  struct FrozenBlock
   {
-  public:
-    static void acquire(Object* o)
+    static constexpr size_t HEADER = CACHE_LINE;
+
+    /// Allocate a block for `size` bytes of objects, and return where the
+    /// objects start.
+    static std::byte* alloc(size_t size)
     {
-      assert(o->debug_is_immutable());
-      o->immutable()->incref();
+      size += HEADER;
+      auto* p = (std::byte*)heap::alloc(size);
+      *(size_t*)p = size;
+      return p + HEADER;
     }
 
-    static size_t release(Object* o)
+    /// Free the block whose first object is `root`.
+    static void dealloc(Object* root)
     {
-      assert(o->debug_is_immutable());
-      auto root = o->immutable();
-
-      if (root->decref())
-        return free(root);
-
-      return 0;
+      std::byte* p = root->real_start() - HEADER;
+      heap::dealloc(p, *(size_t*)p);
     }
+  };
+
+  /**
+   * Immutable SCCs are freed when the reference count of their root drops
+   * to zero. By default this happens at once, on the releasing thread,
+   * which for a large frozen graph can hold up the behaviour that dropped
+   * the last reference.
+   *
+   * With deferred release on (see set_deferred_release()), the root is
+   * queued instead, and scheduler threads with nothing else to run tear
+   * the queued graphs down a chunk of objects at a time (see
+   * reclaim_deferred()). This also covers the releases that the epoch
+   * machinery delays. A thread that is not a scheduler thread, or that
+   * releases after the scheduler has stopped, must call
+   * reclaim_deferred() itself until it returns false.
+   */
+  class Immutable
+  {
+  public:
+    /// Objects torn down by one call to reclaim_deferred().
+    static constexpr size_t RECLAIM_CHUNK = 1024;
 
   private:
-    static size_t free(Object* o)
+    /**
+     * The teardown of the SCCs reachable from some zero-count roots, kept
+     * between calls so that it can be done a bounded amount at a time.
+     */
+    class Teardown
     {
-      assert(o == o->immutable());
-      size_t total = 0;
-
-      // Free immutable graph.
       ObjectStack f;
       LinkedObjectStack fl;
       LinkedObjectStack scc;
       LinkedObjectStack dfs;
 
-      dfs.push(o);
+      /// The root of the SCC being torn down, or nullptr between SCCs.
+      Object* root = nullptr;
+      /// Whether the SCC is in a FrozenBlock.
+      bool in_block = false;
+      /// Whether all of the SCC has been found and finalised.
+      bool finalised = false;
 
-      while (!dfs.empty())
+    public:
+      ~Teardown()
       {
-        assert(f.empty());
-        assert(fl.empty());
-        assert(scc.empty());
+        step(SIZE_MAX);
+      }
+
+      bool empty()
+      {
+        return (root == nullptr) && dfs.empty();
+      }
+
+      /// Add the root `o` of an SCC whose reference count is zero.
+      void push(Object* o)
+      {
+        dfs.push(o);
+      }
 
-        scc.push(dfs.pop());
+      /**
+       * Tear down at most `budget` objects, and return how many bytes were
+       * freed.
+       */
+      size_t step(size_t budget)
+      {
+        size_t total = 0;
+        size_t done = 0;
 
-        while (!scc.empty())
+        while (done < budget)
         {
-          Object* w = scc.pop();
-          fl.push(w);
-          w->trace(f);
+          if (root == nullptr)
+          {
+            if (dfs.empty())
+              break;
+
+            root = dfs.pop();
+            in_block = root->in_frozen_block();
+            finalised = false;
+            scc.push(root);
+          }
 
-          while (!f.empty())
+          if (!finalised)
           {
-            Object* u = f.pop();
-            scc_classify(u, dfs, scc);
+            if (!scc.empty())
+            {
+              Object* w = scc.pop();
+              fl.push(w);
+              w->trace(f);
+
+              while (!f.empty())
+              {
+                Object* u = f.pop();
+                scc_classify(u, dfs, scc);
+              }
+              done++;
+              continue;
+            }
+
+            // Run all finalisers for this SCC before deallocating.
+            fl.forall<run_finaliser>();
+            finalised = true;
           }
-        }
 
-        // Run all finalisers for this SCC before deallocating.
-        fl.forall<run_finaliser>();
+          if (!fl.empty())
+          {
+            Object* w = fl.pop();
+            total += w->size();
+            w->destructor();
+            if (!in_block)
+              w->dealloc();
+            done++;
+            continue;
+          }
 
-        while (!fl.empty())
-        {
-          Object* w = fl.pop();
-          total += w->size();
-          w->destructor();
-          w->dealloc();
+          if (in_block)
+            FrozenBlock::dealloc(root);
+          root = nullptr;
         }
+
+        assert(!empty() || (f.empty() && fl.empty() && scc.empty()));
+        return total;
+      }
+    };
+
+    static inline std::atomic<bool> deferred_{false};
+    static inline std::atomic<size_t> pending_count_{0};
+    static inline std::mutex pending_lock_;
+    static inline LinkedObjectStack pending_;
+
+    static Teardown& local()
+    {
+      static thread_local Teardown teardown;
+      return teardown;
+    }
+
+  public:
+    static void acquire(Object* o)
+    {
+      assert(o->debug_is_immutable());
+      o->immutable()->incref();
+    }
+
+    /**
+     * Release a reference to `o`, and return how many bytes were freed as a
+     * result. Always 0 when deferred release is on.
+     */
+    static size_t release(Object* o)
+    {
+      assert(o->debug_is_immutable());
+      auto root = o->immutable();
+
+      if (!decref(root))
+        return 0;
+
+      if (is_deferred_release())
+      {
+        std::lock_guard<std::mutex> l(pending_lock_);
+        pending_.push(root);
+        pending_count_.fetch_add(1, std::memory_order_relaxed);
+        return 0;
+      }
+
+      return free(root);
+    }
+
+    /**
+     * Whether immutable graphs whose last reference goes are freed later,
+     * by reclaim_deferred(), rather than by the release.
+     */
+    static void set_deferred_release(bool on)
+    {
+      deferred_.store(on, std::memory_order_relaxed);
+    }
+
+    static bool is_deferred_release()
+    {
+      return deferred_.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Tear down up to RECLAIM_CHUNK objects of the graphs queued by deferred
+     * release. Returns false if there was nothing to do.
+     */
+    static bool reclaim_deferred()
+    {
+      auto& t = local();
+      if (t.empty())
+      {
+        if (pending_count_.load(std::memory_order_relaxed) == 0)
+          return false;
+
+        std::lock_guard<std::mutex> l(pending_lock_);
+        if (pending_.empty())
+          return false;
+
+        t.push(pending_.pop());
+        pending_count_.fetch_sub(1, std::memory_order_relaxed);
       }
 
-      assert(f.empty());
-      assert(fl.empty());
-      assert(scc.empty());
-      assert(dfs.empty());
+      t.step(RECLAIM_CHUNK);
+      return true;
+    }
+
+  private:
+    /**
+     * Release a reference to the root of an SCC, and return whether it was
+     * the last. Interned roots are released through the InternTable.
+     */
+    static bool decref(Object* r)
+    {
+      if (r->is_interned())
+        return InternTable::decref(r);
+      return r->decref();
+    }
 
-      return total;
+    static size_t free(Object* o)
+    {
+      assert(o == o->immutable());
+      Teardown t;
+      t.push(o);
+      return t.step(SIZE_MAX);
     }
 
     static inline void run_finaliser(Object* o)
@@ -106,7 +285,7 @@ namespace verona::rt
       {
         case Object::RC:
         {
-          if (r->decref())
+          if (decref(r))
             dfs.push(r);
           break;
         }
@@ -0,0 +1,139 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "../object/object.h"
+
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+
+namespace verona::rt
+{
+  /**
+   * The table of interned immutable objects, which freeze_interned() uses to
+   * share structurally equal frozen objects rather than keep copies of them.
+   * An object can be interned if its descriptor has a `hash` and `equals`,
+   * and it is an SCC of its own.
+   *
+   * The table holds no reference to the objects in it. Instead, an interned
+   * object's last reference is released under the lock of its stripe, which
+   * takes it out of the table before it is torn down, and finding an object
+   * in the table takes a reference to it under the same lock. So an object
+   * found in the table is never one that is being freed.
+   */
+  class InternTable
+  {
+  public:
+    /// Locks the table is split over.
+    static constexpr size_t STRIPES = 64;
+
+  private:
+    struct Stripe
+    {
+      std::mutex lock;
+      std::unordered_multimap<size_t, Object*> objects;
+    };
+
+    static inline std::atomic<size_t> size_{0};
+    static inline std::atomic<size_t> hits_{0};
+
+    static Stripe& stripe(size_t hash)
+    {
+      static Stripe stripes[STRIPES];
+      return stripes[hash % STRIPES];
+    }
+
+    static size_t hash_of(Object* o)
+    {
+      const Descriptor* desc = o->get_descriptor();
+      // Objects of different types with the same contents differ, and the
+      // bits are mixed so that the stripe depends on all of them.
+      size_t h = desc->hash(o) ^ (uintptr_t)desc;
+      h ^= h >> 29;
+      h *= (size_t)0xbf58476d1ce4e5b9ULL;
+      h ^= h >> (sizeof(size_t) * 4);
+      return h;
+    }
+
+  public:
+    /// Whether objects of the type of `o` can be interned.
+    static bool is_internable(Object* o)
+    {
+      return o->get_descriptor()->hash != nullptr;
+    }
+
+    /**
+     * The interned object equal to `o`, with a reference taken on it for
+     * the caller, or if there is none, `o`, which is added to the table.
+     * `o` must be an immutable SCC of its own, whose fields refer to
+     * interned objects where they can.
+     */
+    static Object* intern(Object* o)
+    {
+      assert(is_internable(o));
+      assert(!o->is_interned());
+      const Descriptor* desc = o->get_descriptor();
+      size_t hash = hash_of(o);
+      Stripe& s = stripe(hash);
+      std::lock_guard<std::mutex> lock(s.lock);
+
+      auto range = s.objects.equal_range(hash);
+      for (auto it = range.first; it != range.second; ++it)
+      {
+        Object* c = it->second;
+        if ((c->get_descriptor() == desc) && desc->equals(c, o))
+        {
+          c->incref();
+          hits_.fetch_add(1, std::memory_order_relaxed);
+          return c;
+        }
+      }
+
+      s.objects.emplace(hash, o);
+      o->set_interned(true);
+      size_.fetch_add(1, std::memory_order_relaxed);
+      return o;
+    }
+
+    /**
+     * Release a reference to the interned object `o`, taking it out of the
+     * table if it was the last. Returns whether it was.
+     */
+    static bool decref(Object* o)
+    {
+      assert(o->is_interned());
+      size_t hash = hash_of(o);
+      Stripe& s = stripe(hash);
+      std::lock_guard<std::mutex> lock(s.lock);
+
+      if (!o->decref())
+        return false;
+
+      auto range = s.objects.equal_range(hash);
+      for (auto it = range.first; it != range.second; ++it)
+      {
+        if (it->second == o)
+        {
+          s.objects.erase(it);
+          break;
+        }
+      }
+      o->set_interned(false);
+      size_.fetch_sub(1, std::memory_order_relaxed);
+      return true;
+    }
+
+    /// Objects in the table.
+    static size_t size()
+    {
+      return size_.load(std::memory_order_relaxed);
+    }
+
+    /// Objects that intern() found an equal object for.
+    static size_t hits()
+    {
+      return hits_.load(std::memory_order_relaxed);
+    }
+  };
+} // namespace verona::rt
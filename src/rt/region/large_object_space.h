@@ -0,0 +1,574 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include "../ds/stack.h"
+#include "../object/object.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+namespace verona::rt
+{
+  using namespace snmalloc;
+
+  /**
+   * Storage for the objects of a region that are too large to copy, or
+   * that the region keeps from moving for another reason (pinned or
+   * pretenured ones), whatever their size.
+   *
+   * Memory is taken in page-aligned chunks. Objects that need at most
+   * MAX_SLAB_SLOT bytes share slab chunks, each cut into equal slots of one
+   * power-of-two size class, and every class keeps a free list of the
+   * chunks that have a slot to spare. Slab chunks are CHUNK_SIZE bytes, or
+   * SMALL_CHUNK_SIZE for the classes below a page. Bigger objects get a
+   * chunk of their own, rounded up to whole pages.
+   *
+   * Each slot starts with a small header naming its chunk and index. The
+   * chunk metadata lives out of line and holds a bitmap of the slots in use
+   * and a mark bitmap, so a collection marks objects without writing their
+   * headers, and never touches a dead object that has no finaliser.
+   *
+   * Sweeping is lazy: end_collection() only moves every chunk to the
+   * unswept list. A chunk is swept, which frees its dead slots and gives
+   * its memory back once it is empty, when allocation runs out of room of
+   * its size class or when the next collection starts. Until then a slot
+   * in an unswept chunk is live only if it is marked. Finalisers cannot be
+   * deferred like this, so the non-trivial objects are also kept in a side
+   * table, and the dead ones are finalised by the collection itself.
+   *
+   * Whether a chunk is swept is told by the list it is on, so the chunks of
+   * another space can be taken over by splicing its lists (see merge()).
+   **/
+  class LargeObjectSpace
+  {
+  public:
+    static constexpr size_t PAGE_SIZE = 4096;
+
+    /// Size of a slab chunk.
+    static constexpr size_t CHUNK_SIZE = 1024 * 1024;
+
+    /// Size of a slab chunk of slots smaller than a page.
+    static constexpr size_t SMALL_CHUNK_SIZE = 64 * 1024;
+
+    /// Smallest slot: a slot header, an object header and a field.
+    static constexpr size_t MIN_SLOT = 32;
+
+    /// Largest slot of a slab chunk. Objects that need more get a chunk of
+    /// their own.
+    static constexpr size_t MAX_SLAB_SLOT = CHUNK_SIZE / 4;
+
+    /// The smallest object worth sending here for its size alone: half a
+    /// page, so no slot of a page or more is more than half empty.
+    static constexpr size_t MIN_OBJECT_SIZE = PAGE_SIZE / 2;
+
+  private:
+    static constexpr size_t MIN_SLOT_BITS =
+      bits::next_pow2_bits_const(MIN_SLOT);
+
+    /// Size classes MIN_SLOT, 2 * MIN_SLOT, ..., MAX_SLAB_SLOT.
+    static constexpr size_t NUM_CLASSES =
+      bits::next_pow2_bits_const(MAX_SLAB_SLOT) - MIN_SLOT_BITS + 1;
+
+    /// Size class of a chunk that holds a single object.
+    static constexpr size_t SINGLE = NUM_CLASSES;
+
+    static constexpr size_t MAX_SLOTS =
+      std::max(CHUNK_SIZE / PAGE_SIZE, SMALL_CHUNK_SIZE / MIN_SLOT);
+    static constexpr size_t BITMAP_WORDS = MAX_SLOTS / bits::BITS;
+
+    struct Chunk
+    {
+      std::byte* base;
+      size_t size;
+      size_t slot_size;
+      size_t slot_count;
+      size_t size_class;
+
+      /// Number of bits set in `used`.
+      size_t used_count = 0;
+      /// Words of `used` before this one are full.
+      size_t first_free_word = 0;
+
+      /// Next chunk on the swept or unswept list.
+      Chunk* next = nullptr;
+      /// Next chunk on the free list of its size class.
+      Chunk* next_free = nullptr;
+
+      size_t used[BITMAP_WORDS] = {};
+      /// Set during a collection, possibly by several threads at once.
+      std::atomic<size_t> marked[BITMAP_WORDS] = {};
+    };
+
+    struct SlotHeader
+    {
+      Chunk* chunk;
+      size_t index;
+    };
+
+    static constexpr size_t SLOT_HEADER_SIZE =
+      bits::align_up(sizeof(SlotHeader), Object::ALIGNMENT);
+
+    /// Chunks whose `used` bitmap is exact.
+    Chunk* swept = nullptr;
+    Chunk* swept_last = nullptr;
+
+    /// Chunks the last collection has marked but that are not swept yet.
+    /// In these, a slot is live only if it is both used and marked.
+    Chunk* unswept = nullptr;
+    Chunk* unswept_last = nullptr;
+
+    /// Swept slab chunks with a free slot, per size class.
+    Chunk* free_lists[NUM_CLASSES] = {};
+
+    /// The non-trivial objects, which need finalising when they die.
+    StackThin<Object> non_trivial{};
+
+    size_t object_count = 0;
+    size_t object_bytes = 0;
+    size_t chunk_count = 0;
+    size_t chunk_bytes = 0;
+
+  public:
+    /**
+     * Allocate an object of type `desc` and of `size` bytes.
+     **/
+    Object* alloc(const Descriptor* desc, size_t size)
+    {
+      size_t need = SLOT_HEADER_SIZE + size;
+
+      Chunk* c;
+      size_t index = 0;
+      if (need > MAX_SLAB_SLOT)
+      {
+        c = new_chunk(bits::align_up(need, PAGE_SIZE), SINGLE);
+      }
+      else
+      {
+        size_t sc = bits::next_pow2_bits(std::max(need, MIN_SLOT)) -
+          MIN_SLOT_BITS;
+        c = chunk_with_room(sc);
+        index = free_slot(c);
+        if (c->used_count + 1 == c->slot_count)
+          free_lists[sc] = c->next_free;
+      }
+
+      c->used[index / bits::BITS] |= bits::one_at_bit(index % bits::BITS);
+      c->used_count++;
+
+      std::byte* slot = c->base + index * c->slot_size;
+      new (slot) SlotHeader{c, index};
+      Object* o = Object::register_object(slot + SLOT_HEADER_SIZE, desc);
+      o->init_next(nullptr);
+      if (!Object::is_trivial(desc))
+        non_trivial.push(o);
+
+      object_count++;
+      object_bytes += size;
+      return o;
+    }
+
+    /**
+     * Mark `o` live for the collection in progress. Returns true if it was
+     * not marked yet.
+     **/
+    static bool mark(Object* o)
+    {
+      auto [word, bit] = mark_bit(o);
+      size_t w = word.load(std::memory_order_relaxed);
+      if ((w & bit) != 0)
+        return false;
+      word.store(w | bit, std::memory_order_relaxed);
+      return true;
+    }
+
+    /**
+     * As mark(), for collectors that mark from several threads. Exactly one
+     * of the threads marking `o` gets true.
+     **/
+    static bool mark_atomic(Object* o)
+    {
+      auto [word, bit] = mark_bit(o);
+      if ((word.load(std::memory_order_relaxed) & bit) != 0)
+        return false;
+      return (word.fetch_or(bit, std::memory_order_acq_rel) & bit) == 0;
+    }
+
+    static bool is_marked(Object* o)
+    {
+      auto [word, bit] = mark_bit(o);
+      return (word.load(std::memory_order_relaxed) & bit) != 0;
+    }
+
+    /**
+     * Start a collection. This finishes sweeping after the previous one,
+     * which leaves every mark bit clear.
+     **/
+    void begin_collection()
+    {
+      while (unswept != nullptr)
+        sweep_one();
+    }
+
+    /**
+     * Run the finalisers of the non-trivial objects the collection did not
+     * mark.
+     **/
+    void finalise_dead()
+    {
+      ObjectStack dead_isos;
+      non_trivial.forall([&dead_isos](Object* o) {
+        if (!is_marked(o))
+          o->finalise(nullptr, dead_isos);
+      });
+    }
+
+    /**
+     * Finish a collection that marked `live_objects` objects of
+     * `live_bytes` bytes in total: run the destructors of the dead
+     * non-trivial objects and leave the rest of the sweep for later.
+     * Returns the number of non-trivial objects that died.
+     **/
+    size_t end_collection(size_t live_objects, size_t live_bytes)
+    {
+      StackThin<Object> live{};
+      size_t dead = 0;
+      while (!non_trivial.empty())
+      {
+        Object* o = non_trivial.pop();
+        if (is_marked(o))
+        {
+          live.push(o);
+        }
+        else
+        {
+          o->destructor();
+          dead++;
+        }
+      }
+      non_trivial = live;
+
+      // begin_collection() emptied the unswept list, and only swept chunks
+      // are on the free lists.
+      assert(unswept == nullptr);
+      for (auto& list : free_lists)
+        list = nullptr;
+      unswept = swept;
+      unswept_last = swept_last;
+      swept = nullptr;
+      swept_last = nullptr;
+
+      object_count = live_objects;
+      object_bytes = live_bytes;
+      return dead;
+    }
+
+    /**
+     * Run the finalisers of every non-trivial object, as part of releasing
+     * the region whose iso is `region`.
+     **/
+    void finalise_all(Object* region, ObjectStack& collect)
+    {
+      non_trivial.forall(
+        [region, &collect](Object* o) { o->finalise(region, collect); });
+    }
+
+    /**
+     * Run the destructors of every non-trivial object. This empties the side
+     * table.
+     **/
+    void destruct_all()
+    {
+      while (!non_trivial.empty())
+        non_trivial.pop()->destructor();
+    }
+
+    /**
+     * Free every chunk. Destructors must have run already, or the objects
+     * left in the side table have been moved elsewhere, which drops them
+     * from it without running theirs.
+     **/
+    void release()
+    {
+      while (!non_trivial.empty())
+        non_trivial.pop();
+      for (Chunk** list : {&swept, &unswept})
+      {
+        while (*list != nullptr)
+        {
+          Chunk* c = *list;
+          *list = c->next;
+          free_chunk(c);
+        }
+      }
+      swept_last = nullptr;
+      unswept_last = nullptr;
+      for (auto& list : free_lists)
+        list = nullptr;
+      object_count = 0;
+      object_bytes = 0;
+    }
+
+    /**
+     * Take over every object of `that`, which is left empty. Its chunk
+     * lists are spliced onto these, swept or not, so this does not depend
+     * on the number of chunks. Only its side table of non-trivial objects
+     * is copied. Its chunks with a free slot are not offered for
+     * allocation until the next collection has swept them.
+     **/
+    void merge(LargeObjectSpace& that)
+    {
+      splice(swept, swept_last, that.swept, that.swept_last);
+      splice(unswept, unswept_last, that.unswept, that.unswept_last);
+      for (auto& list : that.free_lists)
+        list = nullptr;
+
+      Object* batch[64];
+      while (size_t n = that.non_trivial.pop_n(batch, 64))
+        non_trivial.push_range(batch, n);
+
+      object_count += that.object_count;
+      object_bytes += that.object_bytes;
+      chunk_count += that.chunk_count;
+      chunk_bytes += that.chunk_bytes;
+      that.object_count = 0;
+      that.object_bytes = 0;
+      that.chunk_count = 0;
+      that.chunk_bytes = 0;
+    }
+
+    /// Number of objects live after the last collection, plus those
+    /// allocated since.
+    size_t get_object_count() const
+    {
+      return object_count;
+    }
+
+    size_t get_object_bytes() const
+    {
+      return object_bytes;
+    }
+
+    size_t get_chunk_count() const
+    {
+      return chunk_count;
+    }
+
+    /// Bytes of memory held in chunks, including free slots and slots not
+    /// swept yet.
+    size_t get_chunk_bytes() const
+    {
+      return chunk_bytes;
+    }
+
+    /**
+     * Position of a walk over the live objects; see first() and next().
+     **/
+    struct Cursor
+    {
+      Chunk* chunk = nullptr;
+      size_t index = 0;
+      bool on_unswept = false;
+    };
+
+    /// The first live object, or nullptr if there is none.
+    Object* first(Cursor& cur) const
+    {
+      cur = {swept, 0, false};
+      return find(cur);
+    }
+
+    /// The live object after the one at `cur`, or nullptr.
+    Object* next(Cursor& cur) const
+    {
+      cur.index++;
+      return find(cur);
+    }
+
+  private:
+    static std::pair<std::atomic<size_t>&, size_t> mark_bit(Object* o)
+    {
+      auto* s = (SlotHeader*)(o->real_start() - SLOT_HEADER_SIZE);
+      return {
+        s->chunk->marked[s->index / bits::BITS],
+        bits::one_at_bit(s->index % bits::BITS)};
+    }
+
+    static bool is_live(const Chunk* c, size_t index, bool on_unswept)
+    {
+      size_t w = index / bits::BITS;
+      size_t live = c->used[w];
+      if (on_unswept)
+        live &= c->marked[w].load(std::memory_order_relaxed);
+      return (live & bits::one_at_bit(index % bits::BITS)) != 0;
+    }
+
+    static Object* object_at(const Chunk* c, size_t index)
+    {
+      return Object::object_start(
+        c->base + index * c->slot_size + SLOT_HEADER_SIZE);
+    }
+
+    /// Append the list from `first` to `last` of another space to this one,
+    /// and empty it.
+    static void
+    splice(Chunk*& head, Chunk*& tail, Chunk*& first, Chunk*& last)
+    {
+      if (first == nullptr)
+        return;
+      if (tail == nullptr)
+        head = first;
+      else
+        tail->next = first;
+      tail = last;
+      first = nullptr;
+      last = nullptr;
+    }
+
+    Object* find(Cursor& cur) const
+    {
+      while (true)
+      {
+        if (cur.chunk == nullptr)
+        {
+          if (cur.on_unswept)
+            return nullptr;
+          cur = {unswept, 0, true};
+          continue;
+        }
+
+        for (; cur.index < cur.chunk->slot_count; cur.index++)
+        {
+          if (is_live(cur.chunk, cur.index, cur.on_unswept))
+            return object_at(cur.chunk, cur.index);
+        }
+        cur.chunk = cur.chunk->next;
+        cur.index = 0;
+      }
+    }
+
+    /**
+     * A swept chunk of size class `sc` with a free slot. Sweeps unswept
+     * chunks until one turns up, and only then adds a chunk.
+     **/
+    Chunk* chunk_with_room(size_t sc)
+    {
+      while (free_lists[sc] == nullptr && unswept != nullptr)
+        sweep_one();
+
+      if (free_lists[sc] == nullptr)
+      {
+        bool small = (MIN_SLOT << sc) < PAGE_SIZE;
+        Chunk* c = new_chunk(small ? SMALL_CHUNK_SIZE : CHUNK_SIZE, sc);
+        c->next_free = nullptr;
+        free_lists[sc] = c;
+      }
+      return free_lists[sc];
+    }
+
+    static size_t free_slot(Chunk* c)
+    {
+      for (size_t w = c->first_free_word; w < words(c); w++)
+      {
+        if (c->used[w] != ~(size_t)0)
+        {
+          c->first_free_word = w;
+          size_t index = w * bits::BITS + bits::ctz(~c->used[w]);
+          assert(index < c->slot_count);
+          return index;
+        }
+      }
+      abort();
+    }
+
+    /// Words of the bitmaps of `c` that its slots use.
+    static size_t words(const Chunk* c)
+    {
+      return (c->slot_count + bits::BITS - 1) / bits::BITS;
+    }
+
+    /**
+     * Sweep the first unswept chunk: drop the slots the collection did not
+     * mark, clear the marks, and free the chunk if nothing in it survived.
+     **/
+    void sweep_one()
+    {
+      Chunk* c = unswept;
+      unswept = c->next;
+      if (unswept == nullptr)
+        unswept_last = nullptr;
+
+      size_t count = 0;
+      for (size_t w = 0; w < words(c); w++)
+      {
+        c->used[w] &= c->marked[w].load(std::memory_order_relaxed);
+        c->marked[w].store(0, std::memory_order_relaxed);
+        for (size_t b = c->used[w]; b != 0; b &= b - 1)
+          count++;
+      }
+      c->used_count = count;
+      c->first_free_word = 0;
+
+      if (count == 0)
+      {
+        free_chunk(c);
+        return;
+      }
+
+      push_swept(c);
+      if (count < c->slot_count)
+      {
+        c->next_free = free_lists[c->size_class];
+        free_lists[c->size_class] = c;
+      }
+    }
+
+    /**
+     * Allocate a chunk of `size` bytes for size class `sc` and put it on the
+     * swept list. Heap blocks of whole pages are page aligned.
+     **/
+    Chunk* new_chunk(size_t size, size_t sc)
+    {
+      auto* c = new (heap::alloc<sizeof(Chunk)>()) Chunk();
+      c->base = (std::byte*)heap::alloc(size);
+      assert(((uintptr_t)c->base & (PAGE_SIZE - 1)) == 0);
+      c->size = size;
+      c->size_class = sc;
+      if (sc == SINGLE)
+      {
+        c->slot_size = size;
+        c->slot_count = 1;
+      }
+      else
+      {
+        c->slot_size = MIN_SLOT << sc;
+        c->slot_count = size / c->slot_size;
+      }
+
+      push_swept(c);
+      chunk_count++;
+      chunk_bytes += size;
+      return c;
+    }
+
+    void push_swept(Chunk* c)
+    {
+      c->next = swept;
+      swept = c;
+      if (swept_last == nullptr)
+        swept_last = c;
+    }
+
+    void free_chunk(Chunk* c)
+    {
+      chunk_count--;
+      chunk_bytes -= c->size;
+      heap::dealloc(c->base, c->size);
+      c->~Chunk();
+      heap::dealloc<sizeof(Chunk)>(c);
+    }
+  };
+} // namespace verona::rt
@@ -0,0 +1,193 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include "../ds/heap.h"
+#include "../object/object.h"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace verona::rt
+{
+  using namespace snmalloc;
+
+  /**
+   * A set of marked objects kept out of line, for collectors that must not
+   * write the headers of live objects.
+   *
+   * The address space is split into pages of PAGE_SIZE bytes, and each page
+   * that holds a marked object gets a bitmap with one bit per
+   * Object::ALIGNMENT granule. The pages are found through an open
+   * addressing hash table keyed by page number, with the last page used
+   * cached in front of it, as marking tends to stay within a page.
+   *
+   * A bitmap is meant to live for a single collection: it allocates pages
+   * as objects are marked, and clear() gives them all back.
+   **/
+  class MarkBitmap
+  {
+  public:
+    static constexpr size_t PAGE_SIZE = 64 * 1024;
+
+  private:
+    static constexpr size_t PAGE_BITS = bits::next_pow2_bits_const(PAGE_SIZE);
+    static constexpr size_t GRANULE_BITS =
+      bits::next_pow2_bits_const(Object::ALIGNMENT);
+    static constexpr size_t PAGE_WORDS =
+      (PAGE_SIZE >> GRANULE_BITS) / bits::BITS;
+
+    static constexpr size_t INITIAL_CAPACITY = 16;
+
+    struct Page
+    {
+      uintptr_t number;
+      size_t words[PAGE_WORDS];
+    };
+
+    /// Hash table of pages, with `capacity` slots, at most half of them
+    /// used.
+    Page** table = nullptr;
+    size_t capacity = 0;
+    size_t page_count = 0;
+
+    /// Page of the last lookup.
+    Page* last = nullptr;
+
+  public:
+    MarkBitmap() = default;
+    MarkBitmap(const MarkBitmap&) = delete;
+    MarkBitmap& operator=(const MarkBitmap&) = delete;
+
+    ~MarkBitmap()
+    {
+      clear();
+    }
+
+    /**
+     * Mark `o`. Returns true if it was not marked before.
+     **/
+    bool mark(const Object* o)
+    {
+      uintptr_t a = reinterpret_cast<uintptr_t>(o);
+      Page* p = find_or_add(a >> PAGE_BITS);
+      size_t index = (a & (PAGE_SIZE - 1)) >> GRANULE_BITS;
+      size_t bit = bits::one_at_bit(index % bits::BITS);
+      size_t& word = p->words[index / bits::BITS];
+      if ((word & bit) != 0)
+        return false;
+      word |= bit;
+      return true;
+    }
+
+    bool is_marked(const Object* o)
+    {
+      uintptr_t a = reinterpret_cast<uintptr_t>(o);
+      Page* p = find(a >> PAGE_BITS);
+      if (p == nullptr)
+        return false;
+      size_t index = (a & (PAGE_SIZE - 1)) >> GRANULE_BITS;
+      return (p->words[index / bits::BITS] &
+              bits::one_at_bit(index % bits::BITS)) != 0;
+    }
+
+    /**
+     * Unmark everything and free the pages.
+     **/
+    void clear()
+    {
+      for (size_t i = 0; i < capacity; i++)
+      {
+        if (table[i] != nullptr)
+          heap::dealloc<sizeof(Page)>(table[i]);
+      }
+      if (table != nullptr)
+        heap::dealloc(table, capacity * sizeof(Page*));
+      table = nullptr;
+      capacity = 0;
+      page_count = 0;
+      last = nullptr;
+    }
+
+    /**
+     * Number of pages holding a marked object.
+     **/
+    size_t get_page_count() const
+    {
+      return page_count;
+    }
+
+  private:
+    static size_t hash(uintptr_t number)
+    {
+      return static_cast<size_t>(
+        (static_cast<uint64_t>(number) * 0x9E3779B97F4A7C15ull) >> 32);
+    }
+
+    Page* find(uintptr_t number)
+    {
+      if ((last != nullptr) && (last->number == number))
+        return last;
+
+      if (capacity == 0)
+        return nullptr;
+
+      size_t mask = capacity - 1;
+      for (size_t i = hash(number) & mask;; i = (i + 1) & mask)
+      {
+        Page* p = table[i];
+        if (p == nullptr)
+          return nullptr;
+        if (p->number == number)
+        {
+          last = p;
+          return p;
+        }
+      }
+    }
+
+    Page* find_or_add(uintptr_t number)
+    {
+      Page* p = find(number);
+      if (p != nullptr)
+        return p;
+
+      if (2 * (page_count + 1) > capacity)
+        grow();
+
+      p = (Page*)heap::calloc<sizeof(Page)>();
+      p->number = number;
+      insert(p);
+      page_count++;
+      last = p;
+      return p;
+    }
+
+    void insert(Page* p)
+    {
+      size_t mask = capacity - 1;
+      size_t i = hash(p->number) & mask;
+      while (table[i] != nullptr)
+        i = (i + 1) & mask;
+      table[i] = p;
+    }
+
+    void grow()
+    {
+      Page** old_table = table;
+      size_t old_capacity = capacity;
+
+      capacity = old_capacity == 0 ? INITIAL_CAPACITY : 2 * old_capacity;
+      table = (Page**)heap::calloc(capacity * sizeof(Page*));
+
+      for (size_t i = 0; i < old_capacity; i++)
+      {
+        if (old_table[i] != nullptr)
+          insert(old_table[i]);
+      }
+      if (old_table != nullptr)
+        heap::dealloc(old_table, old_capacity * sizeof(Page*));
+    }
+  };
+} // namespace verona::rt
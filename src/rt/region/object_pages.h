@@ -0,0 +1,467 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include "../object/object.h"
+#include "externalreference.h"
+
+#include <cstddef>
+
+namespace verona::rt
+{
+  using namespace snmalloc;
+
+  /**
+   * Storage for the objects of a trace region, as an alternative to linking
+   * every object into a ring (see RegionTrace::set_paged()).
+   *
+   * Objects that need at most MAX_SLOT bytes share pages of PAGE_SIZE
+   * bytes, each cut into equal slots of one power-of-two size class, and
+   * holding either only trivial or only non-trivial objects. Every class
+   * keeps a free list of the pages that have a slot to spare. Bigger objects
+   * get a page of their own.
+   *
+   * The page metadata sits at the start of the page, and holds a bitmap of
+   * the slots in use and a mark bitmap. The header word of an object, which
+   * a ring would use for the next object, points at its page instead. So
+   * marking an object writes a bit in its page rather than its header, and
+   * sweeping walks each page in address order. A page with no survivors is
+   * freed in one call.
+   *
+   * The root of the region is allocated here as well. Its header names the
+   * region instead of the page, so its page is remembered separately.
+   **/
+  class ObjectPages
+  {
+  public:
+    static constexpr size_t PAGE_SIZE = 64 * 1024;
+
+    /// Largest slot of a shared page. Objects that need more get a page of
+    /// their own.
+    static constexpr size_t MAX_SLOT = PAGE_SIZE / 8;
+
+    /// Smallest slot: an object header and two fields.
+    static constexpr size_t MIN_SLOT = 32;
+
+  private:
+    static constexpr size_t MIN_SLOT_BITS =
+      bits::next_pow2_bits_const(MIN_SLOT);
+
+    /// Size classes MIN_SLOT, 2 * MIN_SLOT, ..., MAX_SLOT.
+    static constexpr size_t NUM_CLASSES =
+      bits::next_pow2_bits_const(MAX_SLOT) - MIN_SLOT_BITS + 1;
+
+    /// Size class of a page that holds a single object.
+    static constexpr size_t SINGLE = NUM_CLASSES;
+
+    static constexpr size_t MAX_SLOTS = PAGE_SIZE / MIN_SLOT;
+    static constexpr size_t BITMAP_WORDS = MAX_SLOTS / bits::BITS;
+
+    struct Page
+    {
+      /// Size of the page, and of its slots, also as a shift for the slot
+      /// index of an object.
+      size_t size;
+      size_t slot_size;
+      size_t slot_shift;
+      size_t slot_count;
+      size_t size_class;
+      bool non_trivial;
+
+      /// Number of bits set in `used`.
+      size_t used_count = 0;
+
+      /// Next page of the region.
+      Page* next = nullptr;
+      /// Next page on the free list of its size class.
+      Page* next_free = nullptr;
+
+      size_t used[BITMAP_WORDS] = {};
+      size_t marked[BITMAP_WORDS] = {};
+
+      std::byte* base()
+      {
+        return (std::byte*)this + HEADER_SIZE;
+      }
+    };
+
+    static constexpr size_t HEADER_SIZE =
+      bits::align_up(sizeof(Page), Object::ALIGNMENT);
+
+    /// Every page of the region.
+    Page* pages = nullptr;
+
+    /// Shared pages with a free slot, per size class, for trivial and for
+    /// non-trivial objects.
+    Page* free_lists[2][NUM_CLASSES] = {};
+
+    /// Page of the root of the region.
+    Page* root_page = nullptr;
+
+    size_t page_count = 0;
+
+  public:
+    /// Objects, non-trivial ones among them, and bytes freed by a sweep.
+    struct SweepStats
+    {
+      size_t objects = 0;
+      size_t non_trivial = 0;
+      size_t bytes = 0;
+    };
+
+    /**
+     * Allocate an object of type `desc` that needs `need` bytes.
+     **/
+    Object* alloc(const Descriptor* desc, size_t need)
+    {
+      bool non_trivial = !Object::is_trivial(desc);
+
+      Page* p;
+      size_t index = 0;
+      if (need > MAX_SLOT)
+      {
+        p = new_page(HEADER_SIZE + need, SINGLE, non_trivial);
+      }
+      else
+      {
+        size_t sc =
+          bits::next_pow2_bits(need < MIN_SLOT ? MIN_SLOT : need) -
+          MIN_SLOT_BITS;
+        Page*& list = free_lists[non_trivial][sc];
+        if (list == nullptr)
+          list = new_page(PAGE_SIZE, sc, non_trivial);
+        p = list;
+        index = free_slot(p);
+        if (p->used_count + 1 == p->slot_count)
+          list = p->next_free;
+      }
+
+      p->used[index / bits::BITS] |= bits::one_at_bit(index % bits::BITS);
+      p->used_count++;
+
+      Object* o = Object::register_object(
+        p->base() + (index << p->slot_shift), desc);
+      o->init_next((Object*)p);
+      return o;
+    }
+
+    /**
+     * Make `o`, which was allocated here, the root of the region. Called
+     * before its header is changed to name the region.
+     **/
+    void set_root(Object* o)
+    {
+      root_page = page_of(o);
+    }
+
+    /**
+     * Make `next` the root instead of `prev`, which becomes an ordinary
+     * object again. Called before the header of `next` is changed.
+     **/
+    void swap_root(Object* prev, Object* next)
+    {
+      Page* p = page_of(next);
+      prev->init_next((Object*)root_page);
+      root_page = p;
+    }
+
+    /**
+     * Take over the pages of `other`, whose root `o` becomes an ordinary
+     * object of this region.
+     **/
+    void merge(Object* o, ObjectPages& other)
+    {
+      o->init_next((Object*)other.root_page);
+
+      while (other.pages != nullptr)
+      {
+        Page* p = other.pages;
+        other.pages = p->next;
+        p->next = pages;
+        pages = p;
+      }
+
+      for (size_t t = 0; t < 2; t++)
+      {
+        for (size_t sc = 0; sc < NUM_CLASSES; sc++)
+        {
+          while (other.free_lists[t][sc] != nullptr)
+          {
+            Page* p = other.free_lists[t][sc];
+            other.free_lists[t][sc] = p->next_free;
+            p->next_free = free_lists[t][sc];
+            free_lists[t][sc] = p;
+          }
+        }
+      }
+
+      page_count += other.page_count;
+      other.page_count = 0;
+      other.root_page = nullptr;
+    }
+
+    /**
+     * Mark `o`, an object of a paged region other than its root, live for
+     * the collection in progress. Returns true if it was not marked yet.
+     **/
+    static bool mark(Object* o)
+    {
+      return mark_in(page_of(o), o);
+    }
+
+    /**
+     * Free the objects of the region with root `region` that the collection
+     * did not mark, and clear the marks. The root is always live. The isos
+     * of subregions the finalisers find are added to `collect`, and dead
+     * objects are dropped from the region's table `ext`.
+     **/
+    SweepStats
+    sweep(Object* region, ObjectStack& collect, ExternalReferenceTable& ext)
+    {
+      mark_in(root_page, region);
+
+      // All finalisers run before any destructor, as they may look at
+      // other dead objects.
+      for_each_dead([region, &collect](Page* p, Object* o) {
+        if (p->non_trivial)
+          o->finalise(region, collect);
+      });
+
+      SweepStats dead;
+      for_each_dead([&dead, &ext](Page* p, Object* o) {
+        Logging::cout() << "Sweep " << o << Logging::endl;
+        if (o->has_ext_ref())
+          ext.erase(o);
+        dead.objects++;
+        dead.bytes += o->size();
+        if (p->non_trivial)
+        {
+          dead.non_trivial++;
+          o->destructor();
+        }
+      });
+
+      for (auto& lists : free_lists)
+      {
+        for (auto& list : lists)
+          list = nullptr;
+      }
+
+      Page** link = &pages;
+      while (*link != nullptr)
+      {
+        Page* p = *link;
+        size_t count = 0;
+        for (size_t w = 0; w < BITMAP_WORDS; w++)
+        {
+          p->used[w] &= p->marked[w];
+          p->marked[w] = 0;
+          for (size_t b = p->used[w]; b != 0; b &= b - 1)
+            count++;
+        }
+        p->used_count = count;
+
+        if (count == 0)
+        {
+          *link = p->next;
+          free_page(p);
+          continue;
+        }
+
+        if (count < p->slot_count)
+        {
+          Page*& list = free_lists[p->non_trivial][p->size_class];
+          p->next_free = list;
+          list = p;
+        }
+        link = &p->next;
+      }
+      return dead;
+    }
+
+    /**
+     * Finalise and destroy every object, as part of releasing the region
+     * with root `region`, and free every page.
+     **/
+    void
+    release(Object* region, ObjectStack& collect, ExternalReferenceTable& ext)
+    {
+      for_each_used([region, &collect](Page* p, Object* o) {
+        if (p->non_trivial)
+          o->finalise(region, collect);
+      });
+
+      for_each_used([&ext](Page* p, Object* o) {
+        if (o->has_ext_ref())
+          ext.erase(o);
+        if (p->non_trivial)
+          o->destructor();
+      });
+
+      while (pages != nullptr)
+      {
+        Page* p = pages;
+        pages = p->next;
+        free_page(p);
+      }
+      for (auto& lists : free_lists)
+      {
+        for (auto& list : lists)
+          list = nullptr;
+      }
+      root_page = nullptr;
+    }
+
+    size_t get_page_count() const
+    {
+      return page_count;
+    }
+
+    /**
+     * Position of a walk over the objects; see first() and next().
+     **/
+    struct Cursor
+    {
+      Page* page = nullptr;
+      size_t index = 0;
+      bool trivial = true;
+      bool non_trivial = true;
+    };
+
+    /// The first object, only counting trivial or non-trivial ones as
+    /// asked, or nullptr if there is none.
+    Object* first(Cursor& cur, bool trivial, bool non_trivial) const
+    {
+      cur = {pages, 0, trivial, non_trivial};
+      return find(cur);
+    }
+
+    /// The object after the one at `cur`, or nullptr.
+    Object* next(Cursor& cur) const
+    {
+      cur.index++;
+      return find(cur);
+    }
+
+  private:
+    static Page* page_of(Object* o)
+    {
+      return (Page*)o->get_next();
+    }
+
+    static bool mark_in(Page* p, Object* o)
+    {
+      size_t index = (size_t)(o->real_start() - p->base()) >> p->slot_shift;
+      size_t& word = p->marked[index / bits::BITS];
+      size_t bit = bits::one_at_bit(index % bits::BITS);
+      if ((word & bit) != 0)
+        return false;
+      word |= bit;
+      return true;
+    }
+
+    static Object* object_at(Page* p, size_t index)
+    {
+      return Object::object_start(p->base() + (index << p->slot_shift));
+    }
+
+    Object* find(Cursor& cur) const
+    {
+      for (; cur.page != nullptr; cur.page = cur.page->next, cur.index = 0)
+      {
+        if (cur.page->non_trivial ? !cur.non_trivial : !cur.trivial)
+          continue;
+
+        for (; cur.index < cur.page->slot_count; cur.index++)
+        {
+          size_t w = cur.page->used[cur.index / bits::BITS];
+          if ((w & bits::one_at_bit(cur.index % bits::BITS)) != 0)
+            return object_at(cur.page, cur.index);
+        }
+      }
+      return nullptr;
+    }
+
+    /// Apply `f` to the page and object of every slot in use.
+    template<typename F>
+    void for_each_used(F f)
+    {
+      for (Page* p = pages; p != nullptr; p = p->next)
+      {
+        for (size_t w = 0; w < BITMAP_WORDS; w++)
+        {
+          for (size_t b = p->used[w]; b != 0; b &= b - 1)
+            f(p, object_at(p, w * bits::BITS + bits::ctz(b)));
+        }
+      }
+    }
+
+    /// Apply `f` to the page and object of every slot in use but not
+    /// marked.
+    template<typename F>
+    void for_each_dead(F f)
+    {
+      for (Page* p = pages; p != nullptr; p = p->next)
+      {
+        for (size_t w = 0; w < BITMAP_WORDS; w++)
+        {
+          for (size_t b = p->used[w] & ~p->marked[w]; b != 0; b &= b - 1)
+            f(p, object_at(p, w * bits::BITS + bits::ctz(b)));
+        }
+      }
+    }
+
+    static size_t free_slot(const Page* p)
+    {
+      for (size_t w = 0; w < BITMAP_WORDS; w++)
+      {
+        if (p->used[w] != ~(size_t)0)
+        {
+          size_t index = w * bits::BITS + bits::ctz(~p->used[w]);
+          assert(index < p->slot_count);
+          return index;
+        }
+      }
+      abort();
+    }
+
+    /**
+     * Allocate a page of `size` bytes for size class `sc`, holding trivial
+     * or non-trivial objects, and add it to the region.
+     **/
+    Page* new_page(size_t size, size_t sc, bool non_trivial)
+    {
+      auto* p = new (heap::alloc(size)) Page();
+      p->size = size;
+      p->size_class = sc;
+      p->non_trivial = non_trivial;
+      if (sc == SINGLE)
+      {
+        p->slot_size = size - HEADER_SIZE;
+        p->slot_shift = 0;
+        p->slot_count = 1;
+      }
+      else
+      {
+        p->slot_shift = MIN_SLOT_BITS + sc;
+        p->slot_size = (size_t)1 << p->slot_shift;
+        p->slot_count = (size - HEADER_SIZE) >> p->slot_shift;
+        assert(p->slot_count <= MAX_SLOTS);
+      }
+
+      p->next = pages;
+      pages = p;
+      page_count++;
+      return p;
+    }
+
+    void free_page(Page* p)
+    {
+      page_count--;
+      size_t size = p->size;
+      p->~Page();
+      heap::dealloc(p, size);
+    }
+  };
+} // namespace verona::rt
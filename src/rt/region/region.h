@@ -2,15 +2,25 @@
 // SPDX-License-Identifier: MIT
 #pragma once
 
+#include "../ds/hashmap.h"
 #include "../object/object.h"
+#include "../util/live_metrics.h"
+#include "gc_events.h"
 #include "region_arena.h"
 #include "region_base.h"
+#include "region_bytes.h"
+#include "region_compact.h"
+#include "region_generational.h"
 #include "region_rc.h"
 #include "region_semispace.h"
 #include "region_trace.h"
-#ifdef ENABLE_BENCHMARKING
-#include <test/measuretime.h>
-#endif
+
+#include <cstring>
+#include <iterator>
+#include <mutex>
+#include <tuple>
+#include <utility>
+#include <vector>
 
 namespace verona::rt
 {
@@ -103,60 +113,236 @@ namespace verona::rt
     using T = RegionSemiSpace;
   };
 
+  template<>
+  struct RegionType_to_class<RegionType::Generational>
+  {
+    using T = RegionGenerational;
+  };
+
+  template<>
+  struct RegionType_to_class<RegionType::Compact>
+  {
+    using T = RegionCompact;
+  };
+
+  template<>
+  struct RegionType_to_class<RegionType::Bytes>
+  {
+    using T = RegionBytes;
+  };
+
   /**
-   * Helper to capture stats, run an action, and report metrics.
-   * When ENABLE_BENCHMARKING is off, just executes the action directly.
+   * Memory used by the region `r`, and its number of objects.
    */
-  template<typename Action>
-  inline void with_region_stats(
-    [[maybe_unused]] RegionBase* r,
-    [[maybe_unused]] const char* op_name,
-    Action&& action)
+  inline std::pair<size_t, size_t> region_usage(RegionBase* r)
   {
-#ifdef ENABLE_BENCHMARKING
-    RegionType type;
-    if (RegionTrace::is_trace_region(r))
-      type = RegionType::Trace;
-    else if (RegionArena::is_arena_region(r))
-      type = RegionType::Arena;
-    else if (RegionRc::is_rc_region(r))
-      type = RegionType::Rc;
-    else if (RegionSemiSpace::is_semispace_region(r))
-      type = RegionType::SemiSpace;
-    else
-      abort();
+    switch (r->region_type)
+    {
+      case RegionType::Trace:
+        return {
+          ((RegionTrace*)r)->get_current_memory_used(),
+          ((RegionTrace*)r)->get_region_size()};
+      case RegionType::Arena:
+        return {
+          ((RegionArena*)r)->get_current_memory_used(),
+          ((RegionArena*)r)->get_region_size()};
+      case RegionType::Rc:
+        return {
+          ((RegionRc*)r)->get_current_memory_used(),
+          ((RegionRc*)r)->get_region_size()};
+      case RegionType::SemiSpace:
+        return {
+          ((RegionSemiSpace*)r)->get_current_memory_used(),
+          ((RegionSemiSpace*)r)->get_region_size()};
+      case RegionType::Generational:
+        return {
+          ((RegionGenerational*)r)->get_current_memory_used(),
+          ((RegionGenerational*)r)->get_region_size()};
+      case RegionType::Compact:
+        return {
+          ((RegionCompact*)r)->get_current_memory_used(),
+          ((RegionCompact*)r)->get_region_size()};
+      case RegionType::Bytes:
+        return {
+          ((RegionBytes*)r)->get_current_memory_used(),
+          ((RegionBytes*)r)->get_region_size()};
+    }
+    return {0, 0};
+  }
 
-    // Capture memory stats before operation
-    size_t mem_before = 0;
-    size_t obj_before = 0;
-    switch (type)
+  /**
+   * Counters of a region that it keeps up to date as it changes, so that
+   * reading them costs the same whatever the size of the region (see
+   * api::region_stats()).
+   *
+   *  - `objects` and `bytes` are those of region_usage().
+   *  - `trivial` and `non_trivial` split `objects` by whether they have a
+   *    finaliser or destructor to run.
+   *  - `remembered` is the number of immutables and cowns it references.
+   *  - `external_refs` is the number of its objects with an external
+   *    reference.
+   *  - `chunks` is the number of blocks of memory its objects share: the
+   *    pages of a paged Trace region, the arenas of an Arena region, the
+   *    from-space, adopted spaces and large object chunks of a SemiSpace
+   *    region, the nursery halves of a Generational region, and the space
+   *    or buffer of a Compact or Bytes region. Objects allocated on their
+   *    own, as in an Rc region, are not counted.
+   */
+  struct RegionStats
+  {
+    size_t objects = 0;
+    size_t bytes = 0;
+    size_t trivial = 0;
+    size_t non_trivial = 0;
+    size_t remembered = 0;
+    size_t external_refs = 0;
+    size_t chunks = 0;
+  };
+
+  inline RegionStats region_stats(RegionBase* r)
+  {
+    RegionStats stats;
+    std::tie(stats.bytes, stats.objects) = region_usage(r);
+    stats.remembered = r->remembered_size();
+    stats.external_refs = r->ExternalReferenceTable::size();
+    switch (r->region_type)
     {
       case RegionType::Trace:
-        mem_before = ((RegionTrace*)r)->get_current_memory_used();
-        obj_before = ((RegionTrace*)r)->get_region_size();
+        stats.non_trivial = ((RegionTrace*)r)->get_non_trivial_size();
+        stats.chunks = ((RegionTrace*)r)->get_page_count();
         break;
       case RegionType::Arena:
-        mem_before = ((RegionArena*)r)->get_current_memory_used();
-        obj_before = ((RegionArena*)r)->get_region_size();
+        stats.non_trivial = ((RegionArena*)r)->get_non_trivial_size();
+        stats.chunks = ((RegionArena*)r)->get_arena_count();
         break;
       case RegionType::Rc:
-        mem_before = ((RegionRc*)r)->get_current_memory_used();
-        obj_before = ((RegionRc*)r)->get_region_size();
+        stats.non_trivial = ((RegionRc*)r)->get_non_trivial_size();
         break;
       case RegionType::SemiSpace:
-        mem_before = ((RegionSemiSpace*)r)->get_current_memory_used();
-        obj_before = ((RegionSemiSpace*)r)->get_region_size();
+        stats.non_trivial = ((RegionSemiSpace*)r)->get_non_trivial_size();
+        stats.chunks = ((RegionSemiSpace*)r)->get_chunk_count();
+        break;
+      case RegionType::Generational:
+        stats.non_trivial = ((RegionGenerational*)r)->get_non_trivial_size();
+        stats.chunks = 2;
+        break;
+      case RegionType::Compact:
+        stats.non_trivial = ((RegionCompact*)r)->get_non_trivial_size();
+        stats.chunks = 1;
+        break;
+      case RegionType::Bytes:
+        stats.non_trivial = ((RegionBytes*)r)->get_non_trivial_size();
+        stats.chunks = 1;
         break;
     }
+    stats.trivial = stats.objects - stats.non_trivial;
+    return stats;
+  }
 
-    MeasureTime m(true);
+  /**
+   * The allocation sites of the region `r` (see AllocSites), or nullptr if
+   * it keeps none: it is not a SemiSpace or Generational region, or it has
+   * not allocated while pretenuring was on.
+   */
+  inline const AllocSites* region_alloc_sites(RegionBase* r)
+  {
+    switch (r->region_type)
+    {
+      case RegionType::SemiSpace:
+        return ((RegionSemiSpace*)r)->get_alloc_sites();
+      case RegionType::Generational:
+        return ((RegionGenerational*)r)->get_alloc_sites();
+      case RegionType::Trace:
+      case RegionType::Arena:
+      case RegionType::Rc:
+      case RegionType::Compact:
+      case RegionType::Bytes:
+        break;
+    }
+    return nullptr;
+  }
+
+  /**
+   * Helper to capture stats, run an action, and report metrics.
+   * When ENABLE_BENCHMARKING is off, just executes the action directly,
+   * timing it for LiveMetrics if a segment is open.
+   *
+   * The action is timed with two TickClock reads, and the event goes to
+   * the thread's gc_sink, or else its gc_callback, or else GCEventSink.
+   * The time spent here around the action is reported in the event too.
+   *
+   * `releases` says that the action deallocates `r`, so that its state is
+   * not read afterwards.
+   */
+  template<typename Action>
+  inline void with_region_stats(
+    [[maybe_unused]] RegionBase* r,
+    [[maybe_unused]] const char* op_name,
+    Action&& action,
+    [[maybe_unused]] bool releases = false)
+  {
+#ifdef ENABLE_BENCHMARKING
+    uint64_t entered = TickClock::ticks();
+    RegionType type = r->region_type;
+
+    // Capture memory stats before operation
+    auto [mem_before, obj_before] = region_usage(r);
+
+    bool counting = PerfCounters::is_enabled();
+    PerfCounters::Values counters_before;
+    if (counting)
+      counters_before = PerfCounters::read_thread();
+    GCPhases::Totals phases_before = GCPhases::read();
+
+    uint64_t start = TickClock::ticks();
     action();
-    uint64_t duration_ns = m.get_time().count();
+    uint64_t end = TickClock::ticks();
+    uint64_t duration_ns = TickClock::to_ns(end - start);
+
+    GCPhases::Totals phases_after = GCPhases::read();
+    PerfCounters::Values counters;
+    if (counting)
+      counters = PerfCounters::read_thread() - counters_before;
+
+    GCEvent e{};
+    e.duration_ns = duration_ns;
+    e.type = type;
+    e.memory_before = mem_before;
+    e.objects_before = obj_before;
+    e.start_ns = TickClock::timestamp_ns(start);
+    e.counters = counters;
+    for (size_t p = 0; p < GCPhases::COUNT; p++)
+      e.phase_ns[p] = phases_after.ns[p] - phases_before.ns[p];
+    e.bytes_copied = phases_after.bytes_copied - phases_before.bytes_copied;
+    e.bytes_freed = mem_before;
+    e.released = releases;
+    if (!releases)
+    {
+      auto [mem_after, obj_after] = region_usage(r);
+      e.bytes_freed = mem_before > mem_after ? mem_before - mem_after : 0;
+      e.memory_after = mem_after;
+      e.objects_survived = obj_after;
+      e.remembered_set_size = r->remembered_size();
+    }
+
+    LiveMetrics::collected((size_t)type, duration_ns, e.bytes_freed);
+
+    // Time spent reporting is left out, as it depends on the sink.
+    e.harness_ns =
+      TickClock::to_ns((start - entered) + (TickClock::ticks() - end));
 
-    // Report via callback if set
-    if (get_gc_callback() != nullptr)
+    // Report to the sink or callback if set, or to the process-wide sink
+    if (get_gc_sink() != nullptr)
+    {
+      get_gc_sink()(e);
+    }
+    else if (get_gc_callback() != nullptr)
     {
-      (*get_gc_callback())(duration_ns, type, mem_before, obj_before);
+      (*get_gc_callback())(e);
+    }
+    else if (GCEventSink::is_enabled())
+    {
+      GCEventSink::record(e);
     }
     else
     {
@@ -164,7 +350,20 @@ namespace verona::rt
                       << Logging::endl;
     }
 #else
+    if (!LiveMetrics::is_open())
+    {
+      action();
+      return;
+    }
+
+    RegionType type = r->region_type;
+    size_t before = region_usage(r).first;
+    uint64_t start = TickClock::ticks();
     action();
+    uint64_t duration_ns = TickClock::to_ns(TickClock::ticks() - start);
+    size_t after = releases ? 0 : region_usage(r).first;
+    LiveMetrics::collected(
+      (size_t)type, duration_ns, before > after ? before - after : 0);
 #endif // ENABLE_BENCHMARKING
   }
 
@@ -175,9 +374,20 @@ namespace verona::rt
     Region() = delete;
 
     /**
-     * Returns the type of region represented by the Iso object `o`.
+     * Returns the type of the region whose metadata object is `o`.
      **/
     static RegionType get_type(Object* o)
+    {
+      RegionType type = ((RegionBase*)o)->region_type;
+      assert(type == probe_type(o));
+      return type;
+    }
+
+    /**
+     * Returns the type of the region whose metadata object is `o`, from its
+     * descriptor.
+     **/
+    static RegionType probe_type(Object* o)
     {
       if (RegionTrace::is_trace_region(o))
         return RegionType::Trace;
@@ -187,6 +397,12 @@ namespace verona::rt
         return RegionType::Rc;
       else if (RegionSemiSpace::is_semispace_region(o))
         return RegionType::SemiSpace;
+      else if (RegionGenerational::is_generational_region(o))
+        return RegionType::Generational;
+      else if (RegionCompact::is_compact_region(o))
+        return RegionType::Compact;
+      else if (RegionBytes::is_bytes_region(o))
+        return RegionType::Bytes;
 
       abort();
     }
@@ -198,16 +414,210 @@ namespace verona::rt
      * worklist.
      **/
     static void release(Object* o)
+    {
+      if (send_home(o))
+        return;
+
+      release_here(o);
+    }
+
+    /**
+     * As release(), but always on the calling thread.
+     **/
+    static void release_here(Object* o)
     {
       assert(o->debug_is_iso() || o->is_opened());
       ObjectStack collect;
       Region::release_internal(o, collect);
+      release_collected(collect);
+    }
 
-      while (!collect.empty())
+    /**
+     * Takes over the release of the region of `o` on `home`, the
+     * RegionBase::local_home() it was created on, later calling
+     * release_here(). Returns false if it cannot.
+     **/
+    using ReleaseHomeFn = bool (*)(void* home, Object* o);
+
+    /**
+     * Send the release of a region of at least `bytes` of memory that is
+     * released on a scheduler thread other than the one it was created
+     * on back to that thread's core, through the function the scheduler
+     * sets (see set_release_home()), so that its memory goes back to the
+     * allocator it came from on that core, rather than through the
+     * allocator's remote deallocation queues. 0, the default, releases
+     * every region where it is released.
+     **/
+    static void set_release_home_threshold(size_t bytes)
+    {
+      release_home_threshold_.store(bytes, std::memory_order_relaxed);
+    }
+
+    static size_t get_release_home_threshold()
+    {
+      return release_home_threshold_.load(std::memory_order_relaxed);
+    }
+
+    static void set_release_home(ReleaseHomeFn fn)
+    {
+      release_home_.store(fn, std::memory_order_relaxed);
+    }
+
+    /// Regions released on a scheduler thread other than their home one,
+    /// whether or not the release was then sent home.
+    static size_t get_remote_releases()
+    {
+      return remote_releases_.load(std::memory_order_relaxed);
+    }
+
+    /// Releases sent home (see set_release_home_threshold()).
+    static size_t get_home_releases()
+    {
+      return home_releases_.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Schedules up to `count` calls of `help(job)` on other scheduler
+     * threads, and returns how many it scheduled.
+     **/
+    using ReleaseHelpersFn =
+      size_t (*)(size_t count, void (*help)(void* job), void* job);
+
+    /**
+     * Release the subregions found by a release or a collection in
+     * parallel once there are at least `subregions` of them. The Isos are
+     * shared with helpers on other scheduler threads, through the function
+     * the scheduler sets (see set_release_helpers()), and each releases
+     * one at a time, sharing in turn the subregions that one holds. The
+     * releasing thread takes part, and returns once all of them are
+     * released. Finalisers of different subregions then run concurrently.
+     * 0, the default, releases them all on the releasing thread.
+     **/
+    static void set_parallel_release(size_t subregions)
+    {
+      parallel_release_.store(subregions, std::memory_order_relaxed);
+    }
+
+    static size_t get_parallel_release()
+    {
+      return parallel_release_.load(std::memory_order_relaxed);
+    }
+
+    static void set_release_helpers(ReleaseHelpersFn fn)
+    {
+      release_helpers_.store(fn, std::memory_order_relaxed);
+    }
+
+    /// Subregions released by helpers (see set_parallel_release()).
+    static size_t get_helped_releases()
+    {
+      return helped_releases_.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Release and deallocate the region represented by Iso object `o`, but
+     * not the regions it holds, whose Isos are added to `collect` for the
+     * caller to release.
+     **/
+    static void release_shallow(Object* o, ObjectStack& collect)
+    {
+      assert(o->debug_is_iso());
+      Region::release_internal(o, collect);
+    }
+
+    /**
+     * Drop every object of the region represented by Iso object `o`, except
+     * `o` itself, and keep the region for reuse. Only Arena regions support
+     * this. `o` must still be the object the region was created with.
+     *
+     * Fields of `o` that pointed into the region are left dangling.
+     **/
+    static void reset(Object* o)
+    {
+      auto r = get(o);
+      if (Region::get_type(r) != RegionType::Arena)
+        abort();
+
+      ObjectStack collect;
+      ((RegionArena*)r)->reset_internal(o, collect);
+      release_collected(collect);
+    }
+
+    /**
+     * Drop every object allocated in the region represented by Iso object
+     * `o` since the savepoint `sp` was taken with RegionArena::mark(). Only
+     * Arena regions support this. `o` must be older than `sp`.
+     *
+     * Fields of older objects that pointed to dropped ones are left
+     * dangling.
+     **/
+    static void rewind_to(Object* o, const RegionArena::Savepoint& sp)
+    {
+      auto r = get(o);
+      if (Region::get_type(r) != RegionType::Arena)
+        abort();
+
+      ObjectStack collect;
+      ((RegionArena*)r)->rewind_internal(o, sp, collect);
+      release_collected(collect);
+    }
+
+    /**
+     * Convert the region represented by Iso object `o`, of type `From`, to
+     * a region of type `To`, with the same objects, and return its Iso.
+     * Only Arena regions can be converted, to Trace regions, for an arena
+     * that has turned out to be long lived.
+     *
+     * The conversion collects the region as it goes: objects unreachable
+     * from `o` are finalised and freed, and the regions they own are added
+     * to `collect`, for the caller to release. The survivors in arenas are
+     * copied out to objects of their own and their fields rewritten, as an
+     * Arena collection evacuates them. Large objects keep their addresses,
+     * and so does `o` if it is one, or if the region is collectable, as its
+     * Iso is pinned; otherwise `o` moves too. External references follow
+     * their objects, and the remembered set, GC policy and quota carry
+     * over. To convert the open region, use api::region_convert().
+     **/
+    template<RegionType From, RegionType To>
+    static Object* convert(Object* o, ObjectStack& collect)
+    {
+      static_assert(
+        From == RegionType::Arena && To == RegionType::Trace,
+        "only Arena regions can be converted, to Trace regions");
+      assert(o->debug_is_iso());
+      return arena_to_trace(o, collect);
+    }
+
+    /**
+     * Return the Iso of a copy of the region represented by Iso object `o`,
+     * of the same type, holding a copy of each object reachable from `o`.
+     * Only Trace, Arena and SemiSpace regions can be cloned.
+     *
+     * The regions the objects own are cloned too, so that each region has
+     * a single owner, and the immutable and shared objects they refer to
+     * are shared, entering the clone's remembered set. External references
+     * are not cloned, nor are unreachable objects. An Arena clone is
+     * created as create() would now create one.
+     *
+     * Objects are copied bytewise, and their fields rewritten to point at
+     * the copies as a moving collection rewrites them, through a pointer
+     * map, Descriptor::relocate, or else a scan of the body. So objects
+     * must be able to move, as they must in regions whose collector moves
+     * them: a field that is not rewritten keeps pointing into `o`'s region.
+     **/
+    static Object* clone(Object* o)
+    {
+      assert(o->debug_is_iso());
+      switch (Region::get_type(o->get_region()))
       {
-        o = collect.pop();
-        assert(o->debug_is_iso());
-        Region::release_internal(o, collect);
+        case RegionType::Trace:
+          return clone_as<RegionTrace>(o);
+        case RegionType::Arena:
+          return clone_as<RegionArena>(o);
+        case RegionType::SemiSpace:
+          return clone_as<RegionSemiSpace>(o);
+        default:
+          abort();
       }
     }
 
@@ -223,40 +633,506 @@ namespace verona::rt
       return o->get_region();
     }
 
-  private:
     /**
-     * Internal method for releasing and deallocating regions, that takes
-     * a worklist (represented by `f` and `collect`).
-     *
-     * We dispatch based on the type of region represented by `o`.
+     * Returns the bytes of memory currently used by the region `r`.
      **/
-    static void release_internal(Object* o, ObjectStack& collect)
+    static size_t get_memory_used(RegionBase* r)
     {
-      auto r = o->get_region();
       switch (Region::get_type(r))
       {
         case RegionType::Trace:
-          ((RegionTrace*)r)->release_internal(o, collect);
-          return;
+          return ((RegionTrace*)r)->get_current_memory_used();
         case RegionType::Arena:
-          ((RegionArena*)r)->release_internal(o, collect);
-          return;
+          return ((RegionArena*)r)->get_current_memory_used();
         case RegionType::Rc:
-        {
-          ((RegionRc*)r)->release_internal(o, collect);
-          return;
-        }
+          return ((RegionRc*)r)->get_current_memory_used();
         case RegionType::SemiSpace:
-          ((RegionSemiSpace*)r)->release_internal(o, collect);
-          return;
+          return ((RegionSemiSpace*)r)->get_current_memory_used();
+        case RegionType::Generational:
+          return ((RegionGenerational*)r)->get_current_memory_used();
+        case RegionType::Compact:
+          return ((RegionCompact*)r)->get_current_memory_used();
+        case RegionType::Bytes:
+          return ((RegionBytes*)r)->get_current_memory_used();
         default:
           abort();
       }
     }
+
+    /**
+     * Release the regions whose Isos are in `collect`, and any found while
+     * doing so.
+     **/
+    static void release_collected(ObjectStack& collect)
+    {
+      if (!collect.empty() && release_in_parallel(collect))
+        return;
+
+      while (!collect.empty())
+      {
+        Object* o = collect.pop();
+        assert(o->debug_is_iso());
+        Logging::cout() << "Region release: releasing subregion: " << o
+                        << Logging::endl;
+        Region::release_internal(o, collect);
+      }
+    }
+
+  private:
+    static inline std::atomic<size_t> release_home_threshold_{0};
+    static inline std::atomic<ReleaseHomeFn> release_home_{nullptr};
+    static inline std::atomic<size_t> remote_releases_{0};
+    static inline std::atomic<size_t> home_releases_{0};
+    static inline std::atomic<size_t> parallel_release_{0};
+    static inline std::atomic<ReleaseHelpersFn> release_helpers_{nullptr};
+    static inline std::atomic<size_t> helped_releases_{0};
+
+    /**
+     * Subregions that one release_collected() shares with its helpers.
+     * `pending` holds the Isos not yet taken, and `active` counts the
+     * threads releasing one; both are guarded by `m`. The releasing thread
+     * and each helper hold a reference, and the last to drop it frees the
+     * job, as helpers may start after the release is over.
+     **/
+    struct ReleaseJob
+    {
+      std::mutex m;
+      std::vector<Object*> pending;
+      size_t active = 0;
+      std::atomic<size_t> refs{1};
+
+      void drop()
+      {
+        if (refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+          delete this;
+      }
+    };
+
+    /**
+     * Take an Iso from `job` and release its region, adding the Isos of
+     * the regions it held to `job`. Returns false if there was none.
+     **/
+    static bool release_one(ReleaseJob* job)
+    {
+      Object* o;
+      {
+        std::lock_guard<std::mutex> l(job->m);
+        if (job->pending.empty())
+          return false;
+        o = job->pending.back();
+        job->pending.pop_back();
+        job->active++;
+      }
+
+      Logging::cout() << "Region release: releasing subregion: " << o
+                      << Logging::endl;
+      ObjectStack found;
+      Region::release_internal(o, found);
+
+      std::lock_guard<std::mutex> l(job->m);
+      while (!found.empty())
+        job->pending.push_back(found.pop());
+      job->active--;
+      return true;
+    }
+
+    static void help_release(void* p)
+    {
+      auto* job = static_cast<ReleaseJob*>(p);
+      while (release_one(job))
+        helped_releases_.fetch_add(1, std::memory_order_relaxed);
+      job->drop();
+    }
+
+    /**
+     * Release the regions whose Isos are in `collect` with helpers, as
+     * set_parallel_release() says. Returns false, leaving `collect` as it
+     * was, if they are to be released on this thread alone.
+     **/
+    static bool release_in_parallel(ObjectStack& collect)
+    {
+      size_t threshold = get_parallel_release();
+      auto fn = release_helpers_.load(std::memory_order_relaxed);
+      if ((threshold == 0) || (fn == nullptr))
+        return false;
+
+      auto* job = new ReleaseJob;
+      while (!collect.empty())
+        job->pending.push_back(collect.pop());
+
+      size_t count = job->pending.size();
+      if (count < threshold)
+      {
+        for (size_t i = count; i > 0; i--)
+          collect.push(job->pending[i - 1]);
+        delete job;
+        return false;
+      }
+
+      // Each helper holds a reference from before it is scheduled.
+      job->refs.fetch_add(count - 1, std::memory_order_relaxed);
+      size_t helpers = fn(count - 1, &help_release, job);
+      job->refs.fetch_sub(count - 1 - helpers, std::memory_order_acq_rel);
+
+      // Help until nothing is left, then wait for the helpers still
+      // releasing, as they may yet find more.
+      while (true)
+      {
+        if (release_one(job))
+          continue;
+
+        {
+          std::lock_guard<std::mutex> l(job->m);
+          if ((job->active == 0) && job->pending.empty())
+            break;
+        }
+        Systematic::yield();
+        snmalloc::Aal::pause();
+      }
+
+      job->drop();
+      return true;
+    }
+
+    /**
+     * Send the release of `o` home, as set_release_home_threshold() says.
+     * Returns false if it is to be released here.
+     **/
+    static bool send_home(Object* o)
+    {
+      void* here = RegionBase::local_home();
+      void* home = o->get_region()->home;
+      if ((here == nullptr) || (home == nullptr) || (home == here))
+        return false;
+
+      remote_releases_.fetch_add(1, std::memory_order_relaxed);
+      size_t threshold = get_release_home_threshold();
+      if ((threshold == 0) || (get_memory_used(o->get_region()) < threshold))
+        return false;
+
+      auto fn = release_home_.load(std::memory_order_relaxed);
+      if ((fn == nullptr) || !fn(home, o))
+        return false;
+
+      home_releases_.fetch_add(1, std::memory_order_relaxed);
+      return true;
+    }
+
+    /**
+     * convert() from an Arena region to a Trace region.
+     *
+     * Algorithm:
+     *   1. Mark everything reachable from the Iso, and take the arenas out
+     *      of the region.
+     *   2. Finalise, then destruct, the dead non-trivial objects, and drop
+     *      the external references to dead objects.
+     *   3. Put the Iso in a new Trace region, copying it out of its arena if
+     *      it is in one.
+     *   4. Move the large survivors to the Trace region, and free the dead
+     *      large objects.
+     *   5. Copy each survivor in an arena to an object of its own in the
+     *      Trace region, leaving a forwarding pointer behind.
+     *   6. Point the fields of every object of the Trace region at the new
+     *      addresses.
+     *   7. Hand over the external references and the remembered set, and
+     *      free the arenas and the Arena region.
+     **/
+    static Object* arena_to_trace(Object* o, ObjectStack& collect)
+    {
+      using Arena = RegionArena::Arena;
+      RegionArena* from = RegionArena::get(o);
+
+      Logging::cout() << "Region convert: arena to trace: " << o
+                      << Logging::endl;
+
+      // Phase 1: Mark, and take the arenas out, in address order, as the
+      // forward callback expects.
+      size_t live_bytes = 0;
+      size_t live_objects = 0;
+      size_t live_non_trivial = 0;
+      from->mark_live(o, live_bytes, live_objects, live_non_trivial);
+
+      size_t chunk_bytes = 0;
+      size_t wasted_bytes = from->get_wasted_bytes();
+      from->clear_partial();
+      std::vector<Arena*> arenas;
+      for (Arena* a = from->first_arena; a != nullptr; a = a->next)
+      {
+        chunk_bytes += a->chunk_size();
+        arenas.push_back(a);
+      }
+      from->first_arena = nullptr;
+      from->last_arena = nullptr;
+      std::sort(arenas.begin(), arenas.end());
+
+      // Phase 2: As in a collection, all finalisers run before any
+      // destructor.
+      from->for_each_dead<RegionBase::NonTrivial>(
+        arenas, [o, &collect](Object* p) { p->finalise(o, collect); });
+      from->for_each_dead<RegionBase::NonTrivial>(
+        arenas, [](Object* p) { p->destructor(); });
+
+      if (!from->ExternalReferenceTable::is_empty())
+      {
+        from->for_each_dead<RegionBase::AllObjects>(arenas, [from](Object* p) {
+          if (p->has_ext_ref())
+          {
+            from->ExternalReferenceTable::erase(p);
+            p->clear_has_ext_ref();
+          }
+        });
+      }
+
+      // Copy `p` out of its arena to memory of its own.
+      auto copy = [from](Object* p) {
+        size_t sz = p->size();
+        Object* n = Object::object_start(heap::alloc(sz));
+        std::memcpy(n->real_start(), p->real_start(), sz);
+        GCPhases::copied(sz);
+        n->init_next(nullptr);
+        if (n->has_ext_ref())
+          from->ExternalReferenceTable::move(p, n);
+        p->set_forwarding_pointer(n);
+        return n;
+      };
+
+      // Phase 3: The Iso is in the large object ring if it is pinned there
+      // or too large for an arena, as in RegionArena::merge.
+      void* p = heap::alloc<vsizeof<RegionTrace>>();
+      Object* md = Object::register_object(p, RegionTrace::desc());
+      auto to = new (md) RegionTrace();
+
+      bool in_ring = from->collectable ||
+        snmalloc::bits::align_up(o->size(), Object::ALIGNMENT) > Arena::SIZE;
+      Object* root = in_ring ? o : copy(o);
+      to->init_next(root);
+
+      // Phase 4: Linking a large survivor into the Trace region clears its
+      // mark. The Iso is last in the ring, if it is there.
+      Object* q;
+      for (Object* r = from->get_next(); r != from; r = q)
+      {
+        q = r->get_next_any_mark();
+        if (r == o)
+          continue;
+
+        if (r->get_class() == Object::MARKED)
+          to->append(r);
+        else
+          r->dealloc();
+      }
+      from->init_next(from);
+      from->last_large = nullptr;
+
+      root->init_iso();
+      root->set_region(to);
+
+      // Phase 5: Evacuate the arenas.
+      auto evacuate = [&copy, o, to](Object* r) {
+        if (r != o && r->get_class() == Object::MARKED)
+          to->append(copy(r));
+      };
+      for (Arena* a : arenas)
+      {
+        RegionArena::for_each_in(a->objects_begin(), a->objects_end, evacuate);
+        RegionArena::for_each_in(
+          a->non_trivial_begin, a->non_trivial_end, evacuate);
+      }
+
+      // Phase 6: Fix up the fields of every object, the Iso included.
+      RegionArena::gc_evacuating_ = &arenas;
+      for (auto it = to->begin(); it != to->end(); ++it)
+        RegionArena::fix_fields(*it);
+      RegionArena::gc_evacuating_ = nullptr;
+
+      to->use_memory(root->size() + live_bytes);
+      to->region_size = 1 + live_objects;
+      to->non_trivial_size = (o->is_trivial() ? 0 : 1) + live_non_trivial;
+
+      // Phase 7: Hand over what the regions hold, and free the arenas.
+      from->RememberedSet::sweep();
+      to->ExternalReferenceTable::merge(from);
+      to->RememberedSet::merge(from);
+      to->gc_policy = from->gc_policy;
+      to->quota = from->quota;
+
+      for (Arena* a : arenas)
+        Arena::destroy(a);
+      RegionArena::released_chunk_bytes_.fetch_add(
+        chunk_bytes, std::memory_order_relaxed);
+      RegionArena::released_wasted_bytes_.fetch_add(
+        wasted_bytes, std::memory_order_relaxed);
+      from->dealloc_converted();
+
+      Logging::cout() << "Region convert complete. Iso: " << root
+                      << Logging::endl;
+      return root;
+    }
+
+    using CloneMap = ObjectMap<std::pair<Object*, Object*>>;
+
+    /// Copies made by the clone in progress on this thread, by original,
+    /// for the forward callback, which Descriptor::relocate gives no
+    /// context argument.
+    static inline thread_local CloneMap* clone_map_ = nullptr;
+
+    /**
+     * clone() of a region of type R.
+     *
+     * Algorithm:
+     *   1. Find every object reachable from the Iso, cloning the regions
+     *      they own and entering the immutable and shared objects into the
+     *      clone's remembered set.
+     *   2. Make room for the copies, so that allocating them cannot
+     *      collect the clone.
+     *   3. Copy the Iso and each object found.
+     *   4. Point the fields of every copy at the copies.
+     **/
+    template<typename R>
+    static Object* clone_as(Object* o)
+    {
+      R* from = (R*)o->get_region();
+      const Descriptor* desc = o->get_descriptor();
+      assert(desc->tail == 0);
+
+      if constexpr (std::is_same_v<R, RegionTrace>)
+        from->open();
+
+      Object* n;
+      if constexpr (std::is_same_v<R, RegionSemiSpace>)
+        n = R::create(
+          desc, from->get_large_object_threshold(), from->get_initial_size());
+      else
+        n = R::create(desc);
+      R* to = (R*)n->get_region();
+      to->gc_policy = from->gc_policy;
+      to->quota = from->quota;
+
+      Logging::cout() << "Region clone: " << o << " to " << n
+                      << Logging::endl;
+
+      // Phase 1: Find the objects to copy, in the order found.
+      CloneMap map(from->get_region_size());
+      map.insert(std::make_pair(o, n));
+      std::vector<Object*> found;
+      size_t bytes = 0;
+      ObjectStack grey;
+      o->trace(grey);
+      while (!grey.empty())
+      {
+        Object* p = grey.pop();
+        auto [fresh, it] = map.insert(std::make_pair(p, (Object*)nullptr));
+        if (!fresh)
+          continue;
+
+        switch (p->get_class())
+        {
+          case Object::ISO:
+            it.value() = clone(p);
+            break;
+
+          case Object::UNMARKED:
+          case Object::MARKED:
+            found.push_back(p);
+            bytes += snmalloc::bits::align_up(p->size(), Object::ALIGNMENT);
+            p->trace(grey);
+            break;
+
+          case Object::SCC_PTR:
+            to->RememberedSet::template insert<NoTransfer>(p->immutable());
+            break;
+
+          case Object::RC:
+          case Object::SHARED:
+            to->RememberedSet::template insert<NoTransfer>(p);
+            break;
+
+          default:
+            assert(0);
+        }
+      }
+
+      // Phase 2: The Iso's body is cleared first, as growing the space
+      // collects the clone, tracing its Iso.
+      size_t body = o->size() - sizeof(Object::Header);
+      if constexpr (std::is_same_v<R, RegionSemiSpace>)
+      {
+        std::memset((void*)n, 0, body);
+        R::ensure_available(n, bytes);
+      }
+
+      // Phase 3: Copy.
+      std::memcpy((void*)n, (void*)o, body);
+      for (Object* p : found)
+      {
+        const Descriptor* d = p->get_descriptor();
+        size_t tail = d->tail != 0 ? *reinterpret_cast<size_t*>(p) : 0;
+        Object* c = R::alloc(n, d, tail);
+        std::memcpy((void*)c, (void*)p, p->size() - sizeof(Object::Header));
+        map.find(p).value() = c;
+      }
+
+      // Phase 4: Fix up the fields of the copies, as a moving collection
+      // does.
+      clone_map_ = &map;
+      n->relocate_fields(clone_forward);
+      for (Object* p : found)
+        map.find(p).value()->relocate_fields(clone_forward);
+      clone_map_ = nullptr;
+
+      return n;
+    }
+
+    /**
+     * Forwarding callback passed to Descriptor::relocate: the copy of an
+     * object the clone in progress copied, or the reference unchanged.
+     **/
+    static Object* clone_forward(Object* field)
+    {
+      auto it = clone_map_->find(field);
+      if (it == clone_map_->end())
+        return field;
+      return it.value();
+    }
+
+    using ReleaseFn = void (*)(Object*, ObjectStack&);
+
+    template<typename R>
+    static void release_as(Object* o, ObjectStack& collect)
+    {
+      ((R*)o->get_region())->release_internal(o, collect);
+    }
+
+    /// release_as() for each region type, in the order of RegionType.
+    static constexpr ReleaseFn release_fns[] = {
+      &release_as<RegionTrace>,
+      &release_as<RegionArena>,
+      &release_as<RegionRc>,
+      &release_as<RegionSemiSpace>,
+      &release_as<RegionGenerational>,
+      &release_as<RegionCompact>,
+      &release_as<RegionBytes>,
+    };
+
+    /**
+     * Internal method for releasing and deallocating regions, that takes
+     * a worklist (represented by `f` and `collect`).
+     *
+     * We dispatch based on the type of region represented by `o`, through
+     * release_fns.
+     **/
+    static void release_internal(Object* o, ObjectStack& collect)
+    {
+      static_assert(
+        std::size(release_fns) == (size_t)RegionType::Bytes + 1,
+        "release_fns needs an entry for every RegionType");
+      auto type = (size_t)Region::get_type(o->get_region());
+      release_fns[type](o, collect);
+    }
   };
 
-  inline size_t debug_get_ref_count(Object* o)
+  inline void RegionBase::release_collected(ObjectStack& collect)
   {
-    return o->get_ref_count();
+    Region::release_collected(collect);
   }
 } // namespace verona::rt
@@ -2,25 +2,64 @@
 // SPDX-License-Identifier: MIT
 #pragma once
 
+#include "alloc_trace.h"
 #include "freeze.h"
+#include "heap_profile.h"
 #include "region.h"
+#include "region_hints.h"
 
+#include <algorithm>
+#include <chrono>
 #include <debug/logging.h>
+#include <type_traits>
+#include <vector>
 
 namespace verona::rt::api
 {
   namespace internal
   {
+    /**
+     * The stack of regions open on this thread. Frames live in a fixed
+     * array inside the context, and only move to the heap if regions are
+     * nested more than INLINE_FRAMES deep, so opening and closing a region
+     * does not allocate.
+     */
     class RegionContext
     {
       struct RegionFrame
       {
         Object* entry_point;
         RegionBase* region;
-        RegionFrame* prev;
+        RegionType type;
       };
 
-      RegionFrame* top;
+      static constexpr size_t INLINE_FRAMES = 16;
+
+      RegionFrame* top = nullptr;
+      RegionFrame* frames = inline_frames;
+      size_t depth = 0;
+      size_t capacity = INLINE_FRAMES;
+      RegionFrame inline_frames[INLINE_FRAMES];
+
+      RegionContext() = default;
+
+      ~RegionContext()
+      {
+        if (frames != inline_frames)
+          heap::dealloc(frames, capacity * sizeof(RegionFrame));
+      }
+
+      void grow()
+      {
+        size_t new_capacity = capacity * 2;
+        auto* new_frames =
+          (RegionFrame*)heap::alloc(new_capacity * sizeof(RegionFrame));
+        std::copy(frames, frames + depth, new_frames);
+        if (frames != inline_frames)
+          heap::dealloc(frames, capacity * sizeof(RegionFrame));
+        frames = new_frames;
+        capacity = new_capacity;
+      }
 
     public:
       static RegionContext& get_region_context()
@@ -31,19 +70,22 @@ namespace verona::rt::api
 
       static void push(Object* entry_point, RegionBase* region)
       {
-        RegionFrame* frame = new RegionFrame();
+        auto& t = get_region_context();
+        if (t.depth == t.capacity)
+          t.grow();
+        RegionFrame* frame = &t.frames[t.depth++];
         frame->entry_point = entry_point;
         frame->region = region;
-        frame->prev = get_region_context().top;
-        get_region_context().top = frame;
+        frame->type = region->region_type;
+        t.top = frame;
       }
 
       static void pop()
       {
         auto& t = get_region_context();
-        RegionFrame* frame = t.top;
-        t.top = frame->prev;
-        delete frame;
+        assert(t.depth > 0);
+        t.depth--;
+        t.top = (t.depth == 0) ? nullptr : &t.frames[t.depth - 1];
       }
 
       static Object*& get_entry_point()
@@ -55,6 +97,27 @@ namespace verona::rt::api
       {
         return get_region_context().top->region;
       }
+
+      static RegionType get_region_type()
+      {
+        return get_region_context().top->type;
+      }
+
+      /**
+       * Point the current frame at `region`, which its entry point now
+       * belongs to, as after Region::convert().
+       */
+      static void set_region(RegionBase* region)
+      {
+        RegionFrame* frame = get_region_context().top;
+        frame->region = region;
+        frame->type = region->region_type;
+      }
+
+      static bool is_open()
+      {
+        return get_region_context().top != nullptr;
+      }
     };
   }
 
@@ -83,8 +146,13 @@ namespace verona::rt::api
     switch (Region::get_type(md))
     {
       case RegionType::Trace:
+        ((RegionTrace*)md)->open();
+        break;
       case RegionType::Arena:
       case RegionType::SemiSpace:
+      case RegionType::Generational:
+      case RegionType::Compact:
+      case RegionType::Bytes:
         break;
       case RegionType::Rc:
         ((RegionRc*)md)->open(r);
@@ -94,17 +162,60 @@ namespace verona::rt::api
     }
   }
 
+  /**
+   * What closing a region does when its GC policy asks to be consulted on
+   * close (see GCPolicy::on_close()).
+   */
+  enum class CloseGC
+  {
+    /// Collect before closing, if the policy says it is worth it.
+    Collect,
+    /// Leave it for region_collect_deferred(), so that the collection can
+    /// run as separate work instead of extending the current behaviour.
+    Defer,
+    /// Do not consult the policy.
+    Skip,
+  };
+
+  inline bool region_maybe_collect();
+
+  /**
+   * The safepoint at the close of the current region, which collects it if
+   * its policy or its quota asks for it.
+   */
+  inline void close_safepoint(CloseGC gc)
+  {
+    RegionBase* r = RegionContext::get_region();
+    if (
+      (gc == CloseGC::Skip) ||
+      (!r->gc_policy.is_on_close() && !r->quota.is_collect_pending()))
+      return;
+
+    if (gc == CloseGC::Defer)
+      r->collect_deferred = true;
+    else
+      region_maybe_collect();
+  }
+
   /**
    * Close current region
    */
-  inline void close_region()
+  inline void close_region(CloseGC gc = CloseGC::Collect)
   {
+    close_safepoint(gc);
     auto md = RegionContext::get_region();
-    switch (Region::get_type(md))
+    switch (RegionContext::get_region_type())
     {
       case RegionType::Trace:
-      case RegionType::Arena:
+        ((RegionTrace*)md)->close(RegionContext::get_entry_point());
+        break;
       case RegionType::SemiSpace:
+        ((RegionSemiSpace*)md)->close(RegionContext::get_entry_point());
+        break;
+      case RegionType::Arena:
+      case RegionType::Generational:
+      case RegionType::Compact:
+      case RegionType::Bytes:
         break;
       case RegionType::Rc:
         ((RegionRc*)md)->close(RegionContext::get_entry_point());
@@ -115,10 +226,48 @@ namespace verona::rt::api
     RegionContext::pop();
   }
 
+  /**
+   * Open supplied region, which must be of type `type`, without looking up
+   * its type.
+   */
+  template<RegionType type>
+  inline void open_region(Object* r)
+  {
+    assert(r->debug_is_iso());
+    auto md = r->get_region();
+    assert(Region::get_type(md) == type);
+    RegionContext::push(r, md);
+    if constexpr (type == RegionType::Trace)
+      ((RegionTrace*)md)->open();
+    else if constexpr (type == RegionType::Rc)
+      ((RegionRc*)md)->open(r);
+  }
+
+  /**
+   * Close current region, which must be of type `type`, without looking up
+   * its type.
+   */
+  template<RegionType type>
+  inline void close_region(CloseGC gc = CloseGC::Collect)
+  {
+    close_safepoint(gc);
+    auto md = RegionContext::get_region();
+    assert(Region::get_type(md) == type);
+    if constexpr (type == RegionType::Trace)
+      ((RegionTrace*)md)->close(RegionContext::get_entry_point());
+    else if constexpr (type == RegionType::SemiSpace)
+      ((RegionSemiSpace*)md)->close(RegionContext::get_entry_point());
+    else if constexpr (type == RegionType::Rc)
+      ((RegionRc*)md)->close(RegionContext::get_entry_point());
+    RegionContext::pop();
+  }
+
   class UsingRegion
   {
+    CloseGC gc;
+
   public:
-    UsingRegion(Object* r)
+    UsingRegion(Object* r, CloseGC gc = CloseGC::Collect) : gc(gc)
     {
       open_region(r);
     }
@@ -126,21 +275,48 @@ namespace verona::rt::api
     ~UsingRegion()
     {
       // TODO: Check if we are in the same region as the one we opened.
-      close_region();
+      close_region(gc);
     }
   };
 
   /**
-   * Freeze region
+   * Freeze region. Pass FreezeShape::Acyclic if the graph is known to have
+   * no cycles, to skip computing SCCs.
    */
   template<typename T = Object>
-  inline T* freeze(T* r)
+  inline T* freeze(T* r, FreezeShape shape = FreezeShape::Any)
   {
-    // Check for trace region.
-    Freeze::apply(r);
+    AllocTrace::on_freeze(r);
+    Freeze::apply(r, shape);
     return r;
   }
 
+  /**
+   * Freeze region, then share each frozen object whose type defines
+   * `intern_hash` and `intern_equals` with an equal object frozen before,
+   * if there is one (see InternTable). Returns the entry point, which may
+   * be an object frozen before; only the returned pointer may be used.
+   */
+  template<typename T = Object>
+  inline T* freeze_interned(T* r, FreezeShape shape = FreezeShape::Any)
+  {
+    AllocTrace::on_freeze(r);
+    std::vector<Object*> frozen;
+    Freeze::apply(r, shape, &frozen);
+    return (T*)Freeze::intern(r, frozen);
+  }
+
+  /**
+   * Freeze region into a single block (see Freeze::apply_compact()), and
+   * return the new address of its entry point.
+   */
+  template<typename T = Object>
+  inline T* freeze_compact(T* r)
+  {
+    AllocTrace::on_freeze(r);
+    return (T*)Freeze::apply_compact(r);
+  }
+
   /**
    * Add supplied region to the current region
    * and return the entry point.
@@ -152,6 +328,7 @@ namespace verona::rt::api
     assert(
       Region::get_type(r->get_region()) ==
       Region::get_type(RegionContext::get_region()));
+    AllocTrace::on_merge(RegionContext::get_entry_point(), r);
 
     switch (Region::get_type(r->get_region()))
     {
@@ -162,9 +339,17 @@ namespace verona::rt::api
         RegionArena::merge(RegionContext::get_entry_point(), r);
         return r;
       case RegionType::Rc:
-        abort();
+        RegionRc::merge(r, (RegionRc*)RegionContext::get_region());
+        return r;
       case RegionType::SemiSpace:
-        abort(); // Merge not supported for semi-space regions
+        RegionSemiSpace::merge(RegionContext::get_entry_point(), r);
+        return r;
+      case RegionType::Generational:
+        abort(); // Merge not supported for generational regions
+      case RegionType::Compact:
+        abort(); // Merge not supported for compacting regions
+      case RegionType::Bytes:
+        abort(); // Byte-buffer regions hold no objects to merge
     }
     abort();
   }
@@ -194,56 +379,417 @@ namespace verona::rt::api
     return e->get();
   }
 
+  inline void region_collect();
+
+  /**
+   * Check that the current region may use `bytes` more under its quota.
+   * Going over the soft limit asks for a collection at the next safepoint
+   * (see region_maybe_collect()), as the objects being built may not be
+   * reachable yet. Returns false, and the allocation must fail, if the
+   * region would go over the hard limit.
+   */
+  inline bool region_check_quota(size_t bytes)
+  {
+    RegionBase* r = RegionContext::get_region();
+    if (SNMALLOC_LIKELY(!r->quota.is_limited()))
+      return true;
+
+    size_t used = Region::get_memory_used(r) + bytes;
+    if (r->quota.should_collect(used))
+      r->quota.request_collect();
+
+    if (r->quota.is_exceeded(used))
+    {
+      Logging::cout() << "Region " << r << " over its hard quota of "
+                      << r->quota.get_hard() << " bytes" << Logging::endl;
+      return false;
+    }
+    return true;
+  }
+
   /**
-   * Create object in current region
+   * Count an allocation of `bytes` that cannot fail against the current
+   * region's quota (see region_check_quota()). Going over the hard limit is
+   * reported to the breach hook (see RegionQuota::set_breach_hook()), and
+   * the allocation goes ahead.
    */
-  inline Object* create_object(const Descriptor* d)
+  inline void region_charge_quota(size_t bytes)
+  {
+    if (SNMALLOC_UNLIKELY(!region_check_quota(bytes)))
+      RegionQuota::breached(RegionContext::get_entry_point(), bytes);
+  }
+
+  /**
+   * Allocate an object in the current region, without checking its quota.
+   */
+  template<size_t size = 0>
+  inline Object* alloc_object(const Descriptor* d)
   {
     // Case analysis on type of region
-    switch (Region::get_type(RegionContext::get_region()))
+    Object* o;
+    switch (RegionContext::get_region_type())
     {
       case RegionType::Trace:
-        return RegionTrace::alloc(RegionContext::get_entry_point(), d);
+        o = RegionTrace::alloc<size>(RegionContext::get_entry_point(), d);
+        break;
       case RegionType::Arena:
-        return RegionArena::alloc(RegionContext::get_entry_point(), d);
+        o = RegionArena::alloc<size>(RegionContext::get_entry_point(), d);
+        break;
       case RegionType::Rc:
-        return RegionRc::alloc((RegionRc*)RegionContext::get_region(), d);
+        o = RegionRc::alloc<size>((RegionRc*)RegionContext::get_region(), d);
+        break;
       case RegionType::SemiSpace:
       {
         // The iso root is pinned on the heap and never moves during
         // growth, so no entry-point adjustment is needed.
-        return RegionSemiSpace::alloc(
+        o = RegionSemiSpace::alloc<size>(RegionContext::get_entry_point(), d);
+        break;
+      }
+      case RegionType::Generational:
+        o = RegionGenerational::alloc<size>(
           RegionContext::get_entry_point(), d);
+        break;
+      case RegionType::Compact:
+        o = RegionCompact::alloc<size>(RegionContext::get_entry_point(), d);
+        break;
+      default:
+        // Unreachable as case is exhaustive
+        abort();
+    }
+    AllocTrace::on_alloc(RegionContext::get_entry_point(), o);
+    return o;
+  }
+
+  /**
+   * Create object in current region
+   *
+   * If `size` is not 0 it must be `d->size`, and lets the region allocate
+   * through the heap's compile-time size class instead of looking it up.
+   */
+  template<size_t size = 0>
+  inline Object* create_object(const Descriptor* d)
+  {
+    region_charge_quota(d->size);
+    return alloc_object<size>(d);
+  }
+
+  /**
+   * Create object in current region, as create_object() does, unless that
+   * would take the region over its hard quota, when it returns nullptr
+   * having created nothing.
+   */
+  template<size_t size = 0>
+  inline Object* try_create_object(const Descriptor* d)
+  {
+    if (!region_check_quota(d->size))
+      return nullptr;
+    return alloc_object<size>(d);
+  }
+
+  /**
+   * Create object in current region, which must be of type `type`, without
+   * looking up its type.
+   */
+  template<RegionType type, size_t size = 0>
+  inline Object* create_object(const Descriptor* d)
+  {
+    using R = typename RegionType_to_class<type>::T;
+    assert(Region::get_type(RegionContext::get_region()) == type);
+    region_charge_quota(d->size);
+    Object* o;
+    if constexpr (type == RegionType::Rc)
+      o = R::template alloc<size>((R*)RegionContext::get_region(), d);
+    else
+      o = R::template alloc<size>(RegionContext::get_entry_point(), d);
+    AllocTrace::on_alloc(RegionContext::get_entry_point(), o);
+    return o;
+  }
+
+  /**
+   * Create an object of a variable sized type in the current region, whose
+   * trailing array has `tail` elements (see Descriptor::tail).
+   */
+  inline Object* create_object_with_tail(const Descriptor* d, size_t tail)
+  {
+    region_charge_quota(Object::size_of(d, tail));
+
+    Object* o;
+    switch (RegionContext::get_region_type())
+    {
+      case RegionType::Trace:
+        o = RegionTrace::alloc(RegionContext::get_entry_point(), d, tail);
+        break;
+      case RegionType::Arena:
+        o = RegionArena::alloc(RegionContext::get_entry_point(), d, tail);
+        break;
+      case RegionType::Rc:
+        o = RegionRc::alloc((RegionRc*)RegionContext::get_region(), d, tail);
+        break;
+      case RegionType::SemiSpace:
+        o = RegionSemiSpace::alloc(RegionContext::get_entry_point(), d, tail);
+        break;
+      case RegionType::Generational:
+        o = RegionGenerational::alloc(
+          RegionContext::get_entry_point(), d, tail);
+        break;
+      case RegionType::Compact:
+        o = RegionCompact::alloc(RegionContext::get_entry_point(), d, tail);
+        break;
+      default:
+        abort();
+    }
+    AllocTrace::on_alloc(RegionContext::get_entry_point(), o);
+    return o;
+  }
+
+  /**
+   * Opens a region whose type is known at compile time for the lifetime of
+   * this object, and allocates in it with no dispatch on the region type.
+   */
+  template<RegionType type>
+  class UsingTypedRegion
+  {
+  public:
+    UsingTypedRegion(Object* r)
+    {
+      open_region<type>(r);
+    }
+
+    ~UsingTypedRegion()
+    {
+      close_region<type>();
+    }
+
+    /**
+     * Create a default-constructed `T` in the region, as `new T` would.
+     */
+    template<class T>
+    T* create_object()
+    {
+      static_assert(std::is_default_constructible_v<T>);
+      return ::new (api::create_object<type, vsizeof<T>>(T::desc())) T();
+    }
+  };
+
+  /**
+   * Store `value` into `field`, a reference field of an object in the
+   * current region.
+   *
+   * While a trace region is marked incrementally, stores that overwrite a
+   * reference must go through here, so the write barrier sees the old
+   * value. While a trace region has old objects (see
+   * region_set_sticky_marks()), stores into its objects must go
+   * through here too, so the write barrier sees a young value stored into
+   * an old object. Otherwise this is a plain store.
+   **/
+  template<typename T, typename U>
+  inline void store(T*& field, U* value)
+  {
+    static_assert(std::is_base_of_v<Object, T>);
+    if (
+      (RegionTrace::is_any_mark_pending() || RegionTrace::is_any_sticky()) &&
+      RegionContext::is_open())
+    {
+      RegionBase* r = RegionContext::get_region();
+      if (Region::get_type(r) == RegionType::Trace)
+      {
+        auto* reg = (RegionTrace*)r;
+        if (field != nullptr)
+          reg->write_barrier(field);
+        if (value != nullptr)
+          reg->remember_young(value);
       }
     }
-    // Unreachable as case is exhaustive
-    abort();
+    field = value;
+  }
+
+  /**
+   * Load the reference in `field`, a reference field of an object in the
+   * current region.
+   *
+   * While a semispace region is copied incrementally (see
+   * RegionSemiSpace::set_incremental_copy()), loads of references from its
+   * objects must go through here, so the read barrier can hand out the
+   * copy of the target, copying it first if need be, and point `field` at
+   * it. Otherwise this is a plain load.
+   **/
+  template<typename T>
+  inline T* load(T*& field)
+  {
+    static_assert(std::is_base_of_v<Object, T>);
+    T* value = field;
+    if (
+      (value != nullptr) && RegionSemiSpace::is_any_copy_pending() &&
+      RegionContext::is_open())
+    {
+      RegionBase* r = RegionContext::get_region();
+      if (Region::get_type(r) == RegionType::SemiSpace)
+      {
+        value = static_cast<T*>(((RegionSemiSpace*)r)->read_barrier(value));
+        field = value;
+      }
+    }
+    return value;
   }
 
   /**
    * Ensure that at least `bytes` of bump-allocation capacity is
-   * available in the current SemiSpace region's from-space.
+   * available in the current SemiSpace region's from-space, or in the
+   * space of the current Compact region.
    *
-   * If the space needs to grow, it grows now (moving existing
-   * objects), so the caller must call get_root() / get_entry_point()
+   * If the space needs to grow, it grows now by collecting into a
+   * larger space (moving surviving objects and reclaiming unreachable
+   * ones), so the caller must call get_root() / get_entry_point()
    * afterwards to obtain the updated root pointer.  After that,
    * subsequent allocations totalling up to `bytes` are guaranteed
    * not to trigger another growth, keeping all returned pointers
    * valid.
    *
-   * Only meaningful for SemiSpace regions; asserts on other types.
+   * Only meaningful for SemiSpace and Compact regions; asserts on other
+   * types.
    **/
   inline void region_ensure_available(size_t bytes)
   {
-    assert(
-      Region::get_type(RegionContext::get_region()) == RegionType::SemiSpace);
-
     // The iso root is pinned on the heap and never moves during
     // growth, so no entry-point adjustment is needed.
+    if (RegionContext::get_region_type() == RegionType::Compact)
+    {
+      RegionCompact::ensure_available(RegionContext::get_entry_point(), bytes);
+      return;
+    }
+
+    assert(
+      Region::get_type(RegionContext::get_region()) == RegionType::SemiSpace);
     RegionSemiSpace::ensure_available(
       RegionContext::get_entry_point(), bytes);
   }
 
+  /**
+   * Take an allocation cursor on the current region, which must be a
+   * SemiSpace region. It must be destroyed before the region is closed.
+   **/
+  inline RegionSemiSpace::AllocCursor region_alloc_cursor()
+  {
+    assert(RegionContext::get_region_type() == RegionType::SemiSpace);
+    return RegionSemiSpace::AllocCursor(RegionContext::get_entry_point());
+  }
+
+  /**
+   * Create a pinned object with descriptor `d`, and a trailing array of
+   * `tail` elements, in the current region, which must be a SemiSpace
+   * region. It does not move until the region is released, and stays
+   * alive until region_unpin() is called on it, so its address can be
+   * handed to asynchronous I/O (see RegionSemiSpace::alloc_pinned()).
+   **/
+  inline Object* region_alloc_pinned(const Descriptor* d, size_t tail = 0)
+  {
+    assert(RegionContext::get_region_type() == RegionType::SemiSpace);
+    region_charge_quota(Object::size_of(d, tail));
+    Object* o =
+      RegionSemiSpace::alloc_pinned(RegionContext::get_entry_point(), d, tail);
+    AllocTrace::on_alloc(RegionContext::get_entry_point(), o);
+    return o;
+  }
+
+  /**
+   * Pin `o`, a large object of the current region, which must be a
+   * SemiSpace region, so that collections keep it alive (see
+   * RegionSemiSpace::pin()).
+   **/
+  inline void region_pin(Object* o)
+  {
+    assert(RegionContext::get_region_type() == RegionType::SemiSpace);
+    RegionSemiSpace::pin(RegionContext::get_entry_point(), o);
+  }
+
+  /**
+   * Drop a pin taken by region_pin() or region_alloc_pinned().
+   **/
+  inline void region_unpin(Object* o)
+  {
+    assert(RegionContext::get_region_type() == RegionType::SemiSpace);
+    RegionSemiSpace::unpin(RegionContext::get_entry_point(), o);
+  }
+
+  /**
+   * Call `f` on each object of type `T` in the current region, as a `T*`.
+   * Arena and SemiSpace regions visit only the places that objects of that
+   * kind can be, and step over the matches by their known size (see
+   * RegionArena::for_each_of() and RegionSemiSpace::for_each_of()). Other
+   * regions compare the descriptor of every object. `f` must not allocate
+   * in the region, nor may an allocation cursor be open on it. Aborts for
+   * Rc and Bytes regions.
+   **/
+  template<typename T, typename F>
+  inline void region_for_each(F f)
+  {
+    const Descriptor* desc = T::desc();
+    auto visit = [&f](Object* o) { f(static_cast<T*>(o)); };
+    auto scan = [desc, &visit](auto* reg) {
+      for (auto p : *reg)
+      {
+        if (p->get_descriptor() == desc)
+          visit(p);
+      }
+    };
+
+    RegionBase* r = RegionContext::get_region();
+    switch (Region::get_type(r))
+    {
+      case RegionType::Arena:
+        ((RegionArena*)r)->for_each_of(desc, visit);
+        return;
+      case RegionType::SemiSpace:
+        ((RegionSemiSpace*)r)->for_each_of(desc, visit);
+        return;
+      case RegionType::Trace:
+        scan((RegionTrace*)r);
+        return;
+      case RegionType::Generational:
+        scan((RegionGenerational*)r);
+        return;
+      case RegionType::Compact:
+        scan((RegionCompact*)r);
+        return;
+      default:
+        abort();
+    }
+  }
+
+  /**
+   * Create `n` objects with descriptor `d` in the current region, storing
+   * them in `out[0..n)`.
+   *
+   * Trace and Arena regions allocate the batch in one go. SemiSpace and
+   * Compact regions reserve room for all of it first, so no allocation in
+   * the batch moves or collects the ones before it. Other regions allocate
+   * one object at a time.
+   **/
+  inline void create_objects(const Descriptor* d, size_t n, Object** out)
+  {
+    assert(d->tail == 0);
+    region_charge_quota(n * d->size);
+    switch (RegionContext::get_region_type())
+    {
+      case RegionType::Trace:
+        RegionTrace::alloc_many(RegionContext::get_entry_point(), d, n, out);
+        break;
+      case RegionType::Arena:
+        RegionArena::alloc_many(RegionContext::get_entry_point(), d, n, out);
+        break;
+      case RegionType::SemiSpace:
+      case RegionType::Compact:
+        region_ensure_available(n * d->size);
+        [[fallthrough]];
+      default:
+        for (size_t i = 0; i < n; i++)
+          out[i] = alloc_object(d);
+        return;
+    }
+    for (size_t i = 0; i < n; i++)
+      AllocTrace::on_alloc(RegionContext::get_entry_point(), out[i]);
+  }
+
   inline void add_reference(Object*)
   {
     // TODO
@@ -257,7 +803,7 @@ namespace verona::rt::api
   inline void incref(Object* o)
   {
     assert(Region::get_type(RegionContext::get_region()) == RegionType::Rc);
-    RegionRc::incref(o);
+    RegionRc::incref(o, (RegionRc*)RegionContext::get_region());
   }
 
   inline void decref(Object* o)
@@ -269,9 +815,44 @@ namespace verona::rt::api
     });
   }
 
+  /**
+   * The policy a region created with `hints` starts with, expected to use
+   * `bytes` (see RegionHints).
+   **/
+  inline GCPolicy hinted_gc_policy(const RegionHints& hints, size_t bytes)
+  {
+    GCPolicy policy = GCPolicy::get_default();
+    if (policy.get_kind() == GCPolicy::Kind::Always)
+    {
+      if (hints.lifetime == RegionLifetime::Short)
+        policy = GCPolicy::allocation_budget(
+                   std::max(bytes, GCPolicy::DEFAULT_ALLOCATION_BUDGET))
+                   .on_close(policy.is_on_close());
+      else if (hints.lifetime == RegionLifetime::Long)
+        policy = GCPolicy::heap_growth().on_close(policy.is_on_close());
+    }
+    return policy.warm_up(bytes);
+  }
+
+  /**
+   * Create a region of type `type` whose entry point has descriptor `d`,
+   * with its internal structures sized and its GC policy picked for what
+   * `hints` says it will hold. `large_object_threshold` is the size above
+   * which a SemiSpace region puts objects in its large object space; other
+   * region types ignore it.
+   **/
   template<typename T = Object>
-  inline T* create_fresh_region(RegionType type, const Descriptor* d)
+  inline T* create_fresh_region(
+    RegionType type,
+    const Descriptor* d,
+    const RegionHints& hints,
+    size_t large_object_threshold = RegionSemiSpace::LARGE_OBJECT_THRESHOLD)
   {
+    size_t bytes = hints.bytes;
+    if (bytes == 0)
+      bytes = hints.objects *
+        snmalloc::bits::align_up(Object::size_of(d, 0), Object::ALIGNMENT);
+
     Object* entry_point = nullptr;
     switch (type)
     {
@@ -279,21 +860,127 @@ namespace verona::rt::api
         entry_point = RegionTrace::create(d);
         break;
       case RegionType::Arena:
-        entry_point = RegionArena::create(d);
+      {
+        auto config = RegionArena::get_default_chunks();
+        config.initial_size = std::max(config.initial_size, bytes);
+        entry_point = RegionArena::create(d, config);
         break;
+      }
       case RegionType::Rc:
         entry_point = RegionRc::create(d);
         break;
       case RegionType::SemiSpace:
-        entry_point = RegionSemiSpace::create(d);
+        entry_point = RegionSemiSpace::create(
+          d,
+          large_object_threshold,
+          std::max(RegionSemiSpace::get_default_initial_size(), bytes));
+        break;
+      case RegionType::Generational:
+        entry_point = RegionGenerational::create(d, bytes);
+        break;
+      case RegionType::Compact:
+        entry_point = RegionCompact::create(
+          d, std::max(RegionCompact::INITIAL_SPACE_SIZE, bytes));
         break;
+      case RegionType::Bytes:
+        abort(); // Use create_fresh_bytes_region(), which takes a size
     }
+
+    RegionBase* reg = entry_point->get_region();
+    if (
+      (type == RegionType::Trace) || (type == RegionType::Arena) ||
+      (type == RegionType::SemiSpace))
+      reg->RememberedSet::reserve(hints.remembered);
+    if ((hints.lifetime != RegionLifetime::Default) || (bytes != 0))
+      reg->gc_policy = hinted_gc_policy(hints, bytes);
+
+    AllocTrace::on_region(entry_point, type);
     return {reinterpret_cast<T*>(entry_point)};
   }
 
+  /**
+   * Create a region of type `type` whose entry point has descriptor `d`.
+   * `large_object_threshold` is the size above which a SemiSpace region
+   * puts objects in its large object space; other region types ignore it.
+   **/
+  template<typename T = Object>
+  inline T* create_fresh_region(
+    RegionType type,
+    const Descriptor* d,
+    size_t large_object_threshold = RegionSemiSpace::LARGE_OBJECT_THRESHOLD)
+  {
+    return create_fresh_region<T>(
+      type, d, RegionHints{}, large_object_threshold);
+  }
+
+  /**
+   * Create an Arena region whose entry point has descriptor `d`, with its
+   * arenas sized by `config` rather than the default.
+   **/
+  template<typename T = Object>
+  inline T* create_fresh_arena_region(
+    const Descriptor* d, RegionArena::ChunkConfig config)
+  {
+    Object* entry_point = RegionArena::create(d, config);
+    AllocTrace::on_region(entry_point, RegionType::Arena);
+    return reinterpret_cast<T*>(entry_point);
+  }
+
+  /**
+   * Create a SemiSpace region whose entry point has descriptor `d`, with
+   * spaces of `initial_size` bytes to start with rather than the default.
+   **/
+  template<typename T = Object>
+  inline T* create_fresh_semispace_region(
+    const Descriptor* d,
+    size_t initial_size,
+    size_t large_object_threshold = RegionSemiSpace::LARGE_OBJECT_THRESHOLD)
+  {
+    Object* entry_point =
+      RegionSemiSpace::create(d, large_object_threshold, initial_size);
+    AllocTrace::on_region(entry_point, RegionType::SemiSpace);
+    return reinterpret_cast<T*>(entry_point);
+  }
+
+  /**
+   * Create a byte-buffer region of `size` zeroed bytes, whose entry point
+   * has descriptor `d`, and return its entry point. With `page_aligned`
+   * the buffer starts on a page, and its pages can be given back with
+   * bytes_release_pages(). The region moves between cowns with its entry
+   * point, and the buffer is never copied.
+   **/
+  template<typename T = Object>
+  inline T* create_fresh_bytes_region(
+    const Descriptor* d, size_t size, bool page_aligned = false)
+  {
+    Object* entry_point = RegionBytes::create(d, size, page_aligned);
+    AllocTrace::on_region(entry_point, RegionType::Bytes);
+    return reinterpret_cast<T*>(entry_point);
+  }
+
+  /**
+   * The buffer of the byte-buffer region whose entry point is `r`. The
+   * region need not be open.
+   **/
+  inline ByteView bytes_view(Object* r)
+  {
+    return RegionBytes::view(r);
+  }
+
+  /**
+   * Give the whole pages within `length` bytes at `offset` in the
+   * page-aligned buffer of the byte-buffer region whose entry point is `r`
+   * back to the OS, and return how many bytes that was (see
+   * RegionBytes::release_pages()).
+   **/
+  inline size_t bytes_release_pages(Object* r, size_t offset, size_t length)
+  {
+    return RegionBytes::release_pages(r, offset, length);
+  }
+
   inline void set_entry_point(Object* o)
   {
-    switch (Region::get_type(RegionContext::get_region()))
+    switch (RegionContext::get_region_type())
     {
       case RegionType::Trace:
         RegionTrace::swap_root(RegionContext::get_entry_point(), o);
@@ -302,51 +989,283 @@ namespace verona::rt::api
         RegionArena::swap_root(RegionContext::get_entry_point(), o);
         break;
       case RegionType::Rc:
-        abort(); // TODO
+        RegionRc::swap_root(
+          RegionContext::get_entry_point(),
+          o,
+          (RegionRc*)RegionContext::get_region());
         break;
       case RegionType::SemiSpace:
         RegionSemiSpace::swap_root(RegionContext::get_entry_point(), o);
         break;
+      case RegionType::Generational:
+        RegionGenerational::swap_root(RegionContext::get_entry_point(), o);
+        break;
+      case RegionType::Compact:
+        RegionCompact::swap_root(RegionContext::get_entry_point(), o);
+        break;
+      case RegionType::Bytes:
+        abort(); // The buffer belongs to the entry point it was made with
     }
     RegionContext::get_entry_point() = o;
   }
 
+  /**
+   * Convert the current region, of type `From`, to a region of type `To`
+   * (see Region::convert), and release the regions its dead objects owned.
+   * The entry point of the region may move, so the caller must call
+   * get_entry_point() afterwards to find it, unless it is pinned. Objects
+   * of the region are copied out of its arenas, so other pointers to them
+   * must be found again from the entry point.
+   **/
+  template<RegionType From, RegionType To>
+  inline void region_convert()
+  {
+    RegionBase* r = RegionContext::get_region();
+    if (Region::get_type(r) != From)
+      abort();
+
+    // AllocTrace follows objects by their address, which this changes.
+    if (AllocTrace::is_enabled())
+      abort();
+
+    Object*& entry = RegionContext::get_entry_point();
+    ObjectStack collect;
+    with_region_stats(
+      r,
+      "Region convert",
+      [&]() { entry = Region::convert<From, To>(entry, collect); },
+      true);
+    RegionContext::set_region(entry->get_region());
+    Region::release_collected(collect);
+  }
+
   inline void region_collect()
   {
-    RegionType type = Region::get_type(RegionContext::get_region());
+    RegionBase* r = RegionContext::get_region();
+    RegionType type = Region::get_type(r);
     Object* entry = RegionContext::get_entry_point();
+    AllocTrace::on_collect(entry);
+
+    // Only collectable Arena regions have a GC; skip measurement overhead.
+    if (type == RegionType::Arena && !((RegionArena*)r)->is_collectable())
+      return;
+
+    // An Arena region estimated to hold too much garbage becomes a Trace
+    // region, which the conversion collects.
+    if (type == RegionType::Arena && ((RegionArena*)r)->should_promote())
+    {
+      region_convert<RegionType::Arena, RegionType::Trace>();
+      return;
+    }
+
+    // The policy only needs the pause time to pace PauseTarget, so leave the
+    // clock alone for the others.
+    bool timed = r->gc_policy.get_kind() == GCPolicy::Kind::PauseTarget;
+    size_t before = Region::get_memory_used(r);
+    std::chrono::steady_clock::time_point start;
+    if (timed)
+      start = std::chrono::steady_clock::now();
 
-    if (type == RegionType::Arena)
-      return; // Arena has no GC to collect; skip measurement overhead.
+    // Cycle collection in an Rc region does not visit the live objects.
+    if (HeapProfile::is_enabled() && type != RegionType::Rc)
+      HeapProfile::collected();
 
-    with_region_stats(RegionContext::get_region(), "Region collect", [&]() {
+    with_region_stats(r, "Region collect", [&]() {
       switch (type)
       {
         case RegionType::Trace:
           RegionTrace::gc(entry);
           break;
         case RegionType::Rc:
-          RegionRc::gc_cycles(
-            entry,
-            (RegionRc*)RegionContext::get_region());
+          RegionRc::gc_cycles(entry, (RegionRc*)r);
           break;
         case RegionType::SemiSpace:
-          RegionSemiSpace::gc(
-            entry,
-            (RegionSemiSpace*)RegionContext::get_region());
+          RegionSemiSpace::gc(entry, (RegionSemiSpace*)r);
           break;
+        case RegionType::Generational:
+          RegionGenerational::gc(entry, (RegionGenerational*)r);
+          break;
+        case RegionType::Compact:
+          RegionCompact::gc(entry, (RegionCompact*)r);
+          break;
+        case RegionType::Arena:
+        {
+          ObjectStack collect;
+          RegionArena::gc(entry, collect);
+          Region::release_collected(collect);
+          break;
+        }
         default:
           break;
       }
     });
+
+    // An incremental trace mark or semispace copy that is still going has
+    // not freed anything yet; the policy hears about the collection from the
+    // slice that ends it.
+    if (type == RegionType::Trace && ((RegionTrace*)r)->is_mark_pending())
+      return;
+    if (
+      type == RegionType::SemiSpace &&
+      ((RegionSemiSpace*)r)->is_copy_pending())
+      return;
+
+    uint64_t pause_ns = 0;
+    if (timed)
+      pause_ns = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now() - start)
+                   .count();
+    r->gc_policy.collected(before, Region::get_memory_used(r), pause_ns);
+    r->quota.collected(Region::get_memory_used(r));
+  }
+
+  /**
+   * Collect the current region if its GC policy says it is worth it, and
+   * return whether it did.
+   *
+   * Meant for mutators that would otherwise call region_collect() at fixed
+   * points; with the default GCPolicy::always() the two behave the same. An
+   * incremental trace mark in progress always gets its next slice, so the
+   * mark keeps up with the mutator whatever the policy. An Rc region with a
+   * cycle threshold collects once it has buffered that many cycle
+   * candidates, and a region that went over its soft quota collects,
+   * whatever the policy.
+   **/
+  inline bool region_maybe_collect()
+  {
+    RegionBase* r = RegionContext::get_region();
+    RegionType type = Region::get_type(r);
+
+    if (type == RegionType::Arena && !((RegionArena*)r)->is_collectable())
+      return false;
+
+    if (r->quota.is_collect_pending())
+    {
+      region_collect();
+      return true;
+    }
+
+    if (type == RegionType::Rc && ((RegionRc*)r)->has_cycle_threshold())
+    {
+      if (!((RegionRc*)r)->should_collect_cycles())
+        return false;
+      region_collect();
+      return true;
+    }
+
+    if (
+      !(type == RegionType::Trace &&
+        ((RegionTrace*)r)->is_mark_pending()) &&
+      !(type == RegionType::SemiSpace &&
+        ((RegionSemiSpace*)r)->is_copy_pending()) &&
+      !r->gc_policy.should_collect(Region::get_memory_used(r)))
+      return false;
+
+    region_collect();
+    return true;
+  }
+
+  /**
+   * Run the collection that was deferred when the region whose entry point
+   * is `r` was last closed, if there is one, and return whether it
+   * collected. The region must not be open.
+   **/
+  inline bool region_collect_deferred(Object* r)
+  {
+    RegionBase* md = Region::get(r);
+    if (!md->collect_deferred)
+      return false;
+
+    md->collect_deferred = false;
+    md->collect_idle_queued = false;
+    open_region(r);
+    bool collected = region_maybe_collect();
+    close_region(CloseGC::Skip);
+    return collected;
+  }
+
+  /**
+   * Set the GC policy of the region whose entry point is `r`, in place of
+   * the default it was created with.
+   **/
+  inline void region_set_gc_policy(Object* r, GCPolicy policy)
+  {
+    Region::get(r)->gc_policy = policy;
+  }
+
+  /**
+   * Set the memory quota of the region whose entry point is `r`, in place
+   * of the default it was created with.
+   **/
+  inline void region_set_quota(Object* r, RegionQuota quota)
+  {
+    Region::get(r)->quota = quota;
+  }
+
+  /**
+   * Choose whether the collections of the trace region whose entry point is
+   * `r` keep their marks, in place of the default it was created with (see
+   * RegionTrace::set_sticky_marks()).
+   **/
+  inline void region_set_sticky_marks(Object* r, bool enable)
+  {
+    if (Region::get_type(r->get_region()) != RegionType::Trace)
+      abort(); // Only trace regions have sticky marks
+
+    RegionTrace::get(r)->set_region_sticky_marks(enable);
   }
 
   template<typename T = Object>
   inline void region_release(Object* r)
   {
-    with_region_stats(r->get_region(), "Region release", [&]() {
-          Region::release(r);
-        });
+    AllocTrace::on_release(r);
+    with_region_stats(
+      r->get_region(),
+      "Region release",
+      [&]() { Region::release(r); },
+      true);
+  }
+
+  /**
+   * Drop every object of the Arena region whose entry point is `r`, except
+   * `r`, keeping the region and its first arena for reuse. See
+   * Region::reset.
+   **/
+  inline void region_reset(Object* r)
+  {
+    with_region_stats(
+      r->get_region(), "Region reset", [&]() { Region::reset(r); });
+  }
+
+  /**
+   * Take a savepoint in the current region, which must be an Arena region.
+   **/
+  inline RegionArena::Savepoint region_mark()
+  {
+    if (RegionContext::get_region_type() != RegionType::Arena)
+      abort();
+    return RegionArena::mark(RegionContext::get_entry_point());
+  }
+
+  /**
+   * Drop every object allocated in the current region since `sp` was taken
+   * with region_mark(). See Region::rewind_to.
+   **/
+  inline void region_rewind_to(const RegionArena::Savepoint& sp)
+  {
+    Region::rewind_to(RegionContext::get_entry_point(), sp);
+  }
+
+  /**
+   * Return the reference count of `o` in the current region, which must be
+   * an Rc region.
+   *
+   * For testing and debugging purposes only.
+   **/
+  inline size_t debug_get_ref_count(Object* o)
+  {
+    assert(Region::get_type(RegionContext::get_region()) == RegionType::Rc);
+    return RegionRc::get_ref_count(o, (RegionRc*)RegionContext::get_region());
   }
 
   /**
@@ -368,6 +1287,9 @@ namespace verona::rt::api
         }
         return count;
       case RegionType::Arena:
+        // Collections leave dead objects behind as filler.
+        if (((RegionArena*)r)->is_collectable())
+          return ((RegionArena*)r)->get_region_size();
         for (auto p : *((RegionArena*)r))
         {
           UNUSED(p);
@@ -383,11 +1305,52 @@ namespace verona::rt::api
           count++;
         }
         return count;
+      case RegionType::Generational:
+        for (auto p : *((RegionGenerational*)r))
+        {
+          UNUSED(p);
+          count++;
+        }
+        return count;
+      case RegionType::Compact:
+        for (auto p : *((RegionCompact*)r))
+        {
+          UNUSED(p);
+          count++;
+        }
+        return count;
+      case RegionType::Bytes:
+        return ((RegionBytes*)r)->get_region_size();
       default:
         abort();
     }
   }
 
+  /**
+   * Return the counters of the current region (see RegionStats). Unlike
+   * debug_size(), this does not visit the objects, so it can be used to
+   * check a region while it is being timed.
+   **/
+  inline RegionStats region_stats()
+  {
+    return verona::rt::region_stats(RegionContext::get_region());
+  }
+
+  /**
+   * Return the survival of the objects of each allocation site of the
+   * current region, most objects allocated first. It is empty unless the
+   * region is a SemiSpace or Generational region that has allocated while
+   * pretenuring was on (see AllocSites::set_pretenure_after()).
+   **/
+  inline std::vector<AllocSites::Row> region_alloc_sites()
+  {
+    const AllocSites* sites =
+      verona::rt::region_alloc_sites(RegionContext::get_region());
+    if (sites == nullptr)
+      return {};
+    return sites->rows();
+  }
+
   /**
    * Return the memory used by the current region in bytes.
    *
@@ -395,20 +1358,7 @@ namespace verona::rt::api
    **/
   inline size_t debug_memory_used()
   {
-    RegionBase* r = RegionContext::get_region();
-    switch (Region::get_type(r))
-    {
-      case RegionType::Trace:
-        return ((RegionTrace*)r)->get_current_memory_used();
-      case RegionType::Arena:
-        return ((RegionArena*)r)->get_current_memory_used();
-      case RegionType::Rc:
-        return ((RegionRc*)r)->get_current_memory_used();
-      case RegionType::SemiSpace:
-        return ((RegionSemiSpace*)r)->get_current_memory_used();
-      default:
-        abort();
-    }
+    return Region::get_memory_used(RegionContext::get_region());
   }
 
   /**
@@ -424,7 +1374,43 @@ namespace verona::rt::api
   }
 
   /**
-   * Return the number of objects in the large object list.
+   * Return the number of bytes of the two semi-spaces backed by memory.
+   * Aborts if called on a non-SemiSpace region.
+   * For testing and debugging purposes only.
+   **/
+  inline size_t debug_semispace_committed()
+  {
+    RegionBase* r = RegionContext::get_region();
+    assert(Region::get_type(r) == RegionType::SemiSpace);
+    return ((RegionSemiSpace*)r)->get_committed_size();
+  }
+
+  /**
+   * Return the number of pins held on objects of the current SemiSpace
+   * region.
+   * For testing and debugging purposes only.
+   **/
+  inline size_t debug_pin_count()
+  {
+    RegionBase* r = RegionContext::get_region();
+    assert(Region::get_type(r) == RegionType::SemiSpace);
+    return ((RegionSemiSpace*)r)->get_pin_count();
+  }
+
+  /**
+   * Return the number of chunks in the large object space.
+   * Aborts if called on a non-SemiSpace region.
+   * For testing and debugging purposes only.
+   **/
+  inline size_t debug_large_chunk_count()
+  {
+    RegionBase* r = RegionContext::get_region();
+    assert(Region::get_type(r) == RegionType::SemiSpace);
+    return ((RegionSemiSpace*)r)->get_large_chunk_count();
+  }
+
+  /**
+   * Return the number of objects in the large object space.
    * Aborts if called on a non-SemiSpace region.
    * For testing and debugging purposes only.
    **/
@@ -446,4 +1432,53 @@ namespace verona::rt::api
     assert(Region::get_type(r) == RegionType::SemiSpace);
     return ((RegionSemiSpace*)r)->get_fromspace_used();
   }
-} // namespace verona::rt
\ No newline at end of file
+
+  /**
+   * Return the number of objects in the old generation.
+   * Aborts if called on a non-Generational region.
+   * For testing and debugging purposes only.
+   **/
+  inline size_t debug_old_object_count()
+  {
+    RegionBase* r = RegionContext::get_region();
+    assert(Region::get_type(r) == RegionType::Generational);
+    return ((RegionGenerational*)r)->get_old_object_count();
+  }
+
+  /**
+   * Return the number of bytes bump-allocated in the nursery.
+   * Aborts if called on a non-Generational region.
+   * For testing and debugging purposes only.
+   **/
+  inline size_t debug_nursery_used()
+  {
+    RegionBase* r = RegionContext::get_region();
+    assert(Region::get_type(r) == RegionType::Generational);
+    return ((RegionGenerational*)r)->get_nursery_used();
+  }
+
+  /**
+   * Return the size of the space of a Compact region.
+   * Aborts if called on a non-Compact region.
+   * For testing and debugging purposes only.
+   **/
+  inline size_t debug_compact_space_size()
+  {
+    RegionBase* r = RegionContext::get_region();
+    assert(Region::get_type(r) == RegionType::Compact);
+    return ((RegionCompact*)r)->get_space_size();
+  }
+
+  /**
+   * Return the number of bytes bump-allocated in the space of a Compact
+   * region.
+   * Aborts if called on a non-Compact region.
+   * For testing and debugging purposes only.
+   **/
+  inline size_t debug_compact_space_used()
+  {
+    RegionBase* r = RegionContext::get_region();
+    assert(Region::get_type(r) == RegionType::Compact);
+    return ((RegionCompact*)r)->get_space_used();
+  }
+} // namespace verona::rt
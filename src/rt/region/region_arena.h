@@ -2,10 +2,20 @@
 // SPDX-License-Identifier: MIT
 #pragma once
 
+#include "../ds/chunk_cache.h"
 #include "../object/object.h"
+#include "../pal/virtual_memory.h"
+#include "alloc_stats.h"
+#include "gc_phases.h"
+#include "heap_profile.h"
 #include "region_base.h"
 
+#include <algorithm>
+#include <atomic>
 #include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
 
 namespace verona::rt
 {
@@ -23,9 +33,50 @@ namespace verona::rt
    * to the last arena in the linked list.
    *
    * When allocating a new object, we check if the last arena has free space.
-   * If so, we allocate within that arena. If not, we allocate a new arena and
-   * then allocate the object within the new arena. Note that we do not do
-   * first fit or best fit.
+   * If so, we allocate within that arena. If not, we try the few arenas
+   * most recently left with a sizeable gap between their two ends, taking
+   * the one the object fits best, so an object too big for the last arena
+   * does not waste the rest of it. Failing that, we allocate a new arena
+   * and then allocate the object within the new arena.
+   *
+   * Arenas are not all the same size. A region's first arena is small
+   * (ChunkConfig::initial_size, 4KiB by default) and each new one is twice
+   * the size of the last, up to ChunkConfig::max_size, so a region of a few
+   * objects stays small and a large one needs few arenas. Arenas of up to
+   * MAX_HEAP_CHUNK_SIZE come from snmalloc, through the thread's
+   * ChunkCache. If the region is configured
+   * with huge pages, arenas may grow further, and those of HUGE_PAGE_SIZE
+   * or more are mapped through the PAL backed by huge pages.
+   *
+   * Free space left in arenas other than the last when a region is
+   * released is counted as wasted (see get_fragmentation_stats()).
+   *
+   * A region can also drop objects without being released, to be reused for
+   * a fresh batch of work. Region::reset() drops every object but the Iso,
+   * and Region::rewind_to() every object allocated since a savepoint taken
+   * with mark(). Both run the finalisers and destructors of the non-trivial
+   * objects dropped, and rewind the arena pointers, so dropping trivial
+   * objects costs nothing per object. Arenas that empty are kept for reuse,
+   * up to ChunkConfig::retain_size.
+   *
+   * Optionally (see set_collectable()), a region can also be collected with
+   * gc(), which marks from the Iso and then evacuates, in the manner of
+   * Immix. An arena keeps its survivors in place if it is at least
+   * EVACUATE_OCCUPANCY percent live and its only dead objects are trivial;
+   * those dead objects stay as unreachable filler until the arena is next
+   * evacuated. The survivors of every other arena are copied to the end of
+   * the arena list, fields are rewritten through Descriptor::relocate, and
+   * the emptied arenas are retired. Dead large objects are freed. The Iso of
+   * such a region is pinned in the large object ring, so it never moves, and
+   * swap_root() must pick a large object. A collection invalidates every
+   * savepoint taken before it.
+   *
+   * A region that outlives the scratch work it was meant for can be turned
+   * into a Trace region with Region::convert(). With set_promote_garbage(),
+   * region_collect() does so by itself for a collectable region once the
+   * garbage it estimates the region holds exceeds a threshold. The estimate
+   * is the memory allocated since the last collection, times the fraction
+   * of the memory that collection found dead.
    *
    * Note that if the Iso is allocated within an arena, it will still point to
    * the arena region object.
@@ -51,10 +102,80 @@ namespace verona::rt
     friend class RegionTrace;
     friend class RegionRc;
 
+  public:
+    /// Smallest arena, including its header.
+    static constexpr size_t MIN_CHUNK_SIZE = 4 * 1024;
+
+    /// Largest arena allocated from snmalloc, including its header. Larger
+    /// arenas are only used with huge pages.
+    static constexpr size_t MAX_HEAP_CHUNK_SIZE = 1024 * 1024;
+
+    /// Number of arenas left with a gap that later allocations may fill.
+    static constexpr size_t PARTIAL_ARENAS = 4;
+
+    /// Smallest gap worth filling later.
+    static constexpr size_t MIN_PARTIAL_GAP = 256;
+
+    /// Arena space of released regions, across all threads.
+    struct FragmentationStats
+    {
+      /// Total size of the arenas.
+      size_t chunk_bytes;
+      /// Free space in arenas other than the last.
+      size_t wasted_bytes;
+    };
+
+    /// A collection evacuates an arena whose live objects take less than
+    /// this percentage of its usable space.
+    static constexpr size_t EVACUATE_OCCUPANCY = 50;
+
+    /**
+     * Arena sizes for a region, fixed when the region is created. Sizes
+     * include the arena header and are rounded up to powers of two.
+     *
+     * `max_size` only goes beyond MAX_HEAP_CHUNK_SIZE when `huge_pages` is
+     * not None.
+     *
+     * Arenas emptied by Region::reset() or Region::rewind_to() are kept for
+     * reuse while they total at most `retain_size` bytes. The first one is
+     * always kept.
+     **/
+    struct ChunkConfig
+    {
+      size_t initial_size = MIN_CHUNK_SIZE;
+      size_t max_size = MAX_HEAP_CHUNK_SIZE;
+      pal::HugePages huge_pages = pal::HugePages::None;
+      size_t retain_size = 0;
+    };
+
+  private:
+    class Arena;
+
+  public:
     /**
-     * An Arena is a large block of pre-allocated memory. It has an overhead of
-     * four pointers: the next Arena in the linked list, and three pointers to
-     * keep track of where objects are allocated. The next pointers of all
+     * A point in the allocation history of a region, taken with mark().
+     * Region::rewind_to() drops every object allocated after it.
+     **/
+    struct Savepoint
+    {
+      /// The last arena, or nullptr if there was none.
+      Arena* arena;
+      std::byte* objects_end;
+      std::byte* non_trivial_begin;
+      /// The newest large object, or the region if there was none.
+      Object* large_head;
+      Object* last_large;
+      size_t memory_used;
+      size_t size;
+      size_t non_trivial_size;
+    };
+
+  private:
+    /**
+     * An Arena is a block of pre-allocated memory, of a size chosen when it
+     * is allocated. It has an overhead of four pointers: the next Arena in
+     * the linked list, and three pointers to keep track of where objects are
+     * allocated. The next pointers of all
      * objects inside an arena are set to nullptr. An initialized arena is
      * guaranteed to have at least one object.
      *
@@ -73,8 +194,10 @@ namespace verona::rt
      *
      * Note that certain operations require the bottom `MIN_ALLOC_BITS` to be
      * free, so we need to ensure all objects allocated within an arena are
-     * properly aligned. This may involve extra padding in the "header" of an
-     * Arena object, and also rounding up object sizes.
+     * properly aligned. The header is a multiple of the alignment, and object
+     * sizes are rounded up.
+     *
+     * The size of the arena is `non_trivial_end` less the arena's address.
      *
      *                       +-------------------+
      *                       | next arena ---------> ...
@@ -113,11 +236,18 @@ namespace verona::rt
      **/
     class Arena
     {
+      friend class Region;
+      friend class RegionArena;
       template<IteratorType type>
       friend class RegionArena::iterator;
 
     public:
-      static constexpr size_t SIZE = 1024 * 1024 - 4 * sizeof(uintptr_t);
+      /**
+       * Largest object allocated in an arena. Larger objects go in the large
+       * object ring.
+       **/
+      static constexpr size_t SIZE =
+        MAX_HEAP_CHUNK_SIZE - 4 * sizeof(uintptr_t);
 
       /**
        * Pointer to next arena in the linked list.
@@ -137,25 +267,70 @@ namespace verona::rt
       std::byte* non_trivial_begin;
 
       /**
-       * Pointer to the byte after the Arena. We technically don't need to
-       * store this pointer, but we have some space because `objects_begin`
-       * needs to be aligned.
+       * Pointer to the byte after the Arena.
        **/
       std::byte* non_trivial_end;
 
       /**
-       * Where objects will actually be allocated.
+       * Where objects will actually be allocated, straight after the header.
        **/
-      alignas(Object::ALIGNMENT) std::byte objects_begin[SIZE];
+      std::byte* objects_begin()
+      {
+        return reinterpret_cast<std::byte*>(this + 1);
+      }
 
-    public:
-      Arena()
+      const std::byte* objects_begin() const
+      {
+        return reinterpret_cast<const std::byte*>(this + 1);
+      }
+
+      explicit Arena(size_t chunk_size)
       : next(nullptr),
-        objects_end(objects_begin),
-        non_trivial_begin(objects_begin + SIZE),
+        objects_end(objects_begin()),
+        non_trivial_begin(reinterpret_cast<std::byte*>(this) + chunk_size),
         non_trivial_end(non_trivial_begin)
       {
-        assert(free_space() == SIZE);
+        assert(free_space() == chunk_size - sizeof(Arena));
+      }
+
+    public:
+      /**
+       * Allocate an empty arena of `chunk_size` bytes, including its header.
+       * `chunk_size` is a power of two. Arenas of HUGE_PAGE_SIZE or more are
+       * mapped backed as `huge_pages` asks, which must not be None.
+       **/
+      static Arena* make(size_t chunk_size, pal::HugePages huge_pages)
+      {
+        assert(bits::is_pow2(chunk_size));
+        void* p;
+        if (chunk_size >= pal::HUGE_PAGE_SIZE)
+        {
+          assert(huge_pages != pal::HugePages::None);
+          p = pal::vm_alloc_huge(chunk_size, huge_pages);
+        }
+        else
+        {
+          p = ChunkCache::alloc(chunk_size);
+        }
+        return new (p) Arena(chunk_size);
+      }
+
+      /**
+       * Deallocate the arena `a`, which make() allocated.
+       **/
+      static void destroy(Arena* a)
+      {
+        size_t chunk_size = a->chunk_size();
+        if (chunk_size >= pal::HUGE_PAGE_SIZE)
+          pal::vm_release(a, chunk_size);
+        else
+          ChunkCache::dealloc(a, chunk_size);
+      }
+
+      inline size_t chunk_size() const
+      {
+        auto start = reinterpret_cast<const std::byte*>(this);
+        return (size_t)(non_trivial_end - start);
       }
 
       inline size_t free_space() const
@@ -201,13 +376,63 @@ namespace verona::rt
         return o;
       }
 
+      /**
+       * Allocates `n` objects of type `desc` within the current arena, each
+       * taking up `sz` bytes, and stores them in `out[0..n)`.
+       *
+       * This is a single bump of the relevant pointer. Objects are laid out
+       * as if allocated one at a time with alloc_obj.
+       **/
+      void alloc_objs(const Descriptor* desc, size_t sz, size_t n, Object** out)
+      {
+        assert(debug_invariant());
+        assert(free_space() >= sz * n);
+
+        std::byte* p;
+        std::ptrdiff_t step;
+        if (Object::is_trivial(desc))
+        {
+          p = objects_end;
+          step = (std::ptrdiff_t)sz;
+          objects_end += sz * n;
+        }
+        else
+        {
+          non_trivial_begin -= sz * n;
+          p = non_trivial_begin + sz * (n - 1);
+          step = -(std::ptrdiff_t)sz;
+        }
+
+        for (size_t i = 0; i < n; i++, p += step)
+        {
+          auto o = Object::register_object(p, desc);
+          o->init_next(nullptr);
+          out[i] = o;
+        }
+
+        assert(debug_invariant());
+      }
+
     private:
+      /**
+       * Drop the objects allocated since `objects_end` and
+       * `non_trivial_begin` had the given values.
+       **/
+      void rewind(std::byte* end, std::byte* nt_begin)
+      {
+        assert(end >= objects_begin() && end <= objects_end);
+        assert(nt_begin >= non_trivial_begin && nt_begin <= non_trivial_end);
+        objects_end = end;
+        non_trivial_begin = nt_begin;
+        assert(debug_invariant());
+      }
+
       bool debug_invariant() const
       {
-        bool objects_ptrs = objects_begin <= objects_end;
+        bool objects_ptrs = objects_begin() <= objects_end;
         bool non_trivial_ptrs = non_trivial_begin <= non_trivial_end;
         bool no_overlap = (non_trivial_begin - objects_end) >= 0;
-        auto alignment1 = Object::debug_is_aligned(objects_begin);
+        auto alignment1 = Object::debug_is_aligned(objects_begin());
         auto alignment2 = Object::debug_is_aligned(objects_end);
         auto alignment3 = Object::debug_is_aligned(non_trivial_begin);
         auto alignment4 = Object::debug_is_aligned(non_trivial_end);
@@ -215,7 +440,9 @@ namespace verona::rt
           alignment2 && alignment3 && alignment4;
       }
     };
-    static_assert(sizeof(Arena) == 1024 * 1024 * sizeof(std::byte));
+    static_assert(sizeof(Arena) == 4 * sizeof(uintptr_t));
+    static_assert(sizeof(Arena) % Object::ALIGNMENT == 0);
+    static_assert(Arena::SIZE + sizeof(Arena) == MAX_HEAP_CHUNK_SIZE);
 
     /**
      * Pointer to the linked list of arenas where objects are allocated in.
@@ -240,16 +467,76 @@ namespace verona::rt
     // Memory usage tracking (O(1) access)
     size_t current_memory_used = 0;
 
-    // Number of objects in the region (O(1) access)
+    // Number of objects in the region, and of those that are non-trivial
+    // (O(1) access)
     size_t region_size = 0;
+    size_t non_trivial_size = 0;
 
-    RegionArena()
-    : RegionBase(),
+    // Number of arenas in the linked list (O(1) access)
+    size_t arena_count = 0;
+
+    /// Size of the next arena to allocate, including its header.
+    size_t next_chunk_size;
+
+    /// Size arenas stop growing at.
+    size_t max_chunk_size;
+
+    pal::HugePages huge_pages;
+
+    /**
+     * Arenas before the last one that were left with at least
+     * MIN_PARTIAL_GAP bytes free, or nullptr. Taking a savepoint forgets
+     * them, so that objects allocated after a savepoint are still only in
+     * its arena, past its pointers, or in later arenas.
+     **/
+    Arena* partial[PARTIAL_ARENAS] = {};
+
+    /// Emptied arenas kept for reuse, and their total size.
+    Arena* spare_arenas = nullptr;
+    size_t spare_size = 0;
+    size_t retain_size;
+
+    /// Whether gc() may be used, which pins the Iso.
+    bool collectable;
+
+    /// Memory used by the region before and after its last collection.
+    size_t gc_before = 0;
+    size_t gc_after = 0;
+
+    static inline std::atomic<bool> collectable_{false};
+    static inline std::atomic<size_t> promote_garbage_{0};
+    static inline std::atomic<size_t> released_chunk_bytes_{0};
+    static inline std::atomic<size_t> released_wasted_bytes_{0};
+    static inline std::atomic<size_t> default_initial_size_{MIN_CHUNK_SIZE};
+    static inline std::atomic<size_t> default_max_size_{MAX_HEAP_CHUNK_SIZE};
+    static inline std::atomic<pal::HugePages> default_huge_pages_{
+      pal::HugePages::None};
+    static inline std::atomic<size_t> default_retain_size_{0};
+
+    RegionArena(ChunkConfig config)
+    : RegionBase(RegionType::Arena),
       first_arena(nullptr),
       last_arena(nullptr),
-      last_large(nullptr)
+      last_large(nullptr),
+      huge_pages(config.huge_pages),
+      retain_size(config.retain_size),
+      collectable(get_collectable())
     {
       init_next(this);
+
+      size_t limit = huge_pages == pal::HugePages::None ? MAX_HEAP_CHUNK_SIZE :
+                                                          SIZE_MAX / 2 + 1;
+      max_chunk_size = clamp_chunk_size(config.max_size, limit);
+      next_chunk_size = clamp_chunk_size(config.initial_size, max_chunk_size);
+    }
+
+    static size_t clamp_chunk_size(size_t size, size_t limit)
+    {
+      if (size <= MIN_CHUNK_SIZE)
+        return MIN_CHUNK_SIZE;
+      if (size >= limit)
+        return limit;
+      return bits::next_pow2(size);
     }
 
     static const Descriptor* desc()
@@ -284,29 +571,155 @@ namespace verona::rt
       return region_size;
     }
 
+    size_t get_non_trivial_size() const
+    {
+      return non_trivial_size;
+    }
+
+    size_t get_arena_count() const
+    {
+      return arena_count;
+    }
+
+    /**
+     * Size of the next arena the region allocates, including its header.
+     */
+    size_t get_next_chunk_size() const
+    {
+      return next_chunk_size;
+    }
+
     inline static bool is_arena_region(Object* o)
     {
       return o->is_type(desc());
     }
 
+    /**
+     * Set the arena sizes regions created from now on use, unless given
+     * their own to create().
+     **/
+    static void set_default_chunks(ChunkConfig config)
+    {
+      default_initial_size_.store(
+        config.initial_size, std::memory_order_relaxed);
+      default_max_size_.store(config.max_size, std::memory_order_relaxed);
+      default_huge_pages_.store(config.huge_pages, std::memory_order_relaxed);
+      default_retain_size_.store(config.retain_size, std::memory_order_relaxed);
+    }
+
+    static ChunkConfig get_default_chunks()
+    {
+      return {
+        default_initial_size_.load(std::memory_order_relaxed),
+        default_max_size_.load(std::memory_order_relaxed),
+        default_huge_pages_.load(std::memory_order_relaxed),
+        default_retain_size_.load(std::memory_order_relaxed)};
+    }
+
+    /**
+     * Choose whether regions created from now on can be collected with
+     * gc() (see the class comment).
+     **/
+    static void set_collectable(bool enable)
+    {
+      collectable_.store(enable, std::memory_order_relaxed);
+    }
+
+    static bool get_collectable()
+    {
+      return collectable_.load(std::memory_order_relaxed);
+    }
+
+    bool is_collectable() const
+    {
+      return collectable;
+    }
+
+    /**
+     * Set the estimated garbage, in bytes, past which region_collect()
+     * converts a collectable region to a Trace region instead of collecting
+     * it (see the class comment), or 0 to never do so.
+     **/
+    static void set_promote_garbage(size_t bytes)
+    {
+      promote_garbage_.store(bytes, std::memory_order_relaxed);
+    }
+
+    static size_t get_promote_garbage()
+    {
+      return promote_garbage_.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Bytes of garbage the region is estimated to hold, from the death
+     * rate its last collection saw. 0 before its first collection.
+     **/
+    size_t get_estimated_garbage() const
+    {
+      if (gc_before == 0 || current_memory_used <= gc_after)
+        return 0;
+      return (current_memory_used - gc_after) * (gc_before - gc_after) /
+        gc_before;
+    }
+
+    /**
+     * Whether region_collect() should convert this region to a Trace region
+     * rather than collect it.
+     **/
+    bool should_promote() const
+    {
+      size_t threshold = get_promote_garbage();
+      return collectable && threshold != 0 &&
+        get_estimated_garbage() > threshold;
+    }
+
+    static FragmentationStats get_fragmentation_stats()
+    {
+      return {
+        released_chunk_bytes_.load(std::memory_order_relaxed),
+        released_wasted_bytes_.load(std::memory_order_relaxed)};
+    }
+
+    static void reset_fragmentation_stats()
+    {
+      released_chunk_bytes_.store(0, std::memory_order_relaxed);
+      released_wasted_bytes_.store(0, std::memory_order_relaxed);
+    }
+
+    /**
+     * Free space in this region's arenas other than the last, which only
+     * objects that fit a partial arena can still use.
+     **/
+    size_t get_wasted_bytes() const
+    {
+      size_t wasted = 0;
+      for (Arena* a = first_arena; a != last_arena; a = a->next)
+        wasted += a->free_space();
+      return wasted;
+    }
+
     /**
      * Creates a new arena region by allocationg Object `o` of type `desc`. The
      * object is initialised as the Iso object for that region, and points to a
      * newly created Region metadata object. Returns a pointer to `o`.
+     * The region's arenas are sized by `config`. If the region is
+     * collectable, `o` goes in the large object ring whatever its size.
      *
      * The default template parameter `size = 0` is to avoid writing two
      * definitions which differ only in one line. This overload works because
      * every object must contain a descriptor, so 0 is not a valid size.
      **/
     template<size_t size = 0>
-    static Object* create(const Descriptor* desc)
+    static Object*
+    create(const Descriptor* desc, ChunkConfig config = get_default_chunks())
     {
       void* p = Object::register_object(
         heap::alloc<vsizeof<RegionArena>>(), RegionArena::desc());
-      RegionArena* reg = new (p) RegionArena();
+      RegionArena* reg = new (p) RegionArena(config);
 
       // o might be allocated in the arena or the large object ring.
-      Object* o = reg->alloc_internal<size>(desc);
+      Object* o = reg->collectable ? reg->alloc_internal<size, true>(desc) :
+                                     reg->alloc_internal<size>(desc);
       assert(Object::debug_is_aligned(o));
 
       o->init_iso();
@@ -320,23 +733,63 @@ namespace verona::rt
     }
 
     /**
-     * Allocates an object `o` of type `desc` in the region represented by the
-     * Iso object `in`. `o` will be allocated in an arena or the large object
-     * ring. Returns a pointer to `o`.
+     * Allocates an object `o` of type `desc`, with a trailing array of
+     * `tail` elements, in the region represented by the Iso object `in`. `o`
+     * will be allocated in an arena or the large object ring. Returns a
+     * pointer to `o`.
      *
      * The default template parameter `size = 0` is to avoid writing two
      * definitions which differ only in one line. This overload works because
      * every object must contain a descriptor, so 0 is not a valid size.
      **/
     template<size_t size = 0>
-    static Object* alloc(Object* in, const Descriptor* desc)
+    static Object* alloc(Object* in, const Descriptor* desc, size_t tail = 0)
     {
+      AllocStats::Sample sample(
+        RegionType::Arena, Object::size_of(desc, tail));
       RegionArena* reg = get(in);
-      Object* o = reg->alloc_internal<size>(desc);
+      Object* o = reg->alloc_internal<size>(desc, tail);
+      o->init_tail(tail);
       assert(Object::debug_is_aligned(o));
       return o;
     }
 
+    /**
+     * Allocate `n` objects of type `desc` in the region represented by the
+     * Iso Object `in`, storing them in `out[0..n)`. The region metrics are
+     * updated once for the batch.
+     **/
+    template<size_t size = 0>
+    static void
+    alloc_many(Object* in, const Descriptor* desc, size_t n, Object** out)
+    {
+      RegionArena* reg = get(in);
+      reg->alloc_many_internal<size>(desc, n, out);
+    }
+
+    /**
+     * Take a savepoint in the region represented by the Iso Object `in`, for
+     * Region::rewind_to().
+     **/
+    static Savepoint mark(Object* in)
+    {
+      RegionArena* reg = get(in);
+      return reg->mark_internal();
+    }
+
+    /**
+     * Collect the collectable region represented by the Iso Object `o` (see
+     * the class comment). Isos found by the finalisers of dead objects are
+     * added to `collect`, for the caller to release.
+     **/
+    static void gc(Object* o, ObjectStack& collect)
+    {
+      RegionArena* reg = get(o);
+      if (!reg->collectable)
+        abort();
+      reg->gc_internal(o, collect);
+    }
+
     /**
      * Insert the Object `o` into the RememberedSet of `into`'s region.
      *
@@ -372,15 +825,20 @@ namespace verona::rt
       RegionBase* other = o->get_region();
       assert(reg != other);
 
+      // Clear the iso bit on `o`, if it's inside an arena. Otherwise, it's in
+      // the large object ring, and merging the rings points it to some other
+      // object.
+      size_t sz = snmalloc::bits::align_up(o->size(), Object::ALIGNMENT);
+      bool in_arena = false;
       if (is_arena_region(other))
+      {
+        in_arena = sz <= Arena::SIZE && !((RegionArena*)other)->collectable;
         reg->merge_internal((RegionArena*)other);
+      }
       else
         assert(0);
 
-      // Clear the iso bit on `o`, if it's inside an arena. Otherwise, it's in
-      // the large object ring and pointing to some other object.
-      size_t sz = snmalloc::bits::align_up(o->size(), Object::ALIGNMENT);
-      if (sz <= Arena::SIZE)
+      if (in_arena)
         o->init_next(nullptr);
 
       // Merge the ExternalRefTable and RememberedSet.
@@ -393,7 +851,8 @@ namespace verona::rt
 
     /**
      * Swap the Iso (root) Object of a region, `prev`, with another Object
-     * within that region, `next`.
+     * within that region, `next`. In a collectable region, `next` must be in
+     * the large object ring.
      **/
     static void swap_root(Object* prev, Object* next)
     {
@@ -427,36 +886,42 @@ namespace verona::rt
     }
 
     /**
-     * Allocate an object of type `desc` in the region. Returns a pointer to
-     * that object.
+     * Allocate an object of type `desc`, with a trailing array of `tail`
+     * elements, in the region. Returns a pointer to that object.
      *
      * If the object is too large to fit in an arena, new memory is allocated
      * and the object is added to the large object ring.
      *
      * Otherwise, we check if the last arena has space. If so, the object is
-     * allocated there. If not, we allocate a new arena.
+     * allocated there. If not, it goes in the partial arena it fits best, or
+     * failing that in a new arena.
+     *
+     * If `pinned`, the object goes in the large object ring whatever its
+     * size, so a collection never moves it.
      *
      * TODO(region): For now, we guarantee constant-time allocation and accept
      * that we will have fragmentation. Later, we could try other strategies,
      * e.g. first fit or best fit.
      **/
-    template<size_t size = 0>
-    Object* alloc_internal(const Descriptor* desc)
+    template<size_t size = 0, bool pinned = false>
+    Object* alloc_internal(const Descriptor* desc, size_t tail = 0)
     {
-      assert((size == 0) || (desc->size == size));
+      assert((size == 0) || ((desc->size == size) && (tail == 0)));
 
-      auto sz = size == 0 ? desc->size : size;
+      auto sz = size == 0 ? Object::size_of(desc, tail) : size;
 
       // Track memory usage
       current_memory_used += sz;
       region_size += 1;
+      if (!Object::is_trivial(desc))
+        non_trivial_size += 1;
 
-      if (sz > Arena::SIZE)
+      if (pinned || sz > Arena::SIZE)
       {
         // Allocate object.
         void* p = nullptr;
         if constexpr (size == 0)
-          p = heap::alloc(desc->size);
+          p = heap::alloc(sz);
         else
           p = heap::alloc<size>();
 
@@ -469,27 +934,759 @@ namespace verona::rt
       }
 
       // If we don't have an arena, or the arena does not have enough space,
-      // allocate a new arena.
-      if (last_arena == nullptr || last_arena->free_space() < sz)
+      // try an earlier one, or allocate a new arena.
+      Arena* a = last_arena;
+      if (a == nullptr || a->free_space() < sz)
+        a = arena_for(sz);
+
+      // Allocate object within that arena.
+      return a->alloc_obj(desc, sz);
+    }
+
+    /**
+     * Allocate `n` objects of type `desc` in the region, storing them in
+     * `out[0..n)`.
+     *
+     * Objects that fit in an arena are bumped out of it as many at a time
+     * as the arena has room for, moving on as alloc_internal does when it
+     * runs out.
+     * Large objects go to the large object ring, as in alloc_internal.
+     **/
+    template<size_t size = 0>
+    void alloc_many_internal(const Descriptor* desc, size_t n, Object** out)
+    {
+      assert((size == 0) || (desc->size == size));
+
+      auto sz = size == 0 ? desc->size : size;
+
+      // Track memory usage
+      current_memory_used += sz * n;
+      region_size += n;
+      if (!Object::is_trivial(desc))
+        non_trivial_size += n;
+
+      if (sz > Arena::SIZE)
+      {
+        for (size_t i = 0; i < n; i++)
+        {
+          void* p = nullptr;
+          if constexpr (size == 0)
+            p = heap::alloc(desc->size);
+          else
+            p = heap::alloc<size>();
+
+          out[i] = Object::register_object(p, desc);
+          append(out[i]);
+        }
+        return;
+      }
+
+      while (n > 0)
       {
-        void* p = heap::alloc<sizeof(Arena)>();
-        Arena* a = new (p) Arena();
+        Arena* a = last_arena;
+        if (a == nullptr || a->free_space() < sz)
+          a = arena_for(sz);
+
+        size_t count = a->free_space() / sz;
+        if (count > n)
+          count = n;
+
+        a->alloc_objs(desc, sz, count, out);
+        out += count;
+        n -= count;
+      }
+    }
+
+    /**
+     * An arena with room for an object of `sz` bytes, which does not fit in
+     * the last one: the partial arena with the least room that fits, or
+     * else a new one. Partial arenas whose gap has shrunk below
+     * MIN_PARTIAL_GAP are forgotten.
+     **/
+    Arena* arena_for(size_t sz)
+    {
+      Arena* best = nullptr;
+      for (auto& a : partial)
+      {
+        if (a == nullptr)
+          continue;
+
+        size_t free = a->free_space();
+        if (free < MIN_PARTIAL_GAP)
+          a = nullptr;
+        else if (free >= sz && (best == nullptr || free < best->free_space()))
+          best = a;
+      }
+      if (best != nullptr)
+        return best;
 
-        if (last_arena == nullptr)
+      AllocStats::slow_path(RegionType::Arena);
+      add_arena(sz);
+      return last_arena;
+    }
+
+    /**
+     * Remember the arena `a`, which is no longer last, as a partial arena
+     * if its gap is worth filling, in place of the one with the least room.
+     **/
+    void add_partial(Arena* a)
+    {
+      size_t free = a->free_space();
+      if (free < MIN_PARTIAL_GAP)
+        return;
+
+      Arena** slot = nullptr;
+      for (auto& p : partial)
+      {
+        if (p == nullptr)
         {
-          first_arena = a;
-          last_arena = a;
+          slot = &p;
+          break;
+        }
+        if (
+          p->free_space() < free &&
+          (slot == nullptr || p->free_space() < (*slot)->free_space()))
+          slot = &p;
+      }
+      if (slot != nullptr)
+        *slot = a;
+    }
+
+    void clear_partial()
+    {
+      for (auto& p : partial)
+        p = nullptr;
+    }
+
+    /**
+     * Append a new, empty arena with room for an object of `sz` bytes to the
+     * linked list of arenas. The arena is the next size in the region's
+     * schedule, or larger if the object needs it.
+     **/
+    void add_arena(size_t sz)
+    {
+      assert(sz <= Arena::SIZE);
+      size_t needed = bits::next_pow2(sz + sizeof(Arena));
+
+      Arena* a = spare_arenas;
+      if (a != nullptr && a->chunk_size() >= needed)
+      {
+        spare_arenas = a->next;
+        spare_size -= a->chunk_size();
+        a->next = nullptr;
+      }
+      else
+      {
+        size_t chunk_size = next_chunk_size;
+        if (chunk_size < needed)
+          chunk_size = needed;
+        if (chunk_size < max_chunk_size)
+          next_chunk_size = chunk_size * 2;
+
+        a = Arena::make(chunk_size, huge_pages);
+      }
+      arena_count++;
+
+      if (last_arena == nullptr)
+      {
+        first_arena = a;
+        last_arena = a;
+      }
+      else
+      {
+        add_partial(last_arena);
+        last_arena->next = a;
+        last_arena = a;
+      }
+      assert(last_arena->next == nullptr);
+    }
+
+    /**
+     * Keep the emptied arena `a` for reuse, if there is room, or deallocate
+     * it.
+     **/
+    void retire_arena(Arena* a)
+    {
+      arena_count--;
+      a->rewind(a->objects_begin(), a->non_trivial_end);
+      size_t chunk_size = a->chunk_size();
+      if (spare_arenas == nullptr || spare_size + chunk_size <= retain_size)
+      {
+        a->next = spare_arenas;
+        spare_arenas = a;
+        spare_size += chunk_size;
+      }
+      else
+      {
+        Arena::destroy(a);
+      }
+    }
+
+    void release_spare_arenas()
+    {
+      while (spare_arenas != nullptr)
+      {
+        Arena* q = spare_arenas->next;
+        Arena::destroy(spare_arenas);
+        spare_arenas = q;
+      }
+      spare_size = 0;
+    }
+
+    /**
+     * Free the metadata of a region whose objects and arenas have been
+     * handed over to another region, as Region::arena_to_trace() does.
+     **/
+    void dealloc_converted()
+    {
+      release_spare_arenas();
+      dealloc();
+    }
+
+    Savepoint mark_internal()
+    {
+      clear_partial();
+      Savepoint sp{
+        last_arena,
+        nullptr,
+        nullptr,
+        get_next(),
+        last_large,
+        current_memory_used,
+        region_size,
+        non_trivial_size};
+      if (last_arena != nullptr)
+      {
+        sp.objects_end = last_arena->objects_end;
+        sp.non_trivial_begin = last_arena->non_trivial_begin;
+      }
+      return sp;
+    }
+
+    /**
+     * Call `f` on each object in the section [begin, end) of an arena.
+     **/
+    template<typename F>
+    static void for_each_in(std::byte* begin, std::byte* end, F f)
+    {
+      while (begin != end)
+      {
+        assert(begin < end);
+        Object* o = Object::object_start(begin);
+        begin += snmalloc::bits::align_up(o->size(), Object::ALIGNMENT);
+        f(o);
+      }
+    }
+
+    /**
+     * Call `f` on each object allocated since `sp` was taken, or only on
+     * the non-trivial ones if `type` is NonTrivial.
+     **/
+    template<IteratorType type, typename F>
+    void for_each_since(const Savepoint& sp, F f)
+    {
+      static_assert(type == NonTrivial || type == AllObjects);
+
+      Arena* a = first_arena;
+      if (sp.arena != nullptr)
+      {
+        a = sp.arena;
+        if constexpr (type == AllObjects)
+          for_each_in(sp.objects_end, a->objects_end, f);
+        for_each_in(a->non_trivial_begin, sp.non_trivial_begin, f);
+        a = a->next;
+      }
+
+      for (; a != nullptr; a = a->next)
+      {
+        if constexpr (type == AllObjects)
+          for_each_in(a->objects_begin(), a->objects_end, f);
+        for_each_in(a->non_trivial_begin, a->non_trivial_end, f);
+      }
+
+      // Newer large objects are nearer the front of the ring.
+      Object* p = get_next();
+      while (p != sp.large_head)
+      {
+        Object* q = p->get_next_any_mark();
+        if (type == AllObjects || !p->is_trivial())
+          f(p);
+        p = q;
+      }
+    }
+
+    /**
+     * Finalise, destroy and deallocate every object allocated since `sp`
+     * was taken, in the region represented by the Iso Object `o`. Arenas
+     * that empty are retired. Isos found by finalisers are added to
+     * `collect`.
+     *
+     * Objects older than `sp` are untouched, including any fields that
+     * point to dropped objects.
+     **/
+    void rewind_internal(Object* o, const Savepoint& sp, ObjectStack& collect)
+    {
+      Logging::cout() << "Region rewind: arena region: " << o << Logging::endl;
+
+      // As in release_internal, all finalisers run before any destructor.
+      for_each_since<NonTrivial>(
+        sp, [o, &collect](Object* p) { p->finalise(o, collect); });
+      for_each_since<NonTrivial>(sp, [](Object* p) { p->destructor(); });
+
+      if (!ExternalReferenceTable::is_empty())
+      {
+        for_each_since<AllObjects>(sp, [this](Object* p) {
+          if (p->has_ext_ref())
+            ExternalReferenceTable::erase(p);
+        });
+      }
+
+      Object* p = get_next();
+      while (p != sp.large_head)
+      {
+        Object* q = p->get_next_any_mark();
+        p->dealloc();
+        p = q;
+      }
+      set_next(sp.large_head);
+      last_large = sp.last_large;
+
+      Arena* a = first_arena;
+      if (sp.arena != nullptr)
+      {
+        a = sp.arena->next;
+        sp.arena->rewind(sp.objects_end, sp.non_trivial_begin);
+        sp.arena->next = nullptr;
+        last_arena = sp.arena;
+      }
+      else
+      {
+        first_arena = nullptr;
+        last_arena = nullptr;
+      }
+
+      while (a != nullptr)
+      {
+        Arena* q = a->next;
+        retire_arena(a);
+        a = q;
+      }
+
+      clear_partial();
+      current_memory_used = sp.memory_used;
+      region_size = sp.size;
+      non_trivial_size = sp.non_trivial_size;
+
+      assert(
+        last_large != nullptr ? last_large->get_next_any_mark() == this : true);
+    }
+
+    /**
+     * Drop every object but the Iso Object `o` from the region. `o` must be
+     * where create() put it, so it cannot have been swapped in with
+     * swap_root(), unless it was allocated first.
+     **/
+    void reset_internal(Object* o, ObjectStack& collect)
+    {
+      assert(o->debug_is_iso());
+      size_t sz = snmalloc::bits::align_up(o->size(), Object::ALIGNMENT);
+      Savepoint sp{
+        nullptr,
+        nullptr,
+        nullptr,
+        this,
+        nullptr,
+        o->size(),
+        1,
+        o->is_trivial() ? size_t(0) : size_t(1)};
+
+      if (collectable || sz > Arena::SIZE)
+      {
+        assert(o == last_large);
+        sp.large_head = o;
+        sp.last_large = o;
+      }
+      else
+      {
+        Arena* a = first_arena;
+        std::byte* start = o->real_start();
+        sp.arena = a;
+        sp.objects_end = a->objects_begin();
+        sp.non_trivial_begin = a->non_trivial_end;
+        if (o->is_trivial())
+        {
+          if (start != a->objects_begin())
+            abort();
+          sp.objects_end += sz;
         }
         else
         {
-          last_arena->next = a;
-          last_arena = a;
+          if (start != a->non_trivial_end - sz)
+            abort();
+          sp.non_trivial_begin -= sz;
         }
-        assert(last_arena->next == nullptr);
       }
 
-      // Allocate object within that arena.
-      return last_arena->alloc_obj(desc, sz);
+      rewind_internal(o, sp, collect);
+    }
+
+    /// Arenas being evacuated by the collection in progress on this thread,
+    /// in address order, for the forward callback, which
+    /// Descriptor::relocate gives no context argument.
+    static inline thread_local std::vector<Arena*>* gc_evacuating_ = nullptr;
+
+    /**
+     * Collect the region represented by the Iso Object `o`, which is pinned
+     * as the last object of the large object ring.
+     *
+     * Algorithm:
+     *   1. Mark everything reachable from the Iso, entering immutable and
+     *      shared references into the remembered set.
+     *   2. Choose the arenas to evacuate and take them out of the arena
+     *      list.
+     *   3. Finalise, then destruct, the dead non-trivial objects, and drop
+     *      the external references to dead objects.
+     *   4. Free the dead large objects, and unmark the large survivors.
+     *   5. Copy the survivors of the evacuated arenas to the end of the
+     *      arena list, leaving forwarding pointers behind.
+     *   6. Point the fields of every survivor at the new addresses, and
+     *      unmark the survivors in kept arenas.
+     *   7. Retire the evacuated arenas.
+     **/
+    void gc_internal(Object* o, ObjectStack& collect)
+    {
+      assert(o->debug_is_iso());
+      assert(o == last_large);
+
+      Logging::cout() << "Arena GC called for: " << o << Logging::endl;
+
+      // Phase 1: Mark.
+      GCPhases::Scope phase(GCPhases::Mark);
+      gc_before = current_memory_used;
+      size_t live_bytes = 0;
+      size_t live_objects = 0;
+      size_t live_non_trivial = 0;
+      mark_live(o, live_bytes, live_objects, live_non_trivial);
+
+      // Phase 2: Split the arena list. Partial arenas may be evacuated, so
+      // forget them.
+      phase.next(GCPhases::Sweep);
+      clear_partial();
+      std::vector<Arena*> evacuating;
+      Arena* kept = nullptr;
+      Arena* a = first_arena;
+      first_arena = nullptr;
+      last_arena = nullptr;
+      while (a != nullptr)
+      {
+        Arena* q = a->next;
+        a->next = nullptr;
+        if (should_evacuate(a))
+        {
+          evacuating.push_back(a);
+        }
+        else
+        {
+          if (kept == nullptr)
+            first_arena = a;
+          else
+            kept->next = a;
+          kept = a;
+        }
+        a = q;
+      }
+      last_arena = kept;
+      std::sort(evacuating.begin(), evacuating.end());
+
+      // Phase 3: As in release_internal, all finalisers run before any
+      // destructor.
+      phase.next(GCPhases::Finalise);
+      for_each_dead<NonTrivial>(
+        evacuating, [o, &collect](Object* p) { p->finalise(o, collect); });
+      for_each_dead<NonTrivial>(evacuating, [](Object* p) { p->destructor(); });
+
+      if (!ExternalReferenceTable::is_empty())
+      {
+        for_each_dead<AllObjects>(evacuating, [this](Object* p) {
+          if (p->has_ext_ref())
+          {
+            ExternalReferenceTable::erase(p);
+            p->clear_has_ext_ref();
+          }
+        });
+      }
+
+      // Phase 4: Rebuild the large object ring. Linking a survivor to the
+      // next one clears its mark.
+      phase.next(GCPhases::Sweep);
+      Object* prev = this;
+      Object* p = get_next();
+      while (p != o)
+      {
+        Object* q = p->get_next_any_mark();
+        if (p->get_class() == Object::MARKED)
+        {
+          if (prev == this)
+            set_next(p);
+          else
+            prev->init_next(p);
+          prev = p;
+        }
+        else
+        {
+          p->dealloc();
+        }
+        p = q;
+      }
+      if (prev == this)
+        set_next(o);
+      else
+        prev->init_next(o);
+
+      // Phase 5: Evacuate.
+      phase.next(GCPhases::Copy);
+      for (Arena* e : evacuating)
+      {
+        auto evacuate = [this](Object* obj) {
+          if (obj->get_class() != Object::MARKED)
+            return;
+
+          size_t sz = snmalloc::bits::align_up(obj->size(), Object::ALIGNMENT);
+          if (last_arena == nullptr || last_arena->free_space() < sz)
+            add_arena(sz);
+
+          Object* n = last_arena->alloc_obj(obj->get_descriptor(), sz);
+          std::memcpy(n->real_start(), obj->real_start(), sz);
+          GCPhases::copied(sz);
+          n->init_next(nullptr);
+          if (n->has_ext_ref())
+            ExternalReferenceTable::move(obj, n);
+          obj->set_forwarding_pointer(n);
+        };
+        for_each_in(e->objects_begin(), e->objects_end, evacuate);
+        for_each_in(e->non_trivial_begin, e->non_trivial_end, evacuate);
+      }
+
+      // Phase 6: Fix up the fields of every survivor.
+      phase.next(GCPhases::UpdatePointers);
+      gc_evacuating_ = &evacuating;
+      for (p = get_next(); p != o; p = p->get_next_any_mark())
+        fix_fields(p);
+      fix_fields(o);
+
+      auto fix_kept = [](Object* obj) {
+        if (obj->get_class() == Object::MARKED)
+        {
+          fix_fields(obj);
+          obj->unmark();
+        }
+      };
+      for (a = first_arena; a != nullptr; a = a->next)
+      {
+        for_each_in(a->objects_begin(), a->objects_end, fix_kept);
+        for_each_in(a->non_trivial_begin, a->non_trivial_end, fix_kept);
+      }
+
+      auto fix_moved = [](Object* obj) {
+        if (obj->get_class() == Object::MARKED)
+          fix_fields(forwarding_target(obj));
+      };
+      for (Arena* e : evacuating)
+      {
+        for_each_in(e->objects_begin(), e->objects_end, fix_moved);
+        for_each_in(e->non_trivial_begin, e->non_trivial_end, fix_moved);
+      }
+      gc_evacuating_ = nullptr;
+
+      // Phase 7: Retire the evacuated arenas.
+      phase.next(GCPhases::Sweep);
+      for (Arena* e : evacuating)
+        retire_arena(e);
+
+      Logging::cout() << "Arena GC: evacuated " << evacuating.size()
+                      << " arenas" << Logging::endl;
+
+      phase.next(GCPhases::Stats);
+      current_memory_used = o->size() + live_bytes;
+      region_size = 1 + live_objects;
+      non_trivial_size = (o->is_trivial() ? 0 : 1) + live_non_trivial;
+      gc_after = current_memory_used;
+
+      phase.next(GCPhases::Sweep);
+      RememberedSet::sweep();
+
+      Logging::cout() << "Arena GC complete. Iso (pinned): " << o
+                      << Logging::endl;
+    }
+
+    /**
+     * Mark every object reachable from the Iso Object `o`, and add up the
+     * size and number of the objects marked.
+     **/
+    void mark_live(
+      Object* o,
+      size_t& live_bytes,
+      size_t& live_objects,
+      size_t& live_non_trivial)
+    {
+      ObjectStack grey;
+      o->trace(grey);
+      while (!grey.empty())
+      {
+        Object* p = grey.pop();
+        switch (p->get_class())
+        {
+          case Object::ISO:
+          case Object::MARKED:
+            break;
+
+          case Object::UNMARKED:
+            p->mark();
+            live_bytes += p->size();
+            live_objects++;
+            if (!p->is_trivial())
+              live_non_trivial++;
+            HeapProfile::count(p);
+            p->trace(grey);
+            break;
+
+          case Object::SCC_PTR:
+            RememberedSet::mark(p->immutable());
+            break;
+
+          case Object::RC:
+          case Object::SHARED:
+            RememberedSet::mark(p);
+            break;
+
+          default:
+            assert(0);
+        }
+      }
+    }
+
+    /**
+     * Whether a collection evacuates the arena `a`: it is less than
+     * EVACUATE_OCCUPANCY percent live, or it has a dead non-trivial object,
+     * which cannot be left behind as filler.
+     **/
+    static bool should_evacuate(Arena* a)
+    {
+      size_t live = 0;
+      bool dead_non_trivial = false;
+      for_each_in(a->objects_begin(), a->objects_end, [&live](Object* p) {
+        if (p->get_class() == Object::MARKED)
+          live += snmalloc::bits::align_up(p->size(), Object::ALIGNMENT);
+      });
+      for_each_in(
+        a->non_trivial_begin,
+        a->non_trivial_end,
+        [&live, &dead_non_trivial](Object* p) {
+          if (p->get_class() == Object::MARKED)
+            live += snmalloc::bits::align_up(p->size(), Object::ALIGNMENT);
+          else
+            dead_non_trivial = true;
+        });
+
+      size_t usable = a->chunk_size() - sizeof(Arena);
+      return dead_non_trivial || (live * 100 < usable * EVACUATE_OCCUPANCY);
+    }
+
+    /**
+     * Call `f` on each dead object in the arenas `evacuating` and in the
+     * large object ring, or only on the non-trivial ones if `type` is
+     * NonTrivial. With AllObjects, also on the dead objects left as filler
+     * in the kept arenas.
+     **/
+    template<IteratorType type, typename F>
+    void for_each_dead(const std::vector<Arena*>& evacuating, F f)
+    {
+      static_assert(type == NonTrivial || type == AllObjects);
+
+      auto dead = [&f](Object* p) {
+        if (p->get_class() == Object::UNMARKED)
+          f(p);
+      };
+
+      for (Arena* a : evacuating)
+      {
+        if constexpr (type == AllObjects)
+          for_each_in(a->objects_begin(), a->objects_end, dead);
+        for_each_in(a->non_trivial_begin, a->non_trivial_end, dead);
+      }
+
+      if constexpr (type == AllObjects)
+      {
+        for (Arena* a = first_arena; a != nullptr; a = a->next)
+          for_each_in(a->objects_begin(), a->objects_end, dead);
+      }
+
+      // The Iso is last in the ring, and is never dead.
+      for (Object* p = get_next(); p != this; p = p->get_next_any_mark())
+      {
+        if (type == AllObjects || !p->is_trivial())
+          dead(p);
+      }
+    }
+
+    /**
+     * Forwarding callback passed to Descriptor::relocate: the new address
+     * of a survivor in an evacuated arena, or the reference unchanged.
+     **/
+    static Object* forward(Object* field)
+    {
+      auto& evacuating = *gc_evacuating_;
+      auto addr = (std::byte*)field;
+      auto it = std::upper_bound(
+        evacuating.begin(), evacuating.end(), addr, [](std::byte* x, Arena* a) {
+          return x < (std::byte*)a;
+        });
+      if (it == evacuating.begin())
+        return field;
+
+      Arena* a = *(it - 1);
+      if (addr <= a->objects_begin() || addr >= a->non_trivial_end)
+        return field;
+      if (field->get_class() != Object::MARKED)
+        return field;
+      return forwarding_target(field);
+    }
+
+    static Object* forwarding_target(Object* o)
+    {
+      assert(o->get_class() == Object::MARKED);
+      return (Object*)(o->get_header().bits & ~Object::MASK);
+    }
+
+    /**
+     * Point the fields of `obj` at the new addresses of the objects they
+     * reference. Without a pointer map or a `relocate` function, this is a
+     * best-effort scan of the body that rewrites each word holding the
+     * address of a survivor in an evacuated arena; it can theoretically
+     * produce false positives if a non-pointer integer field coincidentally
+     * matches such an address.
+     **/
+    static void fix_fields(Object* obj)
+    {
+      if (obj->relocate_mapped(forward))
+        return;
+
+      auto* descriptor = obj->get_descriptor();
+      if (descriptor->relocate != nullptr)
+      {
+        descriptor->relocate(obj, forward);
+        return;
+      }
+
+      size_t body_size = obj->size() - sizeof(Object::Header);
+      auto* body = (Object**)obj;
+      size_t num_words = body_size / sizeof(Object*);
+      for (size_t i = 0; i < num_words; i++)
+      {
+        Object* word = body[i];
+        if (word != nullptr)
+          body[i] = forward(word);
+      }
     }
 
     void merge_internal(RegionArena* other)
@@ -516,9 +1713,19 @@ namespace verona::rt
       if (head != other)
         append(head, other->last_large);
 
+      other->release_spare_arenas();
+
       // Merge memory tracking
       current_memory_used += other->current_memory_used;
       region_size += other->region_size;
+      non_trivial_size += other->non_trivial_size;
+      arena_count += other->arena_count;
+
+      // Carry on growing arenas from the larger of the two schedules.
+      if (other->next_chunk_size > next_chunk_size)
+        next_chunk_size = other->next_chunk_size < max_chunk_size ?
+          other->next_chunk_size :
+          max_chunk_size;
 
       assert(last_arena != nullptr ? last_arena->next == nullptr : true);
       assert(
@@ -533,7 +1740,11 @@ namespace verona::rt
       size_t nroot_size =
         snmalloc::bits::align_up(nroot->size(), Object::ALIGNMENT);
 
-      if (oroot_size <= Arena::SIZE)
+      // A collection must not move the Iso.
+      if (collectable && nroot_size <= Arena::SIZE)
+        abort();
+
+      if (!collectable && oroot_size <= Arena::SIZE)
       {
         // Old root is inside an arena, so we set its next to nullptr.
         oroot->init_next(nullptr);
@@ -612,13 +1823,19 @@ namespace verona::rt
       }
 
       // Deallocate arenas.
+      size_t chunk_bytes = 0;
+      size_t wasted_bytes = get_wasted_bytes();
       Arena* arena = first_arena;
       while (arena != nullptr)
       {
         Arena* q = arena->next;
-        heap::dealloc<sizeof(Arena)>(arena);
+        chunk_bytes += arena->chunk_size();
+        Arena::destroy(arena);
         arena = q;
       }
+      released_chunk_bytes_.fetch_add(chunk_bytes, std::memory_order_relaxed);
+      released_wasted_bytes_.fetch_add(wasted_bytes, std::memory_order_relaxed);
+      release_spare_arenas();
 
       // Sweep the RememberedSet, to ensure destructors are called.
       RememberedSet::sweep();
@@ -698,7 +1915,7 @@ namespace verona::rt
         std::byte* q = ptr->real_start() + sz;
         if constexpr (type == Trivial)
         {
-          assert(q > arena->objects_begin && q <= arena->objects_end);
+          assert(q > arena->objects_begin() && q <= arena->objects_end);
 
           // We have not yet reached the end, so q is valid.
           if (q != arena->objects_end)
@@ -715,7 +1932,7 @@ namespace verona::rt
         else if constexpr (type == AllObjects)
         {
           assert(
-            (q > arena->objects_begin && q <= arena->objects_end) ||
+            (q > arena->objects_begin() && q <= arena->objects_end) ||
             (q > arena->non_trivial_begin && q <= arena->non_trivial_end));
 
           // We have not yet reached either end, so q is valid.
@@ -766,15 +1983,15 @@ namespace verona::rt
         while (arena != nullptr)
         {
           assert(
-            arena->objects_begin < arena->objects_end ||
+            arena->objects_begin() < arena->objects_end ||
             arena->non_trivial_begin < arena->non_trivial_end);
           assert(arena->debug_invariant());
           if constexpr (type == Trivial || type == AllObjects)
           {
-            if (arena->objects_begin != arena->objects_end)
+            if (arena->objects_begin() != arena->objects_end)
               // objects_begin points to header of first object.
               // we return the actually Object*.
-              return Object::object_start(arena->objects_begin);
+              return Object::object_start(arena->objects_begin());
           }
           if constexpr (type == NonTrivial || type == AllObjects)
           {
@@ -828,6 +2045,48 @@ namespace verona::rt
       return {this, nullptr, nullptr};
     }
 
+    /**
+     * Call `f` on each object of the region with descriptor `desc`. Only
+     * the section of each arena that holds objects of its kind, trivial or
+     * not, is walked, in a loop that compares descriptors and steps over
+     * matches by their known size. `f` must not allocate in the region.
+     **/
+    template<typename F>
+    void for_each_of(const Descriptor* desc, F f)
+    {
+      // Objects of a type without a trailing array all have the same size.
+      size_t step = (desc->tail == 0) ?
+        snmalloc::bits::align_up(desc->size, Object::ALIGNMENT) :
+        0;
+      bool trivial = Object::is_trivial(desc);
+      for (Arena* a = first_arena; a != nullptr; a = a->next)
+      {
+        std::byte* p = trivial ? a->objects_begin() : a->non_trivial_begin;
+        std::byte* end = trivial ? a->objects_end : a->non_trivial_end;
+        while (p != end)
+        {
+          Object* o = Object::object_start(p);
+          if (o->get_descriptor() != desc)
+          {
+            p += snmalloc::bits::align_up(o->size(), Object::ALIGNMENT);
+            continue;
+          }
+          p += (step != 0) ?
+            step :
+            snmalloc::bits::align_up(o->size(), Object::ALIGNMENT);
+          f(o);
+        }
+      }
+
+      for (Object* o = get_next(); o != this;)
+      {
+        Object* q = o->get_next_any_mark();
+        if (o->get_descriptor() == desc)
+          f(o);
+        o = q;
+      }
+    }
+
   private:
     bool debug_is_in_region(Object* o)
     {
@@ -5,8 +5,11 @@
 #include <atomic>
 #include <functional>
 
+#include "../debug/eventtrace.h"
 #include "../object/object.h"
 #include "externalreference.h"
+#include "gc_policy.h"
+#include "region_quota.h"
 #include "rememberedset.h"
 
 namespace verona::rt
@@ -28,6 +31,9 @@ namespace verona::rt
     Arena,
     Rc,
     SemiSpace,
+    Generational,
+    Compact,
+    Bytes,
   };
 
 
@@ -40,6 +46,9 @@ namespace verona::rt
     friend class RegionArena;
     friend class RegionRc;
     friend class RegionSemiSpace;
+    friend class RegionGenerational;
+    friend class RegionCompact;
+    friend class RegionBytes;
 
   public:
     enum IteratorType
@@ -60,14 +69,44 @@ namespace verona::rt
     std::atomic<size_t> owners{1};
     std::atomic<bool> isAlive{true};
 
-    RegionBase() : Object() {
+    /// Decides when api::region_maybe_collect() collects this region.
+    GCPolicy gc_policy = GCPolicy::get_default();
+
+    /// Whether a collection at close was deferred, and has not run since.
+    bool collect_deferred = false;
+
+    /// Whether the deferred collection is waiting for an idle thread or a
+    /// GCPacer (see schedule_idle_collect() and schedule_paced_collect()).
+    bool collect_idle_queued = false;
+
+    /// Limits the memory api::create_object() lets this region use.
+    RegionQuota quota = RegionQuota::get_default();
+
+    /// The kind of region this is, so that it can be found with one load
+    /// instead of comparing descriptors.
+    const RegionType region_type;
+
+    /// The allocation this metadata shares with the Iso object it was
+    /// created with, or nullptr if it has one of its own.
+    CoAllocation* co_allocation = nullptr;
+
+    /// Where the region was created (see local_home()), so that its
+    /// release can be sent back there (see Region::release()).
+    void* home = local_home();
+
+    RegionBase(RegionType type) : Object(), region_type(type) {
       //void* space = heap::alloc(sizeof(std::atomic<RegReleaseControl>));
       //release_control = new (space) std::atomic<RegReleaseControl>();
     }
 
     inline bool task_dec() {
       int old_refcount = owners.fetch_sub(1, std::memory_order_acq_rel);
-      Logging::cout() << "in task_dec: old_refcount = " << old_refcount << "\n";
+      if constexpr (Logging::enabled)
+        Logging::cout() << "in task_dec: old_refcount = " << old_refcount
+                        << Logging::endl;
+      if constexpr (EventTrace::enabled)
+        EventTrace::record(
+          EventTrace::Event::TaskDec, (uintptr_t)this, (uint64_t)old_refcount);
       if (old_refcount == 1) {
         // actually free the region
         return true;
@@ -75,8 +114,32 @@ namespace verona::rt
       return false;
     }
     inline void task_inc() {
-      owners.fetch_add(1, std::memory_order_relaxed);
-      Logging::cout() << "task_inc\n";
+      [[maybe_unused]] size_t old_refcount =
+        owners.fetch_add(1, std::memory_order_relaxed);
+      if constexpr (Logging::enabled)
+        Logging::cout() << "task_inc" << Logging::endl;
+      if constexpr (EventTrace::enabled)
+        EventTrace::record(
+          EventTrace::Event::TaskInc, (uintptr_t)this, (uint64_t)old_refcount);
+    }
+
+    /**
+     * Release the regions whose Isos are in `collect`, of any type, and the
+     * regions found while doing so, through the one worklist. Defined in
+     * region.h, which knows every region type, so that a region can release
+     * the subregions it finds without depending on the other regions.
+     **/
+    static inline void release_collected(ObjectStack& collect);
+
+    /**
+     * Where regions created on this thread are at home: the core of the
+     * scheduler thread running on it, which that thread sets, or nullptr.
+     * Opaque here, as regions do not depend on the scheduler.
+     **/
+    static void*& local_home()
+    {
+      static thread_local void* home = nullptr;
+      return home;
     }
 
     private:
@@ -85,24 +148,73 @@ namespace verona::rt
     {
       ExternalReferenceTable::dealloc();
       RememberedSet::dealloc();
-      Object::dealloc();
+      if (co_allocation != nullptr)
+        co_allocation->release();
+      else
+        Object::dealloc();
+    }
+
+    /**
+     * Allocate the metadata of a region of type R, of `size` bytes, with
+     * room for its Iso of `iso_size` bytes after it if this platform allows
+     * it. Returns the metadata, and sets `iso` to the memory for the Iso,
+     * or nullptr if the caller must allocate it. The caller must pass the
+     * Iso to place_iso() once it is registered.
+     **/
+    static void* alloc_with_iso(size_t size, size_t iso_size, void*& iso)
+    {
+      if constexpr (!Object::CAN_CO_ALLOCATE)
+      {
+        iso = nullptr;
+        return heap::alloc(size);
+      }
+      else
+      {
+        CoAllocation* c = CoAllocation::alloc(size, iso_size);
+        iso = c->second();
+        return c->start;
+      }
+    }
+
+    /// Record that `o` was allocated with this metadata by alloc_with_iso().
+    void place_iso(Object* o)
+    {
+      co_allocation = (CoAllocation*)o->real_start() - 1;
+      o->set_co_allocated();
     }
   };
 
-  // Callback for region GC/release operations
-  inline thread_local std::function<void(uint64_t, RegionType, size_t, size_t)>*
-    gc_callback = nullptr;
+  struct GCEvent;
 
-  inline void set_gc_callback(
-    std::function<void(uint64_t, RegionType, size_t, size_t)>* callback)
+  // Callback for region GC/release operations, given the GCEvent that
+  // with_region_stats() would otherwise record.
+  inline thread_local std::function<void(const GCEvent&)>* gc_callback =
+    nullptr;
+
+  inline void set_gc_callback(std::function<void(const GCEvent&)>* callback)
   {
     gc_callback = callback;
   }
 
-  inline std::function<void(uint64_t, RegionType, size_t, size_t)>*
-  get_gc_callback()
+  inline std::function<void(const GCEvent&)>* get_gc_callback()
   {
     return gc_callback;
   }
 
+  // Like gc_callback, but a plain function, which is cheaper to call.
+  // Given the event in its place when set.
+  using GCSink = void (*)(const GCEvent&);
+
+  inline thread_local GCSink gc_sink = nullptr;
+
+  inline void set_gc_sink(GCSink sink)
+  {
+    gc_sink = sink;
+  }
+
+  inline GCSink get_gc_sink()
+  {
+    return gc_sink;
+  }
+
 } // namespace verona::rt
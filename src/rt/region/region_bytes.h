@@ -0,0 +1,260 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include "../object/object.h"
+#include "../pal/virtual_memory.h"
+#include "region_base.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+namespace verona::rt
+{
+  using namespace snmalloc;
+
+  /**
+   * A view of `size` bytes at `data`, owned by a byte-buffer region (see
+   * RegionBytes). It is valid while the region is, wherever the region's
+   * Iso is moved to.
+   **/
+  struct ByteView
+  {
+    std::byte* data = nullptr;
+    size_t size = 0;
+
+    /**
+     * The `length` bytes at `offset` in this view. Aborts if they are not
+     * all within it.
+     **/
+    ByteView slice(size_t offset, size_t length) const
+    {
+      if (offset > size || length > size - offset)
+        abort();
+      return {data + offset, length};
+    }
+
+    /**
+     * The bytes from `offset` to the end of this view.
+     **/
+    ByteView slice(size_t offset) const
+    {
+      if (offset > size)
+        abort();
+      return {data + offset, size - offset};
+    }
+
+    bool empty() const
+    {
+      return size == 0;
+    }
+  };
+
+  /**
+   * Please see region.h for the full documentation.
+   *
+   * This is a region that holds one contiguous buffer of raw bytes, for
+   * payloads that would otherwise live in a `std::vector` or `std::string`
+   * outside region accounting. The buffer is untraced: it holds no
+   * references, and no collection runs over it. The region's Iso is an
+   * ordinary object of the caller's type, which can describe the payload,
+   * and which is allocated on the heap next to the metadata.
+   *
+   * Moving the Iso between cowns moves the buffer with it, so a payload
+   * passes between behaviours without a copy. Slices of the buffer are
+   * taken as ByteViews (see view()).
+   *
+   * A page-aligned buffer is mapped from the OS on its own and starts on a
+   * page. Its pages can be given back to the OS while the region lives
+   * (see release_pages()), for instance once a prefix has been consumed.
+   * Other buffers come from the heap.
+   *
+   * Objects cannot be allocated in the region, and it can be neither
+   * merged nor frozen.
+   **/
+  class RegionBytes : public RegionBase
+  {
+  public:
+    /// Granularity of page-aligned buffers and of release_pages().
+    static constexpr size_t PAGE_SIZE = 4096;
+
+  private:
+    friend class Region;
+
+    /// The buffer, its size in bytes, and the size of its allocation.
+    std::byte* buffer = nullptr;
+    size_t buffer_size;
+    size_t buffer_capacity;
+    bool page_aligned;
+
+    /// The iso (root) object, which never moves.
+    Object* root_ = nullptr;
+
+    RegionBytes(size_t size, bool page_aligned)
+    : RegionBase(RegionType::Bytes),
+      buffer_size(size),
+      buffer_capacity(
+        page_aligned ? bits::align_up(std::max<size_t>(size, 1), PAGE_SIZE) :
+                       std::max<size_t>(size, 1)),
+      page_aligned(page_aligned)
+    {
+      if (page_aligned)
+      {
+        buffer = (std::byte*)pal::vm_reserve(buffer_capacity);
+        if (buffer == nullptr)
+          abort();
+        pal::vm_commit(buffer, buffer_capacity);
+      }
+      else
+      {
+        buffer = (std::byte*)heap::alloc(buffer_capacity);
+      }
+    }
+
+    static const Descriptor* desc()
+    {
+      static constexpr Descriptor desc = {
+        vsizeof<RegionBytes>, nullptr, nullptr, nullptr};
+      return &desc;
+    }
+
+  public:
+    inline static RegionBytes* get(Object* o)
+    {
+      assert(o->debug_is_iso());
+      assert(is_bytes_region(o->get_region()));
+      return (RegionBytes*)o->get_region();
+    }
+
+    inline static bool is_bytes_region(Object* o)
+    {
+      return o->is_type(desc());
+    }
+
+    /**
+     * Returns the size of the buffer's allocation and of the root. Pages
+     * given back by release_pages() still count, as they take memory again
+     * once written.
+     **/
+    size_t get_current_memory_used() const
+    {
+      return root_->size() + buffer_capacity;
+    }
+
+    size_t get_region_size() const
+    {
+      return 1;
+    }
+
+    size_t get_non_trivial_size() const
+    {
+      return root_->is_trivial() ? 0 : 1;
+    }
+
+    /**
+     * Creates a new byte-buffer region of `size` bytes, zeroed, whose Iso
+     * is an object of type `desc`, and returns the Iso. With `page_aligned`
+     * the buffer starts on a page and its pages can be released.
+     **/
+    static Object*
+    create(const Descriptor* desc, size_t size, bool page_aligned = false)
+    {
+      size_t sz = bits::align_up(desc->size, Object::ALIGNMENT);
+      void* iso_mem = nullptr;
+      void* p = alloc_with_iso(vsizeof<RegionBytes>, sz, iso_mem);
+      Object* o = Object::register_object(p, RegionBytes::desc());
+      auto reg = new (o) RegionBytes(size, page_aligned);
+      if (!page_aligned)
+        memset(reg->buffer, 0, reg->buffer_capacity);
+
+      bool co_allocated = iso_mem != nullptr;
+      if (!co_allocated)
+        iso_mem = heap::alloc(sz);
+      Object* iso = Object::register_object(iso_mem, desc);
+      assert(Object::debug_is_aligned(iso));
+      if (co_allocated)
+        reg->place_iso(iso);
+
+      iso->init_iso();
+      iso->set_region(reg);
+      reg->root_ = iso;
+      return iso;
+    }
+
+    /**
+     * The whole buffer of the region whose Iso is `in`.
+     **/
+    static ByteView view(Object* in)
+    {
+      RegionBytes* reg = get(in);
+      return {reg->buffer, reg->buffer_size};
+    }
+
+    /**
+     * Give the whole pages within the `length` bytes at `offset` in the
+     * buffer of `in`'s region back to the OS. They read as zero afterwards,
+     * and take memory again only once written. Aborts unless the buffer is
+     * page-aligned.
+     *
+     * Returns the number of bytes released.
+     **/
+    static size_t release_pages(Object* in, size_t offset, size_t length)
+    {
+      RegionBytes* reg = get(in);
+      if (!reg->page_aligned)
+        abort();
+      if (offset > reg->buffer_capacity)
+        abort();
+      length = std::min(length, reg->buffer_capacity - offset);
+
+      size_t start = bits::align_up(offset, PAGE_SIZE);
+      size_t end = bits::align_down(offset + length, PAGE_SIZE);
+      if (start >= end)
+        return 0;
+
+      // Decommitting drops the pages, and recommitting only makes the
+      // range accessible again; the OS backs it lazily with zero pages.
+      pal::vm_decommit(reg->buffer + start, end - start);
+      pal::vm_commit(reg->buffer + start, end - start);
+      return end - start;
+    }
+
+    /**
+     * Returns whether the buffer of this region is page-aligned.
+     **/
+    bool is_page_aligned() const
+    {
+      return page_aligned;
+    }
+
+  private:
+    void release_internal(Object* o, ObjectStack& collect)
+    {
+      assert(o->debug_is_iso());
+      assert(o == root_);
+
+      Logging::cout() << "Region release: bytes region: " << o
+                      << Logging::endl;
+
+      if (!root_->is_trivial())
+      {
+        root_->finalise(o, collect);
+        root_->destructor();
+      }
+      root_->dealloc();
+      root_ = nullptr;
+
+      if (page_aligned)
+        pal::vm_release(buffer, buffer_capacity);
+      else
+        heap::dealloc(buffer, buffer_capacity);
+      buffer = nullptr;
+
+      RememberedSet::sweep();
+
+      dealloc();
+    }
+  };
+} // namespace verona::rt
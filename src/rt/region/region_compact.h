@@ -0,0 +1,654 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include "../object/object.h"
+#include "gc_phases.h"
+#include "heap_profile.h"
+#include "region_base.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+namespace verona::rt
+{
+  using namespace snmalloc;
+
+  /**
+   * Please see region.h for the full documentation.
+   *
+   * This is a concrete implementation of a region using a Lisp-2 style
+   * mark-compact (sliding) garbage collector. This class inherits from
+   * RegionBase.
+   *
+   * Objects are bump-allocated in a single space, as in a semi-space
+   * region, but there is no second space to copy into: a collection moves
+   * the survivors down to the start of the space, in place and in
+   * allocation order. It runs in four passes:
+   *   - mark everything reachable from the root;
+   *   - walk the space and give every marked object its new address, which
+   *     is stored as a forwarding pointer in its header word (a mutable
+   *     object of this region does not otherwise use it);
+   *   - rewrite the fields of the root and of every marked object through
+   *     Descriptor::relocate;
+   *   - walk the space again and slide each marked object to its address.
+   *
+   * A survivor only ever moves towards the start of the space, so sliding
+   * in address order never overwrites an object that has not moved yet.
+   *
+   * After marking, the size of the space for the next cycle is chosen from
+   * the live bytes, so that they fill at most half of it. If that differs
+   * from the current size, the survivors are slid into a new space of that
+   * size instead, and the old space is freed. Only then are two spaces
+   * allocated at once.
+   *
+   * As in the semi-space region, the iso root is heap-allocated and
+   * pinned, allocation that finds the space full runs a collection (see
+   * ensure_available()), and non-trivial objects are recorded in a side
+   * table so that dead trivial objects are never touched.
+   **/
+  class RegionCompact : public RegionBase
+  {
+  public:
+    template<RegionBase::IteratorType type>
+    class iterator;
+
+    // Initial size of the space.
+    static constexpr size_t INITIAL_SPACE_SIZE = 1024 * 1024;
+
+  private:
+    friend class Region;
+
+    /// The space objects are allocated in.
+    std::byte* space;
+    size_t space_size;
+
+    /// Bump pointer and end of the space.
+    std::byte* alloc_ptr;
+    std::byte* alloc_end;
+
+    /// Side table of the non-trivial objects in the space.
+    StackThin<Object> non_trivial{};
+
+    /// The iso (root) object, heap-allocated and pinned.
+    Object* pinned_iso_ = nullptr;
+
+    /// Total memory used by objects (for metrics).
+    size_t current_memory_used = 0;
+
+    /// Number of objects currently in the region, and of those that are
+    /// non-trivial (for metrics).
+    size_t region_size = 0;
+    size_t non_trivial_size = 0;
+
+    explicit RegionCompact(size_t initial_size)
+    : RegionBase(RegionType::Compact), space_size(initial_size)
+    {
+      space = (std::byte*)heap::alloc(space_size);
+      alloc_ptr = space;
+      alloc_end = space + space_size;
+    }
+
+    static const Descriptor* desc()
+    {
+      static constexpr Descriptor desc = {
+        vsizeof<RegionCompact>, nullptr, nullptr, nullptr};
+      return &desc;
+    }
+
+  public:
+    inline static RegionCompact* get(Object* o)
+    {
+      assert(o->debug_is_iso());
+      assert(is_compact_region(o->get_region()));
+      return (RegionCompact*)o->get_region();
+    }
+
+    inline static bool is_compact_region(Object* o)
+    {
+      return o->is_type(desc());
+    }
+
+    size_t get_current_memory_used() const
+    {
+      return current_memory_used;
+    }
+
+    size_t get_region_size() const
+    {
+      return region_size;
+    }
+
+    size_t get_non_trivial_size() const
+    {
+      return non_trivial_size;
+    }
+
+    /**
+     * Returns the size of the space.
+     **/
+    size_t get_space_size() const
+    {
+      return space_size;
+    }
+
+    /**
+     * Returns the number of bytes bump-allocated in the space.
+     **/
+    size_t get_space_used() const
+    {
+      return static_cast<size_t>(alloc_ptr - space);
+    }
+
+    /**
+     * Creates a new compacting region by allocating Object `o` of type
+     * `desc`. The object is initialised as the Iso object for that region.
+     * Returns a pointer to `o`.
+     *
+     * The space starts large enough for `initial_size` bytes, rounded up as
+     * the sizing policy rounds sizes (see choose_space_size()).
+     **/
+    template<size_t size = 0>
+    static Object*
+    create(const Descriptor* desc, size_t initial_size = INITIAL_SPACE_SIZE)
+    {
+      void* p = heap::alloc<vsizeof<RegionCompact>>();
+      Object* o = Object::register_object(p, RegionCompact::desc());
+      auto reg =
+        new (o) RegionCompact(choose_space_size(0, 0, initial_size));
+
+      // The iso root is allocated on the heap so that it never moves.
+      size_t sz = snmalloc::bits::align_up(desc->size, Object::ALIGNMENT);
+      void* iso_mem = heap::alloc(sz);
+      Object* iso = Object::register_object(iso_mem, desc);
+      assert(Object::debug_is_aligned(iso));
+
+      iso->init_iso();
+      iso->set_region(reg);
+      reg->pinned_iso_ = iso;
+      reg->current_memory_used += desc->size;
+      reg->region_size += 1;
+      if (!iso->is_trivial())
+        reg->non_trivial_size += 1;
+
+      return iso;
+    }
+
+    /**
+     * Allocates an object of type `desc`, with a trailing array of `tail`
+     * elements, in the region represented by Iso object `in`. Returns a
+     * pointer to the new object.
+     **/
+    template<size_t size = 0>
+    static Object* alloc(Object* in, const Descriptor* desc, size_t tail = 0)
+    {
+      RegionCompact* reg = get(in);
+      Object* o = reg->alloc_internal(desc, tail);
+      assert(Object::debug_is_aligned(o));
+      return o;
+    }
+
+    /**
+     * Ensure that at least `bytes` of the space are available for future
+     * bump allocations, collecting if necessary. This does NOT allocate any
+     * objects.
+     *
+     * Call this before a batch of allocations so that none of them
+     * collects and invalidates earlier pointers. Objects not yet reachable
+     * from the root when the collection runs are reclaimed.
+     **/
+    static void ensure_available(Object* in, size_t bytes)
+    {
+      RegionCompact* reg = get(in);
+      if (bytes > static_cast<size_t>(reg->alloc_end - reg->alloc_ptr))
+        gc(in, reg, bytes);
+    }
+
+    /**
+     * Insert the Object `o` into the RememberedSet of `into`'s region.
+     **/
+    template<TransferOwnership transfer = NoTransfer>
+    static void insert(Object* into, Object* o)
+    {
+      assert(o->debug_is_immutable() || o->debug_is_shared());
+      RegionCompact* reg = get(into);
+      Object::RegionMD c;
+      o = o->root_and_class(c);
+      reg->RememberedSet::insert<transfer>(o);
+    }
+
+    /**
+     * Swap the Iso (root) object of the region.
+     **/
+    static void swap_root(Object* prev, Object* next)
+    {
+      assert(prev != next);
+      assert(prev->debug_is_iso());
+      assert(next->debug_is_mutable());
+
+      prev->init_next(nullptr);
+      next->init_iso();
+      next->set_region(prev->get_region());
+    }
+
+    /**
+     * Run a mark-compact collection of the region whose pinned root is `o`.
+     *
+     * Algorithm:
+     *   1. Mark everything reachable from the root, entering immutable and
+     *      shared references into the remembered set.
+     *   2. Finalise, then destruct, the dead non-trivial objects.
+     *   3. Choose the space for the next cycle, and assign each marked
+     *      object its address in it, in allocation order.
+     *   4. Point the fields of the root and of every marked object at the
+     *      new addresses.
+     *   5. Slide the marked objects to their new addresses.
+     *
+     * A non-zero `reserve` is the number of free bytes the space must have
+     * afterwards.
+     **/
+    static Object* gc(Object* o, RegionCompact* reg, size_t reserve = 0)
+    {
+      assert(o->debug_is_iso());
+      assert(o == reg->pinned_iso_);
+
+      Logging::cout() << "Compact GC called for: " << o << Logging::endl;
+
+      // Phase 1: Mark.
+      GCPhases::Scope phase(GCPhases::Mark);
+      size_t live_bytes = 0;
+      size_t live_objects = 0;
+      size_t survived = reg->mark(o, live_bytes, live_objects);
+
+      // Phase 2: Dead objects are the unmarked ones in the side table. Run
+      // all finalisers before any destructor. This also empties the table;
+      // phase 5 refills it with the new addresses of the survivors.
+      phase.next(GCPhases::Finalise);
+      {
+        ObjectStack dummy_isos;
+        reg->non_trivial.forall([&dummy_isos](Object* obj) {
+          if (obj->get_class() != Object::MARKED)
+            obj->finalise(nullptr, dummy_isos);
+        });
+
+        while (!reg->non_trivial.empty())
+        {
+          Object* obj = reg->non_trivial.pop();
+          if (obj->get_class() != Object::MARKED)
+          {
+            obj->destructor();
+            reg->non_trivial_size -= 1;
+          }
+        }
+      }
+
+      // Phase 3: Compute forwarding addresses.
+      phase.next(GCPhases::UpdatePointers);
+      size_t used = reg->get_space_used();
+      size_t next_size = choose_space_size(reg->space_size, survived, reserve);
+      std::byte* target = reg->space;
+      if (next_size != reg->space_size)
+        target = (std::byte*)heap::alloc(next_size);
+
+      std::byte* dest = target;
+      reg->walk_live([&dest](Object* obj, size_t sz) {
+        obj->set_forwarding_pointer(Object::object_start(dest));
+        dest += sz;
+      });
+
+      // Phase 4: Fix up the fields of the root and of every survivor.
+      gc_region_ = reg;
+      reg->fix_fields(o);
+      reg->walk_live([reg](Object* obj, size_t) { reg->fix_fields(obj); });
+      gc_region_ = nullptr;
+
+      // Phase 5: Slide.
+      phase.next(GCPhases::Copy);
+      reg->slide();
+      if (target != reg->space)
+      {
+        heap::dealloc(reg->space, reg->space_size);
+        reg->space = target;
+        reg->space_size = next_size;
+      }
+      reg->alloc_ptr = dest;
+      reg->alloc_end = reg->space + reg->space_size;
+      assert(reg->get_space_used() == survived);
+
+      Logging::cout() << "Compact sizing: survived " << survived << " of "
+                      << used << " bytes, size " << reg->space_size
+                      << Logging::endl;
+
+      reg->current_memory_used = o->size() + live_bytes;
+      reg->region_size = 1 + live_objects;
+
+      reg->RememberedSet::sweep();
+
+      Logging::cout() << "Compact GC complete. Iso (pinned): " << o
+                      << Logging::endl;
+      return o;
+    }
+
+  private:
+    /**
+     * Sizing policy: the size of the space for the cycle after a
+     * collection that left `live` bytes in a space of `current` bytes.
+     * Sizes are power-of-two multiples of INITIAL_SPACE_SIZE at which live
+     * data and `reserve` fill at most half the space. The space shrinks
+     * only once that size is a quarter of the current one, so a live size
+     * near a boundary does not make it flip back and forth.
+     **/
+    static size_t choose_space_size(size_t current, size_t live, size_t reserve)
+    {
+      size_t target = INITIAL_SPACE_SIZE;
+      while (target < 2 * live || target < live + reserve)
+        target *= 2;
+
+      if (target > current || target <= current / 4)
+        return target;
+      return current;
+    }
+
+    Object* alloc_internal(const Descriptor* desc, size_t tail)
+    {
+      size_t size = Object::size_of(desc, tail);
+      size_t sz = snmalloc::bits::align_up(size, Object::ALIGNMENT);
+
+      // Collecting recomputes the metrics, so count this object after.
+      if (alloc_ptr + sz > alloc_end)
+        gc(pinned_iso_, this, sz);
+      current_memory_used += size;
+      region_size += 1;
+
+      void* p = alloc_ptr;
+      alloc_ptr += sz;
+      Object* o = Object::register_object(p, desc);
+      o->init_tail(tail);
+      o->init_next(nullptr);
+      if (!Object::is_trivial(desc))
+      {
+        non_trivial.push(o);
+        non_trivial_size += 1;
+      }
+      return o;
+    }
+
+    bool in_space(Object* o) const
+    {
+      auto addr = (std::byte*)o->real_start();
+      return addr >= space && addr < alloc_ptr;
+    }
+
+    /**
+     * Mark every object reachable from the root `o`, and add up the size
+     * and number of the objects marked. Returns the bytes of the space the
+     * marked objects occupy.
+     **/
+    size_t mark(Object* o, size_t& live_bytes, size_t& live_objects)
+    {
+      size_t survived = 0;
+      ObjectStack grey;
+      o->trace(grey);
+      while (!grey.empty())
+      {
+        Object* p = grey.pop();
+        switch (p->get_class())
+        {
+          case Object::ISO:
+          case Object::MARKED:
+            break;
+
+          case Object::UNMARKED:
+            assert(in_space(p));
+            p->mark();
+            live_bytes += p->size();
+            live_objects++;
+            HeapProfile::count(p);
+            survived +=
+              snmalloc::bits::align_up(p->size(), Object::ALIGNMENT);
+            p->trace(grey);
+            break;
+
+          case Object::SCC_PTR:
+            RememberedSet::mark(p->immutable());
+            break;
+
+          case Object::RC:
+          case Object::SHARED:
+            RememberedSet::mark(p);
+            break;
+
+          default:
+            assert(0);
+        }
+      }
+      return survived;
+    }
+
+    /**
+     * Call `f(obj, size)` on every marked object of the space, in address
+     * order, where `size` is the space the object occupies.
+     **/
+    template<typename F>
+    void walk_live(F f)
+    {
+      for (std::byte* p = space; p < alloc_ptr;)
+      {
+        Object* obj = Object::object_start(p);
+        size_t sz = snmalloc::bits::align_up(obj->size(), Object::ALIGNMENT);
+        if (obj->get_class() == Object::MARKED)
+          f(obj, sz);
+        p += sz;
+      }
+    }
+
+    /// Collection in progress on this thread, for the forward callback,
+    /// which Descriptor::relocate gives no context argument.
+    static inline thread_local RegionCompact* gc_region_ = nullptr;
+
+    /**
+     * Forwarding callback passed to Descriptor::relocate: the new address
+     * of a survivor in the space, or the reference unchanged.
+     **/
+    static Object* forward(Object* field)
+    {
+      if (gc_region_->in_space(field) && field->get_class() == Object::MARKED)
+        return forwarding_target(field);
+      return field;
+    }
+
+    static Object* forwarding_target(Object* o)
+    {
+      assert(o->get_class() == Object::MARKED);
+      return (Object*)(o->get_header().bits & ~Object::MASK);
+    }
+
+    /**
+     * Point the fields of `obj` at the new addresses of the objects they
+     * reference. Without a `relocate` function, this is a best-effort scan
+     * of the body that rewrites each word holding the address of a marked
+     * object of the space; it can theoretically produce false positives if
+     * a non-pointer integer field coincidentally matches such an address.
+     **/
+    void fix_fields(Object* obj)
+    {
+      if (obj->relocate_mapped(forward))
+        return;
+
+      auto* descriptor = obj->get_descriptor();
+      if (descriptor->relocate != nullptr)
+      {
+        descriptor->relocate(obj, forward);
+        return;
+      }
+
+      size_t body_size = obj->size() - sizeof(Object::Header);
+      auto* body = (Object**)obj;
+      size_t num_words = body_size / sizeof(Object*);
+      for (size_t i = 0; i < num_words; i++)
+      {
+        Object* word = body[i];
+        if (word != nullptr)
+          body[i] = forward(word);
+      }
+    }
+
+    /**
+     * Move every marked object to its forwarding address and clear its
+     * header, rebuilding the side table of non-trivial objects on the way.
+     * Forwarding addresses never exceed the current address, so each
+     * object is read before anything is moved over it.
+     **/
+    void slide()
+    {
+      for (std::byte* p = space; p < alloc_ptr;)
+      {
+        Object* obj = Object::object_start(p);
+        size_t sz = snmalloc::bits::align_up(obj->size(), Object::ALIGNMENT);
+        p += sz;
+        if (obj->get_class() != Object::MARKED)
+          continue;
+
+        Object* new_obj = forwarding_target(obj);
+        if (new_obj != obj)
+          GCPhases::copied(sz);
+        std::memmove(new_obj->real_start(), obj->real_start(), sz);
+        new_obj->init_next(nullptr);
+        if (!new_obj->is_trivial())
+          non_trivial.push(new_obj);
+      }
+    }
+
+    /**
+     * Release and deallocate all objects within the region.
+     **/
+    void release_internal(Object* o, ObjectStack& collect)
+    {
+      assert(o->debug_is_iso());
+
+      Logging::cout() << "Region release: compact region: " << o
+                      << Logging::endl;
+
+      // Finalisers first, while every object is still valid.
+      non_trivial.forall(
+        [o, &collect](Object* obj) { obj->finalise(o, collect); });
+      if (!pinned_iso_->is_trivial())
+        pinned_iso_->finalise(o, collect);
+
+      // Then destructors. Popping the side table also releases its blocks.
+      while (!non_trivial.empty())
+        non_trivial.pop()->destructor();
+      if (!pinned_iso_->is_trivial())
+        pinned_iso_->destructor();
+
+      pinned_iso_->dealloc();
+      pinned_iso_ = nullptr;
+      heap::dealloc(space, space_size);
+
+      RememberedSet::sweep();
+
+      dealloc();
+    }
+
+  public:
+    /**
+     * Iterator over all objects in the region: the pinned root, then the
+     * space in allocation order.
+     **/
+    template<IteratorType type = AllObjects>
+    class iterator
+    {
+      friend class RegionCompact;
+
+      static_assert(
+        type == Trivial || type == NonTrivial || type == AllObjects);
+
+      iterator(RegionCompact* r) : reg(r), space_ptr(r->space), ptr(nullptr)
+      {
+        if (matches_filter(reg->pinned_iso_))
+          ptr = reg->pinned_iso_;
+        else
+          advance();
+      }
+
+      iterator(RegionCompact* r, std::nullptr_t)
+      : reg(r), space_ptr(nullptr), ptr(nullptr)
+      {}
+
+    public:
+      iterator operator++()
+      {
+        if (ptr != reg->pinned_iso_)
+          space_ptr = ptr->real_start() +
+            snmalloc::bits::align_up(ptr->size(), Object::ALIGNMENT);
+        ptr = nullptr;
+        advance();
+        return *this;
+      }
+
+      inline bool operator!=(const iterator& other) const
+      {
+        return ptr != other.ptr;
+      }
+
+      inline Object* operator*() const
+      {
+        return ptr;
+      }
+
+    private:
+      RegionCompact* reg;
+      std::byte* space_ptr;
+      Object* ptr;
+
+      static bool matches_filter(Object* obj)
+      {
+        if constexpr (type == Trivial)
+          return obj->is_trivial();
+        else if constexpr (type == NonTrivial)
+          return !obj->is_trivial();
+        else
+          return true;
+      }
+
+      void advance()
+      {
+        while (space_ptr < reg->alloc_ptr)
+        {
+          Object* obj = Object::object_start(space_ptr);
+          if (matches_filter(obj))
+          {
+            ptr = obj;
+            return;
+          }
+          space_ptr += snmalloc::bits::align_up(obj->size(), Object::ALIGNMENT);
+        }
+      }
+    };
+
+    template<IteratorType type = AllObjects>
+    inline iterator<type> begin()
+    {
+      return {this};
+    }
+
+    template<IteratorType type = AllObjects>
+    inline iterator<type> end()
+    {
+      return {this, nullptr};
+    }
+
+  private:
+    bool debug_is_in_region(Object* o)
+    {
+      for (auto p : *this)
+      {
+        if (p == o)
+          return true;
+      }
+      return false;
+    }
+  };
+} // namespace verona::rt
@@ -0,0 +1,916 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include "../object/object.h"
+#include "alloc_sites.h"
+#include "gc_phases.h"
+#include "heap_profile.h"
+#include "region_base.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+
+namespace verona::rt
+{
+  using namespace snmalloc;
+
+  /**
+   * Please see region.h for the full documentation.
+   *
+   * This is a concrete implementation of a generational region. This class
+   * inherits from RegionBase.
+   *
+   * New objects are bump-allocated in a small semi-space nursery. Every
+   * collection is a minor collection: the live part of the nursery is copied
+   * Cheney-style into the other nursery half, and objects that have already
+   * survived `promotion_age` collections are promoted into the old
+   * generation instead. Old objects are allocated individually on the heap,
+   * kept in a null-terminated list and never move. Once the old generation
+   * has grown past `major_threshold`, the collection is a major one: the
+   * whole nursery is promoted and the old generation is mark-swept.
+   *
+   * Stores into a generational region's objects need not go through the
+   * write barrier in api::store(), so old-to-young pointers cannot be
+   * recorded in a remembered set. A minor collection instead treats every
+   * old object as a root and forwards the nursery pointers it holds.
+   * Long-lived objects are therefore read, but no longer copied, on each
+   * collection.
+   *
+   * A nursery object's age lives in its header word, which an UNMARKED
+   * nursery object does not otherwise use. Allocation never moves objects:
+   * objects above PRETENURE_THRESHOLD, and any object allocated while the
+   * nursery is full, go straight to the old generation. So, with
+   * pretenuring on (see AllocSites), do the objects of a type that keeps
+   * surviving collections, which saves copying them until they would be
+   * promoted. As in the semi-space region, the iso root is heap-allocated
+   * and pinned.
+   *
+   * Non-trivial nursery objects are recorded in a side table, so dead
+   * trivial nursery objects are never touched.
+   **/
+  class RegionGenerational : public RegionBase
+  {
+  public:
+    template<RegionBase::IteratorType type>
+    class iterator;
+
+    // Size of each nursery half.
+    static constexpr size_t NURSERY_SIZE = 256 * 1024;
+
+    // Objects larger than this are allocated in the old generation.
+    static constexpr size_t PRETENURE_THRESHOLD = NURSERY_SIZE / 8;
+
+    // Old-generation size that triggers the first major collection. Later
+    // thresholds are twice what survived the previous major collection.
+    static constexpr size_t INITIAL_MAJOR_THRESHOLD = 4 * 1024 * 1024;
+
+    static constexpr size_t DEFAULT_PROMOTION_AGE = 2;
+
+  private:
+    friend class Region;
+
+    /// Nursery half objects are allocated in.
+    std::byte* nursery_from;
+
+    /// Nursery half survivors are copied to.
+    std::byte* nursery_to;
+
+    /// Bump pointer and end of the nursery.
+    std::byte* alloc_ptr;
+    std::byte* alloc_end;
+
+    /// Side table of the non-trivial objects in the nursery.
+    StackThin<Object> nursery_non_trivial{};
+
+    /// Old generation, linked through Object::next. Null-terminated.
+    Object* old_objects = nullptr;
+    size_t old_bytes = 0;
+    size_t old_count = 0;
+
+    /// Old-generation size at which the next collection is a major one.
+    size_t major_threshold = INITIAL_MAJOR_THRESHOLD;
+
+    /// The iso (root) object, heap-allocated and pinned.
+    Object* pinned_iso_ = nullptr;
+
+    /// Total memory used by objects (for metrics).
+    size_t current_memory_used = 0;
+
+    /// Number of objects currently in the region, and of those that are
+    /// non-trivial (for metrics).
+    size_t region_size = 0;
+    size_t non_trivial_size = 0;
+
+    size_t minor_collections = 0;
+    size_t major_collections = 0;
+
+    /// Survival of the objects of each allocation site, while pretenuring
+    /// is on. Objects of a pretenured site are allocated in the old
+    /// generation.
+    AllocSites* sites = nullptr;
+
+    /// Number of minor collections a nursery object survives before it is
+    /// promoted.
+    static inline std::atomic<size_t> promotion_age_{DEFAULT_PROMOTION_AGE};
+
+    explicit RegionGenerational() : RegionBase(RegionType::Generational)
+    {
+      nursery_from = (std::byte*)heap::alloc(NURSERY_SIZE);
+      nursery_to = (std::byte*)heap::alloc(NURSERY_SIZE);
+      alloc_ptr = nursery_from;
+      alloc_end = nursery_from + NURSERY_SIZE;
+    }
+
+    static const Descriptor* desc()
+    {
+      static constexpr Descriptor desc = {
+        vsizeof<RegionGenerational>, nullptr, nullptr, nullptr};
+      return &desc;
+    }
+
+  public:
+    inline static RegionGenerational* get(Object* o)
+    {
+      assert(o->debug_is_iso());
+      assert(is_generational_region(o->get_region()));
+      return (RegionGenerational*)o->get_region();
+    }
+
+    inline static bool is_generational_region(Object* o)
+    {
+      return o->is_type(desc());
+    }
+
+    size_t get_current_memory_used() const
+    {
+      return current_memory_used;
+    }
+
+    size_t get_region_size() const
+    {
+      return region_size;
+    }
+
+    size_t get_non_trivial_size() const
+    {
+      return non_trivial_size;
+    }
+
+    /**
+     * Returns the number of bytes bump-allocated in the nursery.
+     **/
+    size_t get_nursery_used() const
+    {
+      return static_cast<size_t>(alloc_ptr - nursery_from);
+    }
+
+    /**
+     * Returns the number of objects in the old generation.
+     **/
+    size_t get_old_object_count() const
+    {
+      return old_count;
+    }
+
+    size_t get_minor_collections() const
+    {
+      return minor_collections;
+    }
+
+    size_t get_major_collections() const
+    {
+      return major_collections;
+    }
+
+    /**
+     * Returns the allocation sites of the region, or nullptr if it has not
+     * allocated while pretenuring was on (see AllocSites).
+     **/
+    const AllocSites* get_alloc_sites() const
+    {
+      return sites;
+    }
+
+    /**
+     * Returns the old-generation size at which the next collection is a
+     * major one.
+     **/
+    size_t get_major_threshold() const
+    {
+      return major_threshold;
+    }
+
+    /**
+     * Set the number of minor collections a nursery object must survive
+     * before it is promoted. 0 and 1 both promote on first survival.
+     **/
+    static void set_promotion_age(size_t age)
+    {
+      promotion_age_.store(age == 0 ? 1 : age, std::memory_order_relaxed);
+    }
+
+    static size_t get_promotion_age()
+    {
+      return promotion_age_.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Creates a new generational region by allocating Object `o` of type
+     * `desc`. The object is initialised as the Iso object for that region.
+     * Returns a pointer to `o`.
+     *
+     * The first major collection waits for the old generation to reach
+     * `major_threshold` bytes, or INITIAL_MAJOR_THRESHOLD if that is more,
+     * so a region expected to hold that much is not fully collected while
+     * it is filled.
+     **/
+    template<size_t size = 0>
+    static Object* create(
+      const Descriptor* desc, size_t major_threshold = INITIAL_MAJOR_THRESHOLD)
+    {
+      void* p = heap::alloc<vsizeof<RegionGenerational>>();
+      Object* o = Object::register_object(p, RegionGenerational::desc());
+      auto reg = new (o) RegionGenerational();
+      reg->major_threshold = std::max(major_threshold, INITIAL_MAJOR_THRESHOLD);
+
+      // The iso root is allocated on the heap so that it never moves.
+      size_t sz = snmalloc::bits::align_up(desc->size, Object::ALIGNMENT);
+      void* iso_mem = heap::alloc(sz);
+      Object* iso = Object::register_object(iso_mem, desc);
+      assert(Object::debug_is_aligned(iso));
+
+      iso->init_iso();
+      iso->set_region(reg);
+      reg->pinned_iso_ = iso;
+      reg->current_memory_used += desc->size;
+      reg->region_size += 1;
+      if (!iso->is_trivial())
+        reg->non_trivial_size += 1;
+
+      return iso;
+    }
+
+    /**
+     * Allocates an object of type `desc`, with a trailing array of `tail`
+     * elements, in the region represented by Iso object `in`. Returns a
+     * pointer to the new object.
+     **/
+    template<size_t size = 0>
+    static Object* alloc(Object* in, const Descriptor* desc, size_t tail = 0)
+    {
+      RegionGenerational* reg = get(in);
+      Object* o = reg->alloc_internal(desc, tail);
+      assert(Object::debug_is_aligned(o));
+      return o;
+    }
+
+    /**
+     * Insert the Object `o` into the RememberedSet of `into`'s region.
+     **/
+    template<TransferOwnership transfer = NoTransfer>
+    static void insert(Object* into, Object* o)
+    {
+      assert(o->debug_is_immutable() || o->debug_is_shared());
+      RegionGenerational* reg = get(into);
+      Object::RegionMD c;
+      o = o->root_and_class(c);
+      reg->RememberedSet::insert<transfer>(o);
+    }
+
+    /**
+     * Swap the Iso (root) object of the region.
+     **/
+    static void swap_root(Object* prev, Object* next)
+    {
+      assert(prev != next);
+      assert(prev->debug_is_iso());
+      assert(next->debug_is_mutable());
+
+      prev->init_next(nullptr);
+      next->init_iso();
+      next->set_region(prev->get_region());
+    }
+
+    /**
+     * Run a collection of the region whose pinned root is `o`.
+     *
+     * Algorithm:
+     *   1. Scan the root and every old object, copying the nursery objects
+     *      they reference and forwarding their fields.
+     *   2. Cheney scan of the nursery to-space, plus the objects promoted
+     *      along the way. A nursery object reaching the promotion age (or
+     *      any nursery object, in a major collection) is promoted rather
+     *      than copied.
+     *   3. Finalise and destruct the dead non-trivial nursery objects, and
+     *      swap the nursery halves.
+     *   4. Major collections only: mark the old generation from the root,
+     *      then sweep it and the remembered set.
+     **/
+    static Object* gc(Object* o, RegionGenerational* reg)
+    {
+      assert(o->debug_is_iso());
+      assert(o == reg->pinned_iso_);
+
+      bool major = reg->old_bytes >= reg->major_threshold;
+      Logging::cout() << "Generational GC (" << (major ? "major" : "minor")
+                      << ") called for: " << o << Logging::endl;
+
+      size_t nursery_bytes = 0;
+      size_t nursery_objects = 0;
+      reg->minor_gc(o, major, nursery_bytes, nursery_objects);
+
+      if (major)
+      {
+        reg->major_gc(o);
+        reg->major_threshold =
+          std::max(INITIAL_MAJOR_THRESHOLD, 2 * reg->old_bytes);
+        reg->major_collections++;
+      }
+      reg->minor_collections++;
+
+      reg->current_memory_used = o->size() + nursery_bytes + reg->old_bytes;
+      reg->region_size = 1 + nursery_objects + reg->old_count;
+      if (reg->sites != nullptr)
+        reg->count_sites();
+
+      Logging::cout() << "Generational GC complete. Iso (pinned): " << o
+                      << Logging::endl;
+      return o;
+    }
+
+  private:
+    Object* alloc_internal(const Descriptor* desc, size_t tail)
+    {
+      size_t size = Object::size_of(desc, tail);
+      size_t sz = snmalloc::bits::align_up(size, Object::ALIGNMENT);
+      current_memory_used += size;
+      region_size += 1;
+      if (!Object::is_trivial(desc))
+        non_trivial_size += 1;
+
+      if (SNMALLOC_UNLIKELY(AllocSites::is_enabled()) && pretenure(desc))
+        return alloc_old(desc, tail);
+
+      // Never collect from here: callers may hold pointers into the
+      // nursery. Overflow goes to the old generation until the next gc().
+      if (sz > PRETENURE_THRESHOLD || alloc_ptr + sz > alloc_end)
+        return alloc_old(desc, tail);
+
+      void* p = alloc_ptr;
+      alloc_ptr += sz;
+      Object* o = Object::register_object(p, desc);
+      o->init_tail(tail);
+      o->init_next(nullptr);
+      if (!Object::is_trivial(desc))
+        nursery_non_trivial.push(o);
+      return o;
+    }
+
+    Object* alloc_old(const Descriptor* desc, size_t tail)
+    {
+      void* p = heap::alloc(Object::size_of(desc, tail));
+      Object* o = Object::register_object(p, desc);
+      o->init_tail(tail);
+      link_old(o);
+      return o;
+    }
+
+    /**
+     * Count an allocation of `desc` at its site, and return whether the
+     * site is pretenured, so the object belongs in the old generation.
+     **/
+    bool pretenure(const Descriptor* desc)
+    {
+      if (sites == nullptr)
+        sites = new (heap::alloc<sizeof(AllocSites)>()) AllocSites();
+      return sites->allocated(desc);
+    }
+
+    /**
+     * Count the objects of each allocation site that the collection just
+     * ended kept: those in the nursery, and every old object, as only a
+     * major collection frees any.
+     **/
+    void count_sites()
+    {
+      for (std::byte* p = nursery_from; p < alloc_ptr;)
+      {
+        Object* obj = Object::object_start(p);
+        p += snmalloc::bits::align_up(obj->size(), Object::ALIGNMENT);
+        sites->found(obj);
+      }
+      for (Object* p = old_objects; p != nullptr; p = p->get_next())
+        sites->found(p);
+      sites->collected();
+    }
+
+    void free_sites()
+    {
+      if (sites == nullptr)
+        return;
+      sites->~AllocSites();
+      heap::dealloc<sizeof(AllocSites)>(sites);
+      sites = nullptr;
+    }
+
+    void link_old(Object* o)
+    {
+      o->init_next(old_objects);
+      old_objects = o;
+      old_bytes += o->size();
+      old_count++;
+    }
+
+    bool in_nursery(Object* o) const
+    {
+      auto addr = (std::byte*)o->real_start();
+      return addr >= nursery_from && addr < nursery_from + NURSERY_SIZE;
+    }
+
+    /// The age of a nursery object is stored in its header word, scaled so
+    /// that the class bits stay UNMARKED.
+    static size_t get_age(Object* o)
+    {
+      return o->get_header().bits / Object::ALIGNMENT;
+    }
+
+    static void set_age(Object* o, size_t age)
+    {
+      o->get_header().bits = age * Object::ALIGNMENT;
+    }
+
+    /**
+     * State of one minor collection.
+     **/
+    struct MinorState
+    {
+      std::byte* free_ptr;
+      bool promote_all;
+      StackThin<Object> non_trivial{};
+      /// Promoted objects whose fields are not scanned yet.
+      ObjectStack promoted{};
+      /// Scratch stack for tracing objects that have no `relocate`.
+      ObjectStack fields{};
+      size_t live_bytes = 0;
+      size_t live_objects = 0;
+    };
+
+    /// Collection in progress on this thread, for the forward callback.
+    static inline thread_local RegionGenerational* gc_region_ = nullptr;
+    static inline thread_local MinorState* gc_state_ = nullptr;
+
+    void minor_gc(
+      Object* o, bool promote_all, size_t& nursery_bytes, size_t& nursery_objects)
+    {
+      MinorState st{nursery_to, promote_all};
+      gc_region_ = this;
+      gc_state_ = &st;
+
+      // Phase 1: the roots. Promotions prepend to old_objects, so objects
+      // promoted now are scanned from `st.promoted` instead.
+      GCPhases::Scope phase(GCPhases::Roots);
+      std::byte* scan = nursery_to;
+      scan_object(o, st);
+      for (Object* p = old_objects; p != nullptr; p = p->get_next())
+        scan_object(p, st);
+
+      // Phase 2: Cheney scan.
+      phase.next(GCPhases::Copy);
+      while (scan < st.free_ptr || !st.promoted.empty())
+      {
+        Object* current;
+        if (scan < st.free_ptr)
+        {
+          current = Object::object_start(scan);
+          scan += snmalloc::bits::align_up(current->size(), Object::ALIGNMENT);
+        }
+        else
+        {
+          current = st.promoted.pop();
+        }
+        scan_object(current, st);
+      }
+
+      gc_region_ = nullptr;
+      gc_state_ = nullptr;
+
+      // Phase 3: dead nursery objects are the non-forwarded ones. Run all
+      // finalisers before any destructor.
+      phase.next(GCPhases::Finalise);
+      {
+        ObjectStack dummy_isos;
+        nursery_non_trivial.forall([&dummy_isos](Object* obj) {
+          if (obj->get_class() != Object::MARKED)
+            obj->finalise(nullptr, dummy_isos);
+        });
+
+        while (!nursery_non_trivial.empty())
+        {
+          Object* obj = nursery_non_trivial.pop();
+          if (obj->get_class() != Object::MARKED)
+          {
+            obj->destructor();
+            non_trivial_size -= 1;
+          }
+        }
+      }
+
+      std::byte* old_from = nursery_from;
+      nursery_from = nursery_to;
+      nursery_to = old_from;
+      alloc_ptr = st.free_ptr;
+      alloc_end = nursery_from + NURSERY_SIZE;
+      nursery_non_trivial = st.non_trivial;
+
+      nursery_bytes = st.live_bytes;
+      nursery_objects = st.live_objects;
+    }
+
+    /**
+     * Copy the nursery objects `obj` references and point its fields at
+     * the copies, in a single visit.
+     **/
+    void scan_object(Object* obj, MinorState& st)
+    {
+      if (obj->relocate_mapped(forward))
+        return;
+
+      auto* descriptor = obj->get_descriptor();
+      if (descriptor->relocate != nullptr)
+      {
+        descriptor->relocate(obj, forward);
+        return;
+      }
+
+      // Without relocate, find the children by tracing and then patch the
+      // body words that refer to forwarded nursery objects (best effort).
+      obj->trace(st.fields);
+      while (!st.fields.empty())
+        forward(st.fields.pop());
+
+      size_t body_size = obj->size() - sizeof(Object::Header);
+      auto* body = (Object**)obj;
+      size_t num_words = body_size / sizeof(Object*);
+      for (size_t i = 0; i < num_words; i++)
+      {
+        Object* word = body[i];
+        if (
+          word != nullptr && in_nursery(word) &&
+          word->get_class() == Object::MARKED)
+          body[i] = forwarding_target(word);
+      }
+    }
+
+    /**
+     * Forwarding callback passed to Descriptor::relocate during a minor
+     * collection. Nursery objects are copied or promoted on their first
+     * visit; every other reference is returned unchanged.
+     **/
+    static Object* forward(Object* field)
+    {
+      RegionGenerational* reg = gc_region_;
+      MinorState& st = *gc_state_;
+
+      if (!reg->in_nursery(field))
+        return field;
+
+      if (field->get_class() == Object::MARKED)
+        return forwarding_target(field);
+
+      assert(field->get_class() == Object::UNMARKED);
+      size_t age = get_age(field) + 1;
+      Object* new_obj = (st.promote_all || age >= get_promotion_age()) ?
+        reg->promote(field, st) :
+        copy_in_nursery(field, age, st);
+
+      field->set_forwarding_pointer(new_obj);
+      return new_obj;
+    }
+
+    Object* promote(Object* old_obj, MinorState& st)
+    {
+      size_t sz = old_obj->size();
+      void* p = heap::alloc(sz);
+      std::memcpy(p, old_obj->real_start(), sz);
+      GCPhases::copied(sz);
+      Object* new_obj = Object::object_start(p);
+      link_old(new_obj);
+      st.promoted.push(new_obj);
+      HeapProfile::count(new_obj);
+      return new_obj;
+    }
+
+    static Object* copy_in_nursery(Object* old_obj, size_t age, MinorState& st)
+    {
+      size_t sz = snmalloc::bits::align_up(old_obj->size(), Object::ALIGNMENT);
+      // Survivors never exceed the nursery they came from.
+      std::memcpy(st.free_ptr, old_obj->real_start(), sz);
+      GCPhases::copied(sz);
+      Object* new_obj = Object::object_start(st.free_ptr);
+      set_age(new_obj, age);
+      st.free_ptr += sz;
+
+      st.live_bytes += new_obj->size();
+      st.live_objects++;
+      HeapProfile::count(new_obj);
+      if (!new_obj->is_trivial())
+        st.non_trivial.push(new_obj);
+      return new_obj;
+    }
+
+    static Object* forwarding_target(Object* o)
+    {
+      assert(o->get_class() == Object::MARKED);
+      return (Object*)(o->get_header().bits & ~Object::MASK);
+    }
+
+    /**
+     * Mark-sweep of the old generation. The nursery has just been promoted
+     * wholesale, so every object of the region other than the root is old.
+     **/
+    void major_gc(Object* o)
+    {
+      assert(get_nursery_used() == 0);
+
+      // Mark everything reachable from the root.
+      GCPhases::Scope phase(GCPhases::Mark);
+      ObjectStack grey;
+      o->trace(grey);
+      while (!grey.empty())
+      {
+        Object* p = grey.pop();
+        switch (p->get_class())
+        {
+          case Object::ISO:
+          case Object::MARKED:
+            break;
+
+          case Object::UNMARKED:
+            p->mark();
+            p->trace(grey);
+            break;
+
+          case Object::SCC_PTR:
+            RememberedSet::mark(p->immutable());
+            break;
+
+          case Object::RC:
+          case Object::SHARED:
+            RememberedSet::mark(p);
+            break;
+
+          default:
+            assert(0);
+        }
+      }
+
+      // Split the old generation into the marked objects, which are kept,
+      // and the rest.
+      phase.next(GCPhases::Sweep);
+      Object* live = nullptr;
+      Object* dead = nullptr;
+      for (Object* p = old_objects; p != nullptr;)
+      {
+        Object* next = p->get_next_any_mark();
+        if (p->get_class() == Object::MARKED)
+        {
+          p->unmark();
+          p->init_next(live);
+          live = p;
+        }
+        else
+        {
+          p->init_next(dead);
+          dead = p;
+        }
+        p = next;
+      }
+      old_objects = live;
+
+      // Finalisers of dead objects may still look at each other, so all of
+      // them run before any destructor.
+      phase.next(GCPhases::Finalise);
+      ObjectStack dummy_isos;
+      for (Object* p = dead; p != nullptr; p = p->get_next())
+      {
+        if (!p->is_trivial())
+          p->finalise(nullptr, dummy_isos);
+      }
+
+      while (dead != nullptr)
+      {
+        Object* next = dead->get_next();
+        old_bytes -= dead->size();
+        old_count--;
+        if (!dead->is_trivial())
+        {
+          dead->destructor();
+          non_trivial_size -= 1;
+        }
+        dead->dealloc();
+        dead = next;
+      }
+
+      RememberedSet::sweep();
+    }
+
+    /**
+     * Release and deallocate all objects within the region.
+     **/
+    void release_internal(Object* o, ObjectStack& collect)
+    {
+      assert(o->debug_is_iso());
+
+      Logging::cout() << "Region release: generational region: " << o
+                      << Logging::endl;
+
+      // Finalisers first, while every object is still valid.
+      nursery_non_trivial.forall(
+        [o, &collect](Object* obj) { obj->finalise(o, collect); });
+      for (Object* p = old_objects; p != nullptr; p = p->get_next())
+      {
+        if (!p->is_trivial())
+          p->finalise(o, collect);
+      }
+      if (!pinned_iso_->is_trivial())
+        pinned_iso_->finalise(o, collect);
+
+      // Then destructors, deallocating old objects as we go.
+      while (!nursery_non_trivial.empty())
+        nursery_non_trivial.pop()->destructor();
+
+      while (old_objects != nullptr)
+      {
+        Object* next = old_objects->get_next();
+        if (!old_objects->is_trivial())
+          old_objects->destructor();
+        old_objects->dealloc();
+        old_objects = next;
+      }
+
+      if (!pinned_iso_->is_trivial())
+        pinned_iso_->destructor();
+      pinned_iso_->dealloc();
+      pinned_iso_ = nullptr;
+
+      heap::dealloc(nursery_from, NURSERY_SIZE);
+      heap::dealloc(nursery_to, NURSERY_SIZE);
+      free_sites();
+
+      RememberedSet::sweep();
+
+      dealloc();
+    }
+
+  public:
+    /**
+     * Iterator over all objects in the region: the pinned root, then the
+     * nursery, then the old generation.
+     **/
+    template<IteratorType type = AllObjects>
+    class iterator
+    {
+      friend class RegionGenerational;
+
+      static_assert(
+        type == Trivial || type == NonTrivial || type == AllObjects);
+
+      enum class Phase
+      {
+        PinnedRoot,
+        Nursery,
+        Old,
+        Done
+      };
+
+      iterator(RegionGenerational* r)
+      : reg(r), nursery_ptr(r->nursery_from), ptr(nullptr), phase(Phase::Nursery)
+      {
+        if (matches_filter(reg->pinned_iso_))
+        {
+          ptr = reg->pinned_iso_;
+          phase = Phase::PinnedRoot;
+        }
+        else
+        {
+          advance_nursery();
+        }
+      }
+
+      iterator(RegionGenerational* r, std::nullptr_t)
+      : reg(r), nursery_ptr(nullptr), ptr(nullptr), phase(Phase::Done)
+      {}
+
+    public:
+      iterator operator++()
+      {
+        switch (phase)
+        {
+          case Phase::PinnedRoot:
+            phase = Phase::Nursery;
+            ptr = nullptr;
+            advance_nursery();
+            break;
+
+          case Phase::Nursery:
+            nursery_ptr = ptr->real_start() +
+              snmalloc::bits::align_up(ptr->size(), Object::ALIGNMENT);
+            ptr = nullptr;
+            advance_nursery();
+            break;
+
+          case Phase::Old:
+            ptr = ptr->get_next();
+            skip_to_valid_old();
+            break;
+
+          case Phase::Done:
+            break;
+        }
+        return *this;
+      }
+
+      inline bool operator!=(const iterator& other) const
+      {
+        return ptr != other.ptr;
+      }
+
+      inline Object* operator*() const
+      {
+        return ptr;
+      }
+
+    private:
+      RegionGenerational* reg;
+      std::byte* nursery_ptr;
+      Object* ptr;
+      Phase phase;
+
+      static bool matches_filter(Object* obj)
+      {
+        if constexpr (type == Trivial)
+          return obj->is_trivial();
+        else if constexpr (type == NonTrivial)
+          return !obj->is_trivial();
+        else
+          return true;
+      }
+
+      void advance_nursery()
+      {
+        while (nursery_ptr < reg->alloc_ptr)
+        {
+          Object* obj = Object::object_start(nursery_ptr);
+          if (matches_filter(obj))
+          {
+            ptr = obj;
+            return;
+          }
+          nursery_ptr +=
+            snmalloc::bits::align_up(obj->size(), Object::ALIGNMENT);
+        }
+
+        phase = Phase::Old;
+        ptr = reg->old_objects;
+        skip_to_valid_old();
+      }
+
+      void skip_to_valid_old()
+      {
+        while (ptr != nullptr)
+        {
+          if (matches_filter(ptr))
+            return;
+          ptr = ptr->get_next();
+        }
+        phase = Phase::Done;
+      }
+    };
+
+    template<IteratorType type = AllObjects>
+    inline iterator<type> begin()
+    {
+      return {this};
+    }
+
+    template<IteratorType type = AllObjects>
+    inline iterator<type> end()
+    {
+      return {this, nullptr};
+    }
+
+  private:
+    bool debug_is_in_region(Object* o)
+    {
+      for (auto p : *this)
+      {
+        if (p == o)
+          return true;
+      }
+      return false;
+    }
+  };
+} // namespace verona::rt
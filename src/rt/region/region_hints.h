@@ -0,0 +1,60 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <cstddef>
+
+namespace verona::rt
+{
+  /**
+   * How long a region is expected to live, relative to how often it is
+   * asked whether to collect.
+   *
+   *  - Default leaves the choice of GCPolicy to the default policy.
+   *  - Short is for regions that are released soon after they are filled,
+   *    such as the scratch space of one request, so that collecting them
+   *    mostly traces what is about to be freed anyway.
+   *  - Long is for regions that are kept and mutated for most of the run,
+   *    such as a cache, whose collections should be paced by their growth.
+   **/
+  enum class RegionLifetime
+  {
+    Default,
+    Short,
+    Long,
+  };
+
+  /**
+   * What a region is expected to hold, given when it is created (see
+   * api::create_fresh_region()), so that its internal structures start at
+   * the size they will grow to rather than at the minimum, and its first
+   * collections are not spent growing them. Every field is optional, and 0
+   * means unknown.
+   *
+   *  - `bytes` sizes the first arena of an Arena region, the spaces of a
+   *    SemiSpace or Compact region, and the old generation of a
+   *    Generational region before its first major collection.
+   *  - `objects` stands in for `bytes`, if that is not given, counting
+   *    each object as the size of the entry point.
+   *  - `remembered` sizes the remembered set of Trace, Arena and SemiSpace
+   *    regions for that many immutables and cowns.
+   *  - `lifetime` picks the GCPolicy when the default policy is
+   *    GCPolicy::always(): Short uses an allocation budget of at least
+   *    `bytes`, and Long uses heap growth.
+   *
+   * With a growth-based policy, a region given `bytes` is not collected
+   * before it uses that much, so filling it does not collect it along the
+   * way (see GCPolicy::warm_up()).
+   *
+   * A hint only sizes what the region starts with, so a wrong hint costs
+   * memory or growth, never correctness.
+   **/
+  struct RegionHints
+  {
+    size_t bytes = 0;
+    size_t objects = 0;
+    size_t remembered = 0;
+    RegionLifetime lifetime = RegionLifetime::Default;
+  };
+} // namespace verona::rt
@@ -0,0 +1,112 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "region_api.h"
+
+#include <cstdint>
+
+namespace verona::rt
+{
+  /**
+   * A reference from an object in a SemiSpace region to an object in the
+   * same region's from-space, stored as a 32-bit offset from the start of
+   * from-space instead of as a pointer. It halves the size of a field, for
+   * graphs where references are most of the data.
+   *
+   * The offset is in units of Object::ALIGNMENT, so from-space may be up
+   * to 64 GiB. 0 is the null reference: every object starts past its
+   * header, so none is at offset 0. The target must be in from-space, so
+   * a region_ptr cannot refer to the region's pinned root, to its large
+   * objects or to anything outside the region; storing such a pointer
+   * aborts.
+   *
+   * A region_ptr is only read and written while its region is the current
+   * region. A type with region_ptr fields must have a `relocate` method
+   * that calls relocate() on each of them, which the semispace collector
+   * calls on the copy of the object, while it still knows where from-space
+   * used to be. Freezing a region that holds one aborts, as its objects
+   * leave from-space.
+   **/
+  template<class T>
+  class region_ptr
+  {
+    uint32_t offset = 0;
+
+    static std::byte* base()
+    {
+      RegionBase* r = api::RegionContext::get_region();
+      assert(Region::get_type(r) == RegionType::SemiSpace);
+      return ((RegionSemiSpace*)r)->get_fromspace_start();
+    }
+
+    static T* decode(uint32_t offset, std::byte* base)
+    {
+      if (offset == 0)
+        return nullptr;
+      return (T*)(base + (size_t)offset * Object::ALIGNMENT);
+    }
+
+    static uint32_t encode(const Object* p, std::byte* base)
+    {
+      if (p == nullptr)
+        return 0;
+
+      auto* addr = (const std::byte*)p;
+      if (addr < base)
+        abort();
+      size_t units = (size_t)(addr - base) / Object::ALIGNMENT;
+      if (units > UINT32_MAX)
+        abort();
+      return (uint32_t)units;
+    }
+
+  public:
+    region_ptr() = default;
+
+    region_ptr(std::nullptr_t) {}
+
+    region_ptr(T* p) : offset(encode(p, base())) {}
+
+    region_ptr& operator=(T* p)
+    {
+      offset = encode(p, base());
+      return *this;
+    }
+
+    T* get() const
+    {
+      return decode(offset, base());
+    }
+
+    operator T*() const
+    {
+      return get();
+    }
+
+    T* operator->() const
+    {
+      return get();
+    }
+
+    explicit operator bool() const
+    {
+      return offset != 0;
+    }
+
+    /**
+     * Forward this reference with `forward`, from the old from-space to
+     * the new one, during a collection of its region.
+     **/
+    void relocate(Object* (*forward)(Object*))
+    {
+      if (offset == 0)
+        return;
+
+      auto [from, to] = RegionSemiSpace::get_relocation_starts();
+      offset = encode(forward(decode(offset, from)), to);
+    }
+  };
+
+  static_assert(sizeof(region_ptr<Object>) == sizeof(uint32_t));
+} // namespace verona::rt
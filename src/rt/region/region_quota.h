@@ -0,0 +1,156 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+namespace verona::rt
+{
+  class Object;
+
+  /**
+   * Limits on how much memory one region may use, so that a runaway region
+   * is stopped before it takes the whole process into swap.
+   *
+   * api::create_object() and api::create_objects() check the quota of the
+   * current region before allocating. Going over the soft limit asks for a
+   * collection, which the region runs at its next safepoint: when it is
+   * closed, or at api::region_maybe_collect(), whatever its GC policy. It
+   * is not run by the allocation itself, as the objects the mutator is
+   * building there may not be reachable from the entry point yet. Those
+   * allocations cannot fail, so going over the hard limit is reported to
+   * the breach hook (see set_breach_hook()), and the allocation goes ahead.
+   * api::try_create_object() and try_new() fail instead, returning nullptr,
+   * so that the mutator can drop what it was building or collect, and
+   * retry. A limit of 0 means no limit, and both are 0 by default.
+   *
+   * Every region has one, copied from the default quota when the region is
+   * created (see set_default()). When a collection at the soft limit
+   * leaves the region over it, the next one waits until the region has
+   * grown by half the soft limit again, so a region whose live data alone
+   * exceeds the soft limit does not collect on every allocation.
+   *
+   * Objects a region allocates for itself, such as its entry point, and
+   * objects allocated through a RegionSemiSpace::AllocCursor, are not
+   * checked.
+   **/
+  class RegionQuota
+  {
+    size_t soft = 0;
+    size_t hard = 0;
+
+    /// Memory use at which the soft limit next collects the region.
+    size_t trigger = 0;
+
+    /// Whether the soft limit has asked for a collection that has not run.
+    bool collect_pending = false;
+
+    static inline std::atomic<size_t> default_soft_{0};
+    static inline std::atomic<size_t> default_hard_{0};
+
+  public:
+    using BreachHook = void (*)(Object* region, size_t bytes);
+
+  private:
+    static inline std::atomic<BreachHook> breach_hook_{nullptr};
+
+  public:
+    RegionQuota() = default;
+
+    RegionQuota(size_t soft, size_t hard)
+    : soft(soft), hard(hard), trigger(soft)
+    {}
+
+    /**
+     * Set the quota regions created from now on start with.
+     **/
+    static void set_default(RegionQuota quota)
+    {
+      default_soft_.store(quota.soft, std::memory_order_relaxed);
+      default_hard_.store(quota.hard, std::memory_order_relaxed);
+    }
+
+    static RegionQuota get_default()
+    {
+      return {
+        default_soft_.load(std::memory_order_relaxed),
+        default_hard_.load(std::memory_order_relaxed)};
+    }
+
+    /**
+     * Set a function to call with the entry point of a region, and the
+     * size of the allocation, when an allocation that cannot fail takes the
+     * region over its hard limit. It runs before the allocation, which goes
+     * ahead once it returns. nullptr, the default, calls nothing.
+     **/
+    static void set_breach_hook(BreachHook hook)
+    {
+      breach_hook_.store(hook, std::memory_order_release);
+    }
+
+    static void breached(Object* region, size_t bytes)
+    {
+      auto hook = breach_hook_.load(std::memory_order_acquire);
+      if (hook != nullptr)
+        hook(region, bytes);
+    }
+
+    size_t get_soft() const
+    {
+      return soft;
+    }
+
+    size_t get_hard() const
+    {
+      return hard;
+    }
+
+    /// Whether either limit is set.
+    bool is_limited() const
+    {
+      return (soft != 0) || (hard != 0);
+    }
+
+    /**
+     * Whether a region that would use `memory_used` bytes should be
+     * collected.
+     **/
+    bool should_collect(size_t memory_used) const
+    {
+      return ((soft != 0) && (memory_used > trigger)) ||
+        ((hard != 0) && (memory_used > hard));
+    }
+
+    /**
+     * Whether a region that would use `memory_used` bytes is over its hard
+     * limit.
+     **/
+    bool is_exceeded(size_t memory_used) const
+    {
+      return (hard != 0) && (memory_used > hard);
+    }
+
+    /// Ask for a collection at the region's next safepoint.
+    void request_collect()
+    {
+      collect_pending = true;
+    }
+
+    bool is_collect_pending() const
+    {
+      return collect_pending;
+    }
+
+    /**
+     * Record a collection that left the region using `memory_used` bytes,
+     * and work out when the soft limit next collects it.
+     **/
+    void collected(size_t memory_used)
+    {
+      collect_pending = false;
+      trigger = memory_used < soft ? soft : memory_used + soft / 2;
+    }
+  };
+} // namespace verona::rt
@@ -26,6 +26,36 @@ namespace verona::rt
    * (`FINALIZER_MASK`) to quickly deduce whether an object is trivial or
    * non-trivial.
    *
+   * Cycles are only collected from candidates, the objects a decref left
+   * with a non-zero count, which are buffered on the Lins stack as in
+   * Bacon and Rajan's synchronous cycle collector. Optionally (see
+   * set_cycle_threshold()), region_maybe_collect() collects cycles once a
+   * number of candidates are buffered, instead of following the GC policy,
+   * and (see set_cycle_budget()) each gc_cycles() call examines at most a
+   * number of candidates, leaving the rest for the next call. Either way a
+   * pause costs time in the candidates and their subgraphs, not the region.
+   *
+   * Optionally (see set_deferred()), a region defers the work of decrefs.
+   * A decref then only decrements the count and logs the object. The log is
+   * processed in a batch when the region is closed, collected or released:
+   * objects whose count is zero by then are deallocated, and the others
+   * become cycle candidates. An object incref'd and decref'd many times in
+   * between is checked once, and counts that dip to zero on the way, when a
+   * reference is overwritten before the new one is counted, free nothing.
+   *
+   * Optionally (see set_free_budget()), a region bounds the work of freeing
+   * what a decref drops. Objects whose count reaches zero are queued, and
+   * each later decref, and each close of the region, frees at most a number
+   * of them, queueing in turn the objects they held the last reference to.
+   * A large structure dying at once is then freed over many operations
+   * instead of in one pause. Releasing the region frees the whole queue.
+   *
+   * Optionally (see set_compact()), a region keeps the counts of its objects
+   * in the spare top byte of their descriptor words instead of in their
+   * region meta-data, which then only holds the mark bits and a next
+   * pointer, as in a trace region. A count that reaches the largest the
+   * byte can hold sticks there, and the real count moves to a side table in
+   * the region until the object is freed.
    **/
   class RegionRc : public RegionBase
   {
@@ -33,6 +63,24 @@ namespace verona::rt
     friend class Region;
     friend class RegionTrace;
 
+  public:
+    /// Reference counting work, counted when ENABLE_BENCHMARKING is defined.
+    struct OpStats
+    {
+      /// Calls to incref().
+      size_t increfs = 0;
+      /// Calls to decref().
+      size_t decrefs = 0;
+      /// Objects freed because their count reached zero.
+      size_t zero_frees = 0;
+      /// Candidates examined by cycle collections.
+      size_t cycle_roots = 0;
+      /// Objects marked red by cycle collections.
+      size_t reds = 0;
+      /// Red objects found live and restored to green.
+      size_t greens = 0;
+    };
+
   private:
     static constexpr uintptr_t FINALISER_MASK = 1 << 1;
 
@@ -42,12 +90,68 @@ namespace verona::rt
     // FIXME: Use two stacks to simulate per-block queue based behaviour.
     StackThin<Object> lins_stack;
 
+    // Number of objects on the Lins stack.
+    size_t candidates = 0;
+
+    // Candidates buffered before region_maybe_collect() collects cycles, or
+    // 0 to follow the GC policy.
+    size_t cycle_threshold;
+
+    // Candidates one gc_cycles() call examines, or 0 for all of them.
+    size_t cycle_budget;
+
+    // Whether decrefs are logged and processed when the region is closed.
+    bool deferred;
+
+    // Objects decref'd since the log was last processed, possibly more than
+    // once each.
+    ObjectStack decref_log;
+
+    // Objects one decref or close frees, or 0 to free them all at once.
+    size_t free_budget;
+
+    // Unreachable objects waiting to be freed.
+    ObjectStack free_queue;
+
+    // Whether counts are compact (see the class comment).
+    bool compact;
+
+    // The counts of the objects whose compact count saturated.
+    using OverflowMap = ObjectMap<std::pair<Object*, size_t>>;
+    OverflowMap* overflow = nullptr;
+
+    // Work done in this region.
+    OpStats op_stats;
+
+    // Work done in released regions, across all threads.
+    static inline std::atomic<size_t> released_increfs_{0};
+    static inline std::atomic<size_t> released_decrefs_{0};
+    static inline std::atomic<size_t> released_zero_frees_{0};
+    static inline std::atomic<size_t> released_cycle_roots_{0};
+    static inline std::atomic<size_t> released_reds_{0};
+    static inline std::atomic<size_t> released_greens_{0};
+
+    static inline std::atomic<size_t> cycle_threshold_{0};
+    static inline std::atomic<size_t> cycle_budget_{0};
+    static inline std::atomic<bool> deferred_{false};
+    static inline std::atomic<size_t> free_budget_{0};
+    static inline std::atomic<bool> compact_{false};
+
     // Memory usage in the region.
     size_t current_memory_used = 0;
 
+    // Number of objects in the region, and of those that are non-trivial.
     size_t region_size = 0;
+    size_t non_trivial_size = 0;
 
-    RegionRc() : RegionBase() {}
+    RegionRc()
+    : RegionBase(RegionType::Rc),
+      cycle_threshold(get_cycle_threshold()),
+      cycle_budget(get_cycle_budget()),
+      deferred(get_deferred()),
+      free_budget(get_free_budget()),
+      compact(get_compact())
+    {}
 
     static const Descriptor* desc()
     {
@@ -70,6 +174,11 @@ namespace verona::rt
       return region_size;
     }
 
+    size_t get_non_trivial_size() const
+    {
+      return non_trivial_size;
+    }
+
     size_t get_current_memory_used() const
     {
       return current_memory_used;
@@ -80,10 +189,159 @@ namespace verona::rt
       return o->is_type(desc());
     }
 
+    /**
+     * Set how many cycle candidates regions created from now on buffer
+     * before region_maybe_collect() collects cycles, or 0 to have it follow
+     * the GC policy.
+     **/
+    static void set_cycle_threshold(size_t n)
+    {
+      cycle_threshold_.store(n, std::memory_order_relaxed);
+    }
+
+    static size_t get_cycle_threshold()
+    {
+      return cycle_threshold_.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Set how many cycle candidates one gc_cycles() call examines in regions
+     * created from now on, or 0 for all of them.
+     **/
+    static void set_cycle_budget(size_t n)
+    {
+      cycle_budget_.store(n, std::memory_order_relaxed);
+    }
+
+    static size_t get_cycle_budget()
+    {
+      return cycle_budget_.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Choose whether regions created from now on defer the work of decrefs
+     * to when they are closed (see the class comment).
+     **/
+    static void set_deferred(bool enable)
+    {
+      deferred_.store(enable, std::memory_order_relaxed);
+    }
+
+    static bool get_deferred()
+    {
+      return deferred_.load(std::memory_order_relaxed);
+    }
+
+    bool is_deferred() const
+    {
+      return deferred;
+    }
+
+    /**
+     * Set how many unreachable objects regions created from now on free per
+     * decref or close (see the class comment). 0 frees them all at once.
+     **/
+    static void set_free_budget(size_t objects)
+    {
+      free_budget_.store(objects, std::memory_order_relaxed);
+    }
+
+    static size_t get_free_budget()
+    {
+      return free_budget_.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Choose whether regions created from now on keep compact counts (see
+     * the class comment). Aborts if the platform has no room for them.
+     **/
+    static void set_compact(bool enable)
+    {
+      if (enable && (Object::COMPACT_RC_MASK == 0))
+        abort();
+
+      compact_.store(enable, std::memory_order_relaxed);
+    }
+
+    static bool get_compact()
+    {
+      return compact_.load(std::memory_order_relaxed);
+    }
+
+    bool is_compact() const
+    {
+      return compact;
+    }
+
+    /**
+     * Number of objects whose count is kept in the side table.
+     **/
+    size_t get_overflow_count() const
+    {
+      return (overflow == nullptr) ? 0 : overflow->size();
+    }
+
+    /**
+     * Reference counting work done in this region so far. Always zero
+     * unless ENABLE_BENCHMARKING is defined.
+     **/
+    const OpStats& get_region_op_stats() const
+    {
+      return op_stats;
+    }
+
+    /**
+     * Reference counting work done in the regions released since the last
+     * reset_op_stats(). Always zero unless ENABLE_BENCHMARKING is defined.
+     **/
+    static OpStats get_op_stats()
+    {
+      OpStats stats;
+      stats.increfs = released_increfs_.load(std::memory_order_relaxed);
+      stats.decrefs = released_decrefs_.load(std::memory_order_relaxed);
+      stats.zero_frees = released_zero_frees_.load(std::memory_order_relaxed);
+      stats.cycle_roots =
+        released_cycle_roots_.load(std::memory_order_relaxed);
+      stats.reds = released_reds_.load(std::memory_order_relaxed);
+      stats.greens = released_greens_.load(std::memory_order_relaxed);
+      return stats;
+    }
+
+    static void reset_op_stats()
+    {
+      released_increfs_.store(0, std::memory_order_relaxed);
+      released_decrefs_.store(0, std::memory_order_relaxed);
+      released_zero_frees_.store(0, std::memory_order_relaxed);
+      released_cycle_roots_.store(0, std::memory_order_relaxed);
+      released_reds_.store(0, std::memory_order_relaxed);
+      released_greens_.store(0, std::memory_order_relaxed);
+    }
+
+    size_t get_cycle_candidates() const
+    {
+      return candidates;
+    }
+
+    bool has_cycle_threshold() const
+    {
+      return cycle_threshold != 0;
+    }
+
+    /**
+     * Whether enough cycle candidates are buffered for
+     * region_maybe_collect() to collect cycles. Always false without a
+     * threshold.
+     **/
+    bool should_collect_cycles() const
+    {
+      return has_cycle_threshold() && candidates >= cycle_threshold;
+    }
+
     /**
      * Creates a new rc region by allocating Object `o` of type `desc`. The
      * object is initialised as the Iso object for that region, and points to a
-     * newly created Region metadata object. Returns a pointer to `o`.
+     * newly created Region metadata object, allocated together with it.
+     * Returns a pointer to `o`.
      *
      * The default template parameter `size = 0` is to avoid writing two
      * definitions which differ only in one line. This overload works because
@@ -92,18 +350,29 @@ namespace verona::rt
     template<size_t size = 0>
     static Object* create(const Descriptor* desc)
     {
-      void* p = heap::alloc<vsizeof<RegionRc>>();
+      void* iso = nullptr;
+      void* p = alloc_with_iso(vsizeof<RegionRc>, desc->size, iso);
       Object* o = Object::register_object(p, RegionRc::desc());
       auto reg = new (o) RegionRc();
       reg->use_memory(desc->size);
 
-      if constexpr (size == 0)
-        p = heap::alloc(desc->size);
+      if (iso != nullptr)
+      {
+        o = Object::register_object(iso, desc);
+        reg->place_iso(o);
+      }
       else
-        p = heap::alloc<size>();
-      o = Object::register_object(p, desc);
+      {
+        if constexpr (size == 0)
+          p = heap::alloc(desc->size);
+        else
+          p = heap::alloc<size>();
+        o = Object::register_object(p, desc);
+      }
 
       reg->region_size += 1;
+      if (!o->is_trivial())
+        reg->non_trivial_size += 1;
 
       reg->init_next(o);
       o->init_iso();
@@ -114,33 +383,42 @@ namespace verona::rt
     }
 
     /**
-     * Allocates an object `o` of type `desc` in the region represented by the
-     * Iso object `in`. Returns a pointer to `o`.
+     * Allocates an object `o` of type `desc`, with a trailing array of
+     * `tail` elements, in the region `reg`. Returns a pointer to `o`.
      *
      * The default template parameter `size = 0` is to avoid writing two
      * definitions which differ only in one line. This overload works because
      * every object must contain a descriptor, so 0 is not a valid size.
      **/
     template<size_t size = 0>
-    static Object* alloc(RegionRc* reg, const Descriptor* desc)
+    static Object*
+    alloc(RegionRc* reg, const Descriptor* desc, size_t tail = 0)
     {
-      assert((size == 0) || (size == desc->size));
+      assert((size == 0) || ((size == desc->size) && (tail == 0)));
       assert(reg != nullptr);
+      size_t sz = Object::size_of(desc, tail);
+      AllocStats::Sample sample(RegionType::Rc, sz);
 
       void* p = nullptr;
       if constexpr (size == 0)
-        p = heap::alloc(desc->size);
+        p = heap::alloc(sz);
       else
         p = heap::alloc<size>();
 
       auto o = (Object*)Object::register_object(p, desc);
+      o->init_tail(tail);
       assert(Object::debug_is_aligned(o));
 
-      o->init_ref_count();
+      if (reg->compact)
+        o->init_compact_ref_count();
+      else
+        o->init_ref_count();
 
       // GC heuristics.
-      reg->use_memory(desc->size);
+      reg->use_memory(sz);
       reg->region_size += 1;
+      if (!o->is_trivial())
+        reg->non_trivial_size += 1;
       return o;
     }
 
@@ -153,41 +431,142 @@ namespace verona::rt
     void close(Object* o)
     {
       assert(o->get_class() == RegionMD::OPEN_ISO);
+      process_decref_log();
+      free_queued(free_budget);
       entry_point_count = o->get_ref_count();
       o->set_region(this);
     }
 
-    /// Increments the reference count of `o`. The object `in` is the entry
-    /// point to the region that contains `o`.
-    static void incref(Object* o)
+    /// Increments the reference count of `o`, which is in the region `reg`.
+    static void incref(Object* o, RegionRc* reg)
     {
-      o->incref_rc_region();
+      reg->count_op(&OpStats::increfs);
+      incref_inner(o, reg);
     }
 
     /// Decrements the reference count of `o`. The object `in` is the entry
     /// point to the region that contains `o`. If `decref` is called on an
-    /// object with only one reference, then the object will be deallocated.
+    /// object with only one reference, then the object will be deallocated,
+    /// unless `reg` defers decrefs, in which case nothing is deallocated
+    /// until the region is closed. If `reg` bounds the work of freeing, the
+    /// object is queued, and this returns true once it is unreachable.
     static bool decref(Object* o, RegionRc* reg)
     {
-      if (decref_inner(o))
+      reg->count_op(&OpStats::decrefs);
+      if (reg->deferred)
       {
-        dealloc_object(o, reg);
-        return true;
+        decref_inner(o, reg);
+        reg->decref_log.push(o);
+        reg->free_queued(reg->free_budget);
+        return false;
       }
 
-      if (o->get_rc_colour() != RcColour::BLACK)
+      bool freed = decref_inner(o, reg);
+      if (freed)
+        reg->free_object(o);
+      else
+        reg->add_candidate(o);
+
+      reg->free_queued(reg->free_budget);
+      return freed;
+    }
+
+    /**
+     * Merges `o`'s region into the open region `reg`. Both must be rc
+     * regions, counting alike (see set_compact()). `o` becomes an
+     * ordinary object of `reg`, and its count is its entry point
+     * count, which includes the reference the caller holds. Every other
+     * object keeps its count, and the regions' metrics are summed. The
+     * work left for later in `o`'s region, its logged decrefs and queued
+     * frees, is done first, and its cycle candidates are moved across.
+     **/
+    static void merge(Object* o, RegionRc* reg)
+    {
+      assert(o->debug_is_iso());
+      RegionBase* other_base = o->get_region();
+      assert(reg != other_base);
+      if (!is_rc_region(other_base))
+        abort();
+
+      RegionRc* other = (RegionRc*)other_base;
+      if (reg->compact != other->compact)
+        abort();
+
+      // Settle `o`'s region, whose entry point it still is.
+      other->open(o);
+      other->process_decref_log();
+      other->free_queued(SIZE_MAX);
+      size_t rc = o->get_ref_count();
+
+      while (!other->lins_stack.empty())
       {
-        o->set_rc_colour(RcColour::BLACK);
-        reg->lins_stack.push(o);
+        reg->lins_stack.push(other->lins_stack.pop());
+        reg->candidates++;
       }
-      return false;
+      other->candidates = 0;
+
+      if (other->overflow != nullptr)
+      {
+        if (reg->overflow == nullptr)
+          reg->overflow = OverflowMap::create();
+        for (auto it = other->overflow->begin(); it != other->overflow->end();
+             ++it)
+          reg->overflow->insert(std::make_pair(it.key(), it.value()));
+        other->overflow->dealloc();
+        heap::dealloc<sizeof(OverflowMap)>(other->overflow);
+        other->overflow = nullptr;
+      }
+
+      reg->set_count(o, rc);
+
+      reg->current_memory_used += other->current_memory_used;
+      reg->region_size += other->region_size;
+      reg->non_trivial_size += other->non_trivial_size;
+      reg->gc_policy.merge(other->gc_policy);
+
+      reg->ExternalReferenceTable::merge(other);
+      reg->RememberedSet::merge(other);
+      other->add_released_op_stats();
+      other->dealloc();
     }
 
-    /// Get the reference count of `o`. The object `in` is the entry point to
-    /// the region that contains `o`.
-    static size_t get_ref_count(Object* o)
+    /**
+     * Make `next`, an object of the open region `reg` whose entry point is
+     * `prev`, the entry point instead. `next` gains the reference the
+     * region's owner holds, and `prev` loses it, so `prev` is freed if
+     * nothing else in the region refers to it, and is otherwise a cycle
+     * candidate.
+     **/
+    static void swap_root(Object* prev, Object* next, RegionRc* reg)
     {
-      return o->get_ref_count();
+      assert(prev != next);
+      assert(prev->get_class() == RegionMD::OPEN_ISO);
+      assert(next->debug_is_mutable());
+      reg->process_decref_log();
+
+      size_t next_rc = get_ref_count(next, reg);
+      reg->forget_count(next);
+      next->init_iso();
+      next->init_iso_ref_count(next_rc + 1);
+
+      reg->set_count(prev, prev->get_ref_count());
+      if (decref_inner(prev, reg))
+        reg->free_object(prev);
+      else
+        reg->add_candidate(prev);
+    }
+
+    /// Get the reference count of `o`, which is in the region `reg`.
+    static size_t get_ref_count(Object* o, RegionRc* reg)
+    {
+      if (!has_compact_count(o, reg))
+        return o->get_ref_count();
+
+      size_t rc = o->get_compact_rc();
+      if (rc != Object::COMPACT_RC_MAX)
+        return rc;
+
+      return reg->overflow->find(o).value();
     }
 
     /** Removes cyclic garbage from the region.
@@ -207,7 +586,7 @@ namespace verona::rt
      *
      * The Lins algorithm is a three-phase sweep over the subgraph of an object
      * with potential cyclic reachability. For each object o in the Lins stack,
-     * it does the following:
+     * or only the region's cycle budget of them, it does the following:
      *
      *  1. o's subgraph is traced and each object is marked red and decrefed.
      *  Marking an object red indicates that it is potentially garbage. Objects
@@ -226,13 +605,20 @@ namespace verona::rt
     {
       assert(o->get_class() == RegionMD::OPEN_ISO);
       UNUSED(o);
+      reg->process_decref_log();
       ObjectStack jump_stack;
-      while (!reg->lins_stack.empty())
+      size_t examined = 0;
+      while (
+        !reg->lins_stack.empty() &&
+        (reg->cycle_budget == 0 || examined < reg->cycle_budget))
       {
         auto p = reg->lins_stack.pop();
+        reg->candidates--;
 
         if (p->get_rc_colour() == RcColour::BLACK)
         {
+          examined++;
+          reg->count_op(&OpStats::cycle_roots);
           mark_red(p, reg, jump_stack);
           scan(p, reg, jump_stack);
         }
@@ -249,7 +635,9 @@ namespace verona::rt
     {
       open(o);
       assert(o->get_class() == RegionMD::OPEN_ISO);
-      if (!decref_inner(o))
+      process_decref_log();
+      free_queued(SIZE_MAX);
+      if (!decref_inner(o, this))
       {
         abort();
       }
@@ -272,7 +660,7 @@ namespace verona::rt
             assert(0);
           case Object::MARKED:
           case Object::UNMARKED:
-            if (decref_inner(f))
+            if (decref_inner(f, this))
             {
               f->trace(dfs);
               if (!f->is_trivial())
@@ -295,6 +683,7 @@ namespace verona::rt
               // find and free it, matching the behaviour of
               // dealloc_object().
               lins_stack.push(f);
+              candidates++;
             }
             break;
           case Object::SCC_PTR:
@@ -329,10 +718,230 @@ namespace verona::rt
       close(o);
       o->destructor();
       o->dealloc();
+      if (overflow != nullptr)
+      {
+        overflow->dealloc();
+        heap::dealloc<sizeof(OverflowMap)>(overflow);
+      }
+      add_released_op_stats();
       dealloc();
     }
 
   private:
+    /**
+     * Free every object of the region that is not reachable from its entry
+     * point `o`, for Freeze::apply(): the decrefs and frees left for later,
+     * and every garbage cycle, whatever the cycle budget. The counts are
+     * not needed after this, so the overflow map is freed too.
+     **/
+    void prepare_freeze(Object* o)
+    {
+      open(o);
+      size_t budget = cycle_budget;
+      cycle_budget = 0;
+      do
+      {
+        gc_cycles(o, this);
+        free_queued(SIZE_MAX);
+        process_decref_log();
+      } while (!lins_stack.empty() || !free_queue.empty());
+      cycle_budget = budget;
+      close(o);
+
+      if (overflow != nullptr)
+      {
+        overflow->dealloc();
+        heap::dealloc<sizeof(OverflowMap)>(overflow);
+        overflow = nullptr;
+      }
+      add_released_op_stats();
+    }
+
+    /**
+     * Do the work of the decrefs logged by a deferred region. Every count is
+     * exact by now, so an object whose count is zero is unreachable from the
+     * other objects, and deallocating one cannot reach another. They are
+     * marked as they are found, so each is deallocated once.
+     **/
+    void process_decref_log()
+    {
+      ObjectStack zero;
+      while (!decref_log.empty())
+      {
+        Object* p = decref_log.pop();
+        switch (p->get_class())
+        {
+          case Object::MARKED:
+            // Already found.
+            break;
+          case Object::UNMARKED:
+            if (get_ref_count(p, this) == 0)
+            {
+              p->mark();
+              zero.push(p);
+            }
+            else
+            {
+              add_candidate(p);
+            }
+            break;
+          case Object::OPEN_ISO:
+            // There should always be an external reference keeping the ISO
+            // alive.
+            if (get_ref_count(p, this) == 0)
+              abort();
+            add_candidate(p);
+            break;
+          default:
+            assert(0);
+        }
+      }
+
+      while (!zero.empty())
+      {
+        Object* p = zero.pop();
+        p->unmark();
+        free_object(p);
+      }
+    }
+
+    /**
+     * Free `o`, whose count has reached zero, now or, if the region bounds
+     * the work of freeing, later.
+     **/
+    void free_object(Object* o)
+    {
+      if (free_budget == 0)
+      {
+        dealloc_object(o, this);
+        return;
+      }
+
+      remove_candidate(o);
+      free_queue.push(o);
+    }
+
+    /**
+     * Free at most `n` queued objects, queueing the objects they held the
+     * last reference to.
+     **/
+    void free_queued(size_t n)
+    {
+      ObjectStack fields;
+      ObjectStack sub_regions;
+      for (; (n > 0) && !free_queue.empty(); n--)
+      {
+        Object* o = free_queue.pop();
+        o->trace(fields);
+        while (!fields.empty())
+        {
+          Object* p = fields.pop();
+          switch (p->get_class())
+          {
+            case Object::OPEN_ISO:
+              if (decref_inner(p, this))
+              {
+                // There should always be an external reference keeping the
+                // ISO alive.
+                abort();
+              }
+              break;
+            case Object::MARKED:
+            case Object::UNMARKED:
+              if (decref_inner(p, this))
+              {
+                remove_candidate(p);
+                free_queue.push(p);
+              }
+              else
+              {
+                add_candidate(p);
+              }
+              break;
+            case Object::SCC_PTR:
+              p->immutable();
+              p->decref();
+              break;
+            case Object::RC:
+              p->decref();
+              break;
+            case Object::SHARED:
+              shared::release(p);
+              break;
+            case Object::ISO:
+              sub_regions.push(p);
+              break;
+            default:
+              assert(0);
+          }
+        }
+
+        // The ISO tag has been removed from the entry point.
+        o->finalise(nullptr, sub_regions);
+        region_size -= 1;
+        if (!o->is_trivial())
+          non_trivial_size -= 1;
+        current_memory_used -= o->size();
+        count_op(&OpStats::zero_frees);
+        forget_count(o);
+        o->destructor();
+        o->dealloc();
+      }
+
+      release_collected(sub_regions);
+    }
+
+    /**
+     * Add `n` to the counter `field` of this region's work, if benchmarking.
+     **/
+    void count_op(size_t OpStats::*field, size_t n = 1)
+    {
+#ifdef ENABLE_BENCHMARKING
+      op_stats.*field += n;
+#else
+      UNUSED(field);
+      UNUSED(n);
+#endif
+    }
+
+    void add_released_op_stats()
+    {
+#ifdef ENABLE_BENCHMARKING
+      released_increfs_.fetch_add(op_stats.increfs, std::memory_order_relaxed);
+      released_decrefs_.fetch_add(op_stats.decrefs, std::memory_order_relaxed);
+      released_zero_frees_.fetch_add(
+        op_stats.zero_frees, std::memory_order_relaxed);
+      released_cycle_roots_.fetch_add(
+        op_stats.cycle_roots, std::memory_order_relaxed);
+      released_reds_.fetch_add(op_stats.reds, std::memory_order_relaxed);
+      released_greens_.fetch_add(op_stats.greens, std::memory_order_relaxed);
+#endif
+    }
+
+    /**
+     * Buffer `o`, which a decref left with a non-zero count, as a cycle
+     * candidate, unless it already is one.
+     **/
+    void add_candidate(Object* o)
+    {
+      if (o->get_rc_colour() != RcColour::BLACK)
+      {
+        o->set_rc_colour(RcColour::BLACK);
+        lins_stack.push(o);
+        candidates++;
+      }
+    }
+
+    /**
+     * Forget `o`, which is about to be deallocated, if it is a buffered
+     * cycle candidate.
+     **/
+    void remove_candidate(Object* o)
+    {
+      if (candidates != 0 && lins_stack.remove(o))
+        candidates--;
+    }
+
     void release_cycles(Object* o, LinkedObjectStack& gc, ObjectStack& collect)
     {
       ObjectStack dfs;
@@ -340,6 +949,7 @@ namespace verona::rt
       {
         dfs.push(lins_stack.pop());
       }
+      candidates = 0;
       while (!dfs.empty())
       {
         Object* p = dfs.pop();
@@ -391,7 +1001,7 @@ namespace verona::rt
      * stack" for their liveness to be confirmed later on. This is a performance
      * optimisation that can result in fewer passes over the graph.
      **/
-    static void mark_red(Object* o, Object* in, ObjectStack& jump_stack)
+    static void mark_red(Object* o, RegionRc* reg, ObjectStack& jump_stack)
     {
       if (!o->is_rc_candidate())
       {
@@ -401,6 +1011,7 @@ namespace verona::rt
       if (o->get_rc_colour() != RcColour::RED)
       {
         o->set_rc_colour(RcColour::RED);
+        reg->count_op(&OpStats::reds);
       }
 
       ObjectStack dfs;
@@ -416,7 +1027,7 @@ namespace verona::rt
 
         if (f->get_class() == RegionMD::ISO)
         {
-          if (f != in)
+          if (f != reg)
           {
             // If f is the entry point to a subregion we don't want to trace
             // into it: the colour of `f` is enough to determine the fate of
@@ -424,12 +1035,11 @@ namespace verona::rt
             continue;
           }
 
-          RegionRc* reg = get(f);
-          reg->entry_point_count -= 1;
+          get(f)->entry_point_count -= 1;
         }
         else
         {
-          decref_inner(f);
+          decref_inner(f, reg);
         }
 
         if (f->get_rc_colour() == RcColour::RED)
@@ -438,7 +1048,7 @@ namespace verona::rt
           continue;
         }
 
-        if (get_ref_count(f) > 0)
+        if (get_ref_count(f, reg) > 0)
         {
           // f might still be live, so add it to the jump stack to confirm
           // later on.
@@ -451,6 +1061,7 @@ namespace verona::rt
         }
 
         f->set_rc_colour(RcColour::RED);
+        reg->count_op(&OpStats::reds);
         f->trace(dfs);
       }
     }
@@ -461,7 +1072,7 @@ namespace verona::rt
       // have been decrefed, then |o| is rooted by *at least one* live
       // reference. Hence, it must be made green and have its interior
       // refcounts restored.
-      if (o->is_rc_candidate() && get_ref_count(o) > 0)
+      if (o->is_rc_candidate() && get_ref_count(o, reg) > 0)
       {
         restore_green(o, reg);
         return;
@@ -470,7 +1081,8 @@ namespace verona::rt
       while (!jump_stack.empty())
       {
         Object* p = jump_stack.pop();
-        if (p->get_rc_colour() == RcColour::RED && get_ref_count(p) > 0)
+        if (
+          p->get_rc_colour() == RcColour::RED && get_ref_count(p, reg) > 0)
         {
           restore_green(p, reg);
         }
@@ -486,9 +1098,10 @@ namespace verona::rt
      * Green objects won't be collected, so this method is called on objects
      * known to have live, non-cyclic references after the mark_red phase.
      **/
-    static void restore_green(Object* o, Object* in)
+    static void restore_green(Object* o, RegionRc* reg)
     {
       o->set_rc_colour(RcColour::GREEN);
+      reg->count_op(&OpStats::greens);
       ObjectStack dfs;
       o->trace(dfs);
 
@@ -496,17 +1109,18 @@ namespace verona::rt
       {
         Object* f = dfs.pop();
 
-        if (f->get_class() == RegionMD::ISO && f != in)
+        if (f->get_class() == RegionMD::ISO && f != reg)
         {
           // If f is the entry point to a subregion we don't want to trace
           // into it or incref.
           continue;
         }
 
-        incref(f);
+        incref_inner(f, reg);
         if (f->is_rc_candidate() && f->get_rc_colour() != RcColour::GREEN)
         {
           f->set_rc_colour(RcColour::GREEN);
+          reg->count_op(&OpStats::greens);
           f->trace(dfs);
         }
       }
@@ -574,22 +1188,92 @@ namespace verona::rt
         }
       }
 
-      release_sub_regions(sub_regions);
+      release_collected(sub_regions);
 
       while (!gc.empty())
       {
         Object* o = gc.pop();
         reg->region_size -= 1;
+        if (!o->is_trivial())
+          reg->non_trivial_size -= 1;
         reg->current_memory_used -= o->size();
+        // Candidates not yet examined may be in this cycle.
+        reg->remove_candidate(o);
+        reg->forget_count(o);
         o->destructor();
         o->dealloc();
       }
     }
 
-    inline static bool decref_inner(Object* o)
+    /// Increments the reference count of `o`, which is in the region `reg`,
+    /// without counting it as an incref() call.
+    inline static void incref_inner(Object* o, RegionRc* reg)
+    {
+      if (!has_compact_count(o, reg))
+      {
+        o->incref_rc_region();
+        return;
+      }
+
+      size_t rc = o->get_compact_rc();
+      if (rc < Object::COMPACT_RC_MAX - 1)
+      {
+        o->set_compact_rc(rc + 1);
+      }
+      else if (rc == Object::COMPACT_RC_MAX - 1)
+      {
+        if (reg->overflow == nullptr)
+          reg->overflow = OverflowMap::create();
+
+        o->set_compact_rc(Object::COMPACT_RC_MAX);
+        reg->overflow->insert(std::make_pair(o, Object::COMPACT_RC_MAX));
+      }
+      else
+      {
+        reg->overflow->find(o).value()++;
+      }
+    }
+
+    /// Decrements the reference count of `o`, which is in the region `reg`,
+    /// and returns whether it is now zero.
+    inline static bool decref_inner(Object* o, RegionRc* reg)
+    {
+      if (!has_compact_count(o, reg))
+      {
+        o->decref_rc_region();
+        return (o->get_ref_count() == 0);
+      }
+
+      size_t rc = o->get_compact_rc();
+      assert(rc > 0);
+      if (rc != Object::COMPACT_RC_MAX)
+      {
+        o->set_compact_rc(rc - 1);
+        return rc == 1;
+      }
+
+      return --reg->overflow->find(o).value() == 0;
+    }
+
+    /**
+     * Whether the count of `o` is compact. The entry point, while the region
+     * is open, always keeps its count in its region meta-data.
+     **/
+    inline static bool has_compact_count(Object* o, RegionRc* reg)
+    {
+      return reg->compact &&
+        ((o->get_class() == RegionMD::UNMARKED) ||
+         (o->get_class() == RegionMD::MARKED));
+    }
+
+    /**
+     * Drop the side table entry of `o`, which is about to be freed, if it
+     * has one.
+     **/
+    void forget_count(Object* o)
     {
-      o->decref_rc_region();
-      return (o->get_ref_count() == 0);
+      if (compact && (o->get_compact_rc() == Object::COMPACT_RC_MAX))
+        overflow->erase(o);
     }
 
     static void dealloc_object(Object* o, RegionRc* reg)
@@ -609,7 +1293,7 @@ namespace verona::rt
         switch (p->get_class())
         {
           case Object::OPEN_ISO:
-            if (decref_inner(p))
+            if (decref_inner(p, reg))
             {
               // There should always be an external reference keeping the ISO
               // alive.
@@ -618,7 +1302,7 @@ namespace verona::rt
             break;
           case Object::MARKED:
           case Object::UNMARKED:
-            if (decref_inner(p))
+            if (decref_inner(p, reg))
             {
               p->trace(dfs);
               // The ISO tag has been removed from the entry point.
@@ -630,11 +1314,7 @@ namespace verona::rt
               // RC is still > 0, so this object may be part of a cycle.
               // Push it onto the Lins stack as a candidate for cycle
               // collection, matching the behaviour of decref().
-              if (p->get_rc_colour() != RcColour::BLACK)
-              {
-                p->set_rc_colour(RcColour::BLACK);
-                reg->lins_stack.push(p);
-              }
+              reg->add_candidate(p);
             }
             break;
           case Object::SCC_PTR:
@@ -660,41 +1340,37 @@ namespace verona::rt
       {
         Object* o = gc.pop();
         reg->region_size -= 1;
+        if (!o->is_trivial())
+          reg->non_trivial_size -= 1;
         reg->current_memory_used -= o->size();
         // Remove from the Lins stack before freeing to prevent gc_cycles
         // from later processing a stale (dangling) pointer.
-        reg->lins_stack.remove(o);
+        reg->remove_candidate(o);
+        reg->forget_count(o);
+        reg->count_op(&OpStats::zero_frees);
         o->destructor();
         o->dealloc();
       }
 
-      release_sub_regions(sub_regions);
+      release_collected(sub_regions);
     }
 
-    static void release_sub_regions(ObjectStack& sub_regions)
+  private:
+    /**
+     * Give `o`, which is not the open entry point, the count `rc`, which is
+     * not 0, kept as this region keeps counts.
+     **/
+    void set_count(Object* o, size_t rc)
     {
-      while (!sub_regions.empty())
-      {
-        Object* o = sub_regions.pop();
-        assert(o->debug_is_iso());
-        Logging::cout() << "Region RC: releasing unreachable subregion: " << o
-                        << Logging::endl;
-
-        RegionBase* r = o->get_region();
-        // Unfortunately, we can't use Region::release_internal because of a
-        // circular dependency between header files.
-        if (RegionTrace::is_trace_region(r))
-          ((RegionTrace*)r)->release_internal(o, sub_regions);
-        else if (RegionArena::is_arena_region(r))
-          ((RegionArena*)r)->release_internal(o, sub_regions);
-        else if (RegionRc::is_rc_region(r))
-          ((RegionRc*)r)->release_internal(o, sub_regions);
-        else
-          abort();
-      }
+      assert(rc != 0);
+      if (compact)
+        o->init_compact_ref_count();
+      else
+        o->init_ref_count();
+      for (size_t i = 1; i < rc; i++)
+        incref_inner(o, this);
     }
 
-  private:
     void use_memory(size_t size)
     {
       current_memory_used += size;
@@ -3,11 +3,31 @@
 
 #pragma once
 
+#include "../ds/chunk_cache.h"
 #include "../object/object.h"
+#include "../pal/memory_pressure.h"
+#include "../pal/threading.h"
+#include "../pal/virtual_memory.h"
+#include "alloc_sites.h"
+#include "alloc_stats.h"
+#include "gc_phases.h"
+#include "heap_profile.h"
+#include "large_object_space.h"
 #include "region_base.h"
 
+#include <algorithm>
+#include <atomic>
 #include <cstddef>
 #include <cstring>
+#include <limits>
+#include <list>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#  include <emmintrin.h>
+#endif
 
 namespace verona::rt
 {
@@ -32,12 +52,125 @@ namespace verona::rt
    * the new address in the upper bits). After GC, the spaces are swapped -
    * to-space becomes the new from-space.
    *
-   * Objects that are too large to fit in a semi-space are allocated separately
-   * via heap::alloc and tracked in a linked list ("large object list"). Large
-   * objects are not copied; they are kept in place. If a large object is
-   * reachable from the root, it is marked. We later traverse the large object
-   * ring to create a new ring of just the marked (live) objects and deallocate
-   * the objects in the old ring. 
+   * Objects above the region's large object threshold (see create()) are
+   * not copied. They live in a LargeObjectSpace, which marks the reachable
+   * ones in a side bitmap rather than in their headers and sweeps the rest
+   * lazily, so a collection never walks the large objects that died.
+   *
+   * Objects in the large object space can also be pinned (see pin() and
+   * alloc_pinned(), which places an object of any size there). Nothing in
+   * that space moves, and a collection treats a pinned object as a root
+   * until it is unpinned, so its address can be handed to asynchronous I/O
+   * or to C code that outlives the reference the region held. Freezing a
+   * region copies every object to the heap, so it aborts while anything in
+   * the region is pinned.
+   *
+   * With pretenuring on (see AllocSites), the objects of a type that keeps
+   * surviving collections are allocated in the large object space too,
+   * whatever their size, so that they stop being copied.
+   *
+   * The fields of a copied object are updated through its descriptor's
+   * pointer map or relocate function, which V derives from a `fields()`
+   * method if the type has one. For other types, the references that the
+   * object's trace reports are forwarded, and only the words of its body
+   * that hold one of those that moved are rewritten. Optionally (see
+   * set_word_scan()), every word of such a body that holds a forwarded
+   * from-space address is rewritten instead, for types whose trace does
+   * not report every reference that must follow a move.
+   *
+   * Non-trivial objects in from-space are additionally recorded in a side
+   * table (`from_non_trivial`) when they are allocated or copied. The passes
+   * that run finalisers and destructors on dead or released objects walk this
+   * table rather than the whole space, so trivial garbage is never touched.
+   *
+   * Collections of large from-spaces can optionally copy in parallel (see
+   * set_gc_threads()). Each collector thread copies into a thread-local
+   * allocation buffer carved out of to-space and claims an object by a CAS
+   * on its header before copying it, so every object is moved exactly once.
+   * The unused tails of those buffers are covered by filler objects, which
+   * keeps to-space walkable from start to end.
+   *
+   * A region starts with a from-space of its initial size (see
+   * set_default_initial_size()), and no to-space: the first collection
+   * allocates one. Afterwards the emptied space is kept as the next
+   * to-space, or freed until the collection after, as the retention policy
+   * says (see set_to_space_retention()) and always under memory pressure
+   * (see MemoryPressure). A small initial size and released to-spaces
+   * keep the cost of many small regions low.
+   *
+   * After each collection the spaces are resized for the next cycle from
+   * the bytes that survived: the target is the power-of-two multiple of
+   * the initial size at which live data fills the target occupancy
+   * (see set_target_occupancy()), capped by an optional memory budget for
+   * both spaces together. The spaces grow as soon as the target exceeds
+   * them, but only shrink once live data would fill a quarter of the
+   * current size or less, so a live size near a boundary does not make
+   * the spaces flip back and forth. A kept to-space is reallocated at the
+   * new size immediately; the from-space, which holds the survivors,
+   * is only bounded by `alloc_end` and is reallocated when the next
+   * collection swaps it out.
+   *
+   * Optionally (see set_virtual_spaces()), each space is instead a large
+   * reservation of address space that is backed by memory only where it is
+   * used: from-space is committed in VM_GRANULE steps as allocation
+   * advances, a collection commits just the part of to-space the copy can
+   * reach, and the emptied space is decommitted after the swap. An idle
+   * to-space then costs no resident memory, and growth up to the
+   * reservation happens in place.
+   *
+   * The single-threaded copy visits survivors in breadth-first (Cheney)
+   * order by default, which places a parent far from its children once a
+   * structure is a few levels deep. Optionally (see set_copy_order()), it
+   * copies in an approximately depth-first, hierarchical order instead:
+   * objects are scanned from a small bounded stack as soon as they are
+   * copied, so each object's children and grandchildren land next to it,
+   * and the Cheney scan only picks up what overflowed the stack.
+   *
+   * Objects allocated together tend to survive together, so the
+   * breadth-first copy often copies an object that follows, in from-space,
+   * the one it copied last. Such runs are copied with one copy each (see
+   * set_coalesced_copy()): each object is still forwarded as it is
+   * reached, but its bytes are only copied once the run ends or the scan
+   * reaches it, and long runs are copied with non-temporal stores. The
+   * scan prefetches the next object to scan as it starts on each one.
+   *
+   * External references are kept in the region's ExternalReferenceTable,
+   * keyed by address like those of other regions. After the copy, each
+   * collection re-keys the table by the new addresses and invalidates the
+   * references of dead objects, which costs time in the number of external
+   * references rather than of objects, so they neither pin objects nor go
+   * stale when they move.
+   *
+   * Code that allocates many objects in a row can take an AllocCursor,
+   * which keeps its own copy of the bump pointer and limit, so the common
+   * case is a compare, an add and a header store.
+   *
+   * Merging another region into this one (see merge()) copies nothing: the
+   * other region's from-space, and the heap block of its root, are adopted
+   * as extra spaces that its objects stay in, and its large objects,
+   * remembered set and external references are taken over. The next
+   * collection copies the survivors of every space into one to-space and
+   * frees the adopted ones. Until then allocation carries on in this
+   * region's own from-space, and collections copy on a single thread.
+   *
+   * Optionally (see set_incremental_copy()), a collection copies in slices
+   * of a bounded number of bytes of to-space scanned, one at each
+   * collection request and each close of the region, so the region can be
+   * used between slices. The forwarding pointers in the headers of copied
+   * objects stay valid until the flip, and loads of references from
+   * objects of the region must go through api::load(), whose read barrier
+   * copies a from-space target on the spot (or queues a large one) and
+   * points the field at the copy. So the mutator only ever holds objects
+   * the copy keeps, and stores need no barrier. New objects go to the end
+   * of to-space, where the scan reaches them, or are marked straight away
+   * in the large object space. Once the scan catches up, the copy flips
+   * as a full collection does. It runs on one thread, and is not used for
+   * a region with adopted spaces or a cursor. Objects with region_ptr
+   * fields must not be copied incrementally. Anything that walks or
+   * restructures the region (a collection that must free room, merge,
+   * swap_root, freeze, release, iteration, a new cursor) finishes a
+   * pending copy first, as does allocation once to-space has no room left
+   * beyond the objects still to be copied.
    **/
   class RegionSemiSpace : public RegionBase
   {
@@ -45,24 +178,93 @@ namespace verona::rt
     template<RegionBase::IteratorType type>
     class iterator;
 
-    // Initial semi-space size: 1MB each.
+    class AllocCursor;
+
+    // Default initial semi-space size: 1MB each.
     static constexpr size_t INITIAL_SEMISPACE_SIZE = 1024 * 1024;
 
-    // Objects larger than this are placed in the large object list
-    // and are never copied during GC (they are marked/unmarked in place).
-    // This is fixed so behaviour doesn't change as the semispace grows.
+    // Smallest initial size create() accepts.
+    static constexpr size_t MIN_SEMISPACE_SIZE = 4 * 1024;
+
+    // Default size above which objects are placed in the large object space
+    // and are never copied during GC. It does not follow the semi-space
+    // size, so behaviour doesn't change as the semispace grows.
     static constexpr size_t LARGE_OBJECT_THRESHOLD = INITIAL_SEMISPACE_SIZE / 2;
 
+    // Lowest threshold create() accepts.
+    static constexpr size_t MIN_LARGE_OBJECT_THRESHOLD =
+      LargeObjectSpace::MIN_OBJECT_SIZE;
+
+    // Size of the to-space chunks each collector thread claims during a
+    // parallel copy. Objects above DIRECT_COPY_THRESHOLD bypass the buffer
+    // and claim exactly their own size, which bounds the waste per chunk.
+    static constexpr size_t TLAB_SIZE = 32 * 1024;
+    static constexpr size_t DIRECT_COPY_THRESHOLD = TLAB_SIZE / 16;
+
+    // Below this much used from-space the collection stays single-threaded;
+    // starting the workers would cost more than the copy itself.
+    static constexpr size_t PARALLEL_GC_MIN_BYTES = 256 * 1024;
+
+    // Default share of a semi-space that live data should occupy right
+    // after a collection, in percent. The rest is allocation head room
+    // for the next cycle.
+    static constexpr size_t DEFAULT_TARGET_OCCUPANCY = 50;
+
+    // Address space reserved for each space of a region using virtual
+    // spaces. A region that outgrows it moves to a larger reservation.
+    static constexpr size_t VIRTUAL_SPACE_RESERVE =
+      1024 * INITIAL_SEMISPACE_SIZE;
+
+    // Order in which a single-threaded collection copies survivors.
+    enum class CopyOrder
+    {
+      BreadthFirst,
+      Hierarchical,
+    };
+
+    // Default bytes of to-space a slice of an incremental copy scans.
+    static constexpr size_t DEFAULT_COPY_SLICE = 64 * 1024;
+
+    // Depth of the stack of copied objects a hierarchical copy scans
+    // first. Copies made while it is full are scanned in Cheney order.
+    static constexpr size_t COPY_STACK_DEPTH = 64;
+
+    // Runs of survivors at least this long are copied with non-temporal
+    // stores, where the platform has them, so a run larger than the cache
+    // does not evict the objects still to be scanned.
+    static constexpr size_t STREAM_COPY_THRESHOLD = 256 * 1024;
+
+    // What a collection does with the space it has emptied.
+    enum class ToSpaceRetention
+    {
+      // Keep it as the to-space of the next collection.
+      Keep,
+      // Free it; the next collection allocates a to-space again.
+      Release,
+    };
+
   private:
     friend class Region;
+    friend class Freeze;
 
-    /// Current size of each semi-space (grows dynamically).
+    /// Size of the from-space allocation. Allocation may stop short of its
+    /// end (see alloc_end) while a shrink is pending.
     size_t semispace_size;
 
+    /// Size of the to-space allocation, or of the one the next collection
+    /// makes if there is none. Always at least alloc_end - from_space, so
+    /// every from-space object fits when copied.
+    size_t to_space_size;
+
+    /// Smallest size the sizing policy gives the spaces, and the size of
+    /// the first from-space. A power of two.
+    size_t initial_size;
+
     /// Pointer to from-space (where objects currently live).
     std::byte* from_space;
 
-    /// Pointer to to-space (used during GC).
+    /// Pointer to to-space (used during GC), or nullptr until a collection
+    /// needs one.
     std::byte* to_space;
 
     /// Bump pointer: next free byte in from-space for allocation.
@@ -71,53 +273,199 @@ namespace verona::rt
     /// End of from-space.
     std::byte* alloc_end;
 
+    /// End of the part of from-space that can be bumped into without a
+    /// slow path: alloc_end, or the committed prefix with virtual spaces.
+    std::byte* alloc_limit;
+
+    /// Whether the spaces are reservations committed on demand.
+    bool virtual_spaces;
+
+    /// Committed prefix of each space, with virtual spaces.
+    size_t from_committed = 0;
+    size_t to_committed = 0;
+
     /// Total memory used by objects (for metrics).
     size_t current_memory_used = 0;
 
-    /// Number of objects currently in the region (for metrics).
+    /// Number of objects currently in the region, and of those that are
+    /// non-trivial (for metrics).
     size_t region_size = 0;
+    size_t non_trivial_size = 0;
+
+    /// A side table of non-trivial objects. It holds one entry per such
+    /// object in the region, so it uses large blocks.
+    using NonTrivialStack = StackThin<Object, HeapAlloc, 512>;
+
+    /// References of an object that moved, each with its copy.
+    using MovedFields = std::vector<std::pair<Object*, Object*>>;
+
+    /**
+     * To-space state threaded through the copy loop of a single gc().
+     * Besides the bump pointer, it accumulates the side table of non-trivial
+     * survivors and the live totals used to refresh the region metrics.
+     **/
+    struct CopyState
+    {
+      std::byte* free_ptr;
+      std::byte* to_end;
+      NonTrivialStack non_trivial{};
+      size_t live_bytes = 0;
+      size_t live_objects = 0;
+      /// Large objects marked so far, and their total size.
+      size_t large_objects = 0;
+      size_t large_bytes = 0;
+      /// Large objects that were marked but whose fields are not scanned yet.
+      ObjectStack large_pending{};
+      /// Scratch stack for tracing objects that have no `relocate`.
+      ObjectStack fields{};
+      /// Copy each object into a heap allocation of its own, large ones
+      /// too, as evacuate() does, rather than into to-space.
+      bool to_heap = false;
+      /// Heap copies not scanned yet.
+      ObjectStack heap_pending{};
+      /// Scratch list of the moved fields of an object that has no
+      /// `relocate`, and where they moved to.
+      MovedFields moved{};
+      /// Copies not scanned yet, scanned before the Cheney queue in a
+      /// hierarchical copy.
+      bool hierarchical = false;
+      size_t stack_depth = 0;
+      Object* stack[COPY_STACK_DEPTH]{};
+      /// Whether copies are deferred into runs (see set_coalesced_copy()).
+      /// The run of `run_len` bytes at `run_src` is forwarded to `run_dst`
+      /// but not copied yet (see flush_run()).
+      bool coalesce = false;
+      std::byte* run_src = nullptr;
+      std::byte* run_dst = nullptr;
+      size_t run_len = 0;
+    };
+
+    /// Side table of the non-trivial objects that live in from-space. Entries
+    /// are pushed by alloc_internal() and by the copy in gc(). The memory
+    /// they point to is owned by from-space.
+    NonTrivialStack from_non_trivial{};
 
-    /// Linked list of large objects (too big for semi-space).
-    /// Uses Object::next pointers. Null-terminated.
-    Object* large_objects = nullptr;
+    /// Objects bigger than this many bytes go to `large`.
+    size_t large_object_threshold;
+
+    /// Large objects, which are never copied.
+    LargeObjectSpace large{};
+
+    /// Survival of the objects of each allocation site, while pretenuring
+    /// is on. Objects of a pretenured site are allocated in `large`.
+    AllocSites* sites = nullptr;
+
+    /// Objects pinned by pin(), all in `large`, once for each pin.
+    using PinStack = StackThin<Object, HeapAlloc>;
+    PinStack pinned{};
 
     /// The iso (root) object, heap-allocated and pinned — it never
     /// moves during GC or semispace growth.  This lets callers keep
     /// a stable C++ pointer to the root across those operations.
     Object* pinned_iso_ = nullptr;
 
-    /// Delta from the most recent grow() call.  Consumed by
-    /// create_object() in region_api.h to update the entry point
-    /// in RegionContext (which grow() cannot access directly due
-    /// to header dependency order).
-    ptrdiff_t last_grow_delta_ = 0;
-
-    /// Thread-local from-space bounds used by forward_if_moved callback
-    /// during GC so it can distinguish forwarded from-space objects from
-    /// merely-marked large objects (both use the MARKED class tag).
-    static inline thread_local std::byte* gc_from_space_ = nullptr;
-    static inline thread_local size_t gc_from_size_ = 0;
-
-    /// Thread-local state used by adjust_for_grow callback during
-    /// from-space reallocation to adjust pointer fields by the address
-    /// delta between old and new from-space.
-    static inline thread_local std::byte* grow_old_from_ = nullptr;
-    static inline thread_local size_t grow_old_used_ = 0;
-    static inline thread_local ptrdiff_t grow_delta_ = 0;
-
-    explicit RegionSemiSpace()
-    : RegionBase(),
-      semispace_size(INITIAL_SEMISPACE_SIZE),
+    /// The cursor allocating in this region, if any. A collection writes
+    /// its bump pointer back before it starts and reloads it after.
+    AllocCursor* cursor = nullptr;
+
+    /**
+     * A space of a region merged into this one, whose objects stay where
+     * they are until the next collection copies the survivors out. It is
+     * either the old from-space of that region, or the heap block of its
+     * root, which is then `root`.
+     **/
+    struct AdoptedSpace
+    {
+      std::byte* start;
+      /// End of the objects in the space.
+      std::byte* end;
+      /// Size of the allocation of a from-space, and how it was made.
+      size_t size;
+      bool virtual_space;
+      Object* root;
+      /// Side table of the non-trivial objects in the space.
+      NonTrivialStack non_trivial{};
+      AdoptedSpace* next = nullptr;
+    };
+
+    /// Spaces adopted since the last collection, in a list that another
+    /// region's list can be appended to in constant time.
+    AdoptedSpace* adopted = nullptr;
+    AdoptedSpace* adopted_last = nullptr;
+
+    /// Bytes of objects in the adopted spaces.
+    size_t adopted_used = 0;
+
+    /// Number of adopted spaces.
+    size_t adopted_count = 0;
+
+    /// Number of threads a collection may use to copy. 1 disables the
+    /// parallel copy.
+    static inline std::atomic<size_t> gc_threads_{1};
+
+    /// Sizing policy applied after each collection; see
+    /// set_target_occupancy() and set_memory_budget().
+    static inline std::atomic<size_t> target_occupancy_{
+      DEFAULT_TARGET_OCCUPANCY};
+    static inline std::atomic<size_t> memory_budget_{0};
+
+    /// Whether new regions use virtual spaces.
+    static inline std::atomic<bool> virtual_spaces_{false};
+
+    /// Initial size of new regions' spaces, unless given to create().
+    static inline std::atomic<size_t> default_initial_size_{
+      INITIAL_SEMISPACE_SIZE};
+
+    static inline std::atomic<ToSpaceRetention> to_space_retention_{
+      ToSpaceRetention::Keep};
+
+    /// Copy order of single-threaded collections.
+    static inline std::atomic<CopyOrder> copy_order_{CopyOrder::BreadthFirst};
+
+    /// Whether objects without an exact relocation have their whole body
+    /// scanned for from-space addresses.
+    static inline std::atomic<bool> word_scan_{false};
+
+    /// Whether the breadth-first copy copies runs of adjacent survivors
+    /// with one copy each.
+    static inline std::atomic<bool> coalesced_copy_{true};
+
+    /// Whether collections copy in slices, and the bytes a slice scans.
+    static inline std::atomic<bool> incremental_copy_{false};
+    static inline std::atomic<size_t> copy_slice_{DEFAULT_COPY_SLICE};
+
+    /// Regions with an incremental copy in progress.
+    static inline std::atomic<size_t> pending_copies_{0};
+
+    struct IncrementalCopy;
+
+    /// The incremental copy in progress, or nullptr.
+    IncrementalCopy* copy = nullptr;
+
+    RegionSemiSpace(size_t large_object_threshold, size_t initial_size)
+    : RegionBase(RegionType::SemiSpace),
+      semispace_size(initial_size),
+      to_space_size(initial_size),
+      initial_size(initial_size),
       from_space(nullptr),
       to_space(nullptr),
       alloc_ptr(nullptr),
-      alloc_end(nullptr)
+      alloc_end(nullptr),
+      alloc_limit(nullptr),
+      virtual_spaces(get_virtual_spaces()),
+      large_object_threshold(large_object_threshold)
     {
-      // Allocate two semi-spaces.
-      from_space = (std::byte*)heap::alloc(semispace_size);
-      to_space = (std::byte*)heap::alloc(semispace_size);
+      if (virtual_spaces)
+      {
+        semispace_size = VIRTUAL_SPACE_RESERVE;
+        to_space_size = VIRTUAL_SPACE_RESERVE;
+      }
+
+      // The first collection allocates the to-space.
+      from_space = alloc_space(semispace_size);
       alloc_ptr = from_space;
       alloc_end = from_space + semispace_size;
+      update_alloc_limit();
     }
 
     static const Descriptor* desc()
@@ -127,6 +475,18 @@ namespace verona::rt
       return &desc;
     }
 
+    /**
+     * Descriptor of the filler objects that cover gaps in a semi-space. A
+     * filler's header word holds the length of the gap rather than a next
+     * pointer (see space_size()).
+     **/
+    static const Descriptor* filler_desc()
+    {
+      static constexpr Descriptor desc = {
+        sizeof(Object::Header), nullptr, nullptr, nullptr};
+      return &desc;
+    }
+
   public:
     inline static RegionSemiSpace* get(Object* o)
     {
@@ -150,739 +510,2298 @@ namespace verona::rt
       return region_size;
     }
 
-    /**
-     * Return and clear the address delta from the most recent grow().
-     * If grow() was not called (or delta was zero), returns 0.
-     * Used by create_object() in region_api.h to update the entry
-     * point after an allocation that triggered growth.
-     **/
-    ptrdiff_t consume_grow_delta()
+    size_t get_non_trivial_size() const
     {
-      ptrdiff_t d = last_grow_delta_;
-      last_grow_delta_ = 0;
-      return d;
+      return non_trivial_size;
     }
 
     /**
-     * Returns the current size of each semi-space (from-space and to-space).
-     * This starts at INITIAL_SEMISPACE_SIZE and doubles when growth occurs.
+     * Returns the number of bytes from-space can hold before it has to grow.
+     * This starts at the initial size, doubles when growth occurs and is
+     * resized by the sizing policy after each collection.
      **/
     size_t get_semispace_size() const
     {
-      return semispace_size;
+      return static_cast<size_t>(alloc_end - from_space);
     }
 
     /**
-     * Returns the number of objects in the large object list.
-     * For testing/debugging only.
+     * Set the number of threads used to copy during a collection. Values
+     * greater than one enable the parallel copy for regions whose used
+     * from-space exceeds PARALLEL_GC_MIN_BYTES; 0 and 1 keep the collector
+     * single-threaded.
      **/
-    size_t get_large_object_count() const
+    static void set_gc_threads(size_t n)
     {
-      size_t count = 0;
-      Object* lo = large_objects;
-      while (lo != nullptr)
-      {
-        count++;
-        lo = lo->get_next();
-      }
-      return count;
+      gc_threads_.store(n == 0 ? 1 : n, std::memory_order_relaxed);
+    }
+
+    static size_t get_gc_threads()
+    {
+      return gc_threads_.load(std::memory_order_relaxed);
     }
 
     /**
-     * Returns the number of bytes currently used in from-space
-     * (i.e. how much has been bump-allocated).
+     * Set the share of a semi-space, in percent, that live data should
+     * occupy after a collection. Lower values leave more room to allocate
+     * before the next collection (fewer collections, more memory); higher
+     * values keep the spaces close to the live size. Clamped to [1, 100].
      **/
-    size_t get_fromspace_used() const
+    static void set_target_occupancy(size_t percent)
     {
-      return static_cast<size_t>(alloc_ptr - from_space);
+      target_occupancy_.store(
+        std::clamp<size_t>(percent, 1, 100), std::memory_order_relaxed);
+    }
+
+    static size_t get_target_occupancy()
+    {
+      return target_occupancy_.load(std::memory_order_relaxed);
     }
 
     /**
-     * Creates a new semi-space region by allocating Object `o` of type `desc`.
-     * The object is initialised as the Iso object for that region.
-     * Returns a pointer to `o`.
+     * Set the number of bytes the two semi-spaces of a region may use
+     * together, or 0 for no limit. The sizing policy never picks a size
+     * above half the budget unless live data alone needs more. Allocation
+     * can still grow the spaces past the budget between collections.
      **/
-    template<size_t size = 0>
-    static Object* create(const Descriptor* desc)
+    static void set_memory_budget(size_t bytes)
     {
-      // Allocate and construct region metadata object.
-      void* p = heap::alloc<vsizeof<RegionSemiSpace>>();
-      Object* o = Object::register_object(p, RegionSemiSpace::desc());
-      auto reg = new (o) RegionSemiSpace();
+      memory_budget_.store(bytes, std::memory_order_relaxed);
+    }
 
-      // Allocate the iso (root) object on the heap so it is pinned —
-      // it will never be moved by GC or semispace growth.
-      size_t sz = snmalloc::bits::align_up(desc->size, Object::ALIGNMENT);
-      void* iso_mem = heap::alloc(sz);
-      Object* iso = Object::register_object(iso_mem, desc);
-      assert(Object::debug_is_aligned(iso));
+    static size_t get_memory_budget()
+    {
+      return memory_budget_.load(std::memory_order_relaxed);
+    }
 
-      iso->init_iso();
-      iso->set_region(reg);
-      reg->pinned_iso_ = iso;
-      reg->current_memory_used += desc->size;
-      reg->region_size += 1;
+    /**
+     * Choose whether regions created from now on back their spaces with
+     * reserved address space committed on demand (see the class comment)
+     * instead of heap allocations. The sizing policy does not apply to
+     * them: resident memory follows the used part of from-space.
+     **/
+    static void set_virtual_spaces(bool enable)
+    {
+      virtual_spaces_.store(enable, std::memory_order_relaxed);
+    }
 
-      return iso;
+    static bool get_virtual_spaces()
+    {
+      return virtual_spaces_.load(std::memory_order_relaxed);
     }
 
     /**
-     * Allocates an object of type `desc` in the region represented by
-     * Iso object `in`. Returns a pointer to the new object.
+     * Set the initial size of the spaces of regions created from now on,
+     * unless given their own to create(). It is rounded up to a power of
+     * two, no smaller than MIN_SEMISPACE_SIZE, and the sizing policy never
+     * shrinks a region's spaces below it. Regions using virtual spaces
+     * ignore it.
      **/
-    template<size_t size = 0>
-    static Object* alloc(Object* in, const Descriptor* desc)
+    static void set_default_initial_size(size_t bytes)
     {
-      RegionSemiSpace* reg = get(in);
-      Object* o = reg->alloc_internal(desc);
-      assert(Object::debug_is_aligned(o));
-      return o;
+      default_initial_size_.store(
+        round_initial_size(bytes), std::memory_order_relaxed);
+    }
+
+    static size_t get_default_initial_size()
+    {
+      return default_initial_size_.load(std::memory_order_relaxed);
     }
 
     /**
-     * Ensure that at least `bytes` of from-space are available for
-     * future bump allocations, growing the semi-spaces if necessary.
-     * This does NOT allocate any objects — it only reserves capacity.
-     *
-     * Call this before a batch of allocations so that none of them
-     * will trigger grow() and invalidate earlier pointers.
+     * Choose what collections do with the space they have emptied (see
+     * ToSpaceRetention). Releasing it halves the memory of a region
+     * between collections, at the cost of allocating a to-space in each.
      **/
-    static void ensure_available(Object* in, size_t bytes)
+    static void set_to_space_retention(ToSpaceRetention retention)
     {
-      RegionSemiSpace* reg = get(in);
-      size_t remaining =
-        static_cast<size_t>(reg->alloc_end - reg->alloc_ptr);
-      if (bytes > remaining)
-      {
-        reg->grow(bytes);
-      }
+      to_space_retention_.store(retention, std::memory_order_relaxed);
+    }
+
+    static ToSpaceRetention get_to_space_retention()
+    {
+      return to_space_retention_.load(std::memory_order_relaxed);
+    }
+
+    size_t get_initial_size() const
+    {
+      return initial_size;
     }
 
     /**
-     * Insert the Object `o` into the RememberedSet of `into`'s region.
+     * Choose the order in which single-threaded collections copy
+     * survivors (see the class comment). A hierarchical copy keeps
+     * parents next to their children, which speeds up traversals of the
+     * copied structures. The parallel copy is unaffected.
      **/
-    template<TransferOwnership transfer = NoTransfer>
-    static void insert(Object* into, Object* o)
+    static void set_copy_order(CopyOrder order)
     {
-      assert(o->debug_is_immutable() || o->debug_is_shared());
-      RegionSemiSpace* reg = get(into);
-      Object::RegionMD c;
-      o = o->root_and_class(c);
-      reg->RememberedSet::insert<transfer>(o);
+      copy_order_.store(order, std::memory_order_relaxed);
+    }
+
+    static CopyOrder get_copy_order()
+    {
+      return copy_order_.load(std::memory_order_relaxed);
     }
 
     /**
-     * Swap the Iso (root) object of the region.
+     * Scan the whole body of each copied object that has neither a pointer
+     * map nor a relocate function, rewriting every word that holds the
+     * address of a forwarded from-space object, rather than only the words
+     * that hold a reference its trace reported (see the class comment).
+     * Off by default. The scan can rewrite an integer that happens to look
+     * like such an address.
      **/
-    static void swap_root(Object* prev, Object* next)
+    static void set_word_scan(bool on)
     {
-      assert(prev != next);
-      assert(prev->debug_is_iso());
-      assert(next->debug_is_mutable());
-      RegionSemiSpace* reg = get(prev);
-      UNUSED(reg);
-
-      // Clear iso status on old root.
-      prev->init_next(nullptr);
+      word_scan_.store(on, std::memory_order_relaxed);
+    }
 
-      // Set new root's iso status.
-      next->init_iso();
-      next->set_region(prev->get_region());
+    static bool get_word_scan()
+    {
+      return word_scan_.load(std::memory_order_relaxed);
     }
 
     /**
-     * Run Cheney-style semi-space garbage collection.
-     *
-     * Algorithm:
-     *   1. Trace the pinned iso root's fields (root stays in place).
-     *   2. Cheney scan loop — use scan/free pointers as a BFS queue:
-     *      - For each scanned to-space object, trace its fields.
-     *      - From-space objects are copied to to-space (forwarding pointer
-     *        installed); large objects are marked live in place.
-     *      - ISO, IMMUTABLE, SHARED fields are left as-is / remembered.
-     *   3. Update all pointers in to-space objects to forwarded addresses.
-     *      Also update the pinned root's pointers.
-     *   4. Update pointers in live large objects; finalize/free dead ones.
-     *   5. Finalize and destruct dead objects in old from-space.
-     *   6. Swap spaces. The iso root pointer is unchanged (pinned).
+     * Choose whether single-threaded breadth-first collections copy runs
+     * of survivors that are adjacent in from-space, and are copied one
+     * after the other, with one copy per run rather than one per object
+     * (see the class comment). On by default.
      **/
-    static Object* gc(Object* o, RegionSemiSpace* reg)
+    static void set_coalesced_copy(bool on)
     {
-      assert(o->debug_is_iso());
-      assert(o == reg->pinned_iso_);
+      coalesced_copy_.store(on, std::memory_order_relaxed);
+    }
 
-      Logging::cout() << "SemiSpace GC called for: " << o << Logging::endl;
+    static bool get_coalesced_copy()
+    {
+      return coalesced_copy_.load(std::memory_order_relaxed);
+    }
 
-      std::byte* to_start = reg->to_space;
-      std::byte* scan = to_start;
-      std::byte* free_ptr = to_start;
-      std::byte* to_end = to_start + reg->semispace_size;
+    /**
+     * Choose whether collections copy in slices, across several requests
+     * to collect and closes of the region (see the class comment).
+     **/
+    static void set_incremental_copy(bool enable)
+    {
+      incremental_copy_.store(enable, std::memory_order_relaxed);
+    }
 
-      // Phase 1: The iso root is pinned on the heap — don't copy it.
-      // Trace its fields and copy/mark reachable children.
-      {
-        ObjectStack fields;
-        o->trace(fields);
+    static bool get_incremental_copy()
+    {
+      return incremental_copy_.load(std::memory_order_relaxed);
+    }
 
-        while (!fields.empty())
-        {
-          Object* field = fields.pop();
-          switch (field->get_class())
-          {
-            case Object::ISO:
-              break;
+    /**
+     * Set the number of bytes of to-space a slice of an incremental copy
+     * scans. Clamped to at least 1.
+     **/
+    static void set_copy_slice(size_t bytes)
+    {
+      copy_slice_.store(bytes == 0 ? 1 : bytes, std::memory_order_relaxed);
+    }
 
-            case Object::UNMARKED:
-            {
-              if (is_in_space(field, reg->from_space, reg->semispace_size))
-              {
-                Object* new_obj = copy_object(field, free_ptr, to_end);
-                assert(new_obj != nullptr);
-              }
-              else if (is_large_object(field, reg))
-              {
-                field->mark();
-              }
-              break;
-            }
+    static size_t get_copy_slice()
+    {
+      return copy_slice_.load(std::memory_order_relaxed);
+    }
 
-            case Object::MARKED:
-              break;
+    /**
+     * Whether an incremental copy of this region is in progress.
+     **/
+    bool is_copy_pending() const
+    {
+      return copy != nullptr;
+    }
 
-            case Object::SCC_PTR:
-            {
-              Object* imm = field->immutable();
-              reg->RememberedSet::mark(imm);
-              break;
-            }
+    /**
+     * Whether an incremental copy of any region is in progress. The read
+     * barrier has nothing to do otherwise.
+     **/
+    static bool is_any_copy_pending()
+    {
+      return pending_copies_.load(std::memory_order_relaxed) != 0;
+    }
 
-            case Object::RC:
-            case Object::SHARED:
-            {
-              reg->RememberedSet::mark(field);
-              break;
-            }
+    /**
+     * Read barrier for a reference `p` loaded from an object of this
+     * region. While a copy is in progress, a from-space object is copied if
+     * it has not been yet, and its copy returned, and a large object is
+     * queued to be scanned. Anything else is returned as it is.
+     **/
+    Object* read_barrier(Object* p)
+    {
+      if (!is_copy_pending())
+        return p;
+
+      gc_region_ = this;
+      gc_copy_state_ = &copy->cs;
+      p = copy_and_forward(p);
+      gc_region_ = nullptr;
+      gc_copy_state_ = nullptr;
+      return p;
+    }
 
-            default:
-              break;
-          }
-        }
-      }
+    /**
+     * Called when the region with iso object `o` is closed: advance a
+     * pending incremental copy by one slice.
+     **/
+    void close(Object* o)
+    {
+      if (is_copy_pending())
+        copy_step(o, get_copy_slice());
+    }
 
-      // Phase 2: Cheney scan loop.
-      // scan walks through to-space objects; free_ptr is where next copy goes.
-      // From-space objects are copied on first encounter; large objects are
-      // marked as live in place (they are handled separately in Phase 4).
-      while (scan < free_ptr)
-      {
-        Object* current = Object::object_start(scan);
-        size_t obj_size =
-          snmalloc::bits::align_up(current->size(), Object::ALIGNMENT);
+    /**
+     * Returns the number of bytes of the two spaces that are backed by
+     * memory: all of both spaces, or the committed parts with virtual
+     * spaces.
+     **/
+    size_t get_committed_size() const
+    {
+      if (virtual_spaces)
+        return from_committed + to_committed;
+      return semispace_size + (to_space != nullptr ? to_space_size : 0);
+    }
 
-        // Trace this object's fields.
-        ObjectStack fields;
-        current->trace(fields);
+    /**
+     * Returns the number of objects in the large object space: those that
+     * survived the last collection and those allocated since.
+     **/
+    size_t get_large_object_count() const
+    {
+      return large.get_object_count();
+    }
 
-        while (!fields.empty())
-        {
-          Object* field = fields.pop();
-          switch (field->get_class())
-          {
-            case Object::ISO:
-              // Subregion pointer — don't copy, leave as-is.
-              break;
+    /**
+     * Returns the number of chunks the large object space holds.
+     * For testing/debugging only.
+     **/
+    size_t get_large_chunk_count() const
+    {
+      return large.get_chunk_count();
+    }
 
-            case Object::UNMARKED:
-            {
-              // Live object in from-space, not yet copied.
-              if (is_in_space(field, reg->from_space, reg->semispace_size))
-              {
-                Object* new_obj = copy_object(field, free_ptr, to_end);
-                // to-space is the same size as from-space and we only
-                // copy live objects, so this should never fail.
-                assert(new_obj != nullptr);
-              }
-              else if (is_large_object(field, reg))
-              {
-                // Large object: mark it as live (use MARKED tag).
-                field->mark();
-              }
-              break;
-            }
+    /**
+     * Returns the number of blocks of memory the region's objects are in:
+     * the from-space, the spaces adopted since the last collection, and the
+     * chunks of the large object space.
+     **/
+    size_t get_chunk_count() const
+    {
+      return 1 + adopted_count + large.get_chunk_count();
+    }
 
-            case Object::MARKED:
-            {
-              // Already copied (forwarded) or marked large object.
-              // Will be fixed up in the pointer update pass.
-              break;
-            }
+    size_t get_large_object_threshold() const
+    {
+      return large_object_threshold;
+    }
 
-            case Object::SCC_PTR:
-            {
-              Object* imm = field->immutable();
-              reg->RememberedSet::mark(imm);
-              break;
-            }
+    /**
+     * Returns the allocation sites of the region, or nullptr if it has not
+     * allocated while pretenuring was on (see AllocSites).
+     **/
+    const AllocSites* get_alloc_sites() const
+    {
+      return sites;
+    }
 
-            case Object::RC:
-            case Object::SHARED:
-            {
-              reg->RememberedSet::mark(field);
-              break;
-            }
+    /**
+     * Returns the number of pins held on objects of the region.
+     * For testing/debugging only.
+     **/
+    size_t get_pin_count()
+    {
+      size_t n = 0;
+      pinned.forall([&n](Object*) { n++; });
+      return n;
+    }
 
-            default:
-              break;
-          }
-        }
+    /**
+     * Start of from-space, which region_ptr offsets are taken from.
+     **/
+    std::byte* get_fromspace_start() const
+    {
+      return from_space;
+    }
+
+    /**
+     * The old and new start of from-space while this thread copies for a
+     * collection, for region_ptr::relocate. The spaces are swapped only
+     * once the copy is over.
+     **/
+    static std::pair<std::byte*, std::byte*> get_relocation_starts()
+    {
+      if (gc_region_ != nullptr)
+      {
+        // A freeze moves objects out of the region, where no offset reaches.
+        if (gc_copy_state_->to_heap)
+          abort();
+        return {gc_region_->from_space, gc_region_->to_space};
+      }
+
+      assert(gc_parallel_ != nullptr);
+      return {gc_parallel_->from_start, gc_parallel_->reg->to_space};
+    }
+
+    /**
+     * Returns the number of bytes currently used in from-space
+     * (i.e. how much has been bump-allocated).
+     **/
+    size_t get_fromspace_used() const
+    {
+      return static_cast<size_t>(alloc_ptr - from_space);
+    }
+
+    /**
+     * Creates a new semi-space region by allocating Object `o` of type `desc`.
+     * The object is initialised as the Iso object for that region.
+     * Returns a pointer to `o`.
+     *
+     * Objects of more than `large_object_threshold` bytes are allocated in
+     * the large object space and never copied. Lowering it suits regions
+     * of many mid-size arrays, which would otherwise be copied by every
+     * collection. Values below MIN_LARGE_OBJECT_THRESHOLD are raised to it.
+     *
+     * The from-space starts at `initial_size` bytes, rounded as
+     * set_default_initial_size() does.
+     **/
+    template<size_t size = 0>
+    static Object* create(
+      const Descriptor* desc,
+      size_t large_object_threshold = LARGE_OBJECT_THRESHOLD,
+      size_t initial_size = get_default_initial_size())
+    {
+      // Allocate and construct region metadata object, with room for the
+      // iso (root) object after it, outside the spaces so that it is
+      // pinned — it will never be moved by GC or semispace growth.
+      size_t sz = snmalloc::bits::align_up(desc->size, Object::ALIGNMENT);
+      void* iso_mem = nullptr;
+      void* p = alloc_with_iso(vsizeof<RegionSemiSpace>, sz, iso_mem);
+      Object* o = Object::register_object(p, RegionSemiSpace::desc());
+      auto reg = new (o) RegionSemiSpace(
+        std::max(large_object_threshold, MIN_LARGE_OBJECT_THRESHOLD),
+        round_initial_size(initial_size));
+
+      bool co_allocated = iso_mem != nullptr;
+      if (!co_allocated)
+        iso_mem = heap::alloc(sz);
+      Object* iso = Object::register_object(iso_mem, desc);
+      assert(Object::debug_is_aligned(iso));
+      if (co_allocated)
+        reg->place_iso(iso);
+
+      iso->init_iso();
+      iso->set_region(reg);
+      reg->pinned_iso_ = iso;
+      reg->current_memory_used += desc->size;
+      reg->region_size += 1;
+      if (!iso->is_trivial())
+        reg->non_trivial_size += 1;
+
+      return iso;
+    }
+
+    /**
+     * Allocates an object of type `desc`, with a trailing array of `tail`
+     * elements, in the region represented by Iso object `in`. Returns a
+     * pointer to the new object.
+     **/
+    template<size_t size = 0>
+    static Object* alloc(Object* in, const Descriptor* desc, size_t tail = 0)
+    {
+      AllocStats::Sample sample(
+        RegionType::SemiSpace, Object::size_of(desc, tail));
+      RegionSemiSpace* reg = get(in);
+      Object* o = reg->alloc_internal(desc, tail);
+      assert(Object::debug_is_aligned(o));
+      return o;
+    }
+
+    /**
+     * Allocates an object as alloc() does, but in the large object space
+     * whatever its size, and pins it. It stays at its address until the
+     * region is released, and is kept alive until unpin() is called.
+     **/
+    static Object*
+    alloc_pinned(Object* in, const Descriptor* desc, size_t tail = 0)
+    {
+      AllocStats::Sample sample(
+        RegionType::SemiSpace, Object::size_of(desc, tail));
+      RegionSemiSpace* reg = get(in);
+      Object* o = reg->alloc_large(desc, tail);
+      reg->pinned.push(o);
+      return o;
+    }
+
+    /**
+     * Pin `o`, an object of the region of `in`, which must be in the large
+     * object space: above the region's threshold or from alloc_pinned().
+     * Objects in the spaces that collections copy cannot be pinned, and
+     * abort. The root never moves, and pinning it does nothing.
+     *
+     * Pins nest: `o` is kept alive until each pin() has been matched by an
+     * unpin().
+     **/
+    static void pin(Object* in, Object* o)
+    {
+      RegionSemiSpace* reg = get(in);
+      if (o == reg->pinned_iso_)
+        return;
+      if (!reg->is_in_large(o))
+        abort();
+      // A pending copy keeps it from now on.
+      reg->read_barrier(o);
+      reg->pinned.push(o);
+    }
+
+    /**
+     * Drop one pin on `o` taken by pin() or alloc_pinned(). Once it has no
+     * pins left, `o` is live only while it is reachable. Aborts if `o` is
+     * not pinned.
+     **/
+    static void unpin(Object* in, Object* o)
+    {
+      RegionSemiSpace* reg = get(in);
+      if (o == reg->pinned_iso_)
+        return;
+      if (!reg->pinned.remove(o))
+        abort();
+    }
+
+    /**
+     * A copy of a region's bump pointer and limit for allocating many
+     * objects in a row, which only goes to the region when from-space runs
+     * out or an object belongs in the large object space.
+     *
+     * Objects it allocates are only counted in the region's metrics, and
+     * only reached by iterators, once the cursor is flushed, which happens
+     * when it is destroyed and before each collection. At most one cursor
+     * may exist per region, and it must not outlive the scope in which the
+     * region is open.
+     **/
+    class AllocCursor
+    {
+      RegionSemiSpace* reg;
+      std::byte* ptr;
+      std::byte* limit;
+
+      /// Bytes and objects allocated since the last flush.
+      size_t memory = 0;
+      size_t count = 0;
 
-        scan += obj_size;
+    public:
+      explicit AllocCursor(Object* in) : reg(get(in))
+      {
+        assert(reg->cursor == nullptr);
+        reg->finish_copy();
+        reg->cursor = this;
+        reload();
       }
 
-      // Set from-space context for forward_if_moved callback.
-      gc_from_space_ = reg->from_space;
-      gc_from_size_ = reg->semispace_size;
+      AllocCursor(const AllocCursor&) = delete;
+      AllocCursor& operator=(const AllocCursor&) = delete;
+
+      ~AllocCursor()
+      {
+        flush();
+        reg->cursor = nullptr;
+      }
 
-      // Phase 3: Update all pointers in to-space objects to new addresses.
-      update_all_pointers(to_start, free_ptr, reg);
+      /**
+       * Write the bump pointer and metrics back to the region.
+       **/
+      void flush()
+      {
+        reg->alloc_ptr = ptr;
+        reg->current_memory_used += memory;
+        reg->region_size += count;
+        memory = 0;
+        count = 0;
+      }
 
-      // Also update the pinned root's pointers (it references from-space
-      // objects that have been forwarded to to-space).
-      update_object_pointers(o, reg);
+      /**
+       * Pick up the region's bump pointer and limit after it has changed
+       * them.
+       **/
+      void reload()
+      {
+        ptr = reg->alloc_ptr;
+        // Allocation sites are counted on the slow path.
+        limit = AllocSites::is_enabled() ? ptr : reg->alloc_limit;
+      }
 
-      // Phase 4: Update pointers in large objects and collect dead large
-      // objects.
-      Object* live_large = nullptr;
+      /**
+       * Allocate an object of type `desc`, whose size is `size` if that is
+       * not 0.
+       **/
+      template<size_t size = 0>
+      Object* alloc(const Descriptor* desc)
       {
-        Object* lo = reg->large_objects;
-        while (lo != nullptr)
+        assert((size == 0) || (size == desc->size));
+        size_t sz = snmalloc::bits::align_up(
+          (size == 0) ? desc->size : size, Object::ALIGNMENT);
+
+        if (SNMALLOC_LIKELY(
+              (ptr + sz <= limit) && (sz <= reg->large_object_threshold)))
         {
-          Object* next_lo = lo->get_next_any_mark();
-          if (lo->get_class() == Object::MARKED)
-          {
-            // Live large object — unmark and update its pointers.
-            lo->unmark();
-            update_object_pointers(lo, reg);
-            lo->init_next(live_large);
-            live_large = lo;
-          }
-          else
+          void* p = ptr;
+          ptr += sz;
+          memory += desc->size;
+          count++;
+          Object* o = Object::register_object(p, desc);
+          o->init_next(nullptr);
+          if (!Object::is_trivial(desc))
           {
-            // Dead large object — finalize and deallocate.
-            ObjectStack dead_isos;
-            reg->current_memory_used -= lo->size();
-            if (!lo->is_trivial())
-            {
-              lo->finalise(nullptr, dead_isos);
-              lo->destructor();
-            }
-            lo->dealloc();
+            reg->from_non_trivial.push(o);
+            reg->non_trivial_size += 1;
           }
-          lo = next_lo;
+          return o;
+        }
+
+        // The slow path may collect, which flushes and reloads the cursor.
+        flush();
+        Object* o = reg->alloc_internal(desc);
+        reload();
+        return o;
+      }
+
+      /**
+       * Allocate and default-construct a `T`, as `new T` would.
+       **/
+      template<class T>
+      T* create()
+      {
+        return ::new (alloc<vsizeof<T>>(T::desc())) T();
+      }
+    };
+
+    /**
+     * Ensure that at least `bytes` of from-space are available for
+     * future bump allocations, growing the semi-spaces if necessary.
+     * This does NOT allocate any objects — it only reserves capacity.
+     *
+     * Call this before a batch of allocations so that none of them
+     * will trigger grow() and invalidate earlier pointers. grow() is a
+     * collection, so objects not yet reachable from the root when it runs
+     * are reclaimed.
+     **/
+    static void ensure_available(Object* in, size_t bytes)
+    {
+      RegionSemiSpace* reg = get(in);
+      reg->finish_copy();
+      if (reg->cursor != nullptr)
+        reg->cursor->flush();
+      size_t remaining =
+        static_cast<size_t>(reg->alloc_end - reg->alloc_ptr);
+      if (bytes > remaining)
+      {
+        reg->grow(bytes);
+      }
+    }
+
+    /**
+     * Insert the Object `o` into the RememberedSet of `into`'s region.
+     **/
+    template<TransferOwnership transfer = NoTransfer>
+    static void insert(Object* into, Object* o)
+    {
+      assert(o->debug_is_immutable() || o->debug_is_shared());
+      RegionSemiSpace* reg = get(into);
+      Object::RegionMD c;
+      o = o->root_and_class(c);
+      reg->RememberedSet::insert<transfer>(o);
+    }
+
+    /**
+     * Swap the Iso (root) object of the region.
+     **/
+    static void swap_root(Object* prev, Object* next)
+    {
+      assert(prev != next);
+      assert(prev->debug_is_iso());
+      assert(next->debug_is_mutable());
+      RegionSemiSpace* reg = get(prev);
+      reg->finish_copy();
+
+      // Clear iso status on old root.
+      prev->init_next(nullptr);
+
+      // Set new root's iso status.
+      next->init_iso();
+      next->set_region(prev->get_region());
+    }
+
+    /**
+     * Merge the region whose iso is `o` into the region of `into`. No
+     * object moves: the other region's from-space and root are adopted as
+     * spaces of this region (see AdoptedSpace), along with the spaces it
+     * had adopted itself, and its large object space is spliced onto this
+     * one. So the cost does not depend on how many objects the regions
+     * hold, except for the side table of non-trivial large objects, the
+     * smaller of the remembered sets and the smaller of the external
+     * reference maps, which are copied. `o` stays where it is, and becomes
+     * an ordinary object of this region.
+     *
+     * Objects of the other region must not hold region_ptr fields, whose
+     * offsets are from the start of its own from-space.
+     **/
+    static void merge(Object* into, Object* o)
+    {
+      assert(o->debug_is_iso());
+      RegionSemiSpace* reg = get(into);
+      RegionBase* other_base = o->get_region();
+      assert(reg != other_base);
+      if (!is_semispace_region(other_base))
+        abort();
+
+      auto* other = (RegionSemiSpace*)other_base;
+      if (other->cursor != nullptr)
+        abort();
+      reg->finish_copy();
+      other->finish_copy();
+      if (reg->cursor != nullptr)
+        reg->cursor->flush();
+
+      // The other region's own to-space holds nothing.
+      other->free_space(other->to_space, other->to_space_size);
+
+      auto* space = new (heap::alloc<sizeof(AdoptedSpace)>()) AdoptedSpace{
+        other->from_space,
+        other->alloc_ptr,
+        other->semispace_size,
+        other->virtual_spaces,
+        nullptr};
+      space->non_trivial = other->from_non_trivial;
+      other->from_non_trivial = NonTrivialStack{};
+      reg->adopt(space);
+      reg->adopted_used += other->get_fromspace_used();
+
+      // The old root becomes a mutable object in a space of its own.
+      assert(o == other->pinned_iso_);
+      o->init_next(nullptr);
+      size_t root_size = snmalloc::bits::align_up(o->size(), Object::ALIGNMENT);
+      auto* root = new (heap::alloc<sizeof(AdoptedSpace)>()) AdoptedSpace{
+        o->real_start(), o->real_start() + root_size, 0, false, o};
+      if (!o->is_trivial())
+        root->non_trivial.push(o);
+      reg->adopt(root);
+      reg->adopted_used += root_size;
+
+      if (other->adopted != nullptr)
+      {
+        reg->adopted_last->next = other->adopted;
+        reg->adopted_last = other->adopted_last;
+        reg->adopted_used += other->adopted_used;
+        reg->adopted_count += other->adopted_count;
+      }
+
+      reg->large.merge(other->large);
+      while (!other->pinned.empty())
+        reg->pinned.push(other->pinned.pop());
+      reg->current_memory_used += other->current_memory_used;
+      reg->region_size += other->region_size;
+      reg->non_trivial_size += other->non_trivial_size;
+
+      reg->ExternalReferenceTable::merge(other);
+      reg->RememberedSet::merge(other);
+
+      other->free_sites();
+      other->dealloc();
+    }
+
+    /**
+     * Run Cheney-style semi-space garbage collection.
+     *
+     * Algorithm:
+     *   1. Scan the pinned iso root (root stays in place), and mark and
+     *      queue the objects pinned by pin().
+     *   2. Cheney scan loop — use scan/free pointers as a BFS queue:
+     *      - Each scanned object's fields are visited once, through its
+     *        Descriptor::relocate: from-space objects are copied to
+     *        to-space (forwarding pointer installed) and the field is
+     *        pointed at the copy straight away.
+     *      - Large objects are marked live in the large object space's
+     *        bitmap and scanned too.
+     *      - In a hierarchical copy, fresh copies are scanned from a
+     *        bounded stack ahead of the queue.
+     *      - ISO, IMMUTABLE, SHARED fields are left as-is / remembered.
+     *   3. Point the external references at the copies of their objects,
+     *      and invalidate those of dead objects.
+     *   4. Finalise dead non-trivial large objects.
+     *   5. Finalise and destruct dead objects in old from-space, then
+     *      destruct dead large objects. The rest of the large object space
+     *      is swept lazily.
+     *   6. Swap spaces and resize them for the next cycle, and free the
+     *      spaces adopted by merges. The iso root pointer is unchanged
+     *      (pinned).
+     *
+     * Objects in adopted spaces are copied as from-space objects are, into
+     * the same to-space.
+     *
+     * When more than one GC thread is configured and the from-space is
+     * large enough, phases 1-2 are run by parallel_copy() instead. With
+     * incremental copying, they are run in slices by start_copy() and
+     * copy_step(), and a call while a copy is pending runs the next slice.
+     *
+     * A non-zero `reserve` is the number of free bytes from-space must
+     * have afterwards; grow() uses it to resize the spaces as part of the
+     * collection, which finishes a pending incremental copy first.
+     **/
+    static Object* gc(Object* o, RegionSemiSpace* reg, size_t reserve = 0)
+    {
+      assert(o->debug_is_iso());
+      assert(o == reg->pinned_iso_);
+
+      if (reg->is_copy_pending())
+      {
+        if (reserve == 0)
+        {
+          reg->copy_step(o, get_copy_slice());
+          return o;
         }
+        reg->finish_copy();
+        if (static_cast<size_t>(reg->alloc_end - reg->alloc_ptr) >= reserve)
+          return o;
+      }
+
+      Logging::cout() << "SemiSpace GC called for: " << o << Logging::endl;
+
+      if (reg->cursor != nullptr)
+        reg->cursor->flush();
+
+      size_t capacity = reg->get_semispace_size();
+      size_t used = reg->get_fromspace_used() + reg->adopted_used;
+      size_t threads = get_gc_threads();
+      if constexpr (EventTrace::enabled)
+        EventTrace::record(
+          EventTrace::Event::SemiSpaceGC, (uintptr_t)o, used, capacity);
+      // The parallel and incremental copies only know of one from-space.
+      // An incremental copy allocates in to-space, where a cursor cannot.
+      bool incremental = (reserve == 0) && get_incremental_copy() &&
+        (reg->adopted == nullptr) && (reg->cursor == nullptr);
+      bool parallel = !incremental && threads > 1 &&
+        used >= PARALLEL_GC_MIN_BYTES && reg->adopted == nullptr;
+
+      // Survivors never exceed the used from-space, so that is all the copy
+      // needs. A parallel copy also wastes part of to-space on buffer tails
+      // and direct copies, so it gets head room for the worst case. An
+      // incremental copy gets the whole space, as the mutator allocates in
+      // it until the flip.
+      size_t copy_room = used;
+      if (parallel)
+        copy_room = used + used / 8 + threads * TLAB_SIZE;
+      else if (incremental)
+        copy_room = capacity;
+
+      // To-space must also keep the reserve free once it is from-space. It
+      // is empty, so enlarging it costs no copy. If the region has none, it
+      // is made at least at the size the last collection chose.
+      size_t to_needed = std::max(copy_room, used + reserve);
+      if (reg->to_space == nullptr || to_needed > reg->to_space_size)
+      {
+        size_t to_size =
+          std::max(reg->to_space_size, reg->space_size_for(to_needed));
+        reg->free_space(reg->to_space, reg->to_space_size);
+        reg->to_space = reg->alloc_space(to_size);
+        reg->to_space_size = to_size;
+        reg->to_committed = 0;
+      }
+
+      if (incremental)
+      {
+        reg->start_copy(o, copy_room, capacity, used);
+        return o;
       }
-      reg->large_objects = live_large;
+
+      GCPhases::Scope phase(GCPhases::Copy);
+      CopyState cs{reg->to_space, reg->prepare_to_space(copy_room)};
+      reg->large.begin_collection();
+
+      if (parallel)
+        parallel_copy(o, reg, cs, threads);
+      else
+        sequential_copy(o, reg, cs);
+      GCPhases::copied(cs.live_bytes);
+
+      flip(o, reg, cs, capacity, used, reserve);
+      return o;
+    }
+
+  private:
+    /**
+     * Phases 3-6 of gc(), once everything reachable has been copied with
+     * `cs`. `capacity` and `used` are the size of from-space and the bytes
+     * used in it when the collection started.
+     **/
+    static void flip(
+      Object* o,
+      RegionSemiSpace* reg,
+      CopyState& cs,
+      size_t capacity,
+      size_t used,
+      size_t reserve)
+    {
+      // Phase 3: Update the external references. This visits only the
+      // objects that have one.
+      GCPhases::Scope phase(GCPhases::UpdatePointers);
+      reg->ExternalReferenceTable::relocate([reg](Object* p) -> Object* {
+        if (p == reg->pinned_iso_)
+          return p;
+        if (reg->is_in_from(p))
+          return is_forwarded(p) ? get_forwarding_target(p) : nullptr;
+        // Made during an incremental copy, where the copies go.
+        if (is_in_space(p, reg->to_space, reg->to_space_size))
+          return p;
+        return LargeObjectSpace::is_marked(p) ? p : nullptr;
+      });
+
+      // Phase 4: Finalise dead large objects. Only their side table of
+      // non-trivial objects is visited; the live ones were scanned when
+      // they were marked.
+      phase.next(GCPhases::LargeObjects);
+      reg->large.finalise_dead();
 
       // Phase 5: Finalize dead objects in old from-space.
+      phase.next(GCPhases::Finalise);
       // All non-forwarded objects in from-space are dead (the pinned root
-      // was never in from-space, so it is unaffected).
+      // was never in from-space, so it is unaffected). Only the side table
+      // of non-trivial objects is visited; trivial garbage needs no work.
       // We need to run finalisers before destructors for non-trivial objects.
       {
-        // First pass: finalisers for non-trivial dead objects in from-space.
-        std::byte* p = reg->from_space;
-        std::byte* end = reg->alloc_ptr;
         ObjectStack dummy_isos;
-        while (p < end)
-        {
-          Object* obj = Object::object_start(p);
-          size_t obj_size =
-            snmalloc::bits::align_up(obj->size(), Object::ALIGNMENT);
-
-          if (obj->get_class() != Object::MARKED)
-          {
-            // This object was NOT forwarded — it's dead.
-            if (!obj->is_trivial())
-            {
+        auto finalise_dead = [&dummy_isos](NonTrivialStack& table) {
+          table.forall([&dummy_isos](Object* obj) {
+            // An object that was NOT forwarded is dead.
+            if (!is_forwarded(obj))
               obj->finalise(nullptr, dummy_isos);
-            }
-          }
-          p += obj_size;
-        }
-
-        // Second pass: destructors for non-trivial dead objects.
-        p = reg->from_space;
-        while (p < end)
-        {
-          Object* obj = Object::object_start(p);
-          size_t obj_size =
-            snmalloc::bits::align_up(obj->size(), Object::ALIGNMENT);
-
-          if (obj->get_class() != Object::MARKED)
+          });
+        };
+        finalise_dead(reg->from_non_trivial);
+        for (AdoptedSpace* a = reg->adopted; a != nullptr; a = a->next)
+          finalise_dead(a->non_trivial);
+
+        // Destructors for the dead objects; this also empties the tables.
+        auto destruct_dead = [reg](NonTrivialStack& table) {
+          while (!table.empty())
           {
-            if (!obj->is_trivial())
+            Object* obj = table.pop();
+            if (!is_forwarded(obj))
             {
               obj->destructor();
+              reg->non_trivial_size -= 1;
             }
           }
-          p += obj_size;
-        }
+        };
+        destruct_dead(reg->from_non_trivial);
+        for (AdoptedSpace* a = reg->adopted; a != nullptr; a = a->next)
+          destruct_dead(a->non_trivial);
+
+        reg->non_trivial_size -=
+          reg->large.end_collection(cs.large_objects, cs.large_bytes);
       }
 
       // Phase 6: Swap spaces.
+      phase.next(GCPhases::Sweep);
       // Old from-space is now free. New from-space is to-space (with live
-      // data). Both spaces are always equal in size.
+      // data).
       std::byte* old_from = reg->from_space;
+      size_t old_from_size = reg->semispace_size;
+      size_t old_from_committed = reg->from_committed;
       reg->from_space = reg->to_space;
+      reg->semispace_size = reg->to_space_size;
+      reg->from_committed = reg->to_committed;
       reg->to_space = old_from;
-      reg->alloc_ptr = free_ptr;
-      reg->alloc_end = reg->from_space + reg->semispace_size;
+      reg->to_space_size = old_from_size;
+      reg->to_committed = old_from_committed;
+      reg->alloc_ptr = cs.free_ptr;
+      reg->from_non_trivial = cs.non_trivial;
+      reg->free_adopted();
+
+      phase.next(GCPhases::Stats);
+      if (reg->sites != nullptr)
+        reg->count_sites();
+      size_t live = reg->get_fromspace_used();
+      size_t next_size = std::max(
+        reg->choose_semispace_size(capacity, live),
+        reg->semispace_size_for(live + reserve));
+      if constexpr (Logging::enabled)
+        Logging::cout() << "SemiSpace sizing: survived " << live << " of "
+                        << used << " bytes, size " << capacity << " -> "
+                        << next_size << Logging::endl;
+      if constexpr (EventTrace::enabled)
+        EventTrace::record(
+          EventTrace::Event::SemiSpaceGCDone, (uintptr_t)o, live, next_size);
+      reg->resize_spaces(next_size);
+
+      // Memory used: pinned root + copied live data + live large objects.
+      // The copy loop counted the survivors, so no walk of the new
+      // from-space is needed.
+      reg->current_memory_used = o->size() + cs.live_bytes + cs.large_bytes;
+      reg->region_size = 1 + cs.live_objects + cs.large_objects;
+
+      // Sweep the remembered set.
+      phase.next(GCPhases::Sweep);
+      reg->RememberedSet::sweep();
+
+      if (reg->cursor != nullptr)
+        reg->cursor->reload();
+
+      // The root is pinned — no address change, no need to re-init iso.
+      Logging::cout() << "SemiSpace GC complete. Iso (pinned): " << o
+                      << Logging::endl;
+    }
+
+    /**
+     * Start an incremental copy of the region with iso object `o` into
+     * the first `copy_room` bytes of to-space: scan the root, mark the
+     * pinned objects, and run the first slice. From here until the flip,
+     * from-space takes no allocations.
+     **/
+    void start_copy(Object* o, size_t copy_room, size_t capacity, size_t used)
+    {
+      assert(!is_copy_pending());
+      Logging::cout() << "SemiSpace GC: start incremental copy: " << o
+                      << Logging::endl;
+
+      GCPhases::Scope phase(GCPhases::Roots);
+      copy = new (heap::alloc<sizeof(IncrementalCopy)>()) IncrementalCopy;
+      CopyState& cs = copy->cs;
+      cs.free_ptr = to_space;
+      cs.to_end = prepare_to_space(copy_room);
+      copy->scan = to_space;
+      copy->capacity = capacity;
+      copy->used = used;
+      pending_copies_.fetch_add(1, std::memory_order_relaxed);
+      large.begin_collection();
+      alloc_limit = alloc_ptr;
+
+      gc_region_ = this;
+      gc_copy_state_ = &cs;
+      scan_object(o, this, cs);
+      pinned.forall([&cs](Object* p) {
+        if (LargeObjectSpace::mark(p))
+        {
+          cs.large_pending.push(p);
+          cs.large_objects++;
+          cs.large_bytes += p->size();
+          HeapProfile::count(p);
+        }
+      });
+      gc_region_ = nullptr;
+      gc_copy_state_ = nullptr;
+
+      copy_step(o, get_copy_slice());
+    }
+
+    /**
+     * Advance the pending incremental copy of the region with iso object
+     * `o` by scanning up to `budget` bytes. If that catches the scan up
+     * with the copy, the spaces are flipped and the copy is over.
+     **/
+    void copy_step(Object* o, size_t budget)
+    {
+      assert(is_copy_pending());
+      GCPhases::Scope phase(GCPhases::Copy);
+      CopyState& cs = copy->cs;
+      gc_region_ = this;
+      gc_copy_state_ = &cs;
+
+      size_t scanned = 0;
+      while (scanned < budget)
+      {
+        Object* current;
+        if (copy->scan < cs.free_ptr)
+        {
+          current = Object::object_start(copy->scan);
+          size_t sz =
+            snmalloc::bits::align_up(current->size(), Object::ALIGNMENT);
+          copy->scan += sz;
+          scanned += sz;
+        }
+        else if (!cs.large_pending.empty())
+        {
+          current = cs.large_pending.pop();
+          scanned += current->size();
+        }
+        else
+        {
+          break;
+        }
+        scan_object(current, this, cs);
+      }
+
+      gc_region_ = nullptr;
+      gc_copy_state_ = nullptr;
+
+      if ((copy->scan < cs.free_ptr) || !cs.large_pending.empty())
+        return;
+
+      IncrementalCopy* c = copy;
+      copy = nullptr;
+      pending_copies_.fetch_sub(1, std::memory_order_relaxed);
+      GCPhases::copied(c->cs.live_bytes);
+      flip(o, this, c->cs, c->capacity, c->used, 0);
+      c->~IncrementalCopy();
+      heap::dealloc<sizeof(IncrementalCopy)>(c);
+    }
+
+    /**
+     * Run a pending incremental copy to the end, if there is one.
+     **/
+    void finish_copy()
+    {
+      if (is_copy_pending())
+        copy_step(pinned_iso_, std::numeric_limits<size_t>::max());
+    }
+
+    /**
+     * Allocate an object as alloc_internal() does, at the end of to-space
+     * during an incremental copy, where the scan will reach it. Returns
+     * nullptr if that would leave too little room for the objects still to
+     * be copied.
+     **/
+    Object* alloc_copying(const Descriptor* desc, size_t tail)
+    {
+      size_t size = Object::size_of(desc, tail);
+      size_t sz = snmalloc::bits::align_up(size, Object::ALIGNMENT);
+      CopyState& cs = copy->cs;
+      size_t room = static_cast<size_t>(cs.to_end - to_space);
+      if (copy->used + copy->allocated + sz > room)
+        return nullptr;
+
+      copy->allocated += sz;
+      current_memory_used += size;
+      region_size += 1;
+      cs.live_bytes += size;
+      cs.live_objects++;
+
+      void* p = cs.free_ptr;
+      cs.free_ptr += sz;
+      Object* o = Object::register_object(p, desc);
+      o->init_tail(tail);
+      o->init_next(nullptr);
+      HeapProfile::count(o);
+      if (!Object::is_trivial(desc))
+      {
+        cs.non_trivial.push(o);
+        non_trivial_size += 1;
+      }
+      return o;
+    }
+
+    /**
+     * Sizing policy: the semi-space size for the cycle after a collection
+     * that left `live` bytes in a from-space of `current` usable bytes.
+     * Sizes are power-of-two multiples of the initial size, as grow()
+     * produces.
+     **/
+    size_t choose_semispace_size(size_t current, size_t live) const
+    {
+      size_t desired = live * 100 / get_target_occupancy();
+      size_t target = semispace_size_for(desired);
+
+      // Both spaces count against the budget, but the survivors must
+      // always fit with some room to spare.
+      size_t limit = std::numeric_limits<size_t>::max();
+      size_t budget = get_memory_budget();
+      if (budget != 0)
+      {
+        size_t cap = initial_size;
+        while (cap * 2 <= budget / 2)
+          cap *= 2;
+        limit = std::max(cap, semispace_size_for(live + 1));
+        target = std::min(target, limit);
+      }
+
+      if (target > current)
+        return target;
+
+      // Shrink only with a clear margin, unless the budget demands it.
+      if (target < current && (current > limit || desired <= current / 4))
+        return target;
+
+      return current;
+    }
+
+    /**
+     * The smallest power-of-two multiple of the initial size that holds
+     * `bytes`.
+     **/
+    size_t semispace_size_for(size_t bytes) const
+    {
+      size_t size = initial_size;
+      while (size < bytes)
+        size *= 2;
+      return size;
+    }
+
+    static size_t round_initial_size(size_t bytes)
+    {
+      return snmalloc::bits::next_pow2(std::max(bytes, MIN_SEMISPACE_SIZE));
+    }
+
+    /**
+     * Apply a size picked by choose_semispace_size() after the spaces have
+     * been swapped. The to-space is empty and is reallocated straight
+     * away, or freed if the retention policy says so or there is memory
+     * pressure (see MemoryPressure). The from-space holds the survivors, so
+     * it is only bounded by alloc_end; the next collection frees it.
+     *
+     * Virtual spaces ignore the size: the empty to-space only gives its
+     * pages back, and is moved to a larger reservation if from-space has
+     * outgrown it.
+     **/
+    void resize_spaces(size_t size)
+    {
+      bool release =
+        (get_to_space_retention() == ToSpaceRetention::Release) ||
+        MemoryPressure::is_under_pressure();
+      if (virtual_spaces)
+      {
+        if (release || to_space_size < semispace_size)
+        {
+          free_space(to_space, to_space_size);
+          to_space_size = std::max(to_space_size, semispace_size);
+          to_space = release ? nullptr : alloc_space(to_space_size);
+        }
+        else if (to_committed != 0)
+        {
+          pal::vm_decommit(to_space, to_committed);
+        }
+        to_committed = 0;
+
+        // The copy was given room for all of the old from-space; keep only
+        // what the survivors use.
+        size_t keep = snmalloc::bits::align_up(
+          static_cast<size_t>(alloc_ptr - from_space), pal::VM_GRANULE);
+        if (from_committed > keep)
+        {
+          pal::vm_decommit(from_space + keep, from_committed - keep);
+          from_committed = keep;
+        }
+        size = to_space_size;
+      }
+      else if (release)
+      {
+        free_space(to_space, to_space_size);
+        to_space = nullptr;
+        to_space_size = size;
+      }
+      else if (to_space_size != size)
+      {
+        free_space(to_space, to_space_size);
+        to_space = alloc_space(size);
+        to_space_size = size;
+      }
+      alloc_end = from_space + std::min(semispace_size, size);
+      assert(alloc_ptr <= alloc_end);
+      update_alloc_limit();
+    }
+
+    /**
+     * Allocate or free the memory of one space of `size` bytes: a heap
+     * block, through the thread's ChunkCache, or a reservation with nothing
+     * committed.
+     **/
+    std::byte* alloc_space(size_t size)
+    {
+      if (!virtual_spaces)
+        return (std::byte*)ChunkCache::alloc(size);
+
+      auto* p = (std::byte*)pal::vm_reserve(size);
+      if (p == nullptr)
+        abort();
+      return p;
+    }
+
+    void free_space(std::byte* p, size_t size)
+    {
+      if (p == nullptr)
+        return;
+
+      if (virtual_spaces)
+        pal::vm_release(p, size);
+      else
+        ChunkCache::dealloc(p, size);
+    }
+
+    /**
+     * Size of a space that holds `bytes`. Reservations never shrink below
+     * VIRTUAL_SPACE_RESERVE.
+     **/
+    size_t space_size_for(size_t bytes) const
+    {
+      size_t size = semispace_size_for(bytes);
+      if (virtual_spaces)
+        size = std::max(size, VIRTUAL_SPACE_RESERVE);
+      return size;
+    }
+
+    /**
+     * Back the first `bytes` of to-space with memory, and return the end
+     * of what a copy may use.
+     **/
+    std::byte* prepare_to_space(size_t bytes)
+    {
+      if (!virtual_spaces)
+        return to_space + to_space_size;
+
+      size_t commit = std::min(
+        snmalloc::bits::align_up(bytes, pal::VM_GRANULE), to_space_size);
+      if (commit > to_committed)
+      {
+        pal::vm_commit(to_space + to_committed, commit - to_committed);
+        to_committed = commit;
+      }
+      return to_space + to_committed;
+    }
+
+    void update_alloc_limit()
+    {
+      alloc_limit = alloc_end;
+      if (virtual_spaces)
+        alloc_limit = std::min(alloc_end, from_space + from_committed);
+    }
+
+    /**
+     * Commit enough of from-space for an allocation of `sz` bytes at
+     * alloc_ptr.
+     **/
+    void commit_from_space(size_t sz)
+    {
+      size_t needed = static_cast<size_t>(alloc_ptr + sz - from_space);
+      size_t commit = std::min(
+        snmalloc::bits::align_up(needed, pal::VM_GRANULE), semispace_size);
+      pal::vm_commit(from_space + from_committed, commit - from_committed);
+      from_committed = commit;
+      update_alloc_limit();
+    }
+
+    /**
+     * Allocate an object of type `desc`, with a trailing array of `tail`
+     * elements, in the from-space, or in the large object space if it is
+     * above the region's threshold.
+     **/
+    Object* alloc_internal(const Descriptor* desc, size_t tail = 0)
+    {
+      size_t size = Object::size_of(desc, tail);
+      size_t sz = snmalloc::bits::align_up(size, Object::ALIGNMENT);
+
+      if (SNMALLOC_UNLIKELY(AllocSites::is_enabled()) && pretenure(desc))
+        return alloc_large(desc, tail);
+
+      if (sz > large_object_threshold)
+        return alloc_large(desc, tail);
+
+      // Check if we have space in from-space; grow if needed. Growing
+      // collects, which recomputes the metrics, so count this object after.
+      // With virtual spaces the space may also need committing first.
+      if (alloc_ptr + sz > alloc_limit)
+      {
+        if (is_copy_pending())
+        {
+          Object* o = alloc_copying(desc, tail);
+          if (o != nullptr)
+            return o;
+          finish_copy();
+        }
+        if (alloc_ptr + sz > alloc_end)
+        {
+          AllocStats::slow_path(RegionType::SemiSpace);
+          grow(sz);
+        }
+        if (alloc_ptr + sz > alloc_limit)
+          commit_from_space(sz);
+      }
+      current_memory_used += size;
+      region_size += 1;
+
+      void* p = alloc_ptr;
+      alloc_ptr += sz;
+      Object* o = Object::register_object(p, desc);
+      o->init_tail(tail);
+      o->init_next(nullptr);
+      if (!Object::is_trivial(desc))
+      {
+        from_non_trivial.push(o);
+        non_trivial_size += 1;
+      }
+      return o;
+    }
+
+    /**
+     * Count an allocation of `desc` at its site, and return whether the
+     * site is pretenured, so the object belongs in the large object space.
+     **/
+    bool pretenure(const Descriptor* desc)
+    {
+      if (sites == nullptr)
+        sites = new (heap::alloc<sizeof(AllocSites)>()) AllocSites();
+      return sites->allocated(desc);
+    }
+
+    /**
+     * Count the objects of each allocation site that the collection just
+     * flipped found alive, in from-space and the large object space.
+     **/
+    void count_sites()
+    {
+      for (std::byte* p = from_space; p < alloc_ptr;)
+      {
+        Object* obj = Object::object_start(p);
+        p += space_size(obj);
+        sites->found(obj);
+      }
+      LargeObjectSpace::Cursor cursor{};
+      for (Object* o = large.first(cursor); o != nullptr;
+           o = large.next(cursor))
+        sites->found(o);
+      sites->collected();
+    }
+
+    void free_sites()
+    {
+      if (sites == nullptr)
+        return;
+      sites->~AllocSites();
+      heap::dealloc<sizeof(AllocSites)>(sites);
+      sites = nullptr;
+    }
+
+    /**
+     * Allocate an object of type `desc`, with a trailing array of `tail`
+     * elements, in the large object space.
+     **/
+    Object* alloc_large(const Descriptor* desc, size_t tail = 0)
+    {
+      size_t size = Object::size_of(desc, tail);
+      Object* o = large.alloc(desc, size);
+      o->init_tail(tail);
+      current_memory_used += size;
+      region_size += 1;
+      if (!o->is_trivial())
+        non_trivial_size += 1;
+
+      // During an incremental copy it is live, and only ever given
+      // references the copy keeps.
+      if (is_copy_pending())
+      {
+        LargeObjectSpace::mark(o);
+        copy->cs.large_objects++;
+        copy->cs.large_bytes += o->size();
+        HeapProfile::count(o);
+      }
+      return o;
+    }
+
+    /**
+     * Make room for at least `needed` more bytes in from-space.
+     *
+     * Growing is a collection into a to-space big enough for everything
+     * in from-space plus `needed`: the copy compacts the survivors and
+     * moves them into the larger space in one pass, and the sizing policy
+     * then settles both spaces at a size that keeps `needed` free. Only
+     * pointers to survivors are rewritten, by the copy itself, and
+     * unreachable objects are reclaimed on the way. The pinned root does
+     * not move.
+     **/
+    void grow(size_t needed)
+    {
+      if constexpr (Logging::enabled)
+        Logging::cout() << "SemiSpace grow: " << get_fromspace_used()
+                        << " used, " << needed << " needed, size "
+                        << get_semispace_size() << Logging::endl;
+      if constexpr (EventTrace::enabled)
+        EventTrace::record(
+          EventTrace::Event::SemiSpaceGrow,
+          get_fromspace_used(),
+          needed,
+          get_semispace_size());
+
+      gc(pinned_iso_, this, needed);
+      assert(static_cast<size_t>(alloc_end - alloc_ptr) >= needed);
+    }
+
+    void adopt(AdoptedSpace* space)
+    {
+      if (adopted_last == nullptr)
+        adopted = space;
+      else
+        adopted_last->next = space;
+      adopted_last = space;
+      adopted_count++;
+    }
+
+    /**
+     * Free the adopted spaces, whose objects have been copied out or were
+     * dead. Their side tables must be empty already.
+     **/
+    void free_adopted()
+    {
+      while (adopted != nullptr)
+      {
+        AdoptedSpace* a = adopted;
+        adopted = a->next;
+        assert(a->non_trivial.empty());
+        if (a->root != nullptr)
+          a->root->dealloc();
+        else if (a->virtual_space)
+          pal::vm_release(a->start, a->size);
+        else
+          ChunkCache::dealloc(a->start, a->size);
+        heap::dealloc<sizeof(AdoptedSpace)>(a);
+      }
+      adopted_last = nullptr;
+      adopted_used = 0;
+      adopted_count = 0;
+    }
+
+    /**
+     * Check if an object is in from-space or in an adopted space, which are
+     * what a collection copies out of.
+     **/
+    bool is_in_from(Object* o) const
+    {
+      if (is_in_space(o, from_space, semispace_size))
+        return true;
+      for (AdoptedSpace* a = adopted; a != nullptr; a = a->next)
+      {
+        if (is_in_space(o, a->start, static_cast<size_t>(a->end - a->start)))
+          return true;
+      }
+      return false;
+    }
+
+    /**
+     * Check if an object is in a given memory space.
+     **/
+    static bool is_in_space(Object* o, std::byte* space_start, size_t space_sz)
+    {
+      auto addr = (std::byte*)o->real_start();
+      return addr >= space_start && addr < (space_start + space_sz);
+    }
+
+    /**
+     * Check if an object of this region is in the large object space,
+     * outside the spaces a collection copies and the root. Unlike
+     * is_large_object(), this also holds between collections.
+     **/
+    bool is_in_large(Object* o) const
+    {
+      return o != pinned_iso_ && !is_in_from(o) &&
+        !is_in_space(o, to_space, to_space_size);
+    }
+
+    /**
+     * Check if an object is a large object (allocated outside semi-spaces).
+     **/
+    static bool is_large_object(Object* o, RegionSemiSpace* reg)
+    {
+      return !reg->is_in_from(o) &&
+        !is_in_space(o, reg->to_space, reg->to_space_size);
+    }
+
+    /**
+     * State of an incremental copy between slices. The to-space objects
+     * from `scan` up to `cs.free_ptr` are still to be scanned, and so are
+     * the large objects in `cs.large_pending`.
+     **/
+    struct IncrementalCopy
+    {
+      CopyState cs{nullptr, nullptr};
+      std::byte* scan = nullptr;
+      /// Size of from-space, and the bytes used in it, at the start.
+      size_t capacity = 0;
+      size_t used = 0;
+      /// Bytes the mutator has allocated in to-space since the start.
+      size_t allocated = 0;
+    };
+
+    /// Collection in progress on this thread, for the copy_and_forward
+    /// callback, which Descriptor::relocate gives no context argument.
+    static inline thread_local RegionSemiSpace* gc_region_ = nullptr;
+    static inline thread_local CopyState* gc_copy_state_ = nullptr;
+
+    /**
+     * Phases 1-2 of gc() on the calling thread: copy everything reachable
+     * from the pinned root `o` into to-space. Each object's fields are
+     * forwarded as they are scanned, so no separate pointer-update pass is
+     * needed.
+     **/
+    static void sequential_copy(Object* o, RegionSemiSpace* reg, CopyState& cs)
+    {
+      std::byte* scan = cs.free_ptr;
+      gc_region_ = reg;
+      gc_copy_state_ = &cs;
+      cs.hierarchical = get_copy_order() == CopyOrder::Hierarchical;
+      // A hierarchical copy scans most objects as soon as it copies them.
+      cs.coalesce = !cs.hierarchical && get_coalesced_copy();
+
+      // Phase 1: The iso root is pinned on the heap — don't copy it.
+      // Copy its children and point its fields at the copies.
+      GCPhases::Scope phase(GCPhases::Roots);
+      scan_object(o, reg, cs);
+      std::reverse(cs.stack, cs.stack + cs.stack_depth);
+
+      // Pinned objects are roots too. They are large, so they are marked in
+      // place and scanned once the queue drains.
+      reg->pinned.forall([&cs](Object* p) {
+        if (LargeObjectSpace::mark(p))
+        {
+          cs.large_pending.push(p);
+          cs.large_objects++;
+          cs.large_bytes += p->size();
+          HeapProfile::count(p);
+        }
+      });
+      phase.next(GCPhases::Copy);
+
+      // Phase 2: Cheney scan loop.
+      // scan walks through to-space objects; free_ptr is where next copy goes.
+      // From-space objects are copied on first encounter; large objects are
+      // marked as live in place and scanned once the queue drains.
+      // In a hierarchical copy, the copies on cs.stack are scanned first.
+      // They are marked when scanned, so that the Cheney scan skips them
+      // when it gets there, and unmarks them.
+      while (true)
+      {
+        Object* current;
+        if (cs.stack_depth > 0)
+        {
+          current = cs.stack[--cs.stack_depth];
+          current->mark();
+        }
+        else if (scan < cs.free_ptr)
+        {
+          if ((cs.run_len != 0) && (scan >= cs.run_dst))
+            flush_run(cs);
+          current = Object::object_start(scan);
+          scan += snmalloc::bits::align_up(current->size(), Object::ALIGNMENT);
+          if (current->get_class() == Object::MARKED)
+          {
+            current->unmark();
+            continue;
+          }
+          // The next object to scan, whose fields are read after the
+          // children of this one are copied.
+          if (
+            (scan < cs.free_ptr) &&
+            ((cs.run_len == 0) || (scan < cs.run_dst)))
+            Aal::prefetch(scan);
+        }
+        else if (!cs.large_pending.empty())
+        {
+          current = cs.large_pending.pop();
+        }
+        else
+        {
+          break;
+        }
+
+        // Scan the children of `current` in field order, so the first
+        // field's subtree ends up right after it.
+        size_t depth = cs.stack_depth;
+        scan_object(current, reg, cs);
+        std::reverse(cs.stack + depth, cs.stack + cs.stack_depth);
+      }
+      flush_run(cs);
+
+      gc_region_ = nullptr;
+      gc_copy_state_ = nullptr;
+    }
+
+    /**
+     * Copy the children of `obj` and update its fields to point at them,
+     * in a single visit.
+     *
+     * With a pointer map or a `relocate` function, every pointer field goes
+     * through copy_and_forward() exactly once. Otherwise the fields are
+     * found by tracing, and then patched where they hold one of the traced
+     * references (see patch_moved()), or, with set_word_scan() on, by a
+     * scan of the body (see patch_fields()).
+     **/
+    static void scan_object(Object* obj, RegionSemiSpace* reg, CopyState& cs)
+    {
+      if (obj->relocate_mapped(copy_and_forward))
+        return;
+
+      auto* descriptor = obj->get_descriptor();
+      if (descriptor->relocate != nullptr)
+      {
+        descriptor->relocate(obj, copy_and_forward);
+        return;
+      }
+
+      obj->trace(cs.fields);
+      if (cs.to_heap || !get_word_scan())
+      {
+        patch_moved(obj, cs.fields, cs.moved, copy_and_forward);
+        return;
+      }
+      while (!cs.fields.empty())
+        copy_and_forward(cs.fields.pop());
+      patch_fields(obj, reg->from_space, reg->semispace_size);
+      for (AdoptedSpace* a = reg->adopted; a != nullptr; a = a->next)
+        patch_fields(obj, a->start, static_cast<size_t>(a->end - a->start));
+    }
+
+    /**
+     * Forwarding callback passed to Descriptor::relocate during a
+     * single-threaded copy. A from-space object is copied on its first
+     * visit, and its to-space address returned. Large objects are marked
+     * and queued for scanning, and immutable and shared objects are
+     * remembered. Any other reference is returned unchanged.
+     **/
+    static Object* copy_and_forward(Object* field)
+    {
+      RegionSemiSpace* reg = gc_region_;
+      CopyState& cs = *gc_copy_state_;
+
+      switch (field->get_class())
+      {
+        case Object::ISO:
+          // Subregion pointer — don't copy, leave as-is.
+          break;
+
+        case Object::UNMARKED:
+        {
+          // Live object in from-space, not yet copied.
+          if (reg->is_in_from(field))
+          {
+            Object* new_obj = copy_object(field, cs);
+            // to-space is the same size as from-space and we only
+            // copy live objects, so this should never fail.
+            assert(new_obj != nullptr);
+            if (cs.to_heap)
+              cs.heap_pending.push(new_obj);
+            else if (cs.hierarchical && cs.stack_depth < COPY_STACK_DEPTH)
+              cs.stack[cs.stack_depth++] = new_obj;
+            return new_obj;
+          }
+
+          if (is_large_object(field, reg) && LargeObjectSpace::mark(field))
+          {
+            if (cs.to_heap)
+            {
+              Object* new_obj = copy_object(field, cs);
+              cs.heap_pending.push(new_obj);
+              return new_obj;
+            }
+
+            // Large object seen for the first time: scan it later, so
+            // that what it references survives too.
+            cs.large_pending.push(field);
+            cs.large_objects++;
+            cs.large_bytes += field->size();
+            HeapProfile::count(field);
+          }
+          break;
+        }
+
+        case Object::MARKED:
+        {
+          // Already copied (forwarded).
+          if (
+            reg->is_in_from(field) ||
+            (cs.to_heap && is_large_object(field, reg)))
+            return get_forwarding_target(field);
+          break;
+        }
+
+        case Object::SCC_PTR:
+        {
+          Object* imm = field->immutable();
+          reg->RememberedSet::mark(imm);
+          break;
+        }
+
+        case Object::RC:
+        case Object::SHARED:
+        {
+          reg->RememberedSet::mark(field);
+          break;
+        }
+
+        default:
+          break;
+      }
+      return field;
+    }
+
+    /**
+     * Copy an object from from-space to to-space, or to the heap when
+     * copying for a freeze.
+     * Installs a forwarding pointer in the old object using the MARKED tag.
+     * Returns a pointer to the new object in to-space.
+     * Returns nullptr if there's not enough space.
+     **/
+    static Object* copy_object(Object* old_obj, CopyState& cs)
+    {
+      size_t size = old_obj->size();
+      size_t obj_size = snmalloc::bits::align_up(size, Object::ALIGNMENT);
+      std::byte*& free_ptr = cs.free_ptr;
 
-      // Update memory used: pinned root + from-space live data + large objects.
-      reg->current_memory_used = o->size();
-      reg->region_size = 1;
+      std::byte* dst;
+      if (cs.to_heap)
       {
-        std::byte* p = reg->from_space;
-        while (p < reg->alloc_ptr)
-        {
-          Object* obj = Object::object_start(p);
-          reg->current_memory_used += obj->size();
-          reg->region_size += 1;
-          p += snmalloc::bits::align_up(obj->size(), Object::ALIGNMENT);
-        }
-        // Add large objects.
-        Object* lo = reg->large_objects;
-        while (lo != nullptr)
+        dst = (std::byte*)heap::alloc(obj_size);
+      }
+      else
+      {
+        if (free_ptr + obj_size > cs.to_end)
+          return nullptr;
+        dst = free_ptr;
+        free_ptr += obj_size;
+      }
+
+      std::byte* src = old_obj->real_start();
+      Object* new_obj = Object::object_start(dst);
+      if (cs.coalesce)
+      {
+        // Extend the run if this object follows it in both spaces, and
+        // leave the copy to flush_run().
+        if (
+          (cs.run_len == 0) || (src != cs.run_src + cs.run_len) ||
+          (dst != cs.run_dst + cs.run_len))
         {
-          reg->current_memory_used += lo->size();
-          reg->region_size += 1;
-          lo = lo->get_next();
+          flush_run(cs);
+          cs.run_src = src;
+          cs.run_dst = dst;
         }
+        cs.run_len += obj_size;
+      }
+      else
+      {
+        // Copy the entire object (header + body) to to-space.
+        std::memcpy(dst, src, obj_size);
+        // Ensure the new object is UNMARKED (mutable) — clear any tags.
+        new_obj->init_next(nullptr);
       }
 
-      // Sweep the remembered set.
-      reg->RememberedSet::sweep();
+      // Install forwarding pointer in old object.
+      // We use the MARKED bit plus the new address in the upper bits.
+      // This works because the header `bits` field stores tag in low bits
+      // and payload in upper bits — same pattern as ISO/set_region.
+      old_obj->set_forwarding_pointer(new_obj);
 
-      // The root is pinned — no address change, no need to re-init iso.
-      Logging::cout() << "SemiSpace GC complete. Iso (pinned): " << o
-                      << Logging::endl;
+      cs.live_bytes += size;
+      cs.live_objects++;
+      HeapProfile::count(new_obj);
+      if (!old_obj->is_trivial())
+        cs.non_trivial.push(new_obj);
 
-      return o;
+      return new_obj;
     }
 
-  private:
     /**
-     * Allocate an object of type `desc` in the from-space.
-     * If the object is too large for the semi-space, allocate via heap.
+     * Copy the pending run of a coalesced copy, if there is one. The
+     * originals hold their forwarding pointers by now, so each copy's
+     * header word is reset as copy_object() resets it. The object sizes are
+     * read from the originals, which the copy has just brought into cache.
      **/
-    Object* alloc_internal(const Descriptor* desc)
+    static void flush_run(CopyState& cs)
     {
-      size_t sz = snmalloc::bits::align_up(desc->size, Object::ALIGNMENT);
-      current_memory_used += desc->size;
-      region_size += 1;
+      if (cs.run_len == 0)
+        return;
 
-      if (sz > LARGE_OBJECT_THRESHOLD)
+      std::byte* src = cs.run_src;
+      std::byte* dst = cs.run_dst;
+      size_t len = cs.run_len;
+      cs.run_len = 0;
+
+#if defined(__x86_64__) || defined(_M_X64)
+      if constexpr (Object::ALIGNMENT % sizeof(__m128i) == 0)
       {
-        // Large object: allocate via heap and add to large object list.
-        void* p = heap::alloc(desc->size);
-        Object* o = Object::register_object(p, desc);
-        o->init_next(large_objects);
-        large_objects = o;
-        return o;
+        if (len >= STREAM_COPY_THRESHOLD)
+        {
+          stream_run(dst, src, len);
+          return;
+        }
       }
+#endif
 
-      // Check if we have space in from-space; grow if needed.
-      if (alloc_ptr + sz > alloc_end)
+      std::memcpy(dst, src, len);
+      for (size_t off = 0; off < len;)
       {
-        grow(sz);
+        Object* obj = Object::object_start(src + off);
+        Object::object_start(dst + off)->init_next(nullptr);
+        off += snmalloc::bits::align_up(obj->size(), Object::ALIGNMENT);
       }
-
-      void* p = alloc_ptr;
-      alloc_ptr += sz;
-      Object* o = Object::register_object(p, desc);
-      o->init_next(nullptr);
-      return o;
     }
 
+#if defined(__x86_64__) || defined(_M_X64)
     /**
-     * Grow both semi-spaces so that at least `needed` additional bytes
-     * can be allocated in from-space. The size is doubled repeatedly
-     * until the requirement is met.
-     *
-     * After the raw byte copy, all pointer fields inside from-space
-     * objects (and large objects / the pinned root that reference
-     * from-space) are adjusted by the address delta so they remain
-     * valid. The pinned root itself is heap-allocated and does not
-     * move.
-     *
-     * Steps:
-     *   1. Compute a new size (at least double the current size).
-     *   2. Allocate a new from-space, copy existing live data, free old.
-     *   3. Allocate a new to-space, free old.
-     *   4. Update alloc_ptr / alloc_end.
-     *   5. Adjust all pointer fields by the address delta.
+     * flush_run() with non-temporal stores, which do not bring to-space
+     * into the cache. The header word of each copy is cleared in the
+     * first store of the object rather than written again afterwards,
+     * which would read the line back.
      **/
-    void grow(size_t needed)
+    static void stream_run(std::byte* dst, std::byte* src, size_t len)
     {
-      size_t used = static_cast<size_t>(alloc_ptr - from_space);
-      size_t new_size = semispace_size;
-      while (new_size < used + needed)
-        new_size *= 2;
-
-      // Even if used + needed fits, we still need to grow.
-      if (new_size == semispace_size)
-        new_size *= 2;
+      // The header word is the low half of the first 16 bytes.
+      const __m128i clear_bits = _mm_set_epi64x(-1, 0);
+      constexpr size_t step = sizeof(__m128i);
 
-      Logging::cout() << "SemiSpace grow: " << semispace_size << " -> "
-                      << new_size << Logging::endl;
+      for (size_t off = 0; off < len;)
+      {
+        Object* obj = Object::object_start(src + off);
+        size_t end =
+          off + snmalloc::bits::align_up(obj->size(), Object::ALIGNMENT);
+
+        __m128i first = _mm_loadu_si128((const __m128i*)(src + off));
+        _mm_stream_si128(
+          (__m128i*)(dst + off), _mm_and_si128(first, clear_bits));
+        for (off += step; off < end; off += step)
+          _mm_stream_si128(
+            (__m128i*)(dst + off),
+            _mm_loadu_si128((const __m128i*)(src + off)));
+      }
+      _mm_sfence();
+    }
+#endif
 
-      // Remember old from-space address before freeing it.
-      std::byte* old_from = from_space;
+    /**
+     * Number of bytes the object `obj` occupies in a semi-space, including
+     * its header and alignment padding.
+     **/
+    static size_t space_size(Object* obj)
+    {
+      if (is_filler(obj))
+        return obj->get_header().bits;
+      return snmalloc::bits::align_up(obj->size(), Object::ALIGNMENT);
+    }
 
-      // Grow from-space: allocate new, copy live data, free old.
-      std::byte* new_from = (std::byte*)heap::alloc(new_size);
-      std::memcpy(new_from, from_space, used);
-      heap::dealloc(from_space, semispace_size);
+    static bool is_filler(Object* obj)
+    {
+      return obj->get_descriptor() == filler_desc();
+    }
 
-      // Grow to-space: just reallocate (no live data in to-space).
-      heap::dealloc(to_space, semispace_size);
-      std::byte* new_to = (std::byte*)heap::alloc(new_size);
+    /**
+     * Cover the `gap` bytes at `p` with a filler object. `gap` must be able
+     * to hold an object header.
+     **/
+    static void write_filler(std::byte* p, size_t gap)
+    {
+      assert(gap >= sizeof(Object::Header));
+      assert((gap & (Object::ALIGNMENT - 1)) == 0);
+      Object* f = Object::object_start(p);
+      // Not register_object(): that would consume a systematic-testing id.
+      f->get_header().descriptor.store(filler_desc(), std::memory_order_relaxed);
+      f->get_header().bits = gap;
+    }
 
-      ptrdiff_t delta = new_from - old_from;
+    /**
+     * State shared by the threads of a parallel copy.
+     **/
+    struct ParallelCopy
+    {
+      RegionSemiSpace* reg;
+      std::byte* from_start;
+      size_t from_size;
+      /// Next unclaimed byte of to-space.
+      std::atomic<std::byte*> cursor;
+      std::byte* to_end;
+      size_t workers;
+
+      /// Grey objects offered by busy threads to idle ones.
+      FlagWord pool_lock{};
+      ObjectStack pool{};
+      std::atomic<size_t> pool_size{0};
+
+      /// Threads that found no work. The copy is over once it equals
+      /// `workers`.
+      std::atomic<size_t> idle{0};
+    };
 
-      from_space = new_from;
-      to_space = new_to;
-      alloc_ptr = new_from + used;
-      alloc_end = new_from + new_size;
-      semispace_size = new_size;
+    /**
+     * Per-thread state of a parallel copy.
+     **/
+    struct CopyWorker
+    {
+      /// Thread-local allocation buffer in to-space.
+      std::byte* tlab_ptr = nullptr;
+      std::byte* tlab_end = nullptr;
+
+      /// Copies and marked large objects whose fields are not scanned yet.
+      ObjectStack grey{};
+      /// Fields to enter into the remembered set once the threads are done.
+      ObjectStack remembered{};
+      /// Scratch stack for tracing objects that have no `relocate`.
+      ObjectStack fields{};
+      /// Scratch list of the moved fields of such an object.
+      MovedFields moved{};
+      NonTrivialStack non_trivial{};
+      size_t live_bytes = 0;
+      size_t live_objects = 0;
+      size_t large_objects = 0;
+      size_t large_bytes = 0;
+    };
 
-      // If the address changed, adjust every pointer that referred to
-      // the old from-space.
-      if (delta != 0)
-      {
-        // Set thread-local state for the adjust_for_grow callback.
-        grow_old_from_ = old_from;
-        grow_old_used_ = used;
-        grow_delta_ = delta;
+    /// Parallel copy this thread takes part in, for the
+    /// copy_and_forward_parallel callback.
+    static inline thread_local ParallelCopy* gc_parallel_ = nullptr;
+    static inline thread_local CopyWorker* gc_worker_ = nullptr;
 
-        // Walk all objects in the new from-space.
-        std::byte* p = new_from;
-        while (p < alloc_ptr)
-        {
-          Object* obj = Object::object_start(p);
-          size_t obj_size =
-            snmalloc::bits::align_up(obj->size(), Object::ALIGNMENT);
+    // How often a busy thread checks whether it should share work, and how
+    // many grey objects move between a thread and the pool at a time.
+    static constexpr size_t SHARE_INTERVAL = 64;
+    static constexpr size_t SHARE_BATCH = 32;
 
-          // Fix pointer fields via relocate if available.
-          auto* desc = obj->get_descriptor();
-          if (desc->relocate != nullptr)
-          {
-            desc->relocate(obj, adjust_for_grow);
-          }
-          else
+    /**
+     * Phases 1-2 of gc() on `threads` threads (the calling thread included).
+     * The threads scan and copy until none has work left; as in
+     * sequential_copy(), each object's fields are forwarded while it is
+     * scanned.
+     **/
+    static void
+    parallel_copy(Object* o, RegionSemiSpace* reg, CopyState& cs, size_t threads)
+    {
+      // gc() has already given to-space head room for buffer tails and
+      // direct copies.
+      ParallelCopy pc{
+        reg,
+        reg->from_space,
+        reg->semispace_size,
+        {cs.free_ptr},
+        cs.to_end,
+        threads};
+      auto workers = std::make_unique<CopyWorker[]>(threads);
+
+      // Phase 1: scanning the pinned root and marking the objects pinned
+      // by pin() seed the shared pool.
+      GCPhases::Scope phase(GCPhases::Roots);
+      {
+        CopyWorker& w = workers[0];
+        gc_parallel_ = &pc;
+        gc_worker_ = &w;
+        scan_object_parallel(o, pc, w);
+        reg->pinned.forall([&w](Object* p) {
+          if (LargeObjectSpace::mark_atomic(p))
           {
-            // Fallback: scan body word-by-word (best-effort).
-            size_t body_size = obj->size() - sizeof(Object::Header);
-            auto* body = (Object**)obj;
-            size_t num_words = body_size / sizeof(Object*);
-
-            for (size_t i = 0; i < num_words; i++)
-            {
-              auto* word = (std::byte*)body[i];
-              if (word != nullptr && word >= old_from &&
-                  word < old_from + used)
-              {
-                body[i] = (Object*)(word + delta);
-              }
-            }
+            w.grey.push(p);
+            w.large_objects++;
+            w.large_bytes += p->size();
+            HeapProfile::count(p);
           }
+        });
 
-          p += obj_size;
+        size_t n = 0;
+        while (!w.grey.empty())
+        {
+          pc.pool.push(w.grey.pop());
+          n++;
         }
+        pc.pool_size.store(n, std::memory_order_release);
+      }
 
-        // Fix pointer fields in large objects that reference from-space.
-        Object* lo = large_objects;
-        while (lo != nullptr)
-        {
-          auto* desc = lo->get_descriptor();
-          if (desc->relocate != nullptr)
-          {
-            desc->relocate(lo, adjust_for_grow);
-          }
-          else
-          {
-            size_t body_size = lo->size() - sizeof(Object::Header);
-            auto* body = (Object**)lo;
-            size_t num_words = body_size / sizeof(Object*);
+      // Phase 2 on every thread.
+      phase.next(GCPhases::Copy);
+      std::list<PlatformThread> helpers;
+      for (size_t i = 1; i < threads; i++)
+        helpers.emplace_back(
+          [&pc, &workers, i]() { copy_thread(pc, workers[i]); });
+      copy_thread(pc, workers[0]);
+      for (auto& t : helpers)
+        t.join();
+
+      // Fold the per-thread results into `cs`. The remembered set is not
+      // thread-safe, so it is only updated here.
+      cs.free_ptr = pc.cursor.load(std::memory_order_relaxed);
+      for (size_t i = 0; i < threads; i++)
+      {
+        CopyWorker& w = workers[i];
+        cs.live_bytes += w.live_bytes;
+        cs.live_objects += w.live_objects;
+        cs.large_objects += w.large_objects;
+        cs.large_bytes += w.large_bytes;
 
-            for (size_t i = 0; i < num_words; i++)
-            {
-              auto* word = (std::byte*)body[i];
-              if (word != nullptr && word >= old_from &&
-                  word < old_from + used)
-              {
-                body[i] = (Object*)(word + delta);
-              }
-            }
-          }
-          lo = lo->get_next();
-        }
+        Object* batch[64];
+        while (size_t n = w.non_trivial.pop_n(batch, 64))
+          cs.non_trivial.push_range(batch, n);
 
-        // Fix pointer fields in the pinned root that reference from-space.
-        if (pinned_iso_ != nullptr)
+        while (!w.remembered.empty())
         {
-          auto* desc = pinned_iso_->get_descriptor();
-          if (desc->relocate != nullptr)
-          {
-            desc->relocate(pinned_iso_, adjust_for_grow);
-          }
+          Object* field = w.remembered.pop();
+          if (field->get_class() == Object::SCC_PTR)
+            reg->RememberedSet::mark(field->immutable());
           else
-          {
-            size_t body_size =
-              pinned_iso_->size() - sizeof(Object::Header);
-            auto* body = (Object**)pinned_iso_;
-            size_t num_words = body_size / sizeof(Object*);
-
-            for (size_t i = 0; i < num_words; i++)
-            {
-              auto* word = (std::byte*)body[i];
-              if (word != nullptr && word >= old_from &&
-                  word < old_from + used)
-              {
-                body[i] = (Object*)(word + delta);
-              }
-            }
-          }
+            reg->RememberedSet::mark(field);
         }
-
-        // The pinned root never moves, so no entry-point delta is needed.
       }
     }
 
     /**
-     * Grow-time forwarding callback passed to Descriptor::relocate.
-     * Adjusts pointers that fell in the old from-space by the address
-     * delta; all other pointers are returned unchanged.
+     * Body of one thread of parallel_copy().
      **/
-    static Object* adjust_for_grow(Object* o)
+    static void copy_thread(ParallelCopy& pc, CopyWorker& w)
     {
-      auto addr = (std::byte*)o;
-      if (addr >= grow_old_from_ && addr < grow_old_from_ + grow_old_used_)
-        return (Object*)(addr + grow_delta_);
-      return o;
+      gc_parallel_ = &pc;
+      gc_worker_ = &w;
+
+      // Scan grey objects until every thread runs dry.
+      do
+      {
+        size_t scanned = 0;
+        while (!w.grey.empty())
+        {
+          scan_object_parallel(w.grey.pop(), pc, w);
+
+          if (
+            (++scanned % SHARE_INTERVAL) == 0 &&
+            pc.idle.load(std::memory_order_relaxed) != 0 &&
+            pc.pool_size.load(std::memory_order_relaxed) == 0)
+            share_work(pc, w);
+        }
+      } while (acquire_work(pc, w));
+
+      retire_tlab(w);
+      gc_parallel_ = nullptr;
+      gc_worker_ = nullptr;
     }
 
     /**
-     * Check if an object is in a given memory space.
+     * Parallel counterpart of scan_object(). Only the thread that copied
+     * (or marked) `obj` scans it, so its fields can be written in place.
      **/
-    static bool is_in_space(Object* o, std::byte* space_start, size_t space_sz)
+    static void
+    scan_object_parallel(Object* obj, ParallelCopy& pc, CopyWorker& w)
     {
-      auto addr = (std::byte*)o->real_start();
-      return addr >= space_start && addr < (space_start + space_sz);
+      if (obj->relocate_mapped(copy_and_forward_parallel))
+        return;
+
+      auto* descriptor = obj->get_descriptor();
+      if (descriptor->relocate != nullptr)
+      {
+        descriptor->relocate(obj, copy_and_forward_parallel);
+        return;
+      }
+
+      obj->trace(w.fields);
+      if (!get_word_scan())
+      {
+        patch_moved(obj, w.fields, w.moved, copy_and_forward_parallel);
+        return;
+      }
+      while (!w.fields.empty())
+        copy_and_forward_parallel(w.fields.pop());
+      patch_fields(obj, pc.from_start, pc.from_size);
     }
 
     /**
-     * Check if an object is a large object (allocated outside semi-spaces).
+     * Forwarding callback passed to Descriptor::relocate during a parallel
+     * copy. Other threads may be looking at the same object, so its header
+     * word is only accessed atomically.
      **/
-    static bool is_large_object(Object* o, RegionSemiSpace* reg)
+    static Object* copy_and_forward_parallel(Object* field)
     {
-      return !is_in_space(o, reg->from_space, reg->semispace_size) &&
-        !is_in_space(o, reg->to_space, reg->semispace_size);
+      ParallelCopy& pc = *gc_parallel_;
+      CopyWorker& w = *gc_worker_;
+
+      if (is_in_space(field, pc.from_start, pc.from_size))
+        return forward_parallel(field, pc, w);
+
+      size_t bits = field->get_header().rc.load(std::memory_order_acquire);
+      switch ((Object::RegionMD)(bits & Object::MASK))
+      {
+        case Object::UNMARKED:
+        {
+          // Large object: whoever sets the mark in its chunk scans it.
+          if (
+            is_large_object(field, pc.reg) &&
+            LargeObjectSpace::mark_atomic(field))
+          {
+            w.grey.push(field);
+            w.large_objects++;
+            w.large_bytes += field->size();
+            HeapProfile::count(field);
+          }
+          break;
+        }
+
+        case Object::SCC_PTR:
+        case Object::RC:
+        case Object::SHARED:
+          w.remembered.push(field);
+          break;
+
+        default:
+          break;
+      }
+      return field;
     }
 
     /**
-     * Copy an object from from-space to to-space.
-     * Installs a forwarding pointer in the old object using the MARKED tag.
-     * Returns a pointer to the new object in to-space.
-     * Returns nullptr if there's not enough space.
+     * Copy the from-space object `old_obj` into `w`'s buffer unless another
+     * thread already did; returns its to-space address.
+     *
+     * The header is first claimed by a CAS from UNMARKED to MARKED with no
+     * address. The winner copies, then publishes the forwarding pointer;
+     * everyone else waits for it to appear.
      **/
-    static Object* copy_object(Object* old_obj, std::byte*& free_ptr,
-                               std::byte* to_end)
+    static Object*
+    forward_parallel(Object* old_obj, ParallelCopy& pc, CopyWorker& w)
     {
-      size_t obj_size =
-        snmalloc::bits::align_up(old_obj->size(), Object::ALIGNMENT);
+      auto& header = old_obj->get_header().rc;
+      size_t bits = header.load(std::memory_order_acquire);
+      while (true)
+      {
+        auto c = (Object::RegionMD)(bits & Object::MASK);
+        if (c == Object::MARKED)
+        {
+          auto target = (Object*)(bits & ~Object::MASK);
+          if (target != nullptr)
+            return target;
+          Aal::pause();
+          bits = header.load(std::memory_order_acquire);
+          continue;
+        }
 
-      if (free_ptr + obj_size > to_end)
-        return nullptr;
+        if (c != Object::UNMARKED)
+          return old_obj;
+
+        if (header.compare_exchange_weak(
+              bits,
+              (size_t)Object::MARKED,
+              std::memory_order_acq_rel,
+              std::memory_order_acquire))
+          break;
+      }
 
-      // Copy the entire object (header + body) to to-space.
-      void* src = old_obj->real_start();
-      void* dst = free_ptr;
-      std::memcpy(dst, src, obj_size);
+      size_t obj_size =
+        snmalloc::bits::align_up(old_obj->size(), Object::ALIGNMENT);
+      std::byte* dst = alloc_to_space(pc, w, obj_size);
 
+      // Everything but the header word, which is being written concurrently.
+      std::memcpy(
+        dst + sizeof(size_t),
+        old_obj->real_start() + sizeof(size_t),
+        obj_size - sizeof(size_t));
       Object* new_obj = Object::object_start(dst);
-      // Ensure the new object is UNMARKED (mutable) — clear any tags.
       new_obj->init_next(nullptr);
 
-      free_ptr += obj_size;
-
-      // Install forwarding pointer in old object.
-      // We use the MARKED bit plus the new address in the upper bits.
-      // This works because the header `bits` field stores tag in low bits
-      // and payload in upper bits — same pattern as ISO/set_region.
-      old_obj->set_forwarding_pointer(new_obj);
+      header.store(
+        (size_t)new_obj | (size_t)Object::MARKED, std::memory_order_release);
 
+      w.live_bytes += new_obj->size();
+      w.live_objects++;
+      HeapProfile::count(new_obj);
+      if (!new_obj->is_trivial())
+        w.non_trivial.push(new_obj);
+      w.grey.push(new_obj);
       return new_obj;
     }
 
     /**
-     * Update all object pointers in to-space to point to the new locations.
+     * Reserve `size` bytes of to-space for thread `w`.
      **/
-    static void update_all_pointers(std::byte* to_start, std::byte* to_end,
-                                    RegionSemiSpace* reg)
+    static std::byte* alloc_to_space(ParallelCopy& pc, CopyWorker& w, size_t size)
     {
-      std::byte* p = to_start;
-      while (p < to_end)
+      if (size > DIRECT_COPY_THRESHOLD)
+        return claim_to_space(pc, size);
+
+      // A leftover smaller than a header could not be covered by a filler.
+      size_t remaining = static_cast<size_t>(w.tlab_end - w.tlab_ptr);
+      if (
+        size > remaining ||
+        (size < remaining && remaining - size < sizeof(Object::Header)))
       {
-        Object* obj = Object::object_start(p);
-        size_t obj_size =
-          snmalloc::bits::align_up(obj->size(), Object::ALIGNMENT);
-        update_object_pointers(obj, reg);
-        p += obj_size;
+        retire_tlab(w);
+        w.tlab_ptr = claim_to_space(pc, TLAB_SIZE);
+        w.tlab_end = w.tlab_ptr + TLAB_SIZE;
       }
+
+      std::byte* p = w.tlab_ptr;
+      w.tlab_ptr += size;
+      return p;
+    }
+
+    static std::byte* claim_to_space(ParallelCopy& pc, size_t size)
+    {
+      std::byte* p = pc.cursor.fetch_add(size, std::memory_order_relaxed);
+      // parallel_copy() reserved enough head room for this.
+      if (p + size > pc.to_end)
+        abort();
+      return p;
     }
 
     /**
-     * Forwarding callback passed to Descriptor::relocate.
-     * Returns the new address if the object was moved (forwarded),
-     * otherwise returns the original address unchanged.
-     *
-     * Only from-space objects can be forwarded.  Large objects that were
-     * merely marked as live (also using the MARKED tag) are NOT in
-     * from-space and must be left untouched.
+     * Cover the unused tail of `w`'s buffer with a filler.
      **/
-    static Object* forward_if_moved(Object* o)
+    static void retire_tlab(CopyWorker& w)
     {
-      if (is_in_space(o, gc_from_space_, gc_from_size_) && is_forwarded(o))
-        return get_forwarding_target(o);
-      return o;
+      if (w.tlab_ptr != w.tlab_end)
+        write_filler(w.tlab_ptr, static_cast<size_t>(w.tlab_end - w.tlab_ptr));
+      w.tlab_ptr = w.tlab_end = nullptr;
+    }
+
+    static void share_work(ParallelCopy& pc, CopyWorker& w)
+    {
+      FlagLock lock(pc.pool_lock);
+      size_t n = 0;
+      while (n < SHARE_BATCH && !w.grey.empty())
+      {
+        pc.pool.push(w.grey.pop());
+        n++;
+      }
+      pc.pool_size.fetch_add(n, std::memory_order_release);
+    }
+
+    static bool take_work(ParallelCopy& pc, CopyWorker& w)
+    {
+      if (pc.pool_size.load(std::memory_order_acquire) == 0)
+        return false;
+
+      FlagLock lock(pc.pool_lock);
+      size_t n = 0;
+      while (n < SHARE_BATCH && !pc.pool.empty())
+      {
+        w.grey.push(pc.pool.pop());
+        n++;
+      }
+      pc.pool_size.fetch_sub(n, std::memory_order_release);
+      return n != 0;
     }
 
     /**
-     * Update all pointer fields in a single object to forward to new
-     * addresses.
-     *
-     * If the object's Descriptor provides a `relocate` function, we use it
-     * for exact pointer updates — the object itself knows which of its
-     * fields are pointers and updates them directly via the forwarding
-     * callback. This is 100% correct with no risk of false matches.
-     *
-     * If `relocate` is not available, falls back to a best-effort body
-     * scan that checks each word against from-space bounds and forwarding
-     * status. This fallback can theoretically produce false positives if
-     * a non-pointer integer field coincidentally matches a forwarded
-     * from-space address.
+     * Called by a thread that ran out of grey objects. Returns true once it
+     * has more, or false when every thread is out of work, which ends the
+     * copy.
      **/
-    static void update_object_pointers(Object* obj, RegionSemiSpace* reg)
+    static bool acquire_work(ParallelCopy& pc, CopyWorker& w)
     {
-      auto* descriptor = obj->get_descriptor();
-      if (descriptor->relocate != nullptr)
+      if (take_work(pc, w))
+        return true;
+
+      pc.idle.fetch_add(1, std::memory_order_acq_rel);
+      while (true)
       {
-        // Exact pointer update via relocate callback.
-        descriptor->relocate(obj, forward_if_moved);
-        return;
+        if (pc.pool_size.load(std::memory_order_acquire) != 0)
+        {
+          pc.idle.fetch_sub(1, std::memory_order_acq_rel);
+          if (take_work(pc, w))
+            return true;
+          pc.idle.fetch_add(1, std::memory_order_acq_rel);
+        }
+
+        if (pc.idle.load(std::memory_order_acquire) == pc.workers)
+          return false;
+
+        Aal::pause();
       }
+    }
 
-      // Fallback: scan body word-by-word (best-effort).
+    /**
+     * Point the fields of `obj` that refer to forwarded objects of the
+     * from-space [`from`, `from` + `size`) at the copies, with
+     * set_word_scan() on. For objects without a `relocate` function, this is
+     * a best-effort scan of the body that checks each word against the
+     * from-space bounds and forwarding status; it can theoretically produce
+     * false positives if a non-pointer integer field coincidentally matches
+     * a forwarded from-space address.
+     **/
+    static void patch_fields(Object* obj, std::byte* from, size_t size)
+    {
       size_t body_size = obj->size() - sizeof(Object::Header);
       auto* body = (Object**)obj;
       size_t num_words = body_size / sizeof(Object*);
@@ -890,8 +2809,7 @@ namespace verona::rt
       for (size_t i = 0; i < num_words; i++)
       {
         Object* word = body[i];
-        if (word != nullptr &&
-            is_in_space(word, reg->from_space, reg->semispace_size) &&
+        if (word != nullptr && is_in_space(word, from, size) &&
             is_forwarded(word))
         {
           body[i] = get_forwarding_target(word);
@@ -899,6 +2817,48 @@ namespace verona::rt
       }
     }
 
+    /**
+     * Forward, with `forward`, the references that the trace of `obj` left
+     * in `fields`, and point the words of its body that hold one that moved
+     * at its copy. This is the relocation derived from the trace: only a
+     * word equal to a reference the object holds can be rewritten, and the
+     * body is not looked at when nothing moved. It is also used for copies
+     * to the heap, where large objects move too, so bounds cannot tell
+     * which words are references.
+     **/
+    template<typename Forward>
+    static void patch_moved(
+      Object* obj, ObjectStack& fields, MovedFields& moved, Forward forward)
+    {
+      moved.clear();
+      while (!fields.empty())
+      {
+        Object* field = fields.pop();
+        Object* target = forward(field);
+        if (target != field)
+          moved.emplace_back(field, target);
+      }
+      if (moved.empty())
+        return;
+
+      std::sort(moved.begin(), moved.end());
+      size_t body_size = obj->size() - sizeof(Object::Header);
+      auto* body = (Object**)obj;
+      size_t num_words = body_size / sizeof(Object*);
+
+      for (size_t i = 0; i < num_words; i++)
+      {
+        Object* word = body[i];
+        auto it = std::lower_bound(
+          moved.begin(),
+          moved.end(),
+          word,
+          [](const auto& m, Object* w) { return m.first < w; });
+        if ((it != moved.end()) && (it->first == word))
+          body[i] = it->second;
+      }
+    }
+
     /**
      * Check if an object has been forwarded (has a forwarding pointer).
      * A forwarded object has MARKED tag in its header bits.
@@ -920,6 +2880,76 @@ namespace verona::rt
     /**
      * Release and deallocate all objects within the region.
      **/
+    /**
+     * Move every object reachable from the pinned root `o` into a heap
+     * allocation of its own, for Freeze::apply(), and free the rest of the
+     * region but its metadata. This is a collection that copies out to the
+     * heap, so the dead objects are finalised and destroyed as by gc(),
+     * except that nested regions they hold are added to `collect` for the
+     * caller to release. `o` itself stays where it is.
+     **/
+    void evacuate(Object* o, ObjectStack& collect)
+    {
+      assert(o->debug_is_iso());
+      assert(o == pinned_iso_);
+      // A cursor does not outlive the region being open.
+      assert(cursor == nullptr);
+      // Pinned objects would move to the heap.
+      if (!pinned.empty())
+        abort();
+      finish_copy();
+
+      CopyState cs{nullptr, nullptr};
+      cs.to_heap = true;
+      gc_region_ = this;
+      gc_copy_state_ = &cs;
+      large.begin_collection();
+
+      scan_object(o, this, cs);
+      while (!cs.heap_pending.empty())
+        scan_object(cs.heap_pending.pop(), this, cs);
+
+      gc_region_ = nullptr;
+      gc_copy_state_ = nullptr;
+
+      // The copies own their destructors now.
+      while (!cs.non_trivial.empty())
+        cs.non_trivial.pop();
+
+      auto finalise_dead = [&collect](NonTrivialStack& table) {
+        table.forall([&collect](Object* obj) {
+          if (!is_forwarded(obj))
+            obj->finalise(nullptr, collect);
+        });
+      };
+      finalise_dead(from_non_trivial);
+      for (AdoptedSpace* a = adopted; a != nullptr; a = a->next)
+        finalise_dead(a->non_trivial);
+      large.finalise_dead();
+
+      auto destruct_dead = [](NonTrivialStack& table) {
+        while (!table.empty())
+        {
+          Object* obj = table.pop();
+          if (!is_forwarded(obj))
+            obj->destructor();
+        }
+      };
+      destruct_dead(from_non_trivial);
+      for (AdoptedSpace* a = adopted; a != nullptr; a = a->next)
+        destruct_dead(a->non_trivial);
+      large.end_collection(0, 0);
+
+      large.release();
+      free_space(from_space, semispace_size);
+      free_space(to_space, to_space_size);
+      free_adopted();
+      free_sites();
+      from_space = nullptr;
+      to_space = nullptr;
+      pinned_iso_ = nullptr;
+    }
+
     void release_internal(Object* o, ObjectStack& collect)
     {
       assert(o->debug_is_iso());
@@ -927,29 +2957,22 @@ namespace verona::rt
       Logging::cout() << "Region release: semispace region: " << o
                       << Logging::endl;
 
-      // Run finalisers on all non-trivial objects in from-space.
+      // The tables of a pending copy hold the copies; finishing it leaves
+      // them where a release looks.
+      finish_copy();
+
+      // Run finalisers on all non-trivial objects in from-space and the
+      // adopted spaces.
       {
-        std::byte* p = from_space;
-        while (p < alloc_ptr)
-        {
-          Object* obj = Object::object_start(p);
-          size_t obj_size =
-            snmalloc::bits::align_up(obj->size(), Object::ALIGNMENT);
-          if (!obj->is_trivial())
-          {
-            obj->finalise(o, collect);
-          }
-          p += obj_size;
-        }
+        auto finalise = [o, &collect](Object* obj) {
+          obj->finalise(o, collect);
+        };
+        from_non_trivial.forall(finalise);
+        for (AdoptedSpace* a = adopted; a != nullptr; a = a->next)
+          a->non_trivial.forall(finalise);
 
         // Finalisers for large objects.
-        Object* lo = large_objects;
-        while (lo != nullptr)
-        {
-          if (!lo->is_trivial())
-            lo->finalise(o, collect);
-          lo = lo->get_next();
-        }
+        large.finalise_all(o, collect);
 
         // Finaliser for the pinned root.
         if (pinned_iso_ != nullptr && !pinned_iso_->is_trivial())
@@ -958,28 +2981,18 @@ namespace verona::rt
         }
       }
 
-      // Run destructors on all non-trivial objects.
+      // Run destructors on all non-trivial objects. Popping the side table
+      // also releases its blocks.
       {
-        std::byte* p = from_space;
-        while (p < alloc_ptr)
+        while (!from_non_trivial.empty())
+          from_non_trivial.pop()->destructor();
+        for (AdoptedSpace* a = adopted; a != nullptr; a = a->next)
         {
-          Object* obj = Object::object_start(p);
-          size_t obj_size =
-            snmalloc::bits::align_up(obj->size(), Object::ALIGNMENT);
-          if (!obj->is_trivial())
-          {
-            obj->destructor();
-          }
-          p += obj_size;
+          while (!a->non_trivial.empty())
+            a->non_trivial.pop()->destructor();
         }
 
-        Object* lo = large_objects;
-        while (lo != nullptr)
-        {
-          if (!lo->is_trivial())
-            lo->destructor();
-          lo = lo->get_next();
-        }
+        large.destruct_all();
 
         // Destructor for the pinned root.
         if (pinned_iso_ != nullptr && !pinned_iso_->is_trivial())
@@ -988,16 +3001,10 @@ namespace verona::rt
         }
       }
 
-      // Deallocate large objects.
-      {
-        Object* lo = large_objects;
-        while (lo != nullptr)
-        {
-          Object* next = lo->get_next();
-          lo->dealloc();
-          lo = next;
-        }
-      }
+      // Deallocate large objects, which drops their pins.
+      large.release();
+      pinned.dealloc();
+      pinned = PinStack{};
 
       // Deallocate the pinned root.
       if (pinned_iso_ != nullptr)
@@ -1006,9 +3013,11 @@ namespace verona::rt
         pinned_iso_ = nullptr;
       }
 
-      // Deallocate both semi-spaces.
-      heap::dealloc(from_space, semispace_size);
-      heap::dealloc(to_space, semispace_size);
+      // Deallocate both semi-spaces and the adopted ones.
+      free_space(from_space, semispace_size);
+      free_space(to_space, to_space_size);
+      free_adopted();
+      free_sites();
 
       // Sweep the RememberedSet.
       RememberedSet::sweep();
@@ -1020,8 +3029,8 @@ namespace verona::rt
   public:
     /**
      * Iterator over all objects in the semi-space region.
-     * Yields the pinned root first, then from-space objects, then large
-     * objects.
+     * Yields the pinned root first, then from-space objects, then those of
+     * the adopted spaces, then large objects.
      **/
     template<IteratorType type = AllObjects>
     class iterator
@@ -1031,8 +3040,9 @@ namespace verona::rt
       static_assert(
         type == Trivial || type == NonTrivial || type == AllObjects);
 
-      /// Iteration phase: pinned root -> from-space -> large objects.
-      enum class Phase { PinnedRoot, FromSpace, LargeObjects, Done };
+      /// Iteration phase: pinned root -> from-space -> adopted spaces ->
+      /// large objects.
+      enum class Phase { PinnedRoot, FromSpace, Adopted, LargeObjects, Done };
 
       iterator(RegionSemiSpace* r)
       : reg(r), arena_ptr(r->from_space), ptr(nullptr),
@@ -1068,22 +3078,18 @@ namespace verona::rt
             break;
 
           case Phase::FromSpace:
+          case Phase::Adopted:
           {
-            // Move to next object in from-space.
-            size_t obj_size =
-              snmalloc::bits::align_up(ptr->size(), Object::ALIGNMENT);
-            arena_ptr = ptr->real_start() + obj_size;
+            // Move to next object in the space.
+            arena_ptr = ptr->real_start() + space_size(ptr);
             ptr = nullptr;
             advance_from_space();
             break;
           }
 
           case Phase::LargeObjects:
-            if (ptr != nullptr)
-            {
-              ptr = ptr->get_next();
-              skip_to_valid_large();
-            }
+            ptr = reg->large.next(large_cursor);
+            skip_to_valid_large();
             break;
 
           case Phase::Done:
@@ -1107,6 +3113,8 @@ namespace verona::rt
       std::byte* arena_ptr;
       Object* ptr;
       Phase phase;
+      AdoptedSpace* space = nullptr;
+      LargeObjectSpace::Cursor large_cursor{};
 
       static bool matches_filter(Object* obj)
       {
@@ -1120,24 +3128,33 @@ namespace verona::rt
 
       void advance_from_space()
       {
-        // Try from-space.
-        while (arena_ptr < reg->alloc_ptr)
+        // Try from-space, then each adopted space.
+        while (true)
         {
-          Object* obj = Object::object_start(arena_ptr);
-          size_t obj_size =
-            snmalloc::bits::align_up(obj->size(), Object::ALIGNMENT);
-
-          if (matches_filter(obj))
+          std::byte* end =
+            (phase == Phase::FromSpace) ? reg->alloc_ptr : space->end;
+          while (arena_ptr < end)
           {
-            ptr = obj;
-            return;
+            Object* obj = Object::object_start(arena_ptr);
+
+            if (!is_filler(obj) && matches_filter(obj))
+            {
+              ptr = obj;
+              return;
+            }
+            arena_ptr += space_size(obj);
           }
-          arena_ptr += obj_size;
+
+          space = (phase == Phase::FromSpace) ? reg->adopted : space->next;
+          if (space == nullptr)
+            break;
+          phase = Phase::Adopted;
+          arena_ptr = space->start;
         }
 
         // Then try large objects.
         phase = Phase::LargeObjects;
-        ptr = reg->large_objects;
+        ptr = reg->large.first(large_cursor);
         skip_to_valid_large();
       }
 
@@ -1147,7 +3164,7 @@ namespace verona::rt
         {
           if (matches_filter(ptr))
             return;
-          ptr = ptr->get_next();
+          ptr = reg->large.next(large_cursor);
         }
         // Exhausted.
         phase = Phase::Done;
@@ -1157,6 +3174,7 @@ namespace verona::rt
     template<IteratorType type = AllObjects>
     inline iterator<type> begin()
     {
+      finish_copy();
       return {this};
     }
 
@@ -1166,6 +3184,75 @@ namespace verona::rt
       return {this, nullptr};
     }
 
+    /**
+     * Call `f` on each object of the region with descriptor `desc`. Only
+     * the places such objects can be are visited: for a non-trivial type,
+     * the side tables of non-trivial objects rather than the spaces, and
+     * for a trivial one, the spaces in a loop that compares descriptors
+     * and steps over matches by their known size. `f` must not allocate in
+     * the region.
+     **/
+    template<typename F>
+    void for_each_of(const Descriptor* desc, F f)
+    {
+      finish_copy();
+      if ((pinned_iso_ != nullptr) && (pinned_iso_->get_descriptor() == desc))
+        f(pinned_iso_);
+
+      if (!Object::is_trivial(desc))
+      {
+        auto visit = [desc, &f](Object* o) {
+          if (o->get_descriptor() == desc)
+            f(o);
+        };
+        from_non_trivial.forall(visit);
+        for (AdoptedSpace* a = adopted; a != nullptr; a = a->next)
+          a->non_trivial.forall(visit);
+      }
+      else
+      {
+        for_each_of_in(from_space, alloc_ptr, desc, f);
+        for (AdoptedSpace* a = adopted; a != nullptr; a = a->next)
+          for_each_of_in(a->start, a->end, desc, f);
+      }
+
+      LargeObjectSpace::Cursor cursor{};
+      for (Object* o = large.first(cursor); o != nullptr;
+           o = large.next(cursor))
+      {
+        if (o->get_descriptor() == desc)
+          f(o);
+      }
+    }
+
+  private:
+    /**
+     * Call `f` on each object with descriptor `desc` in [`begin`, `end`)
+     * of a space.
+     **/
+    template<typename F>
+    static void for_each_of_in(
+      std::byte* begin, std::byte* end, const Descriptor* desc, F& f)
+    {
+      // Objects of a type without a trailing array all have the same size.
+      size_t step = (desc->tail == 0) ?
+        snmalloc::bits::align_up(desc->size, Object::ALIGNMENT) :
+        0;
+      while (begin < end)
+      {
+        Object* o = Object::object_start(begin);
+        if (o->get_descriptor() != desc)
+        {
+          begin += space_size(o);
+          continue;
+        }
+        begin += (step != 0) ? step : space_size(o);
+        f(o);
+      }
+    }
+
+  public:
+
   private:
     bool debug_is_in_region(Object* o)
     {
@@ -3,9 +3,22 @@
 #pragma once
 
 #include "../object/object.h"
+#include "../pal/threading.h"
+#include "alloc_stats.h"
+#include "background_collector.h"
+#include "gc_phases.h"
+#include "heap_profile.h"
+#include "mark_bitmap.h"
+#include "object_pages.h"
 #include "region_arena.h"
 #include "region_base.h"
 
+#include <algorithm>
+#include <atomic>
+#include <list>
+#include <memory>
+#include <vector>
+
 namespace verona::rt
 {
   using namespace snmalloc;
@@ -44,12 +57,84 @@ namespace verona::rt
    * Note that we use the "last" pointer to ensure constant-time merging of two
    * rings. We avoid a "last" pointer for the primary ring, since the iso
    * object is the last object, and we always have a pointer to it.
+   *
+   * By default a collection marks live objects by setting MARKED in their
+   * headers, and the sweep clears it again, which writes to every live
+   * object twice. Optionally (see set_mark_bitmap()), marks are kept in a
+   * MarkBitmap instead, and the sweep only reads the headers, so the pages
+   * of live objects are left clean.
+   *
+   * Optionally (see set_lazy_sweep()), a collection only sweeps the
+   * non-trivial ring, whose finalisers must all run before anything is
+   * deallocated. The dead objects of the trivial ring are freed
+   * afterwards, a bounded number at each allocation and each close of the
+   * region, from a cursor into the ring. New objects are inserted at the
+   * front of the ring, ahead of the cursor, so the sweep never sees them.
+   * Until it finishes, the marks stay in a MarkBitmap, so objects behind
+   * the cursor look as usual to the mutator. Anything that needs the
+   * whole ring in order (a collection, merge, swap_root, freeze, release,
+   * iteration) finishes the sweep first.
+   *
+   * Optionally (see set_sweep_threads()), the eager sweep of a large
+   * region frees the dead objects of the trivial ring on several threads.
+   * The mark samples live trivial objects as it goes, and the ring is cut
+   * into segments at them: as they survive the sweep, each segment is
+   * relinked by one thread without touching the others. The non-trivial
+   * ring is still swept by the collecting thread, so every finaliser runs
+   * before any object is freed.
+   *
+   * Optionally (see set_incremental_mark()), a collection marks in slices
+   * of a bounded number of objects, one at each collection request and
+   * each close of the region, so the region can be used between slices.
+   * Marks are kept in a MarkBitmap, and objects allocated while marking
+   * are marked straight away. Stores into objects of the region must then
+   * go through api::store(), whose write barrier pushes the overwritten
+   * reference onto the mark stack, so that everything reachable when the
+   * mark started is marked (snapshot at the beginning). Once the stack is
+   * empty the region is swept, eagerly or lazily. Merge, swap_root and
+   * freeze finish a pending mark first, and release abandons it.
+   *
+   * Optionally (see set_concurrent_mark()), marking happens off the
+   * mutator altogether. A collection request only starts the mark, and
+   * when the region is closed with a mark or a lazy sweep pending, it is
+   * handed to a BackgroundCollector thread, which marks and sweeps it in
+   * slices until done. Opening the region again takes it back, stopping
+   * the thread at the end of its current slice; the mark then carries on
+   * as an incremental one, so the same write barrier applies. Merge,
+   * release and freeze take the region back first too.
+   *
+   * Optionally (see set_paged()), a region keeps its objects in
+   * ObjectPages instead of the rings, which stay empty. Allocation takes a
+   * slot of a size-class page, marks are bits in the pages, and the sweep
+   * scans each page in address order. The side bitmap and the lazy sweep
+   * do not apply to such regions, and they cannot be frozen, as a frozen
+   * object is freed on its own.
+   *
+   * Optionally (see set_sticky_marks() and api::region_set_sticky_marks()),
+   * collections are generational:
+   * the marks of a full collection are kept in a MarkBitmap afterwards,
+   * and the objects marked there are old. Objects allocated after it go
+   * on a young list instead of the rings, and a minor collection only
+   * traces from the iso, the additional roots and the young objects that
+   * stores have made reachable from old ones, stopping at anything
+   * already marked. It then sweeps the young list alone, moving the
+   * survivors into the rings and marking them old, so its cost follows
+   * the allocation since the last collection rather than the size of the
+   * region. Stores into objects of the region must go through
+   * api::store(), whose write barrier records the young object stored.
+   * Old objects that die are only found by the next full collection,
+   * which runs every get_full_gc_interval() collections, or sooner once
+   * more has been promoted since the last one than it found alive. This
+   * applies to regions collected eagerly with rings; lazy, incremental and
+   * concurrent collections, and anything that needs the whole ring
+   * (merge, swap_root, freeze, release, iteration), end it first.
    **/
   class RegionTrace : public RegionBase
   {
     friend class Freeze;
     friend class Region;
     friend class RegionRc;
+    friend class BackgroundCollector<RegionTrace>;
 
   private:
     enum RingKind
@@ -65,20 +150,162 @@ namespace verona::rt
 
     // Memory usage in the region.
     size_t current_memory_used = 0;
-    size_t memory_at_last_gc = 0;
-    size_t closes_since_gc = 0;
 
-    // Number of objects in the region (O(1) access).
+    // Number of objects in the region, and of those that are non-trivial
+    // (O(1) access).
     size_t region_size = 0;
-
-    // Compact representation of previous memory used as a sizeclass.
-    snmalloc::sizeclass_t previous_memory_used;
+    size_t non_trivial_size = 0;
 
     // Stack of stack based entry points into the region.
     StackThin<Object> additional_entry_points{};
 
+    // Whether collections mark objects in a side bitmap.
+    static inline std::atomic<bool> mark_bitmap_{false};
+
+    // Number of objects taken off the mark stack ahead of being inspected,
+    // so that their headers can be prefetched.
+    static constexpr size_t MARK_PREFETCH_DEPTH = 8;
+
+    // Whether marking prefetches objects before it inspects them.
+    static inline std::atomic<bool> mark_prefetch_{true};
+
+    // Number of trivial objects an allocation, or a close of the region,
+    // sweeps while a lazy sweep is pending.
+    static constexpr size_t LAZY_SWEEP_ALLOC_STEP = 8;
+    static constexpr size_t LAZY_SWEEP_CLOSE_STEP = 1024;
+
+    // Number of threads an eager sweep may use, and the number of objects
+    // a region needs for a collection to use more than one.
+    static inline std::atomic<size_t> sweep_threads_{1};
+
+  public:
+    static constexpr size_t PARALLEL_SWEEP_MIN_OBJECTS = 16 * 1024;
+
+  private:
+    /**
+     * Live trivial objects sampled by a mark, at which a parallel sweep
+     * cuts the trivial ring. One in `stride` is kept, and once there are
+     * MAX the stride doubles, so the samples stay spread over the mark.
+     **/
+    struct SweepCuts
+    {
+      static constexpr size_t MAX = 1024;
+      static constexpr size_t INITIAL_STRIDE = 64;
+
+      std::vector<Object*> objects;
+      size_t stride = INITIAL_STRIDE;
+      size_t seen = 0;
+
+      void sample(Object* p)
+      {
+        if ((seen++ % stride) != 0)
+          return;
+
+        if (objects.size() == MAX)
+        {
+          for (size_t i = 0; i < MAX / 2; i++)
+            objects[i] = objects[2 * i];
+          objects.resize(MAX / 2);
+          stride *= 2;
+        }
+        objects.push_back(p);
+      }
+
+      bool contains(Object* p) const
+      {
+        return std::binary_search(objects.begin(), objects.end(), p);
+      }
+    };
+
+    // Cuts sampled by the current mark, or nullptr if the sweep after it
+    // is not parallel.
+    SweepCuts* sweep_cuts = nullptr;
+
+    // Whether collections leave the trivial ring to a lazy sweep.
+    static inline std::atomic<bool> lazy_sweep_{false};
+
+    // Pending lazy sweep: the marks of the last collection, or nullptr if
+    // there is none, and the cursor into the trivial ring. `sweep_prev` is
+    // the object before `sweep_cursor`, or `this` at the start of the ring,
+    // as in sweep_ring().
+    MarkBitmap* sweep_marks = nullptr;
+    Object* sweep_prev = nullptr;
+    Object* sweep_cursor = nullptr;
+    // Whether the trivial ring is the primary one.
+    bool sweep_primary = false;
+
+    /// Objects marked by a call to mark(), and their total size.
+    struct MarkStats
+    {
+      size_t objects = 0;
+      size_t bytes = 0;
+    };
+
+    // Whether collections mark incrementally, and the number of objects
+    // each slice of marking inspects.
+    static constexpr size_t DEFAULT_MARK_SLICE = 4096;
+    static inline std::atomic<bool> incremental_mark_{false};
+    static inline std::atomic<size_t> mark_slice_{DEFAULT_MARK_SLICE};
+
+    // Number of regions with an incremental mark in progress, so that the
+    // write barrier costs a single load otherwise.
+    static inline std::atomic<size_t> pending_marks_{0};
+
+    // Pending incremental mark: the marks so far, or nullptr if there is no
+    // mark in progress, the objects still to inspect, and what has been
+    // found alive.
+    MarkBitmap* mark_marks = nullptr;
+    ObjectStack* mark_stack = nullptr;
+    MarkStats mark_live;
+
+    // Whether closed regions are marked by the background collector.
+    static inline std::atomic<bool> concurrent_mark_{false};
+
+    // Whether the background collector holds this region, whether it has
+    // been asked to give it back, and the iso object it was closed with.
+    std::atomic<bool> in_background{false};
+    std::atomic<bool> background_stop{false};
+    Object* background_entry = nullptr;
+
+    // Whether regions are created with the page backend, and whether this
+    // one was.
+    static inline std::atomic<bool> paged_{false};
+    bool paged = false;
+
+    // The objects of a paged region.
+    ObjectPages pages;
+
+    // Whether the collections of regions created from now on, and of this
+    // one, keep their marks as old objects, and the number of collections
+    // between full ones.
+    static constexpr size_t DEFAULT_FULL_GC_INTERVAL = 8;
+    static inline std::atomic<bool> sticky_marks_{false};
+    bool sticky_marks = sticky_marks_.load(std::memory_order_relaxed);
+    static inline std::atomic<size_t> full_gc_interval_{
+      DEFAULT_FULL_GC_INTERVAL};
+
+    // Number of regions with old objects, so that the write barrier costs
+    // a single load otherwise.
+    static inline std::atomic<size_t> sticky_regions_{0};
+
+    // The old objects, or nullptr if the region has none, and the young
+    // list of objects allocated since the last collection, which ends in
+    // nullptr.
+    MarkBitmap* old_marks = nullptr;
+    Object* young_head = nullptr;
+
+    // Young objects stored into the region since the last collection,
+    // which a minor collection traces from.
+    StackThin<Object> young_roots{};
+
+    // Minor collections since the last full one, bytes they have promoted,
+    // and bytes the full one found alive.
+    size_t minor_gcs = 0;
+    size_t promoted_bytes = 0;
+    size_t full_live_bytes = 0;
+
     explicit RegionTrace()
-    : RegionBase(), next_not_root(this), last_not_root(this)
+    : RegionBase(RegionType::Trace), next_not_root(this), last_not_root(this)
     {}
 
     static const Descriptor* desc()
@@ -112,10 +339,300 @@ namespace verona::rt
       return region_size;
     }
 
+    size_t get_non_trivial_size() const
+    {
+      return non_trivial_size;
+    }
+
+    /**
+     * Choose whether collections mark live objects in a side bitmap
+     * instead of in their headers (see the class comment).
+     **/
+    static void set_mark_bitmap(bool enable)
+    {
+      mark_bitmap_.store(enable, std::memory_order_relaxed);
+    }
+
+    static bool get_mark_bitmap()
+    {
+      return mark_bitmap_.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Choose whether marking prefetches objects as they come off the mark
+     * stack, and inspects them MARK_PREFETCH_DEPTH objects later, which
+     * hides part of the cache miss on each header. On by default.
+     **/
+    static void set_mark_prefetch(bool enable)
+    {
+      mark_prefetch_.store(enable, std::memory_order_relaxed);
+    }
+
+    static bool get_mark_prefetch()
+    {
+      return mark_prefetch_.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Choose whether collections free the dead trivial objects lazily,
+     * after they return (see the class comment). The region metrics count
+     * only live objects either way.
+     **/
+    static void set_lazy_sweep(bool enable)
+    {
+      lazy_sweep_.store(enable, std::memory_order_relaxed);
+    }
+
+    static bool get_lazy_sweep()
+    {
+      return lazy_sweep_.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Whether dead objects of the last collection are still waiting for
+     * the lazy sweep.
+     **/
+    bool is_sweep_pending() const
+    {
+      return sweep_marks != nullptr;
+    }
+
+    /**
+     * Choose whether collections mark in slices, across several requests
+     * to collect and closes of the region (see the class comment).
+     **/
+    static void set_incremental_mark(bool enable)
+    {
+      incremental_mark_.store(enable, std::memory_order_relaxed);
+    }
+
+    static bool get_incremental_mark()
+    {
+      return incremental_mark_.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Set the number of objects a slice of incremental marking inspects.
+     * Clamped to at least 1.
+     **/
+    static void set_mark_slice(size_t objects)
+    {
+      mark_slice_.store(objects == 0 ? 1 : objects, std::memory_order_relaxed);
+    }
+
+    static size_t get_mark_slice()
+    {
+      return mark_slice_.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Whether an incremental mark of this region is in progress.
+     **/
+    bool is_mark_pending() const
+    {
+      return mark_stack != nullptr;
+    }
+
+    /**
+     * Choose whether collections are marked, and swept, on a background
+     * thread while the region is closed (see the class comment).
+     **/
+    static void set_concurrent_mark(bool enable)
+    {
+      concurrent_mark_.store(enable, std::memory_order_relaxed);
+    }
+
+    static bool get_concurrent_mark()
+    {
+      return concurrent_mark_.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Wait until the background collector has finished with every region
+     * handed to it.
+     *
+     * For testing and benchmarking purposes.
+     **/
+    static void drain_background()
+    {
+      BackgroundCollector<RegionTrace>::drain();
+    }
+
+    /**
+     * Choose whether regions created from now on keep their objects in
+     * size-class pages instead of rings (see the class comment).
+     **/
+    static void set_paged(bool enable)
+    {
+      paged_.store(enable, std::memory_order_relaxed);
+    }
+
+    static bool get_paged()
+    {
+      return paged_.load(std::memory_order_relaxed);
+    }
+
+    bool is_paged() const
+    {
+      return paged;
+    }
+
+    /// Number of pages a paged region holds its objects in, or 0.
+    size_t get_page_count() const
+    {
+      return pages.get_page_count();
+    }
+
+    /**
+     * Set the number of threads an eager sweep uses to free the trivial
+     * ring. Values greater than one sweep regions of at least
+     * PARALLEL_SWEEP_MIN_OBJECTS objects in parallel; 0 and 1 keep the
+     * sweep on the collecting thread.
+     **/
+    static void set_sweep_threads(size_t n)
+    {
+      sweep_threads_.store(n == 0 ? 1 : n, std::memory_order_relaxed);
+    }
+
+    static size_t get_sweep_threads()
+    {
+      return sweep_threads_.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Choose whether the collections of regions created from now on keep
+     * the marks of a full collection and collect only the young objects in
+     * between (see the class comment). A region can choose otherwise with
+     * set_region_sticky_marks().
+     **/
+    static void set_sticky_marks(bool enable)
+    {
+      sticky_marks_.store(enable, std::memory_order_relaxed);
+    }
+
+    static bool get_sticky_marks()
+    {
+      return sticky_marks_.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Choose whether the collections of this region keep their marks, in
+     * place of the default it was created with. Turning them off ends them
+     * at the next collection.
+     **/
+    void set_region_sticky_marks(bool enable)
+    {
+      sticky_marks = enable;
+    }
+
+    /**
+     * Set the number of collections of a region with sticky marks that
+     * make up one full collection and the minor ones after it. With 1 or
+     * less, every collection is full.
+     **/
+    static void set_full_gc_interval(size_t collections)
+    {
+      full_gc_interval_.store(collections, std::memory_order_relaxed);
+    }
+
+    static size_t get_full_gc_interval()
+    {
+      return full_gc_interval_.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Whether the region has old objects, so that its next collection can
+     * be a minor one.
+     **/
+    bool is_sticky() const
+    {
+      return old_marks != nullptr;
+    }
+
+    /**
+     * Whether any region has old objects. The sticky write barrier has
+     * nothing to do otherwise.
+     **/
+    static bool is_any_sticky()
+    {
+      return sticky_regions_.load(std::memory_order_relaxed) != 0;
+    }
+
+    /**
+     * Write barrier for a store of `value` into an object of this region.
+     * If the region has old objects and `value` is young, it is recorded,
+     * so the next minor collection keeps it even if only old objects
+     * refer to it.
+     **/
+    void remember_young(Object* value)
+    {
+      if (
+        is_sticky() && (value->get_class() == Object::UNMARKED) &&
+        !old_marks->is_marked(value))
+        young_roots.push(value);
+    }
+
+    /**
+     * Whether an incremental mark of any region is in progress. The write
+     * barrier has nothing to do otherwise.
+     **/
+    static bool is_any_mark_pending()
+    {
+      return pending_marks_.load(std::memory_order_relaxed) != 0;
+    }
+
+    /**
+     * Write barrier for a store into an object of this region that
+     * overwrites the reference `old`. While a mark is in progress, `old` is
+     * pushed onto the mark stack, so it is marked even if the store leaves
+     * it reachable only from objects already inspected.
+     **/
+    void write_barrier(Object* old)
+    {
+      if (is_mark_pending() && (old != nullptr))
+        mark_stack->push(old);
+    }
+
+    /**
+     * Called when the region is opened: take it back from the background
+     * collector, if it has it.
+     **/
+    void open()
+    {
+      BackgroundCollector<RegionTrace>::withdraw(this);
+    }
+
+    /**
+     * Called when the region with iso object `o` is closed: advance a
+     * pending incremental mark by one slice, or else a pending lazy sweep.
+     * With concurrent marking, both are handed to the background collector
+     * instead.
+     **/
+    void close(Object* o)
+    {
+      if (
+        get_concurrent_mark() && (is_mark_pending() || is_sweep_pending()))
+      {
+        background_entry = o;
+        BackgroundCollector<RegionTrace>::submit(this);
+      }
+      else if (is_mark_pending())
+      {
+        ObjectStack collect;
+        mark_step(o, collect, get_mark_slice());
+        release_subregions(collect);
+      }
+      else if (is_sweep_pending())
+      {
+        sweep_step(LAZY_SWEEP_CLOSE_STEP);
+      }
+    }
+
     /**
      * Creates a new trace region by allocating Object `o` of type `desc`. The
      * object is initialised as the Iso object for that region, and points to a
-     * newly created Region metadata object. Returns a pointer to `o`.
+     * newly created Region metadata object. Returns a pointer to `o`. Unless
+     * the region is paged, `o` is allocated together with the metadata.
      *
      * The default template parameter `size = 0` is to avoid writing two
      * definitions which differ only in one line. This overload works because
@@ -124,61 +641,194 @@ namespace verona::rt
     template<size_t size = 0>
     static Object* create(const Descriptor* desc)
     {
-      void* p = heap::alloc<vsizeof<RegionTrace>>();
+      bool paged = get_paged();
+      void* iso = nullptr;
+      void* p = paged ?
+        heap::alloc<vsizeof<RegionTrace>>() :
+        alloc_with_iso(vsizeof<RegionTrace>, desc->size, iso);
       Object* o = Object::register_object(p, RegionTrace::desc());
       auto reg = new (o) RegionTrace();
       reg->use_memory(desc->size);
 
-      if constexpr (size == 0)
-        p = heap::alloc(desc->size);
+      if (paged)
+      {
+        reg->paged = true;
+        reg->init_next(reg);
+        o = reg->pages.alloc(desc, desc->size);
+        reg->pages.set_root(o);
+      }
+      else if (iso != nullptr)
+      {
+        o = Object::register_object(iso, desc);
+        reg->place_iso(o);
+        reg->init_next(o);
+      }
       else
-        p = heap::alloc<size>();
-      o = Object::register_object(p, desc);
+      {
+        if constexpr (size == 0)
+          p = heap::alloc(desc->size);
+        else
+          p = heap::alloc<size>();
+        o = Object::register_object(p, desc);
+        reg->init_next(o);
+      }
 
-      reg->init_next(o);
       o->init_iso();
       o->set_region(reg);
       reg->region_size += 1;
+      if (!o->is_trivial())
+        reg->non_trivial_size += 1;
 
       assert(Object::debug_is_aligned(o));
       return o;
     }
 
     /**
-     * Allocates an object `o` of type `desc` in the region represented by the
-     * Iso object `in`, and adds it to the appropriate ring. Returns a pointer
-     * to `o`.
+     * Allocates an object `o` of type `desc`, with a trailing array of
+     * `tail` elements, in the region represented by the Iso object `in`, and
+     * adds it to the appropriate ring. Returns a pointer to `o`.
      *
      * The default template parameter `size = 0` is to avoid writing two
      * definitions which differ only in one line. This overload works because
      * every object must contain a descriptor, so 0 is not a valid size.
      **/
     template<size_t size = 0>
-    static Object* alloc(Object* in, const Descriptor* desc)
+    static Object* alloc(Object* in, const Descriptor* desc, size_t tail = 0)
     {
-      assert((size == 0) || (size == desc->size));
+      assert((size == 0) || ((size == desc->size) && (tail == 0)));
+      size_t sz = Object::size_of(desc, tail);
+      AllocStats::Sample sample(RegionType::Trace, sz);
       RegionTrace* reg = get(in);
 
       assert(reg != nullptr);
 
-      void* p = nullptr;
-      if constexpr (size == 0)
-        p = heap::alloc(desc->size);
+      if (reg->is_sweep_pending())
+        reg->sweep_step(LAZY_SWEEP_ALLOC_STEP);
+
+      Object* o;
+      if (reg->paged)
+      {
+        o = reg->pages.alloc(desc, sz);
+      }
       else
-        p = heap::alloc<size>();
+      {
+        void* p = nullptr;
+        if constexpr (size == 0)
+          p = heap::alloc(sz);
+        else
+          p = heap::alloc<size>();
+
+        o = Object::register_object(p, desc);
 
-      auto o = (Object*)Object::register_object(p, desc);
+        // Add to the young list, or else to the ring.
+        if (reg->is_sticky())
+        {
+          o->init_next(reg->young_head);
+          reg->young_head = o;
+        }
+        else
+        {
+          reg->append(o);
+        }
+      }
+      o->init_tail(tail);
       assert(Object::debug_is_aligned(o));
 
-      // Add to the ring.
-      reg->append(o);
+      // Objects allocated during a mark are live.
+      if (reg->is_mark_pending())
+      {
+        if (reg->paged)
+          ObjectPages::mark(o);
+        else
+          reg->mark_marks->mark(o);
+        reg->mark_live.objects++;
+        reg->mark_live.bytes += sz;
+        HeapProfile::count(o);
+      }
 
       // GC heuristics.
-      reg->use_memory(desc->size);
+      reg->use_memory(sz);
       reg->region_size += 1;
+      if (!o->is_trivial())
+        reg->non_trivial_size += 1;
       return o;
     }
 
+    /**
+     * Allocate `n` objects of type `desc` in the region represented by the
+     * Iso Object `in`, storing them in `out[0..n)`.
+     *
+     * The objects are linked into one segment and spliced into the ring in a
+     * single step, and the region metrics are updated once for the batch.
+     **/
+    template<size_t size = 0>
+    static void
+    alloc_many(Object* in, const Descriptor* desc, size_t n, Object** out)
+    {
+      assert((size == 0) || (size == desc->size));
+      if (n == 0)
+        return;
+
+      RegionTrace* reg = get(in);
+      assert(reg != nullptr);
+
+      if (reg->is_sweep_pending())
+        reg->sweep_step(LAZY_SWEEP_ALLOC_STEP * n);
+
+      for (size_t i = 0; i < n; i++)
+      {
+        Object* o;
+        if (reg->paged)
+        {
+          o = reg->pages.alloc(desc, desc->size);
+        }
+        else
+        {
+          void* p = nullptr;
+          if constexpr (size == 0)
+            p = heap::alloc(desc->size);
+          else
+            p = heap::alloc<size>();
+
+          o = Object::register_object(p, desc);
+          if (i > 0)
+            out[i - 1]->init_next(o);
+        }
+        assert(Object::debug_is_aligned(o));
+        out[i] = o;
+      }
+
+      if (reg->is_sticky())
+      {
+        out[n - 1]->init_next(reg->young_head);
+        reg->young_head = out[0];
+      }
+      else if (!reg->paged)
+      {
+        reg->append(out[0], out[n - 1]);
+      }
+
+      // Objects allocated during a mark are live.
+      if (reg->is_mark_pending())
+      {
+        for (size_t i = 0; i < n; i++)
+        {
+          if (reg->paged)
+            ObjectPages::mark(out[i]);
+          else
+            reg->mark_marks->mark(out[i]);
+        }
+        reg->mark_live.objects += n;
+        reg->mark_live.bytes += n * desc->size;
+      }
+
+      // GC heuristics.
+      reg->use_memory(n * desc->size);
+      reg->region_size += n;
+      if (!Object::is_trivial(desc))
+        reg->non_trivial_size += n;
+    }
+
     /**
      * Insert the Object `o` into the RememberedSet of `into`'s region.
      *
@@ -194,6 +844,10 @@ namespace verona::rt
       Object::RegionMD c;
       o = o->root_and_class(c);
       reg->RememberedSet::insert<transfer>(o);
+
+      // Keep the entry through the sweep of a mark in progress.
+      if (reg->is_mark_pending())
+        reg->RememberedSet::mark(o);
     }
 
     /**
@@ -212,12 +866,22 @@ namespace verona::rt
       if (is_trace_region(other))
       {
         RegionTrace* other_trace = (RegionTrace*)other;
+        reg->finish_mark(into);
+        other_trace->finish_mark(o);
+        reg->finish_sweep();
+        other_trace->finish_sweep();
+        reg->end_sticky();
+        other_trace->end_sticky();
 
         // o is not allowed to have additional roots, as it is about
         // to be collapsed `into`.
         if (!other_trace->additional_entry_points.empty())
           abort();
 
+        // Rings and pages cannot be mixed.
+        if (reg->paged != other_trace->paged)
+          abort();
+
         reg->merge_internal(o, other_trace);
 
         // Merge the ExternalReferenceTable and RememberedSet.
@@ -245,34 +909,12 @@ namespace verona::rt
       assert(prev->get_region() != next);
 
       RegionTrace* reg = get(prev);
+      reg->finish_mark(prev);
+      reg->finish_sweep();
+      reg->end_sticky();
       reg->swap_root_internal(prev, next);
     } 
 
-    static bool gc_condition(Object* o) {
-      assert(o->debug_is_iso());
-      assert(is_trace_region(o->get_region()));
-
-      RegionTrace* reg = get(o);
-      std::cout << "Region: " << reg << ", ";
-      if (reg->closes_since_gc > 3) {
-        std::cout << "GC CONDITION TRUE 1 " << reg->closes_since_gc << "\n";
-        return true;
-      }
-      size_t cur = reg->get_current_memory_used();
-      size_t last = reg->memory_at_last_gc;
-      Logging::cout() << "CHECKING GC CONDITION: cur=" << cur << ", last=" << last << "\n";
-      if (cur - last > 1000) {
-        std::cout << "GC CONDITION TRUE 2 " << reg->closes_since_gc << "\n";
-        reg->closes_since_gc = 0;
-        return true;
-      }
-  
-      reg->closes_since_gc++;
-      std::cout << "GC CONDITION FALSE 3 " << reg->closes_since_gc << "\n";
-  
-      return false;
-    }
-
     /**
      * Run a garbage collection on the region represented by the Object `o`.
      * Only `o`'s region will be GC'd; we ignore pointers to Immutables and
@@ -283,45 +925,81 @@ namespace verona::rt
       Logging::cout() << "Region GC called for: " << o << Logging::endl;
       assert(o->debug_is_iso());
       assert(is_trace_region(o->get_region()));
+      if constexpr (EventTrace::enabled)
+        EventTrace::record(EventTrace::Event::RegionGC, (uintptr_t)o);
       
       RegionTrace* reg = get(o);
       
-      ObjectStack f;
       ObjectStack collect;
 
+      if (get_incremental_mark() || get_concurrent_mark())
+      {
+        if (!reg->is_mark_pending())
+          reg->start_mark(o);
+
+        // A concurrent mark is left to the background collector.
+        if (!get_concurrent_mark())
+        {
+          reg->mark_step(o, collect, get_mark_slice());
+          reg->release_subregions(collect);
+        }
+        if constexpr (EventTrace::enabled)
+          EventTrace::record(EventTrace::Event::RegionGCDone, (uintptr_t)o);
+        return;
+      }
+
+      ObjectStack f;
+
       // Copy additional roots into f.
       reg->additional_entry_points.forall([&f](Object* o) {
         Logging::cout() << "Additional root: " << o << Logging::endl;
         f.push(o);
       });
 
-      reg->mark(o, f);
-      reg->sweep(o, collect);
-      reg->memory_at_last_gc = reg->get_current_memory_used();
+      reg->finish_mark(o);
+      reg->finish_sweep();
 
-      // `collect` contains all the iso objects to unreachable subregions.
-      // Since they are unreachable, we can just release them.
-      while (!collect.empty())
-      {
-        o = collect.pop();
-        assert(o->debug_is_iso());
-        Logging::cout() << "Region GC: releasing unreachable subregion: " << o
-                        << Logging::endl;
+      bool sticky = !reg->paged && reg->sticky_marks && !get_lazy_sweep();
+      if (!sticky)
+        reg->end_sticky();
 
-        // Note that we need to dispatch because `r` is a different region
-        // metadata object.
-        RegionBase* r = o->get_region();
-        assert(r != reg);
-
-        // Unfortunately, we can't use Region::release_internal because of a
-        // circular dependency between header files.
-        if (RegionTrace::is_trace_region(r))
-          ((RegionTrace*)r)->release_internal(o, collect);
-        else if (RegionArena::is_arena_region(r))
-          ((RegionArena*)r)->release_internal(o, collect);
-        else
-          abort();
+      // The mark of a large region samples where its sweep can be split.
+      SweepCuts cuts;
+      if (
+        !sticky && !reg->paged && !get_lazy_sweep() &&
+        (get_sweep_threads() > 1) &&
+        (reg->region_size >= PARALLEL_SWEEP_MIN_OBJECTS))
+        reg->sweep_cuts = &cuts;
+
+      if (sticky)
+      {
+        reg->sticky_gc(o, f, collect);
+      }
+      else if (reg->paged)
+      {
+        reg->mark(o, f);
+        reg->sweep_pages(o, collect);
+      }
+      else if (get_lazy_sweep())
+      {
+        auto* marks = new (heap::alloc<sizeof(MarkBitmap)>()) MarkBitmap;
+        MarkStats live = reg->mark(o, f, marks);
+        reg->sweep_lazily(o, collect, marks, live);
+      }
+      else if (get_mark_bitmap())
+      {
+        MarkBitmap marks;
+        reg->mark(o, f, &marks);
+        reg->sweep(o, collect, &marks);
       }
+      else
+      {
+        reg->mark(o, f);
+        reg->sweep(o, collect);
+      }
+      reg->release_subregions(collect);
+      if constexpr (EventTrace::enabled)
+        EventTrace::record(EventTrace::Event::RegionGCDone, (uintptr_t)o);
     }
 
     /// Add object `o` to the additional root stack of the region referenced to
@@ -364,6 +1042,10 @@ namespace verona::rt
       {
         tl->init_next(p);
         set_next(hd);
+
+        // Keep a pending sweep linked to the object before its cursor.
+        if (is_sweep_pending() && sweep_primary && sweep_prev == this)
+          sweep_prev = tl;
       }
       else
       {
@@ -372,37 +1054,55 @@ namespace verona::rt
 
         if (last_not_root == this)
           last_not_root = tl;
+
+        if (is_sweep_pending() && !sweep_primary && sweep_prev == this)
+          sweep_prev = tl;
       }
     }
 
     void merge_internal(Object* o, RegionTrace* other)
     {
       assert(o->get_region() == other);
-      Object* head;
 
-      // Merge the primary ring.
-      head = other->get_next();
-      if (head != other)
-        append(head, o);
+      if (paged)
+      {
+        pages.merge(o, other->pages);
+      }
+      else
+      {
+        Object* head;
+
+        // Merge the primary ring.
+        head = other->get_next();
+        if (head != other)
+          append(head, o);
 
-      // Merge the secondary ring.
-      head = other->next_not_root;
-      if (head != other)
-        append(head, other->last_not_root);
+        // Merge the secondary ring.
+        head = other->next_not_root;
+        if (head != other)
+          append(head, other->last_not_root);
+      }
 
-      // Update memory usage and region size.
+      // Both regions' metrics are exact, so the merged region's are their
+      // sums.
       current_memory_used += other->current_memory_used;
       region_size += other->region_size;
-
-      previous_memory_used = size_to_sizeclass_full(
-        sizeclass_full_to_size(other->previous_memory_used) +
-        sizeclass_full_to_size(other->previous_memory_used));
+      non_trivial_size += other->non_trivial_size;
+      gc_policy.merge(other->gc_policy);
     }
 
     void swap_root_internal(Object* oroot, Object* nroot)
     {
       assert(debug_is_in_region(nroot));
 
+      if (paged)
+      {
+        pages.swap_root(oroot, nroot);
+        nroot->init_iso();
+        nroot->set_region(this);
+        return;
+      }
+
       // Swap the rings if necessary.
       if (oroot->is_trivial() != nroot->is_trivial())
       {
@@ -442,13 +1142,66 @@ namespace verona::rt
      * Scan through the region and mark all objects reachable from the iso
      * object `o`. We don't follow pointers to subregions. Also will trace
      * from anything already in `dfs`.
+     *
+     * With `marks`, the objects are marked there rather than in their
+     * headers. A paged region marks them in their pages. Returns the number and size of the objects marked; the iso
+     * object itself is not counted.
+     *
+     * Unless disabled (see set_mark_prefetch()), objects pass through a
+     * small FIFO between the stack and the loop: each is prefetched as it
+     * enters, and inspected once MARK_PREFETCH_DEPTH others have.
      **/
-    void mark(Object* o, ObjectStack& dfs)
+    MarkStats mark(Object* o, ObjectStack& dfs, MarkBitmap* marks = nullptr)
     {
       o->trace(dfs);
-      while (!dfs.empty())
+      return mark_from(dfs, marks, SIZE_MAX);
+    }
+
+    /**
+     * Mark everything reachable from the objects in `dfs`, as mark() does,
+     * but stop once `budget` objects have been inspected. The objects left
+     * to inspect are then on `dfs`.
+     **/
+    MarkStats mark_from(ObjectStack& dfs, MarkBitmap* marks, size_t budget)
+    {
+      GCPhases::Scope phase(GCPhases::Mark);
+      MarkStats live;
+
+      size_t depth = get_mark_prefetch() ? MARK_PREFETCH_DEPTH : 1;
+      Object* fifo[MARK_PREFETCH_DEPTH];
+      size_t head = 0;
+      size_t count = 0;
+
+      while (true)
       {
-        Object* p = dfs.pop();
+        if (budget == 0)
+        {
+          // Put back the objects taken off the stack but not inspected.
+          for (; count > 0; count--)
+          {
+            dfs.push(fifo[head]);
+            head = (head + 1) % MARK_PREFETCH_DEPTH;
+          }
+          break;
+        }
+
+        while (count < depth && !dfs.empty())
+        {
+          Object* q = dfs.pop();
+          if (depth > 1)
+            Aal::prefetch(q->real_start());
+          fifo[(head + count) % MARK_PREFETCH_DEPTH] = q;
+          count++;
+        }
+
+        if (count == 0)
+          break;
+
+        Object* p = fifo[head];
+        head = (head + 1) % MARK_PREFETCH_DEPTH;
+        count--;
+        budget--;
+
         switch (p->get_class())
         {
           case Object::ISO:
@@ -456,8 +1209,27 @@ namespace verona::rt
             break;
 
           case Object::UNMARKED:
-            Logging::cout() << "Mark" << p << Logging::endl;
-            p->mark();
+            if (paged)
+            {
+              if (!ObjectPages::mark(p))
+                break;
+            }
+            else if (marks != nullptr)
+            {
+              if (!marks->mark(p))
+                break;
+            }
+            else
+            {
+              if constexpr (Logging::enabled)
+                Logging::cout() << "Mark" << p << Logging::endl;
+              p->mark();
+            }
+            live.objects++;
+            live.bytes += p->size();
+            HeapProfile::count(p);
+            if ((sweep_cuts != nullptr) && p->is_trivial())
+              sweep_cuts->sample(p);
             p->trace(dfs);
             break;
 
@@ -475,6 +1247,7 @@ namespace verona::rt
             assert(0);
         }
       }
+      return live;
     }
 
     enum class SweepAll
@@ -490,27 +1263,57 @@ namespace verona::rt
      *
      * If sweep_all is Yes, it is assumed the entire region is being released
      * and the Iso object is collected as well.
+     *
+     * With `marks`, the live objects are the ones marked there, and their
+     * headers are not written.
      **/
     template<SweepAll sweep_all = SweepAll::No>
-    void sweep(Object* o, ObjectStack& collect)
+    void sweep(Object* o, ObjectStack& collect, MarkBitmap* marks = nullptr)
     {
+      GCPhases::Scope phase(GCPhases::Sweep);
       RingKind primary_ring = o->is_trivial() ? TrivialRing : NonTrivialRing;
 
       // We sweep the non-trivial ring first, as finalisers in there could refer
       // to other objects. The ISO object o could be deallocated by either of
-      // these two lines.
-      sweep_ring<NonTrivialRing, sweep_all>(o, primary_ring, collect);
-      sweep_ring<TrivialRing, sweep_all>(o, primary_ring, collect);
+      // these two lines. A region of trivial objects only has nothing to
+      // finalise, and one without external references need not look for
+      // them.
+      if (!is_ring_empty(NonTrivialRing, primary_ring))
+        sweep_ring<NonTrivialRing, sweep_all>(o, primary_ring, collect, marks);
+
+      SweepCuts* cuts = sweep_cuts;
+      sweep_cuts = nullptr;
+      if (
+        (sweep_all == SweepAll::No) && (cuts != nullptr) &&
+        !cuts->objects.empty())
+        sweep_parallel(primary_ring, marks, *cuts, get_sweep_threads());
+      else if (ExternalReferenceTable::is_empty())
+        sweep_ring<TrivialRing, sweep_all, false>(
+          o, primary_ring, collect, marks);
+      else
+        sweep_ring<TrivialRing, sweep_all>(o, primary_ring, collect, marks);
 
       RememberedSet::sweep();
-      previous_memory_used = size_to_sizeclass_full(current_memory_used);
+    }
+
+    /**
+     * Whether the ring `ring` has no objects in it. The primary ring always
+     * has the iso object.
+     **/
+    bool is_ring_empty(RingKind ring, RingKind primary_ring) const
+    {
+      return (ring != primary_ring) && (next_not_root == this);
     }
 
     /**
      * Garbage Collect an object. If the object is trivial, then it is
-     * deallocated immediately. Otherwise it is added to the `gc` linked list.
+     * deallocated immediately, and the caller accounts for it in the region
+     * metrics. Otherwise it is added to the `gc` linked list.
+     *
+     * With `ext_refs` false, the region has no external references, so the
+     * object cannot have one to remove.
      */
-    template<RingKind ring>
+    template<RingKind ring, bool ext_refs = true>
     void sweep_object(
       Object* p,
       Object* region,
@@ -529,17 +1332,25 @@ namespace verona::rt
 
         // p is about to be collected; remove the entry for it in
         // the ExternalRefTable.
-        if (p->has_ext_ref())
-          ExternalReferenceTable::erase(p);
+        if constexpr (ext_refs)
+        {
+          if (p->has_ext_ref())
+            ExternalReferenceTable::erase(p);
+        }
+        else
+        {
+          assert(!p->has_ext_ref());
+        }
 
-        current_memory_used -= p->size();
-        region_size -= 1;
         p->dealloc();
       }
       else
       {
         assert(!p->is_trivial());
-        p->finalise(region, sub_regions);
+        {
+          GCPhases::Scope phase(GCPhases::Finalise);
+          p->finalise(region, sub_regions);
+        }
 
         // We can't deallocate the object yet, as other objects' finalisers may
         // look at it. We build up a linked list of all objects to delete, we'll
@@ -548,13 +1359,20 @@ namespace verona::rt
       }
     }
 
-    template<RingKind ring, SweepAll sweep_all>
-    void sweep_ring(Object* o, RingKind primary_ring, ObjectStack& collect)
+    template<RingKind ring, SweepAll sweep_all, bool ext_refs = true>
+    void sweep_ring(
+      Object* o,
+      RingKind primary_ring,
+      ObjectStack& collect,
+      MarkBitmap* marks)
     {
       Object* prev = this;
       Object* p = ring == primary_ring ? get_next() : next_not_root;
       LinkedObjectStack gc;
 
+      // Trivial objects freed, subtracted from the metrics in one go.
+      MarkStats dead;
+
       // Note: we don't use the iterator because we need to remove and
       // deallocate objects from the rings.
       while (p != this)
@@ -571,11 +1389,12 @@ namespace verona::rt
             // entire region anyway.
             if constexpr (sweep_all == SweepAll::Yes)
             {
-              sweep_object<ring>(p, o, &gc, collect);
-            }
-            else
-            {
-              use_memory(p->size());
+              if constexpr (ring == TrivialRing)
+              {
+                dead.objects++;
+                dead.bytes += p->size();
+              }
+              sweep_object<ring, ext_refs>(p, o, &gc, collect);
             }
 
             p = this;
@@ -585,7 +1404,6 @@ namespace verona::rt
           case Object::MARKED:
           {
             assert(sweep_all == SweepAll::No);
-            use_memory(p->size());
             p->unmark();
             prev = p;
             p = p->get_next();
@@ -595,8 +1413,22 @@ namespace verona::rt
           case Object::UNMARKED:
           {
             Object* q = p->get_next();
-            Logging::cout() << "Sweep " << p << Logging::endl;
-            sweep_object<ring>(p, o, &gc, collect);
+            if (marks != nullptr && marks->is_marked(p))
+            {
+              assert(sweep_all == SweepAll::No);
+              prev = p;
+              p = q;
+              break;
+            }
+
+            if constexpr (Logging::enabled)
+              Logging::cout() << "Sweep " << p << Logging::endl;
+            if constexpr (ring == TrivialRing)
+            {
+              dead.objects++;
+              dead.bytes += p->size();
+            }
+            sweep_object<ring, ext_refs>(p, o, &gc, collect);
 
             if (ring != primary_ring && prev == this)
               next_not_root = q;
@@ -618,11 +1450,13 @@ namespace verona::rt
       // Deallocate the objects, if not done in first pass.
       if constexpr (ring == NonTrivialRing)
       {
+        UNUSED(dead);
         while (!gc.empty())
         {
           Object* q = gc.pop();
           current_memory_used -= q->size();
           region_size -= 1;
+          non_trivial_size -= 1;
           q->destructor();
           q->dealloc();
         }
@@ -631,7 +1465,519 @@ namespace verona::rt
       {
         UNUSED(o);
         UNUSED(collect);
+        current_memory_used -= dead.bytes;
+        region_size -= dead.objects;
+      }
+    }
+
+    /**
+     * One thread's share of a parallel sweep: what it freed, and the
+     * objects it found dead with an external reference, which are erased
+     * from the table and freed after the threads are done.
+     **/
+    struct SweepWorker
+    {
+      MarkStats dead;
+      ObjectStack ext_refs{};
+    };
+
+    /**
+     * Sweep the trivial ring on up to `threads` threads, the calling one
+     * included. The ring is cut before each object in `cuts`, which the
+     * mark found alive, and the threads take the segments in turn.
+     **/
+    void sweep_parallel(
+      RingKind primary_ring, MarkBitmap* marks, SweepCuts& cuts, size_t threads)
+    {
+      std::sort(cuts.objects.begin(), cuts.objects.end());
+      size_t segments = cuts.objects.size() + 1;
+      threads = std::min(threads, segments);
+
+      Logging::cout() << "Region GC: parallel sweep of " << segments
+                      << " segments on " << threads << " threads"
+                      << Logging::endl;
+
+      std::atomic<size_t> next{0};
+      auto workers = std::make_unique<SweepWorker[]>(threads);
+      auto run = [this, primary_ring, marks, &cuts, &next, segments](
+                   SweepWorker& w) {
+        for (size_t i = next.fetch_add(1, std::memory_order_relaxed);
+             i < segments;
+             i = next.fetch_add(1, std::memory_order_relaxed))
+          sweep_segment(i, primary_ring, marks, cuts, w);
+      };
+
+      std::list<PlatformThread> helpers;
+      for (size_t i = 1; i < threads; i++)
+        helpers.emplace_back([&run, &workers, i]() { run(workers[i]); });
+      run(workers[0]);
+      for (auto& t : helpers)
+        t.join();
+
+      // The table is not thread-safe, so it is only updated here.
+      for (size_t i = 0; i < threads; i++)
+      {
+        SweepWorker& w = workers[i];
+        while (!w.ext_refs.empty())
+        {
+          Object* p = w.ext_refs.pop();
+          ExternalReferenceTable::erase(p);
+          p->dealloc();
+        }
+        current_memory_used -= w.dead.bytes;
+        region_size -= w.dead.objects;
+      }
+    }
+
+    /**
+     * Sweep segment `i` of the trivial ring, for sweep_parallel(). Segment
+     * 0 starts at the head of the ring, and segment `i` at the `i`th cut,
+     * which stays in the ring. A segment ends at the next cut or at the
+     * end of the ring. Cuts are recognised by address alone, as their
+     * headers belong to the thread sweeping the segment they start.
+     **/
+    void sweep_segment(
+      size_t i,
+      RingKind primary_ring,
+      MarkBitmap* marks,
+      SweepCuts& cuts,
+      SweepWorker& w)
+    {
+      bool primary = primary_ring == TrivialRing;
+      Object* prev = this;
+      Object* p = primary ? get_next() : next_not_root;
+      if (i > 0)
+      {
+        prev = cuts.objects[i - 1];
+        if (prev->get_class() == Object::MARKED)
+          prev->unmark();
+        p = prev->get_next();
+      }
+
+      while (p != this && !cuts.contains(p))
+      {
+        switch (p->get_class())
+        {
+          case Object::ISO:
+            // The iso is the last thing in the primary ring.
+            p = this;
+            break;
+
+          case Object::MARKED:
+            p->unmark();
+            prev = p;
+            p = p->get_next();
+            break;
+
+          case Object::UNMARKED:
+          {
+            Object* q = p->get_next();
+            if (marks != nullptr && marks->is_marked(p))
+            {
+              prev = p;
+              p = q;
+              break;
+            }
+
+            w.dead.objects++;
+            w.dead.bytes += p->size();
+            if (p->has_ext_ref())
+              w.ext_refs.push(p);
+            else
+              p->dealloc();
+
+            if (!primary && prev == this)
+              next_not_root = q;
+            else
+              prev->set_next(q);
+            p = q;
+            break;
+          }
+
+          default:
+            assert(0);
+        }
+      }
+
+      // Only the segment at the end of the secondary ring gets here.
+      if (!primary && p == this)
+        last_not_root = prev;
+    }
+
+    /**
+     * Sweep the pages of the paged region with iso object `o`, which the
+     * mark has left marked.
+     **/
+    void sweep_pages(Object* o, ObjectStack& collect)
+    {
+      GCPhases::Scope phase(GCPhases::Sweep);
+      ObjectPages::SweepStats dead = pages.sweep(o, collect, *this);
+      RememberedSet::sweep();
+
+      current_memory_used -= dead.bytes;
+      region_size -= dead.objects;
+      non_trivial_size -= dead.non_trivial;
+    }
+
+    /**
+     * Sweep the non-trivial ring of the region with iso object `o` now, and
+     * leave the trivial ring to sweep_step(). `marks` holds the marks of the
+     * collection, and is owned by the pending sweep from here on. `live`
+     * is what the mark found alive, which becomes the region metrics, as
+     * the dead trivial objects are no longer reachable.
+     **/
+    void sweep_lazily(
+      Object* o, ObjectStack& collect, MarkBitmap* marks, MarkStats live)
+    {
+      GCPhases::Scope phase(GCPhases::Sweep);
+      RingKind primary_ring = o->is_trivial() ? TrivialRing : NonTrivialRing;
+      if (!is_ring_empty(NonTrivialRing, primary_ring))
+        sweep_ring<NonTrivialRing, SweepAll::No>(
+          o, primary_ring, collect, marks);
+      RememberedSet::sweep();
+
+      // The dead trivial objects stay in the ring until a step frees them,
+      // and no external reference may reach them meanwhile.
+      ExternalReferenceTable::erase_dead([o, marks](Object* p) {
+        return (p != o) && p->is_trivial() && !marks->is_marked(p);
+      });
+
+      current_memory_used = o->size() + live.bytes;
+      region_size = 1 + live.objects;
+
+      sweep_marks = marks;
+      sweep_primary = primary_ring == TrivialRing;
+      sweep_prev = this;
+      sweep_cursor = sweep_primary ? get_next() : next_not_root;
+      sweep_step(0);
+    }
+
+    /**
+     * Advance a pending lazy sweep by up to `budget` objects of the trivial
+     * ring, freeing the unmarked ones. Once the cursor reaches the end of
+     * the ring, the marks are freed and the sweep is over.
+     **/
+    void sweep_step(size_t budget)
+    {
+      GCPhases::Scope phase(GCPhases::Sweep);
+      assert(is_sweep_pending());
+      Object* prev = sweep_prev;
+      Object* p = sweep_cursor;
+
+      // The primary ring ends with the iso object, the secondary one with
+      // the region metadata object.
+      for (; (p != this) && (p->get_class() != Object::ISO) && (budget > 0);
+           budget--)
+      {
+        Object* q = p->get_next();
+        if (sweep_marks->is_marked(p))
+        {
+          prev = p;
+          p = q;
+          continue;
+        }
+
+        if constexpr (Logging::enabled)
+          Logging::cout() << "Lazy sweep " << p << Logging::endl;
+        assert(p->is_trivial());
+        // sweep_lazily() dropped the external references of dead objects.
+        assert(!p->has_ext_ref());
+        p->dealloc();
+
+        if (!sweep_primary && prev == this)
+          next_not_root = q;
+        else
+          prev->set_next(q);
+
+        if (!sweep_primary && last_not_root == p)
+          last_not_root = prev;
+
+        p = q;
+      }
+
+      sweep_prev = prev;
+      sweep_cursor = p;
+
+      if ((p == this) || (p->get_class() == Object::ISO))
+      {
+        sweep_marks->~MarkBitmap();
+        heap::dealloc<sizeof(MarkBitmap)>(sweep_marks);
+        sweep_marks = nullptr;
+        sweep_prev = nullptr;
+        sweep_cursor = nullptr;
+      }
+    }
+
+    /**
+     * Complete a pending lazy sweep, if any.
+     **/
+    void finish_sweep()
+    {
+      BackgroundCollector<RegionTrace>::withdraw(this);
+      if (is_sweep_pending())
+        sweep_step(SIZE_MAX);
+    }
+
+    /**
+     * Collect the region with iso object `o`, whose additional roots are
+     * on `f`, keeping the marks: a minor collection if the region has old
+     * objects and no full one is due, and a full one otherwise.
+     **/
+    void sticky_gc(Object* o, ObjectStack& f, ObjectStack& collect)
+    {
+      if (
+        is_sticky() && (minor_gcs + 1 < get_full_gc_interval()) &&
+        (promoted_bytes <= full_live_bytes))
+      {
+        minor_gc(o, f, collect);
+        return;
+      }
+
+      Logging::cout() << "Region GC: full collection: " << o
+                      << Logging::endl;
+      end_sticky();
+      auto* marks = new (heap::alloc<sizeof(MarkBitmap)>()) MarkBitmap;
+      MarkStats live = mark(o, f, marks);
+      sweep(o, collect, marks);
+
+      old_marks = marks;
+      minor_gcs = 0;
+      promoted_bytes = 0;
+      full_live_bytes = live.bytes;
+      sticky_regions_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /**
+     * Collect the young objects of the region with iso object `o`, whose
+     * additional roots are on `f`. Old objects are not traced through, so
+     * the mark stops at them, and they are not swept, so the RememberedSet
+     * keeps the entries they may refer to.
+     **/
+    void minor_gc(Object* o, ObjectStack& f, ObjectStack& collect)
+    {
+      Logging::cout() << "Region GC: minor collection: " << o
+                      << Logging::endl;
+      while (!young_roots.empty())
+        f.push(young_roots.pop());
+
+      MarkStats promoted = mark(o, f, old_marks);
+      sweep_young(o, collect);
+
+      minor_gcs++;
+      promoted_bytes += promoted.bytes;
+    }
+
+    /**
+     * Sweep the young list of the region with iso object `o`. Survivors,
+     * which the mark has made old, move into the rings.
+     **/
+    void sweep_young(Object* o, ObjectStack& collect)
+    {
+      GCPhases::Scope phase(GCPhases::Sweep);
+
+      // Run the finalisers first, while everything they could look at is
+      // still allocated.
+      for (Object* p = young_head; p != nullptr; p = p->get_next())
+      {
+        if (!p->is_trivial() && !old_marks->is_marked(p))
+        {
+          GCPhases::Scope finalise(GCPhases::Finalise);
+          p->finalise(o, collect);
+        }
+      }
+
+      MarkStats dead;
+      Object* p = young_head;
+      young_head = nullptr;
+      while (p != nullptr)
+      {
+        Object* q = p->get_next();
+        if (old_marks->is_marked(p))
+        {
+          append(p);
+        }
+        else
+        {
+          if constexpr (Logging::enabled)
+            Logging::cout() << "Sweep " << p << Logging::endl;
+          dead.objects++;
+          dead.bytes += p->size();
+          if (p->has_ext_ref())
+            ExternalReferenceTable::erase(p);
+          if (!p->is_trivial())
+          {
+            non_trivial_size -= 1;
+            p->destructor();
+          }
+          p->dealloc();
+        }
+        p = q;
+      }
+
+      current_memory_used -= dead.bytes;
+      region_size -= dead.objects;
+    }
+
+    /**
+     * Drop the old objects of the region, if it has any: the young list
+     * moves into the rings, and the next collection is a full one.
+     **/
+    void end_sticky()
+    {
+      if (!is_sticky())
+        return;
+
+      Object* p = young_head;
+      young_head = nullptr;
+      while (p != nullptr)
+      {
+        Object* q = p->get_next();
+        append(p);
+        p = q;
+      }
+
+      while (!young_roots.empty())
+        young_roots.pop();
+
+      old_marks->~MarkBitmap();
+      heap::dealloc<sizeof(MarkBitmap)>(old_marks);
+      old_marks = nullptr;
+      sticky_regions_.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    /**
+     * Start an incremental mark of the region with iso object `o`, from
+     * `o` and the additional roots. Any pending lazy sweep is finished
+     * first, as the new marks replace its own, and old objects are
+     * dropped.
+     **/
+    void start_mark(Object* o)
+    {
+      assert(!is_mark_pending());
+      finish_sweep();
+      end_sticky();
+
+      Logging::cout() << "Region GC: start incremental mark: " << o
+                      << Logging::endl;
+
+      if (!paged)
+        mark_marks = new (heap::alloc<sizeof(MarkBitmap)>()) MarkBitmap;
+      mark_stack = new (heap::alloc<sizeof(ObjectStack)>()) ObjectStack;
+      mark_live = MarkStats();
+      pending_marks_.fetch_add(1, std::memory_order_relaxed);
+
+      additional_entry_points.forall([this](Object* r) {
+        Logging::cout() << "Additional root: " << r << Logging::endl;
+        mark_stack->push(r);
+      });
+      o->trace(*mark_stack);
+    }
+
+    /**
+     * Advance the pending incremental mark of the region with iso object
+     * `o` by up to `budget` objects. If that empties the mark stack, the
+     * region is swept, and the isos of unreachable subregions are added to
+     * `collect`. Returns whether the mark is over.
+     **/
+    bool mark_step(Object* o, ObjectStack& collect, size_t budget)
+    {
+      assert(is_mark_pending());
+      MarkStats live = mark_from(*mark_stack, mark_marks, budget);
+      mark_live.objects += live.objects;
+      mark_live.bytes += live.bytes;
+
+      if (!mark_stack->empty())
+        return false;
+
+      Logging::cout() << "Region GC: finish incremental mark: " << o
+                      << Logging::endl;
+
+      MarkBitmap* marks = mark_marks;
+      end_mark();
+
+      if (paged)
+      {
+        sweep_pages(o, collect);
+      }
+      else if (get_lazy_sweep())
+      {
+        sweep_lazily(o, collect, marks, mark_live);
+      }
+      else
+      {
+        sweep(o, collect, marks);
+        marks->~MarkBitmap();
+        heap::dealloc<sizeof(MarkBitmap)>(marks);
+      }
+      return true;
+    }
+
+    /**
+     * Complete a pending incremental mark of the region with iso object
+     * `o`, if any, and release the subregions it finds unreachable.
+     **/
+    void finish_mark(Object* o)
+    {
+      BackgroundCollector<RegionTrace>::withdraw(this);
+      if (!is_mark_pending())
+        return;
+
+      ObjectStack collect;
+      mark_step(o, collect, SIZE_MAX);
+      release_subregions(collect);
+    }
+
+    /**
+     * Run by the background collector on the closed region: mark and sweep
+     * in slices, until the collection is over or the region is wanted back.
+     **/
+    void collect_in_background()
+    {
+      Object* o = background_entry;
+      bool marking = is_mark_pending();
+      size_t before = current_memory_used;
+      ObjectStack collect;
+
+      while (!background_stop.load(std::memory_order_relaxed))
+      {
+        if (is_mark_pending())
+          mark_step(o, collect, get_mark_slice());
+        else if (is_sweep_pending())
+          sweep_step(LAZY_SWEEP_CLOSE_STEP);
+        else
+          break;
       }
+
+      // No pause to report, so a pause target policy keeps its estimate.
+      if (marking && !is_mark_pending())
+        gc_policy.collected(before, current_memory_used, 0);
+
+      release_subregions(collect);
+    }
+
+    /**
+     * Drop the state of a pending incremental mark. The marks are freed,
+     * unless they have been handed on to the sweep.
+     **/
+    void end_mark()
+    {
+      while (!mark_stack->empty())
+        mark_stack->pop();
+      mark_stack->~ObjectStack();
+      heap::dealloc<sizeof(ObjectStack)>(mark_stack);
+      mark_stack = nullptr;
+      mark_marks = nullptr;
+      pending_marks_.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    /**
+     * Release the subregions whose isos a sweep of this region added to
+     * `collect`. They are unreachable, so they can just be released.
+     **/
+    void release_subregions(ObjectStack& collect)
+    {
+      GCPhases::Scope phase(GCPhases::ReleaseSubregions);
+      release_collected(collect);
     }
 
     /**
@@ -656,8 +2002,30 @@ namespace verona::rt
 
       Logging::cout() << "Region release: trace region: " << o << Logging::endl;
 
+      BackgroundCollector<RegionTrace>::withdraw(this);
+      if (is_mark_pending())
+      {
+        MarkBitmap* marks = mark_marks;
+        end_mark();
+        if (marks != nullptr)
+        {
+          marks->~MarkBitmap();
+          heap::dealloc<sizeof(MarkBitmap)>(marks);
+        }
+      }
+      finish_sweep();
+      end_sticky();
+
       // Sweep everything, including the entrypoint.
-      sweep<SweepAll::Yes>(o, collect);
+      if (paged)
+      {
+        pages.release(o, collect, *this);
+        RememberedSet::sweep();
+      }
+      else
+      {
+        sweep<SweepAll::Yes>(o, collect);
+      }
 
       dealloc();
     }
@@ -678,6 +2046,12 @@ namespace verona::rt
 
       iterator(RegionTrace* r) : reg(r)
       {
+        if (r->paged)
+        {
+          ptr = r->pages.first(cur, type != NonTrivial, type != Trivial);
+          return;
+        }
+
         Object* q = r->get_next();
         if constexpr (type == Trivial)
           ptr = q->is_trivial() ? q : r->next_not_root;
@@ -697,6 +2071,12 @@ namespace verona::rt
     public:
       iterator operator++()
       {
+        if (reg->paged)
+        {
+          ptr = reg->pages.next(cur);
+          return *this;
+        }
+
         Object* q = ptr->get_next_any_mark();
         if (q != reg)
         {
@@ -741,11 +2121,19 @@ namespace verona::rt
     private:
       RegionTrace* reg;
       Object* ptr;
+      ObjectPages::Cursor cur;
     };
 
+    /**
+     * Iterating finishes a pending lazy sweep, so that only live objects
+     * are visited, and drops old objects, so that young ones are in the
+     * rings.
+     **/
     template<IteratorType type = AllObjects>
     inline iterator<type> begin()
     {
+      finish_sweep();
+      end_sticky();
       return {this};
     }
 
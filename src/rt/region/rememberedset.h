@@ -7,7 +7,9 @@
 #include "externalreference.h"
 #include "immutable.h"
 
+#include <atomic>
 #include <snmalloc/snmalloc.h>
+#include <utility>
 
 namespace verona::rt
 {
@@ -21,23 +23,126 @@ namespace verona::rt
 
   private:
     using HashSet = ObjectMap<Object*>;
-    HashSet* hash_set;
+
+    /// Allocated on the first insert, as most regions never reference an
+    /// immutable or a cown.
+    HashSet* hash_set = nullptr;
+
+    static inline std::atomic<size_t> capacity_hint_{0};
+
+    /**
+     * Direct-mapped cache of the objects marked since the last sweep, in
+     * front of the table, so that an object referenced from many places in
+     * the region is looked up once per collection rather than once per
+     * reference. It is allocated by the first mark and freed by the sweep,
+     * so it only exists while a collection is marking.
+     */
+    struct MarkFilter
+    {
+      static constexpr size_t SIZE = 256;
+
+      Object* slots[SIZE] = {};
+
+      static size_t index(Object* o)
+      {
+        uintptr_t a = reinterpret_cast<uintptr_t>(o);
+        return ((a / Object::ALIGNMENT) ^ (a >> 16)) & (SIZE - 1);
+      }
+    };
+
+    MarkFilter* mark_filter = nullptr;
+
+    void drop_mark_filter()
+    {
+      if (mark_filter == nullptr)
+        return;
+
+      heap::dealloc<sizeof(MarkFilter)>(mark_filter);
+      mark_filter = nullptr;
+    }
+
+    HashSet* get_hash_set()
+    {
+      if (SNMALLOC_UNLIKELY(hash_set == nullptr))
+        hash_set = HashSet::create(get_capacity_hint());
+      return hash_set;
+    }
 
   public:
-    RememberedSet() : hash_set(HashSet::create()) {}
+    RememberedSet() = default;
+
+    /**
+     * Set how many entries remembered sets allocated from now on are sized
+     * for, so that regions known to reference many immutables or cowns do
+     * not rehash their set as it fills. 0, the default, starts with the
+     * smallest table.
+     */
+    static void set_capacity_hint(size_t entries)
+    {
+      capacity_hint_.store(entries, std::memory_order_relaxed);
+    }
+
+    static size_t get_capacity_hint()
+    {
+      return capacity_hint_.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Allocate the set now, sized for `entries`, for a region known to be
+     * about to reference that many immutables or cowns. Does nothing if
+     * the set has been allocated already.
+     */
+    void reserve(size_t entries)
+    {
+      if ((hash_set == nullptr) && (entries != 0))
+        hash_set = HashSet::create(entries);
+    }
+
+    /// Number of immutables and cowns the set holds.
+    size_t remembered_size() const
+    {
+      return hash_set == nullptr ? 0 : hash_set->size();
+    }
+
+    /// Number of entries the set has room for, or 0 if it is not allocated.
+    size_t remembered_capacity() const
+    {
+      return hash_set == nullptr ? 0 : hash_set->capacity();
+    }
 
     inline void dealloc()
     {
+      drop_mark_filter();
+      if (hash_set == nullptr)
+        return;
+
       discard(false);
       hash_set->dealloc();
       heap::dealloc<sizeof(HashSet)>(hash_set);
+      hash_set = nullptr;
     }
 
     /**
      * Add the objects from another set to this set.
+     *
+     * The larger of the two tables is kept, and the entries of the smaller
+     * one are inserted into it, so merging a small region into a large one
+     * costs in proportion to the small one.
      */
     void merge(RememberedSet* that)
     {
+      // The kept table may not be this one, so the cached marks may not be
+      // in it.
+      drop_mark_filter();
+      that->drop_mark_filter();
+      if (that->remembered_size() == 0)
+        return;
+
+      if (that->hash_set->size() > remembered_size())
+        std::swap(hash_set, that->hash_set);
+      if (that->hash_set == nullptr)
+        return;
+
       for (auto* e : *that->hash_set)
       {
         // If q is already present in this, decref, otherwise insert.
@@ -64,7 +169,7 @@ namespace verona::rt
       if constexpr (transfer == NoTransfer)
         o->incref();
 
-      if (!hash_set->insert(o).first)
+      if (!get_hash_set()->insert(o).first)
       {
         // If the caller is transfering ownership of a refcount, i.e., the
         // object is being moved from somewhere to this region, but the object
@@ -76,36 +181,54 @@ namespace verona::rt
 
     /**
      * Mark the given object. If the object is not in the set, incref and add it
-     * to the set.
+     * to the set. An object marked already since the last sweep is usually
+     * found in the MarkFilter, without a table lookup.
      */
     void mark(Object* o)
     {
       assert(o->debug_is_rc() || o->debug_is_shared());
 
-      auto r = hash_set->insert(o);
+      if (SNMALLOC_UNLIKELY(mark_filter == nullptr))
+        mark_filter = new (heap::alloc<sizeof(MarkFilter)>()) MarkFilter;
+
+      Object*& cached = mark_filter->slots[MarkFilter::index(o)];
+      if (cached == o)
+        return;
+
+      auto r = get_hash_set()->insert(o);
       if (r.first)
         o->incref();
 
       r.second.mark();
+      cached = o;
+    }
+
+    /**
+     * Apply `f` to every object in the set.
+     */
+    template<typename F>
+    void for_each(F&& f)
+    {
+      if (hash_set == nullptr)
+        return;
+
+      for (auto* e : *hash_set)
+        f(e);
     }
 
     /**
      * Erase all unmarked entries from the set and unmark the remaining entries.
+     * A table left mostly empty shrinks (see ObjectMap::sweep()).
      */
     void sweep()
     {
-      for (auto it = hash_set->begin(); it != hash_set->end(); ++it)
-      {
-        if (!it.is_marked())
-        {
-          RememberedSet::release_internal(*it);
-          hash_set->erase(it);
-        }
-        else
-        {
-          it.unmark();
-        }
-      }
+      drop_mark_filter();
+
+      // Sweeping visits every slot of the table, so skip an empty one.
+      if (remembered_size() == 0)
+        return;
+
+      hash_set->sweep(RememberedSet::release_internal);
     }
 
     /**
@@ -114,6 +237,10 @@ namespace verona::rt
      */
     void discard(bool release = true)
     {
+      drop_mark_filter();
+      if (hash_set == nullptr)
+        return;
+
       for (auto it = hash_set->begin(); it != hash_set->end(); ++it)
       {
         if (release)
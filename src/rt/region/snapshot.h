@@ -0,0 +1,363 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "../ds/hashmap.h"
+#include "../object/object.h"
+#include "region.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace verona::rt
+{
+  /**
+   * Snapshots of a region, or of a frozen graph of immutable objects, in a
+   * file, from which a process can bring back an equal region without
+   * rebuilding it.
+   *
+   * A snapshot is an image of the objects reachable from the root, the
+   * root first, laid out end to end as in an arena. Each keeps its header,
+   * with the descriptor replaced by the id it was registered under with
+   * register_descriptor(), as descriptors are at other addresses in
+   * another process. References between the objects hold their addresses
+   * in the image as it was written, which the file records, so that
+   * loading only has to look each one up among the objects it allocated.
+   *
+   * Fields are found as a moving collection finds them (see
+   * Object::relocate_fields()), so objects must be able to move, and must
+   * not refer to anything outside the snapshot but their own root:
+   * subregions, shared objects, and for a region, immutable objects, abort
+   * the save. Pointers to memory that is not an object are written as they
+   * are, and are meaningless when loaded.
+   *
+   * Loading copies each object into a new region, of any type that
+   * Region::clone() supports. A snapshot of an immutable graph loads as a
+   * region, which freeze() makes immutable again.
+   **/
+  class Snapshot
+  {
+    static constexpr char MAGIC[8] = {'V', 'R', 'S', 'N', 'A', 'P', '0', '1'};
+
+    struct FileHeader
+    {
+      char magic[sizeof(MAGIC)];
+      /// Object::Header size and alignment the image was laid out with.
+      uint64_t header_size;
+      uint64_t alignment;
+      /// Address of the image when it was written.
+      uint64_t base;
+      uint64_t size;
+      uint64_t objects;
+    };
+
+    using Map = ObjectMap<std::pair<Object*, Object*>>;
+
+    struct Registry
+    {
+      std::mutex m;
+      std::unordered_map<uint64_t, const Descriptor*> by_id;
+      std::unordered_map<const Descriptor*, uint64_t> by_desc;
+    };
+
+    static Registry& registry()
+    {
+      static Registry r;
+      return r;
+    }
+
+    /// Objects placed by the save or load in progress on this thread, for
+    /// the forward callback, which Descriptor::relocate gives no context
+    /// argument.
+    static inline thread_local Map* forward_map_ = nullptr;
+
+    static Object* forward(Object* field)
+    {
+      auto it = forward_map_->find(field);
+      if (it == forward_map_->end())
+        return field;
+      return it.value();
+    }
+
+    static bool id_of(const Descriptor* desc, uint64_t& id)
+    {
+      auto& r = registry();
+      std::lock_guard<std::mutex> lock(r.m);
+      auto it = r.by_desc.find(desc);
+      if (it == r.by_desc.end())
+        return false;
+      id = it->second;
+      return true;
+    }
+
+    static const Descriptor* desc_of(uint64_t id)
+    {
+      auto& r = registry();
+      std::lock_guard<std::mutex> lock(r.m);
+      auto it = r.by_id.find(id);
+      return it == r.by_id.end() ? nullptr : it->second;
+    }
+
+  public:
+    /**
+     * Register `desc` under `id`, which must name the same type in every
+     * process that writes or reads the snapshots. Registering an id or a
+     * descriptor twice, differently, aborts.
+     **/
+    static void register_descriptor(uint64_t id, const Descriptor* desc)
+    {
+      auto& r = registry();
+      std::lock_guard<std::mutex> lock(r.m);
+      auto [i, fresh_id] = r.by_id.emplace(id, desc);
+      auto [d, fresh_desc] = r.by_desc.emplace(desc, id);
+      if ((!fresh_id && i->second != desc) || (!fresh_desc && d->second != id))
+        abort();
+    }
+
+    template<typename T>
+    static void register_type(uint64_t id)
+    {
+      register_descriptor(id, T::desc());
+    }
+
+    /**
+     * Write a snapshot of the region represented by Iso object `o`, or of
+     * the immutable objects reachable from the immutable object `o`, to
+     * `path`. False if an object's descriptor is not registered, or the
+     * file cannot be written.
+     **/
+    static bool save(Object* o, const char* path)
+    {
+      bool frozen = !o->debug_is_iso();
+      assert(frozen ? o->debug_is_immutable() : true);
+
+      // Find the objects, the root first, and where they go in the image.
+      Map map(64);
+      std::vector<Object*> found;
+      std::vector<uint64_t> ids;
+      size_t size = 0;
+      ObjectStack grey;
+      grey.push(o);
+      while (!grey.empty())
+      {
+        Object* p = grey.pop();
+        if (!map.insert(std::make_pair(p, (Object*)nullptr)).first)
+          continue;
+
+        if (p != o)
+        {
+          switch (p->get_class())
+          {
+            case Object::UNMARKED:
+            case Object::MARKED:
+              if (frozen)
+                abort();
+              break;
+
+            case Object::RC:
+            case Object::SCC_PTR:
+              if (!frozen)
+                abort();
+              break;
+
+            default:
+              abort();
+          }
+        }
+
+        uint64_t id;
+        if (!id_of(p->get_descriptor(), id))
+          return false;
+
+        found.push_back(p);
+        ids.push_back(id);
+        size += snmalloc::bits::align_up(p->size(), Object::ALIGNMENT);
+        p->trace(grey);
+      }
+
+      // Lay the objects out, and point their fields at each other.
+      auto* image = (std::byte*)heap::alloc(size);
+      size_t offset = 0;
+      for (Object* p : found)
+      {
+        size_t sz = p->size();
+        Object* c =
+          Object::register_object(image + offset, p->get_descriptor());
+        c->get_header().bits = 0;
+        std::memcpy((void*)c, (void*)p, sz - sizeof(Object::Header));
+        map.find(p).value() = c;
+        offset += snmalloc::bits::align_up(sz, Object::ALIGNMENT);
+      }
+
+      forward_map_ = &map;
+      for (Object* p : found)
+        map.find(p).value()->relocate_fields(forward);
+      forward_map_ = nullptr;
+
+      for (size_t i = 0; i < found.size(); i++)
+        map.find(found[i]).value()->get_header().descriptor_bits = ids[i];
+
+      FileHeader h;
+      std::copy(MAGIC, MAGIC + sizeof(MAGIC), h.magic);
+      h.header_size = sizeof(Object::Header);
+      h.alignment = Object::ALIGNMENT;
+      h.base = (uint64_t)(uintptr_t)image;
+      h.size = size;
+      h.objects = found.size();
+
+      bool ok = false;
+      FILE* file = fopen(path, "wb");
+      if (file != nullptr)
+      {
+        ok = (fwrite(&h, sizeof(h), 1, file) == 1) &&
+          (fwrite(image, 1, size, file) == size);
+        ok = (fclose(file) == 0) && ok;
+      }
+      heap::dealloc(image, size);
+      return ok;
+    }
+
+    /**
+     * Bring back the snapshot at `path` as a new region of type `type`, and
+     * return its Iso. nullptr if the file cannot be read, was not written
+     * by a compatible build, or names a descriptor not registered.
+     **/
+    static Object* load(const char* path, RegionType type)
+    {
+      FILE* file = fopen(path, "rb");
+      if (file == nullptr)
+        return nullptr;
+
+      FileHeader h;
+      if (
+        fread(&h, sizeof(h), 1, file) != 1 ||
+        !std::equal(h.magic, h.magic + sizeof(h.magic), MAGIC) ||
+        h.header_size != sizeof(Object::Header) ||
+        h.alignment != Object::ALIGNMENT || h.objects == 0 ||
+        h.size % Object::ALIGNMENT != 0)
+      {
+        fclose(file);
+        return nullptr;
+      }
+
+      auto* image = (std::byte*)heap::alloc(h.size);
+      bool ok = fread(image, 1, h.size, file) == h.size;
+      fclose(file);
+
+      // Check every object before allocating any.
+      std::vector<const Descriptor*> descs;
+      size_t offset = 0;
+      size_t bytes = 0;
+      while (ok && offset < h.size)
+      {
+        auto* header = (Object::Header*)(image + offset);
+        const Descriptor* desc = desc_of(header->descriptor_bits);
+        if (
+          desc == nullptr || h.size - offset < desc->size ||
+          (descs.empty() && desc->tail != 0))
+        {
+          ok = false;
+          break;
+        }
+        size_t tail = 0;
+        if (desc->tail != 0)
+          tail = *(size_t*)(image + offset + sizeof(Object::Header));
+        size_t sz = snmalloc::bits::align_up(
+          Object::size_of(desc, tail), Object::ALIGNMENT);
+        if (h.size - offset < sz)
+        {
+          ok = false;
+          break;
+        }
+        descs.push_back(desc);
+        bytes += sz;
+        offset += sz;
+      }
+      ok = ok && (descs.size() == h.objects);
+
+      Object* n = nullptr;
+      if (ok)
+      {
+        switch (type)
+        {
+          case RegionType::Trace:
+            n = load_as<RegionTrace>(h, image, descs, bytes);
+            break;
+          case RegionType::Arena:
+            n = load_as<RegionArena>(h, image, descs, bytes);
+            break;
+          case RegionType::SemiSpace:
+            n = load_as<RegionSemiSpace>(h, image, descs, bytes);
+            break;
+          default:
+            abort();
+        }
+      }
+      heap::dealloc(image, h.size);
+      return n;
+    }
+
+  private:
+    /**
+     * Copy the objects of the checked image, of the snapshot described by
+     * `h`, into a new region of type R, and point their fields at each
+     * other, as Region::clone() does.
+     **/
+    template<typename R>
+    static Object* load_as(
+      const FileHeader& h,
+      std::byte* image,
+      const std::vector<const Descriptor*>& descs,
+      size_t bytes)
+    {
+      Object* n = R::create(descs[0]);
+      Object* root = Object::object_start(image);
+      size_t body = descs[0]->size - sizeof(Object::Header);
+
+      // Growing the space collects the region, tracing its Iso.
+      if constexpr (std::is_same_v<R, RegionSemiSpace>)
+      {
+        std::memset((void*)n, 0, body);
+        R::ensure_available(n, bytes);
+      }
+      std::memcpy((void*)n, (void*)root, body);
+
+      // The objects are looked up by their address when the file was
+      // written.
+      Map map(descs.size());
+      std::vector<Object*> loaded;
+      loaded.push_back(n);
+      auto key = [&h, image](std::byte* p) {
+        return (Object*)(uintptr_t)(h.base + (uint64_t)(p - image));
+      };
+      map.insert(std::make_pair(key((std::byte*)root), n));
+
+      size_t offset = snmalloc::bits::align_up(
+        descs[0]->size, Object::ALIGNMENT);
+      for (size_t i = 1; i < descs.size(); i++)
+      {
+        const Descriptor* d = descs[i];
+        Object* p = Object::object_start(image + offset);
+        size_t tail = d->tail != 0 ? *reinterpret_cast<size_t*>(p) : 0;
+        size_t sz = Object::size_of(d, tail);
+        Object* c = R::alloc(n, d, tail);
+        std::memcpy((void*)c, (void*)p, sz - sizeof(Object::Header));
+        map.insert(std::make_pair(key((std::byte*)p), c));
+        loaded.push_back(c);
+        offset += snmalloc::bits::align_up(sz, Object::ALIGNMENT);
+      }
+
+      forward_map_ = &map;
+      for (Object* c : loaded)
+        c->relocate_fields(forward);
+      forward_map_ = nullptr;
+
+      return n;
+    }
+  };
+} // namespace verona::rt
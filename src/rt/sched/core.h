@@ -16,7 +16,13 @@ namespace verona::rt
   {
   public:
     size_t affinity = 0;
+    /// Cores with the same `socket` are in the same package and NUMA node.
+    size_t socket = 0;
+    /// Cores with the same `cache` share a last-level cache.
+    size_t cache = 0;
     WorkStealingQueue<4> q;
+    /// Work of Priority::Low.
+    WorkStealingQueue<4> low_q;
     std::atomic<Core*> next{nullptr};
 
     std::atomic<bool> should_steal_for_fairness{true};
@@ -43,7 +49,23 @@ namespace verona::rt
     SchedulerStats stats;
 
   public:
-    Core() : q{} {}
+    /// Number of levels distance() can return.
+    static constexpr size_t DISTANCES = 3;
+
+    Core() : q{}, low_q{} {}
+
+    /**
+     * How far `that` is from this core: 0 if they share a last-level
+     * cache, 1 if they are in the same socket, and 2 otherwise.
+     */
+    size_t distance(const Core* that) const
+    {
+      if (cache == that->cache)
+        return 0;
+      if (socket == that->socket)
+        return 1;
+      return 2;
+    }
 
     ~Core()
     {
@@ -28,9 +28,22 @@ namespace verona::rt
   public:
     constexpr CorePool() = default;
 
-    void init(size_t count)
+    /**
+     * How many threads the process can keep running at once (see
+     * Topology::available()).
+     */
+    static size_t available()
+    {
+      return topology.get().available();
+    }
+
+    void init(
+      size_t count,
+      Topology::Placement placement = Topology::Placement::Scatter,
+      size_t socket = 0)
     {
       core_count = count;
+      topology.get().place(placement, socket);
       // TODO mjp: review allocation.
       first_core = new Core;
       Core* t = first_core;
@@ -38,6 +51,8 @@ namespace verona::rt
       while (true)
       {
         t->affinity = topology.get().get(count);
+        t->socket = topology.get().socket(count);
+        t->cache = topology.get().cache(count);
         if (count > 1)
         {
           t->next = new Core;
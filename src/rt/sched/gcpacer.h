@@ -0,0 +1,196 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "work.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <snmalloc/snmalloc.h>
+#include <vector>
+
+namespace verona::rt
+{
+  /**
+   * Paces the region collections asked for on a scheduler thread (see
+   * schedule_paced_collect()), so that when many regions cross their
+   * thresholds in the same burst, their pauses do not all land on the
+   * thread at once.
+   *
+   * Each scheduler thread has its own pacer, with a budget of CPU time for
+   * collections: a share of wall time set with set_budget(), which builds
+   * up as credit to at most MAX_CREDIT cycles. A request is queued with the
+   * bytes it is expected to reclaim and the cycles it is expected to take,
+   * estimated from the cycles per KiB that collections have taken so far
+   * (see record()). The thread lets queued collections through, the most
+   * reclaimed bytes per cycle first, while it has credit, and charges each
+   * its estimate. While the core has a backlog of runnable work it holds
+   * them back, for at most MAX_DEFER cycles at a time, and a thread that
+   * runs out of work, or is under memory pressure (see MemoryPressure),
+   * lets them all through whatever its credit.
+   *
+   * Work let through is put on the thread's low priority queue. Pacing is
+   * off, with a budget of 0, by default.
+   */
+  class GCPacer
+  {
+  public:
+    /// Cycles of credit a pacer may build up.
+    static constexpr uint64_t MAX_CREDIT = 10'000'000;
+
+    /// Longest a backlog holds back collections that the budget allows.
+    static constexpr uint64_t MAX_DEFER = 100'000'000;
+
+    /// Estimated cost of any collection, on top of its bytes.
+    static constexpr uint64_t FIXED_CYCLES = 10'000;
+
+    /// Cycles per KiB assumed before any collection has been recorded.
+    static constexpr uint64_t DEFAULT_CYCLES_PER_KIB = 2'000;
+
+  private:
+    struct Request
+    {
+      Work* work;
+      /// Bytes expected to be reclaimed per 1024 cycles.
+      uint64_t score;
+      uint64_t estimate;
+
+      bool operator<(const Request& that) const
+      {
+        return score < that.score;
+      }
+    };
+
+    /// Queued requests, as a heap with the best first.
+    std::vector<Request> requests;
+
+    int64_t credit = (int64_t)MAX_CREDIT;
+    uint64_t refilled_at = 0;
+
+    /// When the current backlog started holding collections back, or 0.
+    uint64_t deferring_since = 0;
+
+    static inline std::atomic<size_t> budget_percent_{0};
+    static inline std::atomic<uint64_t> cycles_per_kib_{
+      DEFAULT_CYCLES_PER_KIB};
+
+    void refill()
+    {
+      uint64_t now = Aal::tick();
+      if (refilled_at != 0)
+      {
+        uint64_t gain = (now - refilled_at) * get_budget() / 100;
+        credit = (int64_t)std::min<uint64_t>(
+          MAX_CREDIT, (uint64_t)std::max<int64_t>(credit, 0) + gain);
+      }
+      refilled_at = now;
+    }
+
+    Work* pop()
+    {
+      std::pop_heap(requests.begin(), requests.end());
+      Request r = requests.back();
+      requests.pop_back();
+      credit -= (int64_t)r.estimate;
+      return r.work;
+    }
+
+  public:
+    /**
+     * Set the share of wall time, in percent, that collections let through
+     * by each pacer may take. 0 turns pacing off, and collections are
+     * scheduled as soon as they are asked for.
+     */
+    static void set_budget(size_t percent)
+    {
+      budget_percent_.store(
+        std::min<size_t>(percent, 100), std::memory_order_relaxed);
+    }
+
+    static size_t get_budget()
+    {
+      return budget_percent_.load(std::memory_order_relaxed);
+    }
+
+    static GCPacer& local()
+    {
+      static thread_local GCPacer pacer;
+      return pacer;
+    }
+
+    /// Estimated cycles to collect a region using `bytes`.
+    static uint64_t estimate(size_t bytes)
+    {
+      return FIXED_CYCLES +
+        (bytes * cycles_per_kib_.load(std::memory_order_relaxed)) / 1024;
+    }
+
+    /**
+     * Record that collecting a region of `bytes` took `cycles`, to refine
+     * the estimates.
+     */
+    static void record(size_t bytes, uint64_t cycles)
+    {
+      uint64_t sample = cycles * 1024 / std::max<size_t>(bytes, 1024);
+      uint64_t avg = cycles_per_kib_.load(std::memory_order_relaxed);
+      cycles_per_kib_.store(
+        avg + (sample / 8) - (avg / 8), std::memory_order_relaxed);
+    }
+
+    bool empty() const
+    {
+      return requests.empty();
+    }
+
+    /**
+     * Queue `w`, a collection of a region using `bytes`, of which
+     * `reclaimable` are expected to be garbage.
+     */
+    void request(Work* w, size_t reclaimable, size_t bytes)
+    {
+      uint64_t cost = estimate(bytes);
+      requests.push_back({w, (uint64_t)reclaimable * 1024 / cost, cost});
+      std::push_heap(requests.begin(), requests.end());
+    }
+
+    /**
+     * The next collection to let through, or nullptr if there is none the
+     * budget allows yet. `backlog` is whether the core has runnable work
+     * waiting.
+     */
+    Work* take(bool backlog)
+    {
+      if (requests.empty())
+        return nullptr;
+
+      refill();
+      if (backlog)
+      {
+        if (deferring_since == 0)
+          deferring_since = refilled_at;
+        if (refilled_at - deferring_since < MAX_DEFER)
+          return nullptr;
+      }
+      deferring_since = 0;
+
+      if (credit <= 0)
+        return nullptr;
+      return pop();
+    }
+
+    /**
+     * The next collection, whatever the budget, for a thread with nothing
+     * else to do, or nullptr if there is none.
+     */
+    Work* take_idle()
+    {
+      if (requests.empty())
+        return nullptr;
+
+      refill();
+      deferring_since = 0;
+      return pop();
+    }
+  };
+} // namespace verona::rt
@@ -0,0 +1,52 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "work.h"
+
+#include <atomic>
+
+namespace verona::rt
+{
+  /**
+   * Work held back until a scheduler thread has nothing else to do, such
+   * as the collection of regions whose cowns have gone quiet (see
+   * schedule_idle_collect()).
+   *
+   * A thread that runs out of work, before it pauses, moves everything
+   * held here onto its low priority queue. Work is linked through
+   * next_in_queue, which is free until then.
+   */
+  class IdleWork
+  {
+    static std::atomic<Work*>& pending()
+    {
+      static std::atomic<Work*> head{nullptr};
+      return head;
+    }
+
+  public:
+    static void push(Work* w)
+    {
+      auto& head = pending();
+      Work* h = head.load(std::memory_order_relaxed);
+      do
+      {
+        w->next_in_queue.store(h, std::memory_order_relaxed);
+      } while (!head.compare_exchange_weak(
+        h, w, std::memory_order_release, std::memory_order_relaxed));
+    }
+
+    /**
+     * Take everything held, as a list linked through next_in_queue, or
+     * nullptr if there is nothing.
+     */
+    static Work* take_all()
+    {
+      auto& head = pending();
+      if (head.load(std::memory_order_relaxed) == nullptr)
+        return nullptr;
+      return head.exchange(nullptr, std::memory_order_acquire);
+    }
+  };
+} // namespace verona::rt
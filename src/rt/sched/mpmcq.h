@@ -2,6 +2,8 @@
 // SPDX-License-Identifier: MIT
 #pragma once
 
+#include "../pal/cache_line.h"
+
 namespace verona::rt
 {
   /**
@@ -30,11 +32,14 @@ namespace verona::rt
   private:
     using NextPtr = std::atomic<T*>;
 
-    std::atomic<NextPtr*> back{&front};
+    // Producers only touch `back` and consumers mostly `front`, so each has
+    // a cache line to itself, and enqueues do not slow down dequeues on
+    // another core, or the reverse.
+    alignas(CACHE_LINE) std::atomic<NextPtr*> back{&front};
 
     // Multi-threaded end of the "queue".
     // Used for work stealing and dequeue individual items.
-    NextPtr front{nullptr};
+    alignas(CACHE_LINE) NextPtr front{nullptr};
 
     // Common function that is used to make the queue appear empty to any other
     // dequeue or dequeue_all operations.
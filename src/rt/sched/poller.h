@@ -0,0 +1,286 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+
+#if defined(__linux__)
+#  include <cerrno>
+#  include <sys/epoll.h>
+#  include <sys/eventfd.h>
+#  include <unistd.h>
+#endif
+
+namespace verona::rt
+{
+  /**
+   * Readiness of file descriptors, polled by the scheduler threads
+   * themselves, rather than by I/O threads that hand events over.
+   *
+   * A scheduler thread with nothing to run polls before it looks any
+   * further for work. While sources are registered, one paused thread at a
+   * time waits in the poller rather than on its semaphore, so readiness
+   * wakes it directly, and waking it for new work interrupts the wait (see
+   * ThreadSync). A ready source has its `ready` called on the thread that
+   * saw it, which schedules the work for it there, on that thread's core.
+   *
+   * Sources are one-shot. Once `ready` has been called, a source is not
+   * polled again until it is rearm()ed. So the work for one event can
+   * rearm or remove its source without racing with another event for it.
+   * While any source is registered the runtime does not finish.
+   *
+   * This is built on epoll, and so is only supported on Linux. Elsewhere,
+   * is_supported() is false and add() aborts.
+   */
+  class FdPoller
+  {
+  public:
+    /// Readiness to wait for, and that was seen.
+    static constexpr uint32_t READABLE = 1;
+    static constexpr uint32_t WRITABLE = 2;
+    /// Seen only: the other end hung up, or an error is pending.
+    static constexpr uint32_t CLOSED = 4;
+
+    struct Source
+    {
+      int fd;
+      /// READABLE, WRITABLE, or both.
+      uint32_t interest;
+      /// Called on a scheduler thread with what the source is ready for.
+      void (*ready)(Source* self, uint32_t events);
+    };
+
+  private:
+    /// Sources registered.
+    static inline std::atomic<size_t> sources{0};
+
+    /// Whether a paused thread is waiting in the poller.
+    static inline std::atomic<bool> waiting{false};
+
+#if defined(__linux__)
+    /// Most events taken in one call.
+    static constexpr int BATCH = 64;
+
+    struct Fds
+    {
+      int epoll;
+      /// Written by interrupt(), and polled with no Source.
+      int interrupt;
+
+      Fds()
+      {
+        epoll = epoll_create1(EPOLL_CLOEXEC);
+        interrupt = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        if ((epoll < 0) || (interrupt < 0))
+          abort();
+
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.ptr = nullptr;
+        if (epoll_ctl(epoll, EPOLL_CTL_ADD, interrupt, &ev) != 0)
+          abort();
+      }
+    };
+
+    static Fds& fds()
+    {
+      static Fds f;
+      return f;
+    }
+
+    static epoll_event to_epoll(Source* s)
+    {
+      epoll_event ev{};
+      ev.events = EPOLLONESHOT;
+      if ((s->interest & READABLE) != 0)
+        ev.events |= EPOLLIN;
+      if ((s->interest & WRITABLE) != 0)
+        ev.events |= EPOLLOUT;
+      ev.data.ptr = s;
+      return ev;
+    }
+
+    static uint32_t from_epoll(uint32_t events)
+    {
+      uint32_t result = 0;
+      if ((events & EPOLLIN) != 0)
+        result |= READABLE;
+      if ((events & EPOLLOUT) != 0)
+        result |= WRITABLE;
+      if ((events & (EPOLLHUP | EPOLLRDHUP | EPOLLERR)) != 0)
+        result |= CLOSED;
+      return result;
+    }
+
+    /**
+     * Wait up to `timeout_ms` for events, and call `ready` for the sources
+     * among them. Returns how many sources were ready, and sets
+     * `interrupted` if interrupt() was called, taking the interrupt if
+     * `take_interrupt`.
+     */
+    static size_t
+    wait_for(int timeout_ms, bool take_interrupt, bool& interrupted)
+    {
+      epoll_event events[BATCH];
+      int n = epoll_wait(fds().epoll, events, BATCH, timeout_ms);
+      if (n < 0)
+      {
+        if (errno == EINTR)
+          return 0;
+        abort();
+      }
+
+      size_t count = 0;
+      for (int i = 0; i < n; i++)
+      {
+        auto* s = static_cast<Source*>(events[i].data.ptr);
+        if (s == nullptr)
+        {
+          interrupted = true;
+          uint64_t value;
+          if (take_interrupt)
+            (void)!read(fds().interrupt, &value, sizeof(value));
+          continue;
+        }
+
+        s->ready(s, from_epoll(events[i].events));
+        count++;
+      }
+      return count;
+    }
+#endif
+
+  public:
+    static constexpr bool is_supported()
+    {
+#if defined(__linux__)
+      return true;
+#else
+      return false;
+#endif
+    }
+
+    /**
+     * Start polling `s`, which must stay valid until it is removed.
+     */
+    static void add(Source* s)
+    {
+#if defined(__linux__)
+      auto ev = to_epoll(s);
+      if (epoll_ctl(fds().epoll, EPOLL_CTL_ADD, s->fd, &ev) != 0)
+        abort();
+      sources.fetch_add(1, std::memory_order_seq_cst);
+#else
+      (void)s;
+      abort();
+#endif
+    }
+
+    /**
+     * Poll `s` again, after its `ready` has been called.
+     */
+    static void rearm(Source* s)
+    {
+#if defined(__linux__)
+      auto ev = to_epoll(s);
+      if (epoll_ctl(fds().epoll, EPOLL_CTL_MOD, s->fd, &ev) != 0)
+        abort();
+#else
+      (void)s;
+#endif
+    }
+
+    /**
+     * Stop polling `s`. It must not be armed, so this is called once its
+     * `ready` has been called and before it is rearmed.
+     */
+    static void remove(Source* s)
+    {
+#if defined(__linux__)
+      epoll_ctl(fds().epoll, EPOLL_CTL_DEL, s->fd, nullptr);
+      sources.fetch_sub(1, std::memory_order_seq_cst);
+#else
+      (void)s;
+#endif
+    }
+
+    static size_t get_sources()
+    {
+      return sources.load(std::memory_order_seq_cst);
+    }
+
+    /**
+     * Call `ready` for the sources that are ready now, without waiting.
+     * Returns how many were.
+     */
+    static size_t poll()
+    {
+#if defined(__linux__)
+      if (get_sources() == 0)
+        return 0;
+
+      // An interrupt is left for the thread waiting in the poller.
+      bool interrupted = false;
+      return wait_for(0, false, interrupted);
+#else
+      return 0;
+#endif
+    }
+
+    /**
+     * Become the thread that waits in the poller, if sources are registered
+     * and no other thread is. Give it up with release_wait().
+     */
+    static bool try_claim_wait()
+    {
+      return (get_sources() != 0) &&
+        !waiting.exchange(true, std::memory_order_acquire);
+    }
+
+    static void release_wait()
+    {
+      waiting.store(false, std::memory_order_release);
+    }
+
+    /**
+     * As the thread that claimed it, wait until interrupt() is called, for
+     * at most `timeout_ns` unless that is 0, calling `ready` for the sources
+     * that are ready meanwhile. Returns whether it was interrupted.
+     */
+    static bool wait(uint64_t timeout_ns)
+    {
+#if defined(__linux__)
+      int timeout_ms = -1;
+      if (timeout_ns != 0)
+      {
+        // Rounded up, so as not to wake before a timer is due.
+        uint64_t ms = (timeout_ns + 999'999) / 1'000'000;
+        timeout_ms = ms > INT32_MAX ? INT32_MAX : (int)ms;
+      }
+
+      bool interrupted = false;
+      // Return once something has happened.
+      while ((wait_for(timeout_ms, true, interrupted) == 0) && !interrupted &&
+             (timeout_ms < 0))
+        ;
+      return interrupted;
+#else
+      (void)timeout_ns;
+      return true;
+#endif
+    }
+
+    /**
+     * Wake the thread waiting in the poller.
+     */
+    static void interrupt()
+    {
+#if defined(__linux__)
+      uint64_t one = 1;
+      (void)!write(fds().interrupt, &one, sizeof(one));
+#endif
+    }
+  };
+} // namespace verona::rt
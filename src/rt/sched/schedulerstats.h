@@ -2,6 +2,12 @@
 // SPDX-License-Identifier: MIT
 #pragma once
 
+#include "../util/latency_histogram.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
 #include <iostream>
 #include <snmalloc/snmalloc.h>
 
@@ -35,17 +41,125 @@ namespace verona::rt
     }
   };
 
+  /**
+   * Counts of what the scheduler threads of a core do, and with
+   * USE_SCHED_STATS histograms, in ticks, of how long work waits in a
+   * queue before it runs, how long it runs, how long threads stay paused,
+   * and how long a thread with no work searches before it steals some.
+   * Without USE_SCHED_STATS nothing is counted.
+   *
+   * Every core has its own, which its threads add to with relaxed atomics.
+   * They are merged into the global one as the cores are torn down, and
+   * dumped as CSV, but snapshot() (and ThreadPool::stats_snapshot()) can
+   * read them at any time while the pool runs.
+   */
   class SchedulerStats
   {
+  public:
+    using LatencyHistogram = api::LatencyHistogram;
+
+    /// What a SchedulerStats has counted, as of a snapshot().
+    struct Snapshot
+    {
+      size_t steals = 0;
+      size_t pauses = 0;
+      size_t unpauses = 0;
+      size_t lifo = 0;
+      size_t cowns = 0;
+      size_t batches = 0;
+      /// Threads retired, and woken from retirement, by an elastic pool.
+      size_t retires = 0;
+      size_t unretires = 0;
+      /// Steals for fairness, and the behaviours a thread ran between
+      /// one and the one before: in total, squared and at most.
+      size_t fair_passes = 0;
+      size_t fair_gap_total = 0;
+      size_t fair_gap_squares = 0;
+      size_t fair_gap_max = 0;
+      /// Behaviours created, by number of cowns; the last counts the rest.
+      std::array<size_t, 16> behaviours{};
+      /// From work being scheduled to it starting to run.
+      LatencyHistogram queue_wait;
+      /// From work starting to run to it finishing.
+      LatencyHistogram run_time;
+      /// From a thread pausing to it waking.
+      LatencyHistogram pause_time;
+      /// From a thread running out of work to it stealing some.
+      LatencyHistogram steal_latency;
+
+      Snapshot& operator+=(const Snapshot& that)
+      {
+        steals += that.steals;
+        pauses += that.pauses;
+        unpauses += that.unpauses;
+        lifo += that.lifo;
+        cowns += that.cowns;
+        batches += that.batches;
+        retires += that.retires;
+        unretires += that.unretires;
+        fair_passes += that.fair_passes;
+        fair_gap_total += that.fair_gap_total;
+        fair_gap_squares += that.fair_gap_squares;
+        fair_gap_max = std::max(fair_gap_max, that.fair_gap_max);
+        for (size_t i = 0; i < behaviours.size(); i++)
+          behaviours[i] += that.behaviours[i];
+        queue_wait.merge(that.queue_wait);
+        run_time.merge(that.run_time);
+        pause_time.merge(that.pause_time);
+        steal_latency.merge(that.steal_latency);
+        return *this;
+      }
+
+      /// Mean of the behaviours run between steals for fairness.
+      double fair_gap_mean() const
+      {
+        return fair_passes == 0 ? 0.0 : (double)fair_gap_total / fair_passes;
+      }
+
+      /// Variance of the behaviours run between steals for fairness. The
+      /// higher it is, the longer some work waits for its turn.
+      double fair_gap_variance() const
+      {
+        if (fair_passes == 0)
+          return 0.0;
+        double mean = fair_gap_mean();
+        return ((double)fair_gap_squares / fair_passes) - (mean * mean);
+      }
+    };
+
   private:
 #ifdef USE_SCHED_STATS
     std::atomic<size_t> steal_count{0};
+    // Steals by distance to the victim: shared cache, socket, remote.
+    std::array<std::atomic<size_t>, 3> steal_distance_count{};
     std::atomic<size_t> pause_count{0};
     std::atomic<size_t> unpause_count{0};
     std::atomic<size_t> lifo_count{0};
     std::array<std::atomic<size_t>, 16> behaviour_count{};
     std::atomic<size_t> cown_count{0};
+    // Batch lengths chosen by the scheduler thread (see
+    // ThreadPool::set_time_slice()).
+    std::atomic<size_t> batch_count{0};
+    std::atomic<size_t> batch_total{0};
+    std::atomic<size_t> batch_max{0};
+    // Threads retired and woken by an elastic pool (see
+    // ThreadPool::set_elastic()).
+    std::atomic<size_t> retire_count{0};
+    std::atomic<size_t> unretire_count{0};
+    // Steals for fairness (see ThreadPool::set_fair_quantum()), and the
+    // behaviours run between them.
+    std::atomic<size_t> fair_count{0};
+    std::atomic<size_t> fair_total{0};
+    std::atomic<size_t> fair_squares{0};
+    std::atomic<size_t> fair_max{0};
+    api::ConcurrentLatencyHistogram queue_wait_ticks;
+    api::ConcurrentLatencyHistogram run_ticks;
+    api::ConcurrentLatencyHistogram pause_ticks;
+    api::ConcurrentLatencyHistogram steal_ticks;
 #endif
+    /// Steals in the last dump of the global statistics.
+    static inline std::atomic<size_t> last_steals{0};
+
   public:
     ~SchedulerStats()
 #ifdef USE_SCHED_STATS
@@ -63,10 +177,13 @@ namespace verona::rt
       = default;
 #endif
 
-    void steal()
+    /// Count a steal from a core `distance` away (see Core::distance()).
+    void steal(size_t distance)
     {
+      UNUSED(distance);
 #ifdef USE_SCHED_STATS
       steal_count++;
+      steal_distance_count[distance]++;
 #endif
     }
 
@@ -109,19 +226,146 @@ namespace verona::rt
 #endif
     }
 
+    /// Count a batch of up to `length` behaviours.
+    void batch(size_t length)
+    {
+      UNUSED(length);
+#ifdef USE_SCHED_STATS
+      batch_count++;
+      batch_total += length;
+      if (length > batch_max)
+        batch_max = length;
+#endif
+    }
+
+    /// A thread of an elastic pool retired.
+    void retire()
+    {
+#ifdef USE_SCHED_STATS
+      retire_count++;
+#endif
+    }
+
+    /// A thread of an elastic pool woke a retired one.
+    void unretire()
+    {
+#ifdef USE_SCHED_STATS
+      unretire_count++;
+#endif
+    }
+
+    /// A thread stole for fairness, having run `behaviours` behaviours
+    /// since it last did.
+    void fair_pass(size_t behaviours)
+    {
+      UNUSED(behaviours);
+#ifdef USE_SCHED_STATS
+      fair_count++;
+      fair_total += behaviours;
+      fair_squares += behaviours * behaviours;
+      if (behaviours > fair_max)
+        fair_max = behaviours;
+#endif
+    }
+
+    /// Work scheduled `ticks` ago starts to run.
+    void queue_wait(uint64_t ticks)
+    {
+      UNUSED(ticks);
+#ifdef USE_SCHED_STATS
+      queue_wait_ticks.record(ticks);
+#endif
+    }
+
+    /// Work ran for `ticks`.
+    void run(uint64_t ticks)
+    {
+      UNUSED(ticks);
+#ifdef USE_SCHED_STATS
+      run_ticks.record(ticks);
+#endif
+    }
+
+    /// A thread was paused for `ticks`.
+    void paused(uint64_t ticks)
+    {
+      UNUSED(ticks);
+#ifdef USE_SCHED_STATS
+      pause_ticks.record(ticks);
+#endif
+    }
+
+    /// A thread searched for `ticks` before it stole work.
+    void steal_latency(uint64_t ticks)
+    {
+      UNUSED(ticks);
+#ifdef USE_SCHED_STATS
+      steal_ticks.record(ticks);
+#endif
+    }
+
+    /**
+     * What has been counted since the last dump. Safe while the threads of
+     * the core add to it, though the counts may then be slightly out of
+     * step with each other. Empty without USE_SCHED_STATS.
+     */
+    Snapshot snapshot() const
+    {
+      Snapshot s;
+#ifdef USE_SCHED_STATS
+      s.steals = steal_count;
+      s.pauses = pause_count;
+      s.unpauses = unpause_count;
+      s.lifo = lifo_count;
+      s.cowns = cown_count;
+      s.batches = batch_count;
+      s.retires = retire_count;
+      s.unretires = unretire_count;
+      s.fair_passes = fair_count;
+      s.fair_gap_total = fair_total;
+      s.fair_gap_squares = fair_squares;
+      s.fair_gap_max = fair_max;
+      for (size_t i = 0; i < behaviour_count.size(); i++)
+        s.behaviours[i] = behaviour_count[i];
+      queue_wait_ticks.snapshot(s.queue_wait);
+      run_ticks.snapshot(s.run_time);
+      pause_ticks.snapshot(s.pause_time);
+      steal_ticks.snapshot(s.steal_latency);
+#endif
+      return s;
+    }
+
     void add(SchedulerStats& that)
     {
       UNUSED(that);
 
 #ifdef USE_SCHED_STATS
       steal_count += that.steal_count;
+      for (size_t i = 0; i < steal_distance_count.size(); i++)
+        steal_distance_count[i] += that.steal_distance_count[i];
       pause_count += that.pause_count;
       unpause_count += that.unpause_count;
       lifo_count += that.lifo_count;
       cown_count += that.cown_count;
+      batch_count += that.batch_count;
+      batch_total += that.batch_total;
+      if (that.batch_max > batch_max)
+        batch_max = that.batch_max.load();
+      retire_count += that.retire_count;
+      unretire_count += that.unretire_count;
+      fair_count += that.fair_count;
+      fair_total += that.fair_total;
+      fair_squares += that.fair_squares;
+      if (that.fair_max > fair_max)
+        fair_max = that.fair_max.load();
 
       for (size_t i = 0; i < behaviour_count.size(); i++)
         behaviour_count[i] += that.behaviour_count[i];
+
+      queue_wait_ticks.merge(that.queue_wait_ticks);
+      run_ticks.merge(that.run_ticks);
+      pause_ticks.merge(that.pause_ticks);
+      steal_ticks.merge(that.steal_ticks);
 #endif
     }
 
@@ -141,29 +385,75 @@ namespace verona::rt
             << "Tag"
             << "DumpID"
             << "Steal"
+            << "Steal cache"
+            << "Steal socket"
+            << "Steal remote"
             << "LIFO"
             << "Pause"
             << "Unpause"
-            << "Cown count";
+            << "Cown count"
+            << "Batches"
+            << "Batch mean"
+            << "Batch max"
+            << "Retire"
+            << "Unretire"
+            << "Fair passes"
+            << "Fair gap mean"
+            << "Fair gap stddev"
+            << "Fair gap max";
 
         for (size_t i = 0; i < behaviour_count.size(); i++)
           csv << i;
 
+        for (auto name : {"Queue wait", "Run", "Pause", "Steal latency"})
+        {
+          for (auto p : {"p50", "p99", "max"})
+            csv << std::string(name) + " " + p;
+        }
+
         csv << std::endl;
       }
 
-      csv << "SchedulerStats" << get_tag() << dumpid << steal_count
-          << lifo_count << pause_count << unpause_count << cown_count;
+      csv << "SchedulerStats" << get_tag() << dumpid << steal_count;
+      for (size_t i = 0; i < steal_distance_count.size(); i++)
+        csv << steal_distance_count[i];
+      csv << lifo_count << pause_count << unpause_count << cown_count;
+      csv << batch_count << (batch_count == 0 ? 0 : batch_total / batch_count)
+          << batch_max;
+      csv << retire_count << unretire_count;
+      Snapshot s = snapshot();
+      csv << fair_count << s.fair_gap_mean()
+          << std::sqrt(std::max(s.fair_gap_variance(), 0.0)) << fair_max;
 
       for (size_t i = 0; i < behaviour_count.size(); i++)
         csv << behaviour_count[i];
+
+      for (auto* h :
+           {&queue_wait_ticks, &run_ticks, &pause_ticks, &steal_ticks})
+      {
+        LatencyHistogram ticks;
+        h->snapshot(ticks);
+        csv << ticks.percentile(50) << ticks.percentile(99) << ticks.max();
+        h->reset();
+      }
       csv << std::endl;
 
       steal_count = 0;
+      for (size_t i = 0; i < steal_distance_count.size(); i++)
+        steal_distance_count[i] = 0;
       pause_count = 0;
       unpause_count = 0;
       lifo_count = 0;
       cown_count = 0;
+      batch_count = 0;
+      batch_total = 0;
+      batch_max = 0;
+      retire_count = 0;
+      unretire_count = 0;
+      fair_count = 0;
+      fair_total = 0;
+      fair_squares = 0;
+      fair_max = 0;
 
       for (size_t i = 0; i < behaviour_count.size(); i++)
         behaviour_count[i] = 0;
@@ -173,10 +463,21 @@ namespace verona::rt
     static void dump_global(std::ostream& o, uint64_t dumpid)
     {
 #ifdef USE_SCHED_STATS
+      last_steals = get_global().steal_count.load();
       get_global().dump(o, dumpid);
 #endif
     }
 
+    /**
+     * Steals counted since the previous dump_global(), as of the last one,
+     * which the thread pool makes as it shuts down. So after a run, the
+     * steals of that run. Always 0 without USE_SCHED_STATS.
+     */
+    static size_t get_last_steal_count()
+    {
+      return last_steals.load();
+    }
+
     static SchedulerStats& get_global()
     {
       static SchedulerStats global;
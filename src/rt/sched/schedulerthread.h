@@ -2,15 +2,30 @@
 // SPDX-License-Identifier: MIT
 #pragma once
 
+#include "../boc/behaviourpool.h"
+#include "../boc/bias.h"
+#include "../boc/cownpool.h"
+#include "../boc/fusion.h"
+#include "../debug/eventtrace.h"
 #include "../debug/systematic.h"
+#include "../ds/chunk_cache.h"
+#include "../pal/memory_pressure.h"
+#include "../region/immutable.h"
+#include "../region/region.h"
+#include "../util/live_metrics.h"
 #include "core.h"
+#include "gcpacer.h"
+#include "idlework.h"
 #include "ds/dllist.h"
 #include "ds/hashmap.h"
 #include "mpmcq.h"
+#include "poller.h"
 #include "schedulerlist.h"
 #include "schedulerstats.h"
 #include "threadpool.h"
+#include "timerwheel.h"
 
+#include <algorithm>
 #include <snmalloc/snmalloc.h>
 
 namespace verona::rt
@@ -40,6 +55,7 @@ namespace verona::rt
     friend DLList<SchedulerThread>;
     friend SchedulerList<SchedulerThread>;
 
+    /// Default for ThreadPool::set_spin_before_park().
     static constexpr uint64_t TSC_QUIESCENCE_TIMEOUT = 1'000'000;
 
     Core* core = nullptr;
@@ -53,10 +69,26 @@ namespace verona::rt
 
     Core* victim = nullptr;
 
+    /// How far away (see Core::distance()) the victims are allowed to be.
+    size_t steal_level = 0;
+
     /// Local work item to avoid overhead of synchronisation
     /// on scheduler queue.
     Work* next_work = nullptr;
 
+    /// Whether next_work was taken by hand_off(), so that it keeps the slot.
+    bool handed_off = false;
+
+    /// Most work the local ring can hold (see ThreadPool::set_local_ring()).
+    static constexpr size_t LOCAL_RING_CAPACITY = 16;
+
+    /// Work displaced from next_work, oldest at ring_first. Like next_work,
+    /// it is only seen by other threads once return_next_work() moves it to
+    /// the queue.
+    Work* local_ring[LOCAL_RING_CAPACITY];
+    size_t ring_first = 0;
+    size_t ring_count = 0;
+
     bool running = true;
 
     /// SchedulerList pointers.
@@ -82,23 +114,261 @@ namespace verona::rt
       running = false;
     }
 
+    /// Note when `w` was scheduled, for its queue wait.
+    static inline void stamp(Work* w)
+    {
+      UNUSED(w);
+#ifdef USE_SCHED_STATS
+      w->scheduled_at = Aal::tick();
+#endif
+      LiveMetrics::count(LiveMetrics::Scheduled);
+    }
+
     inline void schedule_fifo(Work* w)
     {
-      Logging::cout() << "Enqueue work " << w << Logging::endl;
+      if constexpr (Logging::enabled)
+        Logging::cout() << "Enqueue work " << w << Logging::endl;
+      stamp(w);
 
-      // If we already have a work item then we need to enqueue it.
-      return_next_work();
+      // A handed off behaviour keeps the slot, and this goes on the queue.
+      if (handed_off)
+      {
+        core->q.enqueue(w);
+        if (Scheduler::get().unpause())
+          core->stats.unpause();
+        return;
+      }
+
+      // If we already have a work item then we need to keep it in the ring
+      // or enqueue it.
+      displace_next_work();
 
       // Save work item locally, this is used for batching.
       next_work = w;
     }
 
+    /**
+     * Keep `w`, which the behaviour just run made runnable by releasing a
+     * cown to it, in the local slot to run next (see
+     * ThreadPool::set_direct_handoff()). Returns false, for `w` to be
+     * scheduled as usual, if the slot already holds a handed off behaviour
+     * or this thread owes a steal for fairness.
+     */
+    bool hand_off(Work* w)
+    {
+      if (
+        handed_off || fair_quantum_expired() ||
+        (core->should_steal_for_fairness && Scheduler::is_fair()))
+        return false;
+
+      if constexpr (Logging::enabled)
+        Logging::cout() << "Hand off work " << w << Logging::endl;
+      stamp(w);
+      displace_next_work();
+      next_work = w;
+      handed_off = true;
+      return true;
+    }
+
+    /**
+     * Enqueue `w` at the back of the queue of `c`, the home core of its
+     * first cown.
+     */
+    static inline void schedule_on(Core* c, Work* w)
+    {
+      Logging::cout() << "Sticky scheduling work " << w << " onto "
+                      << c->affinity << Logging::endl;
+      stamp(w);
+      c->q.enqueue(w);
+
+      if (Scheduler::get().unpause())
+        c->stats.unpause();
+    }
+
+    /**
+     * Release the region of `o` on `home`, the core it was made on (see
+     * Region::set_release_home_threshold()). Returns false if `home` is not
+     * a core of this run, as the region may be older than the run. The
+     * release is queued on `home`, so a steal may still move it.
+     */
+    static bool release_home(void* home, Object* o)
+    {
+      Core* first = Scheduler::first_core();
+      Core* c = first;
+      do
+      {
+        if (c == home)
+        {
+          schedule_on(c, Closure::make([o](Work*) {
+            Region::release_here(o);
+            return true;
+          }));
+          return true;
+        }
+        c = c->next;
+      } while (c != first);
+      return false;
+    }
+
+    /**
+     * Schedule up to `count` calls of `help(job)` on the cores after this
+     * thread's, one each, to share the release of subregions (see
+     * Region::set_parallel_release()). Returns how many were scheduled.
+     */
+    static size_t
+    release_helpers(size_t count, void (*help)(void* job), void* job)
+    {
+      SchedulerThread* t = Scheduler::local();
+      if (t == nullptr)
+        return 0;
+
+      size_t n = 0;
+      for (Core* c = t->core->next; (n < count) && (c != t->core); c = c->next)
+      {
+        schedule_on(c, Closure::make([help, job](Work*) {
+          help(job);
+          return true;
+        }));
+        n++;
+      }
+      return n;
+    }
+
+    /**
+     * Enqueue `w` on the low priority queue of `c`.
+     */
+    static inline void schedule_low(Core* c, Work* w)
+    {
+      Logging::cout() << "Low priority scheduling work " << w << " onto "
+                      << c->affinity << Logging::endl;
+      stamp(w);
+      c->low_q.enqueue(w);
+
+      if (Scheduler::get().unpause())
+        c->stats.unpause();
+    }
+
+    /**
+     * Move the work held for idle threads onto this core's low priority
+     * queue. Returns false if there was none.
+     */
+    bool schedule_idle_work()
+    {
+      Work* w = IdleWork::take_all();
+      if (w == nullptr)
+        return false;
+
+      while (w != nullptr)
+      {
+        Work* next = w->next_in_queue.load(std::memory_order_relaxed);
+        schedule_low(core, w);
+        w = next;
+      }
+      return true;
+    }
+
+    /**
+     * Let through the collections this thread's GCPacer allows, onto our
+     * core's low priority queue.
+     */
+    void pace_gc()
+    {
+      GCPacer& pacer = GCPacer::local();
+      if (pacer.empty())
+        return;
+
+      // Under memory pressure, everything goes, most garbage first.
+      bool pressure = MemoryPressure::is_under_pressure();
+      bool backlog = !core->q.is_empty();
+      while (Work* w = pressure ? pacer.take_idle() : pacer.take(backlog))
+        schedule_low(core, w);
+    }
+
+    /// MemoryPressure alarms this thread has answered.
+    size_t pressure_alarms = 0;
+
+    /**
+     * Answer a new MemoryPressure alarm by handing back the memory this
+     * thread holds on to: its caches, and its allocator's free memory.
+     */
+    void relieve_memory_pressure()
+    {
+      MemoryPressure::poll();
+      size_t alarms = MemoryPressure::get_alarms();
+      if (alarms == pressure_alarms)
+        return;
+
+      pressure_alarms = alarms;
+      ChunkCache::trim();
+      StackBlockCache::trim();
+      BehaviourPool::trim();
+      CownPool::trim();
+      MemoryPressure::release_heap();
+    }
+
+    /**
+     * Adopt the timers armed off the scheduler threads onto this thread's
+     * TimerWheel, and put the work of those that are due on our core's
+     * queue. Returns false if none were.
+     */
+    bool fire_timers()
+    {
+      TimerWheel& timers = TimerWheel::local();
+      if (timers.empty() && !TimerWheel::has_incoming())
+        return false;
+
+      uint64_t now = TickClock::now_ns();
+      timers.adopt(now);
+      bool fired = false;
+      timers.advance(now, [this, &fired](Work* w) {
+        Logging::cout() << "Timer fired for work " << w << Logging::endl;
+        stamp(w);
+        core->q.enqueue(w);
+        fired = true;
+      });
+
+      if (fired && Scheduler::get().unpause())
+        core->stats.unpause();
+      return fired;
+    }
+
+    /**
+     * Schedule the work for the FdPoller sources that are ready now. Returns
+     * false if none were.
+     */
+    bool poll_sources()
+    {
+      if (FdPoller::poll() == 0)
+        return false;
+
+      // The sources' work is scheduled here, so may be in the local slot.
+      return_next_work();
+      if (Scheduler::get().unpause())
+        core->stats.unpause();
+      return true;
+    }
+
+    /**
+     * With nothing else to run, let through the next collection this
+     * thread's GCPacer holds. Returns false if there was none.
+     */
+    bool pace_gc_idle()
+    {
+      Work* w = GCPacer::local().take_idle();
+      if (w == nullptr)
+        return false;
+
+      schedule_low(core, w);
+      return true;
+    }
+
     static inline void schedule_lifo(Core* c, Work* w)
     {
       // A lifo scheduled cown is coming from an external source, such as
       // asynchronous I/O.
       Logging::cout() << "LIFO scheduling work " << w << " onto " << c->affinity
                       << Logging::endl;
+      stamp(w);
       c->q.enqueue_front(w);
       Logging::cout() << "LIFO scheduled work " << w << " onto " << c->affinity
                       << Logging::endl;
@@ -115,32 +385,235 @@ namespace verona::rt
       t->run_inner(startup, args...);
     }
 
+    /**
+     * Move the local ring, oldest first, and then next_work onto our core's
+     * queue, where other threads can steal them.
+     */
     void return_next_work()
     {
+      handed_off = false;
+      if ((next_work == nullptr) && (ring_count == 0))
+        return;
+
+      while (ring_count != 0)
+        core->q.enqueue(take_oldest());
       if (next_work != nullptr)
+        core->q.enqueue(std::exchange(next_work, nullptr));
+      if (Scheduler::get().unpause())
+        core->stats.unpause();
+    }
+
+    Work* take_oldest()
+    {
+      Work* w = local_ring[ring_first];
+      ring_first = (ring_first + 1) % LOCAL_RING_CAPACITY;
+      ring_count--;
+      return w;
+    }
+
+    Work* take_newest()
+    {
+      ring_count--;
+      return local_ring[(ring_first + ring_count) % LOCAL_RING_CAPACITY];
+    }
+
+    /**
+     * Empty next_work, keeping what it held at the newest end of the local
+     * ring. With no ring, or once it is full, the oldest work goes on our
+     * core's queue instead.
+     */
+    void displace_next_work()
+    {
+      size_t size = Scheduler::get_local_ring();
+      if (size == 0)
       {
-        core->q.enqueue(next_work);
-        next_work = nullptr;
-        if (Scheduler::get().unpause())
-          core->stats.unpause();
+        return_next_work();
+        return;
       }
+
+      handed_off = false;
+      if (next_work == nullptr)
+        return;
+
+      bool enqueued = false;
+      while (ring_count >= size)
+      {
+        core->q.enqueue(take_oldest());
+        enqueued = true;
+      }
+      local_ring[(ring_first + ring_count) % LOCAL_RING_CAPACITY] =
+        std::exchange(next_work, nullptr);
+      ring_count++;
+
+      if (enqueued && Scheduler::get().unpause())
+        core->stats.unpause();
     }
 
     static constexpr size_t BATCH_SIZE = 100;
+
+    /// While both queues have work, one in this many items taken from the
+    /// core comes from the low priority queue.
+    static constexpr size_t LOW_PRIORITY_WEIGHT = 8;
+
+    /// Items taken from the core since the last low priority one.
+    size_t since_low = 0;
+
+    /**
+     * Take the next item from our core, preferring high priority work but
+     * giving low priority work a turn every LOW_PRIORITY_WEIGHT items, so
+     * that it is not starved.
+     */
+    Work* dequeue()
+    {
+      Work* work;
+      if (++since_low >= LOW_PRIORITY_WEIGHT)
+      {
+        since_low = 0;
+        work = core->low_q.dequeue();
+        if (work != nullptr)
+          return work;
+      }
+
+      work = core->q.dequeue();
+      if (work != nullptr)
+        return work;
+
+      since_low = 0;
+      return core->low_q.dequeue();
+    }
+
+    /// Bounds on the batch length chosen to fit a time slice.
+    static constexpr size_t MIN_BATCH_SIZE = 1;
+    static constexpr size_t MAX_BATCH_SIZE = 10'000;
+
+    /// Moving average of the cycles a behaviour on this thread takes, or 0
+    /// if none has been measured.
+    uint64_t behaviour_cycles = 0;
+
+    /**
+     * Run `work`, timing it if the scheduler has a time slice to fit
+     * batches to. Closures it batched on a cown can no longer be fused
+     * once it is done (see Fusion).
+     */
+    void run_work(Work* work)
+    {
+      if (Scheduler::get_time_slice() == 0)
+      {
+        work->run();
+        Fusion::close_local();
+        return;
+      }
+
+      uint64_t start = Aal::tick();
+      work->run();
+      uint64_t cycles = Aal::tick() - start;
+      Fusion::close_local();
+
+      if (behaviour_cycles == 0)
+        behaviour_cycles = cycles;
+      else
+        behaviour_cycles += (cycles / 8) - (behaviour_cycles / 8);
+    }
+
+    /**
+     * The number of behaviours to run from the local slot before looking
+     * at the queue again: BATCH_SIZE, or, with a time slice, as many
+     * behaviours as fit in it at their measured average length.
+     */
+    size_t batch_size()
+    {
+      size_t size = BATCH_SIZE;
+      uint64_t slice = Scheduler::get_time_slice();
+      if ((slice != 0) && (behaviour_cycles != 0))
+      {
+        size = static_cast<size_t>(std::clamp<uint64_t>(
+          slice / behaviour_cycles, MIN_BATCH_SIZE, MAX_BATCH_SIZE));
+      }
+
+      size_t quantum = Scheduler::get_cown_quantum();
+      if ((quantum != 0) && (quantum < size))
+        size = quantum;
+
+      core->stats.batch(size);
+      return size;
+    }
+
+    /// Behaviours run since this thread last stole for fairness, and when
+    /// it did.
+    size_t fair_behaviours = 0;
+    uint64_t fair_since = 0;
+
+    /**
+     * Whether this thread has used up the quantum set by
+     * ThreadPool::set_fair_quantum() since it last stole for fairness.
+     */
+    bool fair_quantum_expired()
+    {
+      size_t behaviours = Scheduler::get_fair_quantum_behaviours();
+      if ((behaviours != 0) && (fair_behaviours >= behaviours))
+        return true;
+
+      uint64_t cycles = Scheduler::get_fair_quantum_cycles();
+      return (cycles != 0) && (Aal::tick() - fair_since >= cycles);
+    }
+
+    /// When the queue of our core was last seen with nothing waiting.
+    uint64_t backlog_since = 0;
+
+    /**
+     * In an elastic pool, wake a retired thread if work has been waiting
+     * in our core's queue for longer than ThreadPool::set_elastic() allows.
+     */
+    void check_backlog()
+    {
+      if (!Scheduler::is_elastic())
+        return;
+
+      uint64_t now = Aal::tick();
+      if (core->q.is_empty())
+      {
+        backlog_since = now;
+        return;
+      }
+
+      if (
+        (Scheduler::get_retired_threads() == 0) ||
+        (now - backlog_since < Scheduler::get_wake_after()))
+        return;
+
+      // At most one wakeup a period from each core.
+      backlog_since = now;
+      if (Scheduler::get().unretire())
+        core->stats.unretire();
+    }
+
     Work* get_work(size_t& batch)
     {
       // Check if we have a thread-local work item to use that is not subject
-      // to work stealing.  This is batched, and should not happen more than
-      // BATCH_SIZE times in a row.
+      // to work stealing, in the slot and then the ring.  This is batched,
+      // and should not happen more than batch_size() times in a row.
       if (next_work != nullptr && batch != 0)
       {
         batch--;
+        handed_off = false;
         return std::exchange(next_work, nullptr);
       }
 
-      batch = BATCH_SIZE;
+      if (ring_count != 0 && batch != 0)
+      {
+        batch--;
+        return take_newest();
+      }
+
+      batch = batch_size();
+      check_backlog();
+      relieve_memory_pressure();
+      pace_gc();
+      fire_timers();
+      poll_sources();
 
-      if (core->should_steal_for_fairness)
+      bool token = core->should_steal_for_fairness && Scheduler::is_fair();
+      if (token || fair_quantum_expired())
       {
         // Check if we have some work. We should only reschedule the token
         // if we do have some work.  Otherwise, the token will be rescheduled
@@ -148,11 +621,17 @@ namespace verona::rt
         if (!core->q.is_empty())
         {
           auto work = try_steal();
-          // Set the flag before rescheduling the token so that we don't have
-          // a race.
-          core->should_steal_for_fairness = false;
-          // Reschedule the token.
-          core->q.enqueue(core->token_work);
+          core->stats.fair_pass(fair_behaviours);
+          fair_behaviours = 0;
+          fair_since = Aal::tick();
+          if (token)
+          {
+            // Set the flag before rescheduling the token so that we don't
+            // have a race.
+            core->should_steal_for_fairness = false;
+            // Reschedule the token.
+            core->q.enqueue(core->token_work);
+          }
           if (work != nullptr)
           {
             return_next_work();
@@ -161,7 +640,7 @@ namespace verona::rt
         }
       }
 
-      auto work = core->q.dequeue();
+      auto work = dequeue();
       if (work != nullptr)
       {
         return_next_work();
@@ -179,9 +658,13 @@ namespace verona::rt
 
       if (next_work != nullptr)
       {
+        handed_off = false;
         return std::exchange(next_work, nullptr);
       }
 
+      if (ring_count != 0)
+        return take_newest();
+
       return steal();
     }
 
@@ -198,23 +681,54 @@ namespace verona::rt
 
       Scheduler::local() = this;
       assert(core != nullptr);
+      // Regions made here are at home on this core.
+      RegionBase::local_home() = core;
+      Region::set_release_home(&release_home);
+      Region::set_release_helpers(&release_helpers);
+      // Cowns made here count their references here while we have work.
+      Bias::set_here(true);
       victim = core->next;
       core->servicing_threads++;
+      backlog_since = Aal::tick();
+      fair_since = backlog_since;
 
 #ifdef USE_SYSTEMATIC_TESTING
       Systematic::attach_systematic_thread(local_systematic);
 #endif
-      size_t batch = BATCH_SIZE;
+      size_t batch = batch_size();
       Work* work;
       while ((work = get_work(batch)))
       {
-        Logging::cout() << "Schedule work " << work << Logging::endl;
-
-        work->run();
+        if constexpr (Logging::enabled)
+          Logging::cout() << "Schedule work " << work << Logging::endl;
+        if constexpr (EventTrace::enabled)
+          EventTrace::record(EventTrace::Event::Schedule, (uintptr_t)work);
+
+#ifdef USE_SCHED_STATS
+        // `work` may be gone once it has run.
+        uint64_t started = Aal::tick();
+        if (work->scheduled_at != 0)
+          core->stats.queue_wait(started - work->scheduled_at);
+        run_work(work);
+        core->stats.run(Aal::tick() - started);
+#else
+        run_work(work);
+#endif
+        LiveMetrics::count(LiveMetrics::Run);
+        fair_behaviours++;
 
         yield();
       }
 
+      // Nothing runs here until the next run, so hand the references
+      // counted here back to the cowns made here.
+      Bias::unbias_all();
+      Bias::set_here(false);
+
+      // Finish any immutable graphs whose release was deferred.
+      while (Immutable::reclaim_deferred())
+        ;
+
       if (core != nullptr)
       {
         auto val = core->servicing_threads.fetch_sub(1);
@@ -232,55 +746,146 @@ namespace verona::rt
       // Reset the local thread pointer as this physical thread could be reused
       // for a different SchedulerThread later.
       Scheduler::local() = nullptr;
+      RegionBase::local_home() = nullptr;
     }
 
     Work* try_steal()
     {
       Work* work = nullptr;
       // Try to steal from the victim thread.
-      work = core->q.steal(victim->q);
+      work = core->q.steal(victim->q, Scheduler::is_steal_half());
 
       if (work != nullptr)
       {
-        core->stats.steal();
-        Logging::cout() << "Fast-steal work " << work << " from "
-                        << victim->affinity << Logging::endl;
+        core->stats.steal(core->distance(victim));
+        LiveMetrics::count(LiveMetrics::Steals);
+        steal_level = 0;
+        if constexpr (Logging::enabled)
+          Logging::cout() << "Fast-steal work " << work << " from "
+                          << victim->affinity << Logging::endl;
+        if constexpr (EventTrace::enabled)
+          EventTrace::record(
+            EventTrace::Event::Steal, (uintptr_t)work, victim->affinity);
       }
 
       // Move to the next victim thread.
-      victim = victim->next;
+      next_victim();
+
+      return work;
+    }
+
+    /**
+     * Move on to the next victim no further away than `steal_level`, so
+     * that cores sharing our cache are tried first, then those in our
+     * socket, then the rest. Each time the search wraps round to our own
+     * core empty-handed, the level widens.
+     */
+    void next_victim()
+    {
+      do
+      {
+        victim = victim->next;
+        if ((victim == core) && (steal_level + 1 < Core::DISTANCES))
+          steal_level++;
+      } while (core->distance(victim) > steal_level);
+    }
 
+    /**
+     * Having been woken to run `work`, pass the wakeup on if more work is
+     * waiting on our core.
+     */
+    Work* woken_with(Work* work, bool woken)
+    {
+      if (woken && (!core->q.is_empty() || !core->low_q.is_empty()))
+        Scheduler::get().wake_another();
       return work;
     }
 
     Work* steal()
     {
       uint64_t tsc = Aal::tick();
+      // When this search for work began, less any time paused.
+      uint64_t searching = tsc;
+      // When this search for work began.
+      uint64_t idle_since = tsc;
       Work* work;
+      bool woken = false;
 
       while (running)
       {
         yield();
 
         // Check if some other thread has pushed work on our queue.
-        work = core->q.dequeue();
+        work = dequeue();
 
         if (work != nullptr)
-          return work;
+          return woken_with(work, woken);
 
-        // Try to steal from the victim thread.
-        work = core->q.steal(victim->q);
+        // Try to steal from the victim thread, high priority work first.
+        work = core->q.steal(victim->q, Scheduler::is_steal_half());
+        if (work == nullptr)
+          work = core->low_q.steal(victim->low_q, Scheduler::is_steal_half());
 
         if (work != nullptr)
         {
-          core->stats.steal();
-          Logging::cout() << "Stole work " << work << " from "
-                          << victim->affinity << Logging::endl;
-          return work;
+          core->stats.steal(core->distance(victim));
+          LiveMetrics::count(LiveMetrics::Steals);
+          steal_level = 0;
+          if constexpr (Logging::enabled)
+            Logging::cout() << "Stole work " << work << " from "
+                            << victim->affinity << Logging::endl;
+          if constexpr (EventTrace::enabled)
+            EventTrace::record(
+              EventTrace::Event::Steal, (uintptr_t)work, victim->affinity);
+          core->stats.steal_latency(Aal::tick() - searching);
+          return woken_with(work, woken);
         }
 
         // We were unable to steal, move to the next victim thread.
-        victim = victim->next;
+        next_victim();
+
+        // With nothing to run, tear down some released immutable state.
+        if (Immutable::reclaim_deferred())
+        {
+          tsc = Aal::tick();
+          continue;
+        }
+
+        // And hand the references counted here back to the cowns made here,
+        // as those taken out here may have been dropped elsewhere.
+        if (Bias::unbias_all())
+        {
+          tsc = Aal::tick();
+          continue;
+        }
+
+        // Then pick up the work that was left for an idle thread.
+        if (schedule_idle_work())
+        {
+          tsc = Aal::tick();
+          continue;
+        }
+
+        // And the collections held back by the pacer.
+        if (pace_gc_idle())
+        {
+          tsc = Aal::tick();
+          continue;
+        }
+
+        // And the timers that are due.
+        if (fire_timers())
+        {
+          tsc = Aal::tick();
+          continue;
+        }
+
+        // And the sources that are ready.
+        if (poll_sources())
+        {
+          tsc = Aal::tick();
+          continue;
+        }
 
 #ifdef USE_SYSTEMATIC_TESTING
         // Only try to pause with 1/(2^5) probability
@@ -293,7 +898,7 @@ namespace verona::rt
 #else
         // Wait until a minimum timeout has passed.
         uint64_t tsc2 = Aal::tick();
-        if ((tsc2 - tsc) < TSC_QUIESCENCE_TIMEOUT)
+        if ((tsc2 - tsc) < Scheduler::get_spin_before_park())
         {
           Aal::pause();
           continue;
@@ -302,8 +907,29 @@ namespace verona::rt
 
         // We've been spinning looking for work for some time. While paused,
         // our running flag may be set to false, in which case we terminate.
-        if (Scheduler::get().pause())
+        // Hand our cached chunks, stack blocks, and pooled behaviours and
+        // cowns back first, as we may sleep for a while.
+        ChunkCache::trim();
+        StackBlockCache::trim();
+        BehaviourPool::trim();
+        CownPool::trim();
+        LiveMetrics::count(LiveMetrics::Parks);
+        if constexpr (EventTrace::enabled)
+          EventTrace::record(EventTrace::Event::Park);
+        uint64_t paused = Aal::tick();
+        bool was_paused = Scheduler::get().pause(Aal::tick() - idle_since);
+        // Work for the sources that were ready while this thread waited in
+        // the FdPoller is in the local slot.
+        return_next_work();
+        if (was_paused)
+        {
           core->stats.pause();
+          core->stats.paused(Aal::tick() - paused);
+          searching = Aal::tick();
+          woken = true;
+        }
+        if constexpr (EventTrace::enabled)
+          EventTrace::record(EventTrace::Event::Unpark);
       }
 
       return nullptr;
@@ -2,6 +2,7 @@
 // SPDX-License-Identifier: MIT
 #pragma once
 
+#include "../boc/fusion.h"
 #include "../pal/threadpoolbuilder.h"
 #include "debug/logging.h"
 #include "threadstate.h"
@@ -11,13 +12,17 @@
 #  include "threadsync.h"
 #endif
 
+#include "../pal/tick_clock.h"
 #include "corepool.h"
+#include "poller.h"
 #include "schedulerlist.h"
+#include "timerwheel.h"
 
 #include <atomic>
 #include <condition_variable>
 #include <mutex>
 #include <snmalloc/snmalloc.h>
+#include <vector>
 
 namespace verona::rt
 {
@@ -73,7 +78,59 @@ namespace verona::rt
 
     bool teardown_in_progress = false;
 
-    bool fair = false;
+    /// Whether the cores pass tokens to steal for fairness.
+    bool fair = true;
+
+    /// Behaviours, and cycles, a thread runs before it steals for fairness
+    /// without waiting for its core's token, or 0 for no bound.
+    size_t fair_quantum_behaviours = 0;
+    uint64_t fair_quantum_cycles = 0;
+
+    /// Most behaviours a thread runs in a row from its local slot, or 0 to
+    /// leave it to the batch length.
+    size_t cown_quantum = 0;
+
+    /// Whether a steal takes half of the victim's queues rather than one.
+    bool steal_half = false;
+
+    /// Whether behaviours are sent to the home core of their first cown.
+    bool sticky = false;
+
+    /// Whether the next behaviour on a released cown runs next on the
+    /// releasing thread.
+    bool direct_handoff = false;
+
+    /// Work a thread keeps in its local ring, behind its local slot, rather
+    /// than on its core's queue, or 0 for none.
+    size_t local_ring = 0;
+
+    /// Target length in cycles of a batch of behaviours, or 0 for a fixed
+    /// batch length.
+    uint64_t time_slice = 0;
+
+    /// Whether new work wakes one paused thread rather than all of them.
+    bool targeted_wakeup = false;
+
+    /// Cycles an idle thread looks for work before it pauses.
+    uint64_t spin_before_park = T::TSC_QUIESCENCE_TIMEOUT;
+
+    /// How the cores are placed on CPUs, and the socket for
+    /// Placement::Socket.
+    Topology::Placement placement = Topology::Placement::Scatter;
+    size_t placement_socket = 0;
+
+    /// Threads kept from retiring, or 0 if the pool is not elastic.
+    size_t elastic_min = 0;
+
+    /// Cycles a thread must have been without work to retire.
+    uint64_t retire_after = 0;
+
+    /// Cycles a core's queue must have had work waiting in it before its
+    /// thread wakes a retired one.
+    uint64_t wake_after = 0;
+
+    /// Threads retired, changed under the sync lock.
+    std::atomic<size_t> retired_threads{0};
 
     ThreadState state;
 
@@ -83,6 +140,23 @@ namespace verona::rt
     /// Systematic ids.
     std::atomic<size_t> systematic_ids = 0;
 
+    /// Whether the threads and cores are kept between runs.
+    bool persistent = false;
+
+    /// The threads kept between runs, or nullptr.
+    ParkedThreads* parked = nullptr;
+
+  public:
+    class ExternalBatch;
+
+  private:
+    /// The outermost ExternalBatch open on this thread, if any.
+    static ExternalBatch*& external_batch()
+    {
+      static thread_local ExternalBatch* batch = nullptr;
+      return batch;
+    }
+
   public:
     static ThreadPool<T>& get()
     {
@@ -136,6 +210,12 @@ namespace verona::rt
                       << (prev_count - 1) << ")" << Logging::endl;
     }
 
+    /**
+     * Whether each core passes a token through its queue, and steals from
+     * another core each time the token comes round, so that work spreads
+     * out even when no core runs dry. On by default. Off, threads steal
+     * only once their own queue is empty, and pay nothing for the token.
+     */
     static void set_fair(bool fair)
     {
       Logging::cout() << "Set fair: " << fair << Logging::endl;
@@ -143,6 +223,302 @@ namespace verona::rt
       s.fair = fair;
     }
 
+    static bool is_fair()
+    {
+      return get().fair;
+    }
+
+    /**
+     * Also steal for fairness once a thread has run `behaviours` behaviours,
+     * or `cycles` cycles have passed, since it last did, without waiting for
+     * the token, which a long queue holds back. The bound is checked between
+     * batches (see set_cown_quantum()). 0 turns either bound off, and both
+     * are off by default. Applies whether or not set_fair() is on.
+     */
+    static void set_fair_quantum(size_t behaviours, uint64_t cycles)
+    {
+      Logging::cout() << "Set fair quantum: " << behaviours << " behaviours, "
+                      << cycles << " cycles" << Logging::endl;
+      auto& s = get();
+      s.fair_quantum_behaviours = behaviours;
+      s.fair_quantum_cycles = cycles;
+    }
+
+    static size_t get_fair_quantum_behaviours()
+    {
+      return get().fair_quantum_behaviours;
+    }
+
+    static uint64_t get_fair_quantum_cycles()
+    {
+      return get().fair_quantum_cycles;
+    }
+
+    /**
+     * Bound how many behaviours a thread runs in a row from its local
+     * slot, before it goes back to its queue. The slot holds the behaviour
+     * that the one just run made runnable, which is usually the next one
+     * on the same cown, so this bounds how long one cown keeps its core
+     * while others wait. 0, the default, leaves it to the batch length
+     * (see set_time_slice()).
+     */
+    static void set_cown_quantum(size_t behaviours)
+    {
+      Logging::cout() << "Set cown quantum: " << behaviours << Logging::endl;
+      get().cown_quantum = behaviours;
+    }
+
+    static size_t get_cown_quantum()
+    {
+      return get().cown_quantum;
+    }
+
+    /**
+     * Make each steal take about half of the victim's work rather than a
+     * quarter of it (see WorkStealingQueue::steal()).
+     */
+    static void set_steal_half(bool steal_half)
+    {
+      Logging::cout() << "Set steal half: " << steal_half << Logging::endl;
+      get().steal_half = steal_half;
+    }
+
+    static bool is_steal_half()
+    {
+      return get().steal_half;
+    }
+
+    /**
+     * Send each behaviour to the home core of its first cown (see
+     * Cown::set_home()), unless that core already has work queued, in which
+     * case it is scheduled as usual. The home follows the cown to wherever
+     * its behaviours run.
+     */
+    static void set_sticky(bool sticky)
+    {
+      Logging::cout() << "Set sticky: " << sticky << Logging::endl;
+      get().sticky = sticky;
+    }
+
+    static bool is_sticky()
+    {
+      return get().sticky;
+    }
+
+    /**
+     * Run the next behaviour on a cown, when a writer releases the cown to
+     * it and it then has all of its cowns, next on the releasing thread,
+     * where the cown's data is still in cache, rather than through the
+     * queues (see schedule_handoff()). It is still bounded by the batch
+     * length and set_cown_quantum(), and the thread does not take it if it
+     * owes a steal for fairness.
+     */
+    static void set_direct_handoff(bool direct_handoff)
+    {
+      Logging::cout() << "Set direct handoff: " << direct_handoff
+                      << Logging::endl;
+      get().direct_handoff = direct_handoff;
+    }
+
+    static bool is_direct_handoff()
+    {
+      return get().direct_handoff;
+    }
+
+    /**
+     * Keep up to `size` items of work in a ring on each scheduler thread,
+     * rather than only the one in its local slot. Work the slot displaces,
+     * as when a behaviour makes several successors runnable, goes in the
+     * ring and runs, most recent first, before the core's queue, without
+     * synchronising on it. The ring is not stealable: it moves to the queue
+     * in bulk when the thread goes back to the queue at the end of a batch
+     * (see set_time_slice()), and its oldest item does when it overflows.
+     * At most SchedulerThread::LOCAL_RING_CAPACITY, and 0, the default,
+     * keeps only the slot.
+     */
+    static void set_local_ring(size_t size)
+    {
+      Logging::cout() << "Set local ring: " << size << Logging::endl;
+      get().local_ring = std::min(size, T::LOCAL_RING_CAPACITY);
+    }
+
+    static size_t get_local_ring()
+    {
+      return get().local_ring;
+    }
+
+    /**
+     * Size each batch of behaviours a scheduler thread runs from its local
+     * slot, before it looks at its queue again, so that the batch takes
+     * about `cycles` cycles. Each thread measures how long its behaviours
+     * take to work this out. 0 restores the fixed batch length.
+     */
+    static void set_time_slice(uint64_t cycles)
+    {
+      Logging::cout() << "Set time slice: " << cycles << Logging::endl;
+      get().time_slice = cycles;
+    }
+
+    static uint64_t get_time_slice()
+    {
+      return get().time_slice;
+    }
+
+    /**
+     * Make new work wake the one paused thread nearest the core that
+     * scheduled it, instead of every paused thread. A woken thread that
+     * finds more work than it took wakes the next one.
+     */
+    static void set_targeted_wakeup(bool targeted_wakeup)
+    {
+      Logging::cout() << "Set targeted wakeup: " << targeted_wakeup
+                      << Logging::endl;
+      get().targeted_wakeup = targeted_wakeup;
+    }
+
+    static bool is_targeted_wakeup()
+    {
+      return get().targeted_wakeup;
+    }
+
+    /**
+     * Set how many cycles an idle thread spins looking for work before it
+     * pauses. Shorter saves CPU between bursts, longer saves the cost of
+     * waking up within them.
+     */
+    static void set_spin_before_park(uint64_t cycles)
+    {
+      Logging::cout() << "Set spin before park: " << cycles << Logging::endl;
+      get().spin_before_park = cycles;
+    }
+
+    static uint64_t get_spin_before_park()
+    {
+      return get().spin_before_park;
+    }
+
+    /**
+     * Set how the next init() gives its cores CPUs (see
+     * Topology::Placement). With Placement::Socket, every core gets a CPU
+     * of socket `socket`, which must exist.
+     */
+    static void set_placement(Topology::Placement placement, size_t socket = 0)
+    {
+      Logging::cout() << "Set placement: " << (int)placement << " socket "
+                      << socket << Logging::endl;
+      auto& s = get();
+      s.placement = placement;
+      s.placement_socket = socket;
+    }
+
+    static Topology::Placement get_placement()
+    {
+      return get().placement;
+    }
+
+    /**
+     * Keep the scheduler threads, and their cores, between runs, rather
+     * than joining and freeing them, so that a later init() of the same
+     * size and its run() start without creating any (see ParkedThreads).
+     * The kept threads wait on a condition variable between runs. Off by
+     * default. A kept pool keeps its placement. Has no effect under
+     * systematic testing, which creates its threads for each run.
+     */
+    static void set_persistent(bool on)
+    {
+      Logging::cout() << "Set persistent: " << on << Logging::endl;
+      get().persistent = on;
+    }
+
+    static bool is_persistent()
+    {
+      return get().persistent;
+    }
+
+    /**
+     * Join the threads, and free the cores, kept by set_persistent(),
+     * between runs. The next init() builds the pool afresh.
+     */
+    static void release_persistent()
+    {
+      auto& s = get();
+      if (s.thread_count != 0)
+        abort();
+      s.release_kept();
+    }
+
+    /**
+     * Make the pool elastic: a thread that has been without work for
+     * `retire_after` cycles retires when it pauses, as long as at least
+     * `min_threads` do not, and only wakes again when a thread whose
+     * core's queue has had work waiting for `wake_after` cycles picks it.
+     * Ordinary wakeups for new work leave retired threads alone. The
+     * thread count given to init() is the most that run. `min_threads` of
+     * 0 turns this off.
+     */
+    static void
+    set_elastic(size_t min_threads, uint64_t retire_after, uint64_t wake_after)
+    {
+      Logging::cout() << "Set elastic: " << min_threads << " retire after "
+                      << retire_after << " wake after " << wake_after
+                      << Logging::endl;
+      auto& s = get();
+      s.elastic_min = min_threads;
+      s.retire_after = retire_after;
+      s.wake_after = wake_after;
+    }
+
+    static bool is_elastic()
+    {
+      return get().elastic_min != 0;
+    }
+
+    static uint64_t get_wake_after()
+    {
+      return get().wake_after;
+    }
+
+    /// How many threads are retired (see set_elastic()).
+    static size_t get_retired_threads()
+    {
+      return get().retired_threads.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * How many scheduler threads the process can keep running at once: the
+     * CPUs it may run on, or fewer if its cgroup has a CPU quota. Threads
+     * beyond this take turns on the CPUs.
+     */
+    static size_t available_cores()
+    {
+      return CorePool<ThreadPool<T>>::available();
+    }
+
+    /**
+     * The core the current scheduler thread runs on, or nullptr off the
+     * scheduler.
+     */
+    static Core* current_core()
+    {
+      auto* t = local();
+      return t == nullptr ? nullptr : t->core;
+    }
+
+    /**
+     * The `index`th core, counting round from the first, or nullptr before
+     * the scheduler is initialised.
+     */
+    static Core* core_at(size_t index)
+    {
+      Core* c = first_core();
+      if (c == nullptr)
+        return nullptr;
+
+      for (size_t i = 0; i < index; i++)
+        c = c->next;
+      return c;
+    }
+
     static bool is_teardown_in_progress()
     {
       return get().teardown_in_progress;
@@ -172,10 +548,32 @@ namespace verona::rt
       return nonlocal;
     }
 
-    static void schedule(Work* w, bool fifo = true)
+    /**
+     * Schedule `w`. With the scheduler sticky, `home` is the core its
+     * first cown last ran on, if any.
+     */
+    static void schedule(Work* w, bool fifo = true, Core* home = nullptr)
     {
+      // Closures appended later to a fusion this thread has open must not
+      // overtake this work (see Fusion).
+      Fusion::close_local();
+
       auto* t = local();
 
+      if ((t == nullptr) && (external_batch() != nullptr))
+      {
+        external_batch()->works.push_back(w);
+        return;
+      }
+
+      if (
+        (home != nullptr) && fifo && ((t == nullptr) || (t->core != home)) &&
+        home->q.is_empty())
+      {
+        T::schedule_on(home, w);
+        return;
+      }
+
       if (t != nullptr && fifo)
       {
         t->schedule_fifo(w);
@@ -186,6 +584,167 @@ namespace verona::rt
       T::schedule_lifo(core, w);
     }
 
+    /**
+     * Schedule `w`, which the behaviour that has just run on this thread
+     * made runnable by releasing a cown to it. With set_direct_handoff() on,
+     * the thread keeps it to run next, ahead of any other successors, and
+     * even if its home is elsewhere. Otherwise, as schedule().
+     */
+    static void schedule_handoff(Work* w, Core* home = nullptr)
+    {
+      auto* t = local();
+      if ((t != nullptr) && is_direct_handoff() && t->hand_off(w))
+        return;
+
+      schedule(w, true, home);
+    }
+
+    /**
+     * Schedule `w`, from a scheduler thread, at the back of the queue of
+     * its core, behind the work waiting there and the work in the thread's
+     * local slot, rather than in the slot, where it would run next.
+     */
+    static void schedule_yielded(Work* w)
+    {
+      auto* t = local();
+      assert(t != nullptr);
+      t->return_next_work();
+      T::schedule_on(t->core, w);
+    }
+
+    /**
+     * Schedule `w` once `delay_ns` nanoseconds have passed, on the current
+     * thread's timer wheel (see TimerWheel). Off the scheduler, the first
+     * scheduler thread to look takes it onto its wheel. The runtime does not
+     * finish while timers are pending.
+     */
+    static void schedule_after(uint64_t delay_ns, Work* w)
+    {
+      Fusion::close_local();
+      uint64_t now = TickClock::now_ns();
+      if (local() != nullptr)
+      {
+        TimerWheel::local().add(now + delay_ns, w, now);
+        return;
+      }
+
+      TimerWheel::add_external(now + delay_ns, w);
+      get().unpause();
+    }
+
+    /**
+     * Start polling `s` (see FdPoller), and make sure that a paused thread
+     * waits on it.
+     */
+    static void add_poll_source(FdPoller::Source* s)
+    {
+      FdPoller::add(s);
+      get().unpause();
+    }
+
+    /**
+     * Schedule `w` with Priority::Low on the current core, or on the next
+     * core off the scheduler.
+     */
+    static void schedule_low(Work* w)
+    {
+      Fusion::close_local();
+      auto* t = local();
+      T::schedule_low(t != nullptr ? t->core : round_robin(), w);
+    }
+
+    /**
+     * Schedule the `count` pieces of work in `works` from a thread outside
+     * the runtime, such as an I/O thread handing over requests. They are
+     * split, in order, into one group per core, at most, and each group is
+     * linked into a segment that goes on the back of its core's queue in
+     * one enqueue. Only one wakeup is issued, for all of them.
+     */
+    static void schedule_external(Work** works, size_t count)
+    {
+      Fusion::close_local();
+      if (count == 0)
+        return;
+
+      auto& s = get();
+      size_t groups = std::min(count, s.core_pool.core_count);
+      Core* core = nullptr;
+      for (size_t g = 0; g < groups; g++)
+      {
+        size_t first = (count * g) / groups;
+        size_t last = ((count * (g + 1)) / groups) - 1;
+        for (size_t i = first; i < last; i++)
+        {
+          T::stamp(works[i]);
+          works[i]->next_in_queue.store(
+            works[i + 1], std::memory_order_relaxed);
+        }
+        T::stamp(works[last]);
+
+        core = round_robin();
+        Logging::cout() << "External batch of " << (last - first + 1)
+                        << " onto " << core->affinity << Logging::endl;
+        core->q.enqueue_segment({works[first], &works[last]->next_in_queue});
+      }
+
+      if (s.unpause())
+        core->stats.unpause();
+    }
+
+    /**
+     * Schedule the `count` pieces of work in `works`, which have become
+     * runnable together, such as the run of readers a writer releases, from
+     * any thread. As with schedule_external(), they go onto the queues of
+     * up to one core each, a segment at a time, with a single wakeup, so
+     * that idle cores pick them up at once.
+     */
+    static void schedule_spread(Work** works, size_t count)
+    {
+      Fusion::close_local();
+      if ((local() == nullptr) && (external_batch() != nullptr))
+      {
+        auto& held = external_batch()->works;
+        held.insert(held.end(), works, works + count);
+        return;
+      }
+
+      schedule_external(works, count);
+    }
+
+    /**
+     * While one is open on a thread outside the runtime, the work that
+     * thread schedules, for instance with BehaviourCore::schedule_many(),
+     * is held back, and handed over with schedule_external() when it
+     * closes. Batches nest; only the outermost hands the work over.
+     */
+    class ExternalBatch
+    {
+      friend ThreadPool;
+
+      std::vector<Work*> works;
+      ExternalBatch* outer;
+
+    public:
+      ExternalBatch() : outer(external_batch())
+      {
+        assert(local() == nullptr);
+        if (outer == nullptr)
+          external_batch() = this;
+      }
+
+      ExternalBatch(const ExternalBatch&) = delete;
+      ExternalBatch& operator=(const ExternalBatch&) = delete;
+
+      ~ExternalBatch()
+      {
+        if (outer != nullptr)
+          return;
+
+        external_batch() = nullptr;
+        schedule_external(works.data(), works.size());
+      }
+    };
+
     void init(size_t count, void (*run_at_termination)(void) = nullptr)
     {
       Logging::cout() << "Init runtime" << Logging::endl;
@@ -196,8 +755,28 @@ namespace verona::rt
       thread_count = count;
       teardown_in_progress = false;
 
+      if (
+        (parked != nullptr) &&
+        (!keep_threads() || (parked->size() != count)))
+        release_kept();
+
+      if (parked != nullptr)
+      {
+        // Reuse the kept threads and cores.
+        for (size_t i = 0; i < count; i++)
+        {
+          T* t = threads.pop_free();
+          t->running = true;
+          t->run_at_termination = run_at_termination;
+          threads.add_free(t);
+        }
+        state.init(thread_count);
+        Logging::cout() << "Runtime reinitialised" << Logging::endl;
+        return;
+      }
+
       // Initialize the corepool.
-      core_pool.init(count);
+      core_pool.init(count, placement, placement_socket);
 
       // For future ids.
       systematic_ids = count + 1;
@@ -225,6 +804,12 @@ namespace verona::rt
     template<typename... Args>
     void run_with_startup(void (*startup)(Args...), Args... args)
     {
+      if (keep_threads())
+      {
+        run_kept(startup, args...);
+        return;
+      }
+
       {
         ThreadPoolBuilder builder(thread_count);
 
@@ -259,6 +844,65 @@ namespace verona::rt
     }
 
   private:
+    bool keep_threads()
+    {
+#ifdef USE_SYSTEMATIC_TESTING
+      return false;
+#else
+      return persistent;
+#endif
+    }
+
+    /**
+     * As run_with_startup(), on threads that are kept parked afterwards,
+     * and started by the first run.
+     */
+    template<typename... Args>
+    void run_kept(void (*startup)(Args...), Args... args)
+    {
+      if (parked == nullptr)
+        parked = new ParkedThreads;
+
+      std::vector<T*> ts;
+      std::vector<size_t> affinities;
+      Core* curr_core = core_pool.first_core;
+      for (size_t i = 0; i < thread_count; i++)
+      {
+        T* t = threads.pop_free();
+        if (t == nullptr)
+          abort();
+        t->set_core(curr_core);
+        threads.add_active(t);
+        ts.push_back(t);
+        affinities.push_back(curr_core->affinity);
+        curr_core = curr_core->next;
+      }
+
+      Logging::cout() << "Starting kept threads" << Logging::endl;
+      parked->run(
+        affinities, [&ts, startup, args...](size_t i) {
+          T::run(ts[i], startup, args...);
+        });
+      Logging::cout() << "All kept threads parked" << Logging::endl;
+
+      for (T* t : ts)
+        threads.move_active_to_free(t);
+
+      incarnation++;
+      thread_count = 0;
+
+      SchedulerStats::dump_global(std::cout, incarnation - 2);
+    }
+
+    /// Join the kept threads, and free them and the cores.
+    void release_kept()
+    {
+      delete parked;
+      parked = nullptr;
+      threads.dealloc_lists();
+      core_pool.clear();
+    }
+
     bool check_for_work()
     {
       // TODO: check for pending async IO
@@ -267,7 +911,7 @@ namespace verona::rt
       {
         Logging::cout() << "Checking for pending work on thread " << c->affinity
                         << Logging::endl;
-        if (!c->q.is_empty())
+        if (!c->q.is_empty() || !c->low_q.is_empty())
         {
           Logging::cout() << "Found pending work!" << Logging::endl;
           return true;
@@ -275,11 +919,34 @@ namespace verona::rt
         c = c->next;
       } while (c != first_core());
 
+      if (TimerWheel::has_incoming())
+      {
+        Logging::cout() << "Found timers to adopt!" << Logging::endl;
+        return true;
+      }
+
       Logging::cout() << "No pending work!" << Logging::endl;
       return false;
     }
 
-    bool pause()
+    /**
+     * Whether a thread without work for `idle` cycles should retire rather
+     * than pause. Called holding the sync lock.
+     */
+    bool should_retire(uint64_t idle)
+    {
+      // A retired thread would not wake for its timers.
+      return (elastic_min != 0) && (idle >= retire_after) &&
+        TimerWheel::local().empty() &&
+        (thread_count - retired_threads.load(std::memory_order_relaxed) >
+         elastic_min);
+    }
+
+    /**
+     * Pause the current thread, which has been without work for `idle`
+     * cycles, unless there is work. Returns false if it did not pause.
+     */
+    bool pause(uint64_t idle = 0)
     {
       // Snapshot unpause_epoch, so we can detect a racing unpause.
       auto local_unpause_epoch = unpause_epoch.load(std::memory_order_relaxed);
@@ -297,6 +964,17 @@ namespace verona::rt
       if (check_for_work())
         return false;
 
+      // Sleep no later than this thread's next timer.
+      uint64_t timeout = 0;
+      uint64_t deadline = TimerWheel::local().next_deadline_ns();
+      if (deadline != UINT64_MAX)
+      {
+        uint64_t now = TickClock::now_ns();
+        if (deadline <= now)
+          return false;
+        timeout = deadline - now;
+      }
+
       yield();
 
       {
@@ -312,18 +990,33 @@ namespace verona::rt
         if (value > 1)
         {
           state.dec_active_threads();
-          Logging::cout() << "Pausing" << Logging::endl;
-          h.pause(); // Spurious wake-ups are safe.
-          Logging::cout() << "Unpausing" << Logging::endl;
+          if (should_retire(idle))
+          {
+            Logging::cout() << "Retiring" << Logging::endl;
+            stats().retire();
+            retired_threads.fetch_add(1, std::memory_order_relaxed);
+            h.retire();
+            retired_threads.fetch_sub(1, std::memory_order_relaxed);
+            Logging::cout() << "Unretiring" << Logging::endl;
+          }
+          else
+          {
+            Logging::cout() << "Pausing" << Logging::endl;
+            h.pause(timeout); // Spurious wake-ups are safe.
+            Logging::cout() << "Unpausing" << Logging::endl;
+          }
           state.inc_active_threads();
           return true;
         }
 
-        // There are external sources should wait for external wake ups.
-        if (external_event_sources != 0)
+        // There are external sources, timers or polled sources, so wait for
+        // them.
+        if (
+          (external_event_sources != 0) || (TimerWheel::get_pending() != 0) ||
+          (FdPoller::get_sources() != 0))
         {
           Logging::cout() << "Pausing last thread" << Logging::endl;
-          h.pause(); // Spurious wake-ups are safe.
+          h.pause(timeout); // Spurious wake-ups are safe.
           Logging::cout() << "Unpausing last thread" << Logging::endl;
           return true;
         }
@@ -358,9 +1051,16 @@ namespace verona::rt
 
       yield();
 
+      // A targeted wakeup wakes a single thread, so while others are still
+      // paused it only catches the epoch up by one, and the next unpause()
+      // wakes another.
+      auto target = local_pause_epoch;
+      if (targeted_wakeup && sync.has_waiters())
+        target = local_unpause_epoch + 1;
+
       // Attempt to catch up epoch.
-      bool success = unpause_epoch.compare_exchange_strong(
-        local_unpause_epoch, local_pause_epoch);
+      bool success =
+        unpause_epoch.compare_exchange_strong(local_unpause_epoch, target);
 
       yield();
 
@@ -368,6 +1068,12 @@ namespace verona::rt
       {
         // This grabs the scheduler lock to ensure threads have seen CAS before
         // we notify.
+        if (targeted_wakeup)
+        {
+          Logging::cout() << "Wake one thread" << Logging::endl;
+          wake_one();
+          return true;
+        }
         Logging::cout() << "Wake all threads" << Logging::endl;
         sync.unpause_all(local());
         return true;
@@ -376,6 +1082,35 @@ namespace verona::rt
       return false;
     }
 
+    /**
+     * Wake the paused thread nearest the current one.
+     */
+    void wake_one()
+    {
+      auto* t = local();
+      sync.unpause_one(t, t != nullptr ? t->core : nullptr);
+    }
+
+    /**
+     * Called by a thread woken by a targeted wakeup that has found more
+     * work than it took: pass the wakeup on to another paused thread.
+     */
+    void wake_another()
+    {
+      if (targeted_wakeup && sync.has_waiters())
+        wake_one();
+    }
+
+    /**
+     * Wake the retired thread nearest the current one. Returns false if
+     * none was woken.
+     */
+    bool unretire()
+    {
+      auto* t = local();
+      return sync.unretire_one(t, t != nullptr ? t->core : nullptr);
+    }
+
     SNMALLOC_FAST_PATH
     bool unpause()
     {
@@ -405,5 +1140,35 @@ namespace verona::rt
         return l->get_stats();
       return SchedulerStats::get_global();
     }
+
+    /**
+     * What each core has counted since the last dump, in core order,
+     * without stopping the pool. Must not be called while the pool is
+     * being initialised or torn down.
+     */
+    static std::vector<SchedulerStats::Snapshot> core_stats_snapshots()
+    {
+      std::vector<SchedulerStats::Snapshot> snapshots;
+      Core* first = get().core_pool.first_core;
+      if (first == nullptr)
+        return snapshots;
+      Core* c = first;
+      do
+      {
+        snapshots.push_back(c->stats.snapshot());
+        c = c->next;
+      } while (c != first);
+      return snapshots;
+    }
+
+    /// The snapshots of all the cores, and of the global statistics,
+    /// merged.
+    static SchedulerStats::Snapshot stats_snapshot()
+    {
+      SchedulerStats::Snapshot total = SchedulerStats::get_global().snapshot();
+      for (auto& s : core_stats_snapshots())
+        total += s;
+      return total;
+    }
   };
 } // namespace verona::rt
@@ -3,7 +3,9 @@
 
 #pragma once
 #include "../pal/semaphore.h"
+#include "core.h"
 #include "debug/logging.h"
+#include "poller.h"
 
 /**
  * This file contains the synchronisation implementation for suspending
@@ -60,6 +62,15 @@ namespace verona::rt
       Logging::cout() << "Locking Scheduler done" << Logging::endl;
     }
 
+    /**
+     * Acquires the lock if it is available, without spinning.
+     */
+    bool try_lock()
+    {
+      auto u = Unlocked;
+      return state.compare_exchange_strong(u, Locked);
+    }
+
     /**
      * Attempts to release the lock.  If the lock has received an unpause
      * request, then will return false, and continues to hold the lock.
@@ -96,6 +107,18 @@ namespace verona::rt
   {
     pal::SleepHandle sem;
     LocalSync* next{nullptr};
+    /// The core of the thread, while it is paused.
+    Core* core{nullptr};
+    /// Whether the thread is paused waiting in the FdPoller.
+    bool polling{false};
+
+    void wake()
+    {
+      if (polling)
+        FdPoller::interrupt();
+      else
+        sem.wake();
+    }
   };
 
   template<class T>
@@ -103,6 +126,10 @@ namespace verona::rt
   {
     SchedulerLock lock;
     LocalSync* waiters{nullptr};
+    /// Length of `waiters`, readable without the lock.
+    std::atomic<size_t> parked{0};
+    /// Threads paused until unretire_one() picks them, or teardown.
+    LocalSync* retired{nullptr};
 
     void unlock()
     {
@@ -115,6 +142,7 @@ namespace verona::rt
 
         auto* curr = waiters;
         waiters = nullptr;
+        parked.store(0, std::memory_order_relaxed);
         // Subsequent unpause requests can be ignored as there are no more
         // waiters as we have held the lock continuously.
         lock.unlock_unpause();
@@ -122,12 +150,30 @@ namespace verona::rt
         while (curr != nullptr)
         {
           auto next = curr->next;
-          curr->sem.wake();
+          curr->wake();
           curr = next;
         }
       }
     }
 
+    /**
+     * Take `s` off the list of paused threads, if it is still on it.
+     * Called holding the lock.
+     */
+    bool remove_waiter(LocalSync* s)
+    {
+      for (auto** curr = &waiters; *curr != nullptr; curr = &(*curr)->next)
+      {
+        if (*curr == s)
+        {
+          *curr = s->next;
+          parked.fetch_sub(1, std::memory_order_relaxed);
+          return true;
+        }
+      }
+      return false;
+    }
+
   public:
     constexpr ThreadSync() = default;
 
@@ -139,6 +185,89 @@ namespace verona::rt
       Logging::cout() << "Unpause all done" << Logging::endl;
     }
 
+    /**
+     * Wake the paused thread whose core is nearest `near` (see
+     * Core::distance()), or any paused thread if `near` is nullptr. If
+     * another thread holds the lock, this wakes them all instead, as
+     * unpause_all() does.
+     */
+    void unpause_one(T*, Core* near)
+    {
+      if (!lock.try_lock())
+      {
+        if (lock.lock_for_unpause())
+          unlock();
+        return;
+      }
+
+      LocalSync** best = nullptr;
+      for (auto** curr = &waiters; *curr != nullptr; curr = &(*curr)->next)
+      {
+        if (
+          (best == nullptr) ||
+          ((near != nullptr) &&
+           (near->distance((*curr)->core) < near->distance((*best)->core))))
+          best = curr;
+      }
+
+      LocalSync* chosen = nullptr;
+      if (best != nullptr)
+      {
+        chosen = *best;
+        *best = chosen->next;
+        parked.fetch_sub(1, std::memory_order_relaxed);
+      }
+      unlock();
+
+      if (chosen != nullptr)
+      {
+        Logging::cout() << "Unpause one" << Logging::endl;
+        chosen->wake();
+      }
+    }
+
+    /// Whether any thread is paused.
+    bool has_waiters()
+    {
+      return parked.load(std::memory_order_relaxed) != 0;
+    }
+
+    /**
+     * Wake the retired thread whose core is nearest `near`, or any retired
+     * thread if `near` is nullptr. Gives up, returning false, if another
+     * thread holds the lock or none is retired.
+     */
+    bool unretire_one(T*, Core* near)
+    {
+      if (!lock.try_lock())
+        return false;
+
+      LocalSync** best = nullptr;
+      for (auto** curr = &retired; *curr != nullptr; curr = &(*curr)->next)
+      {
+        if (
+          (best == nullptr) ||
+          ((near != nullptr) &&
+           (near->distance((*curr)->core) < near->distance((*best)->core))))
+          best = curr;
+      }
+
+      LocalSync* chosen = nullptr;
+      if (best != nullptr)
+      {
+        chosen = *best;
+        *best = chosen->next;
+      }
+      unlock();
+
+      if (chosen == nullptr)
+        return false;
+
+      Logging::cout() << "Unretire one" << Logging::endl;
+      chosen->wake();
+      return true;
+    }
+
     class ThreadSyncHandle
     {
       T* thread;
@@ -147,33 +276,98 @@ namespace verona::rt
 
     public:
       /**
-       * Wake up all threads in the thread pool
+       * Wake up all threads in the thread pool, retired ones included
        *
        * Will only occur once the handle is dropped.
        */
       void unpause_all()
       {
+        while (sync.retired != nullptr)
+        {
+          auto* r = sync.retired;
+          sync.retired = r->next;
+          r->next = sync.waiters;
+          sync.waiters = r;
+        }
         wake_on_exit = true;
       }
 
       /**
-       * Pause this thread
+       * Pause this thread, for at most `timeout_ns` nanoseconds unless that
+       * is 0.
        *
        * If this is the last thread, then something external must call
        * unpause_all to restart the paused threads.
        */
-      void pause()
+      void pause(uint64_t timeout_ns = 0)
       {
+        auto& local = thread->local_sync;
+        // While there are FdPoller sources, one paused thread waits on them
+        // rather than on its semaphore, and is woken through the FdPoller.
+        local.polling = FdPoller::try_claim_wait();
+
         Logging::cout() << "Add to list of waiters" << Logging::endl;
-        thread->local_sync.next = sync.waiters;
-        sync.waiters = &(thread->local_sync);
+        local.next = sync.waiters;
+        local.core = thread->core;
+        sync.waiters = &local;
+        sync.parked.fetch_add(1, std::memory_order_relaxed);
         sync.unlock();
 
         Logging::cout() << "Sleep" << Logging::endl;
-        thread->local_sync.sem.sleep();
+        bool woken = true;
+        if (local.polling)
+          woken = FdPoller::wait(timeout_ns);
+        else if (timeout_ns == 0)
+          local.sem.sleep();
+        else
+          woken = local.sem.sleep_for(timeout_ns);
         Logging::cout() << "Awake!" << Logging::endl;
 
         sync.lock.lock();
+
+        if (!woken && !sync.remove_waiter(&local))
+        {
+          // An unpause took this thread off the list as it timed out, and
+          // its wake is on the way. Take it, so that the next sleep is not
+          // cut short.
+          sync.unlock();
+          if (local.polling)
+          {
+            while (!FdPoller::wait(0))
+            {
+            }
+          }
+          else
+          {
+            local.sem.sleep();
+          }
+          sync.lock.lock();
+        }
+
+        if (local.polling)
+        {
+          local.polling = false;
+          FdPoller::release_wait();
+        }
+      }
+
+      /**
+       * Pause this thread until unretire_one() picks it, or all threads
+       * are woken for teardown. Unlike pause(), new work does not wake it.
+       */
+      void retire()
+      {
+        Logging::cout() << "Add to list of retired" << Logging::endl;
+        thread->local_sync.next = sync.retired;
+        thread->local_sync.core = thread->core;
+        sync.retired = &(thread->local_sync);
+        sync.unlock();
+
+        Logging::cout() << "Retired" << Logging::endl;
+        thread->local_sync.sem.sleep();
+        Logging::cout() << "Unretired" << Logging::endl;
+
+        sync.lock.lock();
       }
 
       ThreadSyncHandle(T* thread, ThreadSync& sync) : thread(thread), sync(sync)
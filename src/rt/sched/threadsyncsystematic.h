@@ -2,7 +2,9 @@
 // SPDX-License-Identifier: MIT
 
 #pragma once
+#include "core.h"
 #include "debug/logging.h"
+#include "poller.h"
 
 #include <condition_variable>
 #include <mutex>
@@ -52,13 +54,21 @@ namespace verona::rt
       }
 
       /**
-       * Pause this thread
+       * Pause this thread. Time is not modelled, so with a timeout, or with
+       * FdPoller sources to watch, this only yields.
        */
-      void pause()
+      void pause(uint64_t timeout_ns = 0)
       {
         assert(sync.m == true);
         sync.m = false;
 
+        if ((timeout_ns != 0) || (FdPoller::get_sources() != 0))
+        {
+          Systematic::yield();
+          sync.acquire();
+          return;
+        }
+
         auto incarnation = sync.unpause_incarnation;
         // Copy for capture by value
         auto sync_ptr = &sync;
@@ -72,6 +82,14 @@ namespace verona::rt
         sync.acquire();
       }
 
+      /**
+       * Retired threads are not told apart here, so this pauses.
+       */
+      void retire()
+      {
+        pause();
+      }
+
       ThreadSyncHandle(ThreadSyncSystematic& sync) : sync(sync) {}
 
       ~ThreadSyncHandle()
@@ -109,5 +127,29 @@ namespace verona::rt
     {
       handle(me).unpause_all();
     }
+
+    /**
+     * Paused threads are not tracked individually here, so this unpauses
+     * all threads.
+     */
+    void unpause_one(T* me, Core*)
+    {
+      unpause_all(me);
+    }
+
+    bool has_waiters()
+    {
+      return false;
+    }
+
+    /**
+     * Retired threads are paused as any other, so this unpauses all
+     * threads.
+     */
+    bool unretire_one(T* me, Core*)
+    {
+      unpause_all(me);
+      return true;
+    }
   };
 }
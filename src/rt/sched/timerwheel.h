@@ -0,0 +1,280 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "work.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <snmalloc/snmalloc.h>
+
+namespace verona::rt
+{
+  /**
+   * Work that is to be scheduled once its deadline has passed (see
+   * ThreadPool::schedule_after()).
+   *
+   * Each scheduler thread has a hierarchical timer wheel of its own. It has
+   * LEVELS levels of SLOTS slots each. A slot of the finest level spans
+   * 2^SLOT_BITS ns, about a millisecond, and a slot of each level above
+   * spans a whole turn of the level below. A timer goes in the slot of the
+   * coarsest level it needs, at a cost of O(1). Each time the wheel reaches
+   * that slot the timer moves down a level, until it fires from the finest.
+   * A bit mask per level records which slots hold timers, so the time of
+   * the next event, which the thread sleeps until when it parks, is found
+   * without scanning the slots.
+   *
+   * Timers are never early, and may be late by up to a slot of the finest
+   * level, or by however long the thread takes to get back to its wheel.
+   *
+   * Timers armed off the scheduler threads wait in a shared list until a
+   * scheduler thread adopts them onto its wheel.
+   */
+  class TimerWheel
+  {
+  public:
+    /// log2 of the nanoseconds spanned by a slot of the finest level.
+    static constexpr size_t SLOT_BITS = 20;
+    static constexpr size_t LEVEL_BITS = 6;
+    static constexpr size_t SLOTS = size_t(1) << LEVEL_BITS;
+    static constexpr size_t LEVELS = 4;
+
+  private:
+    struct Timer
+    {
+      Timer* next;
+      /// In slots of the finest level.
+      uint64_t deadline;
+      Work* work;
+    };
+
+    Timer* slots[LEVELS][SLOTS] = {};
+    uint64_t occupied[LEVELS] = {};
+
+    /// The slot of the finest level, counted from time 0, that the wheel
+    /// has reached.
+    uint64_t current = 0;
+
+    /// Number of timers on this wheel.
+    size_t count = 0;
+
+    /// Timers armed off the scheduler threads, linked through next.
+    static inline std::atomic<Timer*> incoming{nullptr};
+
+    /// Number of timers that have not fired, on any wheel or incoming.
+    static inline std::atomic<size_t> pending{0};
+
+    static Timer* make(uint64_t deadline_ns, Work* w)
+    {
+      auto* t = new (heap::alloc(sizeof(Timer))) Timer;
+      // Rounded up, so that the timer never fires early.
+      t->deadline =
+        (deadline_ns + (uint64_t(1) << SLOT_BITS) - 1) >> SLOT_BITS;
+      t->work = w;
+      pending.fetch_add(1, std::memory_order_relaxed);
+      return t;
+    }
+
+    /**
+     * Put `t` on the wheel, firing no earlier than the slot `base`.
+     */
+    void insert(Timer* t, uint64_t base)
+    {
+      uint64_t at = std::max(t->deadline, base);
+      uint64_t delta = at - current;
+
+      size_t level = 0;
+      while ((level + 1 < LEVELS) &&
+             ((delta >> (LEVEL_BITS * (level + 1))) != 0))
+        level++;
+
+      // Beyond the reach of the wheel, the timer waits in the top level,
+      // and is put back when the wheel gets round to it.
+      if ((delta >> (LEVEL_BITS * LEVELS)) != 0)
+        at = current + (uint64_t(1) << (LEVEL_BITS * LEVELS)) - 1;
+
+      size_t index = (at >> (LEVEL_BITS * level)) & (SLOTS - 1);
+      t->next = slots[level][index];
+      slots[level][index] = t;
+      occupied[level] |= uint64_t(1) << index;
+    }
+
+    Timer* take(size_t level, size_t index)
+    {
+      Timer* t = slots[level][index];
+      slots[level][index] = nullptr;
+      occupied[level] &= ~(uint64_t(1) << index);
+      return t;
+    }
+
+    /**
+     * The first slot of the finest level after `current` at which the
+     * wheel has timers to fire, or to move down a level.
+     */
+    uint64_t next_tick()
+    {
+      uint64_t next = UINT64_MAX;
+      for (size_t level = 0; level < LEVELS; level++)
+      {
+        uint64_t mask = occupied[level];
+        if (mask == 0)
+          continue;
+
+        // Count the slots of this level from the one after the current
+        // one, round to the current one itself.
+        size_t shift = LEVEL_BITS * level;
+        uint64_t here = current >> shift;
+        size_t from = (here + 1) & (SLOTS - 1);
+        uint64_t rotated =
+          (mask >> from) | (mask << ((SLOTS - from) & (SLOTS - 1)));
+        uint64_t ahead = snmalloc::bits::ctz(rotated) + 1;
+        next = std::min(next, (here + ahead) << shift);
+      }
+      return next;
+    }
+
+    /**
+     * Move the wheel on to the slot `tick`, moving down the timers of the
+     * coarser slots it starts, and firing those in the finest slot.
+     */
+    template<typename F>
+    void process(uint64_t tick, F& fire)
+    {
+      current = tick;
+      for (size_t level = LEVELS - 1; level > 0; level--)
+      {
+        size_t shift = LEVEL_BITS * level;
+        if ((tick & ((uint64_t(1) << shift) - 1)) != 0)
+          continue;
+
+        Timer* t = take(level, (tick >> shift) & (SLOTS - 1));
+        while (t != nullptr)
+        {
+          Timer* next = t->next;
+          insert(t, tick);
+          t = next;
+        }
+      }
+
+      Timer* t = take(0, tick & (SLOTS - 1));
+      while (t != nullptr)
+      {
+        Timer* next = t->next;
+        Work* w = t->work;
+        heap::dealloc(t, sizeof(Timer));
+        count--;
+        pending.fetch_sub(1, std::memory_order_relaxed);
+        fire(w);
+        t = next;
+      }
+    }
+
+  public:
+    static TimerWheel& local()
+    {
+      static thread_local TimerWheel wheel;
+      return wheel;
+    }
+
+    ~TimerWheel()
+    {
+      assert(count == 0);
+    }
+
+    /**
+     * Arm a timer for `w`, due once the TickClock reaches `deadline_ns`.
+     * `now_ns` is the time now.
+     */
+    void add(uint64_t deadline_ns, Work* w, uint64_t now_ns)
+    {
+      if (count == 0)
+        current = now_ns >> SLOT_BITS;
+      count++;
+      insert(make(deadline_ns, w), current + 1);
+    }
+
+    /**
+     * As add(), from a thread that has no wheel. A scheduler thread adopts
+     * the timer later.
+     */
+    static void add_external(uint64_t deadline_ns, Work* w)
+    {
+      Timer* t = make(deadline_ns, w);
+      Timer* h = incoming.load(std::memory_order_relaxed);
+      do
+      {
+        t->next = h;
+      } while (!incoming.compare_exchange_weak(
+        h, t, std::memory_order_release, std::memory_order_relaxed));
+    }
+
+    /**
+     * Take the timers armed off the scheduler threads onto this wheel.
+     */
+    void adopt(uint64_t now_ns)
+    {
+      if (incoming.load(std::memory_order_relaxed) == nullptr)
+        return;
+
+      Timer* t = incoming.exchange(nullptr, std::memory_order_acquire);
+      if (count == 0)
+        current = now_ns >> SLOT_BITS;
+      while (t != nullptr)
+      {
+        Timer* next = t->next;
+        count++;
+        insert(t, current + 1);
+        t = next;
+      }
+    }
+
+    /**
+     * Call `fire` with the work of each timer due by `now_ns`, a slot of
+     * the finest level at a time.
+     */
+    template<typename F>
+    void advance(uint64_t now_ns, F&& fire)
+    {
+      uint64_t now = now_ns >> SLOT_BITS;
+      while (count != 0)
+      {
+        uint64_t tick = next_tick();
+        if (tick > now)
+          break;
+        process(tick, fire);
+      }
+
+      // Nothing is due in between, so the wheel can skip to now.
+      current = std::max(current, now);
+    }
+
+    bool empty() const
+    {
+      return count == 0;
+    }
+
+    /**
+     * When, on the TickClock, this wheel next has something to do, or
+     * UINT64_MAX if it is empty.
+     */
+    uint64_t next_deadline_ns()
+    {
+      if (count == 0)
+        return UINT64_MAX;
+      return next_tick() << SLOT_BITS;
+    }
+
+    /// Whether timers are waiting to be adopted.
+    static bool has_incoming()
+    {
+      return incoming.load(std::memory_order_relaxed) != nullptr;
+    }
+
+    /// Number of timers that have not fired yet, on any thread.
+    static size_t get_pending()
+    {
+      return pending.load(std::memory_order_relaxed);
+    }
+  };
+} // namespace verona::rt
@@ -11,6 +11,17 @@ namespace verona::rt
 {
   using namespace snmalloc;
 
+  /**
+   * The class of a behaviour. Each core keeps its low priority work in a
+   * queue of its own, which its scheduler thread serves less often than
+   * the high priority one, and never from the local next_work slot.
+   */
+  enum class Priority
+  {
+    High,
+    Low
+  };
+
   /**
    * @brief A work item that can be scheduled.
    *
@@ -26,6 +37,12 @@ namespace verona::rt
     // pointer and is responsible for all casting and memory management.
     void (*f)(Work*);
 
+#ifdef USE_SCHED_STATS
+    // The tick the work was last scheduled at, or 0, for
+    // SchedulerStats::queue_wait().
+    uint64_t scheduled_at = 0;
+#endif
+
     constexpr Work(void (*f)(Work*)) : f(f) {}
 
     // Helper to run the item.
@@ -36,6 +36,39 @@ namespace verona::rt
       enqueue(ls);
     }
 
+    /**
+     * Take everything in `q`, keeping one item to return and spreading the
+     * rest across our queues.
+     */
+    Work* steal_from(MPMCQ<Work>& q)
+    {
+      auto ls = q.dequeue_all();
+
+      auto r = ls.take_one();
+      if (r == nullptr)
+      {
+        // take_one can fail for three reasons:
+        //  * fully empty
+        //  * single element
+        //  * first link in segment assignment has not become visible
+        // Handle single element segment case
+        if (ls.end == nullptr)
+        {
+          // Fully empty case
+          return nullptr;
+        }
+
+        if (ls.start != nullptr && ls.end == &ls.start->next_in_queue)
+        {
+          // Single element queue.
+          return ls.start;
+        }
+      }
+
+      enqueue_spread(ls);
+      return r;
+    }
+
   public:
     constexpr WorkStealingQueue() {}
 
@@ -45,6 +78,13 @@ namespace verona::rt
       enqueue({work, &work->next_in_queue});
     }
 
+    // Enqueue a linked segment of nodes onto the next enqueue queue, in
+    // one operation.
+    void enqueue_segment(MPMCQ<Work>::Segment ls)
+    {
+      enqueue(ls);
+    }
+
     void enqueue_front(Work* work)
     {
       queues[dequeue_index--].enqueue_front(work);
@@ -73,8 +113,12 @@ namespace verona::rt
      * queues. Returns nullptr if no work could be stolen. This may spuriously
      * return nullptr in the case where the first link in the segment has not
      * been created, and there are more than two elements.
+     *
+     * By default this empties one of the victim's queues. With `half`, it
+     * empties half of them, taking about half of the victim's work in one
+     * steal, so that a thief facing a backlog comes back less often.
      */
-    Work* steal(WorkStealingQueue& victim)
+    Work* steal(WorkStealingQueue& victim, bool half = false)
     {
       if (&victim == this)
       {
@@ -85,30 +129,16 @@ namespace verona::rt
         return nullptr;
       }
 
-      auto ls = victim.queues[steal_index].dequeue_all();
-
-      auto r = ls.take_one();
-      if (r == nullptr)
+      size_t count = half ? (N + 1) / 2 : 1;
+      Work* r = nullptr;
+      for (size_t i = 0; i < count; i++)
       {
-        // take_one can fail for three reasons:
-        //  * fully empty
-        //  * single element
-        //  * first link in segment assignment has not become visible
-        // Handle single element segment case
-        if (ls.end == nullptr)
-        {
-          // Fully empty case
-          return nullptr;
-        }
-
-        if (ls.start != nullptr && ls.end == &ls.start->next_in_queue)
-        {
-          // Single element queue.
-          return ls.start;
-        }
+        Work* w = steal_from(victim.queues[(steal_index + i) % N]);
+        if (r == nullptr)
+          r = w;
+        else if (w != nullptr)
+          enqueue(w);
       }
-
-      enqueue_spread(ls);
       return r;
     }
 
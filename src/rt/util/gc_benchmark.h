@@ -10,78 +10,337 @@
 #include <functional>
 #include <iomanip>
 #include <iostream>
+#include <pal/memory_sampler.h>
 #include <region/region_api.h>
+#include <util/latency_histogram.h>
 #include <sstream>
-#include <unordered_map>
+#include <type_traits>
+#include <iterator>
 
 #include <vector>
 #include <filesystem>
 
 namespace verona::rt::api
 {
+  /// Number of RegionType values, for per-type tables.
+  inline constexpr size_t REGION_TYPE_COUNT = 7;
+
+  /// Windows for which minimum mutator utilisation is reported, 1ms to 1s.
+  inline constexpr uint64_t MMU_WINDOWS_NS[] = {
+    1000000,
+    2000000,
+    5000000,
+    10000000,
+    20000000,
+    50000000,
+    100000000,
+    200000000,
+    500000000,
+    1000000000};
+  inline constexpr size_t MMU_WINDOW_COUNT = std::size(MMU_WINDOWS_NS);
+
+  /**
+   * When the GC pauses of one run happened, relative to the start of the
+   * run, and the minimum mutator utilisation (MMU) that follows from them.
+   *
+   * The MMU for a window size is the smallest fraction of any window of
+   * that size, within the run, that was not spent in a pause. Pauses on
+   * different threads that overlap are counted once, so this is the
+   * utilisation of the time in which no thread was collecting.
+   */
+  class PauseTimeline
+  {
+  public:
+    struct Pause
+    {
+      uint64_t start_ns;
+      uint64_t duration_ns;
+      RegionType type;
+    };
+
+  private:
+    std::vector<Pause> pauses;
+    uint64_t begin_ns = 0;
+    uint64_t length_ns = 0;
+
+    /// Pauses as sorted, disjoint [start, end) intervals.
+    std::vector<std::pair<uint64_t, uint64_t>> merged() const
+    {
+      std::vector<std::pair<uint64_t, uint64_t>> iv;
+      iv.reserve(pauses.size());
+      for (const auto& p : pauses)
+        iv.emplace_back(p.start_ns, p.start_ns + p.duration_ns);
+      std::sort(iv.begin(), iv.end());
+
+      size_t n = 0;
+      for (const auto& i : iv)
+      {
+        if (n != 0 && i.first <= iv[n - 1].second)
+          iv[n - 1].second = std::max(iv[n - 1].second, i.second);
+        else
+          iv[n++] = i;
+      }
+      iv.resize(n);
+      return iv;
+    }
+
+  public:
+    /// Set the span of the run, as GCEvent::now() timestamps.
+    void set_span(uint64_t begin, uint64_t end)
+    {
+      begin_ns = begin;
+      length_ns = end > begin ? end - begin : 0;
+      for (auto& p : pauses)
+        p.start_ns = p.start_ns > begin ? p.start_ns - begin : 0;
+    }
+
+    /// Add a pause, timed with GCEvent::now(), before set_span().
+    void add(uint64_t start_ns, uint64_t duration_ns, RegionType type)
+    {
+      pauses.push_back({start_ns, duration_ns, type});
+    }
+
+    const std::vector<Pause>& get_pauses() const
+    {
+      return pauses;
+    }
+
+    uint64_t get_length() const
+    {
+      return length_ns;
+    }
+
+    /**
+     * The minimum mutator utilisation for windows of `window_ns`, from 0
+     * to 1, or -1 if the run was shorter than the window.
+     */
+    double mmu(uint64_t window_ns) const
+    {
+      if (window_ns == 0 || window_ns > length_ns)
+        return -1;
+
+      auto iv = merged();
+      std::vector<uint64_t> prefix(iv.size() + 1, 0);
+      for (size_t i = 0; i < iv.size(); i++)
+        prefix[i + 1] = prefix[i] + (iv[i].second - iv[i].first);
+
+      // Time paused in [a, a + window_ns).
+      auto paused = [&](uint64_t a) {
+        uint64_t b = a + window_ns;
+        size_t i = (size_t)(std::upper_bound(
+                              iv.begin(),
+                              iv.end(),
+                              a,
+                              [](uint64_t v, const auto& x) {
+                                return v < x.second;
+                              }) -
+                            iv.begin());
+        size_t j = (size_t)(std::lower_bound(
+                              iv.begin(),
+                              iv.end(),
+                              b,
+                              [](const auto& x, uint64_t v) {
+                                return x.first < v;
+                              }) -
+                            iv.begin());
+        if (i >= j)
+          return uint64_t(0);
+        uint64_t t = prefix[j] - prefix[i];
+        if (iv[i].first < a)
+          t -= a - iv[i].first;
+        if (iv[j - 1].second > b)
+          t -= iv[j - 1].second - b;
+        return t;
+      };
+
+      // Time paused is piecewise linear in the window's start, so its
+      // maximum is where either edge of the window meets a pause's edge.
+      uint64_t last = length_ns - window_ns;
+      auto starting = [&](uint64_t a) { return paused(std::min(a, last)); };
+      auto ending = [&](uint64_t b) {
+        return starting(b > window_ns ? b - window_ns : 0);
+      };
+
+      uint64_t worst = paused(0);
+      for (const auto& i : iv)
+      {
+        worst = std::max({worst, starting(i.first), starting(i.second)});
+        worst = std::max({worst, ending(i.first), ending(i.second)});
+      }
+      worst = std::min(worst, window_ns);
+      return 1.0 - (double)worst / (double)window_ns;
+    }
+  };
+
   /**
    * Internal collector for gathering GC and memory measurements.
+   *
+   * Pause times go into fixed size histograms, overall and per region
+   * type, rather than a vector of every event, so a run with millions of
+   * collections costs no more memory than one with a few.
    */
   class TestMeasurementCollector
   {
   private:
-    std::vector<std::pair<uint64_t, RegionType>> measurements;
-    uint64_t total_duration_ns = 0;
-    std::unordered_map<int, uint64_t> duration_by_type;
-    std::unordered_map<int, size_t> count_by_type;
+    LatencyHistogram all;
+    LatencyHistogram by_type[REGION_TYPE_COUNT];
+
+    /// Region type of the first event, or -1 before there is one.
+    int first_type = -1;
+
+    PauseTimeline timeline;
+
+    // Hardware counters, phase times and the collectors' work, summed
+    // over the events
+    PerfCounters::Values counters;
+    GCPhases::Totals phases;
+    uint64_t bytes_freed = 0;
+    size_t objects_survived = 0;
+    size_t max_remembered_set = 0;
+    uint64_t harness_ns = 0;
+
+    // Live memory after each collection, and the share of the memory
+    // before it that survived, for those that started with any. Releases
+    // leave nothing, so they are not counted.
+    size_t collections = 0;
+    size_t memory_after_total = 0;
+    size_t peak_memory_after = 0;
+    double survival_total = 0;
+    size_t survival_events = 0;
 
     // Memory tracking (captured at each GC event)
-    std::vector<size_t> memory_samples;
-    std::vector<size_t> object_samples;
+    size_t memory_total = 0;
+    size_t object_total = 0;
     size_t peak_memory_bytes = 0;
     size_t peak_object_count = 0;
 
   public:
-    void record_gc_measurement(
-      uint64_t duration_ns,
-      RegionType region_type,
-      size_t memory_before,
-      size_t objects_before)
+    void record_gc_measurement(const GCEvent& e)
     {
-      measurements.push_back({duration_ns, region_type});
-      total_duration_ns += duration_ns;
-      duration_by_type[(int)region_type] += duration_ns;
-      count_by_type[(int)region_type]++;
+      all.record(e.duration_ns);
+      timeline.add(e.start_ns, e.duration_ns, e.type);
+      if ((size_t)e.type < REGION_TYPE_COUNT)
+        by_type[(size_t)e.type].record(e.duration_ns);
+      if (first_type < 0)
+        first_type = (int)e.type;
 
-      // Track memory samples for average calculation
-      memory_samples.push_back(memory_before);
-      object_samples.push_back(objects_before);
+      // Track memory totals for average calculation
+      memory_total += e.memory_before;
+      object_total += e.objects_before;
 
       // Track peak memory (before GC, when it's highest)
-      peak_memory_bytes = std::max(peak_memory_bytes, memory_before);
-      peak_object_count = std::max(peak_object_count, objects_before);
+      peak_memory_bytes = std::max(peak_memory_bytes, e.memory_before);
+      peak_object_count = std::max(peak_object_count, e.objects_before);
+
+      counters += e.counters;
+      for (size_t p = 0; p < GCPhases::COUNT; p++)
+        phases.ns[p] += e.phase_ns[p];
+      phases.bytes_copied += e.bytes_copied;
+      bytes_freed += e.bytes_freed;
+      objects_survived += e.objects_survived;
+      max_remembered_set = std::max(max_remembered_set, e.remembered_set_size);
+      harness_ns += e.harness_ns;
+
+      if (e.released)
+        return;
+      collections++;
+      memory_after_total += e.memory_after;
+      peak_memory_after = std::max(peak_memory_after, e.memory_after);
+      if (e.memory_before != 0)
+      {
+        survival_total += (double)e.memory_after / (double)e.memory_before;
+        survival_events++;
+      }
+    }
+
+    const PerfCounters::Values& get_counters() const
+    {
+      return counters;
+    }
+
+    const GCPhases::Totals& get_phases() const
+    {
+      return phases;
+    }
+
+    uint64_t get_bytes_freed() const
+    {
+      return bytes_freed;
+    }
+
+    /// Time spent measuring the events, outside the pauses.
+    uint64_t get_harness_time() const
+    {
+      return harness_ns;
+    }
+
+    size_t get_average_survivors() const
+    {
+      return all.count() == 0 ? 0 : objects_survived / all.count();
+    }
+
+    size_t get_max_remembered_set() const
+    {
+      return max_remembered_set;
+    }
+
+    size_t get_average_memory_after() const
+    {
+      return collections == 0 ? 0 : memory_after_total / collections;
+    }
+
+    size_t get_peak_memory_after() const
+    {
+      return peak_memory_after;
+    }
+
+    /// Mean over the events of the fraction of memory that survived them.
+    double get_survival_ratio() const
+    {
+      return survival_events == 0 ? 0 : survival_total / survival_events;
     }
 
     uint64_t get_total_gc_time() const
     {
-      return total_duration_ns;
+      return all.sum();
     }
 
     size_t get_gc_count() const
     {
-      return measurements.size();
+      return all.count();
     }
 
     size_t get_gc_count_by_type(RegionType type) const
     {
-      auto it = count_by_type.find((int)type);
-      return it != count_by_type.end() ? it->second : 0;
+      return (size_t)type < REGION_TYPE_COUNT ?
+        by_type[(size_t)type].count() :
+        0;
     }
 
     uint64_t get_gc_time_by_type(RegionType type) const
     {
-      auto it = duration_by_type.find((int)type);
-      return it != duration_by_type.end() ? it->second : 0;
+      return (size_t)type < REGION_TYPE_COUNT ? by_type[(size_t)type].sum() :
+                                                0;
     }
 
-    const std::vector<std::pair<uint64_t, RegionType>>& get_measurements() const
+    const LatencyHistogram& get_histogram() const
     {
-      return measurements;
+      return all;
+    }
+
+    const LatencyHistogram& get_histogram(size_t type) const
+    {
+      return by_type[type];
+    }
+
+    int get_first_type() const
+    {
+      return first_type;
+    }
+
+    PauseTimeline& get_timeline()
+    {
+      return timeline;
     }
 
     size_t get_peak_memory() const
@@ -96,37 +355,89 @@ namespace verona::rt::api
 
     size_t get_average_memory() const
     {
-      if (memory_samples.empty())
-        return 0;
-      size_t total = 0;
-      for (size_t m : memory_samples)
-        total += m;
-      return total / memory_samples.size();
+      return all.count() == 0 ? 0 : memory_total / all.count();
     }
 
     size_t get_average_objects() const
     {
-      if (object_samples.empty())
-        return 0;
-      size_t total = 0;
-      for (size_t o : object_samples)
-        total += o;
-      return total / object_samples.size();
+      return all.count() == 0 ? 0 : object_total / all.count();
     }
 
     void reset()
     {
-      measurements.clear();
-      total_duration_ns = 0;
-      duration_by_type.clear();
-      count_by_type.clear();
-      memory_samples.clear();
-      object_samples.clear();
+      all.reset();
+      for (auto& h : by_type)
+        h.reset();
+      first_type = -1;
+      timeline = PauseTimeline();
+      counters = {};
+      phases = {};
+      bytes_freed = 0;
+      objects_survived = 0;
+      max_remembered_set = 0;
+      collections = 0;
+      memory_after_total = 0;
+      peak_memory_after = 0;
+      survival_total = 0;
+      survival_events = 0;
+      memory_total = 0;
+      object_total = 0;
       peak_memory_bytes = 0;
       peak_object_count = 0;
+      harness_ns = 0;
+    }
+  };
+
+  /// A 95% confidence interval for the mean of some samples.
+  struct ConfidenceInterval
+  {
+    size_t samples = 0;
+    double mean = 0;
+    double half_width = 0;
+
+    /// Half width as a fraction of the mean, or 0 for fewer than two
+    /// samples or a zero mean.
+    double relative() const
+    {
+      return mean == 0 ? 0 : half_width / mean;
     }
   };
 
+  /**
+   * The 95% confidence interval for the mean of `values`, from Student's
+   * t distribution.
+   */
+  inline ConfidenceInterval confidence_interval(
+    const std::vector<double>& values)
+  {
+    // Two-sided 97.5% quantiles for 1 to 30 degrees of freedom.
+    static constexpr double T_975[] = {
+      12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+      2.201,  2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+      2.080,  2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042};
+
+    ConfidenceInterval ci;
+    ci.samples = values.size();
+    if (values.empty())
+      return ci;
+
+    for (double v : values)
+      ci.mean += v;
+    ci.mean /= (double)values.size();
+    if (values.size() < 2)
+      return ci;
+
+    double squares = 0;
+    for (double v : values)
+      squares += (v - ci.mean) * (v - ci.mean);
+    size_t df = values.size() - 1;
+    double sd = std::sqrt(squares / (double)df);
+    // Past the table, a close approximation to the quantile.
+    double t = df <= std::size(T_975) ? T_975[df - 1] : 1.96 + 2.4 / df;
+    ci.half_width = t * sd / std::sqrt((double)values.size());
+    return ci;
+  }
+
   /**
    * Harness for benchmarking GC performance across multiple runs.
    * Collects GC timing and memory metrics.
@@ -134,6 +445,33 @@ namespace verona::rt::api
   class GCBenchmark
   {
   public:
+    /// What run_adaptive() measures until it is precise enough.
+    enum class AdaptiveMetric
+    {
+      RunTime,
+      P99Pause,
+    };
+
+    /**
+     * When run_adaptive() stops warming up and stops measuring.
+     */
+    struct AdaptivePolicy
+    {
+      /// Warmup ends once the coefficient of variation of the run times of
+      /// the last `window` warmup runs is below `warmup_cov`, or after
+      /// `max_warmup_runs` runs.
+      size_t window = 5;
+      double warmup_cov = 0.05;
+      size_t max_warmup_runs = 50;
+      /// Measurement ends once the 95% confidence interval of the mean of
+      /// `metric` is within `precision` of the mean, as a fraction, after
+      /// at least `min_runs` runs and at most `max_runs`.
+      AdaptiveMetric metric = AdaptiveMetric::RunTime;
+      double precision = 0.05;
+      size_t min_runs = 5;
+      size_t max_runs = 100;
+    };
+
     struct Result
     {
       // GC timing metrics
@@ -141,6 +479,7 @@ namespace verona::rt::api
       size_t gc_call_count;
       uint64_t average_gc_time_ns;
       uint64_t max_gc_time_ns;
+      uint64_t p99_gc_time_ns;
       // Memory metrics
       size_t peak_memory_bytes;
       size_t peak_object_count;
@@ -148,12 +487,55 @@ namespace verona::rt::api
       size_t avg_object_count;
       // Wall-clock timing
       uint64_t total_run_time_ns;
+      // ChunkCache lookups
+      size_t chunk_cache_hits;
+      size_t chunk_cache_misses;
+      // Arena space of the regions released, and how much of it was left
+      // unused before the last arena
+      size_t arena_chunk_bytes;
+      size_t arena_wasted_bytes;
+      // Reference counting work in the Rc regions released
+      RegionRc::OpStats rc_ops;
+      // When each pause happened, and the MMU for each of MMU_WINDOWS_NS
+      PauseTimeline timeline;
+      double mmu[MMU_WINDOW_COUNT];
+      // Allocation by region type, counted by every thread
+      AllocStats::Counters alloc[REGION_TYPE_COUNT];
+      // Hardware counters over the GC pauses, and over the whole run on
+      // every thread, if PerfCounters is enabled
+      PerfCounters::Values gc_counters;
+      PerfCounters::Values run_counters;
+      // Time the pauses spent in each GCPhases::Phase, and the bytes they
+      // copied
+      GCPhases::Totals gc_phases;
+      // Bytes the pauses freed, objects left after the average pause, and
+      // the largest remembered set after any
+      uint64_t gc_bytes_freed;
+      size_t avg_objects_survived;
+      size_t max_remembered_set;
+      // Live memory after the average collection and at its highest, and
+      // the mean fraction of memory that survived a collection
+      size_t avg_memory_after_bytes;
+      size_t peak_memory_after_bytes;
+      double survival_ratio;
+      // Memory of the whole process over the run, sampled by MemorySampler
+      MemorySampler::Summary process_memory;
+      // Time spent measuring the pauses, outside them
+      uint64_t harness_ns;
     };
 
   private:
     std::vector<Result> run_results;
-    std::vector<uint64_t> all_gc_measurements;
-    std::vector<std::pair<uint64_t, RegionType>> all_gc_measurements_with_type;
+    /// Pause times of every run, overall and by region type.
+    LatencyHistogram all_gc;
+    LatencyHistogram all_gc_by_type[REGION_TYPE_COUNT];
+    /// Region type of the first event of any run, or -1.
+    int first_type = -1;
+    /// Warmup runs of the last run_benchmark() or run_adaptive().
+    size_t warmup_count = 0;
+    /// What the results are named after instead of the region type, or
+    /// empty.
+    std::string variant;
 
   public:
     /**
@@ -197,6 +579,55 @@ namespace verona::rt::api
       size_t warmup_runs = 0,
       const char* test_name = "Test");
 
+    /**
+     * Run `test_fn` as many times as `policy` needs: warm up until the run
+     * time settles, then measure until the chosen metric is known
+     * precisely enough. The summary reports the confidence reached.
+     */
+    void run_adaptive(
+      std::function<void()> test_fn,
+      const AdaptivePolicy& policy,
+      const char* test_name = "Test");
+
+    /**
+     * Run `test_fn` once without measuring it, and return its run time in
+     * nanoseconds. run_benchmark() does this for each warmup run; callers
+     * interleaving several benchmarks use it directly.
+     */
+    uint64_t warmup_run(const std::function<void()>& test_fn);
+
+    /**
+     * Run `test_fn` once and add its metrics to the results, as
+     * run_benchmark() does for each measured run.
+     */
+    void measure_run(const std::function<void()>& test_fn);
+
+    /**
+     * Write the results of measured run `run` to `out`, in a binary form
+     * that read_run() in a process of the same build reads back, so that
+     * runs made in other processes can be added to these results.
+     */
+    void write_run(std::ostream& out, size_t run) const;
+
+    /**
+     * Read a run written by write_run() and add it to the results, as
+     * measure_run() would have. Returns false, and adds nothing, if `in`
+     * does not hold a whole run.
+     */
+    bool read_run(std::istream& in);
+
+    /// Set the warmup runs reported, for runs made outside run_benchmark().
+    void set_warmup_runs(size_t runs)
+    {
+      warmup_count = runs;
+    }
+
+    /**
+     * The name print_summary() is given by run_benchmark(): `test_name`
+     * without its directory or extension.
+     */
+    static std::string summary_name(const char* test_name);
+
     /**
      * Print summary statistics
      */
@@ -205,11 +636,119 @@ namespace verona::rt::api
     /**
      * Write raw data to a CSV file for visualization tools.
      * Format:
-     * run,gc_time_ns,gc_calls,max_gc_ns,avg_mem_bytes,peak_mem_bytes,peak_objects
+     * run,gc_time_ns,gc_calls,max_gc_ns,avg_mem_bytes,peak_mem_bytes,peak_objects,
+     * run_time_ns,chunk_cache_hits,chunk_cache_misses,arena_chunk_bytes,
+     * arena_wasted_bytes,rc_increfs,rc_decrefs,rc_zero_frees,rc_cycle_roots,
+     * rc_reds,rc_greens,avg_mem_after_bytes,peak_mem_after_bytes,
+     * reclaimed_bytes,survival_ratio,rss_avg_bytes,rss_peak_bytes,
+     * allocator_avg_bytes,allocator_peak_bytes
      */
     void write_csv(const char* filename) const;
 
+    /**
+     * Write the CSV that write_csv() would, without the pause timeline,
+     * to `file`.
+     */
+    void write_csv(std::ostream& file) const;
+
+    /**
+     * The directory write_csv() writes the CSVs of `test_name` to, under
+     * CSVs/ at the root of the repository. Created if it does not exist.
+     */
+    static std::filesystem::path csv_directory(const std::string& test_name);
+
+    /**
+     * The results of each measured run, in order.
+     */
+    const std::vector<Result>& get_results() const
+    {
+      return run_results;
+    }
+
+    /**
+     * The region type of the first GC event of any run, or -1 if there
+     * were none.
+     */
+    int get_region_type() const
+    {
+      return first_type;
+    }
+
+    size_t get_warmup_runs() const
+    {
+      return warmup_count;
+    }
+
+    /**
+     * Name the results `name` instead of after the region type of their
+     * first GC event, for runs that do not use regions, such as the native
+     * baselines of the benchmarks.
+     */
+    void set_variant(const std::string& name)
+    {
+      variant = name;
+    }
+
+    const std::string& get_variant() const
+    {
+      return variant;
+    }
+
+    /// The 95% confidence interval of `metric` over the measured runs.
+    ConfidenceInterval get_confidence(AdaptiveMetric metric) const
+    {
+      std::vector<double> values;
+      for (const auto& r : run_results)
+        values.push_back(
+          metric == AdaptiveMetric::RunTime ? (double)r.total_run_time_ns :
+                                              (double)r.p99_gc_time_ns);
+      return confidence_interval(values);
+    }
+
+    /**
+     * Write the pause timeline of every run to a CSV file, as
+     * run,start_ns,duration_ns,type with start_ns relative to the run.
+     */
+    void write_timeline_csv(const std::string& path) const;
+
   private:
+    /**
+     * Apply `f` to every field of `r` but its timeline, all of which are
+     * trivially copyable.
+     */
+    template<typename R, typename F>
+    static void for_each_field(R& r, F&& f)
+    {
+      f(r.total_gc_time_ns);
+      f(r.gc_call_count);
+      f(r.average_gc_time_ns);
+      f(r.max_gc_time_ns);
+      f(r.p99_gc_time_ns);
+      f(r.peak_memory_bytes);
+      f(r.peak_object_count);
+      f(r.avg_memory_bytes);
+      f(r.avg_object_count);
+      f(r.total_run_time_ns);
+      f(r.chunk_cache_hits);
+      f(r.chunk_cache_misses);
+      f(r.arena_chunk_bytes);
+      f(r.arena_wasted_bytes);
+      f(r.rc_ops);
+      f(r.mmu);
+      f(r.alloc);
+      f(r.gc_counters);
+      f(r.run_counters);
+      f(r.gc_phases);
+      f(r.gc_bytes_freed);
+      f(r.avg_objects_survived);
+      f(r.max_remembered_set);
+      f(r.avg_memory_after_bytes);
+      f(r.peak_memory_after_bytes);
+      f(r.survival_ratio);
+      f(r.process_memory);
+      f(r.harness_ns);
+    }
+
     inline uint64_t get_average_gc_time() const
     {
       if (run_results.empty())
@@ -230,6 +769,103 @@ namespace verona::rt::api
       return total / run_results.size();
     }
 
+    /// Lowest MMU of any run for window `w`, or -1 if no run was long
+    /// enough to measure it.
+    inline double get_worst_mmu(size_t w) const
+    {
+      double worst = -1;
+      for (const auto& result : run_results)
+      {
+        if (result.mmu[w] >= 0 && (worst < 0 || result.mmu[w] < worst))
+          worst = result.mmu[w];
+      }
+      return worst;
+    }
+
+    /// Allocation counters for region type `t`, summed over the runs.
+    inline AllocStats::Counters get_alloc_totals(size_t t) const
+    {
+      AllocStats::Counters total;
+      for (const auto& result : run_results)
+      {
+        const auto& a = result.alloc[t];
+        total.bytes += a.bytes;
+        total.objects += a.objects;
+        total.slow_paths += a.slow_paths;
+        for (size_t b = 0; b < AllocStats::LATENCY_BUCKETS; b++)
+          total.latency[b] += a.latency[b];
+      }
+      return total;
+    }
+
+    /// MB/s of the bytes in `totals` over the total run time of the runs.
+    inline double alloc_throughput(const AllocStats::Counters& totals) const
+    {
+      uint64_t run_time = 0;
+      for (const auto& result : run_results)
+        run_time += result.total_run_time_ns;
+      if (run_time == 0)
+        return 0;
+      return ((double)totals.bytes / (1024.0 * 1024.0)) /
+        ((double)run_time / 1e9);
+    }
+
+    /// Hardware counters summed over the runs, over the GC pauses if `gc`
+    /// and over the whole runs otherwise.
+    inline PerfCounters::Values get_counter_totals(bool gc) const
+    {
+      PerfCounters::Values total;
+      for (const auto& result : run_results)
+        total += gc ? result.gc_counters : result.run_counters;
+      return total;
+    }
+
+    inline GCPhases::Totals get_phase_totals() const
+    {
+      GCPhases::Totals total;
+      for (const auto& result : run_results)
+      {
+        for (size_t p = 0; p < GCPhases::COUNT; p++)
+          total.ns[p] += result.gc_phases.ns[p];
+        total.bytes_copied += result.gc_phases.bytes_copied;
+      }
+      return total;
+    }
+
+    static void print_counters(const char* label, const PerfCounters::Values& v)
+    {
+      std::cout << "  " << std::left << std::setw(5) << label << std::right;
+      for (size_t c = 0; c < PerfCounters::COUNT; c++)
+      {
+        std::cout << " " << PerfCounters::NAMES[c] << ": ";
+        if (v.has((PerfCounters::Counter)c))
+          std::cout << v.value[c];
+        else
+          std::cout << "n/a";
+      }
+      if (
+        v.has(PerfCounters::Cycles) && v.has(PerfCounters::Instructions) &&
+        v.value[PerfCounters::Cycles] != 0)
+      {
+        std::cout << " IPC: " << std::fixed << std::setprecision(2)
+                  << (double)v.value[PerfCounters::Instructions] /
+            (double)v.value[PerfCounters::Cycles];
+      }
+      std::cout << "\n";
+    }
+
+    static void write_counters(
+      std::ostream& out, const char* label, const PerfCounters::Values& v)
+    {
+      out << "#counters=" << label;
+      for (size_t c = 0; c < PerfCounters::COUNT; c++)
+      {
+        if (v.has((PerfCounters::Counter)c))
+          out << "," << PerfCounters::NAMES[c] << "=" << v.value[c];
+      }
+      out << "\n";
+    }
+
     inline size_t get_average_peak_memory() const
     {
       if (run_results.empty())
@@ -266,13 +902,27 @@ namespace verona::rt::api
       return oss.str();
     }
 
-    inline uint64_t calculate_percentile(
-      const std::vector<uint64_t>& sorted_values, double percentile) const
+    /// Percentiles reported for each histogram, and their CSV names.
+    static constexpr double PERCENTILES[] = {50, 90, 99, 99.9, 99.99};
+    static constexpr const char* PERCENTILE_NAMES[] = {
+      "p50", "p90", "p99", "p99.9", "p99.99"};
+
+    static void
+    print_percentiles(const char* label, const LatencyHistogram& h)
     {
-      if (sorted_values.empty())
-        return 0;
-      size_t idx = (size_t)((percentile / 100.0) * (sorted_values.size() - 1));
-      return sorted_values[idx];
+      std::cout << "  " << std::left << std::setw(14) << label << std::right;
+      for (size_t i = 0; i < std::size(PERCENTILES); i++)
+        std::cout << " " << PERCENTILE_NAMES[i] << ": "
+                  << h.percentile(PERCENTILES[i]);
+      std::cout << " max: " << h.max() << " ns (" << h.count() << " calls)\n";
+    }
+
+    static void write_percentiles(std::ostream& out, const LatencyHistogram& h)
+    {
+      for (size_t i = 0; i < std::size(PERCENTILES); i++)
+        out << "," << PERCENTILE_NAMES[i]
+            << "_ns=" << h.percentile(PERCENTILES[i]);
+      out << ",max_ns=" << h.max();
     }
 
     inline double calculate_normalized_jitter(
@@ -296,31 +946,15 @@ namespace verona::rt::api
   inline void GCBenchmark::run_benchmark(
     std::function<void()> test_fn, size_t num_runs, size_t warmup_runs, const char* test_name)
   {
+    warmup_count = warmup_runs;
+
     // Warmup phase
     if (warmup_runs > 0)
     {
       std::cout << "=== Warmup Phase (" << warmup_runs << " runs) ===\n";
       for (size_t warmup = 0; warmup < warmup_runs; warmup++)
       {
-        TestMeasurementCollector dummy_collector;
-
-        // Create callback that captures the dummy collector
-        std::function<void(uint64_t, RegionType, size_t, size_t)> callback =
-          [&dummy_collector](
-            uint64_t duration_ns, RegionType type, size_t mem, size_t obj) {
-            dummy_collector.record_gc_measurement(duration_ns, type, mem, obj);
-          };
-
-        {
-          // Enable callback for warmup
-          auto prev = get_gc_callback();
-          set_gc_callback(&callback);
-
-          test_fn();
-
-          // Restore previous callback
-          set_gc_callback(prev);
-        }
+        warmup_run(test_fn);
         std::cout << "Warmup " << (warmup + 1) << " complete\n";
       }
       std::cout << "\n=== Measurement Phase (" << num_runs << " runs) ===\n\n";
@@ -331,84 +965,251 @@ namespace verona::rt::api
     {
       std::cout << "\n--- Benchmark Run " << (run + 1) << " of " << num_runs
                 << " ---\n";
+      measure_run(test_fn);
+    }
+    print_summary(summary_name(test_name).c_str());
+  }
 
-      TestMeasurementCollector collector;
+  inline std::string GCBenchmark::summary_name(const char* test_name)
+  {
+    std::string path = test_name;
+    size_t pos = path.find_last_of("/\\");
+    if (pos != std::string::npos)
+      path = path.substr(pos + 1);
 
-      // Create callback that captures the collector
-      std::function<void(uint64_t, RegionType, size_t, size_t)> callback =
-        [&collector](
-          uint64_t duration_ns, RegionType type, size_t mem, size_t obj) {
-          collector.record_gc_measurement(duration_ns, type, mem, obj);
-        };
+    size_t dot = path.find_last_of('.');
+    if (dot != std::string::npos)
+      path = path.substr(0, dot);
+    return path;
+  }
 
-      uint64_t run_time_ns;
-      {
-        // Enable callback for this run
-        auto prev = get_gc_callback();
-        set_gc_callback(&callback);
+  inline void GCBenchmark::run_adaptive(
+    std::function<void()> test_fn,
+    const AdaptivePolicy& policy,
+    const char* test_name)
+  {
+    // Warm up until the run times of the last `window` runs vary little.
+    std::cout << "=== Adaptive Warmup (CoV < " << policy.warmup_cov
+              << " over " << policy.window << " runs) ===\n";
+    std::vector<uint64_t> times;
+    warmup_count = 0;
+    while (warmup_count < policy.max_warmup_runs)
+    {
+      times.push_back(warmup_run(test_fn));
+      warmup_count++;
+      if (times.size() < std::max<size_t>(policy.window, 2))
+        continue;
+
+      std::vector<uint64_t> last(times.end() - policy.window, times.end());
+      uint64_t sum = 0;
+      for (uint64_t t : last)
+        sum += t;
+      double cov = calculate_normalized_jitter(last, sum / last.size());
+      std::cout << "Warmup " << warmup_count << " CoV: " << cov << "\n";
+      if (cov < policy.warmup_cov)
+        break;
+    }
 
-        // If wall_time_ns_out is provided, test_fn measures internally
-        // and writes elapsed nanoseconds there. Otherwise measure test_fn.
-        if (wall_time_ns_out)
-        {
-          *wall_time_ns_out = 0;
-          test_fn();
-          run_time_ns = *wall_time_ns_out;
-        }
-        else
-        {
-          auto t_start = std::chrono::high_resolution_clock::now();
-          test_fn();
-          auto t_end = std::chrono::high_resolution_clock::now();
-          run_time_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(t_end - t_start).count();
-        }
+    // Measure until the confidence interval is narrow enough.
+    std::cout << "\n=== Adaptive Measurement (95% CI within "
+              << policy.precision * 100 << "%, at most " << policy.max_runs
+              << " runs) ===\n\n";
+    while (run_results.size() < policy.max_runs)
+    {
+      std::cout << "\n--- Benchmark Run " << (run_results.size() + 1)
+                << " ---\n";
+      measure_run(test_fn);
+      if (run_results.size() < std::max<size_t>(policy.min_runs, 2))
+        continue;
+      if (get_confidence(policy.metric).relative() <= policy.precision)
+        break;
+    }
+    print_summary(summary_name(test_name).c_str());
+  }
 
-        // Restore previous callback
-        set_gc_callback(prev);
-      }
+  inline void GCBenchmark::write_run(std::ostream& out, size_t run) const
+  {
+    auto put = [&out](const auto& v) {
+      static_assert(std::is_trivially_copyable_v<std::decay_t<decltype(v)>>);
+      out.write((const char*)&v, sizeof(v));
+    };
+
+    const Result& r = run_results[run];
+    for_each_field(r, put);
+    put(r.timeline.get_length());
+    put(r.timeline.get_pauses().size());
+    for (const auto& p : r.timeline.get_pauses())
+      put(p);
+  }
 
-      // Record all GC measurements
-      uint64_t total_time = collector.get_total_gc_time();
-      size_t total_calls = collector.get_gc_count();
+  inline bool GCBenchmark::read_run(std::istream& in)
+  {
+    auto get = [&in](auto& v) { in.read((char*)&v, sizeof(v)); };
+
+    Result r{};
+    for_each_field(r, get);
+    uint64_t length = 0;
+    size_t count = 0;
+    get(length);
+    get(count);
+    for (size_t i = 0; in && (i < count); i++)
+    {
+      PauseTimeline::Pause p;
+      get(p);
+      r.timeline.add(p.start_ns, p.duration_ns, p.type);
+    }
+    if (!in)
+      return false;
+    r.timeline.set_span(0, length);
+
+    // The timeline has every pause, so the histograms can be rebuilt.
+    for (const auto& p : r.timeline.get_pauses())
+    {
+      all_gc.record(p.duration_ns);
+      if ((size_t)p.type < REGION_TYPE_COUNT)
+        all_gc_by_type[(size_t)p.type].record(p.duration_ns);
+    }
+    if ((first_type < 0) && (count != 0))
+      first_type = (int)r.timeline.get_pauses().front().type;
+    run_results.push_back(std::move(r));
+    return true;
+  }
 
-      uint64_t avg_time = total_calls > 0 ? total_time / total_calls : 0;
+  inline uint64_t
+  GCBenchmark::warmup_run(const std::function<void()>& test_fn)
+  {
+    // Collect events from every thread during warmup, and discard them
+    GCEventSink::set_enabled(true);
+    uint64_t run_time_ns;
+    if (wall_time_ns_out)
+    {
+      *wall_time_ns_out = 0;
+      test_fn();
+      run_time_ns = *wall_time_ns_out;
+    }
+    else
+    {
+      auto t_start = std::chrono::high_resolution_clock::now();
+      test_fn();
+      auto t_end = std::chrono::high_resolution_clock::now();
+      run_time_ns =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(t_end - t_start)
+          .count();
+    }
+    GCEventSink::set_enabled(false);
+    GCEventSink::drain([](const GCEvent&) {});
+    return run_time_ns;
+  }
 
-      // Track max and collect all measurements for global stats
-      uint64_t max_time = 0;
-      for (const auto& m : collector.get_measurements())
+  inline void GCBenchmark::measure_run(const std::function<void()>& test_fn)
+  {
+    TestMeasurementCollector collector;
+
+    uint64_t run_time_ns;
+    uint64_t run_begin_ns = GCEvent::now();
+    ChunkCache::reset_stats();
+    RegionArena::reset_fragmentation_stats();
+    RegionRc::reset_op_stats();
+    AllocStats::reset();
+    PerfCounters::Values run_counters;
+    MemorySampler::Summary process_memory;
+    {
+      // Counts this thread and the threads the test starts, such as the
+      // scheduler's, once they have exited.
+      PerfCounters::Inherited run_perf;
+      MemorySampler sampler;
+      sampler.start();
+
+      // Collect the events of every thread that runs part of the test,
+      // not just this one.
+      GCEventSink::set_enabled(true);
+
+      // If wall_time_ns_out is provided, test_fn measures internally
+      // and writes elapsed nanoseconds there. Otherwise measure test_fn.
+      if (wall_time_ns_out)
       {
-        all_gc_measurements.push_back(m.first);
-        all_gc_measurements_with_type.push_back(m);
-        max_time = std::max(max_time, m.first);
+        *wall_time_ns_out = 0;
+        test_fn();
+        run_time_ns = *wall_time_ns_out;
+      }
+      else
+      {
+        auto t_start = std::chrono::high_resolution_clock::now();
+        test_fn();
+        auto t_end = std::chrono::high_resolution_clock::now();
+        run_time_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(t_end - t_start).count();
       }
 
-      run_results.push_back(
-        {total_time,
-         total_calls,
-         avg_time,
-         max_time,
-         collector.get_peak_memory(),
-         collector.get_peak_objects(),
-         collector.get_average_memory(),
-         collector.get_average_objects(),
-         run_time_ns});
-
-      std::cout << "Run " << (run + 1) << " - Time: " << (run_time_ns / 1000000) << " ms"
-                << " | GC: " << total_time << " ns ("
-                << total_calls << " calls) | Avg Mem: "
-                << format_bytes(collector.get_average_memory())
-                << " | Peak: " << format_bytes(collector.get_peak_memory())
-                << " (" << collector.get_peak_objects() << " obj)\n";
+      GCEventSink::set_enabled(false);
+      process_memory = sampler.stop();
+      run_counters = run_perf.read();
     }
-    std::string path = test_name;
-    size_t pos = path.find_last_of("/\\");
-    if (pos != std::string::npos)
-      path = path.substr(pos + 1);
-    
-    size_t dot = path.find_last_of('.');
-    if (dot != std::string::npos)
-      path = path.substr(0, dot);
-    print_summary(path.c_str());
+    uint64_t run_end_ns = GCEvent::now();
+
+    size_t dropped = GCEventSink::drain(
+      [&collector](const GCEvent& e) { collector.record_gc_measurement(e); });
+    if (dropped > 0)
+      std::cout << "Warning: " << dropped
+                << " GC events were dropped, results are incomplete\n";
+
+    // Record all GC measurements
+    uint64_t total_time = collector.get_total_gc_time();
+    size_t total_calls = collector.get_gc_count();
+
+    uint64_t avg_time = total_calls > 0 ? total_time / total_calls : 0;
+
+    // Merge this run's pause times into the global stats
+    uint64_t max_time = collector.get_histogram().max();
+    all_gc.merge(collector.get_histogram());
+    for (size_t t = 0; t < REGION_TYPE_COUNT; t++)
+      all_gc_by_type[t].merge(collector.get_histogram(t));
+    if (first_type < 0)
+      first_type = collector.get_first_type();
+
+    PauseTimeline& timeline = collector.get_timeline();
+    timeline.set_span(run_begin_ns, run_end_ns);
+
+    auto cache_stats = ChunkCache::get_stats();
+    auto arena_stats = RegionArena::get_fragmentation_stats();
+    Result& r = run_results.emplace_back();
+    r.total_gc_time_ns = total_time;
+    r.gc_call_count = total_calls;
+    r.average_gc_time_ns = avg_time;
+    r.max_gc_time_ns = max_time;
+    r.p99_gc_time_ns = collector.get_histogram().percentile(99);
+    r.peak_memory_bytes = collector.get_peak_memory();
+    r.peak_object_count = collector.get_peak_objects();
+    r.avg_memory_bytes = collector.get_average_memory();
+    r.avg_object_count = collector.get_average_objects();
+    r.total_run_time_ns = run_time_ns;
+    r.chunk_cache_hits = cache_stats.hits;
+    r.chunk_cache_misses = cache_stats.misses;
+    r.arena_chunk_bytes = arena_stats.chunk_bytes;
+    r.arena_wasted_bytes = arena_stats.wasted_bytes;
+    r.rc_ops = RegionRc::get_op_stats();
+    r.timeline = std::move(timeline);
+    for (size_t t = 0; t < REGION_TYPE_COUNT; t++)
+      r.alloc[t] = AllocStats::get((RegionType)t);
+    r.gc_counters = collector.get_counters();
+    r.run_counters = run_counters;
+    r.gc_phases = collector.get_phases();
+    r.gc_bytes_freed = collector.get_bytes_freed();
+    r.avg_objects_survived = collector.get_average_survivors();
+    r.max_remembered_set = collector.get_max_remembered_set();
+    r.avg_memory_after_bytes = collector.get_average_memory_after();
+    r.peak_memory_after_bytes = collector.get_peak_memory_after();
+    r.survival_ratio = collector.get_survival_ratio();
+    r.process_memory = process_memory;
+    r.harness_ns = collector.get_harness_time();
+    for (size_t w = 0; w < MMU_WINDOW_COUNT; w++)
+      r.mmu[w] = r.timeline.mmu(MMU_WINDOWS_NS[w]);
+
+    std::cout << "Run " << run_results.size() << " - Time: " << (run_time_ns / 1000000) << " ms"
+              << " | GC: " << total_time << " ns ("
+              << total_calls << " calls) | Avg Mem: "
+              << format_bytes(collector.get_average_memory())
+              << " | Peak: " << format_bytes(collector.get_peak_memory())
+              << " (" << collector.get_peak_objects() << " obj)\n";
   }
 
   inline void GCBenchmark::print_summary(const char* test_name) const
@@ -423,18 +1224,14 @@ namespace verona::rt::api
     // Auto-write CSV file (convert test name to filename: spaces->underscores,
     // lowercase, append region type if available)
 
-    // Sort measurements for percentile calculation
-    std::vector<uint64_t> sorted_measurements = all_gc_measurements;
-    std::sort(sorted_measurements.begin(), sorted_measurements.end());
-
-    // Collect region type breakdown across all measurements
-    std::unordered_map<int, uint64_t> total_by_type;
-    std::unordered_map<int, size_t> count_by_type;
-    for (const auto& [duration, type] : all_gc_measurements_with_type)
-    {
-      total_by_type[(int)type] += duration;
-      count_by_type[(int)type]++;
-    }
+    const char* type_names[] = {
+      "Trace",
+      "Arena",
+      "Rc",
+      "Semispace",
+      "Generational",
+      "Compact",
+      "Bytes"};
 
     std::cout << "\n" << std::string(90, '=') << "\n";
     std::cout << "Benchmark Summary: " << test_name << "\n";
@@ -488,34 +1285,245 @@ namespace verona::rt::api
               << overall_peak_obj << "\n";
     std::cout << std::string(92, '-') << "\n";
 
-    uint64_t p50 = calculate_percentile(sorted_measurements, 50);
-    uint64_t p99 = calculate_percentile(sorted_measurements, 99);
+    uint64_t p50 = all_gc.percentile(50);
+    uint64_t p99 = all_gc.percentile(99);
     double jitter = (p50 == 0) ? 0 : (double)(p99 - p50) / p50;
 
     std::cout << std::dec << std::fixed << std::setprecision(4);
-    std::cout << "\nGC Timing:\n";
-    std::cout << "  P50: " << p50 << " ns | P99: " << p99 << " ns\n";
+    std::cout << "\nGC Timing (ns):\n";
+    print_percentiles("All", all_gc);
+    for (size_t t = 0; t < REGION_TYPE_COUNT; t++)
+    {
+      if (all_gc_by_type[t].count() != 0)
+        print_percentiles(type_names[t], all_gc_by_type[t]);
+    }
     std::cout << "  Jitter (P99-P50)/P50: " << jitter << "\n";
 
+    // How far the means of the runs can be trusted.
+    ConfidenceInterval run_ci = get_confidence(AdaptiveMetric::RunTime);
+    ConfidenceInterval p99_ci = get_confidence(AdaptiveMetric::P99Pause);
+    std::cout << "\nConfidence (95%, " << run_results.size() << " runs after "
+              << warmup_count << " warmup):\n";
+    std::cout << "  Run time: " << (uint64_t)run_ci.mean << " +/- "
+              << (uint64_t)run_ci.half_width << " ns ("
+              << run_ci.relative() * 100 << "%)\n";
+    std::cout << "  P99 pause: " << (uint64_t)p99_ci.mean << " +/- "
+              << (uint64_t)p99_ci.half_width << " ns ("
+              << p99_ci.relative() * 100 << "%)\n";
+
+    // What measuring costs, so that the times above can be corrected.
+    uint64_t harness = 0;
+    for (const auto& r : run_results)
+      harness += r.harness_ns;
+    std::cout << "\nMeasurement Overhead:\n";
+    std::cout << "  Timer: " << GCEvent::timer_overhead_ns()
+              << " ns per pause (included in each)\n";
+    std::cout << "  Harness: "
+              << (all_gc.count() == 0 ? 0 : harness / all_gc.count())
+              << " ns per pause (outside them), "
+              << harness / run_results.size() << " ns per run\n";
+
+    std::cout << "\nMinimum Mutator Utilisation (worst run):\n";
+    for (size_t w = 0; w < MMU_WINDOW_COUNT; w++)
+    {
+      double worst = get_worst_mmu(w);
+      if (worst < 0)
+        continue;
+      std::cout << "  " << std::right << std::setw(5)
+                << (MMU_WINDOWS_NS[w] / 1000000) << " ms: " << std::fixed
+                << std::setprecision(4) << worst << "\n";
+    }
+
     std::cout << "\nMemory:\n";
     std::cout << "  Average Live Memory: " << format_bytes(overall_avg_mem)
               << " (avg memory at GC events - explains GC frequency)\n";
     std::cout << "  Average Peak Memory: " << format_bytes(overall_peak_mem)
               << " (avg of per-run peaks - ensures GC not unbounded)\n";
 
+    size_t after_avg = 0, after_peak = 0;
+    uint64_t reclaimed = 0;
+    double survival = 0;
+    for (const auto& r : run_results)
+    {
+      after_avg += r.avg_memory_after_bytes;
+      after_peak += r.peak_memory_after_bytes;
+      reclaimed += r.gc_bytes_freed;
+      survival += r.survival_ratio;
+    }
+    std::cout << "  Average Live After GC: "
+              << format_bytes(after_avg / run_results.size())
+              << " | Peak: " << format_bytes(after_peak / run_results.size())
+              << " (avg of per-run values)\n";
+    std::cout << "  Reclaimed per Run: "
+              << format_bytes(reclaimed / run_results.size())
+              << " | Survival Ratio: " << std::fixed << std::setprecision(3)
+              << survival / run_results.size()
+              << " (mean of memory after / memory before)\n";
+
+    // What the process really used, next to what the regions counted
+    size_t rss_avg = 0, rss_peak = 0, alloc_avg = 0, alloc_peak = 0;
+    for (const auto& r : run_results)
+    {
+      rss_avg += r.process_memory.avg_rss;
+      rss_peak += r.process_memory.peak_rss;
+      alloc_avg += r.process_memory.avg_allocator;
+      alloc_peak += r.process_memory.peak_allocator;
+    }
+    if (rss_peak + alloc_peak != 0)
+    {
+      size_t runs = run_results.size();
+      std::cout << "  Process RSS: " << format_bytes(rss_avg / runs)
+                << " avg | " << format_bytes(rss_peak / runs)
+                << " peak (sampled every " << MemorySampler::get_interval()
+                << " us)\n";
+      std::cout << "  Allocator: " << format_bytes(alloc_avg / runs)
+                << " avg | " << format_bytes(alloc_peak / runs)
+                << " peak (from snmalloc, vs "
+                << format_bytes(overall_peak_mem) << " counted by regions)\n";
+    }
+
+    if (ChunkCache::get_capacity() != 0)
+    {
+      size_t hits = 0, misses = 0;
+      for (const auto& r : run_results)
+      {
+        hits += r.chunk_cache_hits;
+        misses += r.chunk_cache_misses;
+      }
+      std::cout << "\nChunk Cache:\n";
+      std::cout << "  Hits: " << hits / run_results.size()
+                << " | Misses: " << misses / run_results.size()
+                << " (avg per run)\n";
+    }
+
+    size_t arena_chunk = 0, arena_wasted = 0;
+    for (const auto& r : run_results)
+    {
+      arena_chunk += r.arena_chunk_bytes;
+      arena_wasted += r.arena_wasted_bytes;
+    }
+    if (arena_chunk != 0)
+    {
+      std::cout << "\nArena Fragmentation:\n";
+      std::cout << "  Chunks: "
+                << format_bytes(arena_chunk / run_results.size())
+                << " | Wasted: "
+                << format_bytes(arena_wasted / run_results.size()) << " ("
+                << std::fixed << std::setprecision(1)
+                << (100.0 * arena_wasted / arena_chunk)
+                << "%, avg per run of released regions)\n";
+    }
+
+    RegionRc::OpStats rc_ops;
+    for (const auto& r : run_results)
+    {
+      rc_ops.increfs += r.rc_ops.increfs;
+      rc_ops.decrefs += r.rc_ops.decrefs;
+      rc_ops.zero_frees += r.rc_ops.zero_frees;
+      rc_ops.cycle_roots += r.rc_ops.cycle_roots;
+      rc_ops.reds += r.rc_ops.reds;
+      rc_ops.greens += r.rc_ops.greens;
+    }
+    if ((rc_ops.increfs + rc_ops.decrefs + rc_ops.cycle_roots) != 0)
+    {
+      size_t runs = run_results.size();
+      std::cout << "\nRc Operations (avg per run of released regions):\n";
+      std::cout << "  Increfs: " << rc_ops.increfs / runs
+                << " | Decrefs: " << rc_ops.decrefs / runs
+                << " | Zero-count frees: " << rc_ops.zero_frees / runs << "\n";
+      std::cout << "  Cycle roots: " << rc_ops.cycle_roots / runs
+                << " | Red: " << rc_ops.reds / runs
+                << " | Restored green: " << rc_ops.greens / runs << "\n";
+    }
+
+    // Allocation throughput against the mean run time, for each region
+    // type that allocated. Only counted when ENABLE_BENCHMARKING is defined.
+    bool alloc_header = false;
+    for (size_t t = 0; t < REGION_TYPE_COUNT; t++)
+    {
+      AllocStats::Counters a = get_alloc_totals(t);
+      if (a.objects == 0)
+        continue;
+      if (!alloc_header)
+      {
+        std::cout << "\nAllocation (avg per run):\n";
+        alloc_header = true;
+      }
+      size_t runs = run_results.size();
+      std::cout << "  " << std::left << std::setw(12) << type_names[t]
+                << std::right << " " << a.objects / runs << " objects, "
+                << format_bytes(a.bytes / runs) << ", " << std::fixed
+                << std::setprecision(1) << alloc_throughput(a)
+                << " MB/s | Slow paths: " << a.slow_paths / runs
+                << " | Sampled latency p50: " << a.latency_percentile(50)
+                << " p99: " << a.latency_percentile(99) << " cycles\n";
+    }
+
+    // Where the pauses spent their time. Only counted when
+    // ENABLE_BENCHMARKING is defined.
+    GCPhases::Totals phases = get_phase_totals();
+    uint64_t phased = 0;
+    for (uint64_t ns : phases.ns)
+      phased += ns;
+    if (phased != 0)
+    {
+      uint64_t gc_total = 0;
+      for (const auto& r : run_results)
+        gc_total += r.total_gc_time_ns;
+      std::cout << "\nGC Phases (avg per run):\n";
+      for (size_t p = 0; p < GCPhases::COUNT; p++)
+      {
+        if (phases.ns[p] == 0)
+          continue;
+        std::cout << "  " << std::left << std::setw(20) << GCPhases::NAMES[p]
+                  << std::right << phases.ns[p] / run_results.size()
+                  << " ns (" << std::fixed << std::setprecision(1)
+                  << (gc_total == 0 ? 0.0 : 100.0 * phases.ns[p] / gc_total)
+                  << "% of GC time)\n";
+      }
+    }
+
+    uint64_t freed = 0;
+    size_t survivors = 0, remembered = 0;
+    for (const auto& r : run_results)
+    {
+      freed += r.gc_bytes_freed;
+      survivors += r.avg_objects_survived;
+      remembered = std::max(remembered, r.max_remembered_set);
+    }
+    if (phases.bytes_copied + freed != 0)
+    {
+      size_t runs = run_results.size();
+      std::cout << "\nGC Work (avg per run):\n";
+      std::cout << "  Copied: " << format_bytes(phases.bytes_copied / runs)
+                << " | Freed: " << format_bytes(freed / runs)
+                << " | Survivors per pause: " << survivors / runs
+                << " | Largest remembered set: " << remembered << "\n";
+    }
+
+    if (PerfCounters::is_enabled())
+    {
+      std::cout << "\nHardware Counters (total over all runs):\n";
+      print_counters("GC", get_counter_totals(true));
+      print_counters("Run", get_counter_totals(false));
+    }
+
     // Show per-region-type breakdown if multiple types were used
-    if (count_by_type.size() > 1)
+    size_t types_used = 0;
+    for (const auto& h : all_gc_by_type)
+      types_used += (h.count() != 0) ? 1 : 0;
+    if (types_used > 1)
     {
       std::cout << "\nPer-Region Type:\n";
-      const char* type_names[] = {"Trace", "Arena", "Rc", "Semispace"};
-      for (const auto& [type_id, count] : count_by_type)
+      for (size_t t = 0; t < REGION_TYPE_COUNT; t++)
       {
-        uint64_t total = total_by_type[type_id];
-        uint64_t avg = count > 0 ? total / count : 0;
-        const char* name =
-          (type_id >= 0 && type_id < 4) ? type_names[type_id] : "Unknown";
-        std::cout << "  " << std::left << std::setw(6) << name << " - " << count
-                  << " calls, " << total << " ns total, " << avg << " ns avg\n";
+        const auto& h = all_gc_by_type[t];
+        if (h.count() == 0)
+          continue;
+        uint64_t avg = h.sum() / h.count();
+        std::cout << "  " << std::left << std::setw(6) << type_names[t]
+                  << " - " << h.count() << " calls, " << h.sum()
+                  << " ns total, " << avg << " ns avg\n";
       }
     }
     std::cout << std::string(90, '=') << "\n";
@@ -534,11 +1542,22 @@ namespace verona::rt::api
     }
       // Determine region type from measurements (if available)
       std::string region_type_str;
-      if (!all_gc_measurements_with_type.empty())
+      if (!variant.empty())
+      {
+        region_type_str = "_" + variant;
+      }
+      else if (first_type >= 0)
       {
-        int region_type = (int)all_gc_measurements_with_type[0].second;
-        const char* type_names[] = {"trace", "arena", "rc", "semispace"};
-        if (region_type >= 0 && region_type < 4)
+        int region_type = first_type;
+        const char* type_names[] = {
+          "trace",
+          "arena",
+          "rc",
+          "semispace",
+          "generational",
+          "compact",
+          "bytes"};
+        if (region_type >= 0 && region_type < (int)REGION_TYPE_COUNT)
           region_type_str = std::string("_") + type_names[region_type];
         else
           region_type_str = "_unknown";
@@ -546,12 +1565,7 @@ namespace verona::rt::api
 
 
 
-    // Ensure CSVs directory exists (platform-independent)
-    // Always use repo root for CSVs directory, 3 parents up from this file
-    std::filesystem::path this_file = std::filesystem::canonical(__FILE__);
-    std::filesystem::path repo_root = this_file.parent_path().parent_path().parent_path().parent_path();
-    std::string dir = (repo_root / "CSVs" / filename_str).string();
-    std::filesystem::create_directories(dir);
+    std::string dir = csv_directory(filename_str).string();
     csv_filename += region_type_str + ".csv";
     std::string base_filename = std::filesystem::path(csv_filename).filename().string();
     std::string fullpath = dir + "/" + base_filename;
@@ -563,6 +1577,33 @@ namespace verona::rt::api
       return;
     }
 
+    write_csv(file);
+    if (run_results.empty())
+      return;
+
+    // Pause timelines go in a subdirectory, so that tools looking for
+    // summary CSVs do not pick them up.
+    std::filesystem::path timeline_dir =
+      std::filesystem::path(dir) / "timeline";
+    std::filesystem::create_directories(timeline_dir);
+    write_timeline_csv((timeline_dir / base_filename).string());
+  }
+
+  inline std::filesystem::path
+  GCBenchmark::csv_directory(const std::string& test_name)
+  {
+    // Ensure CSVs directory exists (platform-independent)
+    // Always use repo root for CSVs directory, 3 parents up from this file
+    std::filesystem::path this_file = std::filesystem::canonical(__FILE__);
+    std::filesystem::path repo_root =
+      this_file.parent_path().parent_path().parent_path().parent_path();
+    std::filesystem::path dir = repo_root / "CSVs" / test_name;
+    std::filesystem::create_directories(dir);
+    return dir;
+  }
+
+  inline void GCBenchmark::write_csv(std::ostream& file) const
+  {
     if (run_results.empty())
     {
       file << "# No benchmark results\n";
@@ -570,10 +1611,8 @@ namespace verona::rt::api
     }
 
     // Calculate P50, P99, jitter
-    std::vector<uint64_t> sorted_measurements = all_gc_measurements;
-    std::sort(sorted_measurements.begin(), sorted_measurements.end());
-    uint64_t p50 = calculate_percentile(sorted_measurements, 50.0);
-    uint64_t p99 = calculate_percentile(sorted_measurements, 99.0);
+    uint64_t p50 = all_gc.percentile(50.0);
+    uint64_t p99 = all_gc.percentile(99.0);
     double jitter = p50 > 0 ? static_cast<double>(p99 - p50) / p50 : 0.0;
 
     // Calculate overall averages
@@ -588,7 +1627,12 @@ namespace verona::rt::api
 
     // CSV header
     file << "run,gc_time_ns,gc_calls,max_gc_ns,avg_mem_bytes,peak_mem_bytes,"
-            "peak_objects,run_time_ns\n";
+            "peak_objects,run_time_ns,chunk_cache_hits,chunk_cache_misses,"
+            "arena_chunk_bytes,arena_wasted_bytes,rc_increfs,rc_decrefs,"
+            "rc_zero_frees,rc_cycle_roots,rc_reds,rc_greens,"
+            "avg_mem_after_bytes,peak_mem_after_bytes,reclaimed_bytes,"
+            "survival_ratio,rss_avg_bytes,rss_peak_bytes,allocator_avg_bytes,"
+            "allocator_peak_bytes\n";
 
     // Per-run data
     for (size_t i = 0; i < run_results.size(); ++i)
@@ -597,13 +1641,136 @@ namespace verona::rt::api
       file << (i + 1) << "," << r.total_gc_time_ns << "," << r.gc_call_count
            << "," << r.max_gc_time_ns << "," << r.avg_memory_bytes << ","
            << r.peak_memory_bytes << "," << r.peak_object_count << ","
-           << r.total_run_time_ns << "\n";
+           << r.total_run_time_ns << "," << r.chunk_cache_hits << ","
+           << r.chunk_cache_misses << "," << r.arena_chunk_bytes << ","
+           << r.arena_wasted_bytes << "," << r.rc_ops.increfs << ","
+           << r.rc_ops.decrefs << "," << r.rc_ops.zero_frees << ","
+           << r.rc_ops.cycle_roots << "," << r.rc_ops.reds << ","
+           << r.rc_ops.greens << "," << r.avg_memory_after_bytes << ","
+           << r.peak_memory_after_bytes << "," << r.gc_bytes_freed << ","
+           << std::fixed << std::setprecision(6) << r.survival_ratio << ","
+           << r.process_memory.avg_rss << "," << r.process_memory.peak_rss
+           << "," << r.process_memory.avg_allocator << ","
+           << r.process_memory.peak_allocator << "\n";
     }
 
     // Summary row
     file << "#p50_ns=" << p50 << ",p99_ns=" << p99 << ",jitter=" << std::fixed
          << std::setprecision(4) << jitter << ",avg_mem=" << overall_avg_mem
          << ",peak_mem=" << overall_peak_mem << "\n";
+
+    // 95% confidence intervals of the means over the runs
+    ConfidenceInterval run_ci = get_confidence(AdaptiveMetric::RunTime);
+    ConfidenceInterval p99_ci = get_confidence(AdaptiveMetric::P99Pause);
+    file << "#ci95,runs=" << run_results.size()
+         << ",warmup_runs=" << warmup_count << ",run_time_ns=" << run_ci.mean
+         << ",run_time_half_ns=" << run_ci.half_width
+         << ",p99_pause_ns=" << p99_ci.mean
+         << ",p99_pause_half_ns=" << p99_ci.half_width << "\n";
+
+    // Pause time percentiles, overall and for each region type used
+    const char* type_names[] = {
+      "trace", "arena", "rc", "semispace", "generational", "compact", "bytes"};
+    file << "#type=all,calls=" << all_gc.count();
+    write_percentiles(file, all_gc);
+    file << "\n";
+    for (size_t t = 0; t < REGION_TYPE_COUNT; t++)
+    {
+      if (all_gc_by_type[t].count() == 0)
+        continue;
+      file << "#type=" << type_names[t]
+           << ",calls=" << all_gc_by_type[t].count();
+      write_percentiles(file, all_gc_by_type[t]);
+      file << "\n";
+    }
+
+    // Allocation, summed over the runs, for each region type that allocated
+    for (size_t t = 0; t < REGION_TYPE_COUNT; t++)
+    {
+      AllocStats::Counters a = get_alloc_totals(t);
+      if (a.objects == 0)
+        continue;
+      file << "#alloc_type=" << type_names[t] << ",objects=" << a.objects
+           << ",bytes=" << a.bytes << ",mb_per_s=" << alloc_throughput(a)
+           << ",slow_paths=" << a.slow_paths
+           << ",p50_cycles=" << a.latency_percentile(50)
+           << ",p99_cycles=" << a.latency_percentile(99) << "\n";
+    }
+
+    // Time in each GC phase, summed over the runs
+    GCPhases::Totals phases = get_phase_totals();
+    file << "#phases=gc";
+    for (size_t p = 0; p < GCPhases::COUNT; p++)
+      file << "," << GCPhases::NAMES[p] << "_ns=" << phases.ns[p];
+    file << "\n";
+
+    // What the collectors did, summed over the runs
+    uint64_t freed = 0;
+    size_t survivors = 0, remembered = 0;
+    for (const auto& r : run_results)
+    {
+      freed += r.gc_bytes_freed;
+      survivors += r.avg_objects_survived;
+      remembered = std::max(remembered, r.max_remembered_set);
+    }
+    file << "#work=gc,bytes_copied=" << phases.bytes_copied
+         << ",bytes_freed=" << freed
+         << ",avg_survivors=" << survivors / run_results.size()
+         << ",max_remembered_set=" << remembered << "\n";
+
+    // Hardware counters summed over the runs, if they were read
+    if (PerfCounters::is_enabled())
+    {
+      write_counters(file, "gc", get_counter_totals(true));
+      write_counters(file, "run", get_counter_totals(false));
+    }
+
+    // Minimum mutator utilisation, worst and mean over the runs long
+    // enough to measure each window
+    for (size_t w = 0; w < MMU_WINDOW_COUNT; w++)
+    {
+      double worst = get_worst_mmu(w);
+      if (worst < 0)
+        continue;
+      double total = 0;
+      size_t runs = 0;
+      for (const auto& r : run_results)
+      {
+        if (r.mmu[w] >= 0)
+        {
+          total += r.mmu[w];
+          runs++;
+        }
+      }
+      file << "#mmu_window_ns=" << MMU_WINDOWS_NS[w] << ",mmu_min=" << worst
+           << ",mmu_mean=" << (total / runs) << "\n";
+    }
+  }
+
+  inline void GCBenchmark::write_timeline_csv(const std::string& path) const
+  {
+    std::ofstream file(path);
+    if (!file.is_open())
+    {
+      std::cerr << "Error: Could not open file " << path << " for writing\n";
+      return;
+    }
+
+    const char* type_names[] = {
+      "trace", "arena", "rc", "semispace", "generational", "compact", "bytes"};
+    file << "run,start_ns,duration_ns,type\n";
+    for (size_t i = 0; i < run_results.size(); ++i)
+    {
+      const auto& timeline = run_results[i].timeline;
+      file << "#run=" << (i + 1) << ",length_ns=" << timeline.get_length()
+           << "\n";
+      for (const auto& p : timeline.get_pauses())
+      {
+        size_t t = (size_t)p.type;
+        file << (i + 1) << "," << p.start_ns << "," << p.duration_ns << ","
+             << (t < REGION_TYPE_COUNT ? type_names[t] : "unknown") << "\n";
+      }
+    }
   }
 
 } // namespace verona::rt::api
@@ -0,0 +1,199 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <snmalloc/snmalloc.h>
+#include <vector>
+
+namespace verona::rt::api
+{
+  /**
+   * A fixed size histogram of latencies in the style of an HDR histogram:
+   * values are counted in buckets whose width grows with the value, so
+   * that any value is recorded to within 1/SUB_BUCKETS of itself, whatever
+   * its magnitude. Recording is O(1), percentiles are O(number of
+   * buckets), and histograms merge by adding their counts.
+   */
+  class LatencyHistogram
+  {
+    friend class ConcurrentLatencyHistogram;
+
+  public:
+    static constexpr size_t SUB_BUCKET_BITS = 7;
+    static constexpr size_t SUB_BUCKETS = size_t(1) << SUB_BUCKET_BITS;
+
+  private:
+    /// Values below SUB_BUCKETS get a bucket each; above that, each power
+    /// of two is split into SUB_BUCKETS buckets.
+    static constexpr size_t BUCKETS = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+    std::vector<uint64_t> counts = std::vector<uint64_t>(BUCKETS, 0);
+    uint64_t total_count = 0;
+    uint64_t total_sum = 0;
+    uint64_t max_value = 0;
+
+    static size_t bucket_of(uint64_t v)
+    {
+      if (v < SUB_BUCKETS)
+        return static_cast<size_t>(v);
+
+      size_t msb = 63 - snmalloc::bits::clz(static_cast<size_t>(v));
+      size_t shift = msb - SUB_BUCKET_BITS;
+      return ((shift + 1) * SUB_BUCKETS) +
+        static_cast<size_t>((v >> shift) - SUB_BUCKETS);
+    }
+
+    /// The largest value that is counted in bucket `b`.
+    static uint64_t highest_in(size_t b)
+    {
+      if (b < SUB_BUCKETS)
+        return b;
+
+      size_t shift = (b / SUB_BUCKETS) - 1;
+      uint64_t lowest = uint64_t(SUB_BUCKETS + (b % SUB_BUCKETS)) << shift;
+      return lowest + ((uint64_t(1) << shift) - 1);
+    }
+
+  public:
+    void record(uint64_t v)
+    {
+      counts[bucket_of(v)]++;
+      total_count++;
+      total_sum += v;
+      max_value = std::max(max_value, v);
+    }
+
+    void merge(const LatencyHistogram& other)
+    {
+      for (size_t b = 0; b < BUCKETS; b++)
+        counts[b] += other.counts[b];
+      total_count += other.total_count;
+      total_sum += other.total_sum;
+      max_value = std::max(max_value, other.max_value);
+    }
+
+    void reset()
+    {
+      std::fill(counts.begin(), counts.end(), 0);
+      total_count = 0;
+      total_sum = 0;
+      max_value = 0;
+    }
+
+    uint64_t count() const
+    {
+      return total_count;
+    }
+
+    uint64_t sum() const
+    {
+      return total_sum;
+    }
+
+    uint64_t max() const
+    {
+      return max_value;
+    }
+
+    /**
+     * The value at `percentile` (0 to 100), to the precision of its bucket,
+     * and never more than the largest value recorded. 0 if empty.
+     */
+    uint64_t percentile(double percentile) const
+    {
+      if (total_count == 0)
+        return 0;
+
+      // The rank of the value, counting from 1, as the nearest rank method.
+      uint64_t rank = static_cast<uint64_t>(
+        (percentile / 100.0) * static_cast<double>(total_count) + 0.5);
+      rank = std::clamp<uint64_t>(rank, 1, total_count);
+
+      uint64_t seen = 0;
+      for (size_t b = 0; b < BUCKETS; b++)
+      {
+        seen += counts[b];
+        if (seen >= rank)
+          return std::min(highest_in(b), max_value);
+      }
+      return max_value;
+    }
+  };
+
+  /**
+   * A LatencyHistogram that several threads may record into at once, and
+   * that may be read while they do, at the cost of an atomic add per
+   * value. snapshot() copies it to a LatencyHistogram for percentiles; a
+   * snapshot taken while values are recorded may miss some of them, but
+   * never counts a value twice.
+   */
+  class ConcurrentLatencyHistogram
+  {
+    static constexpr size_t BUCKETS = LatencyHistogram::BUCKETS;
+
+    std::unique_ptr<std::atomic<uint64_t>[]> counts{
+      new std::atomic<uint64_t>[BUCKETS]()};
+    std::atomic<uint64_t> total_sum{0};
+    std::atomic<uint64_t> max_value{0};
+
+    void raise_max(uint64_t v)
+    {
+      uint64_t m = max_value.load(std::memory_order_relaxed);
+      while (v > m &&
+             !max_value.compare_exchange_weak(m, v, std::memory_order_relaxed))
+      {}
+    }
+
+  public:
+    void record(uint64_t v)
+    {
+      counts[LatencyHistogram::bucket_of(v)].fetch_add(
+        1, std::memory_order_relaxed);
+      total_sum.fetch_add(v, std::memory_order_relaxed);
+      raise_max(v);
+    }
+
+    void merge(const ConcurrentLatencyHistogram& other)
+    {
+      for (size_t b = 0; b < BUCKETS; b++)
+        counts[b].fetch_add(
+          other.counts[b].load(std::memory_order_relaxed),
+          std::memory_order_relaxed);
+      total_sum.fetch_add(
+        other.total_sum.load(std::memory_order_relaxed),
+        std::memory_order_relaxed);
+      raise_max(other.max_value.load(std::memory_order_relaxed));
+    }
+
+    void reset()
+    {
+      for (size_t b = 0; b < BUCKETS; b++)
+        counts[b].store(0, std::memory_order_relaxed);
+      total_sum.store(0, std::memory_order_relaxed);
+      max_value.store(0, std::memory_order_relaxed);
+    }
+
+    /// Add what has been recorded so far to `into`.
+    void snapshot(LatencyHistogram& into) const
+    {
+      uint64_t count = 0;
+      for (size_t b = 0; b < BUCKETS; b++)
+      {
+        uint64_t c = counts[b].load(std::memory_order_relaxed);
+        into.counts[b] += c;
+        count += c;
+      }
+      // The count comes from the buckets, as they may have moved on since
+      // the sum was read.
+      into.total_count += count;
+      into.total_sum += total_sum.load(std::memory_order_relaxed);
+      into.max_value =
+        std::max(into.max_value, max_value.load(std::memory_order_relaxed));
+    }
+  };
+} // namespace verona::rt::api
@@ -0,0 +1,403 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "../pal/cache_line.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <snmalloc/snmalloc.h>
+
+#if defined(_WIN32)
+#  include <windows.h>
+#else
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <unistd.h>
+#endif
+
+namespace verona::rt
+{
+  /**
+   * Counters of what the runtime does, kept in a file mapped into memory
+   * while the process runs, so that an agent outside the process can map
+   * the same file and read them whenever it likes, without synchronising
+   * with the runtime. Off until open() is called.
+   *
+   * The file is a Header followed by `slots` Slots. Each thread that
+   * records anything claims a slot of its own, and only it writes to the
+   * slot, with relaxed loads and stores, until it exits and frees the slot
+   * for the next thread. A slot is never zeroed, so every counter summed
+   * over all slots only ever grows; a Reader does that sum. A thread that
+   * finds no free slot records nothing, and is counted in Header::overflow.
+   *
+   * Each slot has:
+   *
+   *  - Counter totals: behaviours and other work run, work scheduled, work
+   *    stolen, and scheduler thread parks. Work scheduled less work run,
+   *    over all slots, is the work queued across the runtime.
+   *  - For each RegionType: collections and releases, the nanoseconds they
+   *    took, the bytes allocated and the bytes they freed. Bytes allocated
+   *    less bytes freed, over all slots, approximates the bytes live in
+   *    regions of the type.
+   *  - A histogram of collection and release pauses: bucket `b` counts
+   *    those of [2^(b-1), 2^b) ns, and the last bucket those longer.
+   *
+   * The layout is versioned by Header::version, and only changes with it.
+   */
+  class LiveMetrics
+  {
+  public:
+    static constexpr uint64_t MAGIC = 0x5652'4d45'5452'4943; // "VRMETRIC"
+    static constexpr uint32_t VERSION = 2;
+
+    /// Slots of a segment opened with the default.
+    static constexpr size_t DEFAULT_SLOTS = 256;
+
+    /// Number of RegionType values.
+    static constexpr size_t TYPES = 7;
+
+    static constexpr size_t PAUSE_BUCKETS = 40;
+
+    enum Counter : size_t
+    {
+      Run,
+      Scheduled,
+      Steals,
+      Parks,
+      COUNTERS
+    };
+
+    static constexpr const char* NAMES[COUNTERS] = {
+      "run", "scheduled", "steals", "parks"};
+
+    using Value = std::atomic<uint64_t>;
+    static_assert(Value::is_always_lock_free);
+
+    struct Header
+    {
+      uint64_t magic;
+      uint32_t version;
+      uint32_t slots;
+      uint64_t slot_size;
+      uint64_t pid;
+      /// Threads that found no free slot.
+      Value overflow;
+    };
+
+    struct alignas(CACHE_LINE) Slot
+    {
+      /// Id of the thread using the slot, or 0 if it is free.
+      Value owner;
+      Value counters[COUNTERS];
+      Value collections[TYPES];
+      Value collection_ns[TYPES];
+      Value allocated[TYPES];
+      Value freed[TYPES];
+      Value pauses[PAUSE_BUCKETS];
+    };
+
+    /// Every slot of a segment, summed.
+    struct Totals
+    {
+      /// Slots in use by a thread.
+      uint64_t threads = 0;
+      uint64_t overflow = 0;
+      uint64_t counters[COUNTERS] = {};
+      uint64_t collections[TYPES] = {};
+      uint64_t collection_ns[TYPES] = {};
+      uint64_t allocated[TYPES] = {};
+      uint64_t freed[TYPES] = {};
+      uint64_t pauses[PAUSE_BUCKETS] = {};
+    };
+
+  private:
+    static inline std::atomic<Header*> header_{nullptr};
+    static inline size_t mapped_size_ = 0;
+    static inline std::atomic<uint64_t> next_owner_{1};
+
+    static Slot* slots_of(const Header* h)
+    {
+      return (Slot*)(h + 1);
+    }
+
+    static size_t size_for(size_t slots)
+    {
+      return sizeof(Header) + (slots * sizeof(Slot));
+    }
+
+    /// This thread's claim on a slot of the segment it last recorded into.
+    struct Claim
+    {
+      Header* header = nullptr;
+      Slot* slot = nullptr;
+
+      void take(Header* h)
+      {
+        header = h;
+        slot = nullptr;
+        uint64_t id = next_owner_.fetch_add(1, std::memory_order_relaxed);
+        for (size_t i = 0; i < h->slots; i++)
+        {
+          uint64_t free = 0;
+          Slot* s = &slots_of(h)[i];
+          if (s->owner.compare_exchange_strong(
+                free, id, std::memory_order_relaxed))
+          {
+            slot = s;
+            return;
+          }
+        }
+        h->overflow.fetch_add(1, std::memory_order_relaxed);
+      }
+
+      ~Claim()
+      {
+        if ((slot != nullptr) && (header_.load() == header))
+          slot->owner.store(0, std::memory_order_relaxed);
+      }
+    };
+
+    static Slot* local()
+    {
+      Header* h = header_.load(std::memory_order_acquire);
+      if (h == nullptr)
+        return nullptr;
+
+      static thread_local Claim claim;
+      if (claim.header != h)
+        claim.take(h);
+      return claim.slot;
+    }
+
+    /// Only the owning thread writes, so a load and a store suffice.
+    static void bump(Value& v, uint64_t n = 1)
+    {
+      v.store(v.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    static void* map(const char* path, size_t size, bool create)
+    {
+#if defined(_WIN32)
+      HANDLE file = CreateFileA(
+        path,
+        create ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ,
+        FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+        nullptr,
+        create ? CREATE_ALWAYS : OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL,
+        nullptr);
+      if (file == INVALID_HANDLE_VALUE)
+        return nullptr;
+      HANDLE mapping = CreateFileMappingA(
+        file,
+        nullptr,
+        create ? PAGE_READWRITE : PAGE_READONLY,
+        (DWORD)((uint64_t)size >> 32),
+        (DWORD)size,
+        nullptr);
+      CloseHandle(file);
+      if (mapping == nullptr)
+        return nullptr;
+      void* p = MapViewOfFile(
+        mapping, create ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, size);
+      CloseHandle(mapping);
+      return p;
+#else
+      int flags = create ? O_RDWR | O_CREAT | O_TRUNC : O_RDONLY;
+      int fd = ::open(path, flags, 0644);
+      if (fd < 0)
+        return nullptr;
+      if (create && (ftruncate(fd, (off_t)size) != 0))
+      {
+        ::close(fd);
+        return nullptr;
+      }
+      void* p = mmap(
+        nullptr,
+        size,
+        create ? PROT_READ | PROT_WRITE : PROT_READ,
+        MAP_SHARED,
+        fd,
+        0);
+      ::close(fd);
+      return p == MAP_FAILED ? nullptr : p;
+#endif
+    }
+
+    static void unmap(void* p, size_t size)
+    {
+#if defined(_WIN32)
+      UNUSED(size);
+      UnmapViewOfFile(p);
+#else
+      munmap(p, size);
+#endif
+    }
+
+  public:
+    /**
+     * Create the file at `path`, or truncate it, as a segment of `slots`
+     * slots, and start recording into it. Returns false, and records
+     * nothing, if the file cannot be created and mapped, or if a segment
+     * is already open.
+     */
+    static bool open(const char* path, size_t slots = DEFAULT_SLOTS)
+    {
+      if (header_.load() != nullptr)
+        return false;
+
+      size_t size = size_for(slots);
+      void* p = map(path, size, true);
+      if (p == nullptr)
+        return false;
+
+      // The file is new and zeroed, so every slot is free.
+      auto* h = new (p) Header;
+      h->slots = (uint32_t)slots;
+      h->slot_size = sizeof(Slot);
+#if defined(_WIN32)
+      h->pid = GetCurrentProcessId();
+#else
+      h->pid = (uint64_t)getpid();
+#endif
+      h->version = VERSION;
+      for (size_t i = 0; i < slots; i++)
+        new (&slots_of(h)[i]) Slot;
+
+      // Readers check the magic last.
+      std::atomic_thread_fence(std::memory_order_release);
+      h->magic = MAGIC;
+
+      mapped_size_ = size;
+      header_.store(h, std::memory_order_release);
+      return true;
+    }
+
+    /**
+     * Stop recording and unmap the segment, leaving the file as it was.
+     * Only safe once no other thread may be recording, such as after the
+     * runtime has stopped.
+     */
+    static void close()
+    {
+      Header* h = header_.exchange(nullptr);
+      if (h != nullptr)
+        unmap(h, mapped_size_);
+    }
+
+    static bool is_open()
+    {
+      return header_.load(std::memory_order_relaxed) != nullptr;
+    }
+
+    static void count(Counter c, uint64_t n = 1)
+    {
+      if (Slot* s = local())
+        bump(s->counters[c], n);
+    }
+
+    /// Count `bytes` allocated in a region of type `type`.
+    static void allocated(size_t type, size_t bytes)
+    {
+      if (Slot* s = local())
+        bump(s->allocated[type], bytes);
+    }
+
+    /// Count a collection or release of a region of type `type`.
+    static void collected(size_t type, uint64_t ns, size_t freed)
+    {
+      Slot* s = local();
+      if (s == nullptr)
+        return;
+
+      bump(s->collections[type]);
+      bump(s->collection_ns[type], ns);
+      bump(s->freed[type], freed);
+      size_t b = ns == 0 ? 0 : 64 - snmalloc::bits::clz(ns);
+      bump(s->pauses[b < PAUSE_BUCKETS ? b : PAUSE_BUCKETS - 1]);
+    }
+
+    /**
+     * A segment mapped for reading, in this process or another.
+     */
+    class Reader
+    {
+      const Header* header = nullptr;
+      size_t size = 0;
+
+    public:
+      /**
+       * Map the segment in the file at `path`. is_valid() is false if it
+       * cannot be mapped, or does not hold a segment of this version.
+       */
+      Reader(const char* path)
+      {
+        void* p = map(path, sizeof(Header), false);
+        if (p == nullptr)
+          return;
+
+        auto* h = (const Header*)p;
+        bool valid = (h->magic == MAGIC) && (h->version == VERSION) &&
+          (h->slot_size == sizeof(Slot));
+        size_t slots = h->slots;
+        unmap(p, sizeof(Header));
+        if (!valid)
+          return;
+
+        size = size_for(slots);
+        header = (const Header*)map(path, size, false);
+      }
+
+      ~Reader()
+      {
+        if (header != nullptr)
+          unmap((void*)header, size);
+      }
+
+      Reader(const Reader&) = delete;
+      Reader& operator=(const Reader&) = delete;
+
+      bool is_valid() const
+      {
+        return header != nullptr;
+      }
+
+      /// Process id of the writer.
+      uint64_t get_pid() const
+      {
+        return header->pid;
+      }
+
+      Totals read() const
+      {
+        Totals t;
+        t.overflow = header->overflow.load(std::memory_order_relaxed);
+        for (size_t i = 0; i < header->slots; i++)
+        {
+          const Slot& s = slots_of(header)[i];
+          auto get = [](const Value& v) {
+            return v.load(std::memory_order_relaxed);
+          };
+          if (get(s.owner) != 0)
+            t.threads++;
+          for (size_t c = 0; c < COUNTERS; c++)
+            t.counters[c] += get(s.counters[c]);
+          for (size_t r = 0; r < TYPES; r++)
+          {
+            t.collections[r] += get(s.collections[r]);
+            t.collection_ns[r] += get(s.collection_ns[r]);
+            t.allocated[r] += get(s.allocated[r]);
+            t.freed[r] += get(s.freed[r]);
+          }
+          for (size_t b = 0; b < PAUSE_BUCKETS; b++)
+            t.pauses[b] += get(s.pauses[b]);
+        }
+        return t;
+      }
+    };
+  };
+} // namespace verona::rt
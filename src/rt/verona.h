@@ -10,8 +10,12 @@
 #include "boc/cown.h"
 #include "boc/epoch.h"
 #include "boc/noticeboard.h"
+#include "boc/seqnoticeboard.h"
+#include "cpp/cowncollector.h"
 #include "cpp/lambdabehaviour.h"
+#include "cpp/oneshot.h"
 #include "cpp/promise.h"
+#include "cpp/rvector.h"
 #include "cpp/vobject.h"
 #include "debug/logging.h"
 #include "debug/systematic.h"
@@ -21,6 +25,8 @@
 #include "region/immutable.h"
 #include "region/region.h"
 #include "region/region_api.h"
+#include "region/region_ptr.h"
+#include "region/snapshot.h"
 #include "sched/mpmcq.h"
 #include "sched/schedulerthread.h"
 
@@ -1,6 +1,7 @@
 // Copyright Microsoft and Project Verona Contributors.
 // SPDX-License-Identifier: MIT
 #include "arbitrary_nodes.h"
+#include "arbitrary_nodes_baseline.h"
 
 #include "../../../src/benchmarker/export_macro.h"
 #include "../benchmarker/benchmark_main_helper.h"
@@ -12,17 +13,27 @@
 BENCHMARK_WINDOWS_CALLBACK_BRIDGE()
 
 MAKE_REGION_WRAPPER(test, arbitrary_nodes::run_test);
+MAKE_BASELINE_WRAPPER(baseline, arbitrary_nodes::run_baseline);
 
 extern "C" BENCHMARK_EXPORT int run_benchmark(int argc, char** argv)
 {
   opt::Opt opt(argc, argv);
 
   enable_benchmark_logging(opt);
-  RegionType rt = parse_region_type(opt);
 
   int size = opt.is<int>("--size", 1010);
   int regions = opt.is<int>("--regions", 100);
 
+  Baseline b = parse_baseline(opt);
+  if (b != Baseline::None)
+  {
+    DISPATCH_BASELINE(b, baseline, size, regions);
+    return 0;
+  }
+
+  RegionType rt = parse_region_type(opt);
+  parse_gc_options(opt);
+
   DISPATCH_REGION(rt, test, size, regions);
   return 0;
 }
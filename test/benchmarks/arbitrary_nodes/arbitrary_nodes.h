@@ -168,14 +168,9 @@ namespace arbitrary_nodes
         UsingRegion ur(root);
 
         // local vector of nodes in this region
-        std::vector<Node*> all_nodes;
-        all_nodes.push_back(root);
-
-        for (size_t i = 0; i != region_size - 1; i++)
-        {
-          Node* node = new Node();
-          all_nodes.push_back(node);
-        }
+        std::vector<Node*> all_nodes(region_size);
+        all_nodes[0] = root;
+        alloc_many(region_size - 1, all_nodes.data() + 1);
 
         fully_connect<rt>(all_nodes);
 
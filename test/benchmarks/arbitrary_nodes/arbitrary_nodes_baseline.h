@@ -0,0 +1,150 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * The arbitrary nodes workload without a region (see Baseline). Each graph
+ * is still owned by a cown, but its nodes come from a BaselineHeap of its
+ * own. Where run_test() collects the region after the walk, the New
+ * baseline deletes the nodes the walk has left unreachable from the bridge
+ * node. Every graph is fully connected, so under Shared no node is freed
+ * until the cown goes and the edges of every node are cleared.
+ **/
+
+#pragma once
+
+#include "../benchmarker/benchmark_baseline.h"
+#include "arbitrary_nodes.h"
+
+#include <algorithm>
+#include <iostream>
+#include <unordered_set>
+#include <vector>
+
+namespace arbitrary_nodes
+{
+  template<Baseline B>
+  struct NativeNode
+  {
+    using Ptr = typename BaselineHeap<B>::template Ptr<NativeNode>;
+
+    std::vector<Ptr> neighbours;
+  };
+
+  template<Baseline B>
+  class NativeGraph
+  {
+  public:
+    using Ptr = typename NativeNode<B>::Ptr;
+
+    BaselineHeap<B> heap;
+    /// Every live node, the bridge node first.
+    std::vector<Ptr> nodes;
+
+    NativeGraph(size_t size)
+    {
+      for (size_t i = 0; i < size; i++)
+        nodes.push_back(heap.template make<NativeNode<B>>());
+
+      // As fully_connect().
+      for (auto& u : nodes)
+      {
+        for (auto& v : nodes)
+        {
+          if (u != v)
+            u->neighbours.push_back(v);
+        }
+      }
+    }
+
+    NativeNode<B>* root() const
+    {
+      return raw_ptr(nodes[0]);
+    }
+
+    ~NativeGraph()
+    {
+      if constexpr (B == Baseline::Shared)
+      {
+        for (auto& n : nodes)
+          n->neighbours.clear();
+      }
+      for (auto& n : nodes)
+        heap.dispose(n);
+    }
+  };
+
+  /// As traverse_region(), then drop the nodes the walk left unreachable.
+  template<Baseline B>
+  void traverse_native(NativeGraph<B>& graph)
+  {
+    using Node = NativeNode<B>;
+
+    std::cout << "Traversing region" << std::endl;
+    Node* cur = graph.root();
+    while (cur && cur->neighbours.size() > 0)
+    {
+      std::cout << "Current node: " << cur << " has " << cur->neighbours.size()
+                << " outgoing edges" << std::endl;
+      Node* dst = raw_ptr(random_element(cur->neighbours));
+
+      // As removeArc(). The graph still holds `dst`, so it outlives the arc.
+      auto it = std::find_if(
+        cur->neighbours.begin(), cur->neighbours.end(), [&](auto& n) {
+          return raw_ptr(n) == dst;
+        });
+      std::swap(*it, cur->neighbours.back());
+      cur->neighbours.pop_back();
+      std::cout << "Traversed from " << cur << " to " << dst << std::endl;
+      cur = dst;
+    }
+
+    if constexpr (BaselineHeap<B>::frees_each)
+    {
+      std::unordered_set<Node*> seen{graph.root()};
+      std::vector<Node*> next{graph.root()};
+      while (!next.empty())
+      {
+        Node* n = next.back();
+        next.pop_back();
+        for (auto* m : n->neighbours)
+        {
+          if (seen.insert(m).second)
+            next.push_back(m);
+        }
+      }
+
+      auto dead = std::partition(
+        graph.nodes.begin(), graph.nodes.end(), [&](Node* n) {
+          return seen.find(n) != seen.end();
+        });
+      for (auto it = dead; it != graph.nodes.end(); ++it)
+        graph.heap.dispose(*it);
+      graph.nodes.erase(dead, graph.nodes.end());
+    }
+  }
+
+  template<Baseline B>
+  void run_baseline(int size, int regions)
+  {
+    std::cout << "[arbitrary_nodes] Using baseline: " << baseline_name(B)
+              << std::endl;
+
+    std::vector<size_t> region_sizes = random_regions(regions, size);
+    std::cout << "Region sizes: ";
+    for (size_t s : region_sizes)
+    {
+      std::cout << s << " ";
+    }
+    std::cout << std::endl;
+
+    std::vector<cown_ptr<NativeGraph<B>>> graphs;
+    for (size_t region_size : region_sizes)
+      graphs.push_back(make_cown<NativeGraph<B>>(region_size));
+    std::cout << "Finished creating graph regions" << std::endl;
+
+    for (cown_ptr<NativeGraph<B>> graph : graphs)
+    {
+      when(graph) << [](auto g) { traverse_native<B>(*g); };
+    }
+  }
+} // namespace arbitrary_nodes
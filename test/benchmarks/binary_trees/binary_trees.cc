@@ -0,0 +1,40 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#include "binary_trees.h"
+#include "binary_trees_baseline.h"
+
+#include "../../../src/benchmarker/export_macro.h"
+#include "../benchmarker/benchmark_main_helper.h"
+
+#include <debug/harness.h>
+#include <test/opt.h>
+
+BENCHMARK_WINDOWS_CALLBACK_BRIDGE()
+
+MAKE_REGION_WRAPPER(test, binary_trees::run_test);
+MAKE_BASELINE_WRAPPER(baseline, binary_trees::run_baseline);
+
+extern "C" BENCHMARK_EXPORT int run_benchmark(int argc, char** argv)
+{
+  opt::Opt opt(argc, argv);
+
+  enable_benchmark_logging(opt);
+
+  int max_depth = opt.is<int>("--max-depth", 12);
+  int min_depth = opt.is<int>("--min-depth", 4);
+  bool region_per_tree = opt.has("--region-per-tree");
+
+  Baseline b = parse_baseline(opt);
+  if (b != Baseline::None)
+  {
+    DISPATCH_BASELINE(b, baseline, max_depth, min_depth, region_per_tree);
+    return 0;
+  }
+
+  RegionType rt = parse_region_type(opt);
+  parse_gc_options(opt);
+  DISPATCH_REGION(rt, test, max_depth, min_depth, region_per_tree);
+
+  return 0;
+}
+RUN_BENCHMARK_MAIN()
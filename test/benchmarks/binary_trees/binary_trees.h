@@ -0,0 +1,192 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include <algorithm>
+#include <debug/harness.h>
+#include <iostream>
+#include <optional>
+#include <verona.h>
+
+using namespace snmalloc;
+using namespace verona::rt;
+using namespace verona::rt::api;
+
+/**
+ * Binary trees, the GCBench workload of Boehm and the Benchmarks Game, so
+ * that the region collectors can be compared with the published numbers
+ * of other runtimes.
+ *
+ * With a maximum depth of `n`, it builds and drops a stretch tree of depth
+ * n + 1, then builds a long-lived tree of depth n that it holds to the
+ * end. For each depth d from `min_depth` to n, in steps of two, it builds
+ * 2^(n - d + min_depth) temporary trees of depth d, checks each by
+ * counting its nodes and drops it. A tree of depth d has 2^(d + 1) - 1
+ * nodes, and every depth allocates about the same number of nodes, so the
+ * work shifts from many small trees to a few large ones.
+ *
+ * By default every tree is built in one region, which asks its GC policy
+ * whether to collect after each tree is dropped; the long-lived tree is
+ * then traced by every collection, which is what GCBench measures. With
+ * `region_per_tree` each tree is built in a region of its own, and dropping
+ * a temporary tree releases its region.
+ **/
+namespace binary_trees
+{
+  struct Node : public V<Node>
+  {
+    Node* left = nullptr;
+    Node* right = nullptr;
+
+    // Traced, and forwarded after a SemiSpace copy, through V.
+    template<typename F>
+    void fields(F&& f)
+    {
+      f(left);
+      f(right);
+    }
+  };
+
+  /// Entry point of the shared region, holding the long-lived tree.
+  struct Holder : public V<Holder>
+  {
+    Node* long_lived = nullptr;
+
+    template<typename F>
+    void fields(F&& f)
+    {
+      f(long_lived);
+    }
+  };
+
+  inline size_t tree_nodes(int depth)
+  {
+    return (size_t{2} << depth) - 1;
+  }
+
+  /**
+   * Fill in the children of `node` down to `depth` more levels, in the
+   * open region. In rc regions each node's count of one is its parent's
+   * reference.
+   */
+  inline void grow(Node* node, int depth)
+  {
+    if (depth <= 0)
+      return;
+    node->left = new Node;
+    node->right = new Node;
+    grow(node->left, depth - 1);
+    grow(node->right, depth - 1);
+  }
+
+  inline size_t item_check(const Node* node)
+  {
+    if (node == nullptr)
+      return 0;
+    return 1 + item_check(node->left) + item_check(node->right);
+  }
+
+  /**
+   * Make room for a whole tree of `depth` in the open region, so that a
+   * moving collector does not move the tree while it is being built.
+   */
+  template<RegionType rt>
+  inline void reserve(int depth)
+  {
+    if constexpr (rt == RegionType::SemiSpace || rt == RegionType::Compact)
+      region_ensure_available(tree_nodes(depth) * vsizeof<Node>);
+  }
+
+  /**
+   * Build a tree of `depth`, count its nodes and drop it, and return the
+   * count. Without `region_per_tree` the tree is built in the open region.
+   */
+  template<RegionType rt>
+  inline size_t temporary_tree(int depth, bool region_per_tree)
+  {
+    if (region_per_tree)
+    {
+      auto* root = new (rt) Node;
+      size_t nodes;
+      {
+        UsingRegion rr(root);
+        reserve<rt>(depth);
+        grow(root, depth);
+        nodes = item_check(root);
+      }
+      region_release(root);
+      return nodes;
+    }
+
+    reserve<rt>(depth);
+    auto* root = new Node;
+    grow(root, depth);
+    size_t nodes = item_check(root);
+    if constexpr (rt == RegionType::Rc)
+      decref(root);
+    region_maybe_collect();
+    return nodes;
+  }
+
+  /**
+   * The stretch tree, the long-lived tree, held by `holder`, and the
+   * temporary trees. Without `region_per_tree`, the region of `holder`
+   * must be open.
+   */
+  template<RegionType rt>
+  void run_trees(
+    Holder* holder, int max_depth, int min_depth, bool region_per_tree)
+  {
+    size_t nodes = temporary_tree<rt>(max_depth + 1, region_per_tree);
+    std::cout << "stretch tree of depth " << max_depth + 1
+              << "\t check: " << nodes << "\n";
+    check(nodes == tree_nodes(max_depth + 1));
+
+    {
+      std::optional<UsingRegion> rr;
+      if (region_per_tree)
+        rr.emplace(holder);
+      reserve<rt>(max_depth);
+      holder->long_lived = new Node;
+      grow(holder->long_lived, max_depth);
+    }
+
+    for (int d = min_depth; d <= max_depth; d += 2)
+    {
+      size_t iterations = size_t{1} << (max_depth - d + min_depth);
+      size_t total = 0;
+      for (size_t i = 0; i < iterations; i++)
+      {
+        nodes = temporary_tree<rt>(d, region_per_tree);
+        check(nodes == tree_nodes(d));
+        total += nodes;
+      }
+      std::cout << iterations << "\t trees of depth " << d
+                << "\t check: " << total << "\n";
+    }
+
+    // Read through the holder, as a collection may have moved the tree.
+    nodes = item_check(holder->long_lived);
+    std::cout << "long lived tree of depth " << max_depth
+              << "\t check: " << nodes << "\n";
+    check(nodes == tree_nodes(max_depth));
+  }
+
+  template<RegionType rt>
+  void run_test(int max_depth, int min_depth, bool region_per_tree)
+  {
+    max_depth = std::max(max_depth, min_depth + 2);
+
+    auto* holder = new (rt) Holder;
+    if (region_per_tree)
+    {
+      run_trees<rt>(holder, max_depth, min_depth, true);
+    }
+    else
+    {
+      UsingRegion rr(holder);
+      run_trees<rt>(holder, max_depth, min_depth, false);
+    }
+    region_release(holder);
+  }
+} // namespace binary_trees
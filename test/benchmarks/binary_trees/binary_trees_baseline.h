@@ -0,0 +1,120 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "../benchmarker/benchmark_baseline.h"
+
+#include <algorithm>
+#include <debug/harness.h>
+#include <iostream>
+
+namespace binary_trees
+{
+  /**
+   * Binary trees without a region (see Baseline), as the Benchmarks Game
+   * runs it in languages without a collector. The New baseline deletes
+   * each temporary tree node by node once it is checked. With
+   * `region_per_tree`, the Monotonic baseline gives each temporary tree a
+   * heap of its own, freed with the tree, which is how the fastest native
+   * entries use arenas.
+   */
+  template<Baseline B>
+  struct NativeNode
+  {
+    using Ptr = typename BaselineHeap<B>::template Ptr<NativeNode>;
+
+    Ptr left = nullptr;
+    Ptr right = nullptr;
+  };
+
+  template<Baseline B>
+  void grow_native(BaselineHeap<B>& heap, NativeNode<B>* node, int depth)
+  {
+    if (depth <= 0)
+      return;
+    node->left = heap.template make<NativeNode<B>>();
+    node->right = heap.template make<NativeNode<B>>();
+    grow_native(heap, raw_ptr(node->left), depth - 1);
+    grow_native(heap, raw_ptr(node->right), depth - 1);
+  }
+
+  template<typename N>
+  size_t item_check_native(const N* node)
+  {
+    if (node == nullptr)
+      return 0;
+    return 1 + item_check_native(raw_ptr(node->left)) +
+      item_check_native(raw_ptr(node->right));
+  }
+
+  template<Baseline B>
+  void free_native(BaselineHeap<B>& heap, typename NativeNode<B>::Ptr& n)
+  {
+    if (n == nullptr)
+      return;
+
+    if constexpr (BaselineHeap<B>::frees_each)
+    {
+      free_native(heap, n->left);
+      free_native(heap, n->right);
+    }
+    heap.dispose(n);
+  }
+
+  template<Baseline B>
+  size_t temporary_native(BaselineHeap<B>& heap, int depth)
+  {
+    auto root = heap.template make<NativeNode<B>>();
+    grow_native(heap, raw_ptr(root), depth);
+    size_t nodes = item_check_native(raw_ptr(root));
+    free_native(heap, root);
+    return nodes;
+  }
+
+  template<Baseline B>
+  size_t
+  temporary_native(BaselineHeap<B>& heap, int depth, bool region_per_tree)
+  {
+    if (region_per_tree)
+    {
+      BaselineHeap<B> own;
+      return temporary_native(own, depth);
+    }
+    return temporary_native(heap, depth);
+  }
+
+  template<Baseline B>
+  void run_baseline(int max_depth, int min_depth, bool region_per_tree)
+  {
+    max_depth = std::max(max_depth, min_depth + 2);
+    BaselineHeap<B> heap;
+
+    size_t nodes = temporary_native(heap, max_depth + 1, region_per_tree);
+    std::cout << "stretch tree of depth " << max_depth + 1
+              << "\t check: " << nodes << "\n";
+    check(nodes == tree_nodes(max_depth + 1));
+
+    auto long_lived = heap.template make<NativeNode<B>>();
+    grow_native(heap, raw_ptr(long_lived), max_depth);
+
+    for (int d = min_depth; d <= max_depth; d += 2)
+    {
+      size_t iterations = size_t{1} << (max_depth - d + min_depth);
+      size_t total = 0;
+      for (size_t i = 0; i < iterations; i++)
+      {
+        nodes = temporary_native(heap, d, region_per_tree);
+        check(nodes == tree_nodes(d));
+        total += nodes;
+      }
+      std::cout << iterations << "\t trees of depth " << d
+                << "\t check: " << total << "\n";
+    }
+
+    nodes = item_check_native(raw_ptr(long_lived));
+    std::cout << "long lived tree of depth " << max_depth
+              << "\t check: " << nodes << "\n";
+    check(nodes == tree_nodes(max_depth));
+    free_native(heap, long_lived);
+  }
+} // namespace binary_trees
@@ -0,0 +1,34 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#include "ext_ref_churn.h"
+
+#include "../../../src/benchmarker/export_macro.h"
+#include "../benchmarker/benchmark_main_helper.h"
+
+#include <debug/harness.h>
+#include <test/opt.h>
+
+BENCHMARK_WINDOWS_CALLBACK_BRIDGE()
+
+MAKE_REGION_WRAPPER(test, ext_ref_churn::run_test);
+
+extern "C" BENCHMARK_EXPORT int run_benchmark(int argc, char** argv)
+{
+  opt::Opt opt(argc, argv);
+
+  enable_benchmark_logging(opt);
+  RegionType rt = parse_region_type(opt);
+  parse_gc_options(opt);
+
+  // Parse command-line arguments
+  size_t objects = opt.is<size_t>("--objects", 2000);
+  size_t rounds = opt.is<size_t>("--rounds", 50);
+  size_t churn = opt.is<size_t>("--churn-percent", 20);
+  size_t seed = opt.is<size_t>("--seed", 12345);
+
+  DISPATCH_REGION(rt, test, objects, rounds, churn, seed);
+
+  return 0;
+}
+
+RUN_BENCHMARK_MAIN()
@@ -0,0 +1,176 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include <chrono>
+#include <debug/harness.h>
+#include <iostream>
+#include <random>
+#include <vector>
+#include <verona.h>
+
+/**
+ * External reference churn.
+ *
+ * A region keeps a list of `objects` nodes, each with an external
+ * reference held outside the region. Every round drops `churn` percent of
+ * the nodes from the list, appends as many new nodes with new external
+ * references, and collects the region. All the references are then looked
+ * up again: those of live nodes must still find them, wherever a moving
+ * collector put them, and those of dropped nodes must have been
+ * invalidated, and are let go of.
+ *
+ * The benchmark reports the average time of a collection and of looking
+ * up a reference. Only regions whose collections keep external references
+ * up to date, trace and semispace, are run.
+ **/
+namespace ext_ref_churn
+{
+  struct Node : public V<Node>
+  {
+    size_t id;
+    Node* next = nullptr;
+
+    Node(size_t id) : id(id) {}
+
+    void trace(ObjectStack& st) const
+    {
+      if (next != nullptr)
+        st.push(next);
+    }
+
+    void relocate(Object* (*fwd)(Object*))
+    {
+      if (next != nullptr)
+        next = (Node*)fwd(next);
+    }
+  };
+
+  struct Root : public V<Root>
+  {
+    Node* list = nullptr;
+
+    void trace(ObjectStack& st) const
+    {
+      if (list != nullptr)
+        st.push(list);
+    }
+
+    void relocate(Object* (*fwd)(Object*))
+    {
+      if (list != nullptr)
+        list = (Node*)fwd(list);
+    }
+  };
+
+  struct Handle
+  {
+    ExternalRef* ref;
+    size_t id;
+  };
+
+  inline uint64_t elapsed_ns(std::chrono::steady_clock::time_point start)
+  {
+    return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start)
+        .count());
+  }
+
+  /// Prepend `n` new nodes to the list of `r`, and hand out references.
+  inline void add_nodes(
+    Root* r, size_t n, size_t& next_id, std::vector<Handle>& handles)
+  {
+    for (size_t i = 0; i < n; i++)
+    {
+      // Only the pinned root is held across the allocation.
+      auto* node = new Node(next_id);
+      node->next = r->list;
+      r->list = node;
+      handles.push_back({create_external_reference(node), next_id});
+      next_id++;
+    }
+  }
+
+  template<RegionType rt>
+  void run_test(size_t objects, size_t rounds, size_t churn, size_t seed)
+  {
+    if constexpr (rt != RegionType::Trace && rt != RegionType::SemiSpace)
+    {
+      std::cout << "External reference churn needs a region whose "
+                   "collections update external references, skipping.\n";
+      UNUSED(objects, rounds, churn, seed);
+      return;
+    }
+    else
+    {
+      std::mt19937_64 rng(seed);
+      std::uniform_int_distribution<size_t> percent(0, 99);
+      std::vector<Handle> handles;
+      size_t next_id = 0;
+      size_t dropped = 0;
+      size_t lookups = 0;
+      uint64_t collect_ns = 0;
+      uint64_t lookup_ns = 0;
+
+      auto* r = new (rt) Root;
+      {
+        UsingRegion ur(r);
+        add_nodes(r, objects, next_id, handles);
+
+        for (size_t round = 0; round < rounds; round++)
+        {
+          // Drop nodes from the list at random.
+          size_t removed = 0;
+          Node** link = &r->list;
+          while (*link != nullptr)
+          {
+            if (percent(rng) < churn)
+            {
+              *link = (*link)->next;
+              removed++;
+            }
+            else
+              link = &(*link)->next;
+          }
+          add_nodes(r, removed, next_id, handles);
+
+          auto start = std::chrono::steady_clock::now();
+          region_collect();
+          collect_ns += elapsed_ns(start);
+
+          // Look every reference up, letting go of the invalidated ones.
+          start = std::chrono::steady_clock::now();
+          size_t kept = 0;
+          for (auto& h : handles)
+          {
+            if (!is_external_reference_valid(h.ref))
+            {
+              Immutable::release(h.ref);
+              dropped++;
+              continue;
+            }
+            check(((Node*)use_external_reference(h.ref))->id == h.id);
+            handles[kept++] = h;
+          }
+          lookups += handles.size();
+          handles.resize(kept);
+          lookup_ns += elapsed_ns(start);
+          // A lazy sweep may not have reached every dropped node yet.
+          check(kept >= objects);
+        }
+      }
+
+      for (auto& h : handles)
+        Immutable::release(h.ref);
+      region_release(r);
+
+      std::cout << "Nodes: " << objects << ", dropped references: " << dropped
+                << "\n";
+      if (rounds > 0)
+        std::cout << "Average collection: " << collect_ns / rounds << " ns\n";
+      if (lookups > 0)
+        std::cout << "Average lookup: " << lookup_ns / lookups << " ns\n";
+    }
+  }
+} // namespace ext_ref_churn
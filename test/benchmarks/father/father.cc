@@ -7,6 +7,7 @@
 #include "region/region_base.h"
 
 #include <cstddef>
+#include <cstring>
 #include <debug/harness.h>
 #include <iostream>
 #include <test/opt.h>
@@ -22,6 +23,33 @@ extern "C" BENCHMARK_EXPORT int run_benchmark(int argc, char** argv)
 
   enable_benchmark_logging(opt);
   RegionType rt = parse_region_type(opt);
+  parse_gc_options(opt);
+
+  // Multi-tenant mode: tenants of their own region types, each receiving
+  // behaviours at its own rate, instead of the library workloads.
+  const char* tenants_arg = nullptr;
+  for (int i = 1; i + 1 < argc; i++)
+  {
+    if (std::strcmp(argv[i], "--tenants") == 0)
+      tenants_arg = argv[i + 1];
+  }
+  if (tenants_arg != nullptr)
+  {
+    auto tenants = father::parse_tenants(tenants_arg);
+    if (tenants.empty())
+    {
+      std::cerr << "Invalid --tenants " << tenants_arg
+                << " (expected <region>:<rate>,...)\n";
+      return 1;
+    }
+    father::run_tenants(
+      tenants,
+      opt.is<size_t>("--duration-ms", 1000),
+      opt.is<size_t>("--tenant-allocs", 64),
+      opt.is<size_t>("--tenant-live", 4096),
+      opt.is<size_t>("--tenant-seed", 1));
+    return 0;
+  }
 
   std::cout << "Father benchmark - mixed workload test\n\n";
 
@@ -21,17 +21,25 @@
 #include "cpp/when.h"
 #include "region/region_base.h"
 
+#include <algorithm>
+#include <chrono>
 #include <cstddef>
+#include <cstdlib>
 #include <cstring>
 #include <debug/harness.h>
 #include <functional>
+#include <iomanip>
 #include <iostream>
+#include <memory>
+#include <random>
 #include <string>
+#include <util/latency_histogram.h>
 #include <vector>
 #include <verona.h>
 #include <filesystem>
 
 using namespace verona::cpp;
+using verona::rt::api::LatencyHistogram;
 
 namespace father
 {
@@ -311,6 +319,12 @@ namespace father
       case RegionType::SemiSpace:
         std::cout << "SemiSpace";
         break;
+      case RegionType::Generational:
+        std::cout << "Generational";
+        break;
+      case RegionType::Compact:
+        std::cout << "Compact";
+        break;
       default:
         std::cout << "Unknown";
         break;
@@ -408,4 +422,334 @@ namespace father
               << " iterations)\n";
   }
 
+  /**
+   * Multi-tenant mode. Each tenant owns one cown, whose region is of the
+   * tenant's own type, and receives behaviours as a Poisson process at the
+   * tenant's own rate. Arrivals are open loop: they are scheduled when
+   * they are due, whether or not the tenant's earlier behaviours have
+   * finished, and each behaviour's latency is measured from when it was
+   * due rather than from when it was scheduled, so that a tenant that
+   * falls behind (or a ticker that is held up) is not hidden.
+   *
+   * Every behaviour allocates into a queue of nodes kept at a fixed length
+   * in its tenant's region, frees the oldest, and asks the region's GC
+   * policy whether to collect. Tenants share the scheduler threads, so the
+   * tail latency of one shows the pauses of the others.
+   */
+  struct TenantNode : V<TenantNode>
+  {
+    TenantNode* next = nullptr;
+    uint8_t payload[48];
+
+    static constexpr uint64_t pointer_fields()
+    {
+      return field_map(offsetof(TenantNode, next), 1);
+    }
+
+    void trace(ObjectStack& st) const
+    {
+      if (next != nullptr)
+        st.push(next);
+    }
+
+    void relocate(Object* (*fwd)(Object*))
+    {
+      if (next != nullptr)
+        next = (TenantNode*)fwd(next);
+    }
+  };
+
+  /**
+   * The entry point of a tenant's region: a queue of nodes, oldest first.
+   * Only `head` owns its node; `tail` is not traced, so that Rc regions
+   * count each node once, but is moved with the node.
+   */
+  struct TenantRoot : V<TenantRoot>
+  {
+    TenantNode* head = nullptr;
+    TenantNode* tail = nullptr;
+    size_t length = 0;
+
+    void trace(ObjectStack& st) const
+    {
+      if (head != nullptr)
+        st.push(head);
+    }
+
+    void relocate(Object* (*fwd)(Object*))
+    {
+      if (head != nullptr)
+        head = (TenantNode*)fwd(head);
+      if (tail != nullptr)
+        tail = (TenantNode*)fwd(tail);
+    }
+  };
+
+  struct TenantSpec
+  {
+    RegionType type;
+    std::string region_name;
+    /// Behaviours per second.
+    double rate;
+  };
+
+  /**
+   * Parse the argument of --tenants: a comma separated list of
+   * <region>:<behaviours per second>. Returns an empty list if any entry
+   * is malformed.
+   */
+  inline std::vector<TenantSpec> parse_tenants(const std::string& arg)
+  {
+    static constexpr const char* names[] = {
+      "trace", "arena", "rc", "semispace", "generational", "compact"};
+
+    std::vector<TenantSpec> tenants;
+    size_t start = 0;
+    while (start <= arg.size())
+    {
+      size_t end = std::min(arg.find(',', start), arg.size());
+      std::string entry = arg.substr(start, end - start);
+      size_t colon = entry.find(':');
+      if (colon == std::string::npos)
+        return {};
+
+      std::string name = entry.substr(0, colon);
+      auto it = std::find_if(
+        std::begin(names), std::end(names), [&](const char* n) {
+          return name == n;
+        });
+      double rate = std::atof(entry.c_str() + colon + 1);
+      if (it == std::end(names) || rate <= 0)
+        return {};
+
+      tenants.push_back(
+        {(RegionType)(it - std::begin(names)), name, rate});
+      start = end + 1;
+    }
+    return tenants;
+  }
+
+  /// What each tenant saw, printed once every tenant's cown has gone.
+  struct TenantReport
+  {
+    std::vector<TenantSpec> tenants;
+    std::vector<LatencyHistogram> latency;
+    double duration_s;
+
+    TenantReport(const std::vector<TenantSpec>& tenants, double duration_s)
+    : tenants(tenants), latency(tenants.size()), duration_s(duration_s)
+    {}
+
+    ~TenantReport()
+    {
+      std::cout << "\n=== Tenant behaviour latency (us, from arrival) ===\n";
+      for (size_t t = 0; t < tenants.size(); t++)
+      {
+        const LatencyHistogram& h = latency[t];
+        std::cout << "  tenant " << t << " " << std::left << std::setw(13)
+                  << tenants[t].region_name << std::right
+                  << " target: " << tenants[t].rate << "/s"
+                  << " achieved: " << std::fixed << std::setprecision(1)
+                  << (double)h.count() / duration_s << "/s"
+                  << std::defaultfloat;
+        for (double p : {50.0, 90.0, 99.0, 99.9})
+          std::cout << " p" << p << ": " << h.percentile(p) / 1000;
+        std::cout << " max: " << h.max() / 1000 << "\n";
+      }
+    }
+  };
+
+  class TenantCown
+  {
+  public:
+    TenantRoot* root;
+    RegionType type;
+    size_t id;
+    LatencyHistogram latency;
+    std::shared_ptr<TenantReport> report;
+
+    TenantCown(
+      TenantRoot* root,
+      RegionType type,
+      size_t id,
+      std::shared_ptr<TenantReport> report)
+    : root(root), type(type), id(id), report(std::move(report))
+    {}
+
+    ~TenantCown()
+    {
+      report->latency[id] = latency;
+      region_release(root);
+    }
+
+    /**
+     * Append `allocs` nodes to the queue of `root`, a region of type `type`,
+     * then drop the oldest until `live` are left.
+     */
+    static void
+    churn(TenantRoot* root, RegionType type, size_t allocs, size_t live)
+    {
+      UsingRegion ur(root);
+
+      for (size_t i = 0; i < allocs; i++)
+      {
+        auto* n = new TenantNode;
+        std::memset(n->payload, (int)i, sizeof(n->payload));
+        if (root->tail == nullptr)
+          store(root->head, n);
+        else
+          store(root->tail->next, n);
+        root->tail = n;
+        root->length++;
+      }
+
+      while (root->length > live)
+      {
+        TenantNode* old = root->head;
+        store(root->head, old->next);
+        store(old->next, (TenantNode*)nullptr);
+        if (root->head == nullptr)
+          root->tail = nullptr;
+        root->length--;
+        if (type == RegionType::Rc)
+          decref(old);
+      }
+
+      if (type != RegionType::Arena)
+        region_maybe_collect();
+    }
+  };
+
+  /**
+   * Schedules each tenant's behaviours as they fall due. It runs as a
+   * behaviour that reschedules itself until the last arrival, so one
+   * scheduler thread is mostly taken by it.
+   */
+  class TenantTicker
+  {
+    using Clock = std::chrono::steady_clock;
+
+    std::vector<cown_ptr<TenantCown>> cowns;
+    std::vector<std::mt19937_64> rngs;
+    std::vector<std::exponential_distribution<double>> gaps;
+    /// When each tenant's next behaviour is due, in ns since `start`.
+    std::vector<uint64_t> next;
+    /// Set by the first tick, once the scheduler is running.
+    Clock::time_point start;
+    bool started = false;
+    uint64_t duration_ns;
+    size_t allocs;
+    size_t live;
+
+    uint64_t now() const
+    {
+      return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+               Clock::now() - start)
+        .count();
+    }
+
+  public:
+    TenantTicker(
+      std::vector<cown_ptr<TenantCown>> cowns,
+      const std::vector<TenantSpec>& tenants,
+      uint64_t duration_ns,
+      size_t allocs,
+      size_t live,
+      uint64_t seed)
+    : cowns(std::move(cowns)),
+      next(tenants.size(), 0),
+      duration_ns(duration_ns),
+      allocs(allocs),
+      live(live)
+    {
+      for (size_t t = 0; t < tenants.size(); t++)
+      {
+        rngs.emplace_back(seed + t);
+        // Gaps in ns between the arrivals of a Poisson process.
+        gaps.emplace_back(tenants[t].rate / 1e9);
+        next[t] = (uint64_t)gaps[t](rngs[t]);
+      }
+    }
+
+    /// Schedule every behaviour that is due. Returns false after the last.
+    bool tick()
+    {
+      if (!started)
+      {
+        start = Clock::now();
+        started = true;
+      }
+
+      uint64_t t_now = now();
+      bool more = false;
+      for (size_t t = 0; t < cowns.size(); t++)
+      {
+        while (next[t] <= t_now && next[t] < duration_ns)
+        {
+          Clock::time_point due = start + std::chrono::nanoseconds(next[t]);
+          size_t a = allocs;
+          size_t l = live;
+          when(cowns[t]) << [due, a, l](auto c) {
+            TenantCown::churn(c->root, c->type, a, l);
+            c->latency.record(
+              (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+                Clock::now() - due)
+                .count());
+          };
+          next[t] += (uint64_t)gaps[t](rngs[t]);
+        }
+        more |= next[t] < duration_ns;
+      }
+      if (!more)
+        cowns.clear();
+      return more;
+    }
+  };
+
+  inline void schedule_tick(std::shared_ptr<TenantTicker> ticker)
+  {
+    when() << [ticker]() {
+      if (ticker->tick())
+        schedule_tick(ticker);
+    };
+  }
+
+  /**
+   * Run `tenants` for `duration_ms`. Each behaviour allocates `allocs`
+   * nodes in a region that keeps `live` of them.
+   */
+  inline void run_tenants(
+    const std::vector<TenantSpec>& tenants,
+    size_t duration_ms,
+    size_t allocs,
+    size_t live,
+    uint64_t seed)
+  {
+    std::cout << "\nStarting father test with " << tenants.size()
+              << " tenants for " << duration_ms << " ms\n";
+
+    auto report =
+      std::make_shared<TenantReport>(tenants, (double)duration_ms / 1000);
+    std::vector<cown_ptr<TenantCown>> cowns;
+    for (size_t t = 0; t < tenants.size(); t++)
+    {
+      auto* root = new (tenants[t].type) TenantRoot;
+      // Fill the region to its live size before the clock starts.
+      TenantCown::churn(root, tenants[t].type, live, live);
+      cowns.push_back(
+        make_cown<TenantCown>(root, tenants[t].type, t, report));
+      std::cout << "  tenant " << t << ": " << tenants[t].region_name << " at "
+                << tenants[t].rate << " behaviours/s\n";
+    }
+
+    report.reset();
+
+    schedule_tick(std::make_shared<TenantTicker>(
+      std::move(cowns),
+      tenants,
+      (uint64_t)duration_ms * 1000000,
+      allocs,
+      live,
+      seed));
+  }
 } // namespace father
\ No newline at end of file
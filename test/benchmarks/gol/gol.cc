@@ -1,6 +1,7 @@
 // Copyright Microsoft and Project Verona Contributors.
 // SPDX-License-Identifier: MIT
 #include "gol.h"
+#include "gol_baseline.h"
 
 #include "../../../src/benchmarker/export_macro.h"
 #include "../benchmarker/benchmark_main_helper.h"
@@ -12,18 +13,29 @@
 BENCHMARK_WINDOWS_CALLBACK_BRIDGE()
 
 MAKE_REGION_WRAPPER(test, gol::run_test);
+MAKE_BASELINE_WRAPPER(baseline, gol::run_baseline);
 
 extern "C" BENCHMARK_EXPORT int run_benchmark(int argc, char** argv)
 {
   opt::Opt opt(argc, argv);
 
   enable_benchmark_logging(opt);
-  RegionType rt = parse_region_type(opt);
 
   size_t seed = opt.is<size_t>("--seed", 42);
   UNUSED(seed);
   int generations = opt.is<int>("--generations", 10);
   int size = opt.is<int>("--size", 8);
+  bool pool = opt.has("--pool");
+
+  Baseline b = parse_baseline(opt);
+  if (b != Baseline::None)
+  {
+    DISPATCH_BASELINE(b, baseline, size, generations, pool);
+    return 0;
+  }
+
+  RegionType rt = parse_region_type(opt);
+  parse_gc_options(opt);
 
   // Print region type
   std::cout << "[gol.cc] Using region type: ";
@@ -41,6 +53,12 @@ extern "C" BENCHMARK_EXPORT int run_benchmark(int argc, char** argv)
     case RegionType::SemiSpace:
       std::cout << "SemiSpace";
       break;
+    case RegionType::Generational:
+      std::cout << "Generational";
+      break;
+    case RegionType::Compact:
+      std::cout << "Compact";
+      break;
     default:
       std::cout << "Unknown";
       break;
@@ -57,8 +75,9 @@ extern "C" BENCHMARK_EXPORT int run_benchmark(int argc, char** argv)
   std::cout << "  --seed: " << seed << std::endl;
   std::cout << "  --generations: " << generations << std::endl;
   std::cout << "  --size: " << size << std::endl;
+  std::cout << "  --pool: " << pool << std::endl;
 
-  DISPATCH_REGION(rt, test, size, generations);
+  DISPATCH_REGION(rt, test, size, generations, pool);
   return 0;
 }
 
@@ -13,6 +13,12 @@
  * This tests region-based GC effectiveness by forcing collection of dead cells
  * after each generation and verifying the heap size matches the expected number
  * of live cells.
+ *
+ * With `pool`, the cells of each generation are recycled into a RegionPool
+ * once the next generation is built, and new cells are made from it, so the
+ * run does almost no allocation and leaves the collector nothing to free.
+ * Comparing the two runs separates the cost of allocating and freeing cells
+ * from the cost of tracing them.
  **/
 
 #pragma once
@@ -41,6 +47,7 @@ namespace gol
   struct SimRoot : public V<SimRoot>
   {
     std::vector<Cell*> live_cells;
+    RegionPool<Cell> pool;
 
     void trace(ObjectStack& st) const
     {
@@ -49,6 +56,7 @@ namespace gol
         if (c)
           st.push(c);
       }
+      pool.trace(st);
     }
 
     // SemiSpace GC: forward every Cell* in the live_cells vector.
@@ -59,6 +67,7 @@ namespace gol
         if (c)
           c = (Cell*)fwd(c);
       }
+      pool.relocate(fwd);
     }
   };
 
@@ -82,7 +91,7 @@ namespace gol
   }
 
   template<RegionType rt>
-  void run_test(int size, int generations)
+  void run_test(int size, int generations, bool pool)
   {
     std::cout << "[gol] Using region type: ";
     switch (rt)
@@ -99,6 +108,12 @@ namespace gol
       case RegionType::SemiSpace:
         std::cout << "SemiSpace";
         break;
+      case RegionType::Generational:
+        std::cout << "Generational";
+        break;
+      case RegionType::Compact:
+        std::cout << "Compact";
+        break;
       default:
         std::cout << "Unknown";
         break;
@@ -113,9 +128,13 @@ namespace gol
       std::vector<Cell*> current_grid(size * size, nullptr);
       std::vector<Cell*> next_grid(size * size, nullptr);
 
+      auto make_cell = [&](int x, int y) {
+        return pool ? root->pool.make(x, y) : new Cell(x, y);
+      };
+
       auto set_cell = [&](int x, int y) {
         if (x < size && y < size)
-          current_grid[y * size + x] = new Cell(x, y);
+          current_grid[y * size + x] = make_cell(x, y);
       };
 
       // Initialize R-pentomino pattern
@@ -141,7 +160,7 @@ namespace gol
             {
               // Survive Rule (Allocates NEW to create garbage)
               if (neighbors == 2 || neighbors == 3)
-                next_grid[y * size + x] = new Cell(x, y);
+                next_grid[y * size + x] = make_cell(x, y);
               else
                 next_grid[y * size + x] = nullptr;
             }
@@ -149,18 +168,28 @@ namespace gol
             {
               // Birth Rule
               if (neighbors == 3)
-                next_grid[y * size + x] = new Cell(x, y);
+                next_grid[y * size + x] = make_cell(x, y);
               else
                 next_grid[y * size + x] = nullptr;
             }
           }
         }
 
+        // With a pool, the old cells go back to it, which takes over the
+        // live_cells reference in rc regions.
+        if (pool)
+        {
+          for (auto* c : root->live_cells)
+          {
+            if (c)
+              root->pool.recycle(c);
+          }
+        }
         // For RC: decref old cells before overwriting live_cells, since
         // the old cells lose their only in-region reference. Each cell was
         // created with rc=1 covering the live_cells reference; decref → 0
         // triggers immediate deallocation.
-        if constexpr (rt == RegionType::Rc)
+        else if constexpr (rt == RegionType::Rc)
         {
           for (auto* c : root->live_cells)
           {
@@ -171,9 +200,9 @@ namespace gol
 
         current_grid = next_grid;
         root->live_cells = current_grid;
-        region_collect();
+        region_maybe_collect();
 
-        // SemiSpace GC: region_collect() may relocate Cell objects.
+        // SemiSpace GC: collecting may relocate Cell objects.
         // Re-read current_grid from root->live_cells (which was updated
         // by SimRoot::relocate()) so we don't use stale pointers.
         current_grid = root->live_cells;
@@ -185,6 +214,11 @@ namespace gol
             actual_alive_count++;
         }
       }
+
+      if (pool)
+        std::cout << "[gol] Pool: " << root->pool.get_reused()
+                  << " cells reused, " << root->pool.get_allocated()
+                  << " allocated" << std::endl;
     }
     region_release(root);
   }
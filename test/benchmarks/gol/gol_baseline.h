@@ -0,0 +1,127 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * The Game of Life without a region (see Baseline). Each generation makes
+ * new cells for the live ones, as the region version does, and the New
+ * baseline deletes the cells of the last generation once the next one is
+ * built. With `pool`, the old cells are kept on a free list and made into
+ * the cells of the next generation instead.
+ **/
+
+#pragma once
+
+#include "../benchmarker/benchmark_baseline.h"
+
+#include <debug/harness.h>
+#include <iostream>
+#include <utility>
+#include <vector>
+
+namespace gol
+{
+  struct NativeCell
+  {
+    int x, y;
+    NativeCell(int x_, int y_) : x(x_), y(y_) {}
+  };
+
+  template<Baseline B>
+  void run_baseline(int size, int generations, bool pool)
+  {
+    using Ptr = typename BaselineHeap<B>::template Ptr<NativeCell>;
+
+    std::cout << "[gol] Using baseline: " << baseline_name(B) << std::endl;
+
+    BaselineHeap<B> heap;
+    std::vector<Ptr> free_cells;
+    size_t reused = 0;
+    size_t allocated = 0;
+
+    std::vector<Ptr> current_grid(size * size, nullptr);
+    std::vector<Ptr> next_grid(size * size, nullptr);
+
+    auto make_cell = [&](int x, int y) {
+      if (pool && !free_cells.empty())
+      {
+        Ptr c = std::move(free_cells.back());
+        free_cells.pop_back();
+        c->x = x;
+        c->y = y;
+        reused++;
+        return c;
+      }
+      allocated++;
+      return heap.template make<NativeCell>(x, y);
+    };
+
+    auto set_cell = [&](int x, int y) {
+      if (x < size && y < size)
+        current_grid[y * size + x] = make_cell(x, y);
+    };
+
+    // Initialize R-pentomino pattern
+    int cx = size / 2;
+    int cy = size / 2;
+    set_cell(cx + 1, cy);
+    set_cell(cx + 2, cy);
+    set_cell(cx, cy + 1);
+    set_cell(cx + 1, cy + 1);
+    set_cell(cx + 1, cy + 2);
+
+    auto alive = [&](int x, int y) {
+      return current_grid[y * size + x] != nullptr;
+    };
+
+    for (int gen = 0; gen < generations; gen++)
+    {
+      for (int y = 0; y < size; y++)
+      {
+        for (int x = 0; x < size; x++)
+        {
+          int neighbors = 0;
+          for (int dy = -1; dy <= 1; dy++)
+          {
+            for (int dx = -1; dx <= 1; dx++)
+            {
+              if (
+                (dx != 0 || dy != 0) &&
+                alive((x + dx + size) % size, (y + dy + size) % size))
+                neighbors++;
+            }
+          }
+
+          bool live = alive(x, y) ? (neighbors == 2 || neighbors == 3) :
+                                    neighbors == 3;
+          next_grid[y * size + x] = live ? make_cell(x, y) : nullptr;
+        }
+      }
+
+      // The old cells are dead once the next generation is built.
+      for (auto& c : current_grid)
+      {
+        if (c == nullptr)
+          continue;
+        if (pool)
+          free_cells.push_back(std::move(c));
+        else
+          heap.dispose(c);
+        c = nullptr;
+      }
+      std::swap(current_grid, next_grid);
+    }
+
+    if (pool)
+      std::cout << "[gol] Pool: " << reused << " cells reused, " << allocated
+                << " allocated" << std::endl;
+
+    for (auto* grid : {&current_grid, &free_cells})
+    {
+      for (auto& c : *grid)
+      {
+        if (c != nullptr)
+          heap.dispose(c);
+      }
+    }
+  }
+}
@@ -0,0 +1,36 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#include "graph.h"
+
+#include "../../../src/benchmarker/export_macro.h"
+#include "../benchmarker/benchmark_main_helper.h"
+
+#include <debug/harness.h>
+#include <test/opt.h>
+
+BENCHMARK_WINDOWS_CALLBACK_BRIDGE()
+
+MAKE_REGION_WRAPPER(test, graph::run_test);
+
+extern "C" BENCHMARK_EXPORT int run_benchmark(int argc, char** argv)
+{
+  opt::Opt opt(argc, argv);
+
+  enable_benchmark_logging(opt);
+  RegionType rt = parse_region_type(opt);
+  parse_gc_options(opt);
+
+  graph::Options o;
+  o.nodes = opt.is<size_t>("--nodes", 100000);
+  o.degree = opt.is<size_t>("--degree", 4);
+  o.jobs = opt.is<size_t>("--jobs", 8);
+  o.iterations = opt.is<size_t>("--iterations", 5);
+  o.frozen = opt.has("--frozen");
+  o.seed = opt.is<size_t>("--seed", 12345);
+
+  DISPATCH_REGION(rt, test, o);
+
+  return 0;
+}
+
+RUN_BENCHMARK_MAIN()
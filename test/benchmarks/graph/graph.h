@@ -0,0 +1,466 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "cpp/cown.h"
+#include "cpp/when.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <debug/harness.h>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <vector>
+#include <verona.h>
+
+using namespace verona::cpp;
+
+/**
+ * Graph analytics over a large graph held in a region.
+ *
+ * The benchmark builds an undirected power-law graph of `nodes` vertices
+ * by preferential attachment: each new vertex links to `degree` existing
+ * ones, picked in proportion to their degree, so a few hubs end up with
+ * most of the edges. Vertices are allocated first and their edge blocks
+ * afterwards, so a vertex and its edges start far apart, and the region
+ * is then collected once, which lets the collectors that move objects lay
+ * the graph out in the order they trace it.
+ *
+ * `jobs` behaviours then run at once, alternately a breadth-first search
+ * from a random vertex and `iterations` rounds of PageRank. By default the
+ * graph stays in its region, owned by a cown, and every job acquires the
+ * cown read-only, so the jobs run in parallel. With `frozen` the graph is
+ * frozen (trace regions only), and each job holds a reference to the
+ * immutable graph instead of acquiring a cown. The benchmark reports the
+ * time to build and to collect the graph, and the average time and edges
+ * per second of each kind of job.
+ **/
+namespace graph
+{
+  /// Edges in an EdgeBlock, and vertices in a Table and Tables in a Graph.
+  static constexpr size_t EDGES = 14;
+  static constexpr size_t SLOTS = 4096;
+
+  struct EdgeBlock;
+
+  struct Vertex : public V<Vertex>
+  {
+    uint32_t id = 0;
+    uint32_t degree = 0;
+    EdgeBlock* edges = nullptr;
+
+    void trace(ObjectStack& st) const;
+    void relocate(Object* (*fwd)(Object*));
+  };
+
+  struct EdgeBlock : public V<EdgeBlock>
+  {
+    EdgeBlock* next = nullptr;
+    Vertex* to[EDGES] = {};
+
+    void trace(ObjectStack& st) const
+    {
+      if (next != nullptr)
+        st.push(next);
+      for (Vertex* v : to)
+      {
+        if (v != nullptr)
+          st.push(v);
+      }
+    }
+
+    void relocate(Object* (*fwd)(Object*))
+    {
+      if (next != nullptr)
+        next = (EdgeBlock*)fwd(next);
+      for (Vertex*& v : to)
+      {
+        if (v != nullptr)
+          v = (Vertex*)fwd(v);
+      }
+    }
+  };
+
+  inline void Vertex::trace(ObjectStack& st) const
+  {
+    if (edges != nullptr)
+      st.push(edges);
+  }
+
+  inline void Vertex::relocate(Object* (*fwd)(Object*))
+  {
+    if (edges != nullptr)
+      edges = (EdgeBlock*)fwd(edges);
+  }
+
+  struct Table : public V<Table>
+  {
+    Vertex* v[SLOTS] = {};
+
+    void trace(ObjectStack& st) const
+    {
+      for (Vertex* x : v)
+      {
+        if (x != nullptr)
+          st.push(x);
+      }
+    }
+
+    void relocate(Object* (*fwd)(Object*))
+    {
+      for (Vertex*& x : v)
+      {
+        if (x != nullptr)
+          x = (Vertex*)fwd(x);
+      }
+    }
+  };
+
+  /// The entry point of the region: every vertex by id.
+  struct Graph : public V<Graph>
+  {
+    size_t nodes = 0;
+    size_t edges = 0;
+    Table* tables[SLOTS] = {};
+
+    void trace(ObjectStack& st) const
+    {
+      for (Table* t : tables)
+      {
+        if (t != nullptr)
+          st.push(t);
+      }
+    }
+
+    void relocate(Object* (*fwd)(Object*))
+    {
+      for (Table*& t : tables)
+      {
+        if (t != nullptr)
+          t = (Table*)fwd(t);
+      }
+    }
+
+    Vertex* vertex(size_t id) const
+    {
+      return tables[id / SLOTS]->v[id % SLOTS];
+    }
+  };
+
+  /// Call `f` on each neighbour of `v`.
+  template<typename F>
+  void each_edge(const Vertex* v, F&& f)
+  {
+    for (const EdgeBlock* b = v->edges; b != nullptr; b = b->next)
+    {
+      for (Vertex* u : b->to)
+      {
+        if (u == nullptr)
+          return;
+        f(u);
+      }
+    }
+  }
+
+  struct Options
+  {
+    size_t nodes;
+    size_t degree;
+    size_t jobs;
+    size_t iterations;
+    bool frozen;
+    uint64_t seed;
+  };
+
+  using Clock = std::chrono::steady_clock;
+
+  inline uint64_t ns_since(Clock::time_point start)
+  {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+             Clock::now() - start)
+      .count();
+  }
+
+  /// The adjacency lists of a power-law graph, by preferential attachment.
+  inline std::vector<std::vector<uint32_t>> attach(const Options& o)
+  {
+    std::vector<std::vector<uint32_t>> adj(o.nodes);
+    // Each vertex once per edge end, so a uniform pick from it picks
+    // vertices in proportion to their degree.
+    std::vector<uint32_t> ends;
+    ends.reserve(2 * o.nodes * o.degree);
+    std::mt19937_64 rng(o.seed);
+
+    size_t seed_nodes = std::min(o.nodes, o.degree + 1);
+    for (uint32_t v = 0; v < seed_nodes; v++)
+    {
+      for (uint32_t u = 0; u < v; u++)
+      {
+        adj[v].push_back(u);
+        adj[u].push_back(v);
+        ends.push_back(u);
+        ends.push_back(v);
+      }
+    }
+
+    std::vector<uint32_t> picked;
+    for (uint32_t v = (uint32_t)seed_nodes; v < o.nodes; v++)
+    {
+      picked.clear();
+      while (picked.size() < o.degree)
+      {
+        uint32_t u = ends[rng() % ends.size()];
+        if (std::find(picked.begin(), picked.end(), u) == picked.end())
+          picked.push_back(u);
+      }
+      for (uint32_t u : picked)
+      {
+        adj[v].push_back(u);
+        adj[u].push_back(v);
+        ends.push_back(u);
+        ends.push_back(v);
+      }
+    }
+    return adj;
+  }
+
+  /**
+   * Build the graph in a new region of type `rt`. All of it is allocated
+   * before any pointer into the region is kept, after reserving room for
+   * it in regions that would otherwise move objects to grow.
+   */
+  template<RegionType rt>
+  Graph* build(const std::vector<std::vector<uint32_t>>& adj)
+  {
+    size_t n = adj.size();
+    size_t tables = (n + SLOTS - 1) / SLOTS;
+    size_t blocks = 0;
+    size_t edges = 0;
+    for (auto& a : adj)
+    {
+      blocks += (a.size() + EDGES - 1) / EDGES;
+      edges += a.size();
+    }
+
+    auto* g = new (rt) Graph;
+    UsingRegion rr(g);
+    if constexpr (rt == RegionType::SemiSpace || rt == RegionType::Compact)
+      region_ensure_available(
+        tables * vsizeof<Table> + n * vsizeof<Vertex> +
+        blocks * vsizeof<EdgeBlock>);
+
+    g->nodes = n;
+    g->edges = edges / 2;
+    for (size_t t = 0; t < tables; t++)
+      g->tables[t] = new Table;
+
+    std::vector<Vertex*> vertices(n);
+    for (size_t id = 0; id < n; id++)
+    {
+      auto* v = new Vertex;
+      v->id = (uint32_t)id;
+      v->degree = (uint32_t)adj[id].size();
+      vertices[id] = v;
+      g->tables[id / SLOTS]->v[id % SLOTS] = v;
+    }
+
+    // Each block is prepended, so fill them from the end of the list.
+    for (size_t id = 0; id < n; id++)
+    {
+      const auto& a = adj[id];
+      for (size_t end = a.size(); end > 0;)
+      {
+        size_t begin = (end - 1) / EDGES * EDGES;
+        auto* b = new EdgeBlock;
+        for (size_t e = begin; e < end; e++)
+        {
+          Vertex* u = vertices[a[e]];
+          b->to[e - begin] = u;
+          if constexpr (rt == RegionType::Rc)
+            incref(u);
+        }
+        b->next = vertices[id]->edges;
+        vertices[id]->edges = b;
+        end = begin;
+      }
+    }
+    return g;
+  }
+
+  /// Visit every vertex reachable from `source`; returns edges followed.
+  inline size_t bfs(const Graph* g, size_t source)
+  {
+    std::vector<bool> seen(g->nodes);
+    std::vector<const Vertex*> queue;
+    queue.reserve(g->nodes);
+    queue.push_back(g->vertex(source));
+    seen[source] = true;
+    size_t followed = 0;
+    for (size_t head = 0; head < queue.size(); head++)
+    {
+      each_edge(queue[head], [&](const Vertex* u) {
+        followed++;
+        if (!seen[u->id])
+        {
+          seen[u->id] = true;
+          queue.push_back(u);
+        }
+      });
+    }
+    return followed;
+  }
+
+  /// Run `iterations` rounds of PageRank; returns edges followed.
+  inline size_t pagerank(const Graph* g, size_t iterations)
+  {
+    constexpr double damping = 0.85;
+    size_t n = g->nodes;
+    std::vector<double> rank(n, 1.0 / (double)n);
+    std::vector<double> next(n);
+    size_t followed = 0;
+    for (size_t i = 0; i < iterations; i++)
+    {
+      std::fill(next.begin(), next.end(), (1 - damping) / (double)n);
+      for (size_t id = 0; id < n; id++)
+      {
+        const Vertex* v = g->vertex(id);
+        if (v->degree == 0)
+          continue;
+        double share = damping * rank[id] / v->degree;
+        each_edge(v, [&](const Vertex* u) {
+          next[u->id] += share;
+          followed++;
+        });
+      }
+      std::swap(rank, next);
+    }
+    return followed;
+  }
+
+  struct Holder
+  {
+    Graph* g = nullptr;
+
+    ~Holder()
+    {
+      if (g != nullptr)
+        region_release(g);
+    }
+  };
+
+  struct Results
+  {
+    Options o;
+    size_t nodes;
+    size_t edges;
+    Clock::time_point start;
+    std::atomic<size_t> done{0};
+    std::atomic<uint64_t> bfs_ns{0};
+    std::atomic<uint64_t> bfs_edges{0};
+    std::atomic<uint64_t> pagerank_ns{0};
+    std::atomic<uint64_t> pagerank_edges{0};
+
+    /// Immutable graph, released when the last job finishes.
+    Graph* frozen = nullptr;
+
+    Results(const Options& o, const Graph* g)
+    : o(o), nodes(g->nodes), edges(g->edges)
+    {}
+  };
+
+  inline void row(const char* name, size_t jobs, uint64_t ns, uint64_t edges)
+  {
+    std::cout << std::setw(10) << name << std::setw(6) << jobs
+              << std::setw(14) << (jobs == 0 ? 0 : ns / jobs / 1000)
+              << std::setw(16) << std::fixed << std::setprecision(0)
+              << (ns == 0 ? 0.0 : (double)edges * 1e9 / (double)ns)
+              << std::defaultfloat << "\n";
+  }
+
+  /// Run job `j` on the graph, and report once it is the last.
+  inline void job(std::shared_ptr<Results> r, const Graph* g, size_t j)
+  {
+    auto start = Clock::now();
+    if (j % 2 == 0)
+    {
+      std::mt19937_64 rng(r->o.seed + j);
+      r->bfs_edges += bfs(g, rng() % g->nodes);
+      r->bfs_ns += ns_since(start);
+    }
+    else
+    {
+      r->pagerank_edges += pagerank(g, r->o.iterations);
+      r->pagerank_ns += ns_since(start);
+    }
+
+    if (r->done.fetch_add(1) + 1 != r->o.jobs)
+      return;
+
+    size_t bfs_jobs = (r->o.jobs + 1) / 2;
+    std::cout << "Jobs: " << r->o.jobs << " on " << r->nodes
+              << " vertices and " << r->edges << " edges in "
+              << ns_since(r->start) / 1000000 << " ms\n";
+    std::cout << "       job  runs  avg_time_us     edges/s/job\n";
+    row("bfs", bfs_jobs, r->bfs_ns, r->bfs_edges);
+    row("pagerank", r->o.jobs - bfs_jobs, r->pagerank_ns, r->pagerank_edges);
+    if (r->frozen != nullptr)
+      Immutable::release(r->frozen);
+  }
+
+  template<RegionType rt>
+  void run_test(const Options& o)
+  {
+    if (o.nodes < 2 || o.degree == 0 || o.nodes > SLOTS * SLOTS)
+      return;
+
+    Options opts = o;
+    opts.degree = std::min(o.degree, o.nodes - 1);
+    if (o.frozen && rt != RegionType::Trace)
+    {
+      std::cout << "Only trace regions can be frozen, so the graph stays in "
+                   "its region.\n";
+      opts.frozen = false;
+    }
+
+    auto adj = attach(opts);
+    auto start = Clock::now();
+    Graph* g = build<rt>(adj);
+    uint64_t build_ns = ns_since(start);
+    adj.clear();
+
+    start = Clock::now();
+    {
+      UsingRegion rr(g);
+      region_collect();
+    }
+    uint64_t gc_ns = ns_since(start);
+    std::cout << "Built in " << build_ns / 1000000 << " ms, collected in "
+              << gc_ns / 1000000 << " ms\n";
+
+    auto r = std::make_shared<Results>(opts, g);
+    r->start = Clock::now();
+    if (opts.frozen)
+    {
+      freeze(g);
+      r->frozen = g;
+      for (size_t j = 0; j < opts.jobs; j++)
+        when() << [r, g, j]() { job(r, g, j); };
+    }
+    else
+    {
+      auto holder = make_cown<Holder>();
+      when(holder) << [g](acquired_cown<Holder> h) { h->g = g; };
+      for (size_t j = 0; j < opts.jobs; j++)
+      {
+        when(read(holder)) << [r, j](acquired_cown<const Holder> h) {
+          job(r, h->g, j);
+        };
+      }
+    }
+  }
+} // namespace graph
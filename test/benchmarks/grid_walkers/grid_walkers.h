@@ -369,9 +369,9 @@ void run_test(int gridsize, int numsteps, int numwalkers)
       }
 
       int dead = numInaccessible(root, gridsize);
-      region_collect();
+      region_maybe_collect();
 
-      // SemiSpace GC: region_collect() may relocate Node objects.
+      // SemiSpace GC: collecting may relocate Node objects.
       // Rebuild grid[] from root via BFS (each Node stores its coordinates).
       rebuild_grid(root, grid, gridsize);
 
@@ -0,0 +1,212 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "../benchmarker/benchmark_baseline.h"
+#include "grid_walkers.h"
+
+#include <debug/harness.h>
+#include <iostream>
+#include <memory>
+#include <queue>
+#include <random>
+#include <unordered_set>
+#include <vector>
+
+/**
+ * The grid walkers without a region (see Baseline). The grid holds a Ptr to
+ * every node, and after each step the nodes the walkers have cut off from
+ * the root are dropped from it, which is where run_test() collects:
+ *
+ *  - New deletes them, having found them with the traversal the workload
+ *    already makes to count them.
+ *  - Shared frees a cut off node once no live neighbour links to it, but a
+ *    cut off group of nodes still linked to each other stays allocated
+ *    until the grid is dropped and every link is cleared.
+ *  - Monotonic frees nothing until the grid is dropped.
+ **/
+template<Baseline B>
+struct NativeGridNode : public BaselineObject<B, NativeGridNode<B>>
+{
+  using Ptr = typename BaselineHeap<B>::template Ptr<NativeGridNode>;
+
+  Ptr down = nullptr;
+  Ptr right = nullptr;
+  Ptr up = nullptr;
+  Ptr left = nullptr;
+
+  int gx = -1, gy = -1;
+};
+
+/// The nodes reachable from `root`, as numInaccessible() finds them.
+template<typename N>
+std::unordered_set<N*> reachable_native(N* root)
+{
+  std::unordered_set<N*> seen;
+  std::queue<N*> next;
+  next.push(root);
+  seen.insert(root);
+  while (!next.empty())
+  {
+    N* cur = next.front();
+    next.pop();
+    N* neighbors[] = {
+      raw_ptr(cur->down),
+      raw_ptr(cur->right),
+      raw_ptr(cur->up),
+      raw_ptr(cur->left)};
+    for (N* n : neighbors)
+    {
+      if (n && seen.insert(n).second)
+        next.push(n);
+    }
+  }
+  return seen;
+}
+
+/// Cut the link between `n` and the neighbour `field` points to, where
+/// `back` is that neighbour's link to `n`.
+template<typename N, typename P>
+void kill_link_native(N* n, P N::*field, P N::*back)
+{
+  if (n->*field == nullptr)
+    return;
+  raw_ptr(n->*field)->*back = nullptr;
+  n->*field = nullptr;
+}
+
+template<Baseline B>
+void run_baseline(int gridsize, int numsteps, int numwalkers)
+{
+  using Node = NativeGridNode<B>;
+  using Ptr = typename Node::Ptr;
+
+  std::cout << "[grid_walkers] Using baseline: " << baseline_name(B)
+            << std::endl;
+
+  BaselineHeap<B> heap;
+  std::vector<Ptr> grid(gridsize * gridsize, nullptr);
+  std::vector<std::weak_ptr<Node>> all_shared;
+
+  for (int i = 0; i < gridsize; i++)
+  {
+    for (int j = 0; j < gridsize; j++)
+    {
+      Ptr n = heap.template make<Node>();
+      n->gx = j;
+      n->gy = i;
+      if constexpr (B == Baseline::Shared)
+        all_shared.push_back(n);
+      grid[i * gridsize + j] = n;
+    }
+  }
+
+  for (int i = 0; i < gridsize; i++)
+  {
+    for (int j = 0; j < gridsize; j++)
+    {
+      Node* n = raw_ptr(grid[i * gridsize + j]);
+      if (j < gridsize - 1)
+        n->right = grid[i * gridsize + j + 1];
+      if (j > 0)
+        n->left = grid[i * gridsize + j - 1];
+      if (i < gridsize - 1)
+        n->down = grid[(i + 1) * gridsize + j];
+      if (i > 0)
+        n->up = grid[(i - 1) * gridsize + j];
+    }
+  }
+  Node* root = raw_ptr(grid[0]);
+
+  std::random_device rd;
+  std::mt19937 gen(rd());
+
+  std::vector<int> walker_idx(numwalkers);
+  std::uniform_int_distribution<size_t> cdist(0, gridsize - 1);
+  for (int i = 0; i < numwalkers; i++)
+    walker_idx[i] = static_cast<int>(cdist(gen) * gridsize + cdist(gen));
+
+  size_t dropped = 0;
+  for (int i = 0; i < numsteps; i++)
+  {
+    for (int j = 0; j < numwalkers; j++)
+    {
+      Node* walker = raw_ptr(grid[walker_idx[j]]);
+      if (walker == nullptr)
+      {
+        walker_idx[j] = static_cast<int>(cdist(gen) * gridsize + cdist(gen));
+        walker = raw_ptr(grid[walker_idx[j]]);
+        if (walker == nullptr)
+          continue;
+      }
+
+      std::vector<dir> options;
+      if (walker->down)
+        options.push_back(dir::DOWN);
+      if (walker->right)
+        options.push_back(dir::RIGHT);
+      if (walker->up)
+        options.push_back(dir::UP);
+      if (walker->left)
+        options.push_back(dir::LEFT);
+
+      if (options.size() == 0)
+      {
+        walker_idx[j] = static_cast<int>(cdist(gen) * gridsize + cdist(gen));
+        continue;
+      }
+      std::uniform_int_distribution<size_t> dist(0, options.size() - 1);
+      switch (options[dist(gen)])
+      {
+        case dir::DOWN:
+          walker = raw_ptr(walker->down);
+          kill_link_native(walker, &Node::up, &Node::down);
+          break;
+        case dir::RIGHT:
+          walker = raw_ptr(walker->right);
+          kill_link_native(walker, &Node::left, &Node::right);
+          break;
+        case dir::UP:
+          walker = raw_ptr(walker->up);
+          kill_link_native(walker, &Node::down, &Node::up);
+          break;
+        case dir::LEFT:
+          walker = raw_ptr(walker->left);
+          kill_link_native(walker, &Node::right, &Node::left);
+          break;
+      }
+      walker_idx[j] = walker->gy * gridsize + walker->gx;
+    }
+
+    auto seen = reachable_native(root);
+    for (auto& n : grid)
+    {
+      if (n != nullptr && seen.find(raw_ptr(n)) == seen.end())
+      {
+        heap.dispose(n);
+        dropped++;
+      }
+    }
+  }
+  check(dropped + reachable_native(root).size() == grid.size());
+
+  // Drop the grid.
+  if constexpr (B == Baseline::Shared)
+  {
+    for (auto& w : all_shared)
+    {
+      if (auto n = w.lock())
+      {
+        n->down = nullptr;
+        n->right = nullptr;
+        n->up = nullptr;
+        n->left = nullptr;
+      }
+    }
+  }
+  for (auto& n : grid)
+  {
+    if (n != nullptr)
+      heap.dispose(n);
+  }
+}
@@ -0,0 +1,45 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#include "ingest.h"
+
+#include "../../../src/benchmarker/export_macro.h"
+#include "../benchmarker/benchmark_main_helper.h"
+
+#include <cstring>
+#include <debug/harness.h>
+#include <test/opt.h>
+
+BENCHMARK_WINDOWS_CALLBACK_BRIDGE()
+
+MAKE_REGION_WRAPPER(test, ingest::run_test);
+
+extern "C" BENCHMARK_EXPORT int run_benchmark(int argc, char** argv)
+{
+  opt::Opt opt(argc, argv);
+
+  enable_benchmark_logging(opt);
+  RegionType rt = parse_region_type(opt);
+  parse_gc_options(opt);
+
+  // Chunks are mapped at multiples of the allocation granularity.
+  constexpr size_t GRANULE = 64 * 1024;
+
+  ingest::Options o;
+  for (int i = 1; i + 1 < argc; i++)
+  {
+    if (std::strcmp(argv[i], "--input") == 0)
+      o.input = argv[i + 1];
+  }
+  o.generate_mb = opt.is<size_t>("--generate-mb", 64);
+  o.chunk_bytes = (opt.is<size_t>("--chunk-kb", 4096) * 1024 + GRANULE - 1) /
+    GRANULE * GRANULE;
+  o.batch = opt.is<size_t>("--batch", 1000);
+  o.consumers = opt.is<size_t>("--consumers", 1);
+  o.freeze = opt.has("--freeze");
+
+  DISPATCH_REGION(rt, test, o);
+
+  return 0;
+}
+
+RUN_BENCHMARK_MAIN()
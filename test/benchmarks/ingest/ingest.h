@@ -0,0 +1,675 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "cpp/cown.h"
+#include "cpp/when.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <debug/harness.h>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include <verona.h>
+
+#if defined(_WIN32)
+#  ifndef NOMINMAX
+#    define NOMINMAX
+#  endif
+#  include <windows.h>
+#else
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
+
+using namespace verona::cpp;
+
+/**
+ * Ingesting a file into regions.
+ *
+ * A producer cown streams a CSV file of records `id,name,score,tags`, with
+ * the tags separated by ';', mapping it into memory a chunk at a time. It
+ * parses each line as a generic CSV reader would, into a row of string
+ * tokens, and from that builds a typed record, leaving the row behind as
+ * garbage. Every `batch` records go into a region of their own, which is
+ * collected once it is full. The batch is then frozen (trace regions) and
+ * read by a consumer, or handed to a consumer cown, which reads it, drops
+ * the tags of its records and collects it. Batch `i` goes to consumer
+ * `i % consumers`.
+ *
+ * Without an input file, one of `generate_mb` MiB is generated in the
+ * temporary directory the first time it is needed, and reused after. The
+ * benchmark reports the throughput in MB/s and records/s, and the time
+ * the producer and the consumers spent parsing, working and collecting.
+ **/
+namespace ingest
+{
+  /// A string token, up to CAPACITY bytes; longer ones are cut short.
+  struct Str : public V<Str>
+  {
+    static constexpr size_t CAPACITY = 28;
+
+    Str* next = nullptr;
+    uint32_t length = 0;
+    char data[CAPACITY];
+
+    Str(const char* begin, const char* end)
+    {
+      length = (uint32_t)std::min<size_t>((size_t)(end - begin), CAPACITY);
+      memcpy(data, begin, length);
+    }
+
+    void trace(ObjectStack& st) const
+    {
+      if (next != nullptr)
+        st.push(next);
+    }
+
+    void relocate(Object* (*fwd)(Object*))
+    {
+      if (next != nullptr)
+        next = (Str*)fwd(next);
+    }
+  };
+
+  /// The fields of a line, as the tokeniser split them.
+  struct Row : public V<Row>
+  {
+    Str* first = nullptr;
+
+    void trace(ObjectStack& st) const
+    {
+      if (first != nullptr)
+        st.push(first);
+    }
+
+    void relocate(Object* (*fwd)(Object*))
+    {
+      if (first != nullptr)
+        first = (Str*)fwd(first);
+    }
+  };
+
+  struct Record : public V<Record>
+  {
+    Record* next = nullptr;
+    Str* name = nullptr;
+    Str* tags = nullptr;
+    uint64_t id = 0;
+    double score = 0;
+
+    void trace(ObjectStack& st) const
+    {
+      if (next != nullptr)
+        st.push(next);
+      if (name != nullptr)
+        st.push(name);
+      if (tags != nullptr)
+        st.push(tags);
+    }
+
+    void relocate(Object* (*fwd)(Object*))
+    {
+      if (next != nullptr)
+        next = (Record*)fwd(next);
+      if (name != nullptr)
+        name = (Str*)fwd(name);
+      if (tags != nullptr)
+        tags = (Str*)fwd(tags);
+    }
+  };
+
+  /// Entry point of a batch's region.
+  struct Batch : public V<Batch>
+  {
+    Record* first = nullptr;
+    size_t records = 0;
+
+    void trace(ObjectStack& st) const
+    {
+      if (first != nullptr)
+        st.push(first);
+    }
+
+    void relocate(Object* (*fwd)(Object*))
+    {
+      if (first != nullptr)
+        first = (Record*)fwd(first);
+    }
+  };
+
+  /// Tags kept per record; the rest are dropped.
+  static constexpr size_t MAX_TAGS = 8;
+
+  /// Fields of a line the tokeniser keeps; the rest are dropped.
+  static constexpr size_t MAX_FIELDS = 8;
+
+  /// Most objects a record's parse allocates.
+  static constexpr size_t RECORD_OBJECTS = 1 + MAX_FIELDS + 2 + MAX_TAGS;
+
+  struct Options
+  {
+    /// File to ingest, or empty to generate one.
+    std::string input;
+    size_t generate_mb;
+    size_t chunk_bytes;
+    size_t batch;
+    size_t consumers;
+    bool freeze;
+  };
+
+  /**
+   * Reads the lines of a file, mapping it into memory `chunk` bytes at a
+   * time, and unmapping each chunk once its lines have been read. A line
+   * that spans chunks is copied.
+   */
+  class LineReader
+  {
+    uint64_t size = 0;
+    uint64_t offset = 0;
+    size_t chunk;
+    const char* base = nullptr;
+    size_t mapped = 0;
+    const char* pos = nullptr;
+    const char* limit = nullptr;
+    std::string carry;
+    bool carried = false;
+#if defined(_WIN32)
+    HANDLE mapping = nullptr;
+#else
+    int fd = -1;
+#endif
+
+    void unmap()
+    {
+      if (base == nullptr)
+        return;
+#if defined(_WIN32)
+      UnmapViewOfFile(base);
+#else
+      munmap((void*)base, mapped);
+#endif
+      base = nullptr;
+    }
+
+    /// Map the next chunk, or return false at the end of the file.
+    bool advance()
+    {
+      unmap();
+      if (offset >= size)
+        return false;
+
+      mapped = (size_t)std::min<uint64_t>(chunk, size - offset);
+#if defined(_WIN32)
+      base = (const char*)MapViewOfFile(
+        mapping,
+        FILE_MAP_READ,
+        (DWORD)(offset >> 32),
+        (DWORD)offset,
+        mapped);
+#else
+      void* p =
+        mmap(nullptr, mapped, PROT_READ, MAP_PRIVATE, fd, (off_t)offset);
+      base = p == MAP_FAILED ? nullptr : (const char*)p;
+      if (base != nullptr)
+        madvise(p, mapped, MADV_SEQUENTIAL);
+#endif
+      if (base == nullptr)
+        return false;
+      offset += mapped;
+      pos = base;
+      limit = base + mapped;
+      return true;
+    }
+
+  public:
+    /// `chunk` must be a multiple of the allocation granularity, 64 KiB.
+    LineReader(size_t chunk) : chunk(chunk) {}
+
+    ~LineReader()
+    {
+      unmap();
+#if defined(_WIN32)
+      if (mapping != nullptr)
+        CloseHandle(mapping);
+#else
+      if (fd >= 0)
+        close(fd);
+#endif
+    }
+
+    bool open(const std::string& path)
+    {
+#if defined(_WIN32)
+      HANDLE file = CreateFileA(
+        path.c_str(),
+        GENERIC_READ,
+        FILE_SHARE_READ,
+        nullptr,
+        OPEN_EXISTING,
+        FILE_FLAG_SEQUENTIAL_SCAN,
+        nullptr);
+      if (file == INVALID_HANDLE_VALUE)
+        return false;
+      LARGE_INTEGER s;
+      if (GetFileSizeEx(file, &s))
+      {
+        size = (uint64_t)s.QuadPart;
+        if (size != 0)
+          mapping =
+            CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+      }
+      CloseHandle(file);
+      return (size == 0) || (mapping != nullptr);
+#else
+      fd = ::open(path.c_str(), O_RDONLY);
+      struct stat st;
+      if ((fd < 0) || (fstat(fd, &st) != 0))
+        return false;
+      size = (uint64_t)st.st_size;
+      return true;
+#endif
+    }
+
+    uint64_t get_size() const
+    {
+      return size;
+    }
+
+    /**
+     * The next line, without its '\n', in [begin, end), valid until the
+     * next call. Returns false at the end of the file.
+     */
+    bool next(const char*& begin, const char*& end)
+    {
+      if (carried)
+      {
+        carry.clear();
+        carried = false;
+      }
+
+      while (true)
+      {
+        if (pos != limit)
+        {
+          auto* nl = (const char*)memchr(pos, '\n', (size_t)(limit - pos));
+          if (nl == nullptr)
+          {
+            carry.append(pos, limit);
+            pos = limit;
+            continue;
+          }
+
+          const char* line = pos;
+          pos = nl + 1;
+          if (carry.empty())
+          {
+            begin = line;
+            end = nl;
+            return true;
+          }
+          carry.append(line, nl);
+        }
+        else if (advance())
+        {
+          continue;
+        }
+        else if (carry.empty())
+        {
+          return false;
+        }
+
+        carried = true;
+        begin = carry.data();
+        end = begin + carry.size();
+        return true;
+      }
+    }
+  };
+
+  /**
+   * The path of a generated input of `mb` MiB, written the first time it
+   * is asked for.
+   */
+  inline std::string generated_input(size_t mb)
+  {
+    namespace fs = std::filesystem;
+    fs::path path = fs::temp_directory_path() /
+      ("verona_ingest_" + std::to_string(mb) + "mb.csv");
+    uint64_t bytes = (uint64_t)mb << 20;
+    std::error_code ec;
+    if (fs::exists(path, ec) && (fs::file_size(path, ec) >= bytes))
+      return path.string();
+
+    static constexpr const char* TAGS[] = {
+      "red", "green", "blue", "new", "sale", "bulk", "gift", "eu", "us"};
+    std::mt19937_64 rng(42);
+    std::ofstream out(path, std::ios::binary);
+    std::string line;
+    uint64_t written = 0;
+    for (uint64_t id = 0; written < bytes; id++)
+    {
+      line = std::to_string(id) + ",user_" + std::to_string(rng() % 1000000) +
+        "," + std::to_string((double)(rng() % 100000) / 1000) + ",";
+      size_t tags = 1 + (size_t)(rng() % 4);
+      for (size_t t = 0; t < tags; t++)
+      {
+        if (t != 0)
+          line += ';';
+        line += TAGS[rng() % std::size(TAGS)];
+      }
+      line += '\n';
+      out << line;
+      written += line.size();
+    }
+    return path.string();
+  }
+
+  using Clock = std::chrono::steady_clock;
+
+  inline uint64_t ns_since(Clock::time_point start)
+  {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+             Clock::now() - start)
+      .count();
+  }
+
+  struct Reader
+  {};
+
+  struct Consumer
+  {
+    uint64_t checksum = 0;
+  };
+
+  template<RegionType rt>
+  struct Ingest
+  {
+    Options o;
+    std::string path;
+    cown_ptr<Reader> reader = make_cown<Reader>();
+    std::vector<cown_ptr<Consumer>> consumers;
+    Clock::time_point start = Clock::now();
+
+    uint64_t bytes = 0;
+    size_t records = 0;
+    uint64_t parse_ns = 0;
+    uint64_t produce_gc_ns = 0;
+    /// Batches made, once the producer has finished.
+    std::atomic<size_t> batches{SIZE_MAX};
+    std::atomic<size_t> consumed{0};
+    std::atomic<uint64_t> consume_ns{0};
+    std::atomic<uint64_t> consume_gc_ns{0};
+    std::atomic<bool> reported{false};
+
+    Ingest(const Options& o, std::string path) : o(o), path(std::move(path))
+    {
+      for (size_t c = 0; c < o.consumers; c++)
+        consumers.push_back(make_cown<Consumer>());
+    }
+  };
+
+  inline uint64_t parse_u64(const Str* s)
+  {
+    uint64_t v = 0;
+    for (uint32_t i = 0; i < s->length && isdigit(s->data[i]); i++)
+      v = v * 10 + (uint64_t)(s->data[i] - '0');
+    return v;
+  }
+
+  inline double parse_double(const Str* s)
+  {
+    char buf[Str::CAPACITY + 1];
+    memcpy(buf, s->data, s->length);
+    buf[s->length] = '\0';
+    return strtod(buf, nullptr);
+  }
+
+  /**
+   * Parse the line [begin, end) into a record at the head of `batch`, in
+   * its open region.
+   */
+  template<RegionType rt>
+  void add_record(Batch* batch, const char* begin, const char* end)
+  {
+    // Room for every object of the record, so that a moving collector does
+    // not move them while they are only referenced from here.
+    if constexpr (rt == RegionType::SemiSpace || rt == RegionType::Compact)
+      region_ensure_available(
+        RECORD_OBJECTS * std::max(vsizeof<Str>, vsizeof<Record>));
+
+    // Tokenise the line, as a generic CSV reader would.
+    auto* row = new Row;
+    Str* last = nullptr;
+    size_t fields = 0;
+    for (const char* p = begin; fields < MAX_FIELDS; fields++)
+    {
+      auto* comma = (const char*)memchr(p, ',', (size_t)(end - p));
+      const char* field_end = comma == nullptr ? end : comma;
+      auto* s = new Str(p, field_end);
+      if (last == nullptr)
+        row->first = s;
+      else
+        last->next = s;
+      last = s;
+      if (comma == nullptr)
+        break;
+      p = comma + 1;
+    }
+
+    // Map the tokens to a typed record; the row is then garbage.
+    auto* rec = new Record;
+    Str* f = row->first;
+    rec->id = parse_u64(f);
+    if ((f = f->next) != nullptr)
+    {
+      rec->name = new Str(f->data, f->data + f->length);
+      if ((f = f->next) != nullptr)
+      {
+        rec->score = parse_double(f);
+        f = f->next;
+      }
+    }
+    if (f != nullptr)
+    {
+      const char* p = f->data;
+      const char* tags_end = f->data + f->length;
+      Str* tail = nullptr;
+      for (size_t t = 0; (t < MAX_TAGS) && (p < tags_end); t++)
+      {
+        auto* semi = (const char*)memchr(p, ';', (size_t)(tags_end - p));
+        const char* tag_end = semi == nullptr ? tags_end : semi;
+        auto* tag = new Str(p, tag_end);
+        if (tail == nullptr)
+          rec->tags = tag;
+        else
+          tail->next = tag;
+        tail = tag;
+        p = semi == nullptr ? tags_end : semi + 1;
+      }
+    }
+    if constexpr (rt == RegionType::Rc)
+      decref(row);
+
+    // In rc regions the record's count of one is the batch's reference.
+    rec->next = batch->first;
+    batch->first = rec;
+    batch->records++;
+  }
+
+  template<RegionType rt>
+  void report(Ingest<rt>& in)
+  {
+    if (in.reported.exchange(true))
+      return;
+
+    uint64_t total_ns = ns_since(in.start);
+    double seconds = (double)total_ns / 1e9;
+    double mb = (double)in.bytes / (1024 * 1024);
+    auto ms = [](uint64_t ns) { return (double)ns / 1e6; };
+    auto pct = [](uint64_t part, uint64_t whole) {
+      return whole == 0 ? 0.0 : 100.0 * (double)part / (double)whole;
+    };
+
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "Ingested " << mb << " MiB, " << in.records
+              << " records in " << in.batches.load() << " batches, in "
+              << ms(total_ns) << " ms: " << mb / seconds << " MB/s, "
+              << std::setprecision(0) << (double)in.records / seconds
+              << " records/s\n";
+    std::cout << std::setprecision(1);
+    std::cout << "  producer:  parse " << ms(in.parse_ns) << " ms, gc "
+              << ms(in.produce_gc_ns) << " ms ("
+              << pct(in.produce_gc_ns, in.parse_ns + in.produce_gc_ns)
+              << "%)\n";
+    uint64_t consume = in.consume_ns.load();
+    uint64_t consume_gc = in.consume_gc_ns.load();
+    std::cout << "  consumers: work " << ms(consume) << " ms, gc "
+              << ms(consume_gc) << " ms (" << pct(consume_gc, consume)
+              << "%)\n";
+    std::cout << std::defaultfloat;
+  }
+
+  template<RegionType rt>
+  void consumed(Ingest<rt>& in)
+  {
+    if (in.consumed.fetch_add(1) + 1 == in.batches.load())
+      report(in);
+  }
+
+  /// Read the records of a batch, and return a checksum of them.
+  inline uint64_t read_batch(const Batch* batch)
+  {
+    uint64_t sum = 0;
+    for (const Record* r = batch->first; r != nullptr; r = r->next)
+    {
+      sum += r->id + (uint64_t)r->score;
+      if (r->name != nullptr)
+        sum += r->name->length;
+      for (const Str* t = r->tags; t != nullptr; t = t->next)
+        sum++;
+    }
+    return sum;
+  }
+
+  template<RegionType rt>
+  void consume(Ingest<rt>& in, Consumer& c, Batch* batch)
+  {
+    auto start = Clock::now();
+    if (in.o.freeze && rt == RegionType::Trace)
+    {
+      c.checksum += read_batch(batch);
+      Immutable::release(batch);
+    }
+    else
+    {
+      {
+        UsingRegion rr(batch);
+        c.checksum += read_batch(batch);
+
+        // Keep only the fields this consumer wants.
+        for (Record* r = batch->first; r != nullptr; r = r->next)
+        {
+          Str* tags = r->tags;
+          r->tags = nullptr;
+          if constexpr (rt == RegionType::Rc)
+          {
+            if (tags != nullptr)
+              decref(tags);
+          }
+        }
+
+        auto gc_start = Clock::now();
+        region_collect();
+        in.consume_gc_ns += ns_since(gc_start);
+      }
+      region_release(batch);
+    }
+    in.consume_ns += ns_since(start);
+    consumed(in);
+  }
+
+  template<RegionType rt>
+  void produce(std::shared_ptr<Ingest<rt>> p)
+  {
+    Ingest<rt>& in = *p;
+    LineReader lines(in.o.chunk_bytes);
+    if (!lines.open(in.path))
+    {
+      std::cerr << "Could not open " << in.path << "\n";
+      in.batches = 0;
+      report(in);
+      return;
+    }
+    in.bytes = lines.get_size();
+
+    size_t batches = 0;
+    const char* begin;
+    const char* end;
+    bool more = true;
+    while (more)
+    {
+      auto* batch = new (rt) Batch;
+      {
+        UsingRegion rr(batch);
+        auto parse_start = Clock::now();
+        while ((batch->records < in.o.batch) &&
+               (more = lines.next(begin, end)))
+        {
+          if (begin != end)
+            add_record<rt>(batch, begin, end);
+        }
+        in.parse_ns += ns_since(parse_start);
+
+        auto gc_start = Clock::now();
+        region_collect();
+        in.produce_gc_ns += ns_since(gc_start);
+      }
+
+      if (batch->records == 0)
+      {
+        region_release(batch);
+        break;
+      }
+      in.records += batch->records;
+
+      if (in.o.freeze && rt == RegionType::Trace)
+        freeze(batch);
+      when(in.consumers[batches++ % in.consumers.size()])
+        << [p, batch](auto c) { consume(*p, *c, batch); };
+    }
+
+    in.batches = batches;
+    if (in.consumed.load() == batches)
+      report(in);
+  }
+
+  template<RegionType rt>
+  void run_test(const Options& o)
+  {
+    if (o.batch == 0 || o.consumers == 0 || o.chunk_bytes == 0)
+      return;
+
+    if (o.freeze && rt != RegionType::Trace)
+      std::cout << "Only trace regions can be frozen, so batches are "
+                   "handed to the consumers instead.\n";
+
+    std::string path = o.input.empty() ? generated_input(o.generate_mb) :
+                                         o.input;
+    auto p = std::make_shared<Ingest<rt>>(o, path);
+    when(p->reader) << [p](auto) { produce(p); };
+  }
+} // namespace ingest
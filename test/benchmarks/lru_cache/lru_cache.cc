@@ -0,0 +1,52 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#include "lru_cache.h"
+
+#include "../../../src/benchmarker/export_macro.h"
+#include "../benchmarker/benchmark_main_helper.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <debug/harness.h>
+#include <test/opt.h>
+
+BENCHMARK_WINDOWS_CALLBACK_BRIDGE()
+
+MAKE_REGION_WRAPPER(test, lru_cache::run_test);
+
+extern "C" BENCHMARK_EXPORT int run_benchmark(int argc, char** argv)
+{
+  opt::Opt opt(argc, argv);
+
+  enable_benchmark_logging(opt);
+  RegionType rt = parse_region_type(opt);
+  parse_gc_options(opt);
+
+  // Cache sizes to run, as a comma separated list of entry counts.
+  const char* entries = "10000,100000,1000000";
+  for (int i = 1; i + 1 < argc; i++)
+  {
+    if (std::strcmp(argv[i], "--entries") == 0)
+      entries = argv[i + 1];
+  }
+  std::vector<size_t> sizes;
+  for (const char* p = entries; *p != '\0';)
+  {
+    char* end;
+    sizes.push_back(std::strtoull(p, &end, 10));
+    p = (*end == ',') ? end + 1 : end + std::strlen(end);
+  }
+
+  lru_cache::Options o;
+  o.ops = opt.is<size_t>("--ops", 1000000);
+  o.collect_every = opt.is<size_t>("--collect-every", 100000);
+  o.get_percent = opt.is<size_t>("--get-percent", 90);
+  o.hot_percent = opt.is<size_t>("--hot-percent", 10);
+  o.seed = opt.is<size_t>("--seed", 12345);
+
+  DISPATCH_REGION(rt, test, sizes, o);
+
+  return 0;
+}
+
+RUN_BENCHMARK_MAIN()
@@ -0,0 +1,358 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <debug/harness.h>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+#include <verona.h>
+
+/**
+ * A long-lived cache with a small, hot working set.
+ *
+ * A region holds an LRU cache of `entries` entries: a hash index of
+ * buckets, each a chain of entries, and a list of every entry from the
+ * most to the least recently used. Gets move what they find to the front
+ * of the list, and puts of a new key evict the least recently used entry.
+ * Most operations go to a small set of hot keys, so the heap barely
+ * changes between collections, and the region is collected every
+ * `collect_every` operations.
+ *
+ * This is the case where collectors that copy or trace the whole region
+ * do the most work for the least garbage. The benchmark runs once for each
+ * cache size it is given and reports the cost of a collection against the
+ * size of the live heap.
+ **/
+namespace lru_cache
+{
+  struct Entry : public V<Entry>
+  {
+    /// The next less recently used entry. Owns it.
+    Entry* next = nullptr;
+    /// The next entry in the same bucket. Owns it.
+    Entry* chain = nullptr;
+    /// The next more recently used entry. Not traced, so Rc regions count
+    /// the list once.
+    Entry* prev = nullptr;
+    uint64_t key = 0;
+    uint64_t value[4] = {};
+
+    void trace(ObjectStack& st) const
+    {
+      if (next != nullptr)
+        st.push(next);
+      if (chain != nullptr)
+        st.push(chain);
+    }
+
+    void relocate(Object* (*fwd)(Object*))
+    {
+      if (next != nullptr)
+        next = (Entry*)fwd(next);
+      if (chain != nullptr)
+        chain = (Entry*)fwd(chain);
+      if (prev != nullptr)
+        prev = (Entry*)fwd(prev);
+    }
+  };
+
+  /// Number of buckets in a Buckets object, and of those in the cache.
+  static constexpr size_t SLOTS = 4096;
+
+  struct Buckets : public V<Buckets>
+  {
+    Entry* head[SLOTS] = {};
+
+    void trace(ObjectStack& st) const
+    {
+      for (Entry* e : head)
+      {
+        if (e != nullptr)
+          st.push(e);
+      }
+    }
+
+    void relocate(Object* (*fwd)(Object*))
+    {
+      for (Entry*& e : head)
+      {
+        if (e != nullptr)
+          e = (Entry*)fwd(e);
+      }
+    }
+  };
+
+  /**
+   * The entry point of the region. `oldest` is not traced, for the same
+   * reason as Entry::prev.
+   */
+  struct Cache : public V<Cache>
+  {
+    Entry* newest = nullptr;
+    Entry* oldest = nullptr;
+    size_t size = 0;
+    /// log2 of the number of buckets.
+    size_t bucket_bits = 0;
+    Buckets* buckets[SLOTS] = {};
+
+    void trace(ObjectStack& st) const
+    {
+      if (newest != nullptr)
+        st.push(newest);
+      for (Buckets* b : buckets)
+      {
+        if (b != nullptr)
+          st.push(b);
+      }
+    }
+
+    void relocate(Object* (*fwd)(Object*))
+    {
+      if (newest != nullptr)
+        newest = (Entry*)fwd(newest);
+      if (oldest != nullptr)
+        oldest = (Entry*)fwd(oldest);
+      for (Buckets*& b : buckets)
+      {
+        if (b != nullptr)
+          b = (Buckets*)fwd(b);
+      }
+    }
+
+    /// The head of the chain `key` hashes to.
+    Entry*& bucket(uint64_t key)
+    {
+      uint64_t h = (key * 0x9E3779B97F4A7C15ULL) >> (64 - bucket_bits);
+      return buckets[h / SLOTS]->head[h % SLOTS];
+    }
+  };
+
+  /// The entry for `key`, or nullptr.
+  inline Entry* find(Cache* cache, uint64_t key)
+  {
+    for (Entry* e = cache->bucket(key); e != nullptr; e = e->chain)
+    {
+      if (e->key == key)
+        return e;
+    }
+    return nullptr;
+  }
+
+  /// Move `e` to the front of the list. Only moves ownership, so no
+  /// counts change.
+  inline void move_to_front(Cache* cache, Entry* e)
+  {
+    if (cache->newest == e)
+      return;
+
+    Entry* newer = e->prev;
+    Entry* older = e->next;
+    store(newer->next, older);
+    if (older != nullptr)
+      older->prev = newer;
+    else
+      cache->oldest = newer;
+
+    store(e->next, cache->newest);
+    cache->newest->prev = e;
+    e->prev = nullptr;
+    store(cache->newest, e);
+  }
+
+  /// Unlink the least recently used entry from the list and its bucket.
+  template<RegionType rt>
+  void evict(Cache* cache)
+  {
+    Entry* e = cache->oldest;
+    Entry* newer = e->prev;
+    if (newer != nullptr)
+      store(newer->next, (Entry*)nullptr);
+    else
+      store(cache->newest, (Entry*)nullptr);
+    cache->oldest = newer;
+
+    Entry** slot = &cache->bucket(e->key);
+    while (*slot != e)
+      slot = &(*slot)->chain;
+    store(*slot, e->chain);
+    store(e->chain, (Entry*)nullptr);
+    cache->size--;
+
+    // Drop the references of the list and the bucket.
+    if constexpr (rt == RegionType::Rc)
+    {
+      decref(e);
+      decref(e);
+    }
+  }
+
+  /**
+   * Insert or update `key`. A new entry is allocated before any other
+   * pointer into the region is taken, so a collector that moves objects
+   * when it allocates cannot leave one stale.
+   */
+  template<RegionType rt>
+  void put(Cache* cache, size_t capacity, uint64_t key, uint64_t value)
+  {
+    if (Entry* e = find(cache, key); e != nullptr)
+    {
+      e->value[0] = value;
+      move_to_front(cache, e);
+      return;
+    }
+
+    auto* e = new Entry;
+    e->key = key;
+    e->value[0] = value;
+
+    if (cache->size == capacity)
+      evict<rt>(cache);
+
+    store(e->next, cache->newest);
+    if (cache->newest != nullptr)
+      cache->newest->prev = e;
+    else
+      cache->oldest = e;
+    store(cache->newest, e);
+
+    Entry*& head = cache->bucket(key);
+    store(e->chain, head);
+    store(head, e);
+    cache->size++;
+
+    // The list holds the reference the entry was created with, and the
+    // bucket takes another.
+    if constexpr (rt == RegionType::Rc)
+      incref(e);
+  }
+
+  struct Options
+  {
+    size_t ops;
+    size_t collect_every;
+    size_t get_percent;
+    size_t hot_percent;
+    uint64_t seed;
+  };
+
+  template<RegionType rt>
+  void run_size(size_t capacity, const Options& o)
+  {
+    // One bucket per entry, up to SLOTS tables of SLOTS buckets.
+    size_t bucket_bits = 12;
+    while ((size_t{1} << bucket_bits) < capacity && bucket_bits < 24)
+      bucket_bits++;
+    size_t tables = (size_t{1} << bucket_bits) / SLOTS;
+
+    size_t hits = 0;
+    size_t gets = 0;
+    size_t collections = 0;
+    uint64_t collect_ns = 0;
+    uint64_t max_collect_ns = 0;
+    size_t live_bytes = 0;
+
+    auto* cache = new (rt) Cache;
+    {
+      UsingRegion rr(cache);
+
+      // Make room for all the tables first in regions that collect to
+      // grow, so that the space grows once rather than once per table.
+      if constexpr (rt == RegionType::SemiSpace || rt == RegionType::Compact)
+        region_ensure_available(tables * vsizeof<Buckets>);
+      cache->bucket_bits = bucket_bits;
+      for (size_t t = 0; t < tables; t++)
+        cache->buckets[t] = new Buckets;
+
+      // Keys range over twice the capacity, so about half of the gets of
+      // cold keys miss. Hot keys are the first `hot_percent` of them, and
+      // get nine in ten operations.
+      uint64_t key_space = 2 * capacity;
+      uint64_t hot_keys =
+        std::max<uint64_t>(1, key_space * o.hot_percent / 100);
+      std::mt19937_64 rng(o.seed);
+      std::uniform_int_distribution<size_t> percent(0, 99);
+      std::uniform_int_distribution<uint64_t> hot(0, hot_keys - 1);
+      std::uniform_int_distribution<uint64_t> any(0, key_space - 1);
+
+      for (uint64_t k = 0; k < capacity; k++)
+        put<rt>(cache, capacity, k * 2, k);
+
+      for (size_t i = 1; i <= o.ops; i++)
+      {
+        uint64_t key = percent(rng) < 90 ? hot(rng) : any(rng);
+        if (percent(rng) < o.get_percent)
+        {
+          gets++;
+          if (Entry* e = find(cache, key); e != nullptr)
+          {
+            hits++;
+            move_to_front(cache, e);
+          }
+        }
+        else
+        {
+          put<rt>(cache, capacity, key, i);
+        }
+
+        if (o.collect_every != 0 && i % o.collect_every == 0)
+        {
+          auto start = std::chrono::steady_clock::now();
+          region_collect();
+          uint64_t ns =
+            (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+              std::chrono::steady_clock::now() - start)
+              .count();
+          collections++;
+          collect_ns += ns;
+          max_collect_ns = std::max(max_collect_ns, ns);
+          live_bytes = debug_memory_used();
+        }
+      }
+      check(cache->size == capacity);
+      if (collections == 0)
+        live_bytes = debug_memory_used();
+    }
+
+    uint64_t avg_ns = collections == 0 ? 0 : collect_ns / collections;
+    double mib = (double)live_bytes / (1024 * 1024);
+    std::cout << std::setw(10) << capacity << std::setw(14) << live_bytes
+              << std::setw(8) << collections << std::setw(14) << avg_ns
+              << std::setw(14) << max_collect_ns << std::setw(14)
+              << std::fixed << std::setprecision(0)
+              << (mib == 0 ? 0.0 : (double)avg_ns / mib) << std::setw(8)
+              << std::setprecision(1)
+              << (gets == 0 ? 0.0 : 100.0 * (double)hits / (double)gets)
+              << std::defaultfloat << "\n";
+
+    region_release(cache);
+  }
+
+  template<RegionType rt>
+  void run_test(const std::vector<size_t>& sizes, Options o)
+  {
+    std::cout << "LRU cache: " << o.ops << " operations per size, "
+              << o.get_percent << "% gets, collecting every "
+              << o.collect_every << "\n";
+    if constexpr (rt == RegionType::Arena)
+    {
+      if (!RegionArena::get_collectable())
+        std::cout << "Arena regions are only collected with --arena-gc.\n";
+    }
+    std::cout << std::setw(10) << "entries" << std::setw(14) << "live_bytes"
+              << std::setw(8) << "gcs" << std::setw(14) << "avg_gc_ns"
+              << std::setw(14) << "max_gc_ns" << std::setw(14) << "ns_per_MiB"
+              << std::setw(8) << "hit%" << "\n";
+
+    for (size_t capacity : sizes)
+    {
+      if (capacity != 0)
+        run_size<rt>(capacity, o);
+    }
+  }
+} // namespace lru_cache
@@ -0,0 +1,34 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#include "mark_throughput.h"
+
+#include "../../../src/benchmarker/export_macro.h"
+#include "../benchmarker/benchmark_main_helper.h"
+
+#include <debug/harness.h>
+#include <test/opt.h>
+
+BENCHMARK_WINDOWS_CALLBACK_BRIDGE()
+
+MAKE_REGION_WRAPPER(test, mark_throughput::run_test);
+
+extern "C" BENCHMARK_EXPORT int run_benchmark(int argc, char** argv)
+{
+  opt::Opt opt(argc, argv);
+
+  enable_benchmark_logging(opt);
+  RegionType rt = parse_region_type(opt);
+  parse_gc_options(opt);
+
+  // Parse command-line arguments
+  size_t seed = opt.is<size_t>("--seed", 0);
+  size_t nodes = opt.is<size_t>("--nodes", 1 << 20);
+  int collections = opt.is<int>("--collections", 5);
+  mark_throughput::bulk_trace = opt.has("--bulk-trace");
+
+  DISPATCH_REGION(rt, test, nodes, collections, seed);
+
+  return 0;
+}
+
+RUN_BENCHMARK_MAIN()
@@ -0,0 +1,145 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <debug/harness.h>
+#include <iostream>
+#include <random>
+#include <vector>
+#include <verona.h>
+
+using namespace snmalloc;
+using namespace verona::rt;
+using namespace verona::rt::api;
+
+/**
+ * Collector throughput on a large pointer-chasing graph.
+ *
+ * The region holds `nodes` objects, all reachable, linked into a chain in a
+ * random order and given random extra edges, so tracing from the root jumps
+ * around the heap and is bound by cache misses. Each collection keeps
+ * everything, and the benchmark reports how many objects per second the
+ * collector gets through.
+ *
+ * For the trace region, compare with and without --no-mark-prefetch. With
+ * `bulk_trace`, nodes push their children with one push_range() rather
+ * than a push() each.
+ **/
+namespace mark_throughput
+{
+  static constexpr size_t EDGES = 3;
+
+  inline bool bulk_trace = false;
+
+  struct Node : public V<Node>
+  {
+    Node* next = nullptr;
+    Node* edges[EDGES] = {};
+
+    void trace(ObjectStack& st) const
+    {
+      if (bulk_trace)
+      {
+        Object* children[EDGES + 1];
+        size_t n = 0;
+        if (next != nullptr)
+          children[n++] = next;
+        for (auto* e : edges)
+        {
+          if (e != nullptr)
+            children[n++] = e;
+        }
+        st.push_range(children, n);
+        return;
+      }
+
+      if (next != nullptr)
+        st.push(next);
+      for (auto* e : edges)
+      {
+        if (e != nullptr)
+          st.push(e);
+      }
+    }
+
+    void relocate(Object* (*fwd)(Object*))
+    {
+      if (next != nullptr)
+        next = (Node*)fwd(next);
+      for (auto*& e : edges)
+      {
+        if (e != nullptr)
+          e = (Node*)fwd(e);
+      }
+    }
+  };
+
+  template<RegionType rt>
+  void run_test(size_t nodes, int collections, size_t seed)
+  {
+    if constexpr (rt == RegionType::Arena || rt == RegionType::Rc)
+    {
+      std::cout << "Mark throughput needs a tracing collector, skipping.\n";
+      UNUSED(nodes, collections, seed);
+      return;
+    }
+    else
+    {
+      auto* root = new (rt) Node;
+
+      {
+        UsingRegion rr(root);
+
+        // Building the graph holds C++ pointers to every node, so it must
+        // not trigger a collection in a moving region.
+        if constexpr (
+          rt == RegionType::SemiSpace || rt == RegionType::Compact)
+          region_ensure_available(nodes * vsizeof<Node>);
+
+        std::mt19937 rng(static_cast<std::mt19937::result_type>(seed));
+        std::vector<Node*> all(nodes);
+        for (auto& n : all)
+          n = new Node;
+
+        std::vector<Node*> order = all;
+        std::shuffle(order.begin(), order.end(), rng);
+        std::uniform_int_distribution<size_t> pick(0, nodes - 1);
+        for (size_t i = 0; i < nodes; i++)
+        {
+          if (i + 1 < nodes)
+            order[i]->next = order[i + 1];
+          for (auto*& e : order[i]->edges)
+            e = all[pick(rng)];
+        }
+        root->next = order.empty() ? nullptr : order[0];
+
+        uint64_t total_ns = 0;
+        for (int i = 0; i < collections; i++)
+        {
+          auto t_start = std::chrono::high_resolution_clock::now();
+          region_collect();
+          auto t_end = std::chrono::high_resolution_clock::now();
+          uint64_t ns = static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(
+              t_end - t_start)
+              .count());
+          total_ns += ns;
+
+          check(region_stats().objects == nodes + 1);
+          std::cout << "Collection " << i << ": " << ns / 1000 << " us\n";
+        }
+
+        if (total_ns > 0)
+        {
+          double per_second = static_cast<double>(nodes + 1) * collections *
+            1e9 / static_cast<double>(total_ns);
+          std::cout << "Throughput: " << per_second << " objects/s\n";
+        }
+      }
+
+      region_release(root);
+    }
+  }
+} // namespace mark_throughput
@@ -0,0 +1,32 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#include "merge_tree.h"
+
+#include "../../../src/benchmarker/export_macro.h"
+#include "../benchmarker/benchmark_main_helper.h"
+
+#include <debug/harness.h>
+#include <test/opt.h>
+
+BENCHMARK_WINDOWS_CALLBACK_BRIDGE()
+
+MAKE_REGION_WRAPPER(test, merge_tree::run_test);
+
+extern "C" BENCHMARK_EXPORT int run_benchmark(int argc, char** argv)
+{
+  opt::Opt opt(argc, argv);
+
+  enable_benchmark_logging(opt);
+  RegionType rt = parse_region_type(opt);
+  parse_gc_options(opt);
+
+  // Parse command-line arguments
+  size_t leaves = opt.is<size_t>("--leaves", 1024);
+  size_t leaf_depth = opt.is<size_t>("--leaf-depth", 6);
+
+  DISPATCH_REGION(rt, test, leaves, leaf_depth);
+
+  return 0;
+}
+
+RUN_BENCHMARK_MAIN()
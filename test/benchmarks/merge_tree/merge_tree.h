@@ -0,0 +1,172 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "cpp/cown.h"
+#include "cpp/when.h"
+
+#include <atomic>
+#include <chrono>
+#include <debug/harness.h>
+#include <iostream>
+#include <vector>
+#include <verona.h>
+
+using namespace verona::cpp;
+
+/**
+ * Region merge cost in a parallel tree build.
+ *
+ * Each of `leaves` cowns builds a complete binary tree of depth `leaf_depth`
+ * in a region of its own, in parallel. The regions are then merged pairwise
+ * up a reduction tree: each merge moves the right region into the left one
+ * and joins the two trees under a new node, until one region holds the
+ * whole tree. The benchmark reports the time spent in merge itself.
+ *
+ * Only trace, arena and semispace regions support merging.
+ **/
+namespace merge_tree
+{
+  struct Node : public V<Node>
+  {
+    Node* left = nullptr;
+    Node* right = nullptr;
+
+    void trace(ObjectStack& st) const
+    {
+      if (left != nullptr)
+        st.push(left);
+      if (right != nullptr)
+        st.push(right);
+    }
+
+    void relocate(Object* (*fwd)(Object*))
+    {
+      if (left != nullptr)
+        left = (Node*)fwd(left);
+      if (right != nullptr)
+        right = (Node*)fwd(right);
+    }
+  };
+
+  // Cown that owns a region, until the region is merged into another one.
+  struct LeafCown
+  {
+    Node* root = nullptr;
+
+    ~LeafCown()
+    {
+      if (root != nullptr)
+        region_release(root);
+    }
+  };
+
+  inline std::atomic<uint64_t> merge_ns{0};
+  inline std::atomic<size_t> merges{0};
+
+  inline Node* build_tree(size_t depth)
+  {
+    if (depth == 0)
+      return nullptr;
+
+    auto* node = new Node;
+    node->left = build_tree(depth - 1);
+    node->right = build_tree(depth - 1);
+    return node;
+  }
+
+  template<RegionType rt>
+  void run_test(size_t leaves, size_t leaf_depth)
+  {
+    if constexpr (
+      rt != RegionType::Trace && rt != RegionType::Arena &&
+      rt != RegionType::SemiSpace)
+    {
+      std::cout << "Merge tree needs a region that supports merge, skipping.\n";
+      UNUSED(leaves, leaf_depth);
+      return;
+    }
+    else
+    {
+      if (leaves == 0)
+        return;
+
+      merge_ns = 0;
+      merges = 0;
+
+      std::vector<cown_ptr<LeafCown>> cowns;
+      for (size_t i = 0; i < leaves; i++)
+      {
+        cowns.push_back(make_cown<LeafCown>());
+        when(cowns.back()) << [leaf_depth](auto c) {
+          auto* root = new (rt) Node;
+          {
+            UsingRegion rr(root);
+            // A semispace collection during the build would free the nodes
+            // not yet linked to the root.
+            if constexpr (rt == RegionType::SemiSpace)
+              region_ensure_available(
+                ((size_t{1} << leaf_depth) - 1) * vsizeof<Node>);
+            root->left = build_tree(leaf_depth);
+          }
+          c->root = root;
+        };
+      }
+
+      // Behaviours on a cown run in the order they were scheduled, so every
+      // level of the reduction can be scheduled up front.
+      for (size_t stride = 1; stride < leaves; stride *= 2)
+      {
+        for (size_t i = 0; i + stride < leaves; i += 2 * stride)
+        {
+          when(cowns[i], cowns[i + stride]) << [](auto a, auto b) {
+            Node* other = b->root;
+            b->root = nullptr;
+
+            UsingRegion rr(a->root);
+            // Allocate before merging, as an allocation may collect, which
+            // would free `other` before it is linked in.
+            auto* join = new Node;
+            join->left = a->root->left;
+            a->root->left = join;
+
+            auto t_start = std::chrono::high_resolution_clock::now();
+            merge(other);
+            auto t_end = std::chrono::high_resolution_clock::now();
+            merge_ns += static_cast<uint64_t>(
+              std::chrono::duration_cast<std::chrono::nanoseconds>(
+                t_end - t_start)
+                .count());
+            merges++;
+
+            // `other` is an ordinary object of this region now.
+            join->right = other->left;
+          };
+        }
+      }
+
+      when(cowns[0]) << [leaves, leaf_depth](auto c) {
+        UsingRegion rr(c->root);
+
+        // The root, every leaf tree, and a join node per merge. The merged
+        // roots are garbage.
+        size_t live = 1 + leaves * ((size_t{1} << leaf_depth) - 1) + leaves - 1;
+        if constexpr (rt != RegionType::Arena)
+        {
+          region_collect();
+          check(debug_size() == live);
+        }
+        else
+        {
+          check(debug_size() == live + leaves - 1);
+        }
+
+        size_t n = merges;
+        check(n == leaves - 1);
+        std::cout << "Merges: " << n << "\n";
+        if (n > 0)
+          std::cout << "Average merge: " << merge_ns / n << " ns\n";
+      };
+    }
+  }
+} // namespace merge_tree
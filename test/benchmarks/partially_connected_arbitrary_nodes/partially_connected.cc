@@ -20,6 +20,7 @@ extern "C" BENCHMARK_EXPORT int run_benchmark(int argc, char** argv)
 
   enable_benchmark_logging(opt);
   RegionType rt = parse_region_type(opt);
+  parse_gc_options(opt);
 
   int size = opt.is<int>("--size", 101);
   int regions = opt.is<int>("--regions", 10);
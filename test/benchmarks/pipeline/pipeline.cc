@@ -0,0 +1,42 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#include "pipeline.h"
+
+#include "../../../src/benchmarker/export_macro.h"
+#include "../benchmarker/benchmark_main_helper.h"
+
+#include <cstring>
+#include <debug/harness.h>
+#include <test/opt.h>
+
+BENCHMARK_WINDOWS_CALLBACK_BRIDGE()
+
+MAKE_REGION_WRAPPER(test, pipeline::run_test);
+
+extern "C" BENCHMARK_EXPORT int run_benchmark(int argc, char** argv)
+{
+  opt::Opt opt(argc, argv);
+
+  enable_benchmark_logging(opt);
+  RegionType rt = parse_region_type(opt);
+  parse_gc_options(opt);
+
+  pipeline::Options o;
+  o.stages = opt.is<size_t>("--stages", 4);
+  o.width = opt.is<size_t>("--width", 1);
+  o.regions = opt.is<size_t>("--regions", 10000);
+  o.objects = opt.is<size_t>("--objects", 64);
+  o.immutables = opt.is<size_t>("--immutables", 16);
+  o.sink_collect = opt.is<size_t>("--sink-collect", 100);
+  o.sink = pipeline::SinkMode::Merge;
+  if (opt.has("--sink-freeze"))
+    o.sink = pipeline::SinkMode::Freeze;
+  else if (opt.has("--sink-release"))
+    o.sink = pipeline::SinkMode::Release;
+
+  DISPATCH_REGION(rt, test, o);
+
+  return 0;
+}
+
+RUN_BENCHMARK_MAIN()
@@ -0,0 +1,352 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "cpp/cown.h"
+#include "cpp/when.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <debug/harness.h>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <vector>
+#include <verona.h>
+
+using namespace verona::cpp;
+
+/**
+ * Regions passed down a pipeline of cowns.
+ *
+ * Stage 0 builds each region: a list of `objects` nodes, which in trace
+ * and arena regions also refer to a few of a shared set of immutables,
+ * so that the region has a remembered set. Every later stage opens the
+ * region it is handed, replaces every other node with a new one, collects
+ * it, and hands it on in a behaviour on the next stage. The sink at the
+ * end merges each region into one of its own (trace and arena), freezes
+ * it (trace), or releases it. Each stage has `width` cowns, and region `i`
+ * goes through cown `i % width` of every stage.
+ *
+ * Regions are allocated by one scheduler thread and collected and freed
+ * by others, so this exercises the transfer of regions between cowns,
+ * merging and freezing, remembered set merging, and deallocation from a
+ * thread other than the allocating one. The benchmark reports regions per
+ * second end to end, and the time each stage spends working and
+ * collecting.
+ **/
+namespace pipeline
+{
+  struct Node : public V<Node>
+  {
+    Node* next = nullptr;
+    /// A region merged into the sink's, at the sink.
+    Node* merged = nullptr;
+    /// An immutable, in trace regions.
+    Object* imm = nullptr;
+    uint64_t payload[4] = {};
+
+    void trace(ObjectStack& st) const
+    {
+      if (next != nullptr)
+        st.push(next);
+      if (merged != nullptr)
+        st.push(merged);
+      if (imm != nullptr)
+        st.push(imm);
+    }
+
+    void relocate(Object* (*fwd)(Object*))
+    {
+      if (next != nullptr)
+        next = (Node*)fwd(next);
+      if (merged != nullptr)
+        merged = (Node*)fwd(merged);
+    }
+  };
+
+  enum class SinkMode
+  {
+    Merge,
+    Freeze,
+    Release
+  };
+
+  struct Options
+  {
+    size_t stages;
+    size_t width;
+    size_t regions;
+    size_t objects;
+    size_t immutables;
+    SinkMode sink;
+    /// Merged regions between collections of the sink's region.
+    size_t sink_collect;
+  };
+
+  struct StageStats
+  {
+    std::atomic<size_t> regions{0};
+    std::atomic<uint64_t> work_ns{0};
+    std::atomic<uint64_t> gc_ns{0};
+  };
+
+  struct Stage
+  {};
+
+  struct Sink
+  {
+    Node* acc = nullptr;
+    size_t received = 0;
+
+    ~Sink()
+    {
+      if (acc != nullptr)
+        region_release(acc);
+    }
+  };
+
+  using Clock = std::chrono::steady_clock;
+
+  inline uint64_t ns_since(Clock::time_point start)
+  {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+             Clock::now() - start)
+      .count();
+  }
+
+  template<RegionType rt>
+  struct Pipeline
+  {
+    Options o;
+    std::vector<std::vector<cown_ptr<Stage>>> stages;
+    cown_ptr<Sink> sink = make_cown<Sink>();
+    /// One per stage, and the last for the sink.
+    std::vector<StageStats> stats;
+    std::vector<Object*> imms;
+    Clock::time_point start = Clock::now();
+
+    Pipeline(const Options& o) : o(o), stats(o.stages + 1)
+    {
+      for (size_t s = 0; s < o.stages; s++)
+      {
+        stages.emplace_back();
+        for (size_t w = 0; w < o.width; w++)
+          stages.back().push_back(make_cown<Stage>());
+      }
+
+      if constexpr (rt == RegionType::Trace || rt == RegionType::Arena)
+      {
+        for (size_t i = 0; i < o.immutables; i++)
+        {
+          auto* imm = new (RegionType::Trace) Node;
+          freeze(imm);
+          imms.push_back(imm);
+        }
+      }
+    }
+
+    ~Pipeline()
+    {
+      for (Object* imm : imms)
+        Immutable::release(imm);
+    }
+  };
+
+  /// Make room for `n` nodes in regions that would otherwise move objects
+  /// to grow while they are being linked.
+  template<RegionType rt>
+  void reserve(size_t n)
+  {
+    if constexpr (rt == RegionType::SemiSpace || rt == RegionType::Compact)
+      region_ensure_available(n * vsizeof<Node>);
+  }
+
+  template<RegionType rt>
+  Node* build(Pipeline<rt>& p, size_t i)
+  {
+    auto* root = new (rt) Node;
+    UsingRegion rr(root);
+    reserve<rt>(p.o.objects);
+
+    Node* last = root;
+    for (size_t n = 0; n < p.o.objects; n++)
+    {
+      auto* node = new Node;
+      node->payload[0] = n;
+      last->next = node;
+      last = node;
+    }
+
+    if constexpr (rt == RegionType::Trace || rt == RegionType::Arena)
+    {
+      using RegionClass = typename RegionType_to_class<rt>::T;
+      std::mt19937_64 rng(i);
+      size_t n = 0;
+      for (Node* node = root->next; node != nullptr && n < 4;
+           node = node->next)
+      {
+        Object* imm = p.imms[rng() % p.imms.size()];
+        RegionClass::template insert<NoTransfer>(root, imm);
+        if constexpr (rt == RegionType::Trace)
+          node->imm = imm;
+        n++;
+      }
+    }
+    return root;
+  }
+
+  /// Replace every other node of the region with a new one, and collect.
+  template<RegionType rt>
+  void churn(Pipeline<rt>& p, StageStats& stats, Node* root)
+  {
+    UsingRegion rr(root);
+    reserve<rt>(p.o.objects / 2 + 1);
+
+    Node* prev = root;
+    bool replace = false;
+    while (Node* cur = prev->next)
+    {
+      if (replace)
+      {
+        auto* node = new Node;
+        node->payload[0] = cur->payload[0];
+        node->imm = cur->imm;
+        node->next = cur->next;
+        cur->next = nullptr;
+        prev->next = node;
+        if constexpr (rt == RegionType::Rc)
+          decref(cur);
+        cur = node;
+      }
+      replace = !replace;
+      prev = cur;
+    }
+
+    auto start = Clock::now();
+    region_collect();
+    stats.gc_ns += ns_since(start);
+  }
+
+  template<RegionType rt>
+  void receive(Pipeline<rt>& p, Sink& s, Node* root)
+  {
+    StageStats& stats = p.stats[p.o.stages];
+    auto start = Clock::now();
+
+    constexpr bool can_merge =
+      rt == RegionType::Trace || rt == RegionType::Arena;
+    if (p.o.sink == SinkMode::Merge && can_merge)
+    {
+      if (s.acc == nullptr)
+      {
+        s.acc = root;
+      }
+      else
+      {
+        UsingRegion rr(s.acc);
+        merge(root);
+        root->merged = s.acc->merged;
+        s.acc->merged = root;
+
+        // Drop what has been merged so far now and then, so the collection
+        // of the merged region is measured too.
+        if (p.o.sink_collect != 0 && s.received % p.o.sink_collect == 0)
+        {
+          s.acc->merged = nullptr;
+          auto gc_start = Clock::now();
+          region_collect();
+          stats.gc_ns += ns_since(gc_start);
+        }
+      }
+    }
+    else if (p.o.sink == SinkMode::Freeze && rt == RegionType::Trace)
+    {
+      freeze(root);
+      Immutable::release(root);
+    }
+    else
+    {
+      region_release(root);
+    }
+
+    stats.work_ns += ns_since(start);
+    stats.regions++;
+    s.received++;
+
+    if (s.received == p.o.regions)
+    {
+      uint64_t total_ns = ns_since(p.start);
+      std::cout << "Regions: " << p.o.regions << " through " << p.o.stages
+                << " stages of " << p.o.width << " cowns in "
+                << total_ns / 1000000 << " ms, " << std::fixed
+                << std::setprecision(0)
+                << (double)p.o.regions * 1e9 / (double)total_ns
+                << " regions/s\n";
+      std::cout << "  stage   regions  avg_work_us   avg_gc_us    gc%\n";
+      for (size_t k = 0; k <= p.o.stages; k++)
+      {
+        StageStats& st = p.stats[k];
+        size_t n = st.regions;
+        double work = n == 0 ? 0 : (double)st.work_ns / (double)n / 1000;
+        double gc = n == 0 ? 0 : (double)st.gc_ns / (double)n / 1000;
+        if (k == p.o.stages)
+          std::cout << "   sink";
+        else
+          std::cout << std::setw(7) << k;
+        std::cout << std::setw(10) << n << std::setprecision(2)
+                  << std::setw(13) << work << std::setw(12) << gc
+                  << std::setprecision(1) << std::setw(7)
+                  << (work == 0 ? 0.0 : 100 * gc / work) << "\n";
+      }
+      std::cout << std::defaultfloat;
+    }
+  }
+
+  /// Hand region `i` to `stage`, or to the sink after the last stage.
+  template<RegionType rt>
+  void send(
+    std::shared_ptr<Pipeline<rt>> p, size_t stage, size_t i, Node* root)
+  {
+    if (stage == p->o.stages)
+    {
+      when(p->sink) << [p, root](auto s) { receive(*p, *s, root); };
+      return;
+    }
+
+    auto& cown = p->stages[stage][i % p->o.width];
+    when(cown) << [p, stage, i, root](auto) {
+      StageStats& stats = p->stats[stage];
+      auto start = Clock::now();
+      Node* r = root;
+      if (stage == 0)
+        r = build(*p, i);
+      else
+        churn(*p, stats, r);
+      stats.work_ns += ns_since(start);
+      stats.regions++;
+      send(p, stage + 1, i, r);
+    };
+  }
+
+  template<RegionType rt>
+  void run_test(const Options& o)
+  {
+    if (o.stages == 0 || o.width == 0 || o.regions == 0)
+      return;
+
+    if (
+      (o.sink == SinkMode::Merge && rt != RegionType::Trace &&
+       rt != RegionType::Arena) ||
+      (o.sink == SinkMode::Freeze && rt != RegionType::Trace))
+      std::cout << "The sink cannot merge or freeze this region type, so it "
+                   "releases each region instead.\n";
+
+    auto p = std::make_shared<Pipeline<rt>>(o);
+    for (size_t i = 0; i < o.regions; i++)
+      send(p, 0, i, nullptr);
+  }
+} // namespace pipeline
@@ -2,6 +2,7 @@
 // SPDX-License-Identifier: MIT
 
 #include "pointer_churn.h"
+#include "pointer_churn_baseline.h"
 
 #include <debug/harness.h>
 #include <test/opt.h>
@@ -11,13 +12,13 @@
 BENCHMARK_WINDOWS_CALLBACK_BRIDGE()
 
 MAKE_REGION_WRAPPER(test, pointer_churn::run_test);
+MAKE_BASELINE_WRAPPER(baseline, pointer_churn::run_baseline);
 
 extern "C" BENCHMARK_EXPORT int run_benchmark(int argc, char** argv)
 {
   opt::Opt opt(argc, argv);
 
   enable_benchmark_logging(opt);
-  RegionType rt = parse_region_type(opt);
 
   // Parse command-line arguments
   // Fixed seed in test for reproducibility
@@ -25,6 +26,17 @@ extern "C" BENCHMARK_EXPORT int run_benchmark(int argc, char** argv)
   size_t num_nodes = opt.is<size_t>("-n", 12);
   size_t num_mutations = opt.is<size_t>("-m", 1000);
 
+  Baseline b = parse_baseline(opt);
+  if (b != Baseline::None)
+  {
+    DISPATCH_BASELINE(b, baseline, num_nodes, num_mutations, seed);
+    return 0;
+  }
+
+  RegionType rt = parse_region_type(opt);
+  // Every edge is stored through verona::cpp::store().
+  parse_gc_options(opt, true);
+
   DISPATCH_REGION(rt, test, num_nodes, num_mutations, seed);
 
   return 0;
@@ -3,6 +3,7 @@
 
 #pragma once
 
+#include <cstddef>
 #include <debug/harness.h>
 #include <iostream>
 #include <random>
@@ -26,6 +27,9 @@ namespace pointer_churn
    * supports this) at certain intervals or immediately (depending on GC type).
    *
    *
+   * Edges are updated through verona::cpp::store, so the trace region can
+   * also be run with --incremental-mark or --concurrent-mark.
+   *
    * The graph can prematurely collapse to just the root before being able to
    * mutate the given number of times, at which point we close and release the
    * region and repeat the process with a new region until we have mutated the
@@ -38,6 +42,13 @@ namespace pointer_churn
     GraphNode* edges[MAX_OUT_EDGES] = {nullptr};
     size_t id;
 
+    // The edges are the only references, so collectors visit them through
+    // the pointer map instead of calling trace and relocate.
+    static constexpr uint64_t pointer_fields()
+    {
+      return field_map(offsetof(GraphNode, edges), MAX_OUT_EDGES);
+    }
+
     void trace(ObjectStack& st) const
     {
       for (size_t i = 0; i < MAX_OUT_EDGES; i++)
@@ -110,6 +121,10 @@ namespace pointer_churn
       gc_name = "Rc";
     else if constexpr (RT == RegionType::SemiSpace)
       gc_name = "SemiSpace";
+    else if constexpr (RT == RegionType::Generational)
+      gc_name = "Generational";
+    else if constexpr (RT == RegionType::Compact)
+      gc_name = "Compact";
 
     std::cout << "\n" << std::string(60, '=') << "\n";
     std::cout << "  POINTER CHURN | GC: " << gc_name << "\n";
@@ -137,9 +152,11 @@ namespace pointer_churn
       {
         UsingRegion ur(root);
 
-        // For SemiSpace, pre-reserve capacity so that allocating the initial
-        // chain does not trigger a grow (which would invalidate pointers).
-        if constexpr (RT == RegionType::SemiSpace)
+        // For SemiSpace and Compact, pre-reserve capacity so that allocating
+        // the initial chain does not trigger a collection (which would
+        // invalidate pointers).
+        if constexpr (
+          RT == RegionType::SemiSpace || RT == RegionType::Compact)
         {
           region_ensure_available(
             (NUM_NODES - 1) * vsizeof<GraphNode>);
@@ -157,7 +174,7 @@ namespace pointer_churn
           prevNode = node;
         }
         // Sanity check that all nodes are allocated
-        check(debug_size() == NUM_NODES);
+        check(region_stats().objects == NUM_NODES);
 
         // Random distribution for selecting an edge index to mutate
         std::uniform_int_distribution<size_t> rndOutEdgeInd(
@@ -195,7 +212,7 @@ namespace pointer_churn
 
           if (rng() % 2 == 0) // Add/update edge
           {
-            edgeSrcNode->edges[edgeIdx] = newEdgeDstNode;
+            verona::cpp::store(edgeSrcNode->edges[edgeIdx], newEdgeDstNode);
             if constexpr (RT == RegionType::Rc) // Ref count adjustment for RC
             {
               incref(newEdgeDstNode);
@@ -216,7 +233,8 @@ namespace pointer_churn
             {
               // Save ID before decref (which may deallocate the node)
               size_t oldId = oldEdgeDstNode->id;
-              edgeSrcNode->edges[edgeIdx] = nullptr;
+              verona::cpp::store(
+                edgeSrcNode->edges[edgeIdx], (GraphNode*)nullptr);
               if constexpr (RT == RegionType::Rc)
               {
                 decref(oldEdgeDstNode); // Ref count adjustment for RC
@@ -228,10 +246,11 @@ namespace pointer_churn
           {
             if constexpr (RT != RegionType::Arena)
             {
-              region_collect(); // Collect garbage for non-arena regions
-              // SemiSpace GC copies objects to a new space, invalidating
-              // all local interior pointers apart from root which is pinned.
-              if constexpr (RT == RegionType::SemiSpace)
+              region_maybe_collect(); // Collect garbage for non-arena regions
+              // SemiSpace and Compact GC move objects, invalidating all
+              // local interior pointers apart from root which is pinned.
+              if constexpr (
+                RT == RegionType::SemiSpace || RT == RegionType::Compact)
               {
                 check(root == get_root());
               }
@@ -246,7 +265,8 @@ namespace pointer_churn
         if constexpr (RT != RegionType::Arena)
         {
           region_collect();
-          if constexpr (RT == RegionType::SemiSpace)
+          if constexpr (
+            RT == RegionType::SemiSpace || RT == RegionType::Compact)
           {
             check(root == get_root());
           }
@@ -0,0 +1,165 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include "../benchmarker/benchmark_baseline.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <debug/harness.h>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace pointer_churn
+{
+  /**
+   * Pointer churn without a region (see Baseline). The graph is mutated as
+   * in run_test(), and where the region version asks for a collection:
+   *
+   *  - New deletes every node that the reachable set the workload already
+   *    computes leaves out, which is what a program managing the graph by
+   *    hand would have to do.
+   *  - Shared frees nodes as their last edge goes, but not cycles, which
+   *    are only freed when the graph is dropped and every edge is cleared.
+   *  - Monotonic frees nothing until the graph is dropped.
+   **/
+  template<Baseline B>
+  struct NativeGraphNode : public BaselineObject<B, NativeGraphNode<B>>
+  {
+    using Ptr = typename BaselineHeap<B>::template Ptr<NativeGraphNode>;
+
+    Ptr edges[MAX_OUT_EDGES] = {};
+    size_t id = 0;
+  };
+
+  template<typename N>
+  void find_reachable_native(N* node, std::vector<N*>& reachable)
+  {
+    if (node == nullptr)
+      return;
+
+    if (std::find(reachable.begin(), reachable.end(), node) != reachable.end())
+      return;
+
+    reachable.push_back(node);
+    for (size_t i = 0; i < MAX_OUT_EDGES; i++)
+      find_reachable_native(raw_ptr(node->edges[i]), reachable);
+  }
+
+  template<Baseline B>
+  void
+  run_baseline(size_t num_nodes, size_t num_mutations, size_t inputSeed)
+  {
+    using Node = NativeGraphNode<B>;
+    using Ptr = typename Node::Ptr;
+
+    std::cout << "\n" << std::string(60, '=') << "\n";
+    std::cout << "  POINTER CHURN | Baseline: " << baseline_name(B) << "\n";
+    std::cout << std::string(60, '=') << "\n";
+
+    const size_t NUM_NODES = num_nodes;
+    size_t NUM_MUTATIONS_REM = num_mutations;
+    const size_t GC_INTERVAL = num_mutations / 100;
+
+    // Apart from the seeds of the region types.
+    const size_t seed = inputSeed + (10 + static_cast<size_t>(B)) * 10000;
+    std::mt19937 rng(seed);
+
+    while (NUM_MUTATIONS_REM > 0)
+    {
+      BaselineHeap<B> heap;
+
+      // Every node made for this graph, to find the dead ones (New) or
+      // break the cycles (Shared).
+      std::vector<Node*> all;
+      std::vector<std::weak_ptr<Node>> all_shared;
+      auto make_node = [&](size_t id) {
+        Ptr n = heap.template make<Node>();
+        n->id = id;
+        if constexpr (B == Baseline::Shared)
+          all_shared.push_back(n);
+        else if constexpr (BaselineHeap<B>::frees_each)
+          all.push_back(raw_ptr(n));
+        return n;
+      };
+
+      Ptr root = make_node(0);
+      Node* prev = raw_ptr(root);
+      for (size_t i = 0; i < NUM_NODES - 1; i++)
+      {
+        prev->edges[0] = make_node(i + 1);
+        prev = raw_ptr(prev->edges[0]);
+      }
+
+      std::vector<Node*> reachable;
+      while (NUM_MUTATIONS_REM > 0)
+      {
+        reachable.clear();
+        find_reachable_native(raw_ptr(root), reachable);
+        if (reachable.size() == 1)
+          break;
+
+        std::uniform_int_distribution<size_t> rndSrcNodeInd(
+          0, reachable.size() - 1);
+        // As in run_test(), the root is never the destination of an edge.
+        std::uniform_int_distribution<size_t> rndDstNodeInd(
+          1, reachable.size() - 1);
+        std::uniform_int_distribution<size_t> rndOutEdgeInd(
+          0, MAX_OUT_EDGES - 1);
+        Node* src = reachable[rndSrcNodeInd(rng)];
+        Node* dst = reachable[rndDstNodeInd(rng)];
+        size_t edgeIdx = rndOutEdgeInd(rng);
+
+        if (rng() % 2 == 0) // Add/update edge
+        {
+          src->edges[edgeIdx] = heap.ptr_to(dst);
+        }
+        else // Remove edge
+        {
+          src->edges[edgeIdx] = nullptr;
+        }
+
+        if ((GC_INTERVAL != 0) && (NUM_MUTATIONS_REM % GC_INTERVAL == 0))
+        {
+          reachable.clear();
+          find_reachable_native(raw_ptr(root), reachable);
+          if constexpr (BaselineHeap<B>::frees_each)
+          {
+            auto dead = std::partition(all.begin(), all.end(), [&](Node* n) {
+              return std::find(reachable.begin(), reachable.end(), n) !=
+                reachable.end();
+            });
+            for (auto it = dead; it != all.end(); ++it)
+              heap.dispose(*it);
+            all.erase(dead, all.end());
+          }
+        }
+
+        NUM_MUTATIONS_REM--;
+      }
+
+      // Drop the graph.
+      if constexpr (B == Baseline::Shared)
+      {
+        for (auto& w : all_shared)
+        {
+          if (auto n = w.lock())
+          {
+            for (auto& e : n->edges)
+              e = nullptr;
+          }
+        }
+      }
+      else if constexpr (BaselineHeap<B>::frees_each)
+      {
+        for (auto* n : all)
+          heap.dispose(n);
+      }
+      root = nullptr;
+    }
+  }
+}
@@ -19,6 +19,7 @@ extern "C" BENCHMARK_EXPORT int run_benchmark(int argc, char** argv)
 
   enable_benchmark_logging(opt);
   RegionType rt = parse_region_type(opt);
+  parse_gc_options(opt);
 
   // Parse command-line arguments
   // Fixed seed in test for reproducibility
@@ -40,6 +40,13 @@ namespace pointer_churn_with_concurrency
     GraphNode* edges[MAX_OUT_EDGES] = {nullptr};
     size_t id;
 
+    // The edges are the only references, so collectors visit them through
+    // the pointer map instead of calling trace and relocate.
+    static constexpr uint64_t pointer_fields()
+    {
+      return field_map(offsetof(GraphNode, edges), MAX_OUT_EDGES);
+    }
+
     void trace(ObjectStack& st) const
     {
       for (auto edge : edges)
@@ -130,9 +137,11 @@ namespace pointer_churn_with_concurrency
     {
       UsingRegion ur(root);
 
-      // For SemiSpace, pre-reserve capacity so that allocating the initial
-      // chain does not trigger a grow (which would invalidate pointers).
-      if constexpr (RT == RegionType::SemiSpace)
+      // For SemiSpace and Compact, pre-reserve capacity so that allocating
+      // the initial chain does not trigger a collection (which would
+      // invalidate pointers).
+      if constexpr (
+        RT == RegionType::SemiSpace || RT == RegionType::Compact)
       {
         region_ensure_available((num_nodes - 1) * vsizeof<GraphNode>);
       }
@@ -253,6 +262,10 @@ namespace pointer_churn_with_concurrency
       gc_name = "Rc";
     else if constexpr (RT == RegionType::SemiSpace)
       gc_name = "SemiSpace";
+    else if constexpr (RT == RegionType::Generational)
+      gc_name = "Generational";
+    else if constexpr (RT == RegionType::Compact)
+      gc_name = "Compact";
 
     std::cout << "\n" << std::string(60, '=') << "\n";
     std::cout << "  POINTER CHURN WITH CONCURRENCY | GC: " << gc_name << "\n";
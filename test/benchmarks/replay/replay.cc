@@ -0,0 +1,41 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#include "replay.h"
+
+#include "../../../src/benchmarker/export_macro.h"
+#include "../benchmarker/benchmark_main_helper.h"
+
+#include <cstring>
+#include <debug/harness.h>
+#include <test/opt.h>
+
+BENCHMARK_WINDOWS_CALLBACK_BRIDGE()
+
+MAKE_REGION_WRAPPER(test, replay::run_test);
+
+extern "C" BENCHMARK_EXPORT int run_benchmark(int argc, char** argv)
+{
+  opt::Opt opt(argc, argv);
+
+  enable_benchmark_logging(opt);
+  RegionType rt = parse_region_type(opt);
+  parse_gc_options(opt);
+
+  std::string path;
+  for (int i = 1; i + 1 < argc; i++)
+  {
+    if (std::strcmp(argv[i], "--trace-file") == 0)
+      path = argv[i + 1];
+  }
+  if (path.empty())
+  {
+    std::cout << "Usage: replay --trace-file <file> [--<region type>]\n";
+    return 1;
+  }
+
+  DISPATCH_REGION(rt, test, path);
+
+  return 0;
+}
+
+RUN_BENCHMARK_MAIN()
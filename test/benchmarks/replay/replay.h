@@ -0,0 +1,489 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <debug/harness.h>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include <verona.h>
+
+/**
+ * Replays a trace recorded with `benchmarker --record-trace` (see
+ * AllocTrace) against any region type, so that collectors can be compared
+ * on exactly the same sequence of operations.
+ *
+ * Every object of the trace is replayed as an object of the recorded size
+ * whose words are all references, written as the trace writes them. The
+ * writes the recorder recovered before a collection are replayed just
+ * before it, and so are the allocations since the region's last
+ * collection, after reserving room for all of them in regions that would
+ * otherwise collect to grow. So every collection sees the same live graph
+ * as the recorded one. In rc regions each new object keeps the reference
+ * it was created with until then, and writes incref and decref. Regions
+ * that cannot merge release the region that would have been merged into
+ * them, and writes to its objects are dropped; regions that cannot freeze
+ * are released instead, and frozen regions are released straight away.
+ *
+ * Collectors that move objects keep replaying through the references
+ * written so far: after each collection that may have moved objects, the
+ * replay finds every object's new address by following them from the
+ * entry point, which is pinned.
+ **/
+namespace replay
+{
+  using verona::rt::AllocTrace;
+  using Op = AllocTrace::Op;
+
+  /**
+   * The trace at `path`, read once per process so that repeated runs do
+   * not measure reading it. Empty if it cannot be read or is not a trace.
+   */
+  inline const std::vector<uint8_t>& load(const std::string& path)
+  {
+    static std::map<std::string, std::vector<uint8_t>> traces;
+    auto it = traces.find(path);
+    if (it != traces.end())
+      return it->second;
+
+    std::vector<uint8_t>& data = traces[path];
+    std::ifstream file(path, std::ios::binary);
+    data.assign(
+      std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    if (
+      data.size() < sizeof(AllocTrace::MAGIC) ||
+      std::memcmp(data.data(), AllocTrace::MAGIC, sizeof(AllocTrace::MAGIC)) !=
+        0)
+      data.clear();
+    return data;
+  }
+
+  /// Number of reference words in the replayed object `o`.
+  inline size_t words(const Object* o)
+  {
+    return (o->get_descriptor()->size - sizeof(Object::Header)) /
+      sizeof(Object*);
+  }
+
+  inline void trace_words(const Object* o, ObjectStack& st)
+  {
+    auto fields = (Object* const*)o;
+    for (size_t w = 0; w < words(o); w++)
+    {
+      if (fields[w] != nullptr)
+        st.push(fields[w]);
+    }
+  }
+
+  inline void relocate_words(Object* o, Object* (*fwd)(Object*))
+  {
+    auto fields = (Object**)o;
+    for (size_t w = 0; w < words(o); w++)
+    {
+      if (fields[w] != nullptr)
+        fields[w] = fwd(fields[w]);
+    }
+  }
+
+  /// The descriptor of replayed objects of `size` bytes.
+  inline const Descriptor* descriptor(size_t size)
+  {
+    static std::map<size_t, std::unique_ptr<Descriptor>> descriptors;
+    auto& d = descriptors[size];
+    if (d == nullptr)
+      d.reset(new Descriptor{
+        size, trace_words, nullptr, nullptr, nullptr, relocate_words, 0});
+    return d.get();
+  }
+
+  template<RegionType rt>
+  class Replayer
+  {
+    static constexpr bool moves = rt == RegionType::SemiSpace ||
+      rt == RegionType::Generational || rt == RegionType::Compact;
+    static constexpr bool can_merge =
+      rt == RegionType::Trace || rt == RegionType::Arena;
+
+    struct Region
+    {
+      Object* root;
+      /// Objects not yet allocated, with their sizes.
+      std::vector<std::pair<uint64_t, size_t>> pending;
+      /// Objects whose creation reference has not been dropped, in rc.
+      std::vector<uint64_t> fresh;
+      /// Every object of the region that may still be live.
+      std::vector<uint64_t> members;
+    };
+
+    const std::vector<uint8_t>& data;
+    size_t pos = sizeof(AllocTrace::MAGIC);
+
+    /// Each object by id, or nullptr if it is gone.
+    std::vector<Object*> objects{nullptr};
+    std::vector<uint64_t> region_of{0};
+    /// The references of each object by word offset, where objects move.
+    std::vector<std::vector<std::pair<uint32_t, uint64_t>>> refs{{}};
+    std::map<uint64_t, Region> regions;
+    /// The entry point of the open region, or nullptr.
+    Object* open = nullptr;
+
+    /// Marks of the last relink(), by id.
+    std::vector<uint64_t> marks{0};
+    uint64_t epoch = 0;
+
+    size_t allocs = 0;
+    size_t writes = 0;
+    size_t collections = 0;
+    size_t merges_released = 0;
+
+    uint64_t next()
+    {
+      uint64_t v = 0;
+      if (!AllocTrace::get_varint(data.data(), data.size(), pos, v))
+      {
+        std::cout << "Truncated trace\n";
+        abort();
+      }
+      return v;
+    }
+
+    uint64_t add(Object* o, uint64_t region)
+    {
+      objects.push_back(o);
+      region_of.push_back(region);
+      marks.push_back(0);
+      if constexpr (moves)
+        refs.emplace_back();
+      return objects.size() - 1;
+    }
+
+    Object* init(Object* o)
+    {
+      std::memset((void*)o, 0, words(o) * sizeof(Object*));
+      return o;
+    }
+
+    void close()
+    {
+      if (open != nullptr)
+        close_region(CloseGC::Skip);
+      open = nullptr;
+    }
+
+    void use(Region& r)
+    {
+      if (open == r.root)
+        return;
+      close();
+      open_region(r.root);
+      open = r.root;
+    }
+
+    /**
+     * Find every object of `r` where it is now, by following the references
+     * from the entry point, and forget those that cannot be reached.
+     */
+    void relink(uint64_t id, Region& r)
+    {
+      epoch++;
+      marks[id] = epoch;
+      std::vector<uint64_t> work{id};
+      std::vector<uint64_t> live;
+      while (!work.empty())
+      {
+        uint64_t o = work.back();
+        work.pop_back();
+        live.push_back(o);
+        auto fields = (Object**)objects[o];
+        for (auto [w, c] : refs[o])
+        {
+          objects[c] = fields[w];
+          if (marks[c] != epoch)
+          {
+            marks[c] = epoch;
+            work.push_back(c);
+          }
+        }
+      }
+
+      for (uint64_t o : r.members)
+      {
+        if (marks[o] != epoch)
+          objects[o] = nullptr;
+      }
+      r.members = std::move(live);
+    }
+
+    /// Allocate the objects of `r` that are still pending.
+    void materialise(uint64_t id, Region& r)
+    {
+      if (r.pending.empty())
+        return;
+
+      use(r);
+      if constexpr (rt == RegionType::SemiSpace || rt == RegionType::Compact)
+      {
+        size_t bytes = 0;
+        for (auto& p : r.pending)
+          bytes += p.second;
+        size_t before = rt == RegionType::SemiSpace ?
+          debug_semispace_size() :
+          debug_compact_space_size();
+        region_ensure_available(bytes);
+        size_t after = rt == RegionType::SemiSpace ?
+          debug_semispace_size() :
+          debug_compact_space_size();
+        if (before != after)
+          relink(id, r);
+      }
+
+      for (auto& [o, size] : r.pending)
+      {
+        objects[o] = init(create_object(descriptor(size)));
+        r.members.push_back(o);
+        if constexpr (rt == RegionType::Rc)
+          r.fresh.push_back(o);
+      }
+      allocs += r.pending.size();
+      r.pending.clear();
+    }
+
+    /// Drop the creation references of the new objects of `r`, in rc.
+    void settle(Region& r)
+    {
+      if constexpr (rt == RegionType::Rc)
+      {
+        use(r);
+        for (uint64_t o : r.fresh)
+          decref(objects[o]);
+        r.fresh.clear();
+      }
+    }
+
+    /// The region `id`, or nullptr if it is gone.
+    Region* find(uint64_t id)
+    {
+      auto it = regions.find(id);
+      return it == regions.end() ? nullptr : &it->second;
+    }
+
+    void forget(uint64_t id)
+    {
+      for (uint64_t o : regions[id].members)
+        objects[o] = nullptr;
+      regions.erase(id);
+    }
+
+    void write(uint64_t src, uint64_t offset, uint64_t dst)
+    {
+      Region* r = find(region_of[src]);
+      if (r == nullptr)
+        return;
+      materialise(region_of[src], *r);
+      if (objects[src] == nullptr)
+        return;
+
+      use(*r);
+      Object* value = dst == 0 ? nullptr : objects[dst];
+      Object*& field = ((Object**)objects[src])[offset];
+      Object* old = field;
+      if constexpr (rt == RegionType::Rc)
+      {
+        if (value != nullptr)
+          incref(value);
+      }
+      store(field, value);
+      if constexpr (rt == RegionType::Rc)
+      {
+        if (old != nullptr)
+          decref(old);
+      }
+
+      if constexpr (moves)
+      {
+        auto& fields = refs[src];
+        auto f = std::find_if(fields.begin(), fields.end(), [&](auto& e) {
+          return e.first == offset;
+        });
+        if (f != fields.end())
+          fields.erase(f);
+        if (value != nullptr)
+          fields.emplace_back((uint32_t)offset, dst);
+      }
+      writes++;
+    }
+
+    void release(uint64_t id)
+    {
+      Region* r = find(id);
+      if (r == nullptr)
+        return;
+      materialise(id, *r);
+      close();
+      region_release(r->root);
+      forget(id);
+    }
+
+  public:
+    Replayer(const std::vector<uint8_t>& data) : data(data) {}
+
+    void run()
+    {
+      bool end = false;
+      while (!end && pos < data.size())
+      {
+        switch ((Op)data[pos++])
+        {
+          case Op::Region:
+          {
+            auto type = (RegionType)next();
+            size_t size = next();
+            (void)type;
+            Object* root = create_fresh_region(rt, descriptor(size));
+            init(root);
+            uint64_t id = add(root, 0);
+            region_of[id] = id;
+            regions[id] = {root, {}, {}, {id}};
+            break;
+          }
+
+          case Op::Alloc:
+          {
+            uint64_t region = next();
+            size_t size = next();
+            uint64_t id = add(nullptr, region);
+            auto it = regions.find(region);
+            if (it != regions.end())
+              it->second.pending.emplace_back(id, size);
+            break;
+          }
+
+          case Op::Write:
+          {
+            uint64_t src = next();
+            uint64_t offset = next();
+            uint64_t dst = next();
+            write(src, offset, dst);
+            break;
+          }
+
+          case Op::Collect:
+          {
+            uint64_t id = next();
+            Region* r = find(id);
+            if (r == nullptr)
+              break;
+            materialise(id, *r);
+            settle(*r);
+            use(*r);
+            region_collect();
+            if constexpr (moves)
+              relink(id, *r);
+            collections++;
+            break;
+          }
+
+          case Op::Release:
+            release(next());
+            break;
+
+          case Op::Merge:
+          {
+            uint64_t into = next();
+            uint64_t from = next();
+            Region* r = find(into);
+            Region* m = find(from);
+            if (r == nullptr || m == nullptr)
+              break;
+            if constexpr (can_merge)
+            {
+              materialise(from, *m);
+              materialise(into, *r);
+              use(*r);
+              merge(m->root);
+              for (uint64_t o : m->members)
+                region_of[o] = into;
+              r->members.insert(
+                r->members.end(), m->members.begin(), m->members.end());
+              regions.erase(from);
+            }
+            else
+            {
+              release(from);
+              merges_released++;
+            }
+            break;
+          }
+
+          case Op::Freeze:
+          {
+            uint64_t id = next();
+            Region* r = find(id);
+            if (r == nullptr)
+              break;
+            materialise(id, *r);
+            settle(*r);
+            close();
+            if constexpr (rt == RegionType::Trace)
+            {
+              freeze(r->root);
+              Immutable::release(r->root);
+              forget(id);
+            }
+            else
+            {
+              release(id);
+            }
+            break;
+          }
+
+          case Op::End:
+            end = true;
+            break;
+
+          default:
+            std::cout << "Unknown operation in trace\n";
+            abort();
+        }
+      }
+
+      close();
+      while (!regions.empty())
+        release(regions.begin()->first);
+    }
+
+    void report() const
+    {
+      std::cout << "Replayed " << objects.size() - 1 << " objects, " << allocs
+                << " allocated, " << writes << " writes, " << collections
+                << " collections\n";
+      if (merges_released != 0)
+        std::cout << merges_released
+                  << " merged regions were released, as this region type "
+                     "cannot merge\n";
+    }
+  };
+
+  template<RegionType rt>
+  void run_test(const std::string& path)
+  {
+    const std::vector<uint8_t>& data = load(path);
+    if (data.empty())
+    {
+      std::cout << "No trace to replay at " << path << "\n";
+      return;
+    }
+
+    Replayer<rt> replayer(data);
+    replayer.run();
+    replayer.report();
+  }
+} // namespace replay
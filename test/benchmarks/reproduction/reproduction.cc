@@ -1,6 +1,7 @@
 // Copyright Microsoft and Project Verona Contributors.
 // SPDX-License-Identifier: MIT
 #include "reproduction.h"
+#include "reproduction_baseline.h"
 
 #include <debug/harness.h>
 #include <test/opt.h>
@@ -12,19 +13,29 @@
 BENCHMARK_WINDOWS_CALLBACK_BRIDGE()
 
 MAKE_REGION_WRAPPER(test, reproduction::run_test);
+MAKE_BASELINE_WRAPPER(baseline, reproduction::run_baseline);
 
 extern "C" BENCHMARK_EXPORT int run_benchmark(int argc, char** argv)
 {
   opt::Opt opt(argc, argv);
 
   enable_benchmark_logging(opt);
-  RegionType rt = parse_region_type(opt);
 
   size_t seed = opt.is<size_t>("--seed", 42);
   int generations = opt.is<int>("--generations", 101);
   int killPercent = opt.is<int>("--kill-percent", 50);
   int popSize     = opt.is<int>("--pop-size", 100);
 
+  Baseline b = parse_baseline(opt);
+  if (b != Baseline::None)
+  {
+    DISPATCH_BASELINE(b, baseline, generations, killPercent, popSize, seed);
+    return 0;
+  }
+
+  RegionType rt = parse_region_type(opt);
+  parse_gc_options(opt);
+
   DISPATCH_REGION(rt, test, generations, killPercent, popSize, seed);
   return 0;
 }
@@ -265,7 +265,7 @@ namespace reproduction
           }
         }
 
-        region_collect();
+        region_maybe_collect();
 
         // if (g % 10 == 0 || g == generations - 1)
         // {
@@ -276,7 +276,7 @@ namespace reproduction
 
         Logging::cout() << "Gen " << g
                   << " kills=" << kills
-                  << " size=" << debug_size()
+                  << " size=" << region_stats().objects
                   << "\n";
 
         // ---- Reproduction phase ----
@@ -295,7 +295,7 @@ namespace reproduction
         }
 
         Logging::cout() << "After reproduction size="
-                  << debug_size() << "\n";
+                  << region_stats().objects << "\n";
       }
     }
 
@@ -0,0 +1,199 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * The reproduction workload without a region (see Baseline). The New
+ * baseline deletes each organism, with its tree, as it is unlinked from the
+ * ring. Shared frees it as the last pointer to it goes, and breaks the ring
+ * one organism at a time at the end, so that dropping a long ring does not
+ * recurse once per organism.
+ **/
+
+#pragma once
+
+#include "../benchmarker/benchmark_baseline.h"
+
+#include <debug/harness.h>
+#include <iostream>
+#include <random>
+#include <utility>
+#include <vector>
+
+namespace reproduction
+{
+  template<Baseline B>
+  struct NativeNode
+  {
+    using Ptr = typename BaselineHeap<B>::template Ptr<NativeNode>;
+
+    std::vector<Ptr> to;
+  };
+
+  template<Baseline B>
+  struct NativeOrganism
+  {
+    using Ptr = typename BaselineHeap<B>::template Ptr<NativeOrganism>;
+
+    int id;
+    typename NativeNode<B>::Ptr root = nullptr;
+    Ptr next = nullptr;
+
+    NativeOrganism(int id_) : id(id_) {}
+  };
+
+  template<Baseline B>
+  typename NativeNode<B>::Ptr
+  make_tree_native(BaselineHeap<B>& heap, int depth)
+  {
+    auto n = heap.template make<NativeNode<B>>();
+    for (int i = 0; i < depth; i++)
+      n->to.push_back(make_tree_native(heap, depth - 1));
+    return n;
+  }
+
+  /// As the copy constructor of Node, a deep copy of `other`.
+  template<Baseline B>
+  typename NativeNode<B>::Ptr
+  copy_tree_native(BaselineHeap<B>& heap, const NativeNode<B>* other)
+  {
+    auto n = heap.template make<NativeNode<B>>();
+    for (auto& c : other->to)
+      n->to.push_back(copy_tree_native(heap, raw_ptr(c)));
+    return n;
+  }
+
+  template<Baseline B>
+  void free_tree_native(BaselineHeap<B>& heap, typename NativeNode<B>::Ptr& n)
+  {
+    if constexpr (BaselineHeap<B>::frees_each)
+    {
+      for (auto& c : n->to)
+        free_tree_native(heap, c);
+    }
+    heap.dispose(n);
+  }
+
+  template<Baseline B>
+  void free_organism_native(
+    BaselineHeap<B>& heap, typename NativeOrganism<B>::Ptr& o)
+  {
+    if constexpr (BaselineHeap<B>::frees_each)
+    {
+      if (o->root != nullptr)
+        free_tree_native(heap, o->root);
+    }
+    heap.dispose(o);
+  }
+
+  template<Baseline B>
+  void
+  run_baseline(int generations, int killPercent, int popSize, size_t seed = 0)
+  {
+    using Organism = NativeOrganism<B>;
+    using Ptr = typename Organism::Ptr;
+
+    std::cout << "[reproduction] Using baseline: " << baseline_name(B)
+              << std::endl;
+
+    BaselineHeap<B> heap;
+    int counter = 0;
+    auto make_organism = [&]() {
+      Ptr o = heap.template make<Organism>(counter++);
+      o->root = make_tree_native(heap, 4);
+      return o;
+    };
+
+    // Build initial ring
+    Ptr root = heap.template make<Organism>(counter++);
+    root->next = make_organism();
+    Organism* first = raw_ptr(root->next);
+    Organism* tail = first;
+    for (int i = 0; i < popSize - 1; i++)
+    {
+      tail->next = make_organism();
+      tail = raw_ptr(tail->next);
+    }
+    tail->next = root->next;
+
+    if (seed == 0)
+      seed = std::random_device{}();
+    std::mt19937 gen{static_cast<std::mt19937::result_type>(seed)};
+    std::uniform_int_distribution<int> roulette(1, 100);
+    std::uniform_int_distribution<int> coin(0, 1);
+
+    for (int g = 0; g < generations; g++)
+    {
+      Organism* prev = raw_ptr(root->next);
+      Organism* cur = raw_ptr(prev->next);
+
+      int kills = 0;
+
+      // ---- Killing phase ----
+      for (int i = 0; i < popSize; i++)
+      {
+        if (roulette(gen) < killPercent && cur != prev)
+        {
+          // As unlink_after(), the first organism and the last two live.
+          Organism* victim = raw_ptr(prev->next);
+          if (victim->id != 1 && prev->next != victim->next)
+          {
+            Ptr dead = std::move(prev->next);
+            prev->next = std::move(dead->next);
+            free_organism_native(heap, dead);
+            kills++;
+          }
+          cur = raw_ptr(prev->next);
+        }
+        else
+        {
+          prev = cur;
+          cur = raw_ptr(cur->next);
+        }
+      }
+
+      Logging::cout() << "Gen " << g << " kills=" << kills << "\n";
+
+      // ---- Reproduction phase ----
+      int births = (killPercent * popSize) / 100;
+
+      Organism* p1 = raw_ptr(root->next);
+      Organism* p2 = raw_ptr(root->next);
+
+      for (int i = 0; i < births; i++)
+      {
+        p1 = raw_ptr(p1->next);
+        p2 = raw_ptr(raw_ptr(p2->next)->next);
+
+        Ptr child = heap.template make<Organism>(counter++);
+        child->root = heap.template make<NativeNode<B>>();
+        for (auto* parent : {p1, p2})
+        {
+          for (auto& n : parent->root->to)
+          {
+            if (coin(gen) == 0)
+              child->root->to.push_back(copy_tree_native(heap, raw_ptr(n)));
+          }
+        }
+        child->next = std::move(p2->next);
+        p2->next = std::move(child);
+      }
+    }
+
+    // Break the ring, then drop it one organism at a time.
+    Organism* last = first;
+    while (raw_ptr(last->next) != first)
+      last = raw_ptr(last->next);
+    last->next = nullptr;
+
+    Ptr o = std::move(root->next);
+    root->next = nullptr;
+    while (o != nullptr)
+    {
+      Ptr next = std::move(o->next);
+      o->next = nullptr;
+      free_organism_native(heap, o);
+      o = std::move(next);
+    }
+    free_organism_native(heap, root);
+  }
+} // namespace reproduction
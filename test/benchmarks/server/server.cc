@@ -0,0 +1,37 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#include "server.h"
+
+#include "../../../src/benchmarker/export_macro.h"
+#include "../benchmarker/benchmark_main_helper.h"
+
+#include <debug/harness.h>
+#include <test/opt.h>
+
+BENCHMARK_WINDOWS_CALLBACK_BRIDGE()
+
+MAKE_REGION_WRAPPER(test, server::run_test);
+
+extern "C" BENCHMARK_EXPORT int run_benchmark(int argc, char** argv)
+{
+  opt::Opt opt(argc, argv);
+
+  enable_benchmark_logging(opt);
+  RegionType rt = parse_region_type(opt);
+  parse_gc_options(opt);
+
+  server::Options o;
+  o.sessions = opt.is<size_t>("--sessions", 16);
+  o.requests = opt.is<size_t>("--requests", 10000);
+  o.rate = opt.is<size_t>("--rate", 20000);
+  o.objects = opt.is<size_t>("--objects", 32);
+  o.window = opt.is<size_t>("--window", 64);
+  o.collect_every = opt.is<size_t>("--collect-every", 4);
+  o.seed = opt.is<size_t>("--seed", 12345);
+
+  DISPATCH_REGION(rt, test, o);
+
+  return 0;
+}
+
+RUN_BENCHMARK_MAIN()
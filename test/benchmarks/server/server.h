@@ -0,0 +1,377 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "cpp/cown.h"
+#include "cpp/cown_array.h"
+#include "cpp/when.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <debug/harness.h>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <thread>
+#include <util/latency_histogram.h>
+#include <vector>
+#include <verona.h>
+
+using namespace verona::cpp;
+
+/**
+ * Requests arriving at a server at a fixed rate, answered by behaviours
+ * that allocate in regions, so that the time a collector takes shows up as
+ * response time rather than as GC time alone.
+ *
+ * An injector thread, registered as an external event source, sends
+ * `requests` requests at `rate` per second, each to a random one of
+ * `sessions` session cowns. A request allocates a chain of `objects`
+ * nodes in its session's region and stores it in a window of the last
+ * `window` chains, dropping the chain it replaces. Every `collect_every`
+ * requests of a session asks region_maybe_collect(), so the GC policy
+ * given to the benchmarker decides how often a session actually collects.
+ *
+ * A request's response time runs from when it was due to be sent, not from
+ * when it was sent: if the injector falls behind, the requests it sends
+ * late are charged for the wait, which corrects for coordinated omission.
+ * The benchmark also reports the time from the actual send, and the time
+ * the behaviour itself took, so the three can be compared. With systematic
+ * testing there are no external threads, so a chain of behaviours sends
+ * the requests instead.
+ **/
+namespace server
+{
+  using verona::rt::api::LatencyHistogram;
+
+  /// Largest window of chains a session keeps.
+  static constexpr size_t MAX_WINDOW = 1024;
+
+  struct Node : public V<Node>
+  {
+    Node* next = nullptr;
+    uint64_t payload[4] = {};
+
+    void trace(ObjectStack& st) const
+    {
+      if (next != nullptr)
+        st.push(next);
+    }
+
+    void relocate(Object* (*fwd)(Object*))
+    {
+      if (next != nullptr)
+        next = (Node*)fwd(next);
+    }
+  };
+
+  /// The entry point of a session's region.
+  struct Window : public V<Window>
+  {
+    Node* slots[MAX_WINDOW] = {};
+
+    void trace(ObjectStack& st) const
+    {
+      for (Node* n : slots)
+      {
+        if (n != nullptr)
+          st.push(n);
+      }
+    }
+
+    void relocate(Object* (*fwd)(Object*))
+    {
+      for (Node*& n : slots)
+      {
+        if (n != nullptr)
+          n = (Node*)fwd(n);
+      }
+    }
+  };
+
+  struct Options
+  {
+    size_t sessions;
+    size_t requests;
+    size_t rate;
+    size_t objects;
+    size_t window;
+    size_t collect_every;
+    uint64_t seed;
+  };
+
+  struct Session
+  {
+    Window* window = nullptr;
+    size_t requests = 0;
+    /// From when each request was due to be sent.
+    LatencyHistogram response;
+    /// From when each request was actually sent.
+    LatencyHistogram uncorrected;
+    /// From when each request started running.
+    LatencyHistogram service;
+    size_t collections = 0;
+    uint64_t gc_ns = 0;
+    uint64_t max_gc_ns = 0;
+
+    ~Session()
+    {
+      if (window != nullptr)
+        region_release(window);
+    }
+  };
+
+  using Clock = std::chrono::steady_clock;
+
+  inline uint64_t ns_since(Clock::time_point start)
+  {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+             Clock::now() - start)
+      .count();
+  }
+
+  inline const char* policy_name(GCPolicy::Kind kind)
+  {
+    switch (kind)
+    {
+      case GCPolicy::Kind::Always:
+        return "always";
+      case GCPolicy::Kind::HeapGrowth:
+        return "heap growth";
+      case GCPolicy::Kind::AllocationBudget:
+        return "allocation budget";
+      case GCPolicy::Kind::PauseTarget:
+        return "pause target";
+    }
+    return "unknown";
+  }
+
+  struct Server
+  {
+    Options o;
+    std::vector<cown_ptr<Session>> sessions;
+    std::atomic<size_t> completed{0};
+    /// The latest the injector sent a request after it was due.
+    std::atomic<uint64_t> max_send_lag_ns{0};
+    Clock::time_point start;
+    std::thread injector;
+    /// Set once `injector` has been assigned, so it can be joined.
+    std::atomic<bool> ready{false};
+
+    Server(const Options& o) : o(o)
+    {
+      for (size_t s = 0; s < o.sessions; s++)
+        sessions.push_back(make_cown<Session>());
+    }
+  };
+
+  inline void report(std::shared_ptr<Server> p)
+  {
+    cown_array<Session> all{p->sessions.data(), p->sessions.size()};
+    when(all) << [p](acquired_cown_span<Session> s) {
+      uint64_t total_ns = ns_since(p->start);
+      LatencyHistogram response;
+      LatencyHistogram uncorrected;
+      LatencyHistogram service;
+      size_t collections = 0;
+      uint64_t gc_ns = 0;
+      uint64_t max_gc_ns = 0;
+      for (size_t i = 0; i < s.length; i++)
+      {
+        Session& session = *s.array[i];
+        response.merge(session.response);
+        uncorrected.merge(session.uncorrected);
+        service.merge(session.service);
+        collections += session.collections;
+        gc_ns += session.gc_ns;
+        max_gc_ns = std::max(max_gc_ns, session.max_gc_ns);
+      }
+
+      std::cout << "Requests: " << p->o.requests << " at " << p->o.rate
+                << "/s to " << p->o.sessions << " sessions, GC policy "
+                << policy_name(GCPolicy::get_default().get_kind()) << "\n"
+                << "Achieved " << std::fixed << std::setprecision(0)
+                << (double)p->o.requests * 1e9 / (double)total_ns
+                << " requests/s, injector at most "
+                << p->max_send_lag_ns / 1000 << " us late\n"
+                << "Collections: " << collections << ", avg "
+                << (collections == 0 ? 0 : gc_ns / collections / 1000)
+                << " us, max " << max_gc_ns / 1000 << " us\n"
+                << std::defaultfloat;
+      std::cout << "  latency_us         p50       p90       p99     p99.9"
+                   "       max\n";
+      auto row = [](const char* name, const LatencyHistogram& h) {
+        std::cout << std::setw(12) << name << std::setw(10)
+                  << h.percentile(50) / 1000 << std::setw(10)
+                  << h.percentile(90) / 1000 << std::setw(10)
+                  << h.percentile(99) / 1000 << std::setw(10)
+                  << h.percentile(99.9) / 1000 << std::setw(10)
+                  << h.max() / 1000 << "\n";
+      };
+      row("response", response);
+      row("uncorrected", uncorrected);
+      row("service", service);
+    };
+  }
+
+  /// Make room for `n` nodes in regions that would otherwise move objects
+  /// to grow while they are being linked.
+  template<RegionType rt>
+  void reserve(size_t n)
+  {
+    if constexpr (rt == RegionType::SemiSpace || rt == RegionType::Compact)
+      region_ensure_available(n * vsizeof<Node>);
+  }
+
+  template<RegionType rt>
+  void handle(
+    std::shared_ptr<Server> p, Session& s, uint64_t due_ns, uint64_t sent_ns)
+  {
+    auto begin = Clock::now();
+    {
+      if (s.window == nullptr)
+        s.window = new (rt) Window;
+      UsingRegion rr(s.window);
+      reserve<rt>(p->o.objects);
+
+      Node* head = nullptr;
+      for (size_t i = 0; i < p->o.objects; i++)
+      {
+        auto* n = new Node;
+        n->payload[0] = i;
+        store(n->next, head);
+        head = n;
+      }
+
+      // The window holds the reference the chain was created with.
+      Node*& slot = s.window->slots[s.requests % p->o.window];
+      Node* old = slot;
+      store(slot, head);
+      if constexpr (rt == RegionType::Rc)
+      {
+        if (old != nullptr)
+          decref(old);
+      }
+      s.requests++;
+
+      if (p->o.collect_every != 0 && s.requests % p->o.collect_every == 0)
+      {
+        auto gc_start = Clock::now();
+        if (region_maybe_collect())
+        {
+          uint64_t ns = ns_since(gc_start);
+          s.collections++;
+          s.gc_ns += ns;
+          s.max_gc_ns = std::max(s.max_gc_ns, ns);
+        }
+      }
+    }
+
+    // Closing the region is part of the response, as it may collect.
+    uint64_t done_ns = ns_since(p->start);
+    s.response.record(done_ns - due_ns);
+    s.uncorrected.record(done_ns - sent_ns);
+    s.service.record(ns_since(begin));
+
+    if (p->completed.fetch_add(1) + 1 == p->o.requests)
+      report(p);
+  }
+
+  /// When request `i` is due, in nanoseconds from the start.
+  inline uint64_t due(const Server& p, size_t i)
+  {
+    return (uint64_t)i * 1000000000 / p.o.rate;
+  }
+
+  /// Send a request due at `due_ns` to a random session.
+  template<RegionType rt>
+  void send(std::shared_ptr<Server> p, std::mt19937_64& rng, uint64_t due_ns)
+  {
+    uint64_t sent_ns = ns_since(p->start);
+    uint64_t lag = sent_ns - std::min(sent_ns, due_ns);
+    uint64_t latest = p->max_send_lag_ns.load(std::memory_order_relaxed);
+    while (
+      lag > latest && !p->max_send_lag_ns.compare_exchange_weak(latest, lag))
+    {}
+
+    auto& session = p->sessions[rng() % p->sessions.size()];
+    when(session) << [p, due_ns, sent_ns](acquired_cown<Session> s) {
+      handle<rt>(p, *s, due_ns, sent_ns);
+    };
+  }
+
+#ifdef USE_SYSTEMATIC_TESTING
+  /// Send every request that is due, and at least one, from a behaviour,
+  /// then send the rest from another.
+  template<RegionType rt>
+  void pump(std::shared_ptr<Server> p, size_t next, uint64_t seed)
+  {
+    when() << [p, next, seed]() {
+      std::mt19937_64 rng(seed);
+      size_t i = next;
+      do
+      {
+        send<rt>(p, rng, due(*p, i));
+        i++;
+      } while (i < p->o.requests && due(*p, i) <= ns_since(p->start));
+      if (i < p->o.requests)
+        pump<rt>(p, i, rng());
+    };
+  }
+#else
+  /// The injector thread: send each request when it is due, then let the
+  /// runtime shut down.
+  template<RegionType rt>
+  void inject(std::shared_ptr<Server> p)
+  {
+    while (!p->ready.load(std::memory_order_acquire))
+      snmalloc::Aal::pause();
+
+    std::mt19937_64 rng(p->o.seed);
+    for (size_t i = 0; i < p->o.requests; i++)
+    {
+      uint64_t due_ns = due(*p, i);
+      for (uint64_t now = ns_since(p->start); now < due_ns;
+           now = ns_since(p->start))
+      {
+        // Sleep through most of the wait, and spin through the rest.
+        if (due_ns - now > 100000)
+          std::this_thread::sleep_for(
+            std::chrono::nanoseconds(due_ns - now - 100000));
+        else
+          snmalloc::Aal::pause();
+      }
+      send<rt>(p, rng, due_ns);
+    }
+
+    // The runtime must be told from one of its own threads.
+    when() << [p]() {
+      p->injector.join();
+      Scheduler::remove_external_event_source();
+    };
+  }
+#endif
+
+  template<RegionType rt>
+  void run_test(const Options& o)
+  {
+    if (o.sessions == 0 || o.requests == 0 || o.rate == 0)
+      return;
+
+    Options opts = o;
+    opts.window = std::clamp<size_t>(o.window, 1, MAX_WINDOW);
+    auto p = std::make_shared<Server>(opts);
+    p->start = Clock::now();
+#ifdef USE_SYSTEMATIC_TESTING
+    pump<rt>(p, 0, o.seed);
+#else
+    Scheduler::add_external_event_source();
+    p->injector = std::thread([p]() { inject<rt>(p); });
+    p->ready.store(true, std::memory_order_release);
+#endif
+  }
+} // namespace server
@@ -0,0 +1,46 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#include "size_mix.h"
+
+#include "../../../src/benchmarker/export_macro.h"
+#include "../benchmarker/benchmark_main_helper.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <debug/harness.h>
+#include <test/opt.h>
+
+BENCHMARK_WINDOWS_CALLBACK_BRIDGE()
+
+MAKE_REGION_WRAPPER(test, size_mix::run_test);
+
+extern "C" BENCHMARK_EXPORT int run_benchmark(int argc, char** argv)
+{
+  opt::Opt opt(argc, argv);
+
+  enable_benchmark_logging(opt);
+  RegionType rt = parse_region_type(opt);
+  parse_gc_options(opt);
+
+  size_mix::Options o;
+  o.bytes = opt.is<size_t>("--bytes", 64 * 1024 * 1024);
+  o.live_bytes = opt.is<size_t>("--live-bytes", 32 * 1024 * 1024);
+  o.collect_bytes = opt.is<size_t>("--collect-bytes", 16 * 1024 * 1024);
+  o.pointer_percent = opt.is<size_t>("--pointer-percent", 50);
+  o.mix_only = opt.has("--mix-only");
+  o.seed = opt.is<size_t>("--seed", 12345);
+
+  // The power law exponent is fractional, so it is read here.
+  o.alpha = 1.0;
+  for (int i = 1; i + 1 < argc; i++)
+  {
+    if (std::strcmp(argv[i], "--alpha") == 0)
+      o.alpha = std::strtod(argv[i + 1], nullptr);
+  }
+
+  DISPATCH_REGION(rt, test, o);
+
+  return 0;
+}
+
+RUN_BENCHMARK_MAIN()
@@ -0,0 +1,410 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <debug/harness.h>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+#include <verona.h>
+
+/**
+ * Allocation across the whole range of object sizes.
+ *
+ * Objects are allocated in size bands from 16 bytes to 4 MiB, each four
+ * times the one before, as either byte buffers with no pointers or arrays
+ * of pointers to byte buffers. Each goes into a pool of up to POOL_SLOTS
+ * objects, at a random slot, and random objects are dropped from the pool
+ * whenever it holds more than `live_bytes`, so lifetimes are random and
+ * the heap stays at about that size. The region is collected every
+ * `collect_bytes` of allocation.
+ *
+ * The benchmark runs one phase per band and kind, and then one that draws
+ * sizes from a power law, where a band four times larger is 4^alpha times
+ * less likely. Each phase reports its allocation throughput, the cost of
+ * collection per MiB allocated, and the memory the region uses over what
+ * is reachable at the end, which is its fragmentation. This exercises the
+ * large object spaces, the retirement of arena chunks, and snmalloc's
+ * large size classes, which the other benchmarks barely touch.
+ **/
+namespace size_mix
+{
+  static constexpr size_t BANDS = 10;
+  static constexpr size_t POOL_SLOTS = 4096;
+
+  static constexpr size_t band_size(size_t band)
+  {
+    return size_t{16} << (2 * band);
+  }
+
+  /// Bytes of an object of `size` bytes after its header, at least a word.
+  static constexpr size_t payload(size_t size)
+  {
+    return size > sizeof(Object::Header) + sizeof(void*) ?
+      size - sizeof(Object::Header) :
+      sizeof(void*);
+  }
+
+  template<size_t N>
+  struct Bytes : public V<Bytes<N>>
+  {
+    uint8_t data[payload(N)];
+  };
+
+  template<size_t N>
+  struct Refs : public V<Refs<N>>
+  {
+    Object* slot[payload(N) / sizeof(Object*)] = {};
+
+    void trace(ObjectStack& st) const
+    {
+      for (Object* o : slot)
+      {
+        if (o != nullptr)
+          st.push(o);
+      }
+    }
+
+    void relocate(Object* (*fwd)(Object*))
+    {
+      for (Object*& o : slot)
+      {
+        if (o != nullptr)
+          o = fwd(o);
+      }
+    }
+  };
+
+  /// The entry point of the region: the pool.
+  struct Pool : public V<Pool>
+  {
+    Object* slot[POOL_SLOTS] = {};
+
+    void trace(ObjectStack& st) const
+    {
+      for (Object* o : slot)
+      {
+        if (o != nullptr)
+          st.push(o);
+      }
+    }
+
+    void relocate(Object* (*fwd)(Object*))
+    {
+      for (Object*& o : slot)
+      {
+        if (o != nullptr)
+          o = fwd(o);
+      }
+    }
+  };
+
+  /// What the pool holds, kept outside the region so it never moves.
+  struct PoolState
+  {
+    std::vector<size_t> occupied;
+    std::vector<size_t> free;
+    /// Index of each slot in `occupied`, or SIZE_MAX if it is empty.
+    std::vector<size_t> position = std::vector<size_t>(POOL_SLOTS, SIZE_MAX);
+    std::vector<uint8_t> band = std::vector<uint8_t>(POOL_SLOTS, 0);
+    std::vector<bool> refs = std::vector<bool>(POOL_SLOTS, false);
+    size_t bytes = 0;
+
+    PoolState()
+    {
+      for (size_t s = POOL_SLOTS; s > 0; s--)
+        free.push_back(s - 1);
+    }
+  };
+
+  /// The pointer slots of an array of pointers of size `band_size(B)`.
+  template<size_t B>
+  std::pair<Object**, size_t> slots_of(Object* o)
+  {
+    auto* r = (Refs<band_size(B)>*)o;
+    return {r->slot, std::size(r->slot)};
+  }
+
+  template<size_t B>
+  Object* alloc_band(bool refs)
+  {
+    if (refs)
+      return new Refs<band_size(B)>;
+    return new Bytes<band_size(B)>;
+  }
+
+  struct Band
+  {
+    Object* (*alloc)(bool refs);
+    std::pair<Object**, size_t> (*slots)(Object* o);
+  };
+
+  template<size_t... B>
+  constexpr std::array<Band, BANDS> make_bands(std::index_sequence<B...>)
+  {
+    return {Band{&alloc_band<B>, &slots_of<B>}...};
+  }
+
+  static constexpr std::array<Band, BANDS> BAND_TABLE =
+    make_bands(std::make_index_sequence<BANDS>());
+
+  struct Options
+  {
+    size_t bytes;
+    size_t live_bytes;
+    size_t collect_bytes;
+    double alpha;
+    size_t pointer_percent;
+    bool mix_only;
+    uint64_t seed;
+  };
+
+  struct PhaseResult
+  {
+    size_t allocs = 0;
+    size_t bytes = 0;
+    uint64_t alloc_ns = 0;
+    size_t collections = 0;
+    uint64_t collect_ns = 0;
+    size_t live = 0;
+    size_t used = 0;
+    size_t count[BANDS] = {};
+  };
+
+  template<RegionType rt>
+  void drop(Pool* pool, PoolState& ps, size_t s)
+  {
+    Object* o = pool->slot[s];
+    ps.bytes -= o->get_descriptor()->size;
+    store(pool->slot[s], (Object*)nullptr);
+    if constexpr (rt == RegionType::Rc)
+      decref(o);
+
+    size_t i = ps.position[s];
+    ps.occupied[i] = ps.occupied.back();
+    ps.position[ps.occupied[i]] = i;
+    ps.occupied.pop_back();
+    ps.position[s] = SIZE_MAX;
+    ps.free.push_back(s);
+  }
+
+  /**
+   * Point every slot of the new array `o` at a byte buffer in the pool,
+   * where one can be found in a few tries.
+   */
+  template<RegionType rt>
+  void fill(
+    Object* o, size_t band, Pool* pool, PoolState& ps, std::mt19937_64& rng)
+  {
+    auto [slots, n] = BAND_TABLE[band].slots(o);
+    for (size_t i = 0; i < n && !ps.occupied.empty(); i++)
+    {
+      for (size_t attempt = 0; attempt < 4; attempt++)
+      {
+        size_t s = ps.occupied[rng() % ps.occupied.size()];
+        if (!ps.refs[s])
+        {
+          slots[i] = pool->slot[s];
+          if constexpr (rt == RegionType::Rc)
+            incref(slots[i]);
+          break;
+        }
+      }
+    }
+  }
+
+  /// The bytes of every object reachable from the pool.
+  inline size_t reachable_bytes(Pool* pool, const PoolState& ps)
+  {
+    std::unordered_set<Object*> seen;
+    size_t total = pool->get_descriptor()->size;
+    auto visit = [&](Object* o) {
+      if (seen.insert(o).second)
+        total += o->get_descriptor()->size;
+    };
+
+    for (size_t s : ps.occupied)
+    {
+      visit(pool->slot[s]);
+      if (!ps.refs[s])
+        continue;
+      auto [slots, n] = BAND_TABLE[ps.band[s]].slots(pool->slot[s]);
+      for (size_t i = 0; i < n; i++)
+      {
+        if (slots[i] != nullptr)
+          visit(slots[i]);
+      }
+    }
+    return total;
+  }
+
+  /**
+   * Allocate `o.bytes` of objects whose band and kind `choose` draws, in a
+   * region of its own.
+   */
+  template<RegionType rt>
+  PhaseResult run_phase(
+    const Options& o,
+    const std::function<std::pair<size_t, bool>(std::mt19937_64&)>& choose)
+  {
+    using Clock = std::chrono::steady_clock;
+    auto ns_since = [](Clock::time_point start) {
+      return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+               Clock::now() - start)
+        .count();
+    };
+
+    PhaseResult r;
+    PoolState ps;
+    std::mt19937_64 rng(o.seed);
+    size_t since_collect = 0;
+
+    auto* pool = new (rt) Pool;
+    {
+      UsingRegion rr(pool);
+
+      auto collect = [&]() {
+        auto start = Clock::now();
+        region_collect();
+        r.collect_ns += ns_since(start);
+        r.collections++;
+        since_collect = 0;
+      };
+
+      while (r.bytes < o.bytes)
+      {
+        auto [band, refs] = choose(rng);
+        auto start = Clock::now();
+
+        // Nothing else is held across the allocation, so a collector that
+        // moves objects when it allocates cannot leave a pointer stale.
+        Object* obj = BAND_TABLE[band].alloc(refs);
+        if (refs)
+          fill<rt>(obj, band, pool, ps, rng);
+        size_t size = obj->get_descriptor()->size;
+
+        if (ps.free.empty())
+          drop<rt>(pool, ps, ps.occupied[rng() % ps.occupied.size()]);
+        size_t s = ps.free.back();
+        ps.free.pop_back();
+        store(pool->slot[s], obj);
+        ps.position[s] = ps.occupied.size();
+        ps.occupied.push_back(s);
+        ps.band[s] = (uint8_t)band;
+        ps.refs[s] = refs;
+        ps.bytes += size;
+
+        while (ps.bytes > o.live_bytes && ps.occupied.size() > 1)
+        {
+          size_t victim = ps.occupied[rng() % ps.occupied.size()];
+          if (victim != s)
+            drop<rt>(pool, ps, victim);
+        }
+
+        r.alloc_ns += ns_since(start);
+        r.allocs++;
+        r.count[band]++;
+        r.bytes += size;
+        since_collect += size;
+        if (o.collect_bytes != 0 && since_collect >= o.collect_bytes)
+          collect();
+      }
+
+      collect();
+      r.used = debug_memory_used();
+      r.live = reachable_bytes(pool, ps);
+    }
+    region_release(pool);
+    return r;
+  }
+
+  inline void print_size(size_t size)
+  {
+    if (size >= 1024 * 1024)
+      std::cout << std::setw(5) << size / (1024 * 1024) << "M";
+    else if (size >= 1024)
+      std::cout << std::setw(5) << size / 1024 << "K";
+    else
+      std::cout << std::setw(6) << size;
+  }
+
+  inline void print_row(const PhaseResult& r)
+  {
+    double mib = (double)r.bytes / (1024 * 1024);
+    double secs = (double)r.alloc_ns / 1e9;
+    std::cout << std::setw(10) << r.allocs << std::fixed
+              << std::setprecision(1) << std::setw(10)
+              << (secs == 0 ? 0.0 : mib / secs) << std::setw(10)
+              << (r.allocs == 0 ? 0.0 : (double)r.alloc_ns / r.allocs)
+              << std::setw(6) << r.collections << std::setw(12)
+              << (r.collections == 0 ? 0 : r.collect_ns / r.collections)
+              << std::setw(12) << (mib == 0 ? 0.0 : r.collect_ns / mib)
+              << std::setw(12) << r.live << std::setw(12) << r.used
+              << std::setprecision(2) << std::setw(7)
+              << (r.live == 0 ? 0.0 : (double)r.used / (double)r.live)
+              << std::defaultfloat << "\n";
+  }
+
+  template<RegionType rt>
+  void run_test(const Options& o)
+  {
+    std::cout << "Size mix: " << o.bytes << " bytes per phase, "
+              << o.live_bytes << " live, collecting every "
+              << o.collect_bytes << "\n";
+    if constexpr (rt == RegionType::Arena)
+    {
+      if (!RegionArena::get_collectable())
+        std::cout << "Arena regions are only collected with --arena-gc.\n";
+    }
+    std::cout << "  band  kind    allocs     MiB/s  ns/alloc   gcs   avg_gc_ns"
+                 "  gc_ns/MiB        live        used   frag\n";
+
+    if (!o.mix_only)
+    {
+      for (size_t band = 0; band < BANDS; band++)
+      {
+        for (bool refs : {false, true})
+        {
+          PhaseResult r = run_phase<rt>(o, [band, refs](std::mt19937_64&) {
+            return std::make_pair(band, refs);
+          });
+          print_size(band_size(band));
+          std::cout << (refs ? "  refs " : "  bytes");
+          print_row(r);
+        }
+      }
+    }
+
+    std::vector<double> weights;
+    for (size_t band = 0; band < BANDS; band++)
+      weights.push_back(std::pow(4.0, -o.alpha * (double)band));
+    std::discrete_distribution<size_t> bands(weights.begin(), weights.end());
+    std::uniform_int_distribution<size_t> percent(0, 99);
+    size_t pointer_percent = o.pointer_percent;
+
+    PhaseResult r = run_phase<rt>(o, [&](std::mt19937_64& rng) {
+      size_t band = bands(rng);
+      return std::make_pair(band, percent(rng) < pointer_percent);
+    });
+    std::cout << "   mix  both ";
+    print_row(r);
+
+    std::cout << "  mix allocations per band:";
+    for (size_t band = 0; band < BANDS; band++)
+    {
+      std::cout << " ";
+      print_size(band_size(band));
+      std::cout << ": " << r.count[band];
+    }
+    std::cout << "\n";
+  }
+} // namespace size_mix
@@ -0,0 +1,71 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include <chrono>
+#include <debug/harness.h>
+#include <iostream>
+#include <pal/memory_sampler.h>
+#include <vector>
+#include <verona.h>
+
+/**
+ * Many tiny regions.
+ *
+ * Creates `regions` regions, each holding only its root, keeps them all
+ * alive at once, and then releases them. Regions that never reference an
+ * immutable or hand out an external reference allocate no remembered set
+ * or external reference table, so this measures what an empty region
+ * costs.
+ *
+ * The benchmark reports the average time to create and to release a
+ * region, and the memory snmalloc holds per live region.
+ **/
+namespace tiny_regions
+{
+  struct Root : public V<Root>
+  {
+    size_t id;
+
+    Root(size_t id) : id(id) {}
+
+    void trace(ObjectStack&) const {}
+  };
+
+  inline uint64_t elapsed_ns(std::chrono::steady_clock::time_point start)
+  {
+    return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start)
+        .count());
+  }
+
+  template<RegionType rt>
+  void run_test(size_t regions)
+  {
+    std::vector<Root*> roots;
+    roots.reserve(regions);
+
+    size_t before = MemorySampler::allocator_usage();
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < regions; i++)
+      roots.push_back(new (rt) Root(i));
+    uint64_t create_ns = elapsed_ns(start);
+    size_t after = MemorySampler::allocator_usage();
+
+    start = std::chrono::steady_clock::now();
+    for (auto* r : roots)
+      region_release(r);
+    uint64_t release_ns = elapsed_ns(start);
+
+    std::cout << "Regions: " << regions << "\n";
+    if (regions > 0)
+    {
+      std::cout << "Average create: " << create_ns / regions << " ns\n";
+      std::cout << "Average release: " << release_ns / regions << " ns\n";
+      if (after > before)
+        std::cout << "Memory per region: " << (after - before) / regions
+                  << " bytes\n";
+    }
+  }
+} // namespace tiny_regions
@@ -1,6 +1,7 @@
 // Copyright Microsoft and Project Verona Contributors.
 // SPDX-License-Identifier: MIT
 #include "tree_transform.h"
+#include "tree_transform_baseline.h"
 
 #include "../../../src/benchmarker/export_macro.h"
 #include "../benchmarker/benchmark_main_helper.h"
@@ -11,21 +12,31 @@
 BENCHMARK_WINDOWS_CALLBACK_BRIDGE()
 
 MAKE_REGION_WRAPPER(test, tree_transform::run_test);
+MAKE_BASELINE_WRAPPER(baseline, tree_transform::run_baseline);
 
 extern "C" BENCHMARK_EXPORT int run_benchmark(int argc, char** argv)
 {
   opt::Opt opt(argc, argv);
 
   enable_benchmark_logging(opt);
-  RegionType rt = parse_region_type(opt);
 
   // Parse command-line arguments
   size_t seed = opt.is<size_t>("--seed", 0);
-  UNUSED(seed);
   int depth = opt.is<int>("-d", 10);
   int transforms = opt.is<int>("-t", 5);
+  int walks = opt.is<int>("-w", 10);
+  int lookups = opt.is<int>("-l", 100000);
+
+  Baseline b = parse_baseline(opt);
+  if (b != Baseline::None)
+  {
+    DISPATCH_BASELINE(b, baseline, depth, transforms, walks, lookups, seed);
+    return 0;
+  }
 
-  DISPATCH_REGION(rt, test, depth, transforms);
+  RegionType rt = parse_region_type(opt);
+  parse_gc_options(opt);
+  DISPATCH_REGION(rt, test, depth, transforms, walks, lookups, seed);
 
   return 0;
 }
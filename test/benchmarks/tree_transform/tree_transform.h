@@ -2,8 +2,11 @@
 // SPDX-License-Identifier: MIT
 #pragma once
 
+#include <chrono>
 #include <debug/harness.h>
 #include <iostream>
+#include <random>
+#include <vector>
 #include <verona.h>
 
 using namespace snmalloc;
@@ -92,26 +95,19 @@ namespace tree_transform
     root = nullptr;
   }
 
-  /**
-   * Build a complete binary tree of given depth.
-   * Returns the root node.
-   *
-   * For depth=10: 2^10 - 1 = 1023 nodes
-   * For depth=15: 2^15 - 1 = 32767 nodes
-   * For depth=20: 2^20 - 1 = 1048575 nodes
-   */
   template<RegionType rt>
-  inline TreeNode* build_tree(int depth, int start_value = 0)
+  inline TreeNode*
+  link_tree(TreeNode** nodes, size_t& next, int depth, int start_value)
   {
     if (depth <= 0)
       return nullptr;
 
-    auto* node = new TreeNode();
+    auto* node = nodes[next++];
     node->value = start_value;
 
-    // Build children recursively
-    auto* left = build_tree<rt>(depth - 1, start_value * 2 + 1);
-    auto* right = build_tree<rt>(depth - 1, start_value * 2 + 2);
+    // Link children recursively
+    auto* left = link_tree<rt>(nodes, next, depth - 1, start_value * 2 + 1);
+    auto* right = link_tree<rt>(nodes, next, depth - 1, start_value * 2 + 2);
 
     // Assign children - simulate realistic RC overhead
     node->left = left;
@@ -122,6 +118,30 @@ namespace tree_transform
     return node;
   }
 
+  /**
+   * Build a complete binary tree of given depth.
+   * Returns the root node.
+   *
+   * The nodes are allocated as one batch, then linked in the preorder
+   * link_tree() visits them in.
+   *
+   * For depth=10: 2^10 - 1 = 1023 nodes
+   * For depth=15: 2^15 - 1 = 32767 nodes
+   * For depth=20: 2^20 - 1 = 1048575 nodes
+   */
+  template<RegionType rt>
+  inline TreeNode* build_tree(int depth, int start_value = 0)
+  {
+    if (depth <= 0)
+      return nullptr;
+
+    std::vector<TreeNode*> nodes((size_t{1} << depth) - 1);
+    alloc_many(nodes.size(), nodes.data());
+
+    size_t next = 0;
+    return link_tree<rt>(nodes.data(), next, depth, start_value);
+  }
+
   /**
    * Transform tree: increment all values by delta.
    * Creates a NEW tree (old one becomes garbage).
@@ -169,6 +189,60 @@ namespace tree_transform
     return root->value + sum_values(root->left) + sum_values(root->right);
   }
 
+  /**
+   * Time `walks` depth-first traversals of the tree, in nanoseconds per
+   * node visited. Run right after a collection, this measures how well the
+   * collector laid the surviving tree out for the mutator.
+   */
+  inline double time_traversals(TreeNode* root, size_t nodes, int walks)
+  {
+    volatile int sink = 0;
+    auto t_start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < walks; i++)
+      sink = sink + sum_values(root);
+    auto t_end = std::chrono::high_resolution_clock::now();
+    UNUSED(sink);
+
+    if (walks <= 0 || nodes == 0)
+      return 0;
+    auto ns =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(t_end - t_start)
+        .count();
+    return static_cast<double>(ns) / (static_cast<double>(nodes) * walks);
+  }
+
+  /**
+   * Time `lookups` walks from the root to a random leaf, in nanoseconds per
+   * walk. Unlike a full traversal, these touch a few nodes per level, so
+   * they depend on parents being laid out close to their children.
+   */
+  inline double time_lookups(TreeNode* root, int lookups, std::mt19937& rng)
+  {
+    volatile int sink = 0;
+    auto t_start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < lookups; i++)
+    {
+      // One random bit per level picks the child.
+      uint32_t path = rng();
+      int sum = 0;
+      for (TreeNode* n = root; n != nullptr; path >>= 1)
+      {
+        sum += n->value;
+        n = (path & 1) ? n->right : n->left;
+      }
+      sink = sink + sum;
+    }
+    auto t_end = std::chrono::high_resolution_clock::now();
+    UNUSED(sink);
+
+    if (lookups <= 0)
+      return 0;
+    auto ns =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(t_end - t_start)
+        .count();
+    return static_cast<double>(ns) / lookups;
+  }
+
 #undef INCREF
 #undef DECREF
 #undef TRANSFER_REF
@@ -177,13 +251,26 @@ namespace tree_transform
    * Run the tree transformation test.
    */
   template<RegionType rt>
-  void run_test(int depth = 10, int transforms = 5)
+  void run_test(
+    int depth = 10,
+    int transforms = 5,
+    int walks = 10,
+    int lookups = 100000,
+    size_t seed = 0)
   {
     auto* root = new (rt) TreeNode();
+    std::mt19937 rng(static_cast<std::mt19937::result_type>(seed));
 
     {
       UsingRegion rr(root);
 
+      // For SemiSpace and Compact, an allocation that does not fit collects
+      // and moves the tree, so reserve room for a whole tree before building
+      // or transforming one while holding C++ pointers into it.
+      size_t tree_bytes = ((size_t{1} << depth) - 1) * vsizeof<TreeNode>;
+      if constexpr (rt == RegionType::SemiSpace || rt == RegionType::Compact)
+        region_ensure_available(tree_bytes);
+
       TreeNode* current = build_tree<rt>(depth);
       root->left = current;
 
@@ -192,6 +279,13 @@ namespace tree_transform
 
       for (int i = 0; i < transforms; i++)
       {
+        if constexpr (
+          rt == RegionType::SemiSpace || rt == RegionType::Compact)
+        {
+          region_ensure_available(tree_bytes);
+          current = root->left;
+        }
+
         TreeNode* next = transform_tree<rt>(current, 1);
         discard_tree<rt>(current);
         current = next;
@@ -212,10 +306,25 @@ namespace tree_transform
         int heap_after = debug_size();
         std::cout << "Heap size after collect: " << heap_after << "\n";
 
-        // Arena has no GC, so skip the heap size check
-        if constexpr (rt != RegionType::Arena)
+        // Traversal right after the collection, which may have moved the
+        // tree (see RegionSemiSpace::set_copy_order()).
+        size_t nodes = count_nodes(current);
+        std::cout << "Traversal after collect: "
+                  << time_traversals(current, nodes, walks)
+                  << " ns/node\n";
+        std::cout << "Lookups after collect: "
+                  << time_lookups(current, lookups, rng) << " ns/lookup\n";
+
+        // Arena has no GC, so skip the heap size check. A minor
+        // generational collection keeps promoted garbage until the next
+        // major one.
+        size_t expected = nodes + 1; // +1 for root
+        if constexpr (rt == RegionType::Generational)
+        {
+          check(heap_after >= static_cast<int>(expected));
+        }
+        else if constexpr (rt != RegionType::Arena)
         {
-          size_t expected = count_nodes(current) + 1; // +1 for root
           check(heap_after == static_cast<int>(expected));
         }
       }
@@ -226,28 +335,49 @@ namespace tree_transform
     region_release(root);
   }
 
-  inline void
-  run_test(const std::string& gc_type, int depth = 10, int transforms = 5)
+  inline void run_test(
+    const std::string& gc_type,
+    int depth = 10,
+    int transforms = 5,
+    int walks = 10,
+    int lookups = 100000,
+    size_t seed = 0)
   {
     if (gc_type == "trace")
     {
       std::cout << "\nTree Transform Test: Trace GC\n";
-      tree_transform::run_test<RegionType::Trace>(depth, transforms);
+      tree_transform::run_test<RegionType::Trace>(
+        depth, transforms, walks, lookups, seed);
     }
     else if (gc_type == "arena")
     {
       std::cout << "\nTree Transform Test: Arena\n";
-      tree_transform::run_test<RegionType::Arena>(depth, transforms);
+      tree_transform::run_test<RegionType::Arena>(
+        depth, transforms, walks, lookups, seed);
     }
     else if (gc_type == "semispace")
     {
       std::cout << "\nTree Transform Test: SemiSpace GC\n";
-      tree_transform::run_test<RegionType::SemiSpace>(depth, transforms);
+      tree_transform::run_test<RegionType::SemiSpace>(
+        depth, transforms, walks, lookups, seed);
+    }
+    else if (gc_type == "generational")
+    {
+      std::cout << "\nTree Transform Test: Generational GC\n";
+      tree_transform::run_test<RegionType::Generational>(
+        depth, transforms, walks, lookups, seed);
+    }
+    else if (gc_type == "compact")
+    {
+      std::cout << "\nTree Transform Test: Compact GC\n";
+      tree_transform::run_test<RegionType::Compact>(
+        depth, transforms, walks, lookups, seed);
     }
     else
     {
       std::cout << "\nTree Transform Test: RC GC\n";
-      tree_transform::run_test<RegionType::Rc>(depth, transforms);
+      tree_transform::run_test<RegionType::Rc>(
+        depth, transforms, walks, lookups, seed);
     }
   }
 } // namespace tree_transform
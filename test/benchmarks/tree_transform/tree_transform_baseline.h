@@ -0,0 +1,172 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "../benchmarker/benchmark_baseline.h"
+
+#include <chrono>
+#include <debug/harness.h>
+#include <iostream>
+#include <random>
+#include <utility>
+
+namespace tree_transform
+{
+  /**
+   * The tree transformation workload without a region (see Baseline). Each
+   * transformed tree replaces the last one, which the New baseline deletes
+   * node by node, as a compiler pass would free the tree it replaced.
+   */
+  template<Baseline B>
+  struct NativeNode
+  {
+    using Ptr = typename BaselineHeap<B>::template Ptr<NativeNode>;
+
+    Ptr left = nullptr;
+    Ptr right = nullptr;
+    int value = 0;
+  };
+
+  template<Baseline B>
+  typename NativeNode<B>::Ptr
+  build_native(BaselineHeap<B>& heap, int depth, int start_value)
+  {
+    if (depth <= 0)
+      return nullptr;
+
+    auto node = heap.template make<NativeNode<B>>();
+    node->value = start_value;
+    node->left = build_native(heap, depth - 1, start_value * 2 + 1);
+    node->right = build_native(heap, depth - 1, start_value * 2 + 2);
+    return node;
+  }
+
+  template<Baseline B>
+  typename NativeNode<B>::Ptr transform_native(
+    BaselineHeap<B>& heap, const NativeNode<B>* old_root, int delta)
+  {
+    if (old_root == nullptr)
+      return nullptr;
+
+    auto node = heap.template make<NativeNode<B>>();
+    node->value = old_root->value + delta;
+    node->left = transform_native(heap, raw_ptr(old_root->left), delta);
+    node->right = transform_native(heap, raw_ptr(old_root->right), delta);
+    return node;
+  }
+
+  template<Baseline B>
+  void discard_native(BaselineHeap<B>& heap, typename NativeNode<B>::Ptr& n)
+  {
+    if (n == nullptr)
+      return;
+
+    if constexpr (BaselineHeap<B>::frees_each)
+    {
+      discard_native(heap, n->left);
+      discard_native(heap, n->right);
+    }
+    heap.dispose(n);
+  }
+
+  template<typename N>
+  size_t count_native(const N* root)
+  {
+    if (root == nullptr)
+      return 0;
+    return 1 + count_native(raw_ptr(root->left)) +
+      count_native(raw_ptr(root->right));
+  }
+
+  template<typename N>
+  int sum_native(const N* root)
+  {
+    if (root == nullptr)
+      return 0;
+    return root->value + sum_native(raw_ptr(root->left)) +
+      sum_native(raw_ptr(root->right));
+  }
+
+  /// As time_traversals(), over a native tree.
+  template<typename N>
+  double time_native_traversals(const N* root, size_t nodes, int walks)
+  {
+    volatile int sink = 0;
+    auto t_start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < walks; i++)
+      sink = sink + sum_native(root);
+    auto t_end = std::chrono::high_resolution_clock::now();
+    UNUSED(sink);
+
+    if (walks <= 0 || nodes == 0)
+      return 0;
+    auto ns =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(t_end - t_start)
+        .count();
+    return static_cast<double>(ns) / (static_cast<double>(nodes) * walks);
+  }
+
+  /// As time_lookups(), over a native tree.
+  template<typename N>
+  double time_native_lookups(const N* root, int lookups, std::mt19937& rng)
+  {
+    volatile int sink = 0;
+    auto t_start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < lookups; i++)
+    {
+      uint32_t path = rng();
+      int sum = 0;
+      for (const N* n = root; n != nullptr; path >>= 1)
+      {
+        sum += n->value;
+        n = (path & 1) ? raw_ptr(n->right) : raw_ptr(n->left);
+      }
+      sink = sink + sum;
+    }
+    auto t_end = std::chrono::high_resolution_clock::now();
+    UNUSED(sink);
+
+    if (lookups <= 0)
+      return 0;
+    auto ns =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(t_end - t_start)
+        .count();
+    return static_cast<double>(ns) / lookups;
+  }
+
+  template<Baseline B>
+  void run_baseline(
+    int depth = 10,
+    int transforms = 5,
+    int walks = 10,
+    int lookups = 100000,
+    size_t seed = 0)
+  {
+    std::cout << "\nTree Transform Test: " << baseline_name(B) << "\n";
+    std::mt19937 rng(static_cast<std::mt19937::result_type>(seed));
+
+    BaselineHeap<B> heap;
+    auto current = build_native(heap, depth, 0);
+    std::cout << "Tree built. Nodes: " << count_native(raw_ptr(current))
+              << "\n";
+
+    for (int i = 0; i < transforms; i++)
+    {
+      auto next = transform_native(heap, raw_ptr(current), 1);
+      discard_native(heap, current);
+      current = std::move(next);
+
+      size_t nodes = count_native(raw_ptr(current));
+      std::cout << "Traversal after transform: "
+                << time_native_traversals(raw_ptr(current), nodes, walks)
+                << " ns/node\n";
+      std::cout << "Lookups after transform: "
+                << time_native_lookups(raw_ptr(current), lookups, rng)
+                << " ns/lookup\n";
+      check(nodes == (size_t{1} << depth) - 1);
+    }
+
+    discard_native(heap, current);
+    std::cout << "Completed " << transforms << " transforms.\n";
+  }
+} // namespace tree_transform
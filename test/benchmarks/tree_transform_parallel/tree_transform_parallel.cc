@@ -0,0 +1,42 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#include "tree_transform_parallel.h"
+
+#include "../../../src/benchmarker/export_macro.h"
+#include "../benchmarker/benchmark_main_helper.h"
+
+#include <debug/harness.h>
+#include <test/opt.h>
+
+BENCHMARK_WINDOWS_CALLBACK_BRIDGE()
+
+MAKE_REGION_WRAPPER(test, tree_transform_parallel::run_test);
+
+extern "C" BENCHMARK_EXPORT int run_benchmark(int argc, char** argv)
+{
+  opt::Opt opt(argc, argv);
+
+  enable_benchmark_logging(opt);
+  RegionType rt = parse_region_type(opt);
+  parse_gc_options(opt);
+
+  tree_transform_parallel::Options o;
+  o.depth = opt.is<int>("-d", 16);
+  o.split = opt.is<int>("--split", 3);
+  o.transforms = opt.is<int>("-t", 5);
+  o.join = tree_transform_parallel::JoinMode::Merge;
+  if (opt.has("--freeze"))
+    o.join = tree_transform_parallel::JoinMode::Freeze;
+  else if (opt.has("--release"))
+    o.join = tree_transform_parallel::JoinMode::Release;
+  // As the harness reads it.
+  o.cores = opt.is<size_t>("--cores", 4);
+  if (o.cores == 0)
+    o.cores = Scheduler::available_cores();
+
+  DISPATCH_REGION(rt, test, o);
+
+  return 0;
+}
+
+RUN_BENCHMARK_MAIN()
@@ -0,0 +1,307 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "../tree_transform/tree_transform.h"
+#include "cpp/cown.h"
+#include "cpp/when.h"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <debug/harness.h>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <vector>
+#include <verona.h>
+
+using namespace verona::cpp;
+
+/**
+ * Fork-join variant of tree_transform.
+ *
+ * The tree of depth `depth` is split `split` levels down into 2^split
+ * subtrees. Each subtree is built and transformed `transforms` times, with
+ * a collection after each, in a region of its own owned by a cown, in
+ * parallel behaviours. Each finished region is then handed to a join cown,
+ * which merges it into a region holding the top `split` levels of the tree
+ * and links the subtree in where it belongs (trace, arena, rc and
+ * semispace). With JoinMode::Freeze it freezes each region instead (trace),
+ * and with JoinMode::Release it releases it.
+ *
+ * The same work is first done in a single behaviour, and the benchmark
+ * reports the parallel run's speedup over it for the number of cores the
+ * scheduler was started with.
+ **/
+namespace tree_transform_parallel
+{
+  using tree_transform::TreeNode;
+
+  enum class JoinMode
+  {
+    Merge,
+    Freeze,
+    Release
+  };
+
+  struct Options
+  {
+    int depth;
+    int split;
+    int transforms;
+    JoinMode join;
+    /// Scheduler threads, for the report.
+    size_t cores;
+  };
+
+  /// Cown that owns a subtree's region while it is transformed.
+  struct Part
+  {
+    TreeNode* root = nullptr;
+
+    ~Part()
+    {
+      if (root != nullptr)
+        region_release(root);
+    }
+  };
+
+  /// Cown that joins the subtrees back together.
+  struct Joined
+  {
+    /// The region holding the top levels, once the first subtree arrives.
+    TreeNode* root = nullptr;
+    size_t received = 0;
+    size_t nodes = 0;
+
+    ~Joined()
+    {
+      if (root != nullptr)
+        region_release(root);
+    }
+  };
+
+  using Clock = std::chrono::steady_clock;
+
+  inline uint64_t ns_since(Clock::time_point start)
+  {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+             Clock::now() - start)
+      .count();
+  }
+
+  inline size_t subtrees(const Options& o)
+  {
+    return size_t{1} << o.split;
+  }
+
+  template<RegionType rt>
+  constexpr bool can_merge()
+  {
+    return rt == RegionType::Trace || rt == RegionType::Arena ||
+      rt == RegionType::Rc || rt == RegionType::SemiSpace;
+  }
+
+  template<RegionType rt>
+  JoinMode join_mode(const Options& o)
+  {
+    if (o.join == JoinMode::Merge && can_merge<rt>())
+      return JoinMode::Merge;
+    if (o.join == JoinMode::Freeze && rt == RegionType::Trace)
+      return JoinMode::Freeze;
+    return JoinMode::Release;
+  }
+
+  /**
+   * Build subtree `i` in a region of its own, and transform it. The region's
+   * entry point holds the subtree in `left`. The values are those the nodes
+   * would have in one tree built with tree_transform::build_tree().
+   */
+  template<RegionType rt>
+  TreeNode* process(const Options& o, size_t i)
+  {
+    auto* holder = new (rt) TreeNode();
+    UsingRegion rr(holder);
+
+    int depth = o.depth - o.split;
+    size_t tree_bytes = ((size_t{1} << depth) - 1) * vsizeof<TreeNode>;
+    if constexpr (rt == RegionType::SemiSpace || rt == RegionType::Compact)
+      region_ensure_available(tree_bytes);
+
+    int first = (int)(subtrees(o) - 1 + i);
+    holder->left = tree_transform::build_tree<rt>(depth, first);
+
+    for (int t = 0; t < o.transforms; t++)
+    {
+      if constexpr (rt == RegionType::SemiSpace || rt == RegionType::Compact)
+        region_ensure_available(tree_bytes);
+
+      TreeNode* current = holder->left;
+      TreeNode* next = tree_transform::transform_tree<rt>(current, 1);
+      tree_transform::discard_tree<rt>(current);
+      holder->left = next;
+      region_collect();
+    }
+    return holder;
+  }
+
+  /// Where subtree `i` hangs off the top `split` levels.
+  inline TreeNode** slot(TreeNode* root, size_t i, int split)
+  {
+    TreeNode* n = root;
+    for (int b = split - 1; b > 0; b--)
+      n = ((i >> b) & 1) ? n->right : n->left;
+    return (i & 1) ? &n->right : &n->left;
+  }
+
+  /// Take in the region `holder` made for subtree `i`.
+  template<RegionType rt>
+  void join(const Options& o, Joined& j, TreeNode* holder, size_t i)
+  {
+    j.received++;
+    JoinMode mode = join_mode<rt>(o);
+    if (mode != JoinMode::Merge)
+    {
+      j.nodes += tree_transform::count_nodes(holder->left);
+      if (mode == JoinMode::Freeze)
+      {
+        freeze(holder);
+        Immutable::release(holder);
+      }
+      else
+      {
+        region_release(holder);
+      }
+      return;
+    }
+
+    if (j.root == nullptr)
+    {
+      j.root = new (rt) TreeNode();
+      UsingRegion rr(j.root);
+      if constexpr (rt == RegionType::SemiSpace)
+        region_ensure_available(subtrees(o) * vsizeof<TreeNode>);
+      j.root->left = tree_transform::build_tree<rt>(o.split - 1, 1);
+      j.root->right = tree_transform::build_tree<rt>(o.split - 1, 2);
+    }
+
+    UsingRegion rr(j.root);
+    merge(holder);
+    // The old entry point is an ordinary object of this region now, and
+    // garbage once the subtree is moved out of it.
+    *slot(j.root, i, o.split) = holder->left;
+    holder->left = nullptr;
+    if constexpr (rt == RegionType::Rc)
+      decref(holder);
+  }
+
+  /// Check that every subtree arrived, and drop the result.
+  template<RegionType rt>
+  void finish(const Options& o, Joined& j)
+  {
+    check(j.received == subtrees(o));
+    size_t expected = (size_t{1} << o.depth) - 1;
+    if (j.root == nullptr)
+    {
+      check(j.nodes == expected - (subtrees(o) - 1));
+      return;
+    }
+
+    {
+      UsingRegion rr(j.root);
+      check(tree_transform::count_nodes(j.root) == expected);
+      if constexpr (rt != RegionType::Arena)
+      {
+        region_collect();
+        check(debug_size() == expected);
+      }
+    }
+    region_release(j.root);
+    j.root = nullptr;
+  }
+
+  template<RegionType rt>
+  struct Run
+  {
+    Options o;
+    cown_ptr<Joined> serial = make_cown<Joined>();
+    std::vector<cown_ptr<Part>> parts;
+    cown_ptr<Joined> joined = make_cown<Joined>();
+    uint64_t serial_ns = 0;
+    Clock::time_point start;
+
+    Run(const Options& o) : o(o)
+    {
+      for (size_t i = 0; i < subtrees(o); i++)
+        parts.push_back(make_cown<Part>());
+    }
+  };
+
+  template<RegionType rt>
+  void report(Run<rt>& r, uint64_t parallel_ns)
+  {
+    double speedup = (double)r.serial_ns / (double)parallel_ns;
+    std::cout << "Subtrees: " << subtrees(r.o) << " of depth "
+              << r.o.depth - r.o.split << ", " << r.o.transforms
+              << " transforms, on " << r.o.cores << " cores\n";
+    std::cout << "Serial: " << r.serial_ns / 1000000 << " ms, parallel: "
+              << parallel_ns / 1000000 << " ms, speedup: " << std::fixed
+              << std::setprecision(2) << speedup << ", efficiency: "
+              << std::setprecision(0) << 100 * speedup / (double)r.o.cores
+              << "%\n"
+              << std::defaultfloat;
+  }
+
+  /// Fork a behaviour per subtree, each joining its region back in a
+  /// behaviour on the join cown.
+  template<RegionType rt>
+  void fork(std::shared_ptr<Run<rt>> r)
+  {
+    r->start = Clock::now();
+    for (size_t i = 0; i < subtrees(r->o); i++)
+    {
+      when(r->parts[i]) << [r, i](auto p) {
+        p->root = process<rt>(r->o, i);
+        TreeNode* holder = p->root;
+        p->root = nullptr;
+
+        when(r->joined) << [r, i, holder](auto j) {
+          join<rt>(r->o, *j, holder, i);
+          if (j->received == subtrees(r->o))
+          {
+            finish<rt>(r->o, *j);
+            report(*r, ns_since(r->start));
+          }
+        };
+      };
+    }
+  }
+
+  template<RegionType rt>
+  void run_test(const Options& o)
+  {
+    if (o.split < 1 || o.split >= o.depth)
+    {
+      std::cout << "The split must be at least 1 and less than the depth.\n";
+      return;
+    }
+
+    if (
+      (o.join == JoinMode::Merge && !can_merge<rt>()) ||
+      (o.join == JoinMode::Freeze && rt != RegionType::Trace))
+      std::cout << "The join cannot merge or freeze this region type, so it "
+                   "releases each region instead.\n";
+
+    auto r = std::make_shared<Run<rt>>(o);
+    when(r->serial) << [r](auto j) {
+      auto start = Clock::now();
+      for (size_t i = 0; i < subtrees(r->o); i++)
+        join<rt>(r->o, *j, process<rt>(r->o, i), i);
+      finish<rt>(r->o, *j);
+      r->serial_ns = ns_since(start);
+
+      fork(r);
+    };
+  }
+} // namespace tree_transform_parallel
@@ -5,6 +5,7 @@
 #include "debug/harness.h"
 #include "debug/log.h"
 #include "unordered_set"
+#include "vector"
 #include "verona.h"
 
 using namespace snmalloc;
@@ -106,8 +107,67 @@ void test_bag_base()
   }
 }
 
+void test_bag_compact()
+{
+  using E = BagElem<uintptr_t, uintptr_t>;
+  using B = BagBase<E>;
+  B bag;
+
+  const uintptr_t NUM_OBJECTS = 1000;
+  std::vector<E*> items;
+  for (uintptr_t i = 0; i < NUM_OBJECTS; i++)
+    items.push_back(bag.insert({nullptr, i}));
+
+  // Leave long runs of holes, which iteration skips a group at a time.
+  for (uintptr_t i = 0; i < NUM_OBJECTS; i++)
+  {
+    if (i % 100 != 0)
+      bag.remove(items[i]);
+  }
+  check(bag.size() == NUM_OBJECTS / 100);
+  check(bag.hole_count() == NUM_OBJECTS - NUM_OBJECTS / 100);
+
+  std::unordered_set<uintptr_t> live;
+  for (auto entry : bag)
+    live.insert(entry->metadata);
+  check(live.size() == NUM_OBJECTS / 100);
+  for (uintptr_t i = 0; i < NUM_OBJECTS; i += 100)
+    check(live.count(i));
+
+  // Few enough holes are left alone.
+  B dense;
+  dense.remove(dense.insert({nullptr, 1}));
+  dense.insert({nullptr, 2});
+  dense.insert({nullptr, 3});
+  check(!dense.compact_if_sparse([](E*, E*) { check(false); }));
+  dense.dealloc();
+
+  size_t moves = 0;
+  check(bag.compact_if_sparse([&moves](E* from, E* to) {
+    check(from->metadata == to->metadata);
+    moves++;
+  }));
+  check(moves == NUM_OBJECTS / 100);
+  check(bag.hole_count() == 0);
+  check(bag.size() == NUM_OBJECTS / 100);
+
+  std::unordered_set<uintptr_t> after;
+  for (auto entry : bag)
+    after.insert(entry->metadata);
+  check(after == live);
+
+  // Removing and inserting keeps working after compaction.
+  bag.remove(*bag.begin());
+  bag.insert({nullptr, NUM_OBJECTS});
+  check(bag.size() == NUM_OBJECTS / 100);
+  check(bag.hole_count() == 0);
+
+  bag.dealloc();
+}
+
 int main(int, char**)
 {
   test_bag_base();
+  test_bag_compact();
   return 0;
 }
@@ -0,0 +1,26 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#include "compact_gc.h"
+
+#include <debug/harness.h>
+#include <test/opt.h>
+
+int main(int argc, char** argv)
+{
+  opt::Opt opt(argc, argv);
+  size_t seed = opt.is<size_t>("--seed", 0);
+  UNUSED(seed);
+
+#ifdef CI_BUILD
+  auto log = true;
+#else
+  auto log = opt.has("--log-all");
+#endif
+
+  if (log)
+    Logging::enable_logging();
+
+  compact_gc::run_test();
+
+  return 0;
+}
@@ -0,0 +1,281 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "../memory/memory.h"
+
+namespace compact_gc
+{
+  /**
+   * The iso (root) object of a Compact region is pinned, but every other
+   * object may slide on each collection. C++ local pointers to non-root
+   * objects become stale after region_collect(); navigate from the root
+   * instead.
+   */
+
+  static constexpr size_t BLOCK_BODY = 128 * 1024;
+  struct Block : public V<Block>
+  {
+    Block* next = nullptr;
+    uint8_t payload[BLOCK_BODY];
+
+    void trace(ObjectStack& st) const
+    {
+      if (next != nullptr)
+        st.push(next);
+    }
+
+    void relocate(Object* (*fwd)(Object*))
+    {
+      if (next != nullptr)
+        next = (Block*)fwd(next);
+    }
+  };
+
+  struct BlockRoot : public V<BlockRoot>
+  {
+    Block* block = nullptr;
+
+    void trace(ObjectStack& st) const
+    {
+      if (block != nullptr)
+        st.push(block);
+    }
+
+    void relocate(Object* (*fwd)(Object*))
+    {
+      if (block != nullptr)
+        block = (Block*)fwd(block);
+    }
+  };
+
+  size_t chain_length(BlockRoot* root)
+  {
+    size_t len = 0;
+    for (Block* b = root->block; b != nullptr; b = b->next)
+      len++;
+    return len;
+  }
+
+  /**
+   * Test 1: A collection keeps what the root reaches and gives the space
+   * taken by the rest back to the bump allocator.
+   */
+  void test_basic_gc()
+  {
+    auto* root = new (RegionType::Compact) C1;
+
+    {
+      UsingRegion rr(root);
+
+      auto* a = new C1;
+      auto* b = new C1;
+      new C1;
+      new C1;
+      root->f1 = a;
+      a->f2 = b;
+      check(debug_size() == 5);
+      check(debug_compact_space_used() == 4 * vsizeof<C1>);
+
+      region_collect();
+      check(debug_size() == 3);
+      check(debug_compact_space_used() == 2 * vsizeof<C1>);
+      check(root->f1 != nullptr && root->f1->f2 != nullptr);
+    }
+
+    region_release(root);
+    heap::debug_check_empty();
+  }
+
+  /**
+   * Test 2: Survivors slide to the start of the space in allocation order,
+   * and pointers between them, including cycles, are rewritten.
+   */
+  void test_sliding()
+  {
+    auto* root = new (RegionType::Compact) C1;
+
+    {
+      UsingRegion rr(root);
+
+      // A chain of ten objects with garbage between every pair.
+      C1* prev = nullptr;
+      for (size_t i = 0; i < 10; i++)
+      {
+        new C1;
+        auto* n = new C1;
+        if (prev == nullptr)
+          root->f1 = n;
+        else
+          prev->f1 = n;
+        prev = n;
+      }
+      // Close a cycle back to the head.
+      prev->f2 = root->f1;
+      check(debug_size() == 21);
+
+      region_collect();
+      check(debug_size() == 11);
+      check(debug_compact_space_used() == 10 * vsizeof<C1>);
+
+      size_t len = 0;
+      C1* last = nullptr;
+      for (C1* p = root->f1; p != nullptr; p = p->f1)
+      {
+        // No gaps are left between the survivors.
+        if (last != nullptr)
+          check((std::byte*)p == (std::byte*)last + vsizeof<C1>);
+        last = p;
+        len++;
+      }
+      check(len == 10);
+      check(last->f2 == root->f1);
+
+      // Nothing moves when everything survives.
+      C1* head = root->f1;
+      region_collect();
+      check(root->f1 == head);
+    }
+
+    region_release(root);
+    heap::debug_check_empty();
+  }
+
+  /**
+   * Test 3: Non-trivial objects are finalised and destructed exactly once,
+   * whether they die in a collection or are released with the region.
+   */
+  void test_finalisation()
+  {
+    live_count = 0;
+    auto* root = new (RegionType::Compact) F1;
+
+    {
+      UsingRegion rr(root);
+
+      new F1;
+      root->f1 = new F1;
+      new C1;
+      new F1;
+      check(live_count == 4);
+
+      region_collect();
+      check(live_count == 2);
+      check(debug_size() == 2);
+
+      // The survivor slid over the dead object, and is still tracked.
+      root->f1->f1 = new F1;
+      check(live_count == 3);
+      region_collect();
+      check(live_count == 3);
+    }
+
+    region_release(root);
+    check(live_count == 0);
+    heap::debug_check_empty();
+  }
+
+  /**
+   * Test 4: Allocating into a full space collects, and the space grows
+   * once live data fills more than half of it.
+   */
+  void test_growth()
+  {
+    auto* root = new (RegionType::Compact) BlockRoot;
+
+    {
+      UsingRegion rr(root);
+      check(debug_compact_space_size() == RegionCompact::INITIAL_SPACE_SIZE);
+
+      size_t count = 2 * RegionCompact::INITIAL_SPACE_SIZE / vsizeof<Block>;
+      for (size_t i = 0; i < count; i++)
+      {
+        auto* b = new Block;
+        b->next = root->block;
+        root->block = b;
+      }
+      check(debug_compact_space_size() > RegionCompact::INITIAL_SPACE_SIZE);
+      check(debug_size() == count + 1);
+      check(chain_length(root) == count);
+
+      region_collect();
+      check(debug_size() == count + 1);
+      check(chain_length(root) == count);
+      check(debug_compact_space_used() == count * vsizeof<Block>);
+    }
+
+    region_release(root);
+    heap::debug_check_empty();
+  }
+
+  /**
+   * Test 5: The space shrinks again once live data fits a quarter of it.
+   */
+  void test_shrink()
+  {
+    auto* root = new (RegionType::Compact) BlockRoot;
+
+    {
+      UsingRegion rr(root);
+
+      size_t count = 3 * RegionCompact::INITIAL_SPACE_SIZE / vsizeof<Block>;
+      for (size_t i = 0; i < count; i++)
+      {
+        auto* b = new Block;
+        b->next = root->block;
+        root->block = b;
+      }
+      size_t grown = debug_compact_space_size();
+      check(grown >= 4 * RegionCompact::INITIAL_SPACE_SIZE);
+
+      // A single survivor does not need more than the initial size.
+      root->block->next = nullptr;
+      region_collect();
+      check(debug_size() == 2);
+      check(debug_compact_space_size() == RegionCompact::INITIAL_SPACE_SIZE);
+      check(chain_length(root) == 1);
+
+      // Reserving room grows the space ahead of the allocations.
+      region_ensure_available(2 * RegionCompact::INITIAL_SPACE_SIZE);
+      check(debug_compact_space_size() > 2 * RegionCompact::INITIAL_SPACE_SIZE);
+      Block* head = root->block;
+      for (size_t i = 0; i < 8; i++)
+        new Block;
+      check(root->block == head);
+    }
+
+    region_release(root);
+    heap::debug_check_empty();
+  }
+
+  // ---------------------------------------------------------------------------
+  // Test runner
+  // ---------------------------------------------------------------------------
+
+  void run_test()
+  {
+    std::cout << "=== Compact GC Tests ===" << std::endl;
+
+    std::cout << "Test 1: Basic GC..." << std::endl;
+    test_basic_gc();
+    std::cout << "  PASSED" << std::endl;
+
+    std::cout << "Test 2: Sliding..." << std::endl;
+    test_sliding();
+    std::cout << "  PASSED" << std::endl;
+
+    std::cout << "Test 3: Finalisation..." << std::endl;
+    test_finalisation();
+    std::cout << "  PASSED" << std::endl;
+
+    std::cout << "Test 4: Growth..." << std::endl;
+    test_growth();
+    std::cout << "  PASSED" << std::endl;
+
+    std::cout << "Test 5: Shrink..." << std::endl;
+    test_shrink();
+    std::cout << "  PASSED" << std::endl;
+
+    std::cout << "=== All Compact GC tests passed ===" << std::endl;
+  }
+}
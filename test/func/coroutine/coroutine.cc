@@ -0,0 +1,71 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#include <cpp/coroutine.h>
+#include <debug/harness.h>
+
+// Tasks that acquire one cown, several, and some for reading, and that
+// await other tasks for their results. This target is built as C++20.
+
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+using namespace verona::cpp;
+
+struct Account
+{
+  int balance;
+  Account(int balance) : balance(balance) {}
+};
+
+task<> deposit(cown_ptr<Account> a, int amount)
+{
+  auto& x = co_await acquire(a);
+  x->balance += amount;
+}
+
+task<> transfer(cown_ptr<Account> from, cown_ptr<Account> to, int amount)
+{
+  auto [x, y] = co_await acquire(from, to);
+  x->balance -= amount;
+  y->balance += amount;
+}
+
+task<int> total(cown_ptr<Account> a, cown_ptr<Account> b)
+{
+  auto [x, y] = co_await acquire(read(a), read(b));
+  co_return x->balance + y->balance;
+}
+
+task<> run(cown_ptr<Account> a, cown_ptr<Account> b)
+{
+  co_await deposit(a, 10);
+  co_await transfer(a, b, 4);
+  int sum = co_await total(a, b);
+  check(sum == 16);
+
+  auto [x, y] = co_await acquire(read(a), read(b));
+  check(x->balance == 11);
+  check(y->balance == 5);
+}
+
+void test_coroutine()
+{
+  auto a = make_cown<Account>(5);
+  auto b = make_cown<Account>(1);
+
+  // Dropped without being awaited, so it runs to completion on its own.
+  run(a, b);
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+  harness.run(test_coroutine);
+  return 0;
+}
+#else
+int main(int argc, char** argv)
+{
+  UNUSED(argc);
+  UNUSED(argv);
+  return 0;
+}
+#endif
@@ -0,0 +1,92 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+#include <cpp/when.h>
+#include <debug/harness.h>
+
+// Copies of cown_ptrs are taken out on the thread that made the cown, and
+// on others, and dropped on whichever thread they end up on, with and
+// without biased reference counting. Each cown must be destroyed exactly
+// once, after its last copy has gone, and weak references promoted while
+// copies remain must succeed. A cown made on a scheduler thread is biased
+// towards it, and most of the copies it counts are dropped elsewhere, so it
+// is only freed once that thread gives up its bias.
+
+using namespace verona::cpp;
+
+static std::atomic<size_t> made{0};
+static std::atomic<size_t> destroyed{0};
+
+class Body
+{
+public:
+  size_t id;
+
+  Body(size_t id) : id(id)
+  {
+    made++;
+  }
+
+  ~Body()
+  {
+    destroyed++;
+  }
+};
+
+// Spread `copies` copies of `c` over behaviours, each of which copies it
+// again before dropping it.
+void scatter(cown_ptr<Body> c, size_t copies)
+{
+  for (size_t i = 0; i < copies; i++)
+  {
+    when() << [c]() {
+      cown_ptr<Body> again = c;
+      when(again) << [](acquired_cown<Body> b) { check(b->id < made); };
+    };
+  }
+}
+
+void test_body(bool biased, size_t copies)
+{
+  Logging::cout() << "test_body() biased " << biased << Logging::endl;
+  verona::rt::Shared::set_biased_rc(biased);
+
+  // Made, and mostly copied, on this thread, which never biases.
+  auto c = make_cown<Body>(0);
+  std::vector<cown_ptr<Body>> local(copies, c);
+  auto w = c.get_weak();
+  scatter(c, copies);
+
+  when() << [w = std::move(w)]() mutable {
+    // The behaviour holds no strong copy, so the cown may be gone.
+    auto p = w.promote();
+    if (p != nullptr)
+      check(p.get_weak());
+  };
+
+  // Made and copied on a scheduler thread, and dropped on others.
+  when() << [copies]() {
+    auto d = make_cown<Body>(1);
+    scatter(d, copies);
+    when(d) << [d](acquired_cown<Body>) {
+      auto w = d.get_weak();
+      check(w.promote() != nullptr);
+    };
+  };
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+
+  auto copies = harness.opt.is<size_t>("--copies", 20);
+
+  for (bool biased : {true, false})
+  {
+    harness.run(test_body, biased, copies);
+    check(destroyed == made);
+  }
+  verona::rt::Shared::set_biased_rc(true);
+
+  return 0;
+}
@@ -0,0 +1,108 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#include <debug/harness.h>
+
+/**
+ * Rings of cowns, whose only references are each other's, must be freed by
+ * the CownCollector while the runtime runs. A ring links some of its cowns
+ * through a region whose remembered set holds the next cown, and a ring
+ * that something outside still refers to is only freed once that
+ * reference is released, by a behaviour.
+ **/
+
+static std::atomic<size_t> made{0};
+static std::atomic<size_t> destroyed{0};
+
+struct Node;
+
+struct Holder : public V<Holder>
+{
+  Node* cown = nullptr;
+
+  void trace(ObjectStack& st) const;
+};
+
+struct Node : public VCown<Node>
+{
+  Node* next = nullptr;
+  Holder* region = nullptr;
+
+  Node()
+  {
+    made++;
+  }
+
+  ~Node()
+  {
+    destroyed++;
+  }
+
+  void trace(ObjectStack& st) const
+  {
+    if (next != nullptr)
+      st.push(next);
+    if (region != nullptr)
+      st.push(region);
+  }
+};
+
+void Holder::trace(ObjectStack& st) const
+{
+  if (cown != nullptr)
+    st.push(cown);
+}
+
+// Builds a ring of `size` cowns, and returns its first cown, whose
+// reference the caller holds.
+Node* ring(size_t size, bool via_region)
+{
+  std::vector<Node*> nodes(size);
+  for (auto& n : nodes)
+    n = new Node;
+
+  for (size_t i = 0; i < size; i++)
+  {
+    Node* next = nodes[(i + 1) % size];
+    Cown::acquire(next);
+    if (via_region && (i % 2 == 1))
+    {
+      auto* h = new (RegionType::Trace) Holder;
+      h->cown = next;
+      RegionTrace::insert<TransferOwnership::YesTransfer>(h, next);
+      nodes[i]->region = h;
+    }
+    else
+    {
+      nodes[i]->next = next;
+    }
+  }
+
+  for (size_t i = 1; i < size; i++)
+    Cown::release(nodes[i]);
+  return nodes[0];
+}
+
+void test_cycles()
+{
+  Cown::release(ring(1, false));
+  Cown::release(ring(5, false));
+  Cown::release(ring(6, true));
+
+  // Held by a behaviour until it runs.
+  Node* held = ring(3, false);
+  schedule_lambda(held, [held]() { Cown::release(held); });
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+
+  CownCollector::set_enabled(true);
+  harness.run(test_cycles);
+  CownCollector::set_enabled(false);
+
+  check(destroyed == made);
+  check(CownCollector::get_collected() == made);
+
+  return 0;
+}
@@ -267,6 +267,30 @@ void test_repeated_cown()
     [=](auto) { Logging::cout() << "log" << Logging::endl; };
 }
 
+void test_move_busy()
+{
+  Logging::cout() << "test_move_busy()" << Logging::endl;
+
+  auto log1 = make_cown<Body1>(1);
+  auto log2 = make_cown<Body2>(2);
+
+  cown_ptr<Body1> carray[2];
+  carray[0] = log1;
+  carray[1] = log1;
+
+  cown_array<Body1> t1{carray, 2};
+
+  // The moved references are taken over by a behaviour that must wait.
+  when(log1) << [=](auto) { Logging::cout() << "log" << Logging::endl; };
+  when(std::move(t1), std::move(log2)) << [=](auto a, auto b) {
+    check(a.length == 2);
+    check(a.array[0]->val == 1);
+    check(b->val == 2);
+  };
+  check(t1.array == nullptr);
+  check(log2 == nullptr);
+}
+
 int main(int argc, char** argv)
 {
   SystematicTestHarness harness(argc, argv);
@@ -290,5 +314,7 @@ int main(int argc, char** argv)
 
   harness.run(test_repeated_cown);
 
+  harness.run(test_move_busy);
+
   return 0;
 }
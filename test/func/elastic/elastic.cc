@@ -0,0 +1,54 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#include <cpp/when.h>
+#include <debug/harness.h>
+
+using namespace verona::cpp;
+
+// Runs bursts of independent behaviours in an elastic pool, each after a
+// quiet spell in which one behaviour keeps a single thread busy, so that
+// the others retire. Every burst must run to completion, which needs the
+// retired threads, or the thread that keeps running, to pick it up.
+
+static constexpr size_t waves = 3;
+static constexpr size_t burst = 50;
+static constexpr size_t quiet_us = 2000;
+
+struct Counter
+{
+  size_t count = 0;
+};
+
+std::atomic<size_t> done{0};
+size_t cores = 0;
+
+void wave(size_t n)
+{
+  when() << [n]() {
+    check(Scheduler::get_retired_threads() < cores);
+    busy_loop(quiet_us);
+
+    for (size_t i = 0; i < burst; i++)
+    {
+      when(make_cown<Counter>()) << [n](auto c) {
+        c->count++;
+        if (++done == burst * (n + 1) && n + 1 < waves)
+          wave(n + 1);
+      };
+    }
+  };
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+  cores = harness.cores;
+  harness.run([]() {
+    // Retire any thread that pauses, down to one.
+    Scheduler::set_elastic(1, 0, 0);
+    done = 0;
+    wave(0);
+  });
+  check(done == burst * waves);
+  return 0;
+}
@@ -2,6 +2,7 @@
 // SPDX-License-Identifier: MIT
 #include "ext_ref_basic.h"
 #include "ext_ref_merge.h"
+#include "ext_ref_moving.h"
 
 int main(int argc, char** argv)
 {
@@ -10,6 +11,7 @@ int main(int argc, char** argv)
 
   ext_ref_basic::run_test();
   ext_ref_merge::run_test();
+  ext_ref_moving::run_test();
 
   return 0;
 }
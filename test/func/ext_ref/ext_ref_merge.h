@@ -41,8 +41,14 @@ namespace ext_ref_merge
 
     {
       UsingRegion ur(r1);
+      T* o2 = r2->f1;
       merge(r2);
       r1->f1->f1 = r2;
+
+      // Both references now belong to the merged region.
+      check(is_external_reference_valid(wref1));
+      check(is_external_reference_valid(wref2));
+      check(use_external_reference(wref2) == o2);
     }
 
     check(!r2->debug_is_iso());
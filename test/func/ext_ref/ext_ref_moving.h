@@ -0,0 +1,125 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#include <debug/harness.h>
+#include <verona.h>
+
+using namespace snmalloc;
+using namespace verona::rt;
+
+namespace ext_ref_moving
+{
+  // External references into a SemiSpace region must follow their objects
+  // when a collection or a growth of the spaces moves them, and be
+  // invalidated when their objects die.
+
+  struct Node : public V<Node>
+  {
+    size_t id;
+    Node* next = nullptr;
+
+    Node(size_t id) : id(id) {}
+
+    void trace(ObjectStack& st) const
+    {
+      if (next != nullptr)
+        st.push(next);
+    }
+  };
+
+  // Above the default large object threshold, so it is never moved.
+  struct Big : public V<Big>
+  {
+    size_t id;
+    uint8_t payload[600 * 1024];
+
+    Big(size_t id) : id(id) {}
+
+    void trace(ObjectStack&) const {}
+  };
+
+  struct Root : public V<Root>
+  {
+    Node* list = nullptr;
+    Big* big = nullptr;
+
+    void trace(ObjectStack& st) const
+    {
+      if (list != nullptr)
+        st.push(list);
+      if (big != nullptr)
+        st.push(big);
+    }
+  };
+
+  static constexpr size_t count = 200;
+
+  void check_refs(std::vector<ExternalRef*>& refs, bool odd_dead)
+  {
+    for (size_t i = 0; i < count; i++)
+    {
+      bool dead = odd_dead && (i % 2 == 1);
+      check(is_external_reference_valid(refs[i]) == !dead);
+      if (!dead)
+        check(((Node*)use_external_reference(refs[i]))->id == i);
+    }
+  }
+
+  void moving_test()
+  {
+    auto* r = new (RegionType::SemiSpace) Root;
+    std::vector<ExternalRef*> refs;
+    ExternalRef* root_ref;
+    ExternalRef* big_ref;
+    {
+      UsingRegion ur(r);
+      region_ensure_available(count * vsizeof<Node>);
+
+      // Build the list backwards, so that node i is the i-th from the root.
+      for (size_t i = count; i > 0; i--)
+      {
+        auto* n = new Node(i - 1);
+        n->next = r->list;
+        r->list = n;
+      }
+      for (Node* n = r->list; n != nullptr; n = n->next)
+        refs.push_back(create_external_reference(n));
+      r->big = new Big(count);
+      big_ref = create_external_reference(r->big);
+      root_ref = create_external_reference(r);
+
+      // Every node moves.
+      region_collect();
+      check_refs(refs, false);
+
+      // Unlink the odd nodes, which the next collection frees.
+      for (Node* n = r->list; n != nullptr && n->next != nullptr; n = n->next)
+        n->next = n->next->next;
+      region_collect();
+      check_refs(refs, true);
+
+      // Growing the spaces moves the survivors again.
+      region_ensure_available(4 * debug_semispace_size());
+      check_refs(refs, true);
+
+      check(use_external_reference(root_ref) == r);
+      check(use_external_reference(big_ref) == r->big);
+
+      // A large object that dies invalidates its reference too.
+      r->big = nullptr;
+      region_collect();
+      check(!is_external_reference_valid(big_ref));
+    }
+
+    for (auto* e : refs)
+      Immutable::release(e);
+    Immutable::release(root_ref);
+    Immutable::release(big_ref);
+    region_release(r);
+    heap::debug_check_empty();
+  }
+
+  void run_test()
+  {
+    moving_test();
+  }
+}
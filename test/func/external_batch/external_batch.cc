@@ -0,0 +1,74 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#include <debug/harness.h>
+
+// An external thread hands behaviours over in batches: behaviours on cowns
+// and without, scheduled in an ExternalBatch, which nests, and closures
+// given straight to Scheduler::schedule_external. Every one must run, once.
+
+static constexpr size_t per_cown = 100;
+static constexpr size_t closures = 50;
+
+std::atomic<size_t> ran_free{0};
+std::atomic<size_t> ran_closures{0};
+
+struct Counter : public VCown<Counter>
+{
+  size_t count = 0;
+
+  ~Counter()
+  {
+    check(count == per_cown);
+  }
+};
+
+void feed(Counter* a, Counter* b)
+{
+  {
+    Scheduler::ExternalBatch batch;
+    for (size_t i = 0; i < per_cown; i++)
+    {
+      schedule_lambda(a, [a]() { a->count++; });
+      schedule_lambda([]() { ran_free++; });
+
+      Scheduler::ExternalBatch inner;
+      schedule_lambda(b, [b]() { b->count++; });
+    }
+  }
+
+  std::vector<Work*> works;
+  for (size_t i = 0; i < closures; i++)
+    works.push_back(Closure::make([](Work*) {
+      ran_closures++;
+      return true;
+    }));
+  Scheduler::schedule_external(works.data(), works.size());
+
+  Cown::release(a);
+  Cown::release(b);
+
+  schedule_lambda([]() { Scheduler::remove_external_event_source(); });
+}
+
+void test(SystematicTestHarness* harness)
+{
+  ran_free = 0;
+  ran_closures = 0;
+
+  auto* a = new Counter;
+  auto* b = new Counter;
+  schedule_lambda([=]() {
+    Scheduler::add_external_event_source();
+    harness->external_thread([=]() { feed(a, b); });
+  });
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+
+  harness.run(test, &harness);
+  check(ran_free == per_cown);
+  check(ran_closures == closures);
+  return 0;
+}
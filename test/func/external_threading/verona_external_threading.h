@@ -10,6 +10,13 @@ namespace verona::rt
   class Topology
   {
   public:
+    enum class Placement
+    {
+      Scatter,
+      Compact,
+      Socket,
+    };
+
     Topology(){};
     Topology(const Topology&) = delete;
     Topology(Topology&&) = delete;
@@ -29,6 +36,35 @@ namespace verona::rt
     {
       return index;
     }
+
+    /**
+     * Orders the CPU IDs that get() returns.
+     */
+    void place(Placement, size_t = 0) {}
+
+    /**
+     * How many threads can run at once.
+     */
+    size_t available()
+    {
+      return 1;
+    }
+
+    /**
+     * Identifies the socket of the CPU get(index) returns.
+     */
+    size_t socket(size_t)
+    {
+      return 0;
+    }
+
+    /**
+     * Identifies the last-level cache of the CPU get(index) returns.
+     */
+    size_t cache(size_t)
+    {
+      return 0;
+    }
   };
 
   namespace cpu
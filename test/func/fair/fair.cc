@@ -6,7 +6,8 @@
 
 using namespace verona::cpp;
 // Work load that is designed to cause fairness to kick in
-// This does not check it is fair, just that it does not crash.
+// This does not check it is fair, just that it does not crash, with tokens,
+// with the fairness quanta, with direct handoff, and with a local ring.
 // Designed for systematic testing.
 
 static constexpr int start_count = 100;
@@ -43,9 +44,72 @@ void basic_test()
   };
 }
 
+// Behaviours on pairs of cowns, so that one release can make two
+// successors runnable, of which only one can be handed off.
+void pair_loop(cown_ptr<A> c1, cown_ptr<A> c2)
+{
+  when(c1, c2) << [c1, c2](auto a, auto) {
+    if (a->count == 0)
+      return;
+
+    a->count--;
+    pair_loop(c2, c1);
+  };
+}
+
+void pair_test()
+{
+  when() << []() {
+    auto c1 = make_cown<A>(0);
+    auto c2 = make_cown<A>(1);
+    auto c3 = make_cown<A>(2);
+    pair_loop(c1, c2);
+    pair_loop(c2, c3);
+    loop(c3);
+  };
+}
+
 int main(int argc, char** argv)
 {
   SystematicTestHarness harness(argc, argv);
   harness.run(basic_test);
+
+  Scheduler::set_fair_quantum(10, 0);
+  Scheduler::set_cown_quantum(3);
+  harness.run(basic_test);
+
+  Scheduler::set_fair_quantum(0, 100'000);
+  Scheduler::set_cown_quantum(1);
+  harness.run(basic_test);
+
+  Scheduler::set_fair_quantum(0, 0);
+  Scheduler::set_cown_quantum(0);
+
+  Scheduler::set_direct_handoff(true);
+  harness.run(basic_test);
+  harness.run(pair_test);
+
+  Scheduler::set_fair_quantum(10, 0);
+  Scheduler::set_cown_quantum(3);
+  harness.run(pair_test);
+
+  Scheduler::set_fair_quantum(0, 0);
+  Scheduler::set_cown_quantum(0);
+  Scheduler::set_direct_handoff(false);
+
+  // A ring smaller than the successors pair_test makes runnable, so that it
+  // overflows.
+  Scheduler::set_local_ring(2);
+  harness.run(basic_test);
+  harness.run(pair_test);
+
+  Scheduler::set_local_ring(16);
+  Scheduler::set_direct_handoff(true);
+  Scheduler::set_cown_quantum(3);
+  harness.run(pair_test);
+
+  Scheduler::set_cown_quantum(0);
+  Scheduler::set_direct_handoff(false);
+  Scheduler::set_local_ring(0);
   return 0;
 }
@@ -10,8 +10,9 @@ using namespace snmalloc;
 using namespace verona::rt;
 using namespace verona::rt::api;
 
-// This only tests trace regions.
-// At the moment, it does not make sense to freeze arena regions.
+// This mostly tests trace regions; test_semispace() and test_rc() freeze
+// the other regions that can be. At the moment, it does not make sense to
+// freeze arena regions.
 
 struct C1 : public V<C1>
 {
@@ -388,6 +389,223 @@ void test_contains_immutable1()
   heap::debug_check_empty();
 }
 
+void test_acyclic()
+{
+  // Freeze a diamond, declared acyclic.
+  // 1 -> 2, 3
+  // 2 -> 4
+  // 3 -> 4
+  // 5 is unreachable.
+  C1* o1 = new (RegionType::Trace) C1;
+  C1 *o2, *o3, *o4;
+  {
+    UsingRegion r(o1);
+
+    o2 = new C1;
+    o3 = new C1;
+    o4 = new C1;
+    new C1;
+
+    o1->f1 = o2;
+    o1->f2 = o3;
+    o2->f1 = o4;
+    o3->f1 = o4;
+  }
+
+  freeze(o1, FreezeShape::Acyclic);
+
+  check(o1->debug_immutable_root() == o1);
+  check(o2->debug_immutable_root() == o2);
+  check(o3->debug_immutable_root() == o3);
+  check(o4->debug_immutable_root() == o4);
+  check(o1->debug_test_rc(1));
+  check(o2->debug_test_rc(1));
+  check(o3->debug_test_rc(1));
+  check(o4->debug_test_rc(2));
+
+  Immutable::release(o1);
+  heap::debug_check_empty();
+}
+
+void test_compact()
+{
+  // 1 -> 2, 4
+  // 2 -> 3
+  // 3 -> 1
+  // 4 is a subregion.
+  // 5 is unreachable.
+  C1* o1 = new (RegionType::Trace) C1;
+  {
+    UsingRegion r(o1);
+
+    o1->f1 = new C1;
+    o1->f1->f1 = new C1;
+    o1->f1->f1->f1 = o1;
+    o1->f2 = new (RegionType::Trace) C1;
+    new C1;
+  }
+
+  C1* n1 = freeze_compact(o1);
+  C1* n2 = n1->f1;
+  C1* n3 = n2->f1;
+
+  // The copies are laid out in depth-first order, as one SCC.
+  check(n3->f1 == n1);
+  check((std::byte*)n1 < (std::byte*)n2);
+  check((std::byte*)n2 < (std::byte*)n3);
+  check(n1->debug_immutable_root() == n1);
+  check(n2->debug_immutable_root() == n1);
+  check(n3->debug_immutable_root() == n1);
+  check(n1->debug_test_rc(1));
+
+  // The subregion is frozen in place.
+  check(n1->f2->debug_immutable_root() == n1->f2);
+  check(n1->f2->debug_test_rc(1));
+
+  Immutable::release(n1);
+  heap::debug_check_empty();
+}
+
+void test_deferred_release()
+{
+  // A chain long enough to take several chunks to tear down.
+  C1* o = new (RegionType::Trace) C1;
+  {
+    UsingRegion r(o);
+    C1* tail = o;
+    for (size_t i = 0; i < 3 * Immutable::RECLAIM_CHUNK; i++)
+    {
+      tail->f1 = new C1;
+      tail = tail->f1;
+    }
+  }
+
+  freeze(o);
+
+  Immutable::set_deferred_release(true);
+  check(Immutable::release(o) == 0);
+
+  size_t chunks = 0;
+  while (Immutable::reclaim_deferred())
+    chunks++;
+  check(chunks > 1);
+  check(!Immutable::reclaim_deferred());
+  Immutable::set_deferred_release(false);
+
+  heap::debug_check_empty();
+}
+
+template<size_t N>
+struct Sized : public V<Sized<N>>
+{
+  Object* f1 = nullptr;
+  Object* f2 = nullptr;
+  uint8_t data[N];
+
+  void trace(ObjectStack& st) const
+  {
+    if (f1 != nullptr)
+      st.push(f1);
+
+    if (f2 != nullptr)
+      st.push(f2);
+  }
+};
+
+using Small = Sized<16>;
+using Large = Sized<600 * 1024>;
+
+void test_semispace()
+{
+  // 1 -> 2, 3
+  // 2 -> 1
+  // 3 is large, and 3 -> 4, 5
+  // 5 is a subregion.
+  // A small and a large object are unreachable.
+  Small* o1 = new (RegionType::SemiSpace) Small;
+  Small* o2;
+  Large* o3;
+  C1* o5 = new (RegionType::Trace) C1;
+  {
+    UsingRegion r(o1);
+
+    o2 = new Small;
+    o3 = new Large;
+    o1->f1 = o2;
+    o1->f2 = o3;
+    o2->f1 = o1;
+    o3->f1 = new Small;
+    o3->f2 = o5;
+    new Small;
+    new Large;
+  }
+
+  freeze(o1);
+
+  // The root stays put, and the rest move out of the region.
+  auto* n2 = (Small*)o1->f1;
+  auto* n3 = (Large*)o1->f2;
+  check(n2 != o2);
+  check(n3 != o3);
+  check(n2->f1 == o1);
+  check(n2->debug_immutable_root() == o1->debug_immutable_root());
+  check(n3->debug_immutable_root() == n3);
+  check(n3->debug_test_rc(1));
+  check(n3->f1->debug_test_rc(1));
+  check(n3->f2 == o5);
+  check(o5->debug_immutable_root() == o5);
+
+  Immutable::release(o1);
+  heap::debug_check_empty();
+}
+
+void test_rc()
+{
+  // 1 -> 2, 4
+  // 2 -> 3
+  // 3 -> 2
+  // 4 is immutable already.
+  // A cycle dropped from 1 is left for the freeze to collect.
+  C1* o4 = new (RegionType::Trace) C1;
+  freeze(o4);
+
+  C1* o1 = new (RegionType::Rc) C1;
+  C1 *o2, *o3;
+  {
+    UsingRegion r(o1);
+
+    o2 = new C1;
+    o3 = new C1;
+    o1->f1 = o2;
+    o2->f1 = o3;
+    o3->f1 = o2;
+    incref(o2);
+
+    auto* g1 = new C1;
+    auto* g2 = new C1;
+    o1->f2 = g1;
+    g1->f1 = g2;
+    g2->f1 = g1;
+    incref(g1);
+    o1->f2 = nullptr;
+    decref(g1);
+    check(debug_size() == 5);
+
+    // The reference from freezing 4 passes to the field.
+    o1->f2 = o4;
+  }
+
+  freeze(o1);
+
+  check(o1->debug_immutable_root() == o1);
+  check(o2->debug_immutable_root() == o3->debug_immutable_root());
+  check(o2->debug_immutable_root()->debug_test_rc(1));
+  check(o4->debug_test_rc(1));
+
+  Immutable::release(o1);
+  heap::debug_check_empty();
+}
+
 void test_random(size_t seed = 1, size_t max_edges = 128)
 {
   heap::debug_check_empty();
@@ -542,6 +760,11 @@ int main(int, char**)
   test_two_rings_2();
   freeze_weird_ring();
   test_contains_immutable1();
+  test_acyclic();
+  test_compact();
+  test_deferred_release();
+  test_semispace();
+  test_rc();
 
   for (size_t i = 1; i < 10000; i++)
   {
@@ -0,0 +1,98 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#include <cpp/when.h>
+#include <debug/harness.h>
+
+using namespace verona::cpp;
+
+// Schedules runs of when_batched closures on a cown, interleaved with
+// plain whens, or with behaviours scheduled through the runtime's
+// schedule_lambda, on the same cown, and checks that every closure runs
+// once, in the order it was scheduled in.
+
+static constexpr size_t rounds = 20;
+static constexpr size_t run = 5;
+
+struct Log
+{
+  size_t next = 0;
+
+  ~Log()
+  {
+    check(next == rounds * (run + 1));
+  }
+};
+
+void step(acquired_cown<Log>& log, size_t expected)
+{
+  check(log->next == expected);
+  log->next++;
+}
+
+void schedule_all(cown_ptr<Log> c)
+{
+  size_t i = 0;
+  for (size_t r = 0; r < rounds; r++)
+  {
+    for (size_t j = 0; j < run; j++, i++)
+      when_batched(c) << [i](acquired_cown<Log> log) { step(log, i); };
+
+    when(c) << [i](acquired_cown<Log> log) { step(log, i); };
+    i++;
+  }
+}
+
+// Closures on `mixed` count here, as a schedule_lambda behaviour is not
+// handed the cown's Log. Only behaviours on `mixed` touch it.
+static size_t mixed_next = 0;
+
+struct Mixed
+{
+  ~Mixed()
+  {
+    check(mixed_next == rounds * (run + 1));
+  }
+};
+
+void mixed_step(size_t expected)
+{
+  check(mixed_next == expected);
+  mixed_next++;
+}
+
+void schedule_mixed(cown_ptr<Mixed> c)
+{
+  size_t i = 0;
+  for (size_t r = 0; r < rounds; r++)
+  {
+    for (size_t j = 0; j < run; j++, i++)
+      when_batched(c) << [i](acquired_cown<Mixed>) { mixed_step(i); };
+
+    verona::rt::schedule_lambda(c.underlying_cown(), [i]() { mixed_step(i); });
+    i++;
+  }
+}
+
+void basic_test()
+{
+  auto c = make_cown<Log>();
+  when() << [c]() { schedule_all(c); };
+
+  // Outside a behaviour.
+  schedule_all(make_cown<Log>());
+}
+
+void mixed_test()
+{
+  mixed_next = 0;
+  auto c = make_cown<Mixed>();
+  when() << [c]() { schedule_mixed(c); };
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+  harness.run(basic_test);
+  harness.run(mixed_test);
+  return 0;
+}
@@ -0,0 +1,74 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+#include <debug/harness.h>
+
+// Many cowns each leave garbage in their region, defer the collection on
+// close and queue it with the GC pacer of the thread they run on, all in
+// the same burst. Nothing else runs on the cowns, so only the paced
+// collections can have removed the garbage by the time they are collected.
+
+struct Node : public V<Node>
+{
+  Node* next = nullptr;
+
+  void trace(ObjectStack& st) const
+  {
+    if (next != nullptr)
+      st.push(next);
+  }
+};
+
+static constexpr size_t owners = 50;
+
+struct Owner : public VCown<Owner>
+{
+  Node* region;
+
+  Owner() : region(new (RegionType::Trace) Node)
+  {
+    region_set_gc_policy(region, GCPolicy::always().on_close());
+  }
+
+  void trace(ObjectStack& st) const
+  {
+    st.push(region);
+  }
+
+  void finaliser(Object*, ObjectStack&)
+  {
+    check(RegionTrace::get(region)->get_region_size() == 2);
+  }
+};
+
+void test_gc_pacer()
+{
+  GCPacer::set_budget(5);
+
+  for (size_t i = 0; i < owners; i++)
+  {
+    auto* owner = new Owner;
+
+    // Owner i leaves i objects of garbage, so the requests differ in the
+    // bytes they are expected to reclaim.
+    schedule_lambda<YesTransfer>(owner, [owner, i]() {
+      {
+        UsingRegion rr(owner->region, CloseGC::Defer);
+        owner->region->next = new Node;
+        for (size_t j = 0; j < i; j++)
+          new Node;
+      }
+
+      schedule_paced_collect(owner, owner->region);
+      // A second request while the first is waiting is dropped.
+      schedule_paced_collect(owner, owner->region);
+    });
+  }
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+  harness.run(test_gc_pacer);
+  return 0;
+}
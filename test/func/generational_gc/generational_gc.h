@@ -0,0 +1,278 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "../memory/memory.h"
+
+namespace generational_gc
+{
+  /**
+   * As in a SemiSpace region, the iso (root) object of a Generational
+   * region is pinned, but nursery objects move on every collection until
+   * they are promoted. C++ local pointers to non-root objects become stale
+   * after region_collect(); navigate from the root instead.
+   */
+
+  // Larger than PRETENURE_THRESHOLD, so always allocated in the old
+  // generation.
+  static constexpr size_t BIG_BODY = 64 * 1024;
+  struct Big : public V<Big>
+  {
+    C1* child = nullptr;
+    Big* next = nullptr;
+    uint8_t payload[BIG_BODY];
+
+    void trace(ObjectStack& st) const
+    {
+      if (child != nullptr)
+        st.push(child);
+      if (next != nullptr)
+        st.push(next);
+    }
+
+    void relocate(Object* (*fwd)(Object*))
+    {
+      if (child != nullptr)
+        child = (C1*)fwd(child);
+      if (next != nullptr)
+        next = (Big*)fwd(next);
+    }
+  };
+
+  struct BigRoot : public V<BigRoot>
+  {
+    Big* big = nullptr;
+
+    void trace(ObjectStack& st) const
+    {
+      if (big != nullptr)
+        st.push(big);
+    }
+
+    void relocate(Object* (*fwd)(Object*))
+    {
+      if (big != nullptr)
+        big = (Big*)fwd(big);
+    }
+  };
+
+  /**
+   * Test 1: A minor collection keeps what the root reaches and drops the
+   * rest of the nursery.
+   */
+  void test_minor_gc()
+  {
+    auto* root = new (RegionType::Generational) C1;
+
+    {
+      UsingRegion rr(root);
+
+      auto* a = new C1;
+      auto* b = new C1;
+      new C1;
+      new C1;
+      root->f1 = a;
+      a->f2 = b;
+      check(debug_size() == 5);
+
+      region_collect();
+      check(debug_size() == 3);
+      check(debug_old_object_count() == 0);
+      check(debug_nursery_used() == 2 * vsizeof<C1>);
+      check(root->f1 != nullptr && root->f1->f2 != nullptr);
+    }
+
+    region_release(root);
+    heap::debug_check_empty();
+  }
+
+  /**
+   * Test 2: Nursery objects are promoted once they have survived the
+   * promotion age, and stay reachable from young objects allocated later.
+   */
+  void test_promotion()
+  {
+    RegionGenerational::set_promotion_age(2);
+    auto* root = new (RegionType::Generational) C1;
+
+    {
+      UsingRegion rr(root);
+
+      root->f1 = new C1;
+
+      region_collect();
+      check(debug_old_object_count() == 0);
+
+      region_collect();
+      check(debug_old_object_count() == 1);
+      check(debug_nursery_used() == 0);
+
+      // Promoted objects no longer move.
+      C1* old = root->f1;
+      region_collect();
+      check(root->f1 == old);
+
+      // An old-to-young pointer keeps the young object alive.
+      old->f1 = new C1;
+      new C1;
+      region_collect();
+      check(debug_size() == 3);
+      check(root->f1->f1 != nullptr);
+      check(debug_old_object_count() == 1);
+    }
+
+    region_release(root);
+    RegionGenerational::set_promotion_age(
+      RegionGenerational::DEFAULT_PROMOTION_AGE);
+    heap::debug_check_empty();
+  }
+
+  /**
+   * Test 3: Large objects, and objects allocated once the nursery is full,
+   * go straight to the old generation. Allocation never moves anything.
+   */
+  void test_pretenuring()
+  {
+    auto* root = new (RegionType::Generational) C1;
+
+    {
+      UsingRegion rr(root);
+
+      // Garbage from the start, but never reclaimed by a minor collection.
+      new Big;
+      check(debug_old_object_count() == 1);
+      check(debug_nursery_used() == 0);
+
+      // Fill the nursery and overflow it by three objects.
+      size_t per_nursery = RegionGenerational::NURSERY_SIZE / vsizeof<C1>;
+      C1* first = new C1;
+      C1* prev = first;
+      for (size_t i = 1; i < per_nursery + 3; i++)
+      {
+        auto* n = new C1;
+        prev->f1 = n;
+        prev = n;
+      }
+      check(debug_old_object_count() == 4);
+      check(debug_size() == per_nursery + 5);
+
+      root->f1 = first;
+      region_collect();
+      check(debug_size() == per_nursery + 5);
+      check(debug_old_object_count() == 4);
+
+      size_t len = 0;
+      for (C1* p = root->f1; p != nullptr; p = p->f1)
+        len++;
+      check(len == per_nursery + 3);
+    }
+
+    region_release(root);
+    heap::debug_check_empty();
+  }
+
+  /**
+   * Test 4: Non-trivial objects are finalised and destructed exactly once,
+   * whether they die young, die old or are released.
+   */
+  void test_finalisation()
+  {
+    RegionGenerational::set_promotion_age(1);
+    live_count = 0;
+    auto* root = new (RegionType::Generational) F1;
+
+    {
+      UsingRegion rr(root);
+
+      root->f1 = new F1;
+      new F1;
+      new C1;
+      check(live_count == 3);
+
+      // The young garbage dies; root->f1 is promoted.
+      region_collect();
+      check(live_count == 2);
+      check(debug_old_object_count() == 1);
+
+      root->f1->f1 = new F1;
+      check(live_count == 3);
+    }
+
+    region_release(root);
+    check(live_count == 0);
+    RegionGenerational::set_promotion_age(
+      RegionGenerational::DEFAULT_PROMOTION_AGE);
+    heap::debug_check_empty();
+  }
+
+  /**
+   * Test 5: Once the old generation passes the major threshold, a
+   * collection promotes the whole nursery and sweeps the old generation.
+   */
+  void test_major_gc()
+  {
+    auto* root = new (RegionType::Generational) BigRoot;
+
+    {
+      UsingRegion rr(root);
+
+      size_t count =
+        RegionGenerational::INITIAL_MAJOR_THRESHOLD / vsizeof<Big> + 2;
+      for (size_t i = 0; i < count; i++)
+      {
+        auto* b = new Big;
+        b->next = root->big;
+        b->child = new C1;
+        root->big = b;
+      }
+      check(debug_old_object_count() == count);
+
+      // Keep two of them; one still points into the nursery.
+      root->big->next->next = nullptr;
+      region_collect();
+      check(debug_old_object_count() == 4);
+      check(debug_nursery_used() == 0);
+      check(debug_size() == 5);
+      check(root->big->child != nullptr && root->big->next->child != nullptr);
+
+      // The threshold has been reset, so this collection is minor again.
+      root->big->child = nullptr;
+      region_collect();
+      check(debug_old_object_count() == 4);
+    }
+
+    region_release(root);
+    heap::debug_check_empty();
+  }
+
+  // ---------------------------------------------------------------------------
+  // Test runner
+  // ---------------------------------------------------------------------------
+
+  void run_test()
+  {
+    std::cout << "=== Generational GC Tests ===" << std::endl;
+
+    std::cout << "Test 1: Minor GC..." << std::endl;
+    test_minor_gc();
+    std::cout << "  PASSED" << std::endl;
+
+    std::cout << "Test 2: Promotion..." << std::endl;
+    test_promotion();
+    std::cout << "  PASSED" << std::endl;
+
+    std::cout << "Test 3: Pretenuring..." << std::endl;
+    test_pretenuring();
+    std::cout << "  PASSED" << std::endl;
+
+    std::cout << "Test 4: Finalisation..." << std::endl;
+    test_finalisation();
+    std::cout << "  PASSED" << std::endl;
+
+    std::cout << "Test 5: Major GC..." << std::endl;
+    test_major_gc();
+    std::cout << "  PASSED" << std::endl;
+
+    std::cout << "=== All Generational GC tests passed ===" << std::endl;
+  }
+}
@@ -154,6 +154,70 @@ bool test(size_t seed)
   return true;
 }
 
+/**
+ * Sweep a large map down to a few entries, which shrinks it, and then erase
+ * while iterating, which shifts entries into the erased slots.
+ */
+bool test_sweep(size_t seed)
+{
+  ObjectMap<Key*> map;
+  std::unordered_map<Key*, int32_t> model;
+  verona::rt::PRNG<> rng{seed};
+  std::stringstream err;
+
+  static constexpr size_t entries = 1000;
+  for (size_t i = 0; i < entries; i++)
+  {
+    auto* key = new Key();
+    map.insert(key);
+    model.insert(std::make_pair(key, (int32_t)i));
+  }
+  size_t capacity = map.capacity();
+
+  // Keep about one entry in sixteen.
+  for (auto it = map.begin(); it != map.end(); ++it)
+  {
+    if (rng.next(16) == 0)
+      it.mark();
+  }
+  map.sweep([&model](Key* key) {
+    model.erase(key);
+    Cown::release(key);
+  });
+  if (!model_check(map, model, err) || (map.capacity() >= capacity))
+  {
+    std::cout << err.str() << "not shrunk: " << map.capacity() << std::endl;
+    return false;
+  }
+
+  // Erase every other entry while iterating; each is still visited once.
+  size_t visited = 0;
+  bool erase = false;
+  for (auto it = map.begin(); it != map.end(); ++it)
+  {
+    visited++;
+    erase = !erase;
+    if (erase)
+    {
+      Key* key = it.key();
+      map.erase(it);
+      model.erase(key);
+      Cown::release(key);
+    }
+  }
+  if (!model_check(map, model, err) || (visited != map.size() * 2 + erase))
+  {
+    std::cout << err.str() << "visited " << visited << std::endl;
+    return false;
+  }
+
+  map.clear();
+  for (auto e : model)
+    Cown::release(e.first);
+
+  return true;
+}
+
 int main(int argc, char** argv)
 {
   // Use harness for consistent API to seeds for randomness.
@@ -162,7 +226,7 @@ int main(int argc, char** argv)
   for (size_t seed = harness.seed_lower; seed <= harness.seed_upper; seed++)
   {
     std::cout << "seed: " << seed << std::endl;
-    if (!test(seed))
+    if (!test(seed) || !test_sweep(seed))
       return 1;
 
     debug_check_empty<snmalloc::Alloc::Config>();
@@ -0,0 +1,152 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+#include <debug/harness.h>
+#include <sstream>
+#include <verona.h>
+
+using namespace snmalloc;
+using namespace verona::rt;
+using namespace verona::rt::api;
+
+// The heap profile counts exactly the objects of each type that a
+// collection finds alive, for the region types that mark or copy, and
+// nothing while it is off.
+
+struct B : public V<B>
+{
+  size_t payload[8] = {};
+};
+
+struct A : public V<A>
+{
+  A* next = nullptr;
+  B* b = nullptr;
+
+  void trace(ObjectStack& st) const
+  {
+    if (next != nullptr)
+      st.push(next);
+    if (b != nullptr)
+      st.push(b);
+  }
+
+  void relocate(Object* (*fwd)(Object*))
+  {
+    if (next != nullptr)
+      next = (A*)fwd(next);
+    if (b != nullptr)
+      b = (B*)fwd(b);
+  }
+};
+
+// The entry point, of a type of its own, as it is not counted.
+struct Root : public V<Root>
+{
+  A* first = nullptr;
+
+  void trace(ObjectStack& st) const
+  {
+    if (first != nullptr)
+      st.push(first);
+  }
+
+  void relocate(Object* (*fwd)(Object*))
+  {
+    if (first != nullptr)
+      first = (A*)fwd(first);
+  }
+};
+
+static constexpr size_t NODES = 100;
+
+const HeapProfile::Row* find(
+  const std::vector<HeapProfile::Row>& rows, const std::string& name)
+{
+  for (auto& r : rows)
+  {
+    if (r.name == name)
+      return &r;
+  }
+  return nullptr;
+}
+
+template<RegionType type>
+void test_profile(bool enabled)
+{
+  HeapProfile::reset();
+  HeapProfile::set_enabled(enabled);
+
+  auto* r = new (type) Root;
+  {
+    UsingRegion rr(r);
+    A** last = &r->first;
+    for (size_t i = 0; i < NODES; i++)
+    {
+      *last = new A;
+      // Every other A keeps its B alive, and the rest are garbage.
+      B* b = new B;
+      if (i % 2 == 0)
+        (*last)->b = b;
+      last = &(*last)->next;
+    }
+    region_collect();
+  }
+  region_release(r);
+  HeapProfile::set_enabled(false);
+
+  auto rows = HeapProfile::rows();
+  if (!enabled)
+  {
+    check(rows.empty());
+    check(HeapProfile::get_collections() == 0);
+    return;
+  }
+
+  check(HeapProfile::get_collections() == 1);
+  const HeapProfile::Row* a = find(rows, "A");
+  const HeapProfile::Row* b = find(rows, "B");
+  check(a != nullptr && b != nullptr);
+  check(a->objects == NODES);
+  check(b->objects == NODES / 2);
+  check(b->bytes == b->objects * vsizeof<B>);
+  check(b->size == vsizeof<B>);
+  check(find(rows, "Root") == nullptr);
+}
+
+void test_dump()
+{
+  HeapProfile::reset();
+  HeapProfile::set_enabled(true);
+  auto* r = new (RegionType::Trace) Root;
+  {
+    UsingRegion rr(r);
+    r->first = new A;
+    region_collect();
+  }
+  region_release(r);
+  HeapProfile::set_enabled(false);
+
+  std::stringstream out;
+  HeapProfile::dump(out);
+  check(out.str().find("Heap profile (1 types, 1 collections)") == 0);
+  check(out.str().find("100.0%") != std::string::npos);
+  HeapProfile::reset();
+}
+
+int main(int argc, char** argv)
+{
+  UNUSED(argc);
+  UNUSED(argv);
+
+  for (bool enabled : {false, true})
+  {
+    test_profile<RegionType::Trace>(enabled);
+    test_profile<RegionType::SemiSpace>(enabled);
+    test_profile<RegionType::Compact>(enabled);
+  }
+  test_dump();
+
+  heap::debug_check_empty();
+  return 0;
+}
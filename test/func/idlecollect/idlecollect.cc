@@ -0,0 +1,68 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+#include <debug/harness.h>
+
+// A cown leaves garbage in its region, defers the collection on close and
+// hands it to the idle threads. Nothing else runs on the cown, so only the
+// idle collection can have removed the garbage by the time it is
+// collected.
+
+struct Node : public V<Node>
+{
+  Node* next = nullptr;
+
+  void trace(ObjectStack& st) const
+  {
+    if (next != nullptr)
+      st.push(next);
+  }
+};
+
+static constexpr size_t garbage = 10;
+
+struct Owner : public VCown<Owner>
+{
+  Node* region;
+
+  Owner() : region(new (RegionType::Trace) Node)
+  {
+    region_set_gc_policy(region, GCPolicy::always().on_close());
+  }
+
+  void trace(ObjectStack& st) const
+  {
+    st.push(region);
+  }
+
+  void finaliser(Object*, ObjectStack&)
+  {
+    check(RegionTrace::get(region)->get_region_size() == 2);
+  }
+};
+
+void test_idle_collect()
+{
+  auto* owner = new Owner;
+
+  schedule_lambda<YesTransfer>(owner, [owner]() {
+    {
+      UsingRegion rr(owner->region, CloseGC::Defer);
+      owner->region->next = new Node;
+      for (size_t i = 0; i < garbage; i++)
+        new Node;
+    }
+    check(RegionTrace::get(owner->region)->get_region_size() == garbage + 2);
+
+    schedule_idle_collect(owner, owner->region);
+    // A second request while the first is waiting is dropped.
+    schedule_idle_collect(owner, owner->region);
+  });
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+  harness.run(test_idle_collect);
+  return 0;
+}
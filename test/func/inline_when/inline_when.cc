@@ -0,0 +1,103 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#include <cpp/when.h>
+#include <debug/harness.h>
+
+using namespace verona::cpp;
+
+// Checks that when_inline runs a closure at once on an idle cown, that
+// closures from one sender run in the order they were sent whether they ran
+// inline or were scheduled, also with readers about, and that deep nesting
+// falls back to scheduling.
+
+static constexpr size_t senders = 3;
+static constexpr size_t rounds = 20;
+
+struct Log
+{
+  size_t next[senders] = {};
+
+  ~Log()
+  {
+    for (size_t s = 0; s < senders; s++)
+      check(next[s] == rounds * 2);
+  }
+};
+
+struct Sender
+{};
+
+void step(acquired_cown<Log>& log, size_t s, size_t expected)
+{
+  check(log->next[s] == expected);
+  log->next[s]++;
+}
+
+void idle_test()
+{
+  when() << []() {
+    auto c = make_cown<Log>();
+    bool ran = false;
+    when_inline(c) << [&ran](acquired_cown<Log> log) {
+      for (size_t s = 0; s < senders; s++)
+        log->next[s] = rounds * 2;
+      ran = true;
+    };
+    check(ran);
+  };
+}
+
+void order_test()
+{
+  auto c = make_cown<Log>();
+  for (size_t s = 0; s < senders; s++)
+  {
+    when(make_cown<Sender>()) << [c, s](acquired_cown<Sender>) mutable {
+      for (size_t i = 0; i < rounds * 2; i += 2)
+      {
+        when(read(c)) << [](acquired_cown<const Log>) {};
+        when_inline(c) << [s, i](acquired_cown<Log> log) { step(log, s, i); };
+        when(c) << [s, i](acquired_cown<Log> log) { step(log, s, i + 1); };
+      }
+    };
+  }
+}
+
+static constexpr size_t depth = 3 * InlineWhen<Sender>::MAX_DEPTH;
+
+struct Total
+{
+  size_t n = 0;
+
+  ~Total()
+  {
+    check(n == depth);
+  }
+};
+
+void nest(cown_ptr<Total> total, size_t remaining)
+{
+  if (remaining == 0)
+    return;
+
+  auto c = make_cown<Sender>();
+  when_inline(c) << [total, remaining](acquired_cown<Sender>) mutable {
+    when(total) << [](acquired_cown<Total> t) { t->n++; };
+    nest(total, remaining - 1);
+  };
+}
+
+void nesting_test()
+{
+  auto total = make_cown<Total>();
+  when() << [total]() { nest(total, depth); };
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+  harness.run(idle_test);
+  harness.run(order_test);
+  harness.run(nesting_test);
+  return 0;
+}
@@ -0,0 +1,170 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#include "debug/harness.h"
+
+#include <verona.h>
+
+using namespace snmalloc;
+using namespace verona::rt;
+using namespace verona::rt::api;
+
+// Freezes trees in which every subtree of a depth is the same, and checks
+// that interning leaves one object for each depth, shared between the
+// trees, and that releasing them empties the table.
+
+struct Node : public V<Node>
+{
+  Node* left = nullptr;
+  Node* right = nullptr;
+  size_t value = 0;
+
+  void trace(ObjectStack& st) const
+  {
+    if (left != nullptr)
+      st.push(left);
+
+    if (right != nullptr)
+      st.push(right);
+  }
+
+  void relocate(Object* (*forward)(Object*))
+  {
+    if (left != nullptr)
+      left = (Node*)forward(left);
+
+    if (right != nullptr)
+      right = (Node*)forward(right);
+  }
+
+  size_t intern_hash() const
+  {
+    return value ^ ((uintptr_t)left * 31) ^ ((uintptr_t)right * 17);
+  }
+
+  bool intern_equals(const Node& that) const
+  {
+    return value == that.value && left == that.left && right == that.right;
+  }
+};
+
+// Not internable, as it defines neither function.
+struct Plain : public V<Plain>
+{
+  Node* node = nullptr;
+
+  void trace(ObjectStack& st) const
+  {
+    if (node != nullptr)
+      st.push(node);
+  }
+};
+
+static Node* build(Node* n, size_t depth)
+{
+  n->value = depth;
+  if (depth > 1)
+  {
+    n->left = build(new Node, depth - 1);
+    n->right = build(new Node, depth - 1);
+  }
+  return n;
+}
+
+static Node* tree(size_t depth)
+{
+  Node* root = new (RegionType::Trace) Node;
+  UsingRegion r(root);
+  return build(root, depth);
+}
+
+void test_tree()
+{
+  size_t depth = 6;
+  size_t size = InternTable::size();
+  size_t hits = InternTable::hits();
+
+  Node* a = freeze_interned(tree(depth));
+  check(InternTable::size() == size + depth);
+  // All but the first of the 2^depth - 1 nodes of each depth are found.
+  check(InternTable::hits() == hits + ((size_t)1 << depth) - 1 - depth);
+
+  for (Node* n = a; n->left != nullptr; n = n->left)
+  {
+    check(n->debug_is_interned());
+    check(n->left == n->right);
+  }
+
+  Node* b = freeze_interned(tree(depth));
+  check(b == a);
+  check(InternTable::size() == size + depth);
+
+  Immutable::release(a);
+  check(InternTable::size() == size + depth);
+  Immutable::release(b);
+  check(InternTable::size() == size);
+
+  heap::debug_check_empty();
+}
+
+void test_cycle()
+{
+  // A cycle is an SCC of more than one object, which is not interned, but
+  // the subtrees it refers to are.
+  size_t size = InternTable::size();
+  Node* root = new (RegionType::Trace) Node;
+  {
+    UsingRegion r(root);
+    Node* n = new Node;
+    n->left = root;
+    n->right = build(new Node, 3);
+    root->left = n;
+    root->right = build(new Node, 3);
+  }
+
+  root = freeze_interned(root);
+  check(!root->debug_is_interned());
+  check(!root->left->debug_is_interned());
+  check(root->right == root->left->right);
+  check(root->right->debug_is_interned());
+  check(InternTable::size() == size + 3);
+
+  Immutable::release(root);
+  check(InternTable::size() == size);
+
+  heap::debug_check_empty();
+}
+
+void test_plain()
+{
+  // Objects that cannot be interned keep the interned objects they refer
+  // to alive.
+  size_t size = InternTable::size();
+  Plain* root = new (RegionType::Trace) Plain;
+  {
+    UsingRegion r(root);
+    root->node = build(new Node, 2);
+  }
+
+  root = freeze_interned(root);
+  check(!root->debug_is_interned());
+  check(root->node->left == root->node->right);
+  check(InternTable::size() == size + 2);
+
+  Node* other = freeze_interned(tree(2));
+  check(other == root->node);
+
+  Immutable::release(root);
+  check(InternTable::size() == size + 2);
+  Immutable::release(other);
+  check(InternTable::size() == size);
+
+  heap::debug_check_empty();
+}
+
+int main(int, char**)
+{
+  test_tree();
+  test_cycle();
+  test_plain();
+  return 0;
+}
@@ -1,6 +1,7 @@
 // Copyright Microsoft and Project Verona Contributors.
 // SPDX-License-Identifier: MIT
 
+#include <array>
 #include <debug/harness.h>
 
 using namespace std;
@@ -50,6 +51,48 @@ void lambda_cown()
   Cown::release(c);
 }
 
+// Captures more than Behaviour::INLINE_BODY bytes, so is boxed.
+struct Large
+{
+  std::array<size_t, 2 * Behaviour::INLINE_BODY / sizeof(size_t)> data;
+  std::unique_ptr<A> a;
+
+  Large(int v) : a(make_unique<A>(v))
+  {
+    for (size_t i = 0; i < data.size(); i++)
+      data[i] = i;
+  }
+
+  void check_data() const
+  {
+    for (size_t i = 0; i < data.size(); i++)
+      check(data[i] == i);
+  }
+};
+
+void lambda_large()
+{
+  auto f = [l = Large(42)]() {
+    l.check_data();
+    std::cout << "Large " << l.a->v << std::endl;
+  };
+  static_assert(!Behaviour::is_inline<decltype(f)>());
+  schedule_lambda(std::move(f));
+}
+
+void lambda_large_cown()
+{
+  TestCown* c = new TestCown;
+  auto f = [l = Large(43)]() { l.check_data(); };
+  static_assert(!Behaviour::is_inline<decltype(f)>());
+  schedule_lambda(c, std::move(f));
+
+  auto g = []() {};
+  static_assert(Behaviour::is_inline<decltype(g)>());
+  schedule_lambda(c, std::move(g));
+  Cown::release(c);
+}
+
 int main(int argc, char** argv)
 {
   SystematicTestHarness harness(argc, argv);
@@ -58,6 +101,8 @@ int main(int argc, char** argv)
   harness.run(lambda_cown);
   harness.run(lambda_args);
   harness.run(lambda_smart);
+  harness.run(lambda_large);
+  harness.run(lambda_large_cown);
 
   return 0;
 }
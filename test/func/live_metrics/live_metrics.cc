@@ -0,0 +1,85 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+#include <cstdio>
+#include <debug/harness.h>
+
+// Cowns each fill a region with garbage and collect it, with a metrics
+// segment open. Reading the segment back through its file, as an agent
+// outside the process would, must show the work and the collections.
+
+struct Node : public V<Node>
+{
+  Node* next = nullptr;
+
+  void trace(ObjectStack& st) const
+  {
+    if (next != nullptr)
+      st.push(next);
+  }
+};
+
+static constexpr size_t cowns = 10;
+static constexpr size_t garbage = 100;
+static constexpr const char* path = "live_metrics_test.bin";
+
+struct Owner : public VCown<Owner>
+{
+  Node* region = new (RegionType::Trace) Node;
+
+  void trace(ObjectStack& st) const
+  {
+    st.push(region);
+  }
+};
+
+void test_live_metrics()
+{
+  for (size_t i = 0; i < cowns; i++)
+  {
+    auto* owner = new Owner;
+    schedule_lambda<YesTransfer>(owner, [owner]() {
+      UsingRegion rr(owner->region);
+      for (size_t j = 0; j < garbage; j++)
+        new Node;
+      region_collect();
+    });
+  }
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+
+  check(LiveMetrics::open(path));
+  // Only one segment is open at a time.
+  check(!LiveMetrics::open(path));
+  harness.run(test_live_metrics);
+
+  {
+    LiveMetrics::Reader reader(path);
+    check(reader.is_valid());
+
+    LiveMetrics::Totals t = reader.read();
+    size_t trace = (size_t)RegionType::Trace;
+    check(t.overflow == 0);
+    check(t.counters[LiveMetrics::Run] >= cowns);
+    check(t.counters[LiveMetrics::Scheduled] >= cowns);
+    check(t.collections[trace] >= cowns);
+    check(t.allocated[trace] >= cowns * garbage * vsizeof<Node>);
+    check(t.freed[trace] >= cowns * garbage * vsizeof<Node>);
+
+    // Every collection and release is in the pause histogram.
+    uint64_t pauses = 0;
+    for (auto p : t.pauses)
+      pauses += p;
+    uint64_t collections = 0;
+    for (auto c : t.collections)
+      collections += c;
+    check(pauses == collections);
+  }
+
+  LiveMetrics::close();
+  std::remove(path);
+  return 0;
+}
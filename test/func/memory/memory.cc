@@ -3,10 +3,14 @@
 #include "memory.h"
 
 #include "memory_alloc.h"
+#include "memory_arena_gc.h"
+#include "memory_co_alloc.h"
+#include "memory_convert.h"
 #include "memory_gc.h"
 #include "memory_iterator.h"
 #include "memory_merge.h"
 #include "memory_rc.h"
+#include "memory_reset.h"
 // #include "memory_subregion.h"
 #include "memory_swap_root.h"
 
@@ -55,8 +59,25 @@ int main(int argc, char** argv)
   memory_iterator::run_test();
   memory_swap_root::run_test();
   memory_merge::run_test();
+  memory_reset::run_test();
+  memory_arena_gc::run_test();
+  memory_convert::run_test();
   memory_gc::run_test();
+  RegionTrace::set_mark_bitmap(true);
+  memory_gc::run_test();
+  RegionTrace::set_mark_bitmap(false);
+  RegionTrace::set_lazy_sweep(true);
+  memory_gc::run_test();
+  RegionTrace::set_lazy_sweep(false);
+  RegionTrace::set_paged(true);
+  memory_alloc::run_test();
+  memory_iterator::run_test();
+  memory_swap_root::run_test();
+  memory_merge::run_test();
+  memory_gc::run_test();
+  RegionTrace::set_paged(false);
   memory_rc::run_test();
+  memory_co_alloc::run_test();
   // memory_subregion::run_test();
 
   test_dealloc();
@@ -107,8 +107,8 @@ namespace memory_alloc
       test_alloc_helper<region_type, F, F, F>();
       test_alloc_helper<region_type, C, F, C, F>();
 
-      // Medium objects that need a new arena to be allocated. Only 2 can fit in
-      // a single arena, so we'll need a second arena.
+      // Medium objects that need a new arena to be allocated. At most 2 can
+      // fit in a single arena, so we'll need a second arena.
       test_alloc_helper<region_type, MC, MC, MC>();
       test_alloc_helper<region_type, MF, MF, MF>();
       test_alloc_helper<region_type, MF, MC, MF>();
@@ -140,9 +140,6 @@ namespace memory_alloc
       test_alloc_helper<region_type, C, C, C, C, F, F, F, F>();
 
       // Many objects in many arenas.
-      // 1st arena: MC MF C F
-      // 2nd arena: MF MC F F
-      // 3rd arena: MC MC C C
       test_alloc_helper<
         region_type,
         MC,
@@ -170,9 +167,311 @@ namespace memory_alloc
     }
   }
 
+  /**
+   * Allocates `n` objects of type `T` as one batch in a fresh region, checks
+   * they are all accounted for, and then frees the region.
+   **/
+  template<RegionType region_type, class T>
+  void test_alloc_many_helper(size_t n)
+  {
+    auto* o = new (region_type) C1;
+    {
+      UsingRegion rr(o);
+      size_t before = debug_memory_used();
+
+      T* out[16];
+      alloc_many(n, out);
+      for (size_t i = 0; i < n; i++)
+      {
+        check(out[i] != nullptr);
+        check(Object::debug_is_aligned(out[i]));
+      }
+      check(debug_size() == 1 + n);
+      check(debug_memory_used() == before + n * vsizeof<T>);
+      if constexpr (std::is_same_v<T, F1>)
+        check(live_count == (int)n);
+    }
+    region_release(o);
+    heap::debug_check_empty();
+    check(live_count == 0);
+  }
+
+  /**
+   * Tests batch allocation with api::alloc_many.
+   **/
+  template<RegionType region_type>
+  void test_alloc_many()
+  {
+    test_alloc_many_helper<region_type, C1>(0);
+    test_alloc_many_helper<region_type, C1>(16);
+    test_alloc_many_helper<region_type, F1>(16);
+    test_alloc_many_helper<region_type, XLargeC2>(3);
+
+    // Only two medium objects fit in an arena, so the batch spans arenas.
+    test_alloc_many_helper<region_type, MediumC2>(5);
+    test_alloc_many_helper<region_type, MediumF2>(5);
+  }
+
+  /**
+   * Allocates `n` objects of type `T` in a fresh arena region whose arenas
+   * are sized by `config`, checks they can all be reached, and then frees
+   * the region.
+   **/
+  template<class T>
+  void test_alloc_chunks_helper(RegionArena::ChunkConfig config, size_t n)
+  {
+    auto* o = new (config) C1;
+    {
+      UsingRegion rr(o);
+      for (size_t i = 0; i < n; i++)
+      {
+        T* p = new T;
+        check(Object::debug_is_aligned(p));
+      }
+      check(debug_size() == 1 + n);
+    }
+
+    size_t count = 0;
+    auto* reg = RegionArena::get(o);
+    for (auto* p : *reg)
+    {
+      check(Object::debug_is_aligned(p));
+      count++;
+    }
+    check(count == 1 + n);
+
+    region_release(o);
+    heap::debug_check_empty();
+    check(live_count == 0);
+  }
+
+  /**
+   * Tests arena regions with arena sizes other than the default.
+   **/
+  void test_alloc_chunks()
+  {
+    using Config = RegionArena::ChunkConfig;
+    constexpr size_t MiB = 1024 * 1024;
+
+    // Arenas growing from the smallest size, with objects that outgrow the
+    // schedule and need a larger arena straight away.
+    test_alloc_chunks_helper<C1>({}, 10000);
+    test_alloc_chunks_helper<F1>({}, 10000);
+    test_alloc_chunks_helper<MediumC2>({}, 5);
+    test_alloc_chunks_helper<LargeF2>({}, 3);
+
+    // Sizes that are not powers of two are rounded, and sizes out of range
+    // are clamped.
+    test_alloc_chunks_helper<C1>({5000, 3 * MiB}, 10000);
+    test_alloc_chunks_helper<C1>({1, 1}, 1000);
+    test_alloc_chunks_helper<C1>({MiB, MiB}, 1000);
+
+    // Arenas that grow past MAX_HEAP_CHUNK_SIZE onto huge pages.
+    test_alloc_chunks_helper<MediumC2>(
+      {MiB, 8 * MiB, pal::HugePages::Transparent}, 40);
+    test_alloc_chunks_helper<MediumF2>(
+      {2 * MiB, 4 * MiB, pal::HugePages::Explicit}, 20);
+
+    // The default can be changed, and regions keep the sizes they were
+    // created with.
+    Config prev = RegionArena::get_default_chunks();
+    RegionArena::set_default_chunks(
+      {2 * MiB, 2 * MiB, pal::HugePages::Transparent});
+    auto* o = new (RegionType::Arena) C1;
+    RegionArena::set_default_chunks(prev);
+    {
+      UsingRegion rr(o);
+      for (size_t i = 0; i < 10; i++)
+        new MediumC2;
+    }
+    region_release(o);
+    heap::debug_check_empty();
+  }
+
+  /**
+   * Tests that arena chunks and semispaces freed by one region are reused
+   * by the next, and that the cache gives everything back when trimmed.
+   **/
+  void test_chunk_cache()
+  {
+    ChunkCache::set_capacity(16 * 1024 * 1024);
+    ChunkCache::reset_stats();
+
+    for (int round = 0; round < 3; round++)
+    {
+      for (auto type : {RegionType::Arena, RegionType::SemiSpace})
+      {
+        auto* o = new (type) C1;
+        {
+          UsingRegion rr(o);
+          for (int i = 0; i < 1000; i++)
+            new C1;
+          new MediumC2;
+        }
+        region_release(o);
+      }
+    }
+
+    auto stats = ChunkCache::get_stats();
+    check(stats.misses > 0);
+    check(stats.hits >= 2 * stats.misses);
+
+    ChunkCache::trim();
+    ChunkCache::set_capacity(0);
+    heap::debug_check_empty();
+  }
+
+  /**
+   * Tests that once the stack block cache is warm, a collection takes every
+   * block of its stacks from it.
+   **/
+  void test_stack_cache()
+  {
+    StackBlockCache::set_capacity(64);
+
+    auto* o = new (RegionType::Trace) F1;
+    {
+      UsingRegion rr(o);
+      F1* last = o;
+      for (int i = 0; i < 1000; i++)
+      {
+        auto* n = new F1;
+        last->f1 = n;
+        last = n;
+      }
+
+      region_collect();
+      StackBlockCache::reset_stats();
+      region_collect();
+      auto stats = StackBlockCache::get_stats();
+      check(stats.hits > 0);
+      check(stats.misses == 0);
+    }
+    region_release(o);
+
+    StackBlockCache::trim();
+    StackBlockCache::set_capacity(0);
+    heap::debug_check_empty();
+    check(live_count == 0);
+  }
+
+  /**
+   * Tests that an object too big for the last arena goes in the gap an
+   * earlier one was left with, unless a savepoint was taken since, and
+   * that the gaps left are counted as wasted.
+   **/
+  void test_partial_arenas()
+  {
+    using Big = C2<600 * 1024>;
+    using Half = C2<300 * 1024>;
+    constexpr size_t MiB = 1024 * 1024;
+    RegionArena::ChunkConfig config{MiB, MiB};
+
+    for (bool savepoint : {false, true})
+    {
+      RegionArena::reset_fragmentation_stats();
+      auto* o = new (config) C1;
+      {
+        UsingRegion rr(o);
+        new Big;
+        new Big;
+        new Half;
+        if (savepoint)
+          region_mark();
+        // Does not fit in the second arena, but does in the first.
+        new Half;
+        check(debug_size() == 5);
+      }
+      region_release(o);
+
+      auto stats = RegionArena::get_fragmentation_stats();
+      check(stats.chunk_bytes == (savepoint ? 3 : 2) * MiB);
+      check(stats.wasted_bytes < (savepoint ? MiB : 300 * 1024));
+    }
+    heap::debug_check_empty();
+  }
+
+  /**
+   * Tests allocating through a region handle typed at compile time.
+   **/
+  template<RegionType region_type>
+  void test_typed_region()
+  {
+    auto* o = new (region_type) C1;
+    check(Region::get_type(o->get_region()) == region_type);
+    {
+      UsingTypedRegion<region_type> rr(o);
+      for (int i = 0; i < 100; i++)
+      {
+        auto* f = rr.template create_object<F1>();
+        check(Object::debug_is_aligned(f));
+      }
+      check(debug_size() == 1 + 100);
+      check(live_count == 100);
+    }
+    region_release(o);
+    heap::debug_check_empty();
+    check(live_count == 0);
+  }
+
+  struct PoolRoot : public V<PoolRoot>
+  {
+    RegionPool<F1> pool;
+
+    void trace(ObjectStack& st) const
+    {
+      pool.trace(st);
+    }
+  };
+
+  /**
+   * Tests that a RegionPool keeps the objects recycled into it alive, and
+   * makes new objects in their place.
+   **/
+  template<RegionType region_type>
+  void test_region_pool()
+  {
+    auto* r = new (region_type) PoolRoot;
+    {
+      UsingRegion rr(r);
+      F1* a = r->pool.make();
+      F1* b = r->pool.make();
+      check(r->pool.get_allocated() == 2);
+      check(live_count == 2);
+
+      r->pool.recycle(a);
+      r->pool.recycle(b);
+      if constexpr (region_type == RegionType::Trace)
+        region_collect();
+      check(debug_size() == 3);
+
+      // The last object recycled is reused, destroyed and constructed
+      // again in place.
+      F1* c = r->pool.make();
+      check(c == b);
+      check(r->pool.get_reused() == 1);
+      check(r->pool.size() == 1);
+      check(live_count == 2);
+      check(debug_size() == 3);
+    }
+    region_release(r);
+    heap::debug_check_empty();
+    check(live_count == 0);
+  }
+
   void run_test()
   {
     test_alloc<RegionType::Trace>();
     test_alloc<RegionType::Arena>();
+    test_alloc_many<RegionType::Trace>();
+    test_alloc_many<RegionType::Arena>();
+    test_alloc_chunks();
+    test_chunk_cache();
+    test_stack_cache();
+    test_partial_arenas();
+    test_typed_region<RegionType::Trace>();
+    test_typed_region<RegionType::Arena>();
+    test_region_pool<RegionType::Trace>();
+    test_region_pool<RegionType::Arena>();
   }
 }
\ No newline at end of file
@@ -0,0 +1,185 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "memory.h"
+
+#include <type_traits>
+
+namespace memory_arena_gc
+{
+  /**
+   * Creates a collectable arena region whose iso is of type `T`.
+   **/
+  template<class T>
+  T* create_collectable()
+  {
+    RegionArena::set_collectable(true);
+    auto* o = new (RegionType::Arena) T;
+    RegionArena::set_collectable(false);
+    return o;
+  }
+
+  /**
+   * Allocates `n` objects of type `T` in the current region, linking every
+   * other one into a list hanging off `head->f1`. Returns the length of the
+   * list.
+   **/
+  template<class T>
+  size_t alloc_list(T* head, size_t n)
+  {
+    size_t length = 0;
+    T* tail = head;
+    for (size_t i = 0; i < n; i++)
+    {
+      auto* p = new T;
+      if (i % 2 == 0)
+      {
+        tail->f1 = p;
+        tail = p;
+        length++;
+      }
+    }
+    return length;
+  }
+
+  template<class T>
+  size_t list_length(T* head)
+  {
+    size_t length = 0;
+    for (T* p = head->f1; p != nullptr; p = p->f1)
+    {
+      check(Object::debug_is_aligned(p));
+      length++;
+    }
+    return length;
+  }
+
+  /**
+   * Tests that a collection keeps exactly the objects reachable from the
+   * iso, whether their fields are fixed up through relocate (C1) or by
+   * scanning (F1).
+   **/
+  template<class T>
+  void test_collect()
+  {
+    auto* o = create_collectable<T>();
+    int iso_live = live_count;
+    {
+      UsingRegion rr(o);
+      size_t length = alloc_list(o, 4000);
+      new XLargeF2;
+      check(debug_size() == 1 + 4000 + 1);
+
+      region_collect();
+      int list_live = std::is_same_v<T, F1> ? (int)length : 0;
+      check(debug_size() == 1 + length);
+      check(list_length(o) == length);
+      check(live_count == iso_live + list_live);
+
+      // Nothing more is dead.
+      region_collect();
+      check(debug_size() == 1 + length);
+      check(list_length(o) == length);
+
+      o->f1 = nullptr;
+      region_collect();
+      check(debug_size() == 1);
+      check(live_count == iso_live);
+    }
+
+    region_release(o);
+    heap::debug_check_empty();
+    check(live_count == 0);
+  }
+
+  /**
+   * Tests that survivors in a mostly live arena stay where they are.
+   **/
+  void test_dense_arena_kept()
+  {
+    auto* o = create_collectable<C1>();
+    {
+      UsingRegion rr(o);
+      C1* tail = o;
+      for (int i = 0; i < 1000; i++)
+      {
+        tail->f1 = new C1;
+        tail = tail->f1;
+      }
+      for (int i = 0; i < 10; i++)
+        new C1;
+
+      C1* first = o->f1;
+      region_collect();
+      check(o->f1 == first);
+      check(list_length(o) == 1000);
+      check(debug_size() == 1 + 1000);
+    }
+
+    region_release(o);
+    heap::debug_check_empty();
+  }
+
+  /**
+   * Tests that an external reference follows its object when it is
+   * evacuated, and is invalidated when its object dies.
+   **/
+  void test_ext_ref()
+  {
+    auto* o = create_collectable<C1>();
+    ExternalRef* live_ref;
+    ExternalRef* dead_ref;
+    {
+      UsingRegion rr(o);
+      alloc_list(o, 100);
+      live_ref = create_external_reference(o->f1);
+      dead_ref = create_external_reference(new C1);
+
+      region_collect();
+      check(is_external_reference_valid(live_ref));
+      check(use_external_reference(live_ref) == o->f1);
+      check(!is_external_reference_valid(dead_ref));
+    }
+
+    Immutable::release(live_ref);
+    Immutable::release(dead_ref);
+    region_release(o);
+    heap::debug_check_empty();
+  }
+
+  /**
+   * Tests that a collection releases the subregions its dead objects own.
+   **/
+  void test_subregion()
+  {
+    auto* o = create_collectable<F1>();
+    {
+      UsingRegion rr(o);
+      auto* f = new F1;
+      f->f1 = new (RegionType::Arena) F1;
+      {
+        UsingRegion rr2(f->f1);
+        new F1;
+      }
+      check(live_count == 4);
+
+      region_collect();
+      check(live_count == 1);
+      check(debug_size() == 1);
+    }
+
+    region_release(o);
+    heap::debug_check_empty();
+    check(live_count == 0);
+  }
+
+  void run_test()
+  {
+    test_collect<C1>();
+    test_collect<F1>();
+    test_dense_arena_kept();
+    test_ext_ref();
+    test_subregion();
+  }
+}
@@ -0,0 +1,88 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "memory.h"
+
+namespace memory_co_alloc
+{
+  /**
+   * The Iso of a new region shares one allocation with the region's
+   * metadata (see CoAllocation). Each test here ends the two at different
+   * times, and checks that the allocation is freed once both are gone.
+   **/
+
+  template<RegionType region_type>
+  void test_release()
+  {
+    auto r = new (region_type) C1;
+    check(r->debug_is_co_allocated() == Object::debug_can_co_allocate());
+
+    region_release(r);
+    heap::debug_check_empty();
+  }
+
+  /// The metadata goes first, when the region is frozen.
+  template<RegionType region_type>
+  void test_freeze()
+  {
+    auto r = new (region_type) C1;
+    {
+      UsingRegion rr(r);
+      r->f1 = new C1;
+    }
+
+    freeze(r);
+    Immutable::release(r);
+    heap::debug_check_empty();
+  }
+
+  /// The metadata goes first, when the region is merged into another, and
+  /// the old Iso last, as an object of that region.
+  template<RegionType region_type>
+  void test_merge()
+  {
+    auto r1 = new (region_type) C1;
+    auto r2 = new (region_type) C1;
+    {
+      UsingRegion rr(r1);
+      merge(r2);
+      r1->f1 = r2;
+    }
+
+    region_release(r1);
+    heap::debug_check_empty();
+  }
+
+  /// The old Iso goes first, collected after the root is swapped.
+  void test_swap_root()
+  {
+    auto r = new (RegionType::Trace) C1;
+    C1* n;
+    {
+      UsingRegion rr(r);
+      n = new C1;
+      set_entry_point(n);
+      region_collect();
+    }
+
+    region_release(n);
+    heap::debug_check_empty();
+  }
+
+  void run_test()
+  {
+    test_release<RegionType::Trace>();
+    test_release<RegionType::Rc>();
+    test_release<RegionType::SemiSpace>();
+
+    test_freeze<RegionType::Trace>();
+    test_freeze<RegionType::Rc>();
+    test_freeze<RegionType::SemiSpace>();
+
+    test_merge<RegionType::Trace>();
+    test_merge<RegionType::SemiSpace>();
+
+    test_swap_root();
+  }
+}
@@ -0,0 +1,140 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "memory.h"
+#include "memory_arena_gc.h"
+
+#include <type_traits>
+
+namespace memory_convert
+{
+  using memory_arena_gc::alloc_list;
+  using memory_arena_gc::create_collectable;
+  using memory_arena_gc::list_length;
+
+  /**
+   * Tests that converting an Arena region keeps exactly the objects
+   * reachable from the iso, whether their fields are fixed up through
+   * relocate (C1) or by scanning (F1), and that the Trace region it becomes
+   * collects as usual.
+   **/
+  template<class T>
+  void test_convert()
+  {
+    auto* o = new (RegionType::Arena) T;
+    int iso_live = live_count;
+    size_t length;
+    {
+      UsingRegion rr(o);
+      length = alloc_list(o, 4000);
+      new XLargeF2;
+      check(debug_size() == 1 + 4000 + 1);
+    }
+
+    ObjectStack collect;
+    auto* n = (T*)Region::convert<RegionType::Arena, RegionType::Trace>(
+      o, collect);
+    check(collect.empty());
+    check(Region::get_type(Region::get(n)) == RegionType::Trace);
+
+    int list_live = std::is_same_v<T, F1> ? (int)length : 0;
+    check(live_count == iso_live + list_live);
+    {
+      UsingRegion rr(n);
+      check(debug_size() == 1 + length);
+      check(list_length(n) == length);
+
+      n->f1->f1 = nullptr;
+      region_collect();
+      check(debug_size() == 2);
+      check(list_length(n) == 1);
+    }
+
+    region_release(n);
+    heap::debug_check_empty();
+    check(live_count == 0);
+  }
+
+  /**
+   * Tests that converting the open region moves external references with
+   * their objects, invalidates those of dead objects, and releases the
+   * subregions dead objects own.
+   **/
+  void test_convert_open()
+  {
+    auto* o = new (RegionType::Arena) F1;
+    ExternalRef* live_ref;
+    ExternalRef* dead_ref;
+    {
+      UsingRegion rr(o);
+      o->f1 = new F1;
+      live_ref = create_external_reference(o->f1);
+
+      auto* dead = new F1;
+      dead_ref = create_external_reference(dead);
+      dead->f1 = new (RegionType::Arena) F1;
+      {
+        UsingRegion rr2(dead->f1);
+        new F1;
+      }
+      check(live_count == 5);
+
+      region_convert<RegionType::Arena, RegionType::Trace>();
+      check(RegionContext::get_region_type() == RegionType::Trace);
+      o = (F1*)RegionContext::get_entry_point();
+
+      check(live_count == 2);
+      check(debug_size() == 2);
+      check(is_external_reference_valid(live_ref));
+      check(use_external_reference(live_ref) == o->f1);
+      check(!is_external_reference_valid(dead_ref));
+    }
+
+    Immutable::release(live_ref);
+    Immutable::release(dead_ref);
+    region_release(o);
+    heap::debug_check_empty();
+    check(live_count == 0);
+  }
+
+  /**
+   * Tests that a collectable region is collected as an arena until its
+   * estimated garbage passes the threshold, and then converted in place.
+   **/
+  void test_promote()
+  {
+    RegionArena::set_promote_garbage(64 * 1024);
+    auto* o = create_collectable<C1>();
+    {
+      UsingRegion rr(o);
+      size_t length = alloc_list(o, 4000);
+
+      // Nothing has been collected yet to estimate from.
+      region_collect();
+      check(RegionContext::get_region_type() == RegionType::Arena);
+      check(list_length(o) == length);
+
+      // Half of what the first collection saw was dead.
+      for (size_t i = 0; i < 8000; i++)
+        new C1;
+      region_collect();
+      check(RegionContext::get_region_type() == RegionType::Trace);
+      check(RegionContext::get_entry_point() == o);
+      check(debug_size() == 1 + length);
+      check(list_length(o) == length);
+    }
+    RegionArena::set_promote_garbage(0);
+
+    region_release(o);
+    heap::debug_check_empty();
+  }
+
+  void run_test()
+  {
+    test_convert<C1>();
+    test_convert<F1>();
+    test_convert_open();
+    test_promote();
+  }
+}
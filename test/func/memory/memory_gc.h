@@ -19,6 +19,23 @@ namespace memory_gc
   using Cx = C3;
   using Fx = F3;
 
+  /**
+   * A node whose references are only described by a pointer map: it has
+   * neither trace nor relocate.
+   **/
+  struct MappedNode : public V<MappedNode>
+  {
+    MappedNode* left = nullptr;
+    size_t value = 0;
+    MappedNode* right = nullptr;
+
+    static constexpr uint64_t pointer_fields()
+    {
+      return field_map(
+        {offsetof(MappedNode, left), offsetof(MappedNode, right)});
+    }
+  };
+
   template<class... T>
   void alloc_garbage_helper()
   {
@@ -561,12 +578,661 @@ namespace memory_gc
     heap::debug_check_empty();
   }
 
+  /**
+   * A MarkBitmap tells apart objects that share a page, and objects whose
+   * pages are far apart, and gives its pages back when cleared.
+   **/
+  void test_mark_bitmap()
+  {
+    auto* o = new (RegionType::Trace) C;
+
+    {
+      UsingRegion rr(o);
+
+      auto* a = new C;
+      auto* b = new C;
+      auto* x = new XC;
+
+      MarkBitmap marks;
+      check(!marks.is_marked(a));
+      check(marks.mark(a));
+      check(!marks.mark(a));
+      check(marks.is_marked(a));
+      check(!marks.is_marked(b));
+      check(marks.mark(x));
+      check(marks.is_marked(x));
+      check(marks.get_page_count() >= 1);
+
+      marks.clear();
+      check(marks.get_page_count() == 0);
+      check(!marks.is_marked(a));
+      check(!marks.is_marked(x));
+
+      // Headers are left alone: the marked objects still look unmarked.
+      check(marks.mark(a) && marks.mark(b));
+      check(a->debug_is_mutable() && b->debug_is_mutable());
+    }
+
+    region_release(o);
+    heap::debug_check_empty();
+  }
+
+  /**
+   * A parallel sweep frees the same objects as the sequential one, and
+   * leaves the rings linked for the next collection.
+   **/
+  void test_parallel_sweep()
+  {
+    size_t threads = RegionTrace::get_sweep_threads();
+    RegionTrace::set_sweep_threads(4);
+
+    auto* o = new (RegionType::Trace) C;
+    {
+      UsingRegion rr(o);
+
+      // A list of live objects interleaved with garbage, and a few
+      // non-trivial objects in the other ring.
+      size_t live = 4000;
+      C* prev = o;
+      for (size_t i = 0; i < live; i++)
+      {
+        auto* c = new C;
+        prev->f1 = c;
+        prev = c;
+        for (size_t j = 0; j < 4; j++)
+          new C;
+        if ((i % 100) == 0)
+          new F;
+      }
+      check(debug_size() >= RegionTrace::PARALLEL_SWEEP_MIN_OBJECTS);
+
+      region_collect();
+      check(debug_size() == live + 1);
+      check(RegionTrace::get(o)->get_region_size() == live + 1);
+
+      size_t n = 0;
+      for (C* c = o->f1; c != nullptr; c = c->f1)
+        n++;
+      check(n == live);
+
+      o->f1 = nullptr;
+      region_collect();
+      check(debug_size() == 1);
+    }
+    region_release(o);
+    heap::debug_check_empty();
+
+    RegionTrace::set_sweep_threads(threads);
+  }
+
+  /**
+   * With a lazy sweep, a collection leaves the dead trivial objects to later
+   * allocations, but the region metrics already count only live ones, and
+   * external references to the dead objects are already invalid.
+   **/
+  void test_lazy_sweep()
+  {
+    bool lazy = RegionTrace::get_lazy_sweep();
+    RegionTrace::set_lazy_sweep(true);
+
+    auto* o = new (RegionType::Trace) C;
+    {
+      UsingRegion rr(o);
+
+      o->f1 = new C;
+      o->f1->f1 = new C;
+      size_t live = debug_memory_used();
+
+      for (size_t i = 0; i < 100; i++)
+        new C;
+      new F;
+      ExternalRef* dead = create_external_reference(new C);
+
+      region_collect();
+      auto* reg = RegionTrace::get(o);
+      check(reg->is_sweep_pending());
+      check(debug_memory_used() == live);
+      check(reg->get_region_size() == 3);
+
+      // The dead object is not swept yet, but no longer reachable.
+      check(!is_external_reference_valid(dead));
+      Immutable::release(dead);
+
+      // Each allocation sweeps a few objects, until the ring is done.
+      size_t allocs = 0;
+      while (reg->is_sweep_pending())
+      {
+        o->f1->f2 = new C;
+        allocs++;
+      }
+      check(allocs > 1);
+      check(debug_size() == 3 + allocs);
+
+      // Collecting again finishes the sweep first.
+      for (size_t i = 0; i < 10; i++)
+        new C;
+      region_collect();
+      o->f1 = nullptr;
+      region_collect();
+      check(debug_size() == 1);
+    }
+    region_release(o);
+    heap::debug_check_empty();
+
+    RegionTrace::set_lazy_sweep(lazy);
+  }
+
+  /**
+   * An incremental mark spans several collection requests. A reference
+   * moved behind the mark with api::store, and an object allocated during
+   * the mark, both survive it.
+   **/
+  void test_incremental_mark()
+  {
+    bool incremental = RegionTrace::get_incremental_mark();
+    size_t slice = RegionTrace::get_mark_slice();
+    RegionTrace::set_incremental_mark(true);
+    RegionTrace::set_mark_slice(4);
+
+    auto* o = new (RegionType::Trace) C;
+    {
+      UsingRegion rr(o);
+
+      // o -> a -> n[0] -> ... -> n[49], plus some garbage.
+      C* n[50];
+      auto* a = new C;
+      o->f1 = a;
+      C* prev = a;
+      for (size_t i = 0; i < 50; i++)
+      {
+        n[i] = new C;
+        prev->f1 = n[i];
+        prev = n[i];
+      }
+      for (size_t i = 0; i < 20; i++)
+        new C;
+      check(debug_size() == 72);
+
+      region_collect();
+      auto* reg = RegionTrace::get(o);
+      check(reg->is_mark_pending());
+
+      // Hang the tail of the list off the root, which has been traced, and
+      // cut it from the rest of the list, which has not.
+      store(o->f2, n[40]);
+      store(n[39]->f1, (C*)nullptr);
+      store(n[40]->f2, new C);
+
+      size_t slices = 1;
+      while (reg->is_mark_pending())
+      {
+        region_collect();
+        slices++;
+      }
+      check(slices > 2);
+      check(!RegionTrace::is_any_mark_pending());
+      check(debug_size() == 53);
+      check(reg->get_region_size() == 53);
+      check(o->f2 == n[40] && n[40]->f2 != nullptr);
+
+      // A mark in progress is abandoned when the region is released.
+      o->f1 = nullptr;
+      region_collect();
+      check(reg->is_mark_pending());
+    }
+    region_release(o);
+    heap::debug_check_empty();
+    check(!RegionTrace::is_any_mark_pending());
+
+    RegionTrace::set_mark_slice(slice);
+    RegionTrace::set_incremental_mark(incremental);
+  }
+
+  /**
+   * With sticky marks, the collections between full ones only sweep the
+   * objects allocated since the last one. A young object stored into an
+   * old one with api::store survives, and an old object that dies stays
+   * until the next full collection. Each region keeps the default it was
+   * created with, unless it is given its own.
+   **/
+  void test_sticky_marks()
+  {
+    bool sticky = RegionTrace::get_sticky_marks();
+    bool lazy = RegionTrace::get_lazy_sweep();
+    size_t interval = RegionTrace::get_full_gc_interval();
+    RegionTrace::set_sticky_marks(false);
+    RegionTrace::set_lazy_sweep(false);
+    RegionTrace::set_full_gc_interval(4);
+
+    auto* o = new (RegionType::Trace) C;
+    region_set_sticky_marks(o, true);
+    {
+      UsingRegion rr(o);
+      auto* reg = RegionTrace::get(o);
+
+      o->f1 = new C;
+      o->f1->f1 = new C;
+      for (size_t i = 0; i < 20; i++)
+        new C;
+
+      // The first collection is full, and its survivors are old.
+      region_collect();
+      check(reg->is_sticky());
+      check(RegionTrace::is_any_sticky());
+      check(reg->get_region_size() == 3);
+
+      // Iterating would end the sticky marks, so count with the metrics.
+      C* old = o->f1->f1;
+      store(old->f2, new C);
+      for (size_t i = 0; i < 10; i++)
+        new C;
+      region_collect();
+      check(reg->get_region_size() == 4);
+      check(old->f2 != nullptr);
+
+      // Two more minor collections keep the dead old objects, and the one
+      // after them is full again.
+      store(o->f1, (C*)nullptr);
+      region_collect();
+      region_collect();
+      check(reg->get_region_size() == 4);
+      region_collect();
+      check(reg->get_region_size() == 1);
+      check(reg->is_sticky());
+
+      // Iterating moves the young objects into the rings.
+      new C;
+      check(debug_size() == 2);
+      check(!reg->is_sticky());
+    }
+    region_release(o);
+    heap::debug_check_empty();
+    check(!RegionTrace::is_any_sticky());
+
+    RegionTrace::set_sticky_marks(true);
+    o = new (RegionType::Trace) C;
+    RegionTrace::set_sticky_marks(false);
+    {
+      UsingRegion rr(o);
+      region_collect();
+      check(RegionTrace::get(o)->is_sticky());
+
+      // Turning them off makes the next collection a full one.
+      region_set_sticky_marks(o, false);
+      new C;
+      region_collect();
+      check(!RegionTrace::get(o)->is_sticky());
+      check(debug_size() == 1);
+    }
+    region_release(o);
+    heap::debug_check_empty();
+
+    RegionTrace::set_full_gc_interval(interval);
+    RegionTrace::set_lazy_sweep(lazy);
+    RegionTrace::set_sticky_marks(sticky);
+  }
+
+  /**
+   * With concurrent marking, a collection requested in the region is
+   * carried out by the background collector once the region is closed.
+   * Opening the region takes it back, possibly mid-mark, and the mark is
+   * completed in the background after the next close.
+   **/
+  void test_concurrent_mark()
+  {
+    bool concurrent = RegionTrace::get_concurrent_mark();
+    size_t slice = RegionTrace::get_mark_slice();
+    RegionTrace::set_concurrent_mark(true);
+    RegionTrace::set_mark_slice(4);
+
+    auto* o = new (RegionType::Trace) C;
+    auto* reg = RegionTrace::get(o);
+    {
+      UsingRegion rr(o);
+
+      // o -> n[0] -> ... -> n[49], plus some garbage.
+      C* prev = o;
+      for (size_t i = 0; i < 50; i++)
+      {
+        prev->f1 = new C;
+        prev = prev->f1;
+      }
+      for (size_t i = 0; i < 20; i++)
+        new C;
+
+      region_collect();
+      check(reg->is_mark_pending());
+    }
+    RegionTrace::drain_background();
+    check(!reg->is_mark_pending());
+    check(reg->get_region_size() == 51);
+
+    {
+      UsingRegion rr(o);
+      check(debug_size() == 51);
+      o->f1 = nullptr;
+      region_collect();
+    }
+    {
+      UsingRegion rr(o);
+      store(o->f2, new C);
+    }
+    RegionTrace::drain_background();
+    check(!reg->is_mark_pending());
+    {
+      UsingRegion rr(o);
+      check(debug_size() == 2);
+      check(o->f2 != nullptr);
+    }
+
+    region_release(o);
+    heap::debug_check_empty();
+    check(!RegionTrace::is_any_mark_pending());
+
+    RegionTrace::set_mark_slice(slice);
+    RegionTrace::set_concurrent_mark(concurrent);
+  }
+
+  /**
+   * region_maybe_collect() collects only once the region reaches the
+   * trigger its policy worked out from the last collection.
+   **/
+  void test_gc_policy()
+  {
+    constexpr size_t budget = 128 * 1024;
+
+    auto* o = new (RegionType::Trace) C;
+    {
+      UsingRegion rr(o);
+      o->f1 = new C;
+
+      // The default policy collects whenever asked.
+      check(region_maybe_collect());
+      check(region_maybe_collect());
+
+      region_set_gc_policy(o, GCPolicy::allocation_budget(budget));
+      auto& policy = RegionTrace::get(o)->gc_policy;
+      check(policy.get_trigger() == budget);
+
+      size_t garbage = 0;
+      while (!region_maybe_collect())
+      {
+        new C;
+        garbage++;
+      }
+      check(garbage > 0);
+      check(RegionTrace::get(o)->get_region_size() == 2);
+      check(policy.get_trigger() == debug_memory_used() + budget);
+      check(!region_maybe_collect());
+
+      // A small region is left alone until it reaches the minimum.
+      region_set_gc_policy(o, GCPolicy::heap_growth());
+      check(policy.get_trigger() == GCPolicy::MIN_TRIGGER_BYTES);
+      check(!region_maybe_collect());
+    }
+    region_release(o);
+    heap::debug_check_empty();
+
+    // A region collected at 1000 bytes/us may grow to what a 1ms pause
+    // gets through, and no less than half again what survived.
+    auto pause = GCPolicy::pause_target(1000 * 1000);
+    pause.collected(1000 * 1000, 100 * 1000, 1000 * 1000);
+    check(pause.get_trigger() == 1000 * 1000);
+    pause.collected(1000 * 1000, 900 * 1000, 1000 * 1000);
+    check(pause.get_trigger() == 1350 * 1000);
+
+    // Merging regions adds up what survived their last collections.
+    auto growth = GCPolicy::heap_growth(200);
+    growth.collected(0, 100 * 1024, 0);
+    auto other = GCPolicy::heap_growth(200);
+    other.collected(0, 50 * 1024, 0);
+    growth.merge(other);
+    check(growth.get_live() == 150 * 1024);
+    check(growth.get_trigger() == 300 * 1024);
+  }
+
+  /**
+   * A policy asked on close collects the garbage left in a region when it
+   * is closed, or when the deferred collection runs.
+   **/
+  void test_gc_on_close()
+  {
+    auto* o = new (RegionType::Trace) C;
+    region_set_gc_policy(o, GCPolicy::always().on_close());
+    {
+      UsingRegion rr(o);
+      o->f1 = new C;
+      new C;
+      new C;
+      check(RegionTrace::get(o)->get_region_size() == 4);
+    }
+    check(RegionTrace::get(o)->get_region_size() == 2);
+
+    {
+      UsingRegion rr(o, CloseGC::Defer);
+      new C;
+    }
+    check(RegionTrace::get(o)->get_region_size() == 3);
+    check(region_collect_deferred(o));
+    check(RegionTrace::get(o)->get_region_size() == 2);
+    check(!region_collect_deferred(o));
+
+    // A policy that is not asked on close leaves the region alone.
+    region_set_gc_policy(o, GCPolicy::always());
+    {
+      UsingRegion rr(o);
+      new C;
+    }
+    check(RegionTrace::get(o)->get_region_size() == 3);
+
+    region_release(o);
+    heap::debug_check_empty();
+  }
+
+  /**
+   * A region over its soft quota is collected at its next safepoint, and
+   * one whose live data is over the quota does not collect every time.
+   **/
+  void test_quota()
+  {
+    constexpr size_t soft = 64 * 1024;
+
+    auto* o = new (RegionType::Trace) C;
+    region_set_quota(o, {soft, 0});
+    // Only the quota collects.
+    region_set_gc_policy(o, GCPolicy::allocation_budget(SIZE_MAX / 2));
+    {
+      UsingRegion rr(o);
+      for (int i = 0; i < 10000; i++)
+      {
+        new C;
+        region_maybe_collect();
+        check(debug_memory_used() <= soft);
+      }
+
+      // Keep more than the quota alive.
+      C* tail = o;
+      while (debug_memory_used() <= soft)
+      {
+        tail->f1 = new C;
+        tail = tail->f1;
+      }
+      check(region_maybe_collect());
+      size_t live = RegionTrace::get(o)->get_region_size();
+      for (size_t i = 0; i < 10; i++)
+      {
+        new C;
+        check(!region_maybe_collect());
+      }
+      check(RegionTrace::get(o)->get_region_size() == live + 10);
+
+      // Allocating never collects, and closing the region does.
+      o->f1 = nullptr;
+      size_t target = debug_memory_used() + soft;
+      while (debug_memory_used() <= target)
+        new C;
+    }
+    {
+      UsingRegion rr(o);
+      check(debug_size() == 1);
+    }
+
+    region_release(o);
+    heap::debug_check_empty();
+  }
+
+  /**
+   * A checked allocation that would take a region over its hard quota
+   * fails, and once the region has been collected, works again. One that
+   * cannot fail goes ahead, and is reported to the breach hook.
+   **/
+  void test_hard_quota()
+  {
+    constexpr size_t hard = 64 * 1024;
+    static size_t breaches = 0;
+    static Object* breached = nullptr;
+
+    auto* o = new (RegionType::Trace) C;
+    region_set_quota(o, {0, hard});
+    RegionQuota::set_breach_hook([](Object* region, size_t) {
+      breaches++;
+      breached = region;
+    });
+    {
+      UsingRegion rr(o);
+      C* tail = o;
+      while (true)
+      {
+        C* c = try_new<C>();
+        if (c == nullptr)
+          break;
+        tail->f1 = c;
+        tail = c;
+      }
+      check(debug_memory_used() <= hard);
+      check(breaches == 0);
+
+      C* over = new C;
+      check(breaches == 1);
+      check(breached == o);
+      check(debug_memory_used() > hard);
+
+      tail->f1 = over;
+      o->f1 = nullptr;
+      region_collect();
+      check(debug_size() == 1);
+      check(try_new<C>() != nullptr);
+    }
+    RegionQuota::set_breach_hook(nullptr);
+
+    region_release(o);
+    heap::debug_check_empty();
+  }
+
+  /**
+   * Collectors find and update references through a type's pointer map,
+   * whether they mark or copy.
+   **/
+  void test_pointer_map()
+  {
+    for (auto type : {RegionType::Trace, RegionType::SemiSpace})
+    {
+      auto* o = new (type) MappedNode;
+      {
+        UsingRegion rr(o);
+        MappedNode* n = o;
+        for (size_t i = 1; i <= 100; i++)
+        {
+          auto* m = new MappedNode;
+          m->value = i;
+          new MappedNode;
+          if (i % 2 == 0)
+            n->left = m;
+          else
+            n->right = m;
+          n = m;
+        }
+        check(debug_size() == 1 + 200);
+
+        region_collect();
+        check(debug_size() == 1 + 100);
+
+        size_t i = 0;
+        n = o->right;
+        while (n != nullptr)
+        {
+          check(n->value == ++i);
+          n = n->left != nullptr ? n->left : n->right;
+        }
+        check(i == 100);
+      }
+      region_release(o);
+      heap::debug_check_empty();
+    }
+  }
+
+  /**
+   * A collection releases the unreachable subregions it finds, whatever
+   * their type, and the subregions those hold in turn.
+   **/
+  void test_subregion_types()
+  {
+    for (auto type :
+         {RegionType::Trace,
+          RegionType::Arena,
+          RegionType::Rc,
+          RegionType::SemiSpace,
+          RegionType::Generational,
+          RegionType::Compact})
+    {
+      live_count = 0;
+      auto* sub = new (type) F;
+      {
+        UsingRegion rr(sub);
+        sub->f1 = new (RegionType::SemiSpace) F;
+        sub->f2 = new (RegionType::Rc) F;
+      }
+
+      auto* o = new (region_type) F;
+      {
+        UsingRegion rr(o);
+        auto* holder = new F;
+        holder->f1 = sub;
+        check(live_count == 5);
+
+        region_collect();
+        check(live_count == 1);
+      }
+      region_release(o);
+      check(live_count == 0);
+      heap::debug_check_empty();
+    }
+  }
+
   void run_test()
   {
+    // Paged trace regions cannot be frozen, and always sweep eagerly.
+    bool paged = RegionTrace::get_paged();
+
+    test_mark_bitmap();
+    test_parallel_sweep();
+    if (!paged)
+      test_lazy_sweep();
+    test_incremental_mark();
+    if (!paged)
+      test_sticky_marks();
+    test_concurrent_mark();
+    test_gc_policy();
+    test_gc_on_close();
+    test_quota();
+    test_hard_quota();
+    test_pointer_map();
+    test_subregion_types();
     test_basic();
     test_additional_roots();
     test_linked_list();
-    test_freeze();
+    if (!paged)
+      test_freeze();
     test_cycles();
     test_merge();
     test_swap_root();
@@ -299,6 +299,61 @@ namespace memory_iterator
     }
   }
 
+  /**
+   * region_for_each() visits exactly the objects of the given type, among
+   * trivial and non-trivial objects of other types, and large ones.
+   **/
+  template<RegionType region_type>
+  void test_for_each()
+  {
+    using Big = C2<1024 * 1024>;
+    auto* o = new (region_type) F1;
+
+    {
+      UsingRegion r(o);
+      if constexpr (region_type == RegionType::SemiSpace)
+        region_ensure_available(64 * (vsizeof<C1> + vsizeof<F1>));
+
+      std::unordered_set<Object*> cs{};
+      std::unordered_set<Object*> fs{o};
+      std::unordered_set<Object*> bigs{};
+      for (size_t i = 0; i < 32; i++)
+      {
+        cs.insert(new C1);
+        fs.insert(new F1);
+        new C3;
+        if (i % 16 == 0)
+          bigs.insert(new Big);
+      }
+
+      region_for_each<C1>([&cs](C1* p) {
+        check(cs.count(p) == 1);
+        cs.erase(p);
+      });
+      check(cs.empty());
+
+      region_for_each<F1>([&fs](F1* p) {
+        check(fs.count(p) == 1);
+        fs.erase(p);
+      });
+      check(fs.empty());
+
+      region_for_each<Big>([&bigs](Big* p) {
+        check(bigs.count(p) == 1);
+        bigs.erase(p);
+      });
+      check(bigs.empty());
+
+      size_t f3s = 0;
+      region_for_each<F3>([&f3s](F3*) { f3s++; });
+      check(f3s == 0);
+    }
+
+    region_release(o);
+    heap::debug_check_empty();
+    check(live_count == 0);
+  }
+
   void run_test()
   {
     test_simple<RegionType::Trace>();
@@ -306,5 +361,9 @@ namespace memory_iterator
 
     test_iterator<RegionType::Trace>();
     test_iterator<RegionType::Arena>();
+
+    test_for_each<RegionType::Trace>();
+    test_for_each<RegionType::Arena>();
+    test_for_each<RegionType::SemiSpace>();
   }
 }
\ No newline at end of file
@@ -294,9 +294,205 @@ namespace memory_rc
     heap::debug_check_empty();
   }
 
+  /**
+   * Tests that region_maybe_collect() waits for the cycle threshold, that a
+   * cycle budget spreads the candidates over several collections, and that
+   * candidates freed with an earlier one's cycle are forgotten.
+   **/
+  void test_cycle_budget()
+  {
+    RegionRc::set_cycle_threshold(3);
+    RegionRc::set_cycle_budget(1);
+    auto* o = new (RegionType::Rc) C;
+    RegionRc::set_cycle_threshold(0);
+    RegionRc::set_cycle_budget(0);
+    auto* reg = RegionRc::get(o);
+
+    {
+      UsingRegion rc(o);
+
+      // Three unreachable cycles: (a -> b -> a)
+      for (int i = 0; i < 3; i++)
+      {
+        auto* a = new C;
+        auto* b = new C;
+        a->f1 = b;
+        b->f1 = a;
+        push_lins_stack(a);
+
+        check(region_maybe_collect() == (i == 2));
+      }
+      check(debug_size() == 1 + 4);
+      check(reg->get_cycle_candidates() == 2);
+
+      check(!region_maybe_collect());
+      region_collect();
+      check(debug_size() == 1 + 2);
+      region_collect();
+      check(debug_size() == 1);
+      check(reg->get_cycle_candidates() == 0);
+
+      // Both objects of a cycle are candidates.
+      auto* a = new C;
+      auto* b = new C;
+      a->f1 = b;
+      b->f1 = a;
+      push_lins_stack(a);
+      push_lins_stack(b);
+      check(reg->get_cycle_candidates() == 2);
+
+      region_collect();
+      check(debug_size() == 1);
+      check(reg->get_cycle_candidates() == 0);
+    }
+    region_release(o);
+    heap::debug_check_empty();
+  }
+
+  /**
+   * Tests that a region deferring decrefs deallocates nothing until it is
+   * closed, and that a decref it defers still makes a cycle candidate.
+   **/
+  void test_deferred()
+  {
+    RegionRc::set_deferred(true);
+    auto* o = new (RegionType::Rc) C;
+    RegionRc::set_deferred(false);
+    check(RegionRc::get(o)->is_deferred());
+
+    {
+      UsingRegion rc(o);
+
+      auto* o1 = new C;
+      o1->f1 = new C;
+      o->f1 = o1;
+      check(debug_size() == 3);
+
+      // Counts may dip to zero on the way without freeing anything.
+      for (int i = 0; i < 10; i++)
+      {
+        decref(o1);
+        incref(o1);
+      }
+      check(debug_get_ref_count(o1) == 1);
+
+      o->f1 = nullptr;
+      decref(o1);
+      check(debug_size() == 3);
+    }
+
+    {
+      UsingRegion rc(o);
+      check(debug_size() == 1);
+
+      auto* a = new C;
+      auto* b = new C;
+      a->f1 = b;
+      b->f1 = a;
+      push_lins_stack(a);
+      check(debug_size() == 3);
+
+      region_collect();
+      check(debug_size() == 1);
+    }
+    region_release(o);
+    heap::debug_check_empty();
+  }
+
+  /**
+   * Tests that a region bounding the work of freeing frees a dropped list a
+   * few objects per decref and close, and the rest when it is released.
+   **/
+  void test_free_budget()
+  {
+    RegionRc::set_free_budget(10);
+    auto* o = new (RegionType::Rc) C;
+    RegionRc::set_free_budget(0);
+
+    {
+      UsingRegion rc(o);
+
+      C* tail = o;
+      for (int i = 0; i < 100; i++)
+      {
+        tail->f1 = new C;
+        tail = tail->f1;
+      }
+      check(debug_size() == 1 + 100);
+
+      auto* head = o->f1;
+      o->f1 = nullptr;
+      decref(head);
+      check(debug_size() == 1 + 90);
+
+      // Another decref does another step.
+      auto* x = new C;
+      decref(x);
+      check(debug_size() == 1 + 81);
+    }
+
+    {
+      UsingRegion rc(o);
+      check(debug_size() == 1 + 71);
+    }
+
+    region_release(o);
+    heap::debug_check_empty();
+  }
+
+  /**
+   * Tests that a region with compact counts keeps counts too large for the
+   * object header in its side table, and still frees and collects cycles.
+   **/
+  void test_compact()
+  {
+    RegionRc::set_compact(true);
+    auto* o = new (RegionType::Rc) C;
+    RegionRc::set_compact(false);
+    auto* reg = RegionRc::get(o);
+    check(reg->is_compact());
+
+    {
+      UsingRegion rc(o);
+
+      auto* o1 = new C;
+      o1->f1 = new C;
+      o->f1 = o1;
+      for (int i = 0; i < 299; i++)
+        incref(o1);
+      check(debug_get_ref_count(o1) == 300);
+      check(reg->get_overflow_count() == 1);
+
+      for (int i = 0; i < 299; i++)
+        decref(o1);
+      check(debug_get_ref_count(o1) == 1);
+      check(reg->get_overflow_count() == 1);
+
+      o->f1 = nullptr;
+      decref(o1);
+      check(debug_size() == 1);
+      check(reg->get_overflow_count() == 0);
+
+      // An unreachable cycle: (a -> b -> a)
+      auto* a = new C;
+      auto* b = new C;
+      a->f1 = b;
+      b->f1 = a;
+      push_lins_stack(a);
+      region_collect();
+      check(debug_size() == 1);
+    }
+    region_release(o);
+    heap::debug_check_empty();
+  }
+
   void run_test()
   {
     test_basic();
     test_cycles();
+    test_cycle_budget();
+    test_deferred();
+    test_free_budget();
+    test_compact();
   }
 }
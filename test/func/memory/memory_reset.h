@@ -0,0 +1,196 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "memory.h"
+
+namespace memory_reset
+{
+  /**
+   * Counts the objects the region's iterator reaches, checking each is
+   * aligned.
+   **/
+  size_t count_objects(Object* o)
+  {
+    size_t count = 0;
+    for (auto* p : *RegionArena::get(o))
+    {
+      check(Object::debug_is_aligned(p));
+      count++;
+    }
+    return count;
+  }
+
+  /**
+   * Fills a region whose iso is of type `Iso` with objects of every kind,
+   * resets it, and checks only the iso is left. Does this twice, to check
+   * the region can be reused.
+   **/
+  template<class Iso>
+  void test_reset_helper()
+  {
+    auto* o = new (RegionType::Arena) Iso;
+    int iso_live = live_count;
+    size_t iso_size = 0;
+    {
+      UsingRegion rr(o);
+      iso_size = debug_memory_used();
+    }
+
+    for (int round = 0; round < 2; round++)
+    {
+      {
+        UsingRegion rr(o);
+        for (int i = 0; i < 1000; i++)
+        {
+          new C1;
+          new F1;
+        }
+        new MediumC2;
+        new MediumF2;
+        new XLargeC2;
+        new XLargeF2;
+        check(debug_size() == 2005);
+      }
+
+      region_reset(o);
+      check(live_count == iso_live);
+      check(count_objects(o) == 1);
+      {
+        UsingRegion rr(o);
+        check(debug_size() == 1);
+        check(debug_memory_used() == iso_size);
+      }
+    }
+
+    region_release(o);
+    heap::debug_check_empty();
+    check(live_count == 0);
+  }
+
+  /**
+   * Tests Region::reset on isos in each part of an arena region.
+   **/
+  void test_reset()
+  {
+    test_reset_helper<C1>();
+    test_reset_helper<F1>();
+    test_reset_helper<XLargeC2>();
+    test_reset_helper<XLargeF2>();
+  }
+
+  /**
+   * Tests that resetting a region releases the subregions its dropped
+   * objects own.
+   **/
+  void test_reset_subregion()
+  {
+    auto* o = new (RegionType::Arena) C1;
+    {
+      UsingRegion rr(o);
+      auto* f = new F1;
+      f->f1 = new (RegionType::Arena) F1;
+      {
+        UsingRegion rr2(f->f1);
+        new F1;
+      }
+      o->f1 = (C1*)f;
+    }
+    check(live_count == 3);
+
+    region_reset(o);
+    o->f1 = nullptr;
+    check(live_count == 0);
+
+    region_release(o);
+    heap::debug_check_empty();
+  }
+
+  /**
+   * Tests nested savepoints, with each rewind dropping objects in the last
+   * arena, in later arenas and in the large object ring.
+   **/
+  void test_rewind()
+  {
+    auto* o = new (RegionType::Arena) F1;
+    {
+      UsingRegion rr(o);
+      for (int i = 0; i < 10; i++)
+        new C1;
+      size_t memory = debug_memory_used();
+
+      auto outer = region_mark();
+      for (int i = 0; i < 100; i++)
+        new F1;
+      new XLargeF2;
+      check(live_count == 102);
+      size_t inner_memory = debug_memory_used();
+
+      auto inner = region_mark();
+      for (int i = 0; i < 1000; i++)
+        new C1;
+      new MediumF2;
+      new XLargeC2;
+      check(debug_size() == 1 + 10 + 101 + 1002);
+
+      region_rewind_to(inner);
+      check(debug_size() == 1 + 10 + 101);
+      check(debug_memory_used() == inner_memory);
+      check(live_count == 102);
+      check(count_objects(o) == 1 + 10 + 101);
+
+      // Rewinding to where we are drops nothing.
+      region_rewind_to(region_mark());
+      check(debug_size() == 1 + 10 + 101);
+
+      region_rewind_to(outer);
+      check(debug_size() == 1 + 10);
+      check(debug_memory_used() == memory);
+      check(live_count == 1);
+      check(count_objects(o) == 1 + 10);
+
+      // The emptied arenas are reused.
+      for (int i = 0; i < 1000; i++)
+        new F1;
+      check(count_objects(o) == 1 + 10 + 1000);
+    }
+
+    region_release(o);
+    heap::debug_check_empty();
+    check(live_count == 0);
+  }
+
+  /**
+   * Tests rewinding a region that keeps more than one emptied arena.
+   **/
+  void test_rewind_retain()
+  {
+    RegionArena::ChunkConfig config;
+    config.retain_size = 1024 * 1024;
+    auto* o = new (config) C1;
+    {
+      UsingRegion rr(o);
+      auto sp = region_mark();
+      for (int round = 0; round < 3; round++)
+      {
+        for (int i = 0; i < 5000; i++)
+          new F1;
+        check(debug_size() == 5001);
+        region_rewind_to(sp);
+        check(debug_size() == 1);
+        check(live_count == 0);
+      }
+    }
+
+    region_release(o);
+    heap::debug_check_empty();
+  }
+
+  void run_test()
+  {
+    test_reset();
+    test_reset_subregion();
+    test_rewind();
+    test_rewind_retain();
+  }
+}
@@ -399,6 +399,42 @@ namespace memory_subregion
     std::cout << "Dealloced long region chain." << std::endl;
   }
 
+  /**
+   * Opens `n` regions nested inside one another, allocating in each, and
+   * checks each allocation went to the innermost open region.
+   **/
+  void open_nested(Object** isos, size_t n)
+  {
+    if (n == 0)
+      return;
+
+    UsingRegion rr(isos[0]);
+    size_t size = debug_size();
+    new C1;
+    open_nested(isos + 1, n - 1);
+    new C1;
+    check(debug_size() == size + 2);
+  }
+
+  /**
+   * Tests nesting open regions deeper than the region context keeps inline.
+   **/
+  void test_subregion_nested_open()
+  {
+    constexpr size_t n = 40;
+    Object* isos[n];
+    for (size_t i = 0; i < n; i++)
+      isos[i] = new ((i % 2 == 0) ? RegionType::Trace : RegionType::Arena) C1;
+
+    // Twice, so the second time reuses the frames that spilled.
+    open_nested(isos, n);
+    open_nested(isos, n);
+
+    for (size_t i = 0; i < n; i++)
+      region_release(isos[i]);
+    heap::debug_check_empty();
+  }
+
   void run_test()
   {
     test_subregion_singleton<RegionType::Trace>();
@@ -415,6 +451,7 @@ namespace memory_subregion
     test_subregion_swap_root<RegionType::Arena>();
 
     test_subregion_deep<RegionType::Trace>();
+    test_subregion_nested_open();
 
     test_subregion_merge<RegionType::Trace>();
     test_subregion_merge<RegionType::Arena>();
@@ -0,0 +1,74 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+#include <debug/harness.h>
+
+// Cowns leave garbage in their regions, queue the deferred collections with
+// a GC pacer whose budget would hold most of them back, and signal memory
+// pressure. The scheduler threads answer each alarm by emptying their
+// caches and handing back their allocators' free memory, and let the
+// collections through; only they can have removed the garbage by the time
+// the cowns are collected.
+
+struct Node : public V<Node>
+{
+  Node* next = nullptr;
+
+  void trace(ObjectStack& st) const
+  {
+    if (next != nullptr)
+      st.push(next);
+  }
+};
+
+static constexpr size_t owners = 20;
+static constexpr size_t garbage = 10;
+
+struct Owner : public VCown<Owner>
+{
+  Node* region;
+
+  Owner() : region(new (RegionType::Trace) Node)
+  {
+    region_set_gc_policy(region, GCPolicy::always().on_close());
+  }
+
+  void trace(ObjectStack& st) const
+  {
+    st.push(region);
+  }
+
+  void finaliser(Object*, ObjectStack&)
+  {
+    check(RegionTrace::get(region)->get_region_size() == 2);
+  }
+};
+
+void test_memory_pressure()
+{
+  GCPacer::set_budget(1);
+  ChunkCache::set_capacity(1024 * 1024);
+
+  for (size_t i = 0; i < owners; i++)
+  {
+    auto* owner = new Owner;
+    schedule_lambda<YesTransfer>(owner, [owner]() {
+      {
+        UsingRegion rr(owner->region, CloseGC::Defer);
+        owner->region->next = new Node;
+        for (size_t j = 0; j < garbage; j++)
+          new Node;
+      }
+
+      schedule_paced_collect(owner, owner->region);
+      MemoryPressure::signal();
+    });
+  }
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+  harness.run(test_memory_pressure);
+  return 0;
+}
@@ -3,6 +3,7 @@
 
 #include "./noticeboard_basic.h"
 #include "./noticeboard_primitive_weak.h"
+#include "./noticeboard_seqlock.h"
 #include "./noticeboard_weak.h"
 
 #include <debug/harness.h>
@@ -13,5 +14,6 @@ int main(int argc, char** argv)
   harness.run(noticeboard_basic::run_test);
   harness.run(noticeboard_weak::run_test);
   harness.run(noticeboard_primitive_weak::run_test);
+  harness.run(noticeboard_seqlock::run_test);
   return 0;
 }
@@ -0,0 +1,66 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+namespace noticeboard_seqlock
+{
+  // Two fields that are always updated together, so a torn read shows up
+  // as a mismatch.
+  struct Pair
+  {
+    size_t a;
+    size_t b;
+  };
+
+  static constexpr size_t updates = 10;
+
+  struct Writer : public VCown<Writer>
+  {
+  public:
+    SeqNoticeboard<Pair> box;
+    SeqNoticeboard<Pair> coalesced;
+
+    Writer() : box{Pair{0, 0}}, coalesced{Pair{0, 0}, true} {}
+  };
+
+  struct Reader : public VCown<Reader>
+  {};
+
+  Writer* g_writer = nullptr;
+
+  void writer_loop(Writer* writer)
+  {
+    for (size_t i = 1; i <= updates; i++)
+    {
+      writer->box.update(Pair{i, i});
+      writer->coalesced.update(Pair{i, i});
+    }
+    writer->coalesced.flush();
+    check(writer->coalesced.peek().a == updates);
+  }
+
+  void reader_loop(Reader* reader, size_t remaining)
+  {
+    auto p = g_writer->box.peek();
+    check(p.a == p.b);
+    auto q = g_writer->coalesced.peek();
+    check(q.a == q.b);
+
+    if (remaining == 0)
+    {
+      Cown::release(reader);
+      Cown::release(g_writer);
+      return;
+    }
+
+    schedule_lambda(
+      reader, [reader, remaining]() { reader_loop(reader, remaining - 1); });
+  }
+
+  void run_test()
+  {
+    g_writer = new Writer;
+    auto* reader = new Reader;
+
+    schedule_lambda(reader, [reader]() { reader_loop(reader, updates); });
+    schedule_lambda(g_writer, []() { writer_loop(g_writer); });
+  }
+}
@@ -0,0 +1,83 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+#include <debug/harness.h>
+
+using namespace std;
+
+void oneshot_test()
+{
+  auto pp = OneShot<int>::create_oneshot();
+  auto rp = std::move(pp.first);
+  auto wp = std::move(pp.second);
+
+  schedule_lambda([wp = std::move(wp)]() mutable {
+    OneShot<int>::fulfill(std::move(wp), 42);
+  });
+
+  std::move(rp).then([](std::optional<int> val) {
+    check(val.has_value());
+    Logging::cout() << *val << std::endl;
+  });
+}
+
+void oneshot_fulfilled_first()
+{
+  auto pp = OneShot<int>::create_oneshot();
+  OneShot<int>::fulfill(std::move(pp.second), 42);
+
+  std::move(pp.first).then([](std::optional<int> val) {
+    check(val.has_value() && (*val == 42));
+  });
+}
+
+void oneshot_no_reader()
+{
+  auto pp = OneShot<int>::create_oneshot();
+  auto wp = std::move(pp.second);
+
+  schedule_lambda([wp = std::move(wp)]() mutable {
+    OneShot<int>::fulfill(std::move(wp), 42);
+  });
+}
+
+void oneshot_no_writer()
+{
+  auto pp = OneShot<int>::create_oneshot();
+  auto rp = std::move(pp.first);
+
+  std::move(rp).then([](std::optional<int> val) {
+    check(!val.has_value());
+    Logging::cout() << "Got no value" << std::endl;
+  });
+}
+
+void oneshot_smart_pointer()
+{
+  auto pp = OneShot<unique_ptr<int>>::create_oneshot();
+  auto rp = std::move(pp.first);
+  auto wp = std::move(pp.second);
+
+  schedule_lambda([wp = std::move(wp)]() mutable {
+    auto a = make_unique<int>(42);
+    OneShot<unique_ptr<int>>::fulfill(std::move(wp), std::move(a));
+  });
+
+  std::move(rp).then([](std::optional<unique_ptr<int>> a) {
+    check(a.has_value());
+    Logging::cout() << **a << std::endl;
+  });
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+
+  harness.run(oneshot_test);
+  harness.run(oneshot_fulfilled_first);
+  harness.run(oneshot_no_reader);
+  harness.run(oneshot_no_writer);
+  harness.run(oneshot_smart_pointer);
+
+  return 0;
+}
@@ -0,0 +1,183 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+#include <debug/harness.h>
+#include <verona.h>
+
+using namespace snmalloc;
+using namespace verona::rt;
+using namespace verona::rt::api;
+
+// A type whose objects all survive is pretenured after the collections
+// set_pretenure_after() asks for, and stops being once they die, while a
+// type whose objects die young never is. Pretenured objects are allocated
+// where they are not copied, and keep their values.
+
+struct Garbage : public V<Garbage>
+{
+  size_t payload[4] = {};
+};
+
+struct Node : public V<Node>
+{
+  Node* next = nullptr;
+  size_t value = 0;
+
+  void trace(ObjectStack& st) const
+  {
+    if (next != nullptr)
+      st.push(next);
+  }
+
+  void relocate(Object* (*fwd)(Object*))
+  {
+    if (next != nullptr)
+      next = (Node*)fwd(next);
+  }
+};
+
+struct Root : public V<Root>
+{
+  Node* first = nullptr;
+
+  void trace(ObjectStack& st) const
+  {
+    if (first != nullptr)
+      st.push(first);
+  }
+
+  void relocate(Object* (*fwd)(Object*))
+  {
+    if (first != nullptr)
+      first = (Node*)fwd(first);
+  }
+};
+
+static constexpr size_t NODES = 100;
+static constexpr size_t AFTER = 2;
+
+const AllocSites::Row* find(const std::vector<AllocSites::Row>& rows)
+{
+  for (auto& r : rows)
+  {
+    if (r.desc == Node::desc())
+      return &r;
+  }
+  return nullptr;
+}
+
+void push(Root* r, size_t value)
+{
+  Node* n = new Node;
+  n->value = value;
+  n->next = r->first;
+  r->first = n;
+}
+
+void collect_with_garbage()
+{
+  for (size_t i = 0; i < NODES; i++)
+    new Garbage;
+  region_collect();
+}
+
+void check_list(Root* r, size_t length)
+{
+  size_t i = length;
+  for (Node* n = r->first; n != nullptr; n = n->next)
+    check(n->value == --i);
+  check(i == 0);
+}
+
+/// Where a new Node goes: into the space that is never copied or not.
+template<RegionType type>
+size_t non_moving_count(Root* r)
+{
+  if constexpr (type == RegionType::SemiSpace)
+    return RegionSemiSpace::get(r)->get_chunk_count();
+  else
+    return RegionGenerational::get(r)->get_old_object_count();
+}
+
+template<RegionType type>
+void test_pretenure()
+{
+  AllocSites::set_pretenure_after(AFTER);
+
+  auto* r = new (type) Root;
+  {
+    UsingRegion rr(r);
+    for (size_t i = 0; i < NODES; i++)
+      push(r, i);
+
+    // Each collection finds every Node alive, and no Garbage.
+    for (size_t i = 0; i < AFTER; i++)
+    {
+      check(!find(region_alloc_sites())->pretenured);
+      collect_with_garbage();
+    }
+
+    auto rows = region_alloc_sites();
+    const AllocSites::Row* node = find(rows);
+    check(node != nullptr);
+    check(node->pretenured);
+    check(node->allocated == NODES);
+    check(node->live == NODES);
+    check(node->survival == 100);
+    check(node->streak == AFTER);
+    for (auto& row : rows)
+    {
+      if (row.desc == Garbage::desc())
+        check(!row.pretenured && row.live == 0 && row.streak == 0);
+    }
+
+    // A new Node goes where it is never copied, and still counts.
+    size_t before = non_moving_count<type>(r);
+    push(r, NODES);
+    check(non_moving_count<type>(r) == before + 1);
+    collect_with_garbage();
+    check_list(r, NODES + 1);
+    check(find(region_alloc_sites())->live == NODES + 1);
+
+    // Once the Nodes die, the site is no longer pretenured. A generational
+    // region only frees old objects in a major collection.
+    if constexpr (type == RegionType::SemiSpace)
+    {
+      r->first = nullptr;
+      collect_with_garbage();
+      node = find(region_alloc_sites());
+      check(!node->pretenured);
+      check(node->live == 0);
+      check(node->streak == 0);
+    }
+  }
+  region_release(r);
+  AllocSites::set_pretenure_after(0);
+}
+
+void test_off()
+{
+  auto* r = new (RegionType::SemiSpace) Root;
+  {
+    UsingRegion rr(r);
+    for (size_t i = 0; i < NODES; i++)
+      push(r, i);
+    region_collect();
+    check(region_alloc_sites().empty());
+    check_list(r, NODES);
+  }
+  region_release(r);
+}
+
+int main(int argc, char** argv)
+{
+  UNUSED(argc);
+  UNUSED(argv);
+
+  test_off();
+  test_pretenure<RegionType::SemiSpace>();
+  test_pretenure<RegionType::Generational>();
+
+  heap::debug_check_empty();
+  return 0;
+}
@@ -0,0 +1,53 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#include <cpp/when.h>
+#include <debug/harness.h>
+
+using namespace verona::cpp;
+
+// Mixes high and low priority behaviours, on the same cowns and on their
+// own, and checks that every one of them runs.
+
+static constexpr int rounds = 50;
+
+struct Counter
+{
+  int high = 0;
+  int low = 0;
+
+  ~Counter()
+  {
+    check(high == rounds);
+    check(low == rounds);
+  }
+};
+
+void loop(cown_ptr<Counter> c, int remaining)
+{
+  if (remaining == 0)
+    return;
+
+  when<Priority::Low>(c) << [](auto c) { c->low++; };
+
+  when(c) << [c, remaining](auto a) {
+    a->high++;
+    loop(c, remaining - 1);
+  };
+}
+
+void basic_test()
+{
+  for (int i = 0; i < 4; i++)
+    loop(make_cown<Counter>(), rounds);
+
+  when<Priority::Low>() << []() {
+    when() << []() { Logging::cout() << "High from low" << Logging::endl; };
+  };
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+  harness.run(basic_test);
+  return 0;
+}
@@ -0,0 +1,125 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#include <debug/harness.h>
+
+// Rc regions can be merged, and can have their entry point swapped. A
+// merged entry point keeps its count and becomes an ordinary object, and
+// a swapped out entry point is freed once nothing refers to it.
+
+static std::atomic<size_t> live{0};
+
+struct Node : public V<Node>
+{
+  Node* left = nullptr;
+  Node* right = nullptr;
+
+  Node()
+  {
+    live++;
+  }
+
+  ~Node()
+  {
+    live--;
+  }
+
+  void trace(ObjectStack& st) const
+  {
+    if (left != nullptr)
+      st.push(left);
+    if (right != nullptr)
+      st.push(right);
+  }
+};
+
+void test_merge(bool compact)
+{
+  RegionRc::set_compact(compact);
+
+  auto* a = new (RegionType::Rc) Node;
+  {
+    UsingRegion rr(a);
+    a->left = new Node;
+  }
+
+  auto* b = new (RegionType::Rc) Node;
+  {
+    UsingRegion rr(b);
+    b->left = new Node;
+    b->right = new Node;
+    // A reference back to the entry point, which merging keeps.
+    b->left->left = b;
+    incref(b);
+  }
+
+  {
+    UsingRegion rr(a);
+    a->right = merge(b);
+    check(debug_size() == 5);
+    check(debug_get_ref_count(b) == 2);
+
+    // Only the reference from b->left is left; dropping that frees the
+    // merged objects.
+    a->right = nullptr;
+    decref(b);
+    check(debug_get_ref_count(b) == 1);
+    b->left->left = nullptr;
+    decref(b);
+    check(debug_size() == 2);
+  }
+
+  region_release(a);
+  check(live == 0);
+  RegionRc::set_compact(false);
+}
+
+void test_swap_root()
+{
+  auto* r = new (RegionType::Rc) Node;
+  Node* n = nullptr;
+  {
+    UsingRegion rr(r);
+    n = new Node;
+    r->left = n;
+    n->left = new Node;
+
+    // Nothing else refers to r, so it goes.
+    set_entry_point(n);
+    check(debug_size() == 2);
+    check(live == 2);
+    check(debug_get_ref_count(n) == 1);
+  }
+  region_release(n);
+  check(live == 0);
+
+  r = new (RegionType::Rc) Node;
+  {
+    UsingRegion rr(r);
+    n = new Node;
+    r->left = n;
+    n->left = r;
+    incref(r);
+
+    // r is still referred to from n, so stays.
+    set_entry_point(n);
+    check(debug_size() == 2);
+    check(debug_get_ref_count(n) == 2);
+    check(debug_get_ref_count(r) == 1);
+  }
+  region_release(n);
+  check(live == 0);
+}
+
+int main(int argc, char** argv)
+{
+  UNUSED(argc);
+  UNUSED(argv);
+
+  test_merge(false);
+  if (sizeof(uintptr_t) == 8)
+    test_merge(true);
+  test_swap_root();
+
+  heap::debug_check_empty();
+  return 0;
+}
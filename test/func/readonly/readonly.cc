@@ -72,8 +72,36 @@ void test_read_only_fast_send()
     };
 }
 
+void test_read_mostly()
+{
+  // Readers of a read-mostly cown, with writers between them, and with
+  // the queue emptying while readers are still running.
+  cown_ptr<Account> account = make_cown<Account>(100);
+  account.set_read_mostly();
+
+  for (int round = 0; round < 4; round++)
+  {
+    for (int i = 0; i < 8; i++)
+    {
+      when(read(account)) << [round](acquired_cown<const Account> account) {
+        check(account->balance == 100 + round);
+      };
+    }
+
+    when(account) << [](acquired_cown<Account> account) { account->balance++; };
+  }
+
+  for (int i = 0; i < 8; i++)
+  {
+    when(read(account)) << [](acquired_cown<const Account> account) {
+      check(account->balance == 104);
+    };
+  }
+}
+
 int main(int argc, char** argv)
 {
   SystematicTestHarness harness(argc, argv);
   harness.run(test_read_only);
+  harness.run(test_read_mostly);
 }
\ No newline at end of file
@@ -0,0 +1,184 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#include <debug/harness.h>
+#include <test/opt.h>
+
+// Region::clone copies a graph of nodes with back edges to the entry point,
+// a shared node, variable sized children arrays, and a subregion, for every
+// region type that can be cloned. The clone must be a separate region with
+// the same shape, which the original does not see changes to.
+
+static std::atomic<size_t> live{0};
+
+struct Sub : public V<Sub>
+{
+  size_t id;
+
+  Sub(size_t id) : id(id)
+  {
+    live++;
+  }
+
+  ~Sub()
+  {
+    live--;
+  }
+
+  void trace(ObjectStack&) const {}
+};
+
+struct Node : public VTail<Node, Node*>
+{
+  size_t id;
+  Object* back = nullptr;
+  Sub* sub = nullptr;
+
+  Node(size_t id) : id(id)
+  {
+    live++;
+  }
+
+  ~Node()
+  {
+    live--;
+  }
+
+  void trace(ObjectStack& st) const
+  {
+    if (back != nullptr)
+      st.push(back);
+    if (sub != nullptr)
+      st.push(sub);
+  }
+
+  void relocate(Object* (*fwd)(Object*))
+  {
+    if (back != nullptr)
+      back = fwd(back);
+    if (sub != nullptr)
+      sub = (Sub*)fwd(sub);
+  }
+
+  void finaliser(Object* region, ObjectStack& sub_regions)
+  {
+    Object::add_sub_region(sub, region, sub_regions);
+  }
+};
+
+struct Root : public V<Root>
+{
+  Node* list = nullptr;
+  Node* shared = nullptr;
+
+  void trace(ObjectStack& st) const
+  {
+    if (list != nullptr)
+      st.push(list);
+    if (shared != nullptr)
+      st.push(shared);
+  }
+};
+
+static constexpr size_t length = 100;
+
+// Builds a list of nodes, each with the shared node and the next one in its
+// children array, and every tenth with a subregion of one node.
+void build(Root* r, RegionType type)
+{
+  UsingRegion rr(r);
+  if (type == RegionType::SemiSpace)
+    region_ensure_available((length + 2) * (vsizeof<Node> + 64));
+
+  r->shared = create_object_with_tail<Node>(0, length);
+  r->shared->back = r;
+  Node* prev = nullptr;
+  for (size_t i = length; i > 0; i--)
+  {
+    Node* n = create_object_with_tail<Node>(2, i - 1);
+    n->tail()[0] = r->shared;
+    n->tail()[1] = prev;
+    n->back = r;
+    if ((i - 1) % 10 == 0)
+      n->sub = new (RegionType::Arena) Sub(i - 1);
+    prev = n;
+  }
+  r->list = prev;
+
+  // Garbage, which the clone leaves behind.
+  create_object_with_tail<Node>(0, length + 1);
+}
+
+void check_shape(Root* r)
+{
+  Node* n = r->list;
+  for (size_t i = 0; i < length; i++)
+  {
+    check(n->id == i);
+    check(n->back == r);
+    check(n->tail_size() == 2);
+    check(n->tail()[0] == r->shared);
+    if ((i % 10) == 0)
+    {
+      check(n->sub != nullptr);
+      check(n->sub->id == i);
+    }
+    else
+    {
+      check(n->sub == nullptr);
+    }
+    n = n->tail()[1];
+  }
+  check(n == nullptr);
+  check(r->shared->id == length);
+  check(r->shared->back == r);
+}
+
+void test_clone(RegionType type)
+{
+  auto* r = new (type) Root;
+  build(r, type);
+  size_t before = live;
+
+  auto* c = (Root*)Region::clone(r);
+  check(Region::get_type(Region::get(c)) == type);
+  check(live == before + length + 1 + length / 10);
+  {
+    UsingRegion rr(c);
+    check_shape(c);
+    check(c->list != r->list);
+    check(c->shared != r->shared);
+    check(c->list->sub != r->list->sub);
+    check(debug_size() == 1 + length + 1);
+
+    // The clone is a region of its own.
+    c->list->id = length + 2;
+    c->list = nullptr;
+    if (type != RegionType::Arena)
+    {
+      region_collect();
+      check(debug_size() == 2);
+    }
+  }
+
+  {
+    UsingRegion rr(r);
+    check_shape(r);
+  }
+
+  region_release(c);
+  region_release(r);
+  heap::debug_check_empty();
+  check(live == 0);
+}
+
+int main(int argc, char** argv)
+{
+  opt::Opt opt(argc, argv);
+  UNUSED(opt);
+
+  for (auto type :
+       {RegionType::Trace, RegionType::Arena, RegionType::SemiSpace})
+    test_clone(type);
+
+  return 0;
+}
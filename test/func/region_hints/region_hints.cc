@@ -0,0 +1,160 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+#include <debug/harness.h>
+#include <verona.h>
+
+using namespace snmalloc;
+using namespace verona::rt;
+using namespace verona::rt::api;
+
+// Regions created with RegionHints start with their structures sized for
+// what the hints say, and with a GC policy that does not collect them
+// while they are filled.
+
+struct C : public V<C>
+{
+  C* f = nullptr;
+
+  void trace(ObjectStack& st) const
+  {
+    if (f != nullptr)
+      st.push(f);
+  }
+
+  void relocate(Object* (*fwd)(Object*))
+  {
+    if (f != nullptr)
+      f = (C*)fwd(f);
+  }
+};
+
+static constexpr size_t MiB = 1024 * 1024;
+
+void test_sizes()
+{
+  RegionHints hints;
+  hints.bytes = 8 * MiB;
+
+  auto* a = new (RegionType::Arena, hints) C;
+  check(
+    RegionArena::get(a)->get_next_chunk_size() ==
+    RegionArena::MAX_HEAP_CHUNK_SIZE);
+  region_release(a);
+  a = new (RegionType::Arena) C;
+  check(
+    RegionArena::get(a)->get_next_chunk_size() <
+    RegionArena::MAX_HEAP_CHUNK_SIZE);
+  region_release(a);
+
+  auto* s = new (RegionType::SemiSpace, hints) C;
+  check(RegionSemiSpace::get(s)->get_semispace_size() >= 8 * MiB);
+  region_release(s);
+
+  auto* c = new (RegionType::Compact, hints) C;
+  check(RegionCompact::get(c)->get_space_size() >= 8 * MiB);
+  region_release(c);
+
+  auto* g = new (RegionType::Generational, hints) C;
+  check(RegionGenerational::get(g)->get_major_threshold() == 8 * MiB);
+  region_release(g);
+  g = new (RegionType::Generational) C;
+  check(
+    RegionGenerational::get(g)->get_major_threshold() ==
+    RegionGenerational::INITIAL_MAJOR_THRESHOLD);
+  region_release(g);
+
+  // Objects stand in for bytes, at the size of the entry point.
+  RegionHints objects;
+  objects.objects = 100000;
+  s = new (RegionType::SemiSpace, objects) C;
+  check(
+    RegionSemiSpace::get(s)->get_semispace_size() >= 100000 * vsizeof<C>);
+  region_release(s);
+}
+
+void test_remembered()
+{
+  RegionHints hints;
+  hints.remembered = 1000;
+
+  auto* t = new (RegionType::Trace, hints) C;
+  check(t->get_region()->remembered_capacity() >= 1000);
+  check(t->get_region()->remembered_size() == 0);
+
+  // Filling it does not grow it.
+  size_t capacity = t->get_region()->remembered_capacity();
+  for (size_t i = 0; i < 1000; i++)
+  {
+    auto* imm = new (RegionType::Trace) C;
+    freeze(imm);
+    RegionTrace::insert<YesTransfer>(t, imm);
+  }
+  check(t->get_region()->remembered_size() == 1000);
+  check(t->get_region()->remembered_capacity() == capacity);
+  region_release(t);
+
+  t = new (RegionType::Trace) C;
+  check(t->get_region()->remembered_capacity() == 0);
+  region_release(t);
+}
+
+void test_policy()
+{
+  // The default policy collects whenever asked, and hints that say nothing
+  // of the lifetime leave it so.
+  RegionHints hints;
+  hints.bytes = 4 * MiB;
+  auto* r = new (RegionType::Trace, hints) C;
+  check(r->get_region()->gc_policy.get_kind() == GCPolicy::Kind::Always);
+  region_release(r);
+
+  hints.lifetime = RegionLifetime::Short;
+  r = new (RegionType::Trace, hints) C;
+  GCPolicy& p = r->get_region()->gc_policy;
+  check(p.get_kind() == GCPolicy::Kind::AllocationBudget);
+  check(p.get_trigger() >= 4 * MiB);
+  region_release(r);
+
+  hints.lifetime = RegionLifetime::Long;
+  r = new (RegionType::Trace, hints) C;
+  check(
+    r->get_region()->gc_policy.get_kind() == GCPolicy::Kind::HeapGrowth);
+  check(r->get_region()->gc_policy.get_trigger() == 4 * MiB);
+  region_release(r);
+
+  // A policy chosen by the default is kept, with the floor.
+  GCPolicy::set_default(GCPolicy::heap_growth());
+  hints.lifetime = RegionLifetime::Short;
+  r = new (RegionType::Trace, hints) C;
+  check(
+    r->get_region()->gc_policy.get_kind() == GCPolicy::Kind::HeapGrowth);
+  check(r->get_region()->gc_policy.get_trigger() == 4 * MiB);
+
+  // Filling the region to the hint does not ask for a collection.
+  {
+    UsingRegion rr(r);
+    C* last = r;
+    while (Region::get_memory_used(r->get_region()) < 2 * MiB)
+    {
+      last->f = new C;
+      last = last->f;
+    }
+    check(!region_maybe_collect());
+  }
+  region_release(r);
+  GCPolicy::set_default(GCPolicy::always());
+}
+
+int main(int argc, char** argv)
+{
+  UNUSED(argc);
+  UNUSED(argv);
+
+  test_sizes();
+  test_remembered();
+  test_policy();
+
+  heap::debug_check_empty();
+  return 0;
+}
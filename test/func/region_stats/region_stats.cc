@@ -0,0 +1,201 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+#include <debug/harness.h>
+#include <verona.h>
+
+using namespace snmalloc;
+using namespace verona::rt;
+using namespace verona::rt::api;
+
+// The counters of region_stats() agree with what walking the region finds,
+// after allocation and after collection, for every region type.
+
+/// Non-trivial, as it has a destructor.
+struct N : public V<N>
+{
+  N* n = nullptr;
+  size_t* destructed;
+
+  N(size_t* destructed) : destructed(destructed) {}
+
+  ~N()
+  {
+    (*destructed)++;
+  }
+
+  void trace(ObjectStack& st) const
+  {
+    if (n != nullptr)
+      st.push(n);
+  }
+
+  void relocate(Object* (*fwd)(Object*))
+  {
+    if (n != nullptr)
+      n = (N*)fwd(n);
+  }
+};
+
+struct C : public V<C>
+{
+  C* f = nullptr;
+  N* n = nullptr;
+
+  void trace(ObjectStack& st) const
+  {
+    if (f != nullptr)
+      st.push(f);
+    if (n != nullptr)
+      st.push(n);
+  }
+
+  void relocate(Object* (*fwd)(Object*))
+  {
+    if (f != nullptr)
+      f = (C*)fwd(f);
+    if (n != nullptr)
+      n = (N*)fwd(n);
+  }
+};
+
+static constexpr size_t NODES = 1000;
+static constexpr size_t NON_TRIVIAL = NODES / 4;
+
+template<RegionType type>
+void test_objects(bool collect)
+{
+  size_t destructed = 0;
+  auto* r = new (type) C;
+  {
+    UsingRegion rr(r);
+    check(region_stats().objects == 1);
+
+    C* last = r;
+    for (size_t i = 0; i < NODES; i++)
+    {
+      last->f = new C;
+      last = last->f;
+    }
+
+    r->n = new N(&destructed);
+    N* tail = r->n;
+    for (size_t i = 1; i < NON_TRIVIAL; i++)
+    {
+      tail->n = new N(&destructed);
+      tail = tail->n;
+    }
+
+    RegionStats stats = region_stats();
+    check(stats.objects == NODES + NON_TRIVIAL + 1);
+    check(stats.objects == debug_size());
+    check(stats.bytes == debug_memory_used());
+    check(stats.trivial == NODES + 1);
+    check(stats.non_trivial == NON_TRIVIAL);
+
+    if (collect)
+    {
+      C* mid = r;
+      for (size_t i = 0; i < NODES / 2; i++)
+        mid = mid->f;
+      mid->f = nullptr;
+      N* n = r->n;
+      for (size_t i = 1; i < NON_TRIVIAL / 2; i++)
+        n = n->n;
+      n->n = nullptr;
+      region_collect();
+
+      stats = region_stats();
+      check(stats.objects == NODES / 2 + NON_TRIVIAL / 2 + 1);
+      check(stats.objects == debug_size());
+      check(stats.bytes == debug_memory_used());
+      check(stats.trivial == NODES / 2 + 1);
+      check(stats.non_trivial == NON_TRIVIAL / 2);
+      check(destructed == NON_TRIVIAL - NON_TRIVIAL / 2);
+    }
+  }
+  region_release(r);
+  check(destructed == NON_TRIVIAL);
+}
+
+void test_chunks()
+{
+  auto* a = new (RegionType::Arena) C;
+  {
+    UsingRegion rr(a);
+    size_t before = region_stats().chunks;
+    check(before >= 1);
+    for (size_t i = 0; i < 100 * NODES; i++)
+      new C;
+    check(region_stats().chunks > before);
+  }
+  region_release(a);
+
+  auto* s = new (RegionType::SemiSpace) C;
+  {
+    UsingRegion rr(s);
+    check(region_stats().chunks == 1);
+  }
+  region_release(s);
+
+  // Only a paged trace region shares memory between its objects.
+  auto* t = new (RegionType::Trace) C;
+  {
+    UsingRegion rr(t);
+    check(region_stats().chunks == 0);
+  }
+  region_release(t);
+
+  RegionTrace::set_paged(true);
+  t = new (RegionType::Trace) C;
+  {
+    UsingRegion rr(t);
+    check(region_stats().chunks >= 1);
+  }
+  region_release(t);
+  RegionTrace::set_paged(false);
+}
+
+void test_references()
+{
+  auto* r = new (RegionType::Trace) C;
+  {
+    UsingRegion rr(r);
+    r->f = new C;
+    check(region_stats().remembered == 0);
+    check(region_stats().external_refs == 0);
+
+    for (size_t i = 0; i < 10; i++)
+    {
+      auto* imm = new (RegionType::Trace) C;
+      freeze(imm);
+      RegionTrace::insert<YesTransfer>(r, imm);
+    }
+    check(region_stats().remembered == 10);
+
+    auto* e1 = create_external_reference(r);
+    auto* e2 = create_external_reference(r->f);
+    check(region_stats().external_refs == 2);
+    Immutable::release(e1);
+    Immutable::release(e2);
+  }
+  region_release(r);
+}
+
+int main(int argc, char** argv)
+{
+  UNUSED(argc);
+  UNUSED(argv);
+
+  test_objects<RegionType::Trace>(true);
+  test_objects<RegionType::Arena>(false);
+  test_objects<RegionType::Rc>(false);
+  test_objects<RegionType::SemiSpace>(true);
+  test_objects<RegionType::Generational>(true);
+  test_objects<RegionType::Compact>(true);
+  test_chunks();
+  test_references();
+
+  heap::debug_check_empty();
+  return 0;
+}
@@ -0,0 +1,79 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+#include <debug/harness.h>
+
+// A behaviour builds a tree of regions of several types and hands it to
+// region_release_async(). The regions are released by later low priority
+// closures, one region at a time, so every object must be gone by the
+// time the runtime stops.
+
+static std::atomic<size_t> live{0};
+
+struct Node : public V<Node>
+{
+  Node* next = nullptr;
+  Node* sub = nullptr;
+
+  Node()
+  {
+    live++;
+  }
+
+  ~Node()
+  {
+    live--;
+  }
+
+  void trace(ObjectStack& st) const
+  {
+    if (next != nullptr)
+      st.push(next);
+    if (sub != nullptr)
+      st.push(sub);
+  }
+
+  void finaliser(Object* region, ObjectStack& sub_regions)
+  {
+    Object::add_sub_region(sub, region, sub_regions);
+  }
+};
+
+static constexpr size_t depth = 4;
+static constexpr size_t length = 100;
+
+static const RegionType types[] = {
+  RegionType::Trace, RegionType::SemiSpace, RegionType::Rc, RegionType::Arena};
+
+Node* build(size_t level)
+{
+  Node* sub = (level + 1 < depth) ? build(level + 1) : nullptr;
+  auto* root = new (types[level % std::size(types)]) Node;
+  root->sub = sub;
+
+  UsingRegion rr(root);
+  Node* n = root;
+  for (size_t i = 0; i < length; i++)
+  {
+    n->next = new Node;
+    n = n->next;
+  }
+  return root;
+}
+
+void test_release_async()
+{
+  schedule_lambda([]() {
+    Node* r = build(0);
+    check(live == depth * (length + 1));
+    region_release_async(r);
+  });
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+  harness.run(test_release_async);
+  check(live == 0);
+  return 0;
+}
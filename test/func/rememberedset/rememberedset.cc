@@ -147,6 +147,104 @@ void merge_test()
   heap::debug_check_empty();
 }
 
+/**
+ * Tests that a collection keeps exactly the reachable entries of a large
+ * remembered set, sized up front, and that a collection with nothing to
+ * drop keeps them all.
+ **/
+void sweep_test()
+{
+  RememberedSet::set_capacity_hint(100);
+  auto* r = new (RegionType::Trace) C1;
+  RememberedSet::set_capacity_hint(0);
+
+  C1* imms[100];
+  for (auto*& imm : imms)
+  {
+    imm = new (RegionType::Trace) C1;
+    freeze(imm);
+    Immutable::acquire(imm);
+    RegionTrace::insert<YesTransfer>(r, imm);
+    check(imm->debug_rc() == 2);
+  }
+
+  r->f1 = imms[10];
+  r->f2 = imms[20];
+  RegionTrace::gc(r);
+  for (size_t i = 0; i < 100; i++)
+    check(imms[i]->debug_rc() == ((i == 10) || (i == 20) ? 2 : 1));
+
+  RegionTrace::gc(r);
+  check(imms[10]->debug_rc() == 2 && imms[20]->debug_rc() == 2);
+
+  for (auto* imm : imms)
+    Immutable::release(imm);
+  region_release(r);
+
+  heap::debug_check_empty();
+}
+
+/**
+ * Tests that marking an entry referenced from many objects, or entries
+ * sharing a slot of the mark filter, counts each entry once.
+ **/
+void shared_target_test()
+{
+  auto* r = new (RegionType::Trace) C1;
+
+  C1* imms[300];
+  for (auto*& imm : imms)
+  {
+    imm = new (RegionType::Trace) C1;
+    freeze(imm);
+  }
+
+  {
+    UsingRegion rr(r);
+
+    // A list of objects, all referring to the first two immutables, and
+    // then to every one of them.
+    C1* prev = r;
+    for (size_t i = 0; i < 1000; i++)
+    {
+      auto* c = new C1;
+      Immutable::acquire(imms[i % 2]);
+      RegionTrace::insert<YesTransfer>(r, imms[i % 2]);
+      c->f2 = imms[i % 2];
+      prev->f1 = c;
+      prev = c;
+    }
+    for (auto* imm : imms)
+    {
+      auto* c = new C1;
+      Immutable::acquire(imm);
+      RegionTrace::insert<YesTransfer>(r, imm);
+      c->f2 = imm;
+      prev->f1 = c;
+      prev = c;
+    }
+  }
+
+  for (size_t n = 0; n < 2; n++)
+  {
+    RegionTrace::gc(r);
+    for (auto* imm : imms)
+      check(imm->debug_rc() == 2);
+  }
+
+  // Dropping the list drops every entry.
+  r->f1 = nullptr;
+  RegionTrace::gc(r);
+  for (auto* imm : imms)
+    check(imm->debug_rc() == 1);
+
+  for (auto* imm : imms)
+    Immutable::release(imm);
+  region_release(r);
+
+  heap::debug_check_empty();
+}
+
 int main(int argc, char** argv)
 {
   (void)argc;
@@ -158,5 +256,8 @@ int main(int argc, char** argv)
   merge_test<RegionType::Trace>();
   merge_test<RegionType::Arena>();
 
+  sweep_test();
+  shared_target_test();
+
   return 0;
 }
\ No newline at end of file
@@ -0,0 +1,115 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#include <debug/harness.h>
+#include <test/opt.h>
+#include <vector>
+
+// An entry point holds an rvector of objects, an rvector of integers and an
+// rstring, and a standard vector with a region_allocator where the region
+// does not move objects. Their buffers are objects of the region, so they
+// are counted in it and survive collections, whose moves they follow.
+
+struct Item : public V<Item>
+{
+  size_t value;
+
+  Item(size_t v) : value(v) {}
+
+  void trace(ObjectStack&) const {}
+};
+
+struct Holder : public V<Holder>
+{
+  rvector<Item*> items;
+  rvector<size_t> values;
+  rstring name;
+  std::vector<size_t, region_allocator<size_t>> plain;
+
+  void trace(ObjectStack& st) const
+  {
+    items.trace(st);
+    values.trace(st);
+    name.trace(st);
+    if (plain.data() != nullptr)
+      st.push(RegionBuffer::of(plain.data()));
+  }
+
+  void relocate(Object* (*fwd)(Object*))
+  {
+    items.relocate(fwd);
+    values.relocate(fwd);
+    name.relocate(fwd);
+  }
+};
+
+static constexpr size_t count = 1000;
+
+void check_contents(Holder* h, bool plain)
+{
+  check(h->items.size() == count);
+  check(h->values.size() == count);
+  for (size_t i = 0; i < count; i++)
+  {
+    check(h->items[i]->value == i);
+    check(h->values[i] == i * i);
+  }
+  check(h->name == "region vector");
+  check(h->name.size() == 13);
+  if (plain)
+  {
+    check(h->plain.size() == count);
+    for (size_t i = 0; i < count; i++)
+      check(h->plain[i] == i + 1);
+  }
+}
+
+void test_rvector(RegionType type)
+{
+  bool plain = type == RegionType::Trace || type == RegionType::Rc;
+
+  auto* h = new (type) Holder;
+  {
+    UsingRegion rr(h);
+    size_t before = debug_memory_used();
+
+    for (size_t i = 0; i < count; i++)
+    {
+      // Growing first, so that a collection the item's allocation causes
+      // finds the vector with room for it.
+      h->items.reserve(i + 1);
+      h->items.push_back(new Item(i));
+      h->values.push_back(i * i);
+      if (plain)
+        h->plain.push_back(i + 1);
+    }
+    h->name = "region";
+    h->name.append(" vector");
+    check(debug_memory_used() > before + count * sizeof(size_t));
+    check_contents(h, plain);
+
+    if (type != RegionType::Arena)
+    {
+      region_collect();
+      check_contents(h, plain);
+    }
+  }
+  region_release(h);
+  heap::debug_check_empty();
+}
+
+int main(int argc, char** argv)
+{
+  opt::Opt opt(argc, argv);
+  UNUSED(opt);
+
+  for (auto type :
+       {RegionType::Trace,
+        RegionType::Arena,
+        RegionType::Rc,
+        RegionType::SemiSpace,
+        RegionType::Generational,
+        RegionType::Compact})
+    test_rvector(type);
+
+  return 0;
+}
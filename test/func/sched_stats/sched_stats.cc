@@ -0,0 +1,57 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#include <cpp/when.h>
+#include <debug/harness.h>
+
+using namespace verona::cpp;
+
+// Reads the scheduler statistics from a behaviour while the pool runs, and
+// checks they account for the chain of behaviours that led to it. Nothing
+// is counted without USE_SCHED_STATS.
+
+static constexpr size_t rounds = 100;
+
+struct Counter
+{
+  size_t count = 0;
+};
+
+size_t cores = 0;
+
+void check_snapshot()
+{
+  auto per_core = Scheduler::core_stats_snapshots();
+  check(per_core.size() == cores);
+
+  auto s = Scheduler::stats_snapshot();
+#ifdef USE_SCHED_STATS
+  // Each behaviour of the chain was created, and waited for its cown,
+  // before the one that created the next released it.
+  check(s.behaviours[1] >= rounds);
+  check(s.queue_wait.count() >= rounds);
+  check(s.queue_wait.percentile(50) <= s.queue_wait.max());
+#else
+  check(s.behaviours[1] == 0);
+  check(s.queue_wait.count() == 0);
+  check(s.run_time.count() == 0);
+  check(s.fair_passes == 0);
+#endif
+}
+
+void loop(cown_ptr<Counter> c)
+{
+  when(c) << [c](auto a) {
+    if (++a->count == rounds)
+      check_snapshot();
+    else
+      loop(c);
+  };
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+  cores = harness.cores;
+  harness.run([]() { loop(make_cown<Counter>()); });
+  return 0;
+}
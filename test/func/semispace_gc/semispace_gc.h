@@ -4,6 +4,8 @@
 
 #include "../memory/memory.h"
 
+#include <vector>
+
 namespace semispace_gc
 {
   /**
@@ -77,6 +79,125 @@ namespace semispace_gc
     }
   };
 
+  // A large object with a pointer back into from-space.
+  struct BigNode : public V<BigNode>
+  {
+    C1* child = nullptr;
+    uint8_t payload[LARGE_BODY];
+
+    void trace(ObjectStack& st) const
+    {
+      if (child != nullptr)
+        st.push(child);
+    }
+
+    void relocate(Object* (*fwd)(Object*))
+    {
+      if (child != nullptr)
+        child = (C1*)fwd(child);
+    }
+  };
+
+  // Root for the parallel copy test: trivial, non-trivial and large
+  // children.
+  struct ParallelRoot : public V<ParallelRoot>
+  {
+    C1* tree = nullptr;
+    F1* list = nullptr;
+    BigNode* big = nullptr;
+
+    void trace(ObjectStack& st) const
+    {
+      if (tree != nullptr)
+        st.push(tree);
+      if (list != nullptr)
+        st.push(list);
+      if (big != nullptr)
+        st.push(big);
+    }
+
+    void relocate(Object* (*fwd)(Object*))
+    {
+      if (tree != nullptr)
+        tree = (C1*)fwd(tree);
+      if (list != nullptr)
+        list = (F1*)fwd(list);
+      if (big != nullptr)
+        big = (BigNode*)fwd(big);
+    }
+  };
+
+  // A list node whose link is a 32-bit region_ptr.
+  struct CompactNode : public V<CompactNode>
+  {
+    region_ptr<CompactNode> next;
+    uint32_t value = 0;
+
+    void trace(ObjectStack& st) const
+    {
+      if (next)
+        st.push(next.get());
+    }
+
+    void relocate(Object* (*fwd)(Object*))
+    {
+      next.relocate(fwd);
+    }
+  };
+
+  // A node whose references are named by fields(), and which keeps the
+  // address of an object it does not reference as an integer.
+  struct FieldNode : public V<FieldNode>
+  {
+    FieldNode* left = nullptr;
+    FieldNode* right = nullptr;
+    uintptr_t cookie = 0;
+
+    template<typename F>
+    void fields(F&& f)
+    {
+      f(left);
+      f(right);
+    }
+  };
+
+  // As FieldNode, but with only a trace, so relocated from it.
+  struct TracedNode : public V<TracedNode>
+  {
+    FieldNode* node = nullptr;
+    TracedNode* next = nullptr;
+    uintptr_t cookie = 0;
+
+    void trace(ObjectStack& st) const
+    {
+      if (node != nullptr)
+        st.push(node);
+      if (next != nullptr)
+        st.push(next);
+    }
+  };
+
+  // Append `n` chunks to the chain hanging off `root`. Allocation may grow
+  // the semispace and move the chain, so the tail is found again each time.
+  inline void append_chunks(Chunk* root, size_t n)
+  {
+    for (size_t i = 0; i < n; i++)
+    {
+      auto* c = new Chunk;
+      Chunk* tail = root;
+      while (tail->next != nullptr)
+        tail = tail->next;
+      tail->next = c;
+    }
+  }
+
+  inline size_t count_tree(C1* n)
+  {
+    if (n == nullptr)
+      return 0;
+    return 1 + count_tree(n->f1) + count_tree(n->f2);
+  }
+
   // ---------------------------------------------------------------------------
   // Original functional tests
   // ---------------------------------------------------------------------------
@@ -543,8 +664,8 @@ namespace semispace_gc
   }
 
   /**
-   * Test 11: After GC collects garbage the semispace size is preserved
-   * (it does not shrink), and memory-used / object-count are correct.
+   * Test 11: After GC collects garbage the semispace size never drops
+   * below INITIAL, and memory-used / object-count are correct.
    * Also verifies that large objects are freed by GC when unreachable.
    *
    * Graph:  root -> a -> b
@@ -595,7 +716,7 @@ namespace semispace_gc
       check(debug_size() == 2);          // root, a
       check(debug_large_object_count() == 0);
 
-      // Semispace size should still be at least INITIAL (never shrinks).
+      // Semispace size should still be at least INITIAL (the shrink floor).
       check(debug_semispace_size() >= RegionSemiSpace::INITIAL_SEMISPACE_SIZE);
     }
 
@@ -603,10 +724,922 @@ namespace semispace_gc
     heap::debug_check_empty();
   }
 
+  /**
+   * Test 12: Non-trivial objects are finalised and destructed exactly
+   * once, whether they die in a collection (after surviving earlier ones)
+   * or are still live when the region is released. Trivial garbage is
+   * interleaved to check it is skipped without disturbing the side table.
+   */
+  void test_non_trivial_finalisation()
+  {
+    live_count = 0;
+    auto* root = new (RegionType::SemiSpace) F1;
+
+    {
+      UsingRegion rr(root);
+
+      region_ensure_available(3 * vsizeof<F1> + 3 * vsizeof<C1>);
+
+      auto* a = new F1;
+      new C1;
+      auto* b = new F1;
+      new C1;
+      auto* c = new F1;
+      new C1;
+
+      root->f1 = a;
+      a->f1 = b;
+      root->f2 = c;
+      check(live_count == 4);
+      check(debug_size() == 7);
+
+      // c dies; a and b survive and are moved to the new from-space.
+      root->f2 = nullptr;
+      region_collect();
+      check(live_count == 3);
+      check(debug_size() == 3); // root, a, b
+
+      // Survivors of the previous GC must still be tracked.
+      root->f1->f1 = nullptr;
+      region_collect();
+      check(live_count == 2);
+      check(debug_size() == 2); // root, a
+
+      // Leave a live non-trivial object for release to clean up.
+      root->f2 = new F1;
+      check(live_count == 3);
+    }
+
+    region_release(root);
+    check(live_count == 0);
+    heap::debug_check_empty();
+  }
+
+  /**
+   * Test 14: The sizing policy shrinks the spaces once live data has
+   * dropped, grows them ahead of the live size, and keeps both spaces
+   * within the memory budget.
+   */
+  void test_semispace_resizing()
+  {
+    constexpr size_t initial = RegionSemiSpace::INITIAL_SEMISPACE_SIZE;
+    auto* root = new (RegionType::SemiSpace) Chunk;
+
+    {
+      UsingRegion rr(root);
+
+      // A spike of live data grows the space to 8MB.
+      append_chunks(root, 40);
+      check(debug_semispace_size() == 8 * initial);
+
+      // Once the spike is gone, one collection shrinks it to the floor.
+      root->next = nullptr;
+      region_collect();
+      check(debug_semispace_size() == initial);
+      check(debug_size() == 1);
+
+      // Live data near the target occupancy keeps the size stable...
+      append_chunks(root, 3);
+      region_collect();
+      region_collect();
+      check(debug_semispace_size() == initial);
+
+      // ...and above it, the spaces grow without running out first. The
+      // empty to-space grows at once, from-space on the next collection.
+      append_chunks(root, 2);
+      region_collect();
+      region_collect();
+      check(debug_semispace_size() == 2 * initial);
+      check(debug_size() == 6);
+
+      // Live data just above a quarter of the 2MB space is not enough of
+      // a drop to shrink it.
+      root->next->next->next = nullptr;
+      region_collect();
+      region_collect();
+      check(debug_semispace_size() == 2 * initial);
+    }
+
+    region_release(root);
+
+    // A budget of 4MB for both spaces keeps each at 2MB, although the
+    // occupancy target alone would ask for 4MB.
+    RegionSemiSpace::set_memory_budget(4 * initial);
+    root = new (RegionType::SemiSpace) Chunk;
+    {
+      UsingRegion rr(root);
+
+      append_chunks(root, 12);
+      check(debug_semispace_size() == 2 * initial);
+      region_collect();
+      region_collect();
+      check(debug_semispace_size() == 2 * initial);
+
+      RegionSemiSpace::set_memory_budget(0);
+      region_collect();
+      region_collect();
+      check(debug_semispace_size() == 4 * initial);
+      check(debug_size() == 13);
+    }
+
+    region_release(root);
+    heap::debug_check_empty();
+  }
+
+  /**
+   * Test 15: Growing is a collection. A from-space full of garbage is
+   * reclaimed instead of being doubled, and the allocation that triggered
+   * growth is counted once the collection's metrics are in place.
+   */
+  void test_grow_collects()
+  {
+    live_count = 0;
+    auto* root = new (RegionType::SemiSpace) F1;
+
+    {
+      UsingRegion rr(root);
+
+      root->f1 = new F1;
+      size_t semispace = debug_semispace_size();
+      while (debug_fromspace_used() + vsizeof<F1> <= semispace)
+        new F1;
+      check(live_count > 2);
+
+      // This allocation does not fit, so it grows the space by collecting.
+      root->f2 = new F1;
+      check(debug_semispace_size() == semispace);
+      check(live_count == 3);
+      check(debug_size() == 3);
+      check(debug_memory_used() == 3 * vsizeof<F1>);
+      check(root->f1 != nullptr && root->f2 != nullptr);
+    }
+
+    region_release(root);
+    check(live_count == 0);
+    heap::debug_check_empty();
+  }
+
+  /**
+   * Test 16: With virtual spaces, memory is committed as allocation
+   * advances, growth within the reservation does not move objects, and a
+   * collection leaves only the survivors' pages committed.
+   */
+  void test_virtual_spaces()
+  {
+    RegionSemiSpace::set_virtual_spaces(true);
+    auto* root = new (RegionType::SemiSpace) Chunk;
+
+    {
+      UsingRegion rr(root);
+
+      check(debug_semispace_size() == RegionSemiSpace::VIRTUAL_SPACE_RESERVE);
+      check(debug_semispace_committed() == 0);
+
+      auto* first = new Chunk;
+      root->next = first;
+      check(
+        debug_semispace_committed() ==
+        snmalloc::bits::align_up(vsizeof<Chunk>, pal::VM_GRANULE));
+
+      // Far more than INITIAL_SEMISPACE_SIZE fits without moving anything.
+      append_chunks(root, 40);
+      check(root->next == first);
+      check(debug_semispace_committed() >= 41 * vsizeof<Chunk>);
+      check(debug_size() == 42);
+
+      // Keep two chunks; the emptied space is given back.
+      first->next->next = nullptr;
+      region_collect();
+      check(debug_size() == 3);
+      check(
+        debug_semispace_committed() ==
+        snmalloc::bits::align_up(2 * vsizeof<Chunk>, pal::VM_GRANULE));
+      check(debug_semispace_size() == RegionSemiSpace::VIRTUAL_SPACE_RESERVE);
+
+      // Allocation after a collection commits again on demand.
+      append_chunks(root, 4);
+      region_collect();
+      check(debug_size() == 7);
+    }
+
+    region_release(root);
+    RegionSemiSpace::set_virtual_spaces(false);
+    heap::debug_check_empty();
+  }
+
+  /**
+   * Test 17: With a lower large object threshold, mid-size objects share
+   * slab chunks of the large object space. They never move, dead ones with
+   * finalisers are finalised by the collection, and the rest of the space
+   * is swept lazily: the chunks of dead objects are only reclaimed when an
+   * allocation needs room.
+   */
+  void test_large_object_space()
+  {
+    live_count = 0;
+    auto* root = new (RegionType::SemiSpace, 64 * 1024) Chunk;
+
+    {
+      UsingRegion rr(root);
+
+      // Four 128KB chunks fit in a slab chunk.
+      append_chunks(root, 10);
+      check(debug_large_object_count() == 10);
+      check(debug_large_chunk_count() == 3);
+      check(debug_fromspace_used() == 0);
+
+      Chunk* first = root->next;
+      region_collect();
+      check(root->next == first);
+      check(debug_size() == 11);
+
+      // Garbage with finalisers on both sides of the threshold.
+      new F2<8 * 1024>;
+      new F2<96 * 1024>;
+      check(live_count == 2);
+      check(debug_large_object_count() == 11);
+      check(debug_large_chunk_count() == 4);
+
+      first->next->next = nullptr;
+      region_collect();
+      check(live_count == 0);
+      check(debug_large_object_count() == 2);
+      check(debug_size() == 3);
+      check(debug_large_chunk_count() == 4);
+
+      // The next allocation sweeps until it finds a free slot, which it
+      // reuses; the next collection finishes the sweep.
+      append_chunks(root, 1);
+      check(debug_large_chunk_count() <= 4);
+      check(debug_large_object_count() == 3);
+      check(debug_size() == 4);
+
+      region_collect();
+      check(root->next == first);
+      check(debug_large_chunk_count() == 1);
+      check(debug_size() == 4);
+    }
+
+    region_release(root);
+    heap::debug_check_empty();
+  }
+
+  /**
+   * Test 18: A hierarchical copy keeps the same survivors as a Cheney copy,
+   * but copies each subtree right after the node that holds it: down the
+   * left spine of a tree allocated in breadth-first order, the children of
+   * a node's left child directly follow its right child. Copies that
+   * overflow the copy stack are still scanned, and nothing is left marked
+   * for the next collection.
+   */
+  void test_hierarchical_copy()
+  {
+    RegionSemiSpace::set_copy_order(RegionSemiSpace::CopyOrder::Hierarchical);
+    auto* root = new (RegionType::SemiSpace) C1;
+
+    {
+      UsingRegion rr(root);
+
+      constexpr size_t tree_nodes = (1 << 12) - 1;
+      std::vector<C1*> nodes(tree_nodes);
+      for (auto& n : nodes)
+      {
+        n = new C1;
+        new C1;
+      }
+      for (size_t i = 0; 2 * i + 2 < tree_nodes; i++)
+      {
+        nodes[i]->f1 = nodes[2 * i + 1];
+        nodes[i]->f2 = nodes[2 * i + 2];
+      }
+      root->f1 = nodes[0];
+
+      // A spine with a leaf on every node leaves one leaf per level on the
+      // copy stack, so it overflows.
+      constexpr size_t spine_len = 4 * RegionSemiSpace::COPY_STACK_DEPTH;
+      C1* spine = nullptr;
+      for (size_t i = 0; i < spine_len; i++)
+      {
+        auto* n = new C1;
+        n->f1 = spine;
+        n->f2 = new C1;
+        spine = n;
+      }
+      root->f2 = spine;
+      check(debug_size() == 1 + 2 * tree_nodes + 2 * spine_len);
+
+      for (int i = 0; i < 2; i++)
+      {
+        region_collect();
+        check(debug_size() == 1 + tree_nodes + 2 * spine_len);
+        check(count_tree(root->f1) == tree_nodes);
+
+        size_t len = 0;
+        for (C1* n = root->f2; n != nullptr; n = n->f1)
+        {
+          check(n->f2 != nullptr && n->f2->f1 == nullptr);
+          len++;
+        }
+        check(len == spine_len);
+
+        for (C1* n = root->f1; n->f1->f1 != nullptr; n = n->f1)
+          check((std::byte*)n->f1->f1 == (std::byte*)n->f2 + vsizeof<C1>);
+      }
+    }
+
+    region_release(root);
+    RegionSemiSpace::set_copy_order(RegionSemiSpace::CopyOrder::BreadthFirst);
+    heap::debug_check_empty();
+  }
+
   // ---------------------------------------------------------------------------
   // Test runner
   // ---------------------------------------------------------------------------
 
+  /**
+   * Test 13: With several GC threads, a large region is copied in parallel
+   * and ends up exactly as a single-threaded copy would leave it: the same
+   * survivors, finalisers run once, and large objects keep what they
+   * reference alive. A from-space that is nearly all live makes the copy
+   * enlarge to-space first.
+   */
+  void test_parallel_copy()
+  {
+    RegionSemiSpace::set_gc_threads(4);
+    live_count = 0;
+    auto* root = new (RegionType::SemiSpace) ParallelRoot;
+
+    {
+      UsingRegion rr(root);
+
+      constexpr size_t tree_nodes = (1 << 14) - 1;
+      constexpr size_t list_len = 1000;
+      region_ensure_available(
+        (2 * tree_nodes + 1) * vsizeof<C1> + 2 * list_len * vsizeof<F1>);
+
+      // A complete binary tree with a garbage object next to every node.
+      std::vector<C1*> nodes(tree_nodes);
+      for (auto& n : nodes)
+      {
+        n = new C1;
+        new C1;
+      }
+      for (size_t i = 0; 2 * i + 2 < tree_nodes; i++)
+      {
+        nodes[i]->f1 = nodes[2 * i + 1];
+        nodes[i]->f2 = nodes[2 * i + 2];
+      }
+      root->tree = nodes[0];
+
+      // A list of finalisable objects, again interleaved with garbage.
+      for (size_t i = 0; i < list_len; i++)
+      {
+        auto* f = new F1;
+        f->f1 = root->list;
+        root->list = f;
+        new F1;
+      }
+
+      root->big = new BigNode;
+      root->big->child = new C1;
+
+      check(debug_fromspace_used() >= RegionSemiSpace::PARALLEL_GC_MIN_BYTES);
+      check(live_count == 2 * list_len);
+
+      region_collect();
+      check(live_count == list_len);
+      check(debug_size() == 1 + tree_nodes + list_len + 2);
+      check(count_tree(root->tree) == tree_nodes);
+      check(root->big->child != nullptr);
+      check(root->big->child->f1 == nullptr);
+
+      size_t len = 0;
+      for (F1* f = root->list; f != nullptr; f = f->f1)
+        len++;
+      check(len == list_len);
+
+      // Drop half of the tree; the survivors are copied in parallel again.
+      root->tree->f2 = nullptr;
+      region_collect();
+      check(count_tree(root->tree) == (tree_nodes + 1) / 2);
+      check(debug_size() == 1 + (tree_nodes + 1) / 2 + list_len + 2);
+      check(live_count == list_len);
+    }
+
+    region_release(root);
+    check(live_count == 0);
+
+    // Fill from-space to the brim with live objects.
+    root = new (RegionType::SemiSpace) ParallelRoot;
+    {
+      UsingRegion rr(root);
+
+      size_t semispace = debug_semispace_size();
+      size_t count = 0;
+      while (debug_fromspace_used() + vsizeof<C1> <= semispace)
+      {
+        auto* c = new C1;
+        c->f1 = root->tree;
+        root->tree = c;
+        count++;
+      }
+      check(debug_semispace_size() == semispace);
+
+      region_collect();
+      check(debug_semispace_size() > semispace);
+      check(debug_size() == 1 + count);
+
+      size_t len = 0;
+      for (C1* c = root->tree; c != nullptr; c = c->f1)
+        len++;
+      check(len == count);
+    }
+
+    region_release(root);
+    RegionSemiSpace::set_gc_threads(1);
+    heap::debug_check_empty();
+  }
+
+  /**
+   * Test 19: Objects allocated through a cursor are counted once it is
+   * flushed, and collections it triggers keep the objects reachable from
+   * the root.
+   **/
+  void test_alloc_cursor()
+  {
+    live_count = 0;
+    auto* root = new (RegionType::SemiSpace) F1;
+    size_t kept = 0;
+
+    {
+      UsingRegion rr(root);
+      size_t semispace = debug_semispace_size();
+      size_t n = 4 * semispace / vsizeof<F1>;
+
+      {
+        auto cursor = region_alloc_cursor();
+        for (size_t i = 0; i < n; i++)
+        {
+          auto* p = cursor.create<F1>();
+          if (i % 10 == 0)
+          {
+            p->f1 = root->f1;
+            root->f1 = p;
+            kept++;
+          }
+        }
+      }
+
+      // Running out of from-space collected the garbage at least once.
+      check(debug_size() < 1 + n);
+      region_collect();
+      check(debug_size() == 1 + kept);
+      check(debug_memory_used() == (1 + kept) * vsizeof<F1>);
+      check(live_count == (int)(1 + kept));
+
+      size_t len = 0;
+      for (F1* p = root->f1; p != nullptr; p = p->f1)
+        len++;
+      check(len == kept);
+
+      // The region allocates normally once the cursor is gone.
+      root->f2 = new F1;
+      check(debug_size() == 2 + kept);
+    }
+
+    region_release(root);
+    check(live_count == 0);
+    heap::debug_check_empty();
+  }
+
+  /**
+   * Test 20: region_ptr fields follow their targets through collections,
+   * whichever way the survivors are copied.
+   **/
+  void test_region_ptr()
+  {
+    for (size_t threads : {1, 4})
+    {
+      RegionSemiSpace::set_gc_threads(threads);
+      auto* root = new (RegionType::SemiSpace) CompactNode;
+
+      {
+        UsingRegion rr(root);
+        for (uint32_t i = 1; i <= 1000; i++)
+        {
+          auto* n = new CompactNode;
+          n->value = i;
+          n->next = root->next;
+          root->next = n;
+          new CompactNode;
+        }
+        check(debug_size() == 1 + 2000);
+
+        for (int round = 0; round < 2; round++)
+        {
+          region_collect();
+          check(debug_size() == 1 + 1000);
+
+          uint32_t expected = 1000;
+          for (CompactNode* n = root->next; n != nullptr; n = n->next)
+            check(n->value == expected--);
+          check(expected == 0);
+        }
+      }
+
+      region_release(root);
+      heap::debug_check_empty();
+    }
+    RegionSemiSpace::set_gc_threads(1);
+  }
+
+  /**
+   * Test 21: Merging a region moves none of its objects: its root and its
+   * from-space objects keep their addresses, and its large objects stay
+   * large. The next collection copies the survivors of both regions into
+   * one to-space, and finalises the dead objects of either. A region
+   * released with spaces still adopted frees them.
+   */
+  void test_merge()
+  {
+    live_count = 0;
+    auto* root = new (RegionType::SemiSpace) F1;
+    auto* other = new (RegionType::SemiSpace) F1;
+
+    {
+      UsingRegion rr(root);
+      root->f1 = new F1;
+    }
+
+    F1* kept;
+    {
+      UsingRegion rr(other);
+      kept = new F1;
+      other->f1 = kept;
+      other->f2 = new F1;
+      new F2<96 * 1024>;
+      new F2<600 * 1024>;
+    }
+    check(live_count == 7);
+
+    {
+      UsingRegion rr(root);
+      merge(other);
+      check(!other->debug_is_iso());
+      check(other->f1 == kept);
+      check(debug_size() == 7);
+      check(debug_large_object_count() == 1);
+
+      // Keep the old root and one of its children.
+      root->f2 = other;
+      other->f2 = nullptr;
+      region_collect();
+      check(live_count == 4);
+      check(debug_size() == 4);
+      check(debug_large_object_count() == 0);
+      check(root->f2 != other);
+      check(root->f2->f1 != nullptr);
+      check(debug_memory_used() == 4 * vsizeof<F1>);
+
+      region_collect();
+      check(debug_size() == 4);
+    }
+
+    auto* third = new (RegionType::SemiSpace) F1;
+    {
+      UsingRegion rr(third);
+      third->f1 = new F1;
+      new F2<600 * 1024>;
+    }
+
+    {
+      UsingRegion rr(root);
+      merge(third);
+      check(debug_size() == 7);
+    }
+
+    region_release(root);
+    check(live_count == 0);
+    heap::debug_check_empty();
+  }
+
+  /**
+   * Test 22: A region with a small initial size starts with a from-space of
+   * that size and no to-space. The first collection makes a to-space,
+   * which is kept afterwards, or freed if the retention policy says so.
+   * The spaces grow from the initial size, not the default one.
+   */
+  void test_small_initial_size()
+  {
+    constexpr size_t initial = 8 * 1024;
+    auto* root =
+      create_fresh_semispace_region<C1>(C1::desc(), initial - 1);
+
+    {
+      UsingRegion rr(root);
+
+      check(debug_semispace_size() == initial);
+      check(debug_semispace_committed() == initial);
+
+      root->f1 = new C1;
+      region_collect();
+      check(debug_size() == 2);
+      check(debug_semispace_committed() == 2 * initial);
+
+      RegionSemiSpace::set_to_space_retention(
+        RegionSemiSpace::ToSpaceRetention::Release);
+      region_collect();
+      check(debug_size() == 2);
+      check(debug_semispace_committed() == initial);
+
+      // Filling the space grows it by doubling the initial size. Growing
+      // moves every object but the root.
+      for (size_t i = 0; i < initial / vsizeof<C1>; i++)
+      {
+        auto* c = new C1;
+        c->f1 = root->f1;
+        root->f1 = c;
+      }
+      check(debug_semispace_size() == 2 * initial);
+      check(debug_semispace_committed() == 2 * initial);
+      RegionSemiSpace::set_to_space_retention(
+        RegionSemiSpace::ToSpaceRetention::Keep);
+    }
+
+    region_release(root);
+    heap::debug_check_empty();
+  }
+
+  /**
+   * Test 23: Under memory pressure, collections free the space they empty
+   * whatever the retention policy, and keep it again once the pressure
+   * has passed.
+   */
+  void test_memory_pressure()
+  {
+    constexpr size_t initial = 8 * 1024;
+    auto* root = create_fresh_semispace_region<C1>(C1::desc(), initial);
+
+    {
+      UsingRegion rr(root);
+      root->f1 = new C1;
+
+      MemoryPressure::signal();
+      check(MemoryPressure::is_under_pressure());
+      region_collect();
+      check(debug_size() == 2);
+      check(debug_semispace_committed() == initial);
+
+      // With sampling off, the next sample clears the signal.
+      MemoryPressure::set_interval(0);
+      MemoryPressure::poll();
+      MemoryPressure::set_interval(MemoryPressure::DEFAULT_INTERVAL);
+      check(!MemoryPressure::is_under_pressure());
+      region_collect();
+      check(debug_size() == 2);
+      check(debug_semispace_committed() == 2 * initial);
+    }
+
+    region_release(root);
+    heap::debug_check_empty();
+  }
+
+  /**
+   * Test 24: A pinned object keeps its address, and stays alive while it is
+   * pinned even when nothing refers to it, along with what it refers to.
+   * Pins nest, and an unpinned object is collected like any other. Merging
+   * a region takes over its pins, and releasing a region drops them.
+   */
+  void test_pinning()
+  {
+    live_count = 0;
+    auto* root = new (RegionType::SemiSpace) F1;
+
+    {
+      UsingRegion rr(root);
+      auto* buf = ::new (region_alloc_pinned(F1::desc())) F1;
+      buf->f1 = new F1;
+      check(debug_pin_count() == 1);
+      check(debug_large_object_count() == 1);
+
+      region_collect();
+      check(live_count == 3);
+      check(debug_size() == 3);
+      check(buf->f1 != nullptr);
+
+      auto* big = new F2<600 * 1024>;
+      region_pin(big);
+      region_pin(big);
+      region_collect();
+      check(live_count == 4);
+      region_unpin(big);
+      region_collect();
+      check(live_count == 4);
+      region_unpin(big);
+      region_collect();
+      check(live_count == 3);
+
+      region_unpin(buf);
+      check(debug_pin_count() == 0);
+      region_collect();
+      check(live_count == 1);
+      check(debug_large_object_count() == 0);
+
+      auto* kept = ::new (region_alloc_pinned(F1::desc())) F1;
+      root->f1 = kept;
+      region_collect();
+      check(root->f1 == kept);
+    }
+
+    auto* other = new (RegionType::SemiSpace) F1;
+    {
+      UsingRegion rr(other);
+      ::new (region_alloc_pinned(F1::desc())) F1;
+    }
+
+    {
+      UsingRegion rr(root);
+      merge(other);
+      check(debug_pin_count() == 2);
+      region_collect();
+      check(live_count == 3);
+      check(debug_large_object_count() == 2);
+    }
+
+    region_release(root);
+    check(live_count == 0);
+    heap::debug_check_empty();
+  }
+
+  /**
+   * Test 25: Only references are relocated. The fields of a FieldNode
+   * are updated through the relocate function derived from fields(), and
+   * those of a TracedNode where they hold a reference its trace reports.
+   * Integers that hold the address of a moved object are left alone,
+   * unless the word scan is on, which rewrites that of a TracedNode.
+   */
+  void test_exact_relocation(bool word_scan)
+  {
+    RegionSemiSpace::set_word_scan(word_scan);
+    auto* root = new (RegionType::SemiSpace) TracedNode;
+
+    {
+      UsingRegion rr(root);
+      auto* a = new FieldNode;
+      auto* b = new FieldNode;
+      auto* t = new TracedNode;
+      a->left = b;
+      a->right = a;
+      a->cookie = (uintptr_t)b;
+      t->cookie = (uintptr_t)a;
+      root->node = a;
+      root->next = t;
+      uintptr_t old_a = (uintptr_t)a;
+      uintptr_t old_b = (uintptr_t)b;
+
+      // `a` is copied with the root, before `t` is scanned.
+      region_collect();
+      check(debug_size() == 4);
+
+      a = root->node;
+      b = a->left;
+      t = root->next;
+      check((uintptr_t)a != old_a);
+      check((uintptr_t)b != old_b);
+      check(a->right == a);
+      check(b->left == nullptr);
+      check(a->cookie == old_b);
+      if (word_scan)
+      {
+        check(t->cookie == (uintptr_t)a);
+      }
+      else
+      {
+        check(t->cookie == old_a);
+      }
+    }
+
+    region_release(root);
+    heap::debug_check_empty();
+    RegionSemiSpace::set_word_scan(false);
+  }
+
+  /**
+   * Test 26: An incremental copy runs a slice at each collection request
+   * and each close, and loads through load() see the copies meanwhile.
+   * Objects allocated during the copy survive it, and the garbage is only
+   * freed at the flip.
+   */
+  void test_incremental_copy()
+  {
+    RegionSemiSpace::set_incremental_copy(true);
+    RegionSemiSpace::set_copy_slice(4 * vsizeof<F1>);
+    live_count = 0;
+    auto* root = new (RegionType::SemiSpace) F1;
+    auto* reg = RegionSemiSpace::get(root);
+    const size_t n = 64;
+
+    {
+      UsingRegion rr(root);
+      // A list of n objects, each followed by a dead one.
+      for (size_t i = 0; i < n; i++)
+      {
+        auto* p = new F1;
+        p->f1 = root->f1;
+        root->f1 = p;
+        new F1;
+      }
+      check(live_count == (int)(1 + 2 * n));
+
+      region_collect();
+      check(reg->is_copy_pending());
+      check(live_count == (int)(1 + 2 * n));
+
+      // The read barrier copies what the slices have not reached yet.
+      size_t len = 0;
+      for (F1* p = load(root->f1); p != nullptr; p = load(p->f1))
+        len++;
+      check(len == n);
+
+      auto* q = new F1;
+      q->f1 = load(root->f1);
+      root->f1 = q;
+    }
+
+    {
+      UsingRegion rr(root);
+      while (reg->is_copy_pending())
+        region_collect();
+      check(live_count == (int)(2 + n));
+      check(debug_size() == 2 + n);
+
+      size_t len = 0;
+      for (F1* p = root->f1; p != nullptr; p = p->f1)
+        len++;
+      check(len == n + 1);
+    }
+
+    region_release(root);
+    check(live_count == 0);
+    heap::debug_check_empty();
+    RegionSemiSpace::set_copy_slice(RegionSemiSpace::DEFAULT_COPY_SLICE);
+    RegionSemiSpace::set_incremental_copy(false);
+  }
+
+  /**
+   * Test 27: A coalesced copy leaves the same survivors, in the same order
+   * and with clean headers, as copying each object on its own. The first
+   * half of the list is allocated in one piece, so it is copied as one run,
+   * long enough to be streamed. The second half has a dead object after
+   * each node, so each node is a run of its own, and the dead ones are
+   * finalised.
+   */
+  void test_coalesced_copy(bool coalesce)
+  {
+    RegionSemiSpace::set_coalesced_copy(coalesce);
+    live_count = 0;
+    auto* root = new (RegionType::SemiSpace) F1;
+    const size_t n = 4 * RegionSemiSpace::STREAM_COPY_THRESHOLD / vsizeof<F1>;
+
+    {
+      UsingRegion rr(root);
+      region_ensure_available((n + n / 2) * vsizeof<F1>);
+
+      F1* tail = root;
+      for (size_t i = 0; i < n; i++)
+      {
+        auto* p = new F1;
+        tail->f1 = p;
+        tail = p;
+        if (i >= n / 2)
+          new F1;
+      }
+      check(live_count == (int)(1 + n + n / 2));
+
+      for (int k = 0; k < 2; k++)
+      {
+        region_collect();
+        check(live_count == (int)(1 + n));
+        check(debug_size() == 1 + n);
+
+        size_t len = 0;
+        for (F1* p = root->f1; p != nullptr; p = p->f1)
+        {
+          check(p->debug_is_mutable());
+          if (p->f1 != nullptr)
+            check((std::byte*)p->f1 == (std::byte*)p + vsizeof<F1>);
+          len++;
+        }
+        check(len == n);
+      }
+    }
+
+    region_release(root);
+    check(live_count == 0);
+    heap::debug_check_empty();
+    RegionSemiSpace::set_coalesced_copy(true);
+  }
+
   void run_test()
   {
     std::cout << "=== SemiSpace GC Tests ===" << std::endl;
@@ -655,6 +1688,72 @@ namespace semispace_gc
     test_sizes_after_gc();
     std::cout << "  PASSED" << std::endl;
 
+    std::cout << "Test 12: Non-trivial finalisation..." << std::endl;
+    test_non_trivial_finalisation();
+    std::cout << "  PASSED" << std::endl;
+
+    std::cout << "Test 13: Parallel copy..." << std::endl;
+    test_parallel_copy();
+    std::cout << "  PASSED" << std::endl;
+
+    std::cout << "Test 14: Semispace resizing..." << std::endl;
+    test_semispace_resizing();
+    std::cout << "  PASSED" << std::endl;
+
+    std::cout << "Test 15: Grow collects..." << std::endl;
+    test_grow_collects();
+    std::cout << "  PASSED" << std::endl;
+
+    std::cout << "Test 16: Virtual spaces..." << std::endl;
+    test_virtual_spaces();
+    std::cout << "  PASSED" << std::endl;
+
+    std::cout << "Test 17: Large object space..." << std::endl;
+    test_large_object_space();
+    std::cout << "  PASSED" << std::endl;
+
+    std::cout << "Test 18: Hierarchical copy..." << std::endl;
+    test_hierarchical_copy();
+    std::cout << "  PASSED" << std::endl;
+
+    std::cout << "Test 19: Allocation cursor..." << std::endl;
+    test_alloc_cursor();
+    std::cout << "  PASSED" << std::endl;
+
+    std::cout << "Test 20: Region pointers..." << std::endl;
+    test_region_ptr();
+    std::cout << "  PASSED" << std::endl;
+
+    std::cout << "Test 21: Merge..." << std::endl;
+    test_merge();
+    std::cout << "  PASSED" << std::endl;
+
+    std::cout << "Test 22: Small initial size..." << std::endl;
+    test_small_initial_size();
+    std::cout << "  PASSED" << std::endl;
+
+    std::cout << "Test 23: Memory pressure..." << std::endl;
+    test_memory_pressure();
+    std::cout << "  PASSED" << std::endl;
+
+    std::cout << "Test 24: Pinning..." << std::endl;
+    test_pinning();
+    std::cout << "  PASSED" << std::endl;
+
+    std::cout << "Test 25: Exact relocation..." << std::endl;
+    test_exact_relocation(false);
+    test_exact_relocation(true);
+    std::cout << "  PASSED" << std::endl;
+
+    std::cout << "Test 26: Incremental copy..." << std::endl;
+    test_incremental_copy();
+    std::cout << "  PASSED" << std::endl;
+
+    std::cout << "Test 27: Coalesced copy..." << std::endl;
+    test_coalesced_copy(true);
+    test_coalesced_copy(false);
+    std::cout << "  PASSED" << std::endl;
+
     std::cout << "=== All SemiSpace GC tests passed ===" << std::endl;
   }
 }
@@ -0,0 +1,150 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#include <cstdio>
+#include <debug/harness.h>
+#include <test/opt.h>
+
+// A region of nodes with variable sized children arrays and back edges to
+// the entry point is saved to a snapshot, and loaded back as each region
+// type that can hold it; so is the same graph once frozen. The loaded
+// region must have the same shape as the one saved.
+
+struct Node : public VTail<Node, Node*>
+{
+  size_t id;
+  Object* back = nullptr;
+
+  Node(size_t id) : id(id) {}
+
+  void trace(ObjectStack& st) const
+  {
+    if (back != nullptr)
+      st.push(back);
+  }
+
+  void relocate(Object* (*fwd)(Object*))
+  {
+    if (back != nullptr)
+      back = fwd(back);
+  }
+};
+
+struct Root : public V<Root>
+{
+  Node* list = nullptr;
+  size_t count = 0;
+
+  void trace(ObjectStack& st) const
+  {
+    if (list != nullptr)
+      st.push(list);
+  }
+};
+
+struct Unregistered : public V<Unregistered>
+{
+  void trace(ObjectStack&) const {}
+};
+
+static constexpr size_t length = 500;
+static constexpr const char* path = "snapshot_test.bin";
+
+// Builds a list in which node i holds the next node and i spare slots.
+Root* build()
+{
+  auto* r = new (RegionType::Trace) Root;
+  UsingRegion rr(r);
+  Node* next = nullptr;
+  for (size_t i = length; i > 0; i--)
+  {
+    Node* n = create_object_with_tail<Node>(1 + (i - 1) % 8, i - 1);
+    n->tail()[0] = next;
+    n->back = r;
+    next = n;
+  }
+  r->list = next;
+  r->count = length;
+
+  // Garbage, which the snapshot leaves out.
+  new Unregistered;
+  return r;
+}
+
+void check_shape(Root* r)
+{
+  check(r->count == length);
+  Node* n = r->list;
+  for (size_t i = 0; i < length; i++)
+  {
+    check(n->id == i);
+    check(n->back == r);
+    check(n->tail_size() == 1 + i % 8);
+    for (size_t j = 1; j < n->tail_size(); j++)
+      check(n->tail()[j] == nullptr);
+    n = n->tail()[0];
+  }
+  check(n == nullptr);
+}
+
+void test_load(RegionType type, bool frozen)
+{
+  auto* r = (Root*)Snapshot::load(path, type);
+  check(r != nullptr);
+  check(Region::get_type(Region::get(r)) == type);
+  {
+    UsingRegion rr(r);
+    check(debug_size() == 1 + length);
+    check_shape(r);
+  }
+  if (frozen)
+  {
+    freeze(r);
+    check_shape(r);
+    Immutable::release(r);
+  }
+  else
+  {
+    region_release(r);
+  }
+}
+
+void test_snapshot()
+{
+  Root* r = build();
+  check(Snapshot::save(r, path));
+  for (auto type :
+       {RegionType::Trace, RegionType::Arena, RegionType::SemiSpace})
+    test_load(type, false);
+
+  // An object whose type is not registered cannot be saved.
+  {
+    UsingRegion rr(r);
+    r->list->back = new Unregistered;
+  }
+  check(!Snapshot::save(r, "snapshot_unregistered.bin"));
+  {
+    UsingRegion rr(r);
+    r->list->back = r;
+  }
+
+  freeze(r);
+  check(Snapshot::save(r, path));
+  Immutable::release(r);
+  test_load(RegionType::Trace, true);
+
+  check(Snapshot::load("snapshot_missing.bin", RegionType::Trace) == nullptr);
+  std::remove(path);
+  heap::debug_check_empty();
+}
+
+int main(int argc, char** argv)
+{
+  opt::Opt opt(argc, argv);
+  UNUSED(opt);
+
+  Snapshot::register_type<Root>(1);
+  Snapshot::register_type<Node>(2);
+  test_snapshot();
+
+  return 0;
+}
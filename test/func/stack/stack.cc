@@ -0,0 +1,77 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+#include <iostream>
+#include <snmalloc/snmalloc.h>
+#include <vector>
+#include <verona.h>
+
+using namespace verona::rt;
+
+// Distinct, non-null values to push.
+std::vector<size_t> values(size_t n)
+{
+  std::vector<size_t> v(n);
+  for (size_t i = 0; i < n; i++)
+    v[i] = (i + 1) * 8;
+  return v;
+}
+
+// Test that push_range and pop_n match pushing and popping one at a time,
+// across block boundaries, after `pushed` single pushes.
+template<class S>
+void test_bulk(size_t pushed, size_t n, size_t chunk)
+{
+  auto v = values(pushed + n);
+  auto items = (size_t**)v.data();
+
+  {
+    S bulk;
+    S single;
+    for (size_t i = 0; i < pushed; i++)
+    {
+      bulk.push(items[i]);
+      single.push(items[i]);
+    }
+    bulk.push_range(items + pushed, n);
+    for (size_t i = pushed; i < pushed + n; i++)
+      single.push(items[i]);
+
+    std::vector<size_t*> out(chunk);
+    size_t total = 0;
+    while (size_t got = bulk.pop_n(out.data(), chunk))
+    {
+      for (size_t i = 0; i < got; i++)
+      {
+        if (single.empty() || single.pop() != out[i])
+          abort();
+      }
+      total += got;
+    }
+    if (total != pushed + n || !single.empty() || !bulk.empty())
+      abort();
+  }
+  std::cout << "." << std::flush;
+}
+
+template<class S>
+void test_sizes()
+{
+  for (size_t pushed : {0, 1, 62, 63, 64, 600})
+  {
+    for (size_t n : {0, 1, 63, 64, 200, 1100})
+    {
+      for (size_t chunk : {1, 7, 64, 1000})
+        test_bulk<S>(pushed, n, chunk);
+    }
+  }
+}
+
+int main()
+{
+  test_sizes<Stack<size_t>>();
+  test_sizes<Stack<size_t, 512>>();
+
+  std::cout << std::endl;
+  heap::debug_check_empty();
+}
@@ -0,0 +1,127 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#include <debug/harness.h>
+#include <test/opt.h>
+
+// Variable sized objects in every region type: a tree whose nodes keep
+// their children in a trailing array of references, and a byte buffer
+// large enough for the large object space of SemiSpace regions. The
+// collectors must size, trace and move them by their actual sizes.
+
+struct Node : public VTail<Node, Node*>
+{
+  size_t id;
+
+  Node(size_t id) : id(id) {}
+
+  void trace(ObjectStack&) const {}
+};
+
+struct Bytes : public VTail<Bytes, uint8_t>
+{
+  void trace(ObjectStack&) const {}
+};
+
+struct Root : public V<Root>
+{
+  Node* tree = nullptr;
+  Bytes* bytes = nullptr;
+
+  void trace(ObjectStack& st) const
+  {
+    if (tree != nullptr)
+      st.push(tree);
+    if (bytes != nullptr)
+      st.push(bytes);
+  }
+};
+
+static constexpr size_t depth = 4;
+static constexpr size_t fanout = 3;
+static constexpr size_t nodes = 1 + 3 + 9 + 27 + 81;
+static constexpr size_t byte_count = 10000;
+
+Node* build(size_t level, size_t& next_id)
+{
+  size_t n = (level < depth) ? fanout : 0;
+  Node* node = create_object_with_tail<Node>(n, next_id++);
+  check(node->tail_size() == n);
+  for (size_t i = 0; i < n; i++)
+  {
+    check(node->tail()[i] == nullptr);
+    node->tail()[i] = build(level + 1, next_id);
+  }
+  return node;
+}
+
+void walk(Node* node, size_t& count, size_t& sum)
+{
+  count++;
+  sum += node->id;
+  for (size_t i = 0; i < node->tail_size(); i++)
+  {
+    // Children are numbered in preorder, after their parent.
+    check(node->tail()[i]->id > node->id);
+    walk(node->tail()[i], count, sum);
+  }
+}
+
+void check_contents(Root* r)
+{
+  size_t count = 0;
+  size_t sum = 0;
+  walk(r->tree, count, sum);
+  check(count == nodes);
+  check(sum == nodes * (nodes - 1) / 2);
+
+  check(r->bytes->tail_size() == byte_count);
+  for (size_t i = 0; i < byte_count; i++)
+    check(r->bytes->tail()[i] == (uint8_t)i);
+}
+
+void test_tail(RegionType type)
+{
+  auto* r = new (type) Root;
+  {
+    UsingRegion rr(r);
+    size_t before = debug_memory_used();
+
+    // Nothing may move while the tree is built from pointers held here.
+    if (type == RegionType::SemiSpace || type == RegionType::Compact)
+      region_ensure_available(64 * 1024);
+
+    size_t next_id = 0;
+    r->tree = build(0, next_id);
+    r->bytes = create_object_with_tail<Bytes>(byte_count);
+    for (size_t i = 0; i < byte_count; i++)
+      r->bytes->tail()[i] = (uint8_t)i;
+
+    check(debug_memory_used() >= before + byte_count + nodes * sizeof(Node));
+    check_contents(r);
+
+    if (type != RegionType::Arena)
+    {
+      region_collect();
+      check_contents(r);
+    }
+  }
+  region_release(r);
+  heap::debug_check_empty();
+}
+
+int main(int argc, char** argv)
+{
+  opt::Opt opt(argc, argv);
+  UNUSED(opt);
+
+  for (auto type :
+       {RegionType::Trace,
+        RegionType::Arena,
+        RegionType::Rc,
+        RegionType::SemiSpace,
+        RegionType::Generational,
+        RegionType::Compact})
+    test_tail(type);
+
+  return 0;
+}
@@ -0,0 +1,77 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#include <chrono>
+#include <cpp/when.h>
+#include <debug/harness.h>
+
+using namespace verona::cpp;
+using namespace std::chrono;
+
+// Checks that behaviours scheduled with when_after run no earlier than
+// their delays, in order of deadline, whether they were armed on or off
+// the scheduler threads, including delays beyond the finest level of the
+// timer wheel.
+
+struct Log
+{
+  steady_clock::time_point start = steady_clock::now();
+  size_t next = 0;
+  size_t expected = 0;
+
+  ~Log()
+  {
+    check(next == expected);
+  }
+};
+
+void record(acquired_cown<Log>& log, size_t index, milliseconds delay)
+{
+  check(steady_clock::now() - log->start >= delay);
+  check(log->next == index);
+  log->next++;
+}
+
+void order_test()
+{
+  auto log = make_cown<Log>();
+  when(log) << [](acquired_cown<Log> l) { l->expected = 4; };
+
+  // Armed from a behaviour, out of order.
+  when() << [log]() {
+    when_after(milliseconds(150), log) << [](acquired_cown<Log> l) {
+      record(l, 3, milliseconds(150));
+    };
+    when_after(milliseconds(10), log) << [](acquired_cown<Log> l) {
+      record(l, 0, milliseconds(10));
+    };
+    when_after(milliseconds(50), log) << [](acquired_cown<Log> l) {
+      record(l, 2, milliseconds(50));
+    };
+    when_after(milliseconds(30), log) << [](acquired_cown<Log> l) {
+      record(l, 1, milliseconds(30));
+    };
+  };
+}
+
+void external_test()
+{
+  auto start = steady_clock::now();
+  auto log = make_cown<Log>();
+  when(log) << [](acquired_cown<Log> l) { l->expected = 1; };
+
+  // Armed off the scheduler threads, with no cowns, and then one.
+  when_after(milliseconds(5)) << [start, log]() {
+    check(steady_clock::now() - start >= milliseconds(5));
+    when_after(milliseconds(5), log) << [](acquired_cown<Log> l) {
+      record(l, 0, milliseconds(10));
+    };
+  };
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+  harness.run(order_test);
+  harness.run(external_test);
+  return 0;
+}
@@ -0,0 +1,92 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#include <cpp/when.h>
+#include <debug/harness.h>
+
+// Checks that behaviours scheduled with when_ready run when their file
+// descriptor is ready, once per readiness until they say to stop, with the
+// data written from another cown, and that the runtime waits for them.
+
+#if defined(__linux__)
+#  include <fcntl.h>
+#  include <unistd.h>
+
+using namespace verona::cpp;
+
+static constexpr size_t MESSAGES = 20;
+
+struct Reader
+{
+  int fd;
+  size_t received = 0;
+  bool closed = false;
+
+  Reader(int fd) : fd(fd) {}
+
+  ~Reader()
+  {
+    check(received == MESSAGES);
+    check(closed);
+  }
+};
+
+struct Writer
+{
+  int fd;
+
+  Writer(int fd) : fd(fd) {}
+};
+
+void write_next(cown_ptr<Writer> w, size_t remaining)
+{
+  when(w) << [w, remaining](acquired_cown<Writer> acq) {
+    if (remaining == 0)
+    {
+      close(acq->fd);
+      return;
+    }
+
+    uint8_t byte = 1;
+    check(write(acq->fd, &byte, 1) == 1);
+    write_next(w, remaining - 1);
+  };
+}
+
+void pipe_test()
+{
+  int fds[2];
+  check(pipe2(fds, O_NONBLOCK | O_CLOEXEC) == 0);
+
+  auto reader = make_cown<Reader>(fds[0]);
+  auto writer = make_cown<Writer>(fds[1]);
+
+  when_ready(fds[0], FdPoller::READABLE, reader) <<
+    [](acquired_cown<Reader>& r, uint32_t events) {
+      uint8_t buffer[8];
+      ssize_t n;
+      while ((n = read(r->fd, buffer, sizeof(buffer))) > 0)
+        r->received += (size_t)n;
+
+      if (n == 0)
+      {
+        // The writer closed its end, after everything it wrote.
+        check((events & (FdPoller::READABLE | FdPoller::CLOSED)) != 0);
+        r->closed = true;
+        close(r->fd);
+        return false;
+      }
+      return true;
+    };
+
+  write_next(writer, MESSAGES);
+}
+#endif
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+#if defined(__linux__)
+  harness.run(pipe_test);
+#endif
+  return 0;
+}
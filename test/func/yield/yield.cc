@@ -84,6 +84,33 @@ void test_counter()
   };
 }
 
+// A long behaviour that processes its cown in chunks, giving its core up
+// between them, while a behaviour on another cown gets a turn.
+void test_yield_turn()
+{
+  static constexpr int chunks = 10;
+
+  auto work = make_cown<Counter>();
+  auto other = make_cown<Counter>();
+
+  when(work) << [chunk = 0](auto counter) mutable {
+    counter->c += 100;
+    if (++chunk < chunks)
+    {
+      verona::rt::Behaviour::yield_turn();
+      return;
+    }
+    check(counter->c == 100 * chunks);
+  };
+
+  when(other) << [](auto counter) { counter->c++; };
+
+  when(work, other) << [](auto counter, auto o) {
+    check(counter->c == 100 * chunks);
+    check(o->c == 1);
+  };
+}
+
 int main(int argc, char** argv)
 {
   SystematicTestHarness harness(argc, argv);
@@ -92,6 +119,7 @@ int main(int argc, char** argv)
 
   harness.run(test_counter);
   harness.run(test_state_machine);
+  harness.run(test_yield_turn);
 
   return 0;
 }
@@ -0,0 +1,93 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * This benchmark is for testing false sharing between the runtime's state
+ * for a cown and the cown's value.
+ *
+ * There are n producer loops, each on a cown of its own, that keep sending
+ * behaviours to one shared cown, m each. Every behaviour on the shared cown
+ * updates its value w times. Sending a behaviour writes the shared cown's
+ * reference count and queue while the behaviour before it is running, so
+ * with the value packed next to them (CownLayout::Packed) the two fight
+ * over the same cache lines. With CownLayout::Padded they do not.
+ */
+
+#include "test/opt.h"
+#include "verona.h"
+
+#include <cpp/when.h>
+
+namespace sn = snmalloc;
+namespace rt = verona::rt;
+using namespace verona::cpp;
+
+template<CownLayout layout>
+struct Counters
+{
+  static constexpr CownLayout cown_layout = layout;
+
+  // Volatile, so that each update is a store to the value.
+  volatile size_t values[4] = {};
+};
+
+struct Producer
+{};
+
+size_t updates;
+
+template<CownLayout layout>
+void produce(
+  cown_ptr<Producer> p, cown_ptr<Counters<layout>> shared, size_t remaining)
+{
+  if (remaining == 0)
+    return;
+
+  when(p) << [p, shared, remaining](acquired_cown<Producer>) {
+    when(shared) << [](acquired_cown<Counters<layout>> c) {
+      for (size_t i = 0; i < updates; i++)
+        c->values[i % 4]++;
+    };
+    produce(p, shared, remaining - 1);
+  };
+}
+
+template<CownLayout layout>
+void run(size_t cores, size_t loops, size_t sends, const char* name)
+{
+  auto& sched = rt::Scheduler::get();
+  for (int l = 0; l < 10; l++)
+  {
+    sched.init(cores);
+
+    when() << [loops, sends]() {
+      auto shared = make_cown<Counters<layout>>();
+      for (size_t i = 0; i < loops; i++)
+        produce(make_cown<Producer>(), shared, sends);
+    };
+
+    auto start = sn::Aal::tick();
+    sched.run();
+    auto end = sn::Aal::tick();
+    std::cout << name << ": cycles per behaviour: "
+              << (end - start) / (loops * sends) << std::endl;
+  }
+}
+
+int main(int argc, char** argv)
+{
+  opt::Opt opt(argc, argv);
+
+  const auto cores = opt.is<size_t>("--cores", 4);
+  const auto loops = opt.is<size_t>("--loops", 8);
+  const auto sends = opt.is<size_t>("--sends", 100000);
+  updates = opt.is<size_t>("--updates", 64);
+
+  std::cout << "cores: " << cores << ", loops: " << loops
+            << ", sends: " << sends << ", updates: " << updates << std::endl;
+
+  run<CownLayout::Packed>(cores, loops, sends, "packed");
+  run<CownLayout::Padded>(cores, loops, sends, "padded");
+
+  heap::debug_check_empty();
+}
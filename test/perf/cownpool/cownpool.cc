@@ -0,0 +1,103 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * This benchmark is for testing the cost of making and freeing short-lived
+ * cowns, with and without the CownPool.
+ *
+ * There are n producer loops, each on a cown of its own. Each step of a
+ * loop makes a batch of b cowns and sends them to a behaviour on the next
+ * loop's cown, usually on another thread, which drops them. So most cowns
+ * are freed on a thread other than the one that made them. There are m
+ * cowns made in all.
+ */
+
+#include "test/opt.h"
+#include "verona.h"
+
+#include <cpp/when.h>
+#include <vector>
+
+namespace sn = snmalloc;
+namespace rt = verona::rt;
+using namespace verona::cpp;
+
+struct Session
+{
+  size_t id;
+  size_t data[3] = {};
+
+  Session(size_t id) : id(id) {}
+};
+
+struct Producer
+{};
+
+size_t batch;
+
+void produce(
+  std::vector<cown_ptr<Producer>>* loops, size_t index, size_t remaining)
+{
+  if (remaining == 0)
+    return;
+
+  auto& p = (*loops)[index];
+  when(p) << [loops, index, remaining](acquired_cown<Producer>) {
+    std::vector<cown_ptr<Session>> sessions;
+    for (size_t i = 0; i < batch; i++)
+      sessions.push_back(make_cown<Session>(i));
+
+    auto& next = (*loops)[(index + 1) % loops->size()];
+    when(next) << [sessions = std::move(sessions)](acquired_cown<Producer>) {
+      // The sessions are freed here, on the thread that runs this.
+    };
+    produce(loops, index, remaining - 1);
+  };
+}
+
+void run(
+  size_t cores, size_t loops, size_t cowns, size_t capacity, const char* name)
+{
+  rt::CownPool::set_capacity(capacity);
+  auto& sched = rt::Scheduler::get();
+  for (int l = 0; l < 5; l++)
+  {
+    sched.init(cores);
+
+    auto* ps = new std::vector<cown_ptr<Producer>>;
+    for (size_t i = 0; i < loops; i++)
+      ps->push_back(make_cown<Producer>());
+    size_t steps = cowns / (loops * batch);
+    for (size_t i = 0; i < loops; i++)
+      produce(ps, i, steps);
+
+    auto start = sn::Aal::tick();
+    sched.run();
+    auto end = sn::Aal::tick();
+    delete ps;
+
+    std::cout << name << ": cycles per cown: "
+              << (end - start) / (steps * loops * batch) << std::endl;
+  }
+}
+
+int main(int argc, char** argv)
+{
+  opt::Opt opt(argc, argv);
+
+  const auto cores = opt.is<size_t>("--cores", 32);
+  const auto loops = opt.is<size_t>("--loops", 64);
+  const auto cowns = opt.is<size_t>("--cowns", 10000000);
+  const auto capacity = opt.is<size_t>("--capacity", 1 << 20);
+  batch = opt.is<size_t>("--batch", 16);
+
+  std::cout << "cores: " << cores << ", loops: " << loops
+            << ", cowns: " << cowns << ", batch: " << batch
+            << ", capacity: " << capacity << std::endl;
+
+  run(cores, loops, cowns, 0, "heap");
+  run(cores, loops, cowns, capacity, "pooled");
+
+  rt::CownPool::trim();
+  heap::debug_check_empty();
+}
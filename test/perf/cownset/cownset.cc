@@ -0,0 +1,70 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * This benchmark is for testing how scheduling a behaviour on a dynamic set
+ * of cowns scales with the size of the set.
+ *
+ * For each set size s, from 1 doubling up to --max-set, it schedules m
+ * behaviours each acquiring s cowns, picked at random from a pool of n,
+ * and reports the cycles per behaviour and per cown.
+ */
+
+#include "test/opt.h"
+#include "verona.h"
+
+#include <cpp/when.h>
+#include <vector>
+
+namespace sn = snmalloc;
+namespace rt = verona::rt;
+using namespace verona::cpp;
+
+struct Cell
+{
+  size_t value = 0;
+};
+
+int main(int argc, char** argv)
+{
+  opt::Opt opt(argc, argv);
+
+  const auto cores = opt.is<size_t>("--cores", 4);
+  const auto pool = opt.is<size_t>("--cowns", 4096);
+  const auto max_set = opt.is<size_t>("--max-set", 4096);
+  const auto behaviours = opt.is<size_t>("--behaviours", 1000);
+
+  std::cout << "cores: " << cores << ", cowns: " << pool
+            << ", behaviours: " << behaviours << std::endl;
+
+  auto& sched = rt::Scheduler::get();
+  for (size_t set = 1; set <= max_set; set *= 2)
+  {
+    sched.init(cores);
+
+    when() << [pool, set, behaviours]() {
+      std::vector<cown_ptr<Cell>> cells;
+      for (size_t i = 0; i < pool; i++)
+        cells.push_back(make_cown<Cell>());
+
+      PRNG<> rng;
+      std::vector<cown_ptr<Cell>> picked(set);
+      for (size_t b = 0; b < behaviours; b++)
+      {
+        for (auto& p : picked)
+          p = cells[rng.next() % pool];
+
+        cown_array<Cell> cs{picked.data(), set};
+        when(cs) << [](auto acq) { acq.array[0]->value++; };
+      }
+    };
+
+    auto start = sn::Aal::tick();
+    sched.run();
+    auto end = sn::Aal::tick();
+    std::cout << "Set " << set << ": cycles per behaviour "
+              << (end - start) / behaviours << ", per cown "
+              << (end - start) / (behaviours * set) << std::endl;
+  }
+  heap::debug_check_empty();
+}
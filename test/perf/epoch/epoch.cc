@@ -1,11 +1,14 @@
 // Copyright Microsoft and Project Verona Contributors.
 // SPDX-License-Identifier: MIT
+#include <chrono>
 #include <test/measuretime.h>
 #include <test/opt.h>
+#include <util/latency_histogram.h>
 #include <verona.h>
 
 using namespace snmalloc;
 using namespace verona::rt;
+using verona::rt::api::LatencyHistogram;
 
 void test_epoch()
 {
@@ -32,6 +35,31 @@ void test_epoch()
     Epoch::flush();
   }
 
+  {
+    // The time to leave an epoch, which is when a thread that advances it
+    // reclaims what was delayed two epochs before.
+    LatencyHistogram latency;
+    for (int n = 0; n < count; n++)
+    {
+      auto start = std::chrono::steady_clock::now();
+      {
+        Epoch e;
+        obj = heap::alloc(size);
+        e.delete_in_epoch(obj);
+      }
+      auto end = std::chrono::steady_clock::now();
+      latency.record(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(end - start)
+          .count());
+    }
+
+    Epoch::flush();
+    std::cout << "epoch exit ns: p50 " << latency.percentile(50) << " p99 "
+              << latency.percentile(99) << " p99.9 "
+              << latency.percentile(99.9) << " max " << latency.max()
+              << std::endl;
+  }
+
   {
     MeasureTime m;
     m << "without_epoch";
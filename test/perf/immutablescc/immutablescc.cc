@@ -238,7 +238,19 @@ Object* make_horrible_cycles_two(size_t size)
   return make_horrible_cycles_two_inner<Order>(size, nullptr).first;
 }
 
-template<typename Make>
+/**
+ * Follow the f1 fields from `root`, for at most `limit` steps.
+ */
+size_t walk(Object* root, size_t limit)
+{
+  size_t steps = 0;
+  for (Object* p = root; (p != nullptr) && (steps < limit);
+       p = ((C1<>*)p)->f1)
+    steps++;
+  return steps;
+}
+
+template<bool Compact = false, typename Make>
 void test_alloc_freeze_release(std::string ds, Make make, bool print)
 {
 #ifdef CI_BUILD
@@ -277,8 +289,13 @@ void test_alloc_freeze_release(std::string ds, Make make, bool print)
         verona::rt::Object::reset_find_count();
         {
           MeasureTime m(true);
-          for (auto root : roots)
-            freeze(root);
+          for (auto& root : roots)
+          {
+            if constexpr (Compact)
+              root = freeze_compact(root);
+            else
+              freeze(root);
+          }
           if (print)
           {
             std::cout << ds << ",Freeze," << list_size << ","
@@ -289,6 +306,16 @@ void test_alloc_freeze_release(std::string ds, Make make, bool print)
           }
         }
 
+        {
+          MeasureTime m(true);
+          size_t steps = 0;
+          for (auto root : roots)
+            steps += walk(root, work + 1);
+          if (print)
+            std::cout << ds << ",Walk," << list_size << ","
+                      << (double)m.get_time().count() / steps << std::endl;
+        }
+
         verona::rt::Object::reset_find_count();
         // Free immutable graph.
         {
@@ -325,12 +352,16 @@ int main(int, char**)
   for (int i = 0; i < repeats; i++)
   {
     test_alloc_freeze_release("Linked List", make_list<false>, i != 0);
+    test_alloc_freeze_release<true>(
+      "Linked List (compact)", make_list<false>, i != 0);
     test_alloc_freeze_release("Doubly Linked List", make_list<true>, i != 0);
     test_alloc_freeze_release(
       "Doubly Linked List (Reverse field order)",
       make_list<true, true>,
       i != 0);
     test_alloc_freeze_release("Balanced Binary Tree", make_tree<false>, i != 0);
+    test_alloc_freeze_release<true>(
+      "Balanced Binary Tree (compact)", make_tree<false>, i != 0);
     test_alloc_freeze_release(
       "Balanced Binary Tree with Leaf to root cycle", make_tree<true>, i != 0);
     test_alloc_freeze_release(
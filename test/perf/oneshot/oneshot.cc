@@ -0,0 +1,95 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * This benchmark compares Promise with OneShot for fan-out/fan-in.
+ *
+ * n values are each produced by their own Work item, fulfilling a promise
+ * or one-shot future, and consumed by a continuation that adds it to a
+ * running total. The last continuation checks the total.
+ */
+
+#include "test/opt.h"
+#include "verona.h"
+
+#include <chrono>
+
+namespace sn = snmalloc;
+namespace rt = verona::rt;
+using namespace verona::rt;
+
+std::atomic<size_t> remaining;
+std::atomic<size_t> total;
+size_t expected;
+
+void add(size_t v)
+{
+  total.fetch_add(v, std::memory_order_relaxed);
+  if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+  {
+    if (total.load(std::memory_order_relaxed) != expected)
+      abort();
+  }
+}
+
+void fan_promise(size_t n)
+{
+  for (size_t i = 0; i < n; i++)
+  {
+    auto pp = Promise<size_t>::create_promise();
+    schedule_lambda([i, wp = std::move(pp.second)]() mutable {
+      Promise<size_t>::fulfill(std::move(wp), size_t(i));
+    });
+    pp.first.then([](std::variant<size_t, Promise<size_t>::PromiseErr> v) {
+      add(std::get<size_t>(v));
+    });
+  }
+}
+
+void fan_oneshot(size_t n)
+{
+  for (size_t i = 0; i < n; i++)
+  {
+    auto pp = OneShot<size_t>::create_oneshot();
+    schedule_lambda([i, wp = std::move(pp.second)]() mutable {
+      OneShot<size_t>::fulfill(std::move(wp), size_t(i));
+    });
+    std::move(pp.first).then([](std::optional<size_t> v) { add(*v); });
+  }
+}
+
+int main(int argc, char** argv)
+{
+  opt::Opt opt(argc, argv);
+
+  const auto cores = opt.is<size_t>("--cores", 4);
+  const auto n = opt.is<size_t>("--n", 1'000'000);
+  expected = n * (n - 1) / 2;
+
+  std::cout << "cores: " << cores << ", n: " << n << std::endl;
+
+  auto& sched = rt::Scheduler::get();
+  for (int l = 0; l < 10; l++)
+  {
+    for (bool oneshot : {false, true})
+    {
+      sched.init(cores);
+      remaining = n;
+      total = 0;
+
+      schedule_lambda([oneshot, n]() {
+        if (oneshot)
+          fan_oneshot(n);
+        else
+          fan_promise(n);
+      });
+
+      auto start = sn::Aal::tick();
+      sched.run();
+      auto end = sn::Aal::tick();
+      std::cout << (oneshot ? "OneShot" : "Promise")
+                << " cycles per value: " << (end - start) / n << std::endl;
+    }
+  }
+  heap::debug_check_empty();
+}
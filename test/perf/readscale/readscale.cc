@@ -0,0 +1,79 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * This benchmark is for testing how reads of a single cown scale with the
+ * number of cores.
+ *
+ * There are n reader loops, each sending m read-only behaviours to the same
+ * cown, one after the other, with a write to it every w reads. With
+ * --read-mostly the cown counts finished readers per core.
+ */
+
+#include "test/opt.h"
+#include "verona.h"
+
+#include <chrono>
+#include <cpp/when.h>
+
+namespace sn = snmalloc;
+namespace rt = verona::rt;
+using namespace verona::cpp;
+
+struct Counter
+{
+  size_t value = 0;
+};
+
+size_t writes_every;
+
+void read_loop(cown_ptr<Counter> c, size_t remaining)
+{
+  if (remaining == 0)
+    return;
+
+  if ((writes_every != 0) && (remaining % writes_every == 0))
+    when(c) << [](acquired_cown<Counter> s) { s->value++; };
+
+  when(read(c)) << [c, remaining](acquired_cown<const Counter> s) {
+    UNUSED(s->value);
+    read_loop(c, remaining - 1);
+  };
+}
+
+int main(int argc, char** argv)
+{
+  opt::Opt opt(argc, argv);
+
+  const auto cores = opt.is<size_t>("--cores", 4);
+  const auto loops = opt.is<size_t>("--loops", 64);
+  const auto reads = opt.is<size_t>("--reads", 10000);
+  const auto read_mostly = opt.has("--read-mostly");
+  writes_every = opt.is<size_t>("--writes_every", 0);
+
+  std::cout << "cores: " << cores << ", loops: " << loops
+            << ", reads: " << reads << ", read_mostly: " << read_mostly
+            << ", writes_every: " << writes_every << std::endl;
+
+  auto& sched = rt::Scheduler::get();
+  for (int l = 0; l < 10; l++)
+  {
+    sched.init(cores);
+
+    when() << [loops, reads, read_mostly]() {
+      auto c = make_cown<Counter>();
+      if (read_mostly)
+        c.set_read_mostly();
+
+      for (size_t i = 0; i < loops; i++)
+        read_loop(c, reads);
+    };
+
+    auto start = sn::Aal::tick();
+    sched.run();
+    auto end = sn::Aal::tick();
+    std::cout << "Cycles per read: " << (end - start) / (loops * reads)
+              << std::endl;
+  }
+  heap::debug_check_empty();
+}
@@ -0,0 +1,144 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * This benchmark is for testing the release of a region that holds many
+ * independent subregions, as the nested region trees of
+ * test/func/memory_tree do, on one thread and in parallel (see
+ * Region::set_parallel_release()).
+ *
+ * Each of r behaviours builds a parent region holding c child regions of
+ * n objects each, and releases it. This is run for several child counts
+ * and sizes, with the children released on the releasing thread, and
+ * then shared with helpers on the other cores once there are at least
+ * --parallel of them.
+ *
+ * For each run it reports the cycles each release of a parent took, and
+ * how many children helpers released.
+ */
+
+#include "test/opt.h"
+#include "verona.h"
+
+#include <chrono>
+#include <cpp/when.h>
+#include <vector>
+
+namespace sn = snmalloc;
+namespace rt = verona::rt;
+using namespace verona::cpp;
+using namespace verona::rt::api;
+
+struct Node : public V<Node>
+{
+  Node* next = nullptr;
+  // The Iso of a child region.
+  Node* child = nullptr;
+  size_t payload[4] = {};
+
+  void trace(ObjectStack& st) const
+  {
+    if (next != nullptr)
+      st.push(next);
+    if (child != nullptr)
+      st.push(child);
+  }
+};
+
+struct Loop
+{};
+
+size_t children;
+size_t objects;
+std::atomic<uint64_t> release_cycles{0};
+
+Node* build_child()
+{
+  auto* root = new (RegionType::Trace) Node;
+  UsingRegion rr(root);
+  Node* n = root;
+  for (size_t i = 1; i < objects; i++)
+  {
+    n->next = new Node;
+    n = n->next;
+  }
+  return root;
+}
+
+Node* build()
+{
+  std::vector<Node*> isos;
+  for (size_t i = 0; i < children; i++)
+    isos.push_back(build_child());
+
+  auto* root = new (RegionType::Trace) Node;
+  UsingRegion rr(root);
+  Node* n = root;
+  for (Node* iso : isos)
+  {
+    n->child = iso;
+    n->next = new Node;
+    n = n->next;
+  }
+  return root;
+}
+
+void step(cown_ptr<Loop> l, size_t remaining)
+{
+  if (remaining == 0)
+    return;
+
+  when(l) << [l, remaining](acquired_cown<Loop>) {
+    Node* r = build();
+    auto start = sn::Aal::tick();
+    region_release(r);
+    release_cycles.fetch_add(
+      sn::Aal::tick() - start, std::memory_order_relaxed);
+    step(l, remaining - 1);
+  };
+}
+
+void run(size_t cores, size_t parents, size_t parallel, const char* name)
+{
+  rt::Region::set_parallel_release(parallel);
+  release_cycles = 0;
+  size_t helped = rt::Region::get_helped_releases();
+
+  auto& sched = rt::Scheduler::get();
+  sched.init(cores);
+  step(make_cown<Loop>(), parents);
+  sched.run();
+
+  std::cout << name << " children: " << children << ", objects: " << objects
+            << ": cycles per release: " << release_cycles / parents
+            << ", released by helpers: "
+            << rt::Region::get_helped_releases() - helped << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+  opt::Opt opt(argc, argv);
+
+  const auto cores = opt.is<size_t>("--cores", 8);
+  const auto parents = opt.is<size_t>("--parents", 20);
+  const auto parallel = opt.is<size_t>("--parallel", 16);
+
+  std::cout << "cores: " << cores << ", parents: " << parents
+            << ", parallel: " << parallel << std::endl;
+
+  const size_t counts[] = {16, 256, 4096};
+  const size_t sizes[] = {1, 16, 256};
+  for (size_t count : counts)
+  {
+    children = count;
+    for (size_t size : sizes)
+    {
+      objects = size;
+      run(cores, parents, 0, "sequential");
+      run(cores, parents, parallel, "parallel");
+    }
+  }
+
+  rt::Region::set_parallel_release(0);
+  heap::debug_check_empty();
+}
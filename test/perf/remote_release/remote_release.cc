@@ -0,0 +1,157 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * This benchmark is for testing the cost of releasing regions on a thread
+ * other than the one that built them, whose memory the allocator then has
+ * to send back through its remote deallocation queues.
+ *
+ * There are p producer loops, each on a cown of its own. Each step of a
+ * loop builds a region of n objects and sends it to one of c consumer
+ * cowns, round robin, which releases it. This is run for several producer
+ * and consumer counts and region sizes, with regions released where they
+ * are received, and then with releases of regions of at least --home
+ * bytes sent back to the core that built them (see
+ * Region::set_release_home_threshold()).
+ *
+ * For each run it reports the regions released per second, the cycles
+ * each release took on the consumer, and how many releases were remote,
+ * that is on another core than the region's home, and how many of those
+ * were sent home.
+ */
+
+#include "test/opt.h"
+#include "verona.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cpp/when.h>
+#include <vector>
+
+namespace sn = snmalloc;
+namespace rt = verona::rt;
+using namespace verona::cpp;
+using namespace verona::rt::api;
+
+struct Node : public V<Node>
+{
+  Node* next = nullptr;
+  size_t payload[6] = {};
+
+  void trace(ObjectStack& st) const
+  {
+    if (next != nullptr)
+      st.push(next);
+  }
+};
+
+struct Loop
+{};
+
+size_t objects;
+std::atomic<uint64_t> release_cycles{0};
+
+Node* build()
+{
+  auto* root = new (RegionType::Trace) Node;
+  UsingRegion rr(root);
+  Node* n = root;
+  for (size_t i = 1; i < objects; i++)
+  {
+    n->next = new Node;
+    n = n->next;
+  }
+  return root;
+}
+
+void produce(
+  cown_ptr<Loop> p,
+  std::vector<cown_ptr<Loop>>* consumers,
+  size_t next,
+  size_t remaining)
+{
+  if (remaining == 0)
+    return;
+
+  when(p) << [p, consumers, next, remaining](acquired_cown<Loop>) {
+    Node* r = build();
+    when((*consumers)[next]) << [r](acquired_cown<Loop>) {
+      auto start = sn::Aal::tick();
+      region_release(r);
+      release_cycles.fetch_add(
+        sn::Aal::tick() - start, std::memory_order_relaxed);
+    };
+    produce(p, consumers, (next + 1) % consumers->size(), remaining - 1);
+  };
+}
+
+void run(
+  size_t cores,
+  size_t producers,
+  size_t consumers,
+  size_t regions,
+  size_t home,
+  const char* name)
+{
+  rt::Region::set_release_home_threshold(home);
+  release_cycles = 0;
+  size_t remote = rt::Region::get_remote_releases();
+  size_t sent = rt::Region::get_home_releases();
+
+  auto& sched = rt::Scheduler::get();
+  sched.init(cores);
+
+  auto* cs = new std::vector<cown_ptr<Loop>>;
+  for (size_t i = 0; i < consumers; i++)
+    cs->push_back(make_cown<Loop>());
+  size_t steps = regions / producers;
+  for (size_t i = 0; i < producers; i++)
+    produce(make_cown<Loop>(), cs, i % consumers, steps);
+
+  auto start = std::chrono::steady_clock::now();
+  sched.run();
+  auto end = std::chrono::steady_clock::now();
+  delete cs;
+
+  size_t released = steps * producers;
+  double seconds = std::chrono::duration<double>(end - start).count();
+  std::cout << name << " producers: " << producers
+            << ", consumers: " << consumers << ", objects: " << objects
+            << ": regions per second: " << (size_t)(released / seconds)
+            << ", cycles per release: " << release_cycles / released
+            << ", remote releases: "
+            << rt::Region::get_remote_releases() - remote
+            << ", sent home: " << rt::Region::get_home_releases() - sent
+            << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+  opt::Opt opt(argc, argv);
+
+  const auto cores = opt.is<size_t>("--cores", 8);
+  const auto regions = opt.is<size_t>("--regions", 20000);
+  const auto home = opt.is<size_t>("--home", 64 * 1024);
+
+  std::cout << "cores: " << cores << ", regions: " << regions
+            << ", home: " << home << std::endl;
+
+  const size_t counts[] = {1, 4, 8};
+  const size_t sizes[] = {16, 1024, 16384};
+  for (size_t size : sizes)
+  {
+    objects = size;
+    // Fewer regions when they are large, to keep the runs short.
+    size_t n = std::max<size_t>(regions * 16 / size, 64);
+    for (size_t producers : counts)
+    {
+      for (size_t consumers : counts)
+      {
+        run(cores, producers, consumers, n, 0, "remote");
+        run(cores, producers, consumers, n, home, "home");
+      }
+    }
+  }
+
+  heap::debug_check_empty();
+}
@@ -80,6 +80,7 @@ int main(int argc, char** argv)
 
   auto& sched = rt::Scheduler::get();
   sched.set_fair(true);
+  sched.set_local_ring(opt.is<size_t>("--local-ring", 0));
   for (int l = 0; l < 20; l++)
   {
     sched.init(cores);
@@ -0,0 +1,67 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * This benchmark is for testing how long the runtime takes to start and
+ * stop, with and without keeping its threads between runs (see
+ * ThreadPool::set_persistent()).
+ *
+ * Each run inits the runtime, schedules one behaviour, and runs to
+ * quiescence. It reports the time from the start of init() to the start of
+ * the behaviour, and to the end of run().
+ */
+
+#include "test/opt.h"
+#include "verona.h"
+
+#include <chrono>
+#include <cpp/when.h>
+
+namespace rt = verona::rt;
+using namespace verona::cpp;
+using namespace std::chrono;
+
+steady_clock::time_point first;
+
+void run(size_t cores, size_t runs, bool persistent, const char* name)
+{
+  auto& sched = rt::Scheduler::get();
+  rt::Scheduler::set_persistent(persistent);
+
+  nanoseconds to_first{0};
+  nanoseconds to_end{0};
+  for (size_t r = 0; r < runs; r++)
+  {
+    auto start = steady_clock::now();
+    sched.init(cores);
+    when() << []() { first = steady_clock::now(); };
+    sched.run();
+    auto end = steady_clock::now();
+
+    to_first += duration_cast<nanoseconds>(first - start);
+    to_end += duration_cast<nanoseconds>(end - start);
+  }
+
+  rt::Scheduler::release_persistent();
+  std::cout << name << ": time to first behaviour: "
+            << to_first.count() / runs << "ns, time to end of run: "
+            << to_end.count() / runs << "ns" << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+  opt::Opt opt(argc, argv);
+
+  const auto cores = opt.is<size_t>("--cores", 4);
+  const auto runs = opt.is<size_t>("--runs", 1000);
+
+  std::cout << "cores: " << cores << ", runs: " << runs << std::endl;
+
+  for (int l = 0; l < 5; l++)
+  {
+    run(cores, runs, false, "fresh");
+    run(cores, runs, true, "persistent");
+  }
+
+  heap::debug_check_empty();
+}
@@ -234,6 +234,8 @@ int main(int argc, char** argv)
   const auto report_count = opt.is<size_t>("--report_count", 10);
   const auto initial_pings = opt.is<size_t>("--initial_pings", 5);
   const auto percent_multimessage = opt.is<size_t>("--percent_multimessage", 5);
+  const auto steal_half = opt.has("--steal-half");
+  const auto behaviour_pool = opt.is<size_t>("--behaviour-pool", 0);
   check(percent_multimessage <= 100);
 
   logger::cout() << "cores: " << cores
@@ -241,6 +243,8 @@ int main(int argc, char** argv)
                  << ", pingers: " << pingers
                  << ", initial_pings: " << initial_pings
                  << ", percent_mutlimessage: " << percent_multimessage
+                 << ", steal_half: " << steal_half
+                 << ", behaviour_pool: " << behaviour_pool
                  << std::endl;
 
 #ifdef USE_SYSTEMATIC_TESTING
@@ -251,6 +255,8 @@ int main(int argc, char** argv)
 #endif
   auto& sched = rt::Scheduler::get();
   sched.set_fair(true);
+  sched.set_steal_half(steal_half);
+  rt::BehaviourPool::set_capacity(behaviour_pool);
   sched.init(cores);
 
   static vector<Pinger*> pinger_set;
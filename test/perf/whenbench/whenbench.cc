@@ -0,0 +1,288 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * A suite of scheduler microbenchmarks, for a baseline to compare changes
+ * to the scheduler against.
+ *
+ * Each configuration has `--producers` producers share `--behaviours`
+ * behaviours between them. A producer sends them in bursts of 64 from a
+ * behaviour of its own, and sends itself on to send the next burst. Each
+ * behaviour needs `--cowns-per-when` cowns from a pool of `--cowns`
+ * (1 to 16), one of which is the hot cown for `--hot-percent` of them,
+ * acquires them for reading for `--read-percent` of them, and spins for
+ * `--body` iterations.
+ *
+ * For each configuration the benchmark prints the behaviours per second
+ * from the first producer starting to the last behaviour finishing, the
+ * percentiles of the time from a behaviour being sent to it starting, and
+ * the steals of the run (only counted with USE_SCHED_STATS). With
+ * --sweep, it varies each knob in turn from the values given.
+ */
+
+#include "test/opt.h"
+#include "verona.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cpp/when.h>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <util/latency_histogram.h>
+#include <vector>
+
+namespace sn = snmalloc;
+namespace rt = verona::rt;
+using namespace verona::cpp;
+using verona::rt::api::LatencyHistogram;
+
+struct Cell
+{
+  uint64_t value = 0;
+};
+
+struct Config
+{
+  size_t cowns_per_when;
+  size_t hot_percent;
+  size_t read_percent;
+  size_t body;
+  size_t producers;
+};
+
+using CellPool = std::vector<cown_ptr<Cell>>;
+
+/// Most cowns a behaviour needs.
+static constexpr size_t MAX_COWNS = 16;
+static constexpr size_t BURST = 64;
+
+size_t behaviours;
+std::atomic<size_t> finished;
+std::atomic<uint64_t> start_ns;
+std::atomic<uint64_t> end_ns;
+
+uint64_t now_ns()
+{
+  return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+           std::chrono::steady_clock::now().time_since_epoch())
+    .count();
+}
+
+/// The histograms of the scheduler threads in the current run, which are
+/// merged when it ends.
+std::mutex histograms_lock;
+std::vector<std::unique_ptr<LatencyHistogram>> histograms;
+size_t generation = 0;
+
+void record_latency(uint64_t sent)
+{
+  static thread_local LatencyHistogram* local = nullptr;
+  static thread_local size_t local_generation = 0;
+  if (local == nullptr || local_generation != generation)
+  {
+    std::lock_guard<std::mutex> lock(histograms_lock);
+    histograms.push_back(std::make_unique<LatencyHistogram>());
+    local = histograms.back().get();
+    local_generation = generation;
+  }
+  local->record(now_ns() - sent);
+}
+
+void finish()
+{
+  if (finished.fetch_add(1) + 1 == behaviours)
+    end_ns = now_ns();
+}
+
+void spin(size_t body)
+{
+  for (volatile size_t i = 0; i < body; i++)
+    sn::Aal::pause();
+}
+
+void send(const Config& c, const CellPool& pool, std::mt19937_64& rng)
+{
+  cown_ptr<Cell> chosen[MAX_COWNS];
+  size_t index[MAX_COWNS];
+  size_t k = c.cowns_per_when;
+  size_t n = 0;
+  if (rng() % 100 < c.hot_percent)
+    index[n++] = 0;
+  while (n < k)
+  {
+    size_t i = 1 + rng() % (pool.size() - 1);
+    if (std::find(index, index + n, i) == index + n)
+      index[n++] = i;
+  }
+  for (size_t i = 0; i < k; i++)
+    chosen[i] = pool[index[i]];
+
+  cown_array<Cell> cowns{chosen, k};
+  uint64_t sent = now_ns();
+  size_t body = c.body;
+  if (rng() % 100 < c.read_percent)
+  {
+    when(read(cowns)) << [sent, body](auto cells) {
+      record_latency(sent);
+      UNUSED(cells.array[0]->value);
+      spin(body);
+      finish();
+    };
+  }
+  else
+  {
+    when(cowns) << [sent, body](acquired_cown_span<Cell> cells) {
+      record_latency(sent);
+      for (size_t i = 0; i < cells.length; i++)
+        cells.array[i]->value++;
+      spin(body);
+      finish();
+    };
+  }
+}
+
+void produce(
+  Config c, std::shared_ptr<CellPool> pool, size_t remaining, uint64_t seed)
+{
+  when() << [c, pool, remaining, seed]() {
+    uint64_t expected = 0;
+    start_ns.compare_exchange_strong(expected, now_ns());
+
+    std::mt19937_64 rng(seed);
+    size_t burst = std::min(remaining, BURST);
+    for (size_t i = 0; i < burst; i++)
+      send(c, *pool, rng);
+    if (remaining > burst)
+      produce(c, pool, remaining - burst, rng());
+  };
+}
+
+void run(const Config& c, size_t cores, size_t pool_size, size_t seed)
+{
+  finished = 0;
+  start_ns = 0;
+  end_ns = 0;
+  histograms.clear();
+  generation++;
+
+  auto& sched = rt::Scheduler::get();
+  sched.init(cores);
+
+  when() << [c, pool_size, seed]() {
+    auto pool = std::make_shared<CellPool>();
+    for (size_t i = 0; i < pool_size; i++)
+      pool->push_back(make_cown<Cell>());
+
+    for (size_t p = 0; p < c.producers; p++)
+    {
+      size_t share = behaviours / c.producers +
+        (p < behaviours % c.producers ? 1 : 0);
+      if (share != 0)
+        produce(c, pool, share, seed + p);
+    }
+  };
+
+  sched.run();
+
+  LatencyHistogram latency;
+  for (auto& h : histograms)
+    latency.merge(*h);
+
+  uint64_t elapsed = end_ns - start_ns;
+  double rate =
+    elapsed == 0 ? 0 : (double)behaviours * 1e9 / (double)elapsed;
+  std::cout << std::setw(6) << c.cowns_per_when << std::setw(6)
+            << c.hot_percent << std::setw(7) << c.read_percent << std::setw(7)
+            << c.body << std::setw(7) << c.producers << std::setw(14)
+            << std::fixed << std::setprecision(0) << rate << std::defaultfloat
+            << std::setw(10) << latency.percentile(50) << std::setw(10)
+            << latency.percentile(90) << std::setw(10)
+            << latency.percentile(99) << std::setw(10)
+            << latency.percentile(99.9) << std::setw(11) << latency.max()
+#ifdef USE_SCHED_STATS
+            << std::setw(9) << rt::SchedulerStats::get_last_steal_count()
+#else
+            << std::setw(9) << "n/a"
+#endif
+            << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+  opt::Opt opt(argc, argv);
+
+  const auto cores = opt.is<size_t>("--cores", 4);
+  const auto seed = opt.is<size_t>("--seed", 1);
+  const auto pool_size =
+    std::max<size_t>(opt.is<size_t>("--cowns", 64), 2 * MAX_COWNS);
+  const auto repeats = opt.is<size_t>("--repeats", 1);
+  const auto sweep = opt.has("--sweep");
+  behaviours = opt.is<size_t>("--behaviours", 20000);
+
+  Config base;
+  base.cowns_per_when =
+    std::clamp<size_t>(opt.is<size_t>("--cowns-per-when", 1), 1, MAX_COWNS);
+  base.hot_percent =
+    std::min<size_t>(opt.is<size_t>("--hot-percent", 0), 100);
+  base.read_percent =
+    std::min<size_t>(opt.is<size_t>("--read-percent", 0), 100);
+  base.body = opt.is<size_t>("--body", 0);
+  base.producers = std::max<size_t>(opt.is<size_t>("--producers", cores), 1);
+
+  std::vector<Config> configs{base};
+  if (sweep)
+  {
+    for (size_t k : {2, 4, 8, 16})
+    {
+      Config c = base;
+      c.cowns_per_when = k;
+      configs.push_back(c);
+    }
+    for (size_t hot : {10, 50, 90})
+    {
+      Config c = base;
+      c.hot_percent = hot;
+      configs.push_back(c);
+    }
+    for (size_t reads : {50, 90, 100})
+    {
+      Config c = base;
+      c.read_percent = reads;
+      configs.push_back(c);
+    }
+    for (size_t body : {100, 1000, 10000})
+    {
+      Config c = base;
+      c.body = body;
+      configs.push_back(c);
+    }
+    for (size_t producers : {size_t(1), 2 * cores})
+    {
+      Config c = base;
+      c.producers = producers;
+      configs.push_back(c);
+    }
+  }
+
+  std::cout << "cores: " << cores << ", behaviours: " << behaviours
+            << ", cowns: " << pool_size << std::endl;
+  std::cout << std::setw(6) << "k" << std::setw(6) << "hot%" << std::setw(7)
+            << "read%" << std::setw(7) << "body" << std::setw(7) << "prod"
+            << std::setw(14) << "behaviours/s" << std::setw(10) << "p50_ns"
+            << std::setw(10) << "p90_ns" << std::setw(10) << "p99_ns"
+            << std::setw(10) << "p99.9_ns" << std::setw(11) << "max_ns"
+            << std::setw(9) << "steals" << std::endl;
+
+  for (const Config& c : configs)
+  {
+    for (size_t r = 0; r < repeats; r++)
+      run(c, cores, pool_size, seed + r);
+  }
+
+  histograms.clear();
+  heap::debug_check_empty();
+}
@@ -0,0 +1,62 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+// Built against verona_rt_production, at -O2, for production_check.cmake to
+// look for debugging hooks left in the runtime. It runs behaviours, which
+// allocate and collect in regions, so that the scheduler loop, scheduling
+// and the region allocators are all compiled in.
+
+#include <verona.h>
+
+using namespace verona::rt;
+using namespace verona::rt::api;
+
+struct Node : public V<Node>
+{
+  Node* next = nullptr;
+
+  void trace(ObjectStack& st) const
+  {
+    if (next != nullptr)
+      st.push(next);
+  }
+};
+
+struct Counter : public VCown<Counter>
+{
+  size_t count = 0;
+};
+
+int main()
+{
+  Scheduler& sched = Scheduler::get();
+  sched.init(2);
+
+  auto* c = new Counter;
+  for (size_t i = 0; i < 100; i++)
+  {
+    schedule_lambda(c, [c]() {
+      c->count++;
+      for (auto type : {RegionType::Trace, RegionType::Arena})
+      {
+        auto* r = new (type) Node;
+        {
+          UsingRegion rr(r);
+          for (size_t j = 0; j < 10; j++)
+          {
+            auto* n = new Node;
+            n->next = r->next;
+            r->next = n;
+          }
+        }
+        region_release(r);
+      }
+      if (c->count == 100)
+        printf("Production check ran\n");
+    });
+  }
+  Cown::release(c);
+
+  sched.run();
+  return 0;
+}
@@ -7,7 +7,10 @@ Usage:
     python benchmark_visualizer.py <test_name> --sys [args...]
     python benchmark_visualizer.py <test_name> --run_all [args...]
     python benchmark_visualizer.py [runs] [warmup_runs] <test_name> [args...]
+    python benchmark_visualizer.py <test_name> --interleave [args...]
     python benchmark_visualizer.py --csv <folder_name>
+    python benchmark_visualizer.py --combined <combined_csv>
+    python benchmark_visualizer.py --sweep <sweep_csv>
 
 Examples:
     python benchmark_visualizer.py gol
@@ -48,37 +51,371 @@ else:
 
 def parse_csv(filepath):
     """Parse a benchmark CSV file."""
-    results = {"name": Path(filepath).stem, "runs": [], "p50": 0, "p99": 0, "jitter": 0}
+    with open(filepath, "r") as f:
+        return parse_lines(
+            f,
+            Path(filepath).stem,
+            Path(filepath).parent / "timeline" / Path(filepath).name,
+        )
+
 
+def parse_combined(filepath):
+    """Parse the combined CSV written by `benchmarker --regions`.
+
+    It holds one benchmark CSV per region type, each after a
+    "## region=<name>" line. Returns a dict from region name to results.
+    """
+    sections = {}
+    name = None
     with open(filepath, "r") as f:
         for line in f:
-            line = line.strip()
-            if not line or line.startswith("run,"):
-                continue
-            if line.startswith("#"):
-                parts = dict(p.split("=") for p in line[1:].split(",") if "=" in p)
+            if line.startswith("## region="):
+                name = line.strip()[len("## region="):]
+                sections[name] = []
+            elif name is not None:
+                sections[name].append(line)
+    return {name: parse_lines(lines, name, None) for name, lines in sections.items()}
+
+
+def parse_lines(lines, name, timeline_path):
+    """Parse the lines of one benchmark CSV."""
+    results = {
+        "name": name,
+        "runs": [],
+        "p50": 0,
+        "p99": 0,
+        "jitter": 0,
+        "mmu": [],
+        "phases": {},
+        "counters": {},
+        "work": {},
+        "after": [],
+        "footprint": [],
+        "timeline": parse_timeline(timeline_path) if timeline_path else {},
+    }
+
+    for line in lines:
+        line = line.strip()
+        if not line or line.startswith("run,"):
+            continue
+        if line.startswith("#"):
+            parts = dict(p.split("=") for p in line[1:].split(",") if "=" in p)
+            if "mmu_window_ns" in parts:
+                results["mmu"].append(
+                    (
+                        int(parts["mmu_window_ns"]),
+                        float(parts["mmu_min"]),
+                        float(parts["mmu_mean"]),
+                    )
+                )
+            elif "phases" in parts:
+                results["phases"] = {
+                    k[: -len("_ns")]: int(v)
+                    for k, v in parts.items()
+                    if k.endswith("_ns")
+                }
+            elif "work" in parts:
+                parts.pop("work")
+                results["work"] = {k: int(v) for k, v in parts.items()}
+            elif "counters" in parts:
+                label = parts.pop("counters")
+                results["counters"][label] = {k: int(v) for k, v in parts.items()}
+            elif "jitter" in parts:
                 results["p50"] = int(parts.get("p50_ns", 0))
                 results["p99"] = int(parts.get("p99_ns", 0))
                 results["jitter"] = float(parts.get("jitter", 0))
-            else:
-                parts = line.split(",")
-                if len(parts) >= 7:
-                    run_time_ns = int(parts[7]) if len(parts) >= 8 else 0
-                    results["runs"].append(
-                        (
-                            int(parts[0]),
-                            int(parts[1]),
-                            int(parts[2]),
-                            int(parts[3]),
-                            int(parts[4]),
-                            int(parts[5]),
-                            int(parts[6]),
-                            run_time_ns,
-                        )
+        else:
+            parts = line.split(",")
+            if len(parts) >= 7:
+                run_time_ns = int(parts[7]) if len(parts) >= 8 else 0
+                results["runs"].append(
+                    (
+                        int(parts[0]),
+                        int(parts[1]),
+                        int(parts[2]),
+                        int(parts[3]),
+                        int(parts[4]),
+                        int(parts[5]),
+                        int(parts[6]),
+                        run_time_ns,
                     )
+                )
+            if len(parts) >= 22:
+                # avg_mem_after_bytes, peak_mem_after_bytes, reclaimed_bytes,
+                # survival_ratio
+                results["after"].append(
+                    (int(parts[18]), int(parts[19]), int(parts[20]), float(parts[21]))
+                )
+            if len(parts) >= 26:
+                # peak_mem_bytes (counted by the regions), rss_peak_bytes,
+                # allocator_peak_bytes
+                results["footprint"].append(
+                    (int(parts[5]), int(parts[23]), int(parts[25]))
+                )
     return results
 
 
+def parse_timeline(filepath):
+    """Parse the pause timeline written next to a benchmark CSV, if any.
+
+    Returns a dict from run number to a list of (start_ns, duration_ns).
+    """
+    timeline = {}
+    if not Path(filepath).exists():
+        return timeline
+    with open(filepath, "r") as f:
+        for line in f:
+            line = line.strip()
+            if not line or line.startswith("#") or line.startswith("run,"):
+                continue
+            parts = line.split(",")
+            if len(parts) >= 3:
+                timeline.setdefault(int(parts[0]), []).append(
+                    (int(parts[1]), int(parts[2]))
+                )
+    return timeline
+
+
+def plot_mmu(all_results, output_path, colors):
+    """Plot MMU curves and the pause timeline of the first run of each type."""
+    with_mmu = {n: r for n, r in all_results.items() if r["mmu"]}
+    if not with_mmu:
+        print("No MMU data to plot")
+        return
+
+    fig, axes = plt.subplots(1, 2, figsize=(14, 5))
+
+    for idx, (name, results) in enumerate(with_mmu.items()):
+        color = colors[idx % len(colors)]
+        windows_ms = [w / 1e6 for (w, _, _) in results["mmu"]]
+        axes[0].plot(
+            windows_ms,
+            [m for (_, m, _) in results["mmu"]],
+            label=f"{name} (worst run)",
+            color=color,
+            marker="o",
+        )
+        axes[0].plot(
+            windows_ms,
+            [m for (_, _, m) in results["mmu"]],
+            label=f"{name} (mean)",
+            color=color,
+            linestyle="--",
+        )
+
+        if results["timeline"]:
+            first_run = min(results["timeline"].keys())
+            pauses = results["timeline"][first_run]
+            axes[1].scatter(
+                [s / 1e6 for (s, _) in pauses],
+                [max(d, 1) / 1e3 for (_, d) in pauses],
+                label=name,
+                color=color,
+                s=4,
+            )
+
+    axes[0].set_xscale("log")
+    axes[0].set_ylim(0, 1.05)
+    axes[0].set_xlabel("Window (ms)")
+    axes[0].set_ylabel("Minimum Mutator Utilisation")
+    axes[0].set_title("MMU by Window Size")
+    axes[0].legend(fontsize=7, loc="lower right")
+
+    axes[1].set_yscale("log")
+    axes[1].set_xlabel("Time Since Run Start (ms)")
+    axes[1].set_ylabel("Pause (µs)")
+    axes[1].set_title("GC Pause Timeline (first run)")
+    if axes[1].collections:
+        axes[1].legend(fontsize=7, loc="upper right")
+
+    plt.tight_layout()
+    plt.savefig(output_path, dpi=150)
+    print(f"Saved: {output_path}")
+    plt.show()
+
+
+def plot_phases(all_results, output_path, colors):
+    """Plot the share of GC time each phase took, as one stacked bar per type."""
+    with_phases = {
+        n: r for n, r in all_results.items() if sum(r["phases"].values()) > 0
+    }
+    if not with_phases:
+        print("No GC phase data to plot")
+        return
+
+    phase_names = []
+    for results in with_phases.values():
+        for p in results["phases"]:
+            if p not in phase_names:
+                phase_names.append(p)
+
+    fig, ax = plt.subplots(figsize=(10, 5))
+    names = list(with_phases.keys())
+    bottoms = [0.0] * len(names)
+    for idx, phase in enumerate(phase_names):
+        totals = [sum(with_phases[n]["phases"].values()) for n in names]
+        shares = [
+            100.0 * with_phases[n]["phases"].get(phase, 0) / t
+            for n, t in zip(names, totals)
+        ]
+        ax.bar(
+            names,
+            shares,
+            bottom=bottoms,
+            label=phase,
+            color=colors[idx % len(colors)],
+            edgecolor="black",
+        )
+        bottoms = [b + s for b, s in zip(bottoms, shares)]
+
+    ax.set_ylim(0, 100)
+    ax.set_xlabel("Region Type")
+    ax.set_ylabel("Share of GC Time (%)")
+    ax.set_title("GC Time by Phase")
+    ax.legend(fontsize=8, loc="upper right")
+
+    plt.tight_layout()
+    plt.savefig(output_path, dpi=150)
+    print(f"Saved: {output_path}")
+    plt.show()
+
+
+def plot_survival(all_results, output_path, colors):
+    """Plot the live memory after GC and the survival ratio of each run."""
+    with_after = {n: r for n, r in all_results.items() if r["after"]}
+    if not with_after:
+        print("No post-GC memory data to plot")
+        return
+
+    # Column of each run's "after" tuple, its scale, and its label
+    panels = [
+        (0, 1 / 1024, "Avg Live After GC (KB)"),
+        (2, 1 / 1024, "Reclaimed per Run (KB)"),
+        (3, 1, "Survival Ratio (after / before)"),
+    ]
+    names = list(with_after.keys())
+    fig, axes = plt.subplots(1, len(panels), figsize=(15, 5))
+    for ax, (column, scale, label) in zip(axes, panels):
+        data = [[a[column] * scale for a in with_after[n]["after"]] for n in names]
+        bp = ax.boxplot(data, patch_artist=True, vert=False)
+        for idx, patch in enumerate(bp["boxes"]):
+            patch.set_facecolor(colors[idx % len(colors)])
+            patch.set_edgecolor("black")
+        ax.set_yticks(range(1, len(names) + 1))
+        ax.set_yticklabels(names)
+        ax.set_xlabel(label)
+        ax.set_title(label)
+    axes[-1].set_xlim(0, 1.05)
+
+    plt.tight_layout()
+    plt.savefig(output_path, dpi=150)
+    print(f"Saved: {output_path}")
+    plt.show()
+
+
+def plot_footprint(all_results, output_path, colors):
+    """Compare the peak memory the regions counted with the process's."""
+    with_fp = {n: r for n, r in all_results.items() if r["footprint"]}
+    if not with_fp:
+        print("No process memory data to plot")
+        return
+
+    names = list(with_fp.keys())
+    measures = ["Counted by regions", "Process RSS", "Allocator"]
+    width = 0.8 / len(measures)
+    fig, ax = plt.subplots(figsize=(10, 5))
+    for m, label in enumerate(measures):
+        means = [
+            sum(f[m] for f in with_fp[n]["footprint"])
+            / len(with_fp[n]["footprint"])
+            / (1024 * 1024)
+            for n in names
+        ]
+        ax.bar(
+            [i + (m - 1) * width for i in range(len(names))],
+            means,
+            width,
+            label=label,
+            color=colors[m % len(colors)],
+            edgecolor="black",
+        )
+    ax.set_xticks(range(len(names)))
+    ax.set_xticklabels(names)
+    ax.set_xlabel("Region Type")
+    ax.set_ylabel("Mean Peak Memory (MB)")
+    ax.set_title("Memory Counted by Regions vs Process Footprint")
+    ax.legend(fontsize=8)
+
+    plt.tight_layout()
+    plt.savefig(output_path, dpi=150)
+    print(f"Saved: {output_path}")
+    plt.show()
+
+
+def plot_sweep(filepath):
+    """Plot the speedup and efficiency curves of a `benchmarker --sweep-cores`
+    CSV, one line per region type and parameter values, next to the
+    median time the thread pool took to start and stop at each core count."""
+    import csv
+
+    curves = {}
+    startup = {}
+    with open(filepath, newline="") as f:
+        reader = csv.DictReader(f)
+        params = reader.fieldnames[3:-3]
+        for row in reader:
+            label = row["region"] + "".join(
+                f" {p}={row[p]}" for p in params
+            )
+            cores = int(row["cores"])
+            if row["trial"] == "":
+                curve = curves.setdefault(label, {})
+                curve.setdefault(cores, {})[row["metric"]] = float(row["value"])
+            elif row["metric"] == "pool_startup_ns":
+                startup.setdefault(cores, []).append(float(row["value"]))
+
+    if not curves:
+        print(f"No speedup rows in {filepath}")
+        return
+
+    fig, axes = plt.subplots(1, 3, figsize=(18, 5))
+    all_cores = sorted({c for curve in curves.values() for c in curve})
+    for label, curve in sorted(curves.items()):
+        cores = sorted(curve)
+        axes[0].plot(cores, [curve[c]["speedup"] for c in cores], marker="o",
+                     label=label)
+        axes[1].plot(cores, [curve[c]["efficiency"] for c in cores],
+                     marker="o", label=label)
+
+    base = all_cores[0]
+    axes[0].plot(all_cores, [c / base for c in all_cores], "k--", alpha=0.5,
+                 label="ideal")
+    axes[1].axhline(1.0, color="k", linestyle="--", alpha=0.5)
+    for ax, title in ((axes[0], "Speedup"), (axes[1], "Parallel efficiency")):
+        ax.set_xscale("log", base=2)
+        ax.set_xticks(all_cores)
+        ax.set_xticklabels([str(c) for c in all_cores])
+        ax.set_xlabel("Cores")
+        ax.set_title(title)
+        ax.grid(True, alpha=0.3)
+    axes[0].legend(fontsize=8)
+
+    startup_cores = sorted(startup)
+    axes[2].plot(startup_cores,
+                 [np.median(startup[c]) / 1e6 for c in startup_cores],
+                 marker="o")
+    axes[2].set_xlabel("Cores")
+    axes[2].set_ylabel("Median start and stop (ms)")
+    axes[2].set_title("Thread pool startup")
+    axes[2].grid(True, alpha=0.3)
+
+    plt.tight_layout()
+    output_path = Path(filepath).parent / "benchmark_sweep.png"
+    plt.savefig(output_path, dpi=150)
+    print(f"Saved: {output_path}")
+    plt.show()
+
+
 def plot_bp(ax, data, labels, box_colors, xlabel, title):
     bp = ax.boxplot(data, patch_artist=True, vert=False)
     for patch, color in zip(bp["boxes"], box_colors):
@@ -106,7 +443,7 @@ def plot(all_results, output_path, test_name=None):
     fig, axes = plt.subplots(2, 3, figsize=(14, 8))
 
     # Colors for different region types
-    colors = ["#3498db", "#e74c3c", "#2ecc71", "#9b59b6", "#f39c12"]
+    colors = ["#3498db", "#e74c3c", "#2ecc71", "#9b59b6", "#f39c12", "#1abc9c"]
 
     num_types = len(all_results)
     width = 0.8 / num_types  # Bar width based on number of types
@@ -116,9 +453,10 @@ def plot(all_results, output_path, test_name=None):
     runs = [r[0] for r in first_result["runs"]]
     x = range(len(runs))
 
-    region_color_map = {"trace": colors[0], "arena": colors[1], "rc": colors[2], "semispace": colors[3]}
+    region_color_map = {"trace": colors[0], "arena": colors[1], "rc": colors[2], "semispace": colors[3], "generational": colors[4], "compact": colors[5]}
     avg_gc_us_data = [
-        [(r[1] / r[2]) / 1e3 for r in results["runs"]]
+        # A native baseline makes no collections.
+        [(r[1] / r[2]) / 1e3 if r[2] > 0 else 0 for r in results["runs"]]
         for results in all_results.values()
     ]
     max_gc_us_data = [
@@ -135,7 +473,7 @@ def plot(all_results, output_path, test_name=None):
         region_color_map.get(
             "trace"
             if "trace" in name
-            else ("arena" if "arena" in name else ("rc" if "rc" in name else ("semispace" if "semispace" in name else None))),
+            else ("arena" if "arena" in name else ("rc" if "rc" in name else ("semispace" if "semispace" in name else ("generational" if "generational" in name else ("compact" if "compact" in name else None))))),
             colors[idx % len(colors)],
         )
         for idx, (name) in enumerate(all_results.keys())
@@ -184,7 +522,9 @@ def plot(all_results, output_path, test_name=None):
             "trace" if "trace" in name else (
                 "arena" if "arena" in name else (
                     "rc" if "rc" in name else (
-                        "semispace" if "semispace" in name else None))),
+                        "semispace" if "semispace" in name else (
+                            "generational" if "generational" in name else (
+                                "compact" if "compact" in name else None))))),
             colors[idx % len(colors)],
         )
         data = np.array(gc_times)
@@ -278,8 +618,33 @@ if __name__ == "__main__":
     CSV_DIR = Path(__file__).parent.parent / "CSVs"
     test_name = None
 
+    interleave = "--interleave" in sys.argv
+    if interleave:
+        sys.argv.remove("--interleave")
+        args = sys.argv[1:]
+
+    combined_file = None
+
+    # Sweep mode: plot the scaling curves of a sweep and stop
+    if len(args) >= 2 and args[0] == "--sweep":
+        sweep_file = Path(args[1])
+        if not sweep_file.exists():
+            print(f"Error: File not found: {sweep_file}")
+            sys.exit(1)
+        plot_sweep(sweep_file)
+        sys.exit(0)
+
+    # Combined mode: --combined must be the first argument
+    if len(args) >= 2 and args[0] == "--combined":
+        combined_file = Path(args[1])
+        if not combined_file.exists():
+            print(f"Error: File not found: {combined_file}")
+            sys.exit(1)
+        target_dir = combined_file.parent
+        csv_files = []
+
     # CSV mode: --csv must be the first argument
-    if len(args) >= 2 and args[0] == "--csv":
+    elif len(args) >= 2 and args[0] == "--csv":
         folder_name = args[1]
         target_dir = CSV_DIR / folder_name
         print(f"Checking directory for CSV files: {target_dir} (full path: {target_dir.resolve()})")
@@ -351,8 +716,11 @@ if __name__ == "__main__":
             print(f"Error: benchmarker_main not found in {exe.parent}")
             sys.exit(1)
 
-        if run_all:
-            gc_types = ["trace", "rc", "arena", "semispace"]
+        if interleave:
+            # One process runs every region type, in interleaved trials
+            gc_types = [None]
+        elif run_all:
+            gc_types = ["trace", "rc", "arena", "semispace", "generational", "compact"]
         else:
             gc_types = [None]
 
@@ -363,8 +731,10 @@ if __name__ == "__main__":
                 runs,
                 f"--warmup_runs",
                 warmup_runs,
-                str(test_lib_path),
-            ] + extra_args
+            ]
+            if interleave:
+                cmd += ["--regions", "all"]
+            cmd += [str(test_lib_path)] + extra_args
             if gc_type:
                 cmd += [f"--{gc_type}"]
             print(extra_args)
@@ -381,25 +751,40 @@ if __name__ == "__main__":
         if not target_dir.exists() or not target_dir.is_dir():
             print(f"Error: Directory not found: {target_dir}")
             sys.exit(1)
-        csv_files = list(target_dir.glob("*.csv"))
-        if not csv_files:
+        if interleave:
+            combined_file = target_dir / "combined" / "interleaved.csv"
+            if not combined_file.exists():
+                print(f"Error: File not found: {combined_file}")
+                sys.exit(1)
+        csv_files = [] if interleave else list(target_dir.glob("*.csv"))
+        if not csv_files and not interleave:
             print(f"No CSV files found in directory '{target_dir}'")
             print("Available benchmarks:")
             for bname in available_benchmarks:
                 print(f"  {bname}")
             sys.exit(1)
 
-    print(f"\nFound {len(csv_files)} CSV file(s)")
+    if combined_file is not None:
+        print(f"\nReading combined results: {combined_file}")
+    else:
+        print(f"\nFound {len(csv_files)} CSV file(s)")
 
     # Parse all CSVs and combine into one plot
-    all_results = {}
+    all_results = parse_combined(combined_file) if combined_file is not None else {}
     label_counts = {}
     for csv_file in sorted(csv_files):
         results = parse_csv(csv_file)
         stem = Path(csv_file).stem.lower()
 
-        # Detect region type from filename
-        if "trace" in stem:
+        # Detect region type from filename, or the native baseline run in
+        # place of one
+        baseline = next(
+            (b for b in ("baseline_new", "baseline_shared", "baseline_monotonic") if b in stem),
+            None,
+        )
+        if baseline:
+            base = baseline
+        elif "trace" in stem:
             base = "trace"
         elif "arena" in stem:
             base = "arena"
@@ -407,6 +792,10 @@ if __name__ == "__main__":
             base = "rc"
         elif "semispace" in stem:
             base = "semispace"
+        elif "generational" in stem:
+            base = "generational"
+        elif "compact" in stem:
+            base = "compact"
         else:
             base = Path(csv_file).stem
 
@@ -418,4 +807,24 @@ if __name__ == "__main__":
     # Determine test name for the plot title
     plot_test_name = test_name if test_name else None
     output_file = target_dir / "benchmark_comparison.png"
-    plot(all_results, str(output_file), test_name=plot_test_name)
\ No newline at end of file
+    plot(all_results, str(output_file), test_name=plot_test_name)
+    plot_mmu(
+        all_results,
+        str(target_dir / "benchmark_mmu.png"),
+        ["#3498db", "#e74c3c", "#2ecc71", "#9b59b6", "#f39c12", "#1abc9c"],
+    )
+    plot_phases(
+        all_results,
+        str(target_dir / "benchmark_phases.png"),
+        ["#3498db", "#e74c3c", "#2ecc71", "#9b59b6", "#f39c12", "#1abc9c"],
+    )
+    plot_survival(
+        all_results,
+        str(target_dir / "benchmark_survival.png"),
+        ["#3498db", "#e74c3c", "#2ecc71", "#9b59b6", "#f39c12", "#1abc9c"],
+    )
+    plot_footprint(
+        all_results,
+        str(target_dir / "benchmark_footprint.png"),
+        ["#3498db", "#e74c3c", "#2ecc71", "#9b59b6", "#f39c12", "#1abc9c"],
+    )
\ No newline at end of file